@@ -4,7 +4,13 @@ import joblib
 import numpy as np
 import pandas as pd
 from datetime import datetime, timedelta
+import json
 import os
+import sys
+import threading
+import time
+import urllib.parse
+import urllib.request
 import warnings
 warnings.filterwarnings('ignore')
 
@@ -13,8 +19,18 @@ CORS(app)
 
 # Global variables to store model and data
 model = None
+native_forest = None  # Flattened model run by backend/native, when built
+curalink_forest = None
 synthetic_data = None
 current_prediction = None
+history_store = None  # Bed history store from backend/native, when built
+history_dir = None
+history_lock = threading.Lock()
+history_cursor = None  # Last bedHistory key copied from the RTDB
+history_synced = 0.0
+HISTORY_SYNC_SECONDS = 10
+HISTORY_SYNC_BATCH = 5000
+HISTORY_MAX_LIMIT = 5000
 
 # Alert threshold configuration
 PATIENT_THRESHOLD_HIGH = 40  # Red alert threshold
@@ -53,6 +69,152 @@ def load_model():
         print(f"Error loading model: {str(e)}")
         return False
 
+def load_native_forest():
+    """Load the flattened forest (rf_best_model.forest) into the native module
+
+    Export it with native/export_forest.py and build the module with
+    `python setup.py build_ext --inplace` in backend/native. Predictions are
+    identical to scikit-learn's; without them the joblib model is used.
+    """
+    global native_forest, curalink_forest
+    base = os.path.dirname(__file__)
+    path = os.path.join(base, 'rf_best_model.forest')
+    if not os.path.exists(path):
+        return False
+    try:
+        sys.path.insert(0, os.path.join(base, 'native'))
+        import curalink_forest as module
+        native_forest = module.Forest(path)
+        curalink_forest = module
+        print(f"Native forest loaded ({native_forest.n_trees} trees)")
+        return True
+    except (ImportError, ValueError) as e:
+        print(f"Native forest unavailable: {str(e)}")
+        return False
+
+def load_history_store():
+    """Open the bed history store (native/historyStore.h) in HISTORY_DIR
+
+    Defaults to backend/history_data. Needs the curalink_history module built
+    with `python setup.py build_ext --inplace` in backend/native; without it
+    the /history endpoints answer 503 and the dashboard keeps its RTDB window.
+    """
+    global history_store, history_dir, history_cursor
+    base = os.path.dirname(__file__)
+    history_dir = os.environ.get('HISTORY_DIR') or os.path.join(base, 'history_data')
+    try:
+        sys.path.insert(0, os.path.join(base, 'native'))
+        import curalink_history
+        history_store = curalink_history.Store(history_dir)
+    except (ImportError, OSError) as e:
+        print(f"History store unavailable: {str(e)}")
+        return False
+    cursor_path = os.path.join(history_dir, 'firebase.cursor')
+    if os.path.exists(cursor_path):
+        with open(cursor_path) as f:
+            history_cursor = f.read().strip() or None
+    print(f"History store opened ({history_store.stats()['events']} events)")
+    return True
+
+def history_time(value):
+    """Milliseconds from an RTDB timestamp (server time in ms, or ISO text)"""
+    if isinstance(value, (int, float)):
+        return int(value)
+    try:
+        return int(datetime.fromisoformat(str(value).replace('Z', '+00:00')).timestamp() * 1000)
+    except ValueError:
+        return None
+
+def history_event(entry):
+    """A bedHistory entry as a store row; None if it has no bed or time"""
+    if not isinstance(entry, dict):
+        return None
+    ts = history_time(entry.get('timestamp'))
+    if ts is None or not entry.get('bedId'):
+        return None
+    data = entry.get('data') if isinstance(entry.get('data'), dict) else {}
+    text = lambda key: None if data.get(key) is None else str(data.get(key))
+    return (ts, str(entry['bedId']), str(entry.get('action') or ''), text('previousStatus'),
+            text('newStatus'), text('staffId'), text('source'), json.dumps(data, separators=(',', ':')))
+
+def history_entry(row):
+    """A store row back in the bedHistory shape the dashboard renders"""
+    ts, bed, action, _, _, _, _, payload = row
+    return {'bedId': bed, 'action': action, 'data': json.loads(payload) if payload else {}, 'timestamp': ts}
+
+def firebase_json(path, params=None):
+    """GET a node from the RTDB REST API; None without FIREBASE_DATABASE_URL"""
+    url = os.environ.get('FIREBASE_DATABASE_URL')
+    if not url:
+        return None
+    query = dict(params or {})
+    if os.environ.get('FIREBASE_AUTH'):
+        query['auth'] = os.environ['FIREBASE_AUTH']
+    full = url.rstrip('/') + '/' + path + '.json'
+    if query:
+        full += '?' + urllib.parse.urlencode(query)
+    with urllib.request.urlopen(full, timeout=10) as response:
+        return json.load(response)
+
+def sync_history():
+    """Copy bedHistory entries added since the last sync into the store
+
+    Reads the RTDB in key order from the saved cursor, HISTORY_SYNC_BATCH
+    entries at a time, at most every HISTORY_SYNC_SECONDS. Push keys grow
+    with time, so the cursor never misses an entry; an entry can be stored
+    twice only if the backend stops between a batch and its cursor write.
+    """
+    global history_cursor, history_synced
+    if history_store is None or time.time() - history_synced < HISTORY_SYNC_SECONDS:
+        return
+    history_synced = time.time()
+    cursor_path = os.path.join(history_dir, 'firebase.cursor')
+    try:
+        wards = None
+        while True:
+            params = {'orderBy': '"$key"', 'limitToFirst': HISTORY_SYNC_BATCH + (1 if history_cursor else 0)}
+            if history_cursor:
+                params['startAt'] = json.dumps(history_cursor)
+            batch = firebase_json('bedHistory', params)
+            if not batch:
+                return
+            keys = sorted(k for k in batch if k != history_cursor)
+            if not keys:
+                return
+            if wards is None:
+                wards = {bed_id: bed.get('ward') for bed_id, bed in (firebase_json('beds') or {}).items()
+                         if isinstance(bed, dict)}
+                for bed_id, ward in wards.items():
+                    if ward:
+                        history_store.set_ward(bed_id, str(ward))
+            rows = [row for row in (history_event(batch[k]) for k in keys) if row is not None]
+            history_store.append(rows)
+            history_cursor = keys[-1]
+            with open(cursor_path, 'w') as f:
+                f.write(history_cursor)
+            if len(keys) < HISTORY_SYNC_BATCH:
+                return
+    except Exception as e:
+        print(f"Could not sync bed history: {str(e)}")
+
+def history_filters(args):
+    """range()/count() keywords from the query string"""
+    filters = {}
+    beds = args.getlist('bed')
+    if beds:
+        filters['beds'] = beds
+    for name in ('ward', 'action', 'status'):
+        if args.get(name):
+            filters[name] = args.get(name)
+    for name, key in (('from', 'start'), ('to', 'end')):
+        if args.get(name):
+            value = args.get(name)
+            ms = int(value) if value.lstrip('-').isdigit() else history_time(value)
+            if ms is None:
+                raise ValueError(f'{name} must be milliseconds or an ISO time')
+            filters[key] = ms
+    return filters
+
 def generate_synthetic_data(hours=240):  # 10 days of hourly data
     """Generate comprehensive synthetic historical data with all model features"""
     end_time = datetime.now()
@@ -123,16 +285,59 @@ def generate_synthetic_data(hours=240):  # 10 days of hourly data
     
     return df
 
+def load_bed_hours(hours=240):
+    """Hourly patient counts from the bed controllers' summaries (/hourly in the RTDB)
+
+    Every bed uploads one summary per hour (hardware hourlyAggregates.h). The
+    ward's patient count for an hour is the number of beds occupied on average:
+    the sum over beds of occupied time / observed time. Returns None when
+    FIREBASE_DATABASE_URL is not set or fewer than 24 hours are available.
+    """
+    url = os.environ.get('FIREBASE_DATABASE_URL')
+    if not url:
+        return None
+    query = url.rstrip('/') + '/hourly.json'
+    auth = os.environ.get('FIREBASE_AUTH')
+    if auth:
+        query += '?auth=' + urllib.parse.quote(auth)
+    try:
+        with urllib.request.urlopen(query, timeout=10) as response:
+            beds = json.load(response) or {}
+    except Exception as e:
+        print(f"Could not read bed summaries: {str(e)}")
+        return None
+
+    census = {}
+    for bed_hours in beds.values():
+        for summary in (bed_hours or {}).values():
+            covered = summary.get('coveredSeconds', 0)
+            if covered <= 0:
+                continue
+            start = int(summary['hourStart'])
+            census[start] = census.get(start, 0) + summary.get('occupiedSeconds', 0) / covered
+    if len(census) < 24:
+        return None
+
+    # Hours with no summaries (controller offline) repeat the previous count
+    starts = sorted(census)
+    series = pd.Series([census[s] for s in starts],
+                       index=pd.DatetimeIndex([datetime.fromtimestamp(s) for s in starts]))
+    series = series.resample('h').mean().ffill().tail(hours)
+    return pd.DataFrame({
+        'datetime': series.index,
+        'patients': [int(round(x)) for x in series]
+    })
+
 def get_next_hour_prediction():
     """Get prediction for the next hour using the new Random Forest model"""
-    if model is None or synthetic_data is None:
+    if (model is None and native_forest is None) or synthetic_data is None:
         return None
         
     try:
         # Get next hour's datetime
         next_hour_time = datetime.now() + timedelta(hours=1)
         
-        # Get the most recent data from synthetic_data for lag and rolling features
+        # Most recent hours (bed summaries, or synthetic) for lag and rolling features
         recent_data = synthetic_data.tail(24).copy()  # Last 24 hours for lags
         
         if len(recent_data) < 24:
@@ -144,6 +349,12 @@ def get_next_hour_prediction():
         hour = next_hour_time.hour
         month = next_hour_time.month
         
+        # Native path: the same features built incrementally, same prediction
+        if native_forest is not None:
+            series = curalink_forest.Series(recent_data['patients'].tolist())
+            prediction = native_forest.forecast([series], dayofweek, hour, month)[0]
+            return max(0, int(round(prediction)))
+
         # Holiday feature (simplified - weekend or random holiday)
         holiday = 1 if dayofweek >= 5 else 0
         
@@ -201,9 +412,14 @@ def get_next_hour_prediction():
 # Initialize model and data on startup
 if not load_model():
     print("Warning: Model failed to load. Some features may be unavailable.")
+load_native_forest()
+load_history_store()
 
-# Generate initial synthetic data (10 days)
-synthetic_data = generate_synthetic_data(240)  # 10 days = 240 hours
+# Hourly history from the beds when available, otherwise synthetic (10 days)
+synthetic_data = load_bed_hours(240)
+data_source = 'beds' if synthetic_data is not None else 'synthetic'
+if synthetic_data is None:
+    synthetic_data = generate_synthetic_data(240)  # 10 days = 240 hours
 current_prediction = get_next_hour_prediction()
 
 @app.route('/predict', methods=['POST'])
@@ -262,13 +478,74 @@ def analytics():
     
     return jsonify(chart_data)
 
+@app.route('/history', methods=['GET', 'POST'])
+def history():
+    """Bed history from the native store
+
+    GET: entries newest first (order=asc for oldest first), filtered by
+    bed (repeatable), ward, from/to (ms or ISO; to is exclusive), action and
+    status, at most limit (1 to 5000, default 500). POST: bedHistory-shaped
+    entries (one or a list, optionally with a ward) from a local stand-in for
+    the RTDB; answers with the number stored.
+    """
+    if history_store is None:
+        return jsonify({'error': 'History store not available'}), 503
+    if request.method == 'POST':
+        entries = request.get_json(silent=True)
+        entries = entries if isinstance(entries, list) else [entries]
+        rows = [row for row in (history_event(e) for e in entries) if row is not None]
+        with history_lock:
+            for entry in entries:
+                if isinstance(entry, dict) and entry.get('ward') and entry.get('bedId'):
+                    history_store.set_ward(str(entry['bedId']), str(entry['ward']))
+            stored = history_store.append(rows)
+        return jsonify({'stored': stored, 'rejected': len(entries) - len(rows)})
+    try:
+        filters = history_filters(request.args)
+        limit = int(request.args.get('limit', 500))
+        if limit < 1:
+            raise ValueError('limit must be at least 1')
+        limit = min(limit, HISTORY_MAX_LIMIT)
+    except ValueError as e:
+        return jsonify({'error': str(e)}), 400
+    with history_lock:
+        sync_history()
+        rows = history_store.range(limit=limit, newest_first=request.args.get('order') != 'asc', **filters)
+    return jsonify({'entries': [history_entry(row) for row in rows]})
+
+@app.route('/history/counts')
+def history_counts():
+    """Events per bucket (hour, day or ms) and status, action or bed
+
+    Takes the same filters as /history; group defaults to status.
+    """
+    if history_store is None:
+        return jsonify({'error': 'History store not available'}), 503
+    buckets = {'hour': 3600000, 'day': 86400000}
+    bucket = request.args.get('bucket', 'hour')
+    try:
+        bucket_ms = buckets[bucket] if bucket in buckets else int(bucket)
+        filters = history_filters(request.args)
+        with history_lock:
+            sync_history()
+            counts = history_store.count(bucket_ms, group=request.args.get('group', 'status'), **filters)
+    except ValueError as e:
+        return jsonify({'error': str(e)}), 400
+    return jsonify({
+        'bucket_ms': bucket_ms,
+        'counts': [{'start': start, 'key': key, 'count': count} for start, key, count in counts]
+    })
+
 @app.route('/health')
 def health():
     """Health check endpoint"""
     return jsonify({
         'status': 'healthy',
         'model_loaded': model is not None,
+        'native_inference': native_forest is not None,
+        'history_store': history_store.stats() if history_store is not None else None,
         'synthetic_data_available': synthetic_data is not None,
+        'data_source': data_source,
         'current_time': datetime.now().isoformat(),
         'alert_thresholds': {
             'high': PATIENT_THRESHOLD_HIGH,
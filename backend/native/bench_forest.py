@@ -0,0 +1,144 @@
+"""Native forest vs scikit-learn: bit-exactness and predictions per second
+
+Usage (after `python setup.py build_ext --inplace` in this directory):
+    python bench_forest.py [--model ../rf_best_model.joblib] [--series 200]
+
+Without --model (or if the file is missing) a forest is trained like
+ML_model/model_train.ipynb on 30 days of synthetic hourly counts. Reports:
+  - exact: native predictions equal to scikit-learn's bit for bit (n_jobs=1;
+    with parallel jobs scikit-learn's sum order varies, so its own results
+    differ in the last bits from run to run)
+  - predictions/s for single rows and for batches
+  - a per-minute refresh of one ward and --series beds: pandas features and
+    scikit-learn per series (what get_next_hour_prediction does) against
+    native Series and one forecast() call, with the features compared
+"""
+
+import argparse
+import os
+import sys
+import tempfile
+import time
+from datetime import datetime, timedelta
+
+import joblib
+import numpy as np
+import pandas as pd
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import curalink_forest  # noqa: E402
+from export_forest import export  # noqa: E402
+
+FEATURES = [
+    'dayofweek', 'hour', 'holiday',
+    'lag1', 'lag2', 'lag3', 'lag24', 'lag6', 'lag12', 'lag18',
+    'rolling_3h', 'rolling_6h', 'rolling_24h', 'rolling_12h', 'rolling_18h',
+    'hour_sq', 'hour_holiday', 'lag1_lag24', 'peak_hour',
+    'season_Monsoon', 'season_Summer', 'season_Winter'
+]
+
+
+def pandas_features(patients, when):
+    """Features as backend/app.py builds them from the last 24 hourly counts"""
+    recent = pd.DataFrame({'patients': patients})
+    dayofweek, hour, month = when.weekday(), when.hour, when.month
+    holiday = 1 if dayofweek >= 5 else 0
+    lag1, lag24 = recent['patients'].iloc[-1], recent['patients'].iloc[-24]
+    return [
+        dayofweek, hour, holiday,
+        lag1, recent['patients'].iloc[-2], recent['patients'].iloc[-3], lag24,
+        recent['patients'].iloc[-6], recent['patients'].iloc[-12], recent['patients'].iloc[-18],
+        recent['patients'].tail(3).mean(), recent['patients'].tail(6).mean(), recent['patients'].tail(24).mean(),
+        recent['patients'].tail(12).mean(), recent['patients'].tail(18).mean(),
+        hour ** 2, hour * holiday, lag1 * lag24, 1 if 10 <= hour <= 16 else 0,
+        1 if month in [6, 7, 8, 9] else 0, 1 if month in [3, 4, 5] else 0, 1 if month in [10, 11, 12, 1, 2] else 0
+    ]
+
+
+def train_forest(rng):
+    from sklearn.ensemble import RandomForestRegressor
+    counts = rng.integers(15, 30, size=24 * 30)
+    start = datetime(2025, 9, 1)
+    rows = [pandas_features(counts[i - 24:i], start + timedelta(hours=i)) for i in range(24, len(counts))]
+    X = pd.DataFrame(rows, columns=FEATURES)
+    model = RandomForestRegressor(n_estimators=500, min_samples_split=5, min_samples_leaf=2,
+                                  random_state=42, n_jobs=-1)
+    model.fit(X, counts[24:])
+    return model, X
+
+
+def rate(fn, count, seconds=1.0):
+    """Calls per second of fn, each producing count predictions"""
+    fn()
+    calls, start = 0, time.perf_counter()
+    while time.perf_counter() - start < seconds:
+        fn()
+        calls += 1
+    return calls * count / (time.perf_counter() - start)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--model')
+    parser.add_argument('--series', type=int, default=200)
+    args = parser.parse_args()
+    rng = np.random.default_rng(1)
+
+    if args.model and os.path.exists(args.model):
+        model = joblib.load(args.model)
+        X = pd.DataFrame(rng.uniform(0, 60, size=(2000, model.n_features_in_)), columns=model.feature_names_in_)
+        source = args.model
+    else:
+        model, X = train_forest(rng)
+        source = 'trained on synthetic counts'
+    path = os.path.join(tempfile.mkdtemp(), 'model.forest')
+    trees, nodes = export(model, path)
+    forest = curalink_forest.Forest(path)
+    print(f'forest: {trees} trees, {nodes} nodes ({nodes * 12 / 1e6:.1f} MB of nodes), {source}')
+
+    # Exactness, sequential scikit-learn
+    model.set_params(n_jobs=1)
+    rows = np.ascontiguousarray(np.vstack([X.to_numpy(dtype=np.float64),
+                                           X.to_numpy(dtype=np.float64) + rng.normal(0, 0.5, X.shape)]))
+    reference = model.predict(pd.DataFrame(rows, columns=X.columns))
+    native = np.empty(len(rows))
+    forest.predict(rows, out=native)
+    exact = np.count_nonzero(reference.view(np.uint64) == native.view(np.uint64))
+    print(f'exact: {exact}/{len(rows)} predictions identical, max diff {np.max(np.abs(reference - native)):.3g}')
+
+    # Throughput
+    print(f'\n{"batch":>8} {"sklearn/s":>12} {"native/s":>12} {"speedup":>8}')
+    for batch in (1, 64, len(rows)):
+        part = rows[:batch]
+        frame = pd.DataFrame(part, columns=X.columns)
+        out = np.empty(batch)
+        sk = rate(lambda: model.predict(frame), batch)
+        nat = rate(lambda: forest.predict(part, out=out), batch)
+        print(f'{batch:>8} {sk:>12.0f} {nat:>12.0f} {nat / sk:>7.0f}x')
+
+    # Per-minute refresh: ward + beds
+    history = [rng.integers(15, 30, size=24).astype(np.int64) for _ in range(args.series + 1)]
+    when = datetime.now() + timedelta(hours=1)
+    series = [curalink_forest.Series(h.tolist()) for h in history]
+    frames = [pandas_features(h, when) for h in history]
+    mismatched = sum(1 for s, f in zip(series, frames)
+                     if s.features(when.weekday(), when.hour, when.month) != [float(v) for v in f])
+
+    def python_refresh():
+        return [model.predict(pd.DataFrame([pandas_features(h, when)], columns=FEATURES))[0] for h in history]
+
+    def native_refresh():
+        return forest.forecast(series, when.weekday(), when.hour, when.month)
+
+    same = np.array_equal(np.array(python_refresh()), np.array(native_refresh()))
+    start = time.perf_counter()
+    python_refresh()
+    python_s = time.perf_counter() - start
+    native_per_s = rate(native_refresh, 1)
+    print(f'\nrefresh of {len(history)} series: pandas+sklearn {python_s * 1e3:.0f} ms, '
+          f'native {1e3 / native_per_s:.2f} ms ({python_s * native_per_s:.0f}x); '
+          f'features equal: {len(history) - mismatched}/{len(history)}, predictions identical: {same}')
+
+
+if __name__ == '__main__':
+    main()
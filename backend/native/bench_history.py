@@ -0,0 +1,192 @@
+"""Native history store vs a full scan of bedHistory: size, ingest and queries
+
+Usage (after `python setup.py build_ext --inplace` in this directory):
+    python bench_history.py [--events 1000000] [--beds 60] [--wards 3] [--days 90]
+
+Generates bedHistory entries shaped like src/firebase/bedManager.js writes
+them (status changes from the controllers, assignments, overrides), pushes
+them into a fresh store and reports:
+  - the bedHistory JSON size against the store on disk
+  - ingest rate and the time to reopen the store
+  - per query: the store against what the dashboard does with the whole
+    node (json.loads, then filter and sort in memory), with the results
+    compared entry for entry
+"""
+
+import argparse
+import json
+import os
+import random
+import shutil
+import statistics
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import curalink_history  # noqa: E402
+
+STATUSES = ['unoccupied', 'occupied', 'cleaning', 'occupied_cleaning']
+HOUR = 3600000
+DAY = 24 * HOUR
+
+
+def generate(count, beds, wards, days, rng):
+    """bedHistory as the RTDB returns it: push key -> entry, in time order"""
+    end = 1760000000000
+    start = end - days * DAY
+    step = (end - start) // count
+    status = {f'bed{b}': 'unoccupied' for b in range(1, beds + 1)}
+    entries = {}
+    for i in range(count):
+        bed = f'bed{rng.randint(1, beds)}'
+        ts = start + i * step + rng.randrange(step)
+        roll = rng.random()
+        if roll < 0.9:
+            new = rng.choice([s for s in STATUSES if s != status[bed]])
+            action = 'status_change'
+            data = {'previousStatus': status[bed], 'newStatus': new, 'staffId': f'STAFF{rng.randint(1, 40):03d}',
+                    'source': 'hardware', 'details': f'{status[bed]} to {new}',
+                    'deviceTime': ts - rng.randint(50, 400), 'deviceMonoMs': rng.randint(0, 1 << 31)}
+            status[bed] = new
+        elif roll < 0.95:
+            action = 'patient_assigned'
+            data = {'patientName': f'Patient {rng.randint(1, 5000)}', 'patientId': f'P{rng.randint(1, 99999):05d}'}
+        elif roll < 0.98:
+            action = 'patient_unassigned'
+            data = {'reason': 'discharged', 'patientInfo': {'patientId': f'P{rng.randint(1, 99999):05d}'}}
+        else:
+            new = rng.choice(STATUSES)
+            action = 'supervisor_override'
+            data = {'previousStatus': status[bed], 'newStatus': new}
+            status[bed] = new
+        entries[f'-N{i:09d}'] = {'bedId': bed, 'action': action, 'data': data, 'timestamp': ts}
+    ward_of = {f'bed{b}': f'ward{(b - 1) % wards + 1}' for b in range(1, beds + 1)}
+    return entries, ward_of, start, end
+
+
+def row(entry):
+    """An entry as a store row (backend/app.py history_event)"""
+    data = entry['data']
+    text = lambda key: None if data.get(key) is None else str(data[key])
+    return (entry['timestamp'], entry['bedId'], entry['action'], text('previousStatus'), text('newStatus'),
+            text('staffId'), text('source'), json.dumps(data, separators=(',', ':')))
+
+
+def timed(fn, repeat):
+    times = []
+    for _ in range(repeat):
+        began = time.perf_counter()
+        result = fn()
+        times.append(time.perf_counter() - began)
+    return result, statistics.median(times)
+
+
+def directory_bytes(path):
+    return sum(os.path.getsize(os.path.join(path, name)) for name in os.listdir(path))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--events', type=int, default=1000000)
+    parser.add_argument('--beds', type=int, default=60)
+    parser.add_argument('--wards', type=int, default=3)
+    parser.add_argument('--days', type=int, default=90)
+    parser.add_argument('--repeat', type=int, default=5)
+    args = parser.parse_args()
+    rng = random.Random(7)
+
+    entries, ward_of, start, end = generate(args.events, args.beds, args.wards, args.days, rng)
+    node = json.dumps(entries)
+    directory = tempfile.mkdtemp(prefix='curalink_history_')
+    try:
+        store = curalink_history.Store(directory)
+        for bed, ward in ward_of.items():
+            store.set_ward(bed, ward)
+        rows = [row(e) for e in entries.values()]
+        # Controllers report late: arrival order is shuffled within 64 events
+        for i in range(0, len(rows), 64):
+            chunk = rows[i:i + 64]
+            rng.shuffle(chunk)
+            rows[i:i + 64] = chunk
+        began = time.perf_counter()
+        for i in range(0, len(rows), 10000):
+            store.append(rows[i:i + 10000])
+        store.flush()
+        ingest = time.perf_counter() - began
+        del store
+        began = time.perf_counter()
+        store = curalink_history.Store(directory)
+        reopen = time.perf_counter() - began
+        stats = store.stats()
+        print(f'{args.events} events, {args.beds} beds, {args.wards} wards, {args.days} days')
+        print(f'bedHistory JSON {len(node) / 1e6:.1f} MB, store {directory_bytes(directory) / 1e6:.1f} MB '
+              f'({stats["blocks"]} blocks in {stats["partitions"]} partitions, '
+              f'columns {stats["raw_bytes"] / 1e6:.1f} MB before deflate)')
+        print(f'ingest {args.events / ingest:,.0f} events/s, reopen {reopen * 1e3:.0f} ms')
+
+        _, parse = timed(lambda: json.loads(node), 1)
+        everything = list(json.loads(node).values())
+        week = end - 7 * DAY
+        day_start = end - 3 * DAY
+        ward_beds = {b for b, w in ward_of.items() if w == 'ward1'}
+        newest = lambda items, limit=None: sorted(items, key=lambda e: -e['timestamp'])[:limit]
+        oldest = lambda items: sorted(items, key=lambda e: e['timestamp'])
+
+        def tally(items, bucket, key):
+            counts = {}
+            for e in items:
+                k = ((e['timestamp'] // bucket) * bucket, key(e))
+                counts[k] = counts.get(k, 0) + 1
+            return sorted(counts.items())
+
+        queries = [
+            ('latest 500, all beds',
+             lambda: [row(e) for e in newest(everything, 500)],
+             lambda: store.range(limit=500)),
+            ('latest 100, one bed',
+             lambda: [row(e) for e in newest([e for e in everything if e['bedId'] == 'bed7'], 100)],
+             lambda: store.range(beds='bed7', limit=100)),
+            ('one bed, one day, oldest first',
+             lambda: [row(e) for e in oldest([e for e in everything if e['bedId'] == 'bed7'
+                                              and day_start <= e['timestamp'] < day_start + DAY])],
+             lambda: store.range(beds='bed7', start=day_start, end=day_start + DAY, newest_first=False)),
+            ('ward, 7 days, to occupied',
+             lambda: [row(e) for e in newest([e for e in everything if e['bedId'] in ward_beds
+                                              and e['timestamp'] >= week
+                                              and e['data'].get('newStatus') == 'occupied'])],
+             lambda: store.range(ward='ward1', start=week, status='occupied')),
+            ('per hour by status, ward, 7 days',
+             lambda: tally([e for e in everything if e['bedId'] in ward_beds and e['timestamp'] >= week],
+                           HOUR, lambda e: e['data'].get('newStatus') or ''),
+             lambda: store.count(HOUR, group='status', ward='ward1', start=week)),
+            (f'per day by action, all, {args.days} days',
+             lambda: tally(everything, DAY, lambda e: e['action']),
+             lambda: store.count(DAY, group='action')),
+            (f'per hour by bed, all, {args.days} days',
+             lambda: tally(everything, HOUR, lambda e: e['bedId']),
+             lambda: store.count(HOUR, group='bed')),
+        ]
+
+        print(f'\nfull scan: json.loads of the whole node {parse * 1e3:.0f} ms, then per query:')
+        print(f'{"query":<38} {"rows":>7} {"scan ms":>9} {"+parse":>9} {"store ms":>9} {"speedup":>8} {"equal":>6}')
+        all_equal = True
+        for name, scan, native in queries:
+            expected, scan_s = timed(scan, max(1, args.repeat // 2))
+            got, native_s = timed(native, args.repeat)
+            if isinstance(got[0] if got else None, tuple) and len(got[0]) == 3:
+                got = sorted(((s, k or ''), c) for s, k, c in got)
+            equal = got == expected
+            all_equal &= equal
+            print(f'{name:<38} {len(got):>7} {scan_s * 1e3:>9.1f} {(scan_s + parse) * 1e3:>9.0f} '
+                  f'{native_s * 1e3:>9.2f} {(scan_s + parse) / native_s:>7.0f}x {"yes" if equal else "NO":>6}')
+        stats = store.stats()
+        print(f'\nblocks read {stats["blocks_read"]}, skipped by time index {stats["blocks_skipped"]}')
+        if not all_equal:
+            sys.exit(1)
+    finally:
+        shutil.rmtree(directory, ignore_errors=True)
+
+
+if __name__ == '__main__':
+    main()
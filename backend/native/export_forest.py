@@ -0,0 +1,103 @@
+"""Flatten a trained random forest into the .forest file read by flatForest.h
+
+Usage:
+    python export_forest.py ../rf_best_model.joblib ../rf_best_model.forest
+
+Accepts a fitted RandomForestRegressor or ExtraTreesRegressor (single
+output). Trees are renumbered breadth-first so that the two children of a
+node sit next to each other and traversal picks one with `child + (x > t)`.
+
+Layout (little-endian):
+    header   b"CLRF", version, n_features, n_trees, n_nodes, n_values,
+             names_bytes (uint32 each)
+    names    feature names, "\\n"-joined UTF-8, names_bytes long
+    roots    uint32 x n_trees
+    nodes    (float32 threshold, uint32 feature, uint32 child) x n_nodes;
+             leaves have feature = 0xFFFFFFFF and child = index into values
+    values   float64 x n_values, the leaf predictions
+
+scikit-learn compares a float32 feature against a float64 threshold. For a
+float32 x, x <= t holds exactly when x <= t rounded down to float32, so the
+thresholds are stored that way and inference matches scikit-learn bit for bit.
+"""
+
+import struct
+import sys
+
+import joblib
+import numpy as np
+
+MAGIC = b'CLRF'
+VERSION = 1
+LEAF = 0xFFFFFFFF
+
+
+def float32_floor(values):
+    """Largest float32 not above each float64 value"""
+    rounded = values.astype(np.float32)
+    above = rounded.astype(np.float64) > values
+    rounded[above] = np.nextafter(rounded[above], np.float32(-np.inf))
+    return rounded
+
+
+def flatten_tree(tree, node_base, value_base):
+    """Breadth-first nodes of one tree: (threshold, feature, child) arrays and leaf values"""
+    order = [0]
+    thresholds, features, children, values = [], [], [], []
+    floors = float32_floor(tree.threshold)
+    i = 0
+    while i < len(order):
+        node = order[i]
+        left, right = tree.children_left[node], tree.children_right[node]
+        if left == -1:
+            thresholds.append(np.float32(0))
+            features.append(LEAF)
+            children.append(value_base + len(values))
+            values.append(float(tree.value[node][0][0]))
+        else:
+            thresholds.append(floors[node])
+            features.append(int(tree.feature[node]))
+            children.append(node_base + len(order))
+            order += [left, right]
+        i += 1
+    return thresholds, features, children, values
+
+
+def export(model, path):
+    estimators = getattr(model, 'estimators_', None)
+    if estimators is None or getattr(model, 'n_outputs_', 1) != 1:
+        raise ValueError('expected a fitted single-output forest regressor')
+    names = [str(n) for n in getattr(model, 'feature_names_in_', [])]
+    if not names:
+        names = [f'f{i}' for i in range(model.n_features_in_)]
+
+    roots, thresholds, features, children, values = [], [], [], [], []
+    for estimator in estimators:
+        roots.append(len(thresholds))
+        t, f, c, v = flatten_tree(estimator.tree_, len(thresholds), len(values))
+        thresholds += t
+        features += f
+        children += c
+        values += v
+
+    name_bytes = '\n'.join(names).encode('utf-8')
+    nodes = np.zeros(len(thresholds), dtype=[('threshold', '<f4'), ('feature', '<u4'), ('child', '<u4')])
+    nodes['threshold'] = thresholds
+    nodes['feature'] = features
+    nodes['child'] = children
+    with open(path, 'wb') as f:
+        f.write(MAGIC)
+        f.write(struct.pack('<6I', VERSION, len(names), len(roots), len(nodes), len(values), len(name_bytes)))
+        f.write(name_bytes)
+        f.write(np.asarray(roots, dtype='<u4').tobytes())
+        f.write(nodes.tobytes())
+        f.write(np.asarray(values, dtype='<f8').tobytes())
+    return len(roots), len(nodes)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        print(__doc__)
+        sys.exit(1)
+    trees, nodes = export(joblib.load(sys.argv[1]), sys.argv[2])
+    print(f'{trees} trees, {nodes} nodes -> {sys.argv[2]}')
@@ -0,0 +1,196 @@
+#ifndef CURALINK_FLAT_FOREST_H
+#define CURALINK_FLAT_FOREST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Random-forest regressor inference over the flat node arrays written by
+// export_forest.py. Predictions are bit-identical to scikit-learn's
+// RandomForestRegressor.predict with n_jobs=1: features are rounded to
+// float32, every tree's leaf value is added in tree order starting from 0.0,
+// and the sum is divided by the tree count.
+// - All trees share one contiguous node array (12 bytes per node). The two
+//   children of a node are adjacent, so a step is
+//   `node = child + (x[feature] > threshold)` with no branch on the direction.
+// - Leaves are rewritten at load into nodes that step to themselves
+//   (threshold +inf), so a tree is walked for exactly its depth with no leaf
+//   test either.
+// - predict() takes rows in blocks and walks each tree for the whole block
+//   before moving on: the tree's nodes stay in cache and the independent
+//   walks of a block overlap their memory latency. A single row instead
+//   stops at its leaf, which beats walking to the deepest one.
+
+#define FOREST_MAGIC        "CLRF"
+#define FOREST_VERSION      1
+#define FOREST_LEAF         0xFFFFFFFFu
+#define FOREST_BLOCK        32      // Rows walked together
+
+class FlatForest {
+public:
+    struct Node {
+        float threshold;
+        uint32_t feature;
+        uint32_t child;     // Left child; the right one follows it
+    };
+
+    // False with error() set if the file is missing or malformed
+    bool load(const char* path) {
+        FILE* f = fopen(path, "rb");
+        if (f == nullptr) {
+            return fail(std::string("cannot open ") + path);
+        }
+        bool ok = read(f);
+        fclose(f);
+        return ok;
+    }
+
+    // rows: count x features(), row-major; out: one prediction per row
+    template<typename T>
+    void predict(const T* rows, size_t count, double* out) const {
+        size_t width = featureNames.size();
+        std::vector<float> x(FOREST_BLOCK * width);
+        for (size_t first = 0; first < count; first += FOREST_BLOCK) {
+            size_t n = count - first < FOREST_BLOCK ? count - first : FOREST_BLOCK;
+            for (size_t i = 0; i < n * width; i++) {
+                x[i] = (float)rows[first * width + i];
+            }
+            predictBlock(x.data(), n, out + first);
+        }
+    }
+
+    size_t features() const { return featureNames.size(); }
+    size_t trees() const { return roots.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+    const std::vector<std::string>& names() const { return featureNames; }
+    const std::string& error() const { return lastError; }
+
+private:
+    void predictBlock(const float* x, size_t n, double* out) const {
+        size_t width = featureNames.size();
+        double sums[FOREST_BLOCK];
+        uint32_t at[FOREST_BLOCK];
+        for (size_t r = 0; r < n; r++) {
+            sums[r] = 0.0;
+        }
+        const Node* base = nodes.data();
+        for (size_t t = 0; t < roots.size(); t++) {
+            for (size_t r = 0; r < n; r++) {
+                at[r] = roots[t];
+            }
+            if (n == 1) {
+                // A lone row stops at its leaf rather than the tree's deepest one
+                for (uint32_t next = at[0];;) {
+                    const Node& node = base[next];
+                    next = node.child + (x[node.feature] > node.threshold);
+                    if (next == at[0]) break;
+                    at[0] = next;
+                }
+            } else {
+                for (uint32_t d = 0; d < depths[t]; d++) {
+                    for (size_t r = 0; r < n; r++) {
+                        const Node& node = base[at[r]];
+                        at[r] = node.child + (x[r * width + node.feature] > node.threshold);
+                    }
+                }
+            }
+            for (size_t r = 0; r < n; r++) {
+                sums[r] += values[at[r]];
+            }
+        }
+        for (size_t r = 0; r < n; r++) {
+            out[r] = sums[r] / (double)roots.size();
+        }
+    }
+
+    bool read(FILE* f) {
+        char magic[4];
+        uint32_t header[6];
+        if (fread(magic, 1, 4, f) != 4 || memcmp(magic, FOREST_MAGIC, 4) != 0 ||
+            fread(header, sizeof(uint32_t), 6, f) != 6) {
+            return fail("not a forest file");
+        }
+        if (header[0] != FOREST_VERSION) {
+            return fail("unsupported forest version");
+        }
+        uint32_t featureCount = header[1], treeCount = header[2], nodeTotal = header[3];
+        uint32_t valueTotal = header[4], nameBytes = header[5];
+        if (featureCount == 0 || treeCount == 0) {
+            return fail("empty forest");
+        }
+
+        std::string joined(nameBytes, '\0');
+        std::vector<uint32_t> stored(nodeTotal * 3);
+        std::vector<double> leafValues(valueTotal);
+        roots.resize(treeCount);
+        if (fread(&joined[0], 1, nameBytes, f) != nameBytes ||
+            fread(roots.data(), sizeof(uint32_t), treeCount, f) != treeCount ||
+            fread(stored.data(), sizeof(uint32_t), stored.size(), f) != stored.size() ||
+            fread(leafValues.data(), sizeof(double), valueTotal, f) != valueTotal) {
+            return fail("truncated forest file");
+        }
+        featureNames.clear();
+        for (size_t start = 0; start <= joined.size();) {
+            size_t end = joined.find('\n', start);
+            if (end == std::string::npos) end = joined.size();
+            featureNames.push_back(joined.substr(start, end - start));
+            start = end + 1;
+        }
+        if (featureNames.size() != featureCount) {
+            return fail("feature names do not match the feature count");
+        }
+
+        // Leaves step to themselves and keep their value by node index
+        nodes.resize(nodeTotal);
+        values.assign(nodeTotal, 0.0);
+        for (uint32_t i = 0; i < nodeTotal; i++) {
+            Node& node = nodes[i];
+            memcpy(&node.threshold, &stored[i * 3], sizeof(float));
+            node.feature = stored[i * 3 + 1];
+            node.child = stored[i * 3 + 2];
+            if (node.feature == FOREST_LEAF) {
+                if (node.child >= valueTotal) return fail("leaf value out of range");
+                values[i] = leafValues[node.child];
+                node.threshold = std::numeric_limits<float>::infinity();
+                node.feature = 0;
+                node.child = i;
+            } else if (node.feature >= featureCount || node.child + 1 >= nodeTotal || node.child <= i) {
+                return fail("malformed node");
+            }
+        }
+
+        // Depth of each tree: children come after their parent (breadth-first)
+        depths.assign(treeCount, 0);
+        std::vector<uint32_t> level(nodeTotal, 0);
+        for (uint32_t t = 0; t < treeCount; t++) {
+            uint32_t end = t + 1 < treeCount ? roots[t + 1] : nodeTotal;
+            if (roots[t] >= end) return fail("malformed tree");
+            for (uint32_t i = roots[t]; i < end; i++) {
+                if (nodes[i].child != i) {
+                    if (nodes[i].child + 1 >= end) return fail("node outside its tree");
+                    level[nodes[i].child] = level[nodes[i].child + 1] = level[i] + 1;
+                } else if (level[i] > depths[t]) {
+                    depths[t] = level[i];
+                }
+            }
+        }
+        return true;
+    }
+
+    bool fail(const std::string& message) {
+        lastError = message;
+        return false;
+    }
+
+    std::vector<Node> nodes;
+    std::vector<double> values;         // Leaf value per node index
+    std::vector<uint32_t> roots;
+    std::vector<uint32_t> depths;       // Steps from the root to the deepest leaf
+    std::vector<std::string> featureNames;
+    std::string lastError;
+};
+
+#endif
@@ -0,0 +1,372 @@
+// Python extension module curalink_history: the bed history store
+// (historyStore.h) for backend/app.py.
+//
+//   store = curalink_history.Store("history_data")
+//   store.set_ward("bed1", "ward1")
+//   store.append([(ts_ms, bed, action, previous, status, staff, source, payload), ...])
+//   store.range(beds=["bed1"], start=t0, end=t1, status="occupied", limit=100)
+//   store.count(3600000, group="status", ward="ward1", start=t0, end=t1)
+//
+// range() returns (ts_ms, bed, action, previous, status, staff, source,
+// payload) tuples, newest first unless newest_first=False; count() returns
+// (bucket_start_ms, key, count) tuples with key the status, action or bed.
+// Missing strings are None; payload is the rest of the event as JSON text.
+// Build: python setup.py build_ext --inplace
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "historyStore.h"
+
+// ------------------ Store ------------------
+
+struct StoreObject {
+    PyObject_HEAD
+    HistoryStore* store;
+};
+
+static int Store_init(StoreObject* self, PyObject* args, PyObject*) {
+    const char* path;
+    if (!PyArg_ParseTuple(args, "s", &path)) {
+        return -1;
+    }
+    delete self->store;
+    self->store = new HistoryStore();
+    if (!self->store->open(path)) {
+        PyErr_SetString(PyExc_OSError, self->store->error().c_str());
+        delete self->store;
+        self->store = nullptr;
+        return -1;
+    }
+    return 0;
+}
+
+static void Store_dealloc(StoreObject* self) {
+    delete self->store;
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static bool opened(StoreObject* self) {
+    if (self->store == nullptr) {
+        PyErr_SetString(PyExc_ValueError, "store not open");
+        return false;
+    }
+    return true;
+}
+
+static PyObject* storeError(StoreObject* self) {
+    PyErr_SetString(PyExc_OSError, self->store->error().c_str());
+    return nullptr;
+}
+
+// str (or None for empty) as a dictionary id
+static bool internText(HistoryStore& store, PyObject* item, uint32_t& id) {
+    if (item == Py_None) {
+        id = 0;
+        return true;
+    }
+    Py_ssize_t length;
+    const char* text = PyUnicode_AsUTF8AndSize(item, &length);
+    if (text == nullptr) {
+        return false;
+    }
+    id = store.intern(std::string(text, (size_t)length));
+    return true;
+}
+
+static PyObject* Store_set_ward(StoreObject* self, PyObject* args) {
+    PyObject* bed;
+    PyObject* ward;
+    if (!opened(self) || !PyArg_ParseTuple(args, "UU", &bed, &ward)) {
+        return nullptr;
+    }
+    uint32_t bedId, wardId;
+    if (!internText(*self->store, bed, bedId) || !internText(*self->store, ward, wardId)) {
+        return nullptr;
+    }
+    self->store->setWard(bedId, wardId);
+    Py_RETURN_NONE;
+}
+
+// Events in the order they happened; returns how many were stored
+static PyObject* Store_append(StoreObject* self, PyObject* events) {
+    if (!opened(self)) {
+        return nullptr;
+    }
+    PyObject* items = PySequence_Fast(events, "events must be a sequence of tuples");
+    if (items == nullptr) {
+        return nullptr;
+    }
+    HistoryStore& store = *self->store;
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(items);
+    Py_ssize_t stored = 0;
+    for (; stored < count; stored++) {
+        PyObject* item = PySequence_Fast_GET_ITEM(items, stored);
+        if (!PyTuple_Check(item) || PyTuple_GET_SIZE(item) != 8) {
+            PyErr_SetString(PyExc_ValueError,
+                            "an event is (ts_ms, bed, action, previous, status, staff, source, payload)");
+            break;
+        }
+        HistoryEvent e;
+        e.tsMs = PyLong_AsLongLong(PyTuple_GET_ITEM(item, 0));
+        Py_ssize_t length;
+        const char* payload = PyTuple_GET_ITEM(item, 7) == Py_None
+                                  ? ""
+                                  : PyUnicode_AsUTF8AndSize(PyTuple_GET_ITEM(item, 7), &length);
+        if ((e.tsMs == -1 && PyErr_Occurred()) || payload == nullptr ||
+            !internText(store, PyTuple_GET_ITEM(item, 1), e.bed) ||
+            !internText(store, PyTuple_GET_ITEM(item, 2), e.action) ||
+            !internText(store, PyTuple_GET_ITEM(item, 3), e.previous) ||
+            !internText(store, PyTuple_GET_ITEM(item, 4), e.status) ||
+            !internText(store, PyTuple_GET_ITEM(item, 5), e.staff) ||
+            !internText(store, PyTuple_GET_ITEM(item, 6), e.source)) {
+            break;
+        }
+        if (*payload != '\0') {
+            e.payload.assign(payload, (size_t)length);
+        }
+        if (!store.append(std::move(e))) {
+            storeError(self);
+            break;
+        }
+    }
+    Py_DECREF(items);
+    // Whatever was appended is kept, even when a later event was rejected
+    if (!store.commit() && !PyErr_Occurred()) {
+        return storeError(self);
+    }
+    return PyErr_Occurred() ? nullptr : PyLong_FromSsize_t(stored);
+}
+
+// Filters shared by range() and count(); `empty` when no event can match
+// (a status, action or ward the store has never seen, or no known bed)
+static bool parseQuery(StoreObject* self, PyObject* beds, PyObject* ward, PyObject* action, PyObject* status,
+                       HistoryQuery& q, bool& empty) {
+    HistoryStore& store = *self->store;
+    empty = false;
+    auto known = [&](PyObject* item, uint32_t& id) {
+        const char* text = PyUnicode_AsUTF8(item);
+        if (text == nullptr) {
+            return false;
+        }
+        if (!store.lookup(text, id)) empty = true;
+        return true;
+    };
+    if (action != nullptr && action != Py_None && !known(action, q.action)) {
+        return false;
+    }
+    if (status != nullptr && status != Py_None && !known(status, q.status)) {
+        return false;
+    }
+    std::vector<uint32_t> wardBeds;
+    bool byWard = ward != nullptr && ward != Py_None;
+    if (byWard) {
+        uint32_t wardId;
+        if (!known(ward, wardId)) {
+            return false;
+        }
+        if (!empty) wardBeds = store.bedsInWard(wardId);
+        if (wardBeds.empty()) empty = true;
+    }
+    if (beds != nullptr && beds != Py_None) {
+        PyObject* items = PyUnicode_Check(beds) ? PyTuple_Pack(1, beds)
+                                                : PySequence_Fast(beds, "beds must be a bed id or a sequence of them");
+        if (items == nullptr) {
+            return false;
+        }
+        for (Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(items); i++) {
+            const char* name = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(items, i));
+            if (name == nullptr) {
+                Py_DECREF(items);
+                return false;
+            }
+            // An unknown bed, or one outside the ward, only drops itself
+            uint32_t bedId;
+            if (store.lookup(name, bedId) &&
+                (!byWard || std::find(wardBeds.begin(), wardBeds.end(), bedId) != wardBeds.end())) {
+                q.beds.push_back(bedId);
+            }
+        }
+        Py_DECREF(items);
+        if (q.beds.empty()) empty = true;
+    } else {
+        q.beds = wardBeds;
+    }
+    return true;
+}
+
+// None for the empty string, as append() takes it
+static PyObject* text(HistoryStore& store, uint32_t id) {
+    if (id == 0) {
+        Py_RETURN_NONE;
+    }
+    const std::string& value = store.text(id);
+    return PyUnicode_DecodeUTF8(value.data(), (Py_ssize_t)value.size(), "replace");
+}
+
+static PyObject* Store_range(StoreObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"beds", "ward", "start", "end", "action", "status", "limit", "newest_first",
+                                     nullptr};
+    PyObject* beds = nullptr;
+    PyObject* ward = nullptr;
+    PyObject* action = nullptr;
+    PyObject* status = nullptr;
+    HistoryQuery q;
+    long long start = q.fromMs, end = q.toMs;
+    Py_ssize_t limit = 0;
+    int newestFirst = 1;
+    if (!opened(self) || !PyArg_ParseTupleAndKeywords(args, kwargs, "|OOLLOOnp", (char**)keywords, &beds, &ward,
+                                                      &start, &end, &action, &status, &limit, &newestFirst)) {
+        return nullptr;
+    }
+    bool empty;
+    if (!parseQuery(self, beds, ward, action, status, q, empty)) {
+        return nullptr;
+    }
+    if (empty) {
+        return PyList_New(0);
+    }
+    q.fromMs = start;
+    q.toMs = end;
+    q.limit = limit > 0 ? (size_t)limit : 0;
+    q.newestFirst = newestFirst != 0;
+
+    HistoryStore& store = *self->store;
+    std::vector<HistoryEvent> events;
+    store.range(q, events);
+    PyObject* list = PyList_New((Py_ssize_t)events.size());
+    for (size_t i = 0; i < events.size(); i++) {
+        const HistoryEvent& e = events[i];
+        PyList_SET_ITEM(list, i,
+                        Py_BuildValue("(LNNNNNNN)", (long long)e.tsMs, text(store, e.bed), text(store, e.action),
+                                      text(store, e.previous), text(store, e.status), text(store, e.staff),
+                                      text(store, e.source),
+                                      PyUnicode_DecodeUTF8(e.payload.data(), (Py_ssize_t)e.payload.size(),
+                                                           "replace")));
+    }
+    return list;
+}
+
+static PyObject* Store_count(StoreObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"bucket_ms", "group", "beds", "ward", "start", "end", "action", "status",
+                                     nullptr};
+    long long bucketMs;
+    const char* groupName = "status";
+    PyObject* beds = nullptr;
+    PyObject* ward = nullptr;
+    PyObject* action = nullptr;
+    PyObject* status = nullptr;
+    HistoryQuery q;
+    long long start = q.fromMs, end = q.toMs;
+    if (!opened(self) || !PyArg_ParseTupleAndKeywords(args, kwargs, "L|sOOLLOO", (char**)keywords, &bucketMs,
+                                                      &groupName, &beds, &ward, &start, &end, &action, &status)) {
+        return nullptr;
+    }
+    HistoryGroup group;
+    if (strcmp(groupName, "status") == 0) {
+        group = GROUP_STATUS;
+    } else if (strcmp(groupName, "action") == 0) {
+        group = GROUP_ACTION;
+    } else if (strcmp(groupName, "bed") == 0) {
+        group = GROUP_BED;
+    } else {
+        PyErr_SetString(PyExc_ValueError, "group must be status, action or bed");
+        return nullptr;
+    }
+    if (bucketMs <= 0) {
+        PyErr_SetString(PyExc_ValueError, "bucket_ms must be positive");
+        return nullptr;
+    }
+    bool empty;
+    if (!parseQuery(self, beds, ward, action, status, q, empty)) {
+        return nullptr;
+    }
+    if (empty) {
+        return PyList_New(0);
+    }
+    q.fromMs = start;
+    q.toMs = end;
+
+    HistoryStore& store = *self->store;
+    std::vector<HistoryCount> counts;
+    store.count(q, bucketMs, group, counts);
+    PyObject* list = PyList_New((Py_ssize_t)counts.size());
+    for (size_t i = 0; i < counts.size(); i++) {
+        PyList_SET_ITEM(list, i, Py_BuildValue("(LNK)", (long long)counts[i].bucketMs, text(store, counts[i].key),
+                                               (unsigned long long)counts[i].count));
+    }
+    return list;
+}
+
+static PyObject* Store_flush(StoreObject* self, PyObject*) {
+    if (!opened(self)) {
+        return nullptr;
+    }
+    if (!self->store->flush()) {
+        return storeError(self);
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* Store_stats(StoreObject* self, PyObject*) {
+    if (!opened(self)) {
+        return nullptr;
+    }
+    HistoryStats s = self->store->stats();
+    return Py_BuildValue("{s:K,s:K,s:n,s:K,s:K,s:K,s:K,s:K,s:K,s:K}",
+                         "events", (unsigned long long)s.events,
+                         "sealed_events", (unsigned long long)s.sealedEvents,
+                         "beds", (Py_ssize_t)self->store->bedCount(),
+                         "blocks", (unsigned long long)s.blocks,
+                         "partitions", (unsigned long long)s.partitions,
+                         "disk_bytes", (unsigned long long)s.diskBytes,
+                         "raw_bytes", (unsigned long long)s.rawBytes,
+                         "log_bytes", (unsigned long long)s.logBytes,
+                         "blocks_read", (unsigned long long)s.blocksRead,
+                         "blocks_skipped", (unsigned long long)s.blocksSkipped);
+}
+
+static PyMethodDef StoreMethods[] = {
+    {"set_ward", (PyCFunction)Store_set_ward, METH_VARARGS, "set_ward(bed, ward): ward used by ward= filters"},
+    {"append", (PyCFunction)Store_append, METH_O,
+     "append(events): (ts_ms, bed, action, previous, status, staff, source, payload) tuples"},
+    {"range", (PyCFunction)(void (*)(void))Store_range, METH_VARARGS | METH_KEYWORDS,
+     "range(beds=None, ward=None, start=None, end=None, action=None, status=None, limit=0, newest_first=True)"},
+    {"count", (PyCFunction)(void (*)(void))Store_count, METH_VARARGS | METH_KEYWORDS,
+     "count(bucket_ms, group='status', beds=None, ward=None, start=None, end=None, action=None, status=None)"},
+    {"flush", (PyCFunction)Store_flush, METH_NOARGS, "flush(): seal every bed's pending events"},
+    {"stats", (PyCFunction)Store_stats, METH_NOARGS, "stats(): event, block and byte counts"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyTypeObject StoreType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+// ------------------ Module ------------------
+
+static PyModuleDef HistoryModule = {
+    PyModuleDef_HEAD_INIT, "curalink_history", "Native bed history store", -1, nullptr
+};
+
+PyMODINIT_FUNC PyInit_curalink_history() {
+    StoreType.tp_name = "curalink_history.Store";
+    StoreType.tp_basicsize = sizeof(StoreObject);
+    StoreType.tp_flags = Py_TPFLAGS_DEFAULT;
+    StoreType.tp_doc = "Store(path): bed history, columnar and indexed by bed and day";
+    StoreType.tp_new = PyType_GenericNew;
+    StoreType.tp_init = (initproc)Store_init;
+    StoreType.tp_dealloc = (destructor)Store_dealloc;
+    StoreType.tp_methods = StoreMethods;
+
+    if (PyType_Ready(&StoreType) < 0) {
+        return nullptr;
+    }
+    PyObject* module = PyModule_Create(&HistoryModule);
+    if (module == nullptr) {
+        return nullptr;
+    }
+    Py_INCREF(&StoreType);
+    PyModule_AddObject(module, "Store", (PyObject*)&StoreType);
+    return module;
+}
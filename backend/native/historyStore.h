@@ -0,0 +1,946 @@
+#ifndef CURALINK_HISTORY_STORE_H
+#define CURALINK_HISTORY_STORE_H
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Bed history (status changes, assignments, overrides) for backend/app.py,
+// kept per bed and per UTC day so a query reads the blocks it needs instead
+// of the whole bedHistory node.
+// - Events go to a write-ahead log and to their bed's in-memory tail. A full
+//   tail (HISTORY_BLOCK_ROWS) is sorted by time and sealed into one block per
+//   day, appended to b<B>_<day>.col and indexed in b<B>_<day>.idx (B: the
+//   bed's dictionary id; offset, size, rows, time range, last sequence
+//   number per block). Files are only ever appended to.
+// - A block stores each field as its own column: times as varint deltas, the
+//   repeating strings (action, statuses, staff, source) as dictionary ids,
+//   and the rest of the event as a JSON payload. Each column is deflated on
+//   its own, so counting by status inflates two small columns per block.
+// - Queries pick partitions by day, skip blocks outside the time range and
+//   decode only the columns they filter, group or return.
+// - open() reads the dictionary and indexes and replays the log past each
+//   bed's last sealed sequence number; a torn last record is dropped. Once
+//   every tail is sealed (flush(), or when the log outgrows
+//   HISTORY_LOG_BYTES) the log starts again empty.
+// Not thread-safe; the Python module holds the GIL across calls.
+
+#define HISTORY_BLOCK_ROWS  4096
+#define HISTORY_DAY_MS      86400000LL
+#define HISTORY_LOG_BYTES   (8u << 20)      // Log size that seals every tail
+#define HISTORY_BLOCK_MAGIC 0x31424843u     // "CHB1"
+#define HISTORY_LOG_MAGIC   0x314C4843u     // "CHL1"
+#define HISTORY_ANY         0xFFFFFFFFu     // Query filter: any value
+#define HISTORY_STRING_MAX  65535           // Longest dictionary string or payload
+#define HISTORY_DENSE_CELLS (1u << 22)      // count(): largest dense buckets x keys table
+
+enum HistoryColumn : uint8_t {
+    HISTORY_TIME,
+    HISTORY_ACTION,
+    HISTORY_PREVIOUS,
+    HISTORY_STATUS,
+    HISTORY_STAFF,
+    HISTORY_SOURCE,
+    HISTORY_PAYLOAD,
+    HISTORY_COLUMNS
+};
+
+enum HistoryGroup : uint8_t {
+    GROUP_STATUS,
+    GROUP_ACTION,
+    GROUP_BED
+};
+
+// Strings are dictionary ids (0: empty)
+struct HistoryEvent {
+    int64_t tsMs = 0;
+    uint64_t seq = 0;
+    uint32_t bed = 0;
+    uint32_t action = 0;
+    uint32_t previous = 0;
+    uint32_t status = 0;
+    uint32_t staff = 0;
+    uint32_t source = 0;
+    std::string payload;
+};
+
+// One sealed block; also the .idx record
+struct HistoryBlockRef {
+    uint64_t offset;
+    uint32_t bytes;
+    uint32_t rows;
+    int64_t minTs;
+    int64_t maxTs;
+    uint64_t maxSeq;
+};
+
+struct HistoryBlockHeader {
+    uint32_t magic;
+    uint32_t rows;
+    int64_t minTs;
+    uint32_t packed[HISTORY_COLUMNS];   // Deflated bytes per column
+    uint32_t raw[HISTORY_COLUMNS];      // Inflated bytes per column
+};
+
+struct HistoryQuery {
+    int64_t fromMs = std::numeric_limits<int64_t>::min();   // Inclusive
+    int64_t toMs = std::numeric_limits<int64_t>::max();     // Exclusive
+    std::vector<uint32_t> beds;         // Empty: every bed
+    uint32_t action = HISTORY_ANY;
+    uint32_t status = HISTORY_ANY;
+    size_t limit = 0;                   // range(): 0 for all
+    bool newestFirst = true;
+};
+
+struct HistoryCount {
+    int64_t bucketMs;                   // Bucket start
+    uint32_t key;                       // Status or action id, or bed id
+    uint64_t count;
+};
+
+struct HistoryStats {
+    uint64_t events;
+    uint64_t sealedEvents;
+    uint64_t blocks;
+    uint64_t partitions;
+    uint64_t diskBytes;                 // Sealed blocks
+    uint64_t rawBytes;                  // The same columns before deflate
+    uint64_t logBytes;
+    uint64_t blocksRead;                // By queries since open
+    uint64_t blocksSkipped;
+};
+
+inline void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+inline bool getVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// FNV-1a, for log records
+inline uint32_t historyChecksum(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+class HistoryStore {
+    static_assert(sizeof(HistoryBlockRef) == 40, "HistoryBlockRef is the .idx record layout");
+
+public:
+    ~HistoryStore() { close(); }
+
+    // Creates the directory if needed. False with error() set on failure.
+    bool open(const std::string& directory) {
+        close();
+        root = directory;
+        mkdir(root.c_str(), 0755);
+        struct stat info;
+        if (stat(root.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+            return fail("cannot create " + root);
+        }
+        strings.assign(1, std::string());
+        ids.clear();
+        ids[std::string()] = 0;
+        beds.clear();
+        readCounters = {};
+        return loadStrings() && loadWards() && loadIndexes() && replayLog();
+    }
+
+    // Seals every tail and closes the files
+    void close() {
+        if (log != nullptr) {
+            flush();
+            fclose(log);
+            log = nullptr;
+        }
+        if (stringFile != nullptr) {
+            fclose(stringFile);
+            stringFile = nullptr;
+        }
+        if (wardFile != nullptr) {
+            fclose(wardFile);
+            wardFile = nullptr;
+        }
+    }
+
+    // Dictionary id of a string, added if new
+    uint32_t intern(const std::string& text) {
+        auto found = ids.find(text);
+        if (found != ids.end()) {
+            return found->second;
+        }
+        std::string value = text.size() > HISTORY_STRING_MAX ? text.substr(0, HISTORY_STRING_MAX) : text;
+        uint16_t length = (uint16_t)value.size();
+        fwrite(&length, sizeof(length), 1, stringFile);
+        fwrite(value.data(), 1, value.size(), stringFile);
+        fflush(stringFile);
+        uint32_t id = (uint32_t)strings.size();
+        strings.push_back(value);
+        ids[value] = id;
+        return id;
+    }
+
+    // Id of a known string; false if it was never stored
+    bool lookup(const std::string& text, uint32_t& id) const {
+        auto found = ids.find(text);
+        if (found == ids.end()) {
+            return false;
+        }
+        id = found->second;
+        return true;
+    }
+
+    const std::string& text(uint32_t id) const { return id < strings.size() ? strings[id] : strings[0]; }
+
+    // Ward a bed belongs to (both dictionary ids); kept across restarts
+    void setWard(uint32_t bed, uint32_t ward) {
+        Bed& b = beds[bed];
+        if (b.ward == ward) {
+            return;
+        }
+        b.ward = ward;
+        uint32_t record[2] = {bed, ward};
+        fwrite(record, sizeof(uint32_t), 2, wardFile);
+        fflush(wardFile);
+    }
+
+    std::vector<uint32_t> bedsInWard(uint32_t ward) const {
+        std::vector<uint32_t> found;
+        for (const auto& entry : beds) {
+            if (entry.second.ward == ward) found.push_back(entry.first);
+        }
+        return found;
+    }
+
+    // Logs the event and adds it to its bed's tail. Call commit() after a batch.
+    bool append(HistoryEvent event) {
+        event.seq = ++seq;
+        if (event.payload.size() > HISTORY_STRING_MAX) {
+            event.payload.resize(HISTORY_STRING_MAX);
+        }
+        if (!writeLog(event)) {
+            return false;
+        }
+        Bed& bed = beds[event.bed];
+        bed.tail.push_back(event);
+        eventCount++;
+        return bed.tail.size() < HISTORY_BLOCK_ROWS || seal(event.bed, bed);
+    }
+
+    // The batch is in the log; seal everything if the log has grown large
+    bool commit() {
+        if (fflush(log) != 0) {
+            return fail("cannot write the history log");
+        }
+        return logBytes < HISTORY_LOG_BYTES || flush();
+    }
+
+    // Seal every tail and start the log again
+    bool flush() {
+        for (auto& entry : beds) {
+            if (!entry.second.tail.empty() && !seal(entry.first, entry.second)) {
+                return false;
+            }
+        }
+        fflush(log);
+        if (logBytes > sizeof(uint32_t)) {
+            fclose(log);
+            log = fopen(path("history.log").c_str(), "wb");
+            if (log == nullptr) {
+                return fail("cannot reset the history log");
+            }
+            uint32_t magic = HISTORY_LOG_MAGIC;
+            fwrite(&magic, sizeof(magic), 1, log);
+            fflush(log);
+            logBytes = sizeof(magic);
+        }
+        return true;
+    }
+
+    // Matching events, newest (or oldest) first, at most q.limit. Days are
+    // read newest first (oldest first) across the beds and reading stops at
+    // the first day that completes the limit.
+    void range(const HistoryQuery& q, std::vector<HistoryEvent>& out) {
+        out.clear();
+        std::vector<HistoryEvent> found;
+        std::map<int64_t, std::vector<uint32_t>> days;
+        for (uint32_t bedId : selectedBeds(q)) {
+            auto at = beds.find(bedId);
+            if (at == beds.end()) continue;
+            for (const HistoryEvent& e : at->second.tail) {
+                if (matches(q, e.tsMs, e.action, e.status)) found.push_back(e);
+            }
+            if (q.fromMs >= q.toMs) continue;
+            auto last = at->second.days.upper_bound(dayOf(q.toMs - 1));
+            for (auto day = at->second.days.lower_bound(dayOf(q.fromMs)); day != last; ++day) {
+                days[day->first].push_back(bedId);
+            }
+        }
+        // Unsealed events count towards the limit once the day being read is
+        // no newer (older) than they are
+        order(found.begin(), found.end(), q.newestFirst);
+        size_t tails = found.size();
+        size_t tailsBefore = 0;
+        auto readDay = [&](int64_t day, const std::vector<uint32_t>& dayBeds) {
+            for (uint32_t bedId : dayBeds) {
+                readPartition(q, bedId, day, beds[bedId].days[day], found);
+            }
+            if (q.limit == 0) {
+                return false;
+            }
+            int64_t boundary = q.newestFirst ? day * HISTORY_DAY_MS : (day + 1) * HISTORY_DAY_MS;
+            while (tailsBefore < tails && (q.newestFirst ? found[tailsBefore].tsMs >= boundary
+                                                         : found[tailsBefore].tsMs < boundary)) {
+                tailsBefore++;
+            }
+            return found.size() - tails + tailsBefore >= q.limit;
+        };
+        if (q.newestFirst) {
+            for (auto day = days.rbegin(); day != days.rend() && !readDay(day->first, day->second); ++day) {}
+        } else {
+            for (auto day = days.begin(); day != days.end() && !readDay(day->first, day->second); ++day) {}
+        }
+        order(found.begin(), found.end(), q.newestFirst);
+        if (q.limit != 0 && found.size() > q.limit) {
+            found.resize(q.limit);
+        }
+        out.swap(found);
+    }
+
+    // Events per time bucket and status, action or bed
+    void count(const HistoryQuery& q, int64_t bucketMs, HistoryGroup group, std::vector<HistoryCount>& out) {
+        out.clear();
+        if (bucketMs <= 0) {
+            return;
+        }
+        // Buckets the query can touch, from the indexes and the tails
+        std::vector<uint32_t> selected = selectedBeds(q);
+        int64_t lowMs = std::numeric_limits<int64_t>::max();
+        int64_t highMs = std::numeric_limits<int64_t>::min();
+        for (uint32_t bedId : selected) {
+            auto at = beds.find(bedId);
+            if (at == beds.end()) continue;
+            for (const auto& day : at->second.days) {
+                for (const HistoryBlockRef& ref : day.second.blocks) {
+                    lowMs = std::min(lowMs, ref.minTs);
+                    highMs = std::max(highMs, ref.maxTs);
+                }
+            }
+            for (const HistoryEvent& e : at->second.tail) {
+                lowMs = std::min(lowMs, e.tsMs);
+                highMs = std::max(highMs, e.tsMs);
+            }
+        }
+        lowMs = std::max(lowMs, q.fromMs);
+        highMs = std::min(highMs, q.toMs - 1);
+        if (lowMs > highMs) {
+            return;
+        }
+        Tally tally(bucketOf(lowMs, bucketMs), bucketOf(highMs, bucketMs), strings.size());
+        for (uint32_t bedId : selected) {
+            auto at = beds.find(bedId);
+            if (at == beds.end()) continue;
+            tally.bed = bedId;
+            countBed(q, bucketMs, group, at->second, tally);
+        }
+        tally.results(bucketMs, out);
+    }
+
+    HistoryStats stats() const {
+        HistoryStats s = readCounters;
+        s.events = eventCount;
+        s.logBytes = logBytes;
+        for (const auto& entry : beds) {
+            for (const auto& day : entry.second.days) {
+                s.partitions++;
+                for (const HistoryBlockRef& block : day.second.blocks) {
+                    s.blocks++;
+                    s.sealedEvents += block.rows;
+                    s.diskBytes += block.bytes;
+                }
+                s.rawBytes += day.second.rawBytes;
+            }
+        }
+        return s;
+    }
+
+    size_t bedCount() const { return beds.size(); }
+    const std::string& error() const { return lastError; }
+
+private:
+    struct Partition {
+        std::vector<HistoryBlockRef> blocks;
+        uint64_t rawBytes = 0;
+    };
+
+    struct Bed {
+        std::map<int64_t, Partition> days;      // By UTC day number
+        std::vector<HistoryEvent> tail;         // Not sealed yet
+        uint64_t sealedSeq = 0;
+        uint32_t ward = 0;
+    };
+
+    // Columns of one block, as far as decoded
+    struct Block {
+        uint32_t rows = 0;
+        std::vector<int64_t> ts;
+        std::vector<uint32_t> column[HISTORY_PAYLOAD];
+        std::vector<std::string> payload;
+    };
+
+    struct BucketHash {
+        size_t operator()(const std::pair<int64_t, uint32_t>& k) const {
+            return std::hash<uint64_t>()((uint64_t)k.first * 0x9E3779B97F4A7C15ull ^ k.second);
+        }
+    };
+
+    // Counts per (bucket, key): a dense table when buckets x keys is at most
+    // HISTORY_DENSE_CELLS, a hash map beyond that
+    struct Tally {
+        Tally(int64_t firstBucket, int64_t lastBucket, size_t keyCount) : first(firstBucket), keys(keyCount) {
+            uint64_t buckets = (uint64_t)(lastBucket - firstBucket) + 1;
+            if (buckets <= HISTORY_DENSE_CELLS / keys) {
+                dense.assign(buckets * keys, 0);
+            }
+        }
+
+        void add(int64_t bucket, uint32_t key, uint64_t events = 1) {
+            if (!dense.empty()) {
+                dense[(size_t)(bucket - first) * keys + key] += events;
+            } else {
+                sparse[{bucket, key}] += events;
+            }
+        }
+
+        void results(int64_t bucketMs, std::vector<HistoryCount>& out) const {
+            for (size_t cell = 0; cell < dense.size(); cell++) {
+                if (dense[cell] != 0) {
+                    out.push_back({(first + (int64_t)(cell / keys)) * bucketMs, (uint32_t)(cell % keys), dense[cell]});
+                }
+            }
+            for (const auto& entry : sparse) {
+                out.push_back({entry.first.first * bucketMs, entry.first.second, entry.second});
+            }
+            if (!sparse.empty()) {
+                std::sort(out.begin(), out.end(), [](const HistoryCount& a, const HistoryCount& b) {
+                    return a.bucketMs != b.bucketMs ? a.bucketMs < b.bucketMs : a.key < b.key;
+                });
+            }
+        }
+
+        int64_t first;
+        size_t keys;
+        std::vector<uint64_t> dense;
+        std::unordered_map<std::pair<int64_t, uint32_t>, uint64_t, BucketHash> sparse;
+        uint32_t bed = 0;
+    };
+
+    static int64_t dayOf(int64_t tsMs) { return bucketOf(tsMs, HISTORY_DAY_MS); }
+
+    static void order(std::vector<HistoryEvent>::iterator begin, std::vector<HistoryEvent>::iterator end,
+                      bool newestFirst) {
+        std::sort(begin, end, [newestFirst](const HistoryEvent& a, const HistoryEvent& b) {
+            if (a.tsMs != b.tsMs) return newestFirst ? a.tsMs > b.tsMs : a.tsMs < b.tsMs;
+            return newestFirst ? a.seq > b.seq : a.seq < b.seq;
+        });
+    }
+
+    static bool matches(const HistoryQuery& q, int64_t ts, uint32_t action, uint32_t status) {
+        return ts >= q.fromMs && ts < q.toMs && (q.action == HISTORY_ANY || q.action == action) &&
+               (q.status == HISTORY_ANY || q.status == status);
+    }
+
+    std::string path(const std::string& name) const { return root + "/" + name; }
+
+    std::string partitionPath(uint32_t bed, int64_t day, const char* extension) const {
+        char name[64];
+        snprintf(name, sizeof(name), "b%u_%lld.%s", bed, (long long)day, extension);
+        return path(name);
+    }
+
+    std::vector<uint32_t> selectedBeds(const HistoryQuery& q) const {
+        if (!q.beds.empty()) {
+            return q.beds;
+        }
+        std::vector<uint32_t> all;
+        for (const auto& entry : beds) all.push_back(entry.first);
+        return all;
+    }
+
+    // Rows of one bed and day matching q
+    void readPartition(const HistoryQuery& q, uint32_t bedId, int64_t day, const Partition& partition,
+                       std::vector<HistoryEvent>& found) {
+        uint8_t mask = (1 << HISTORY_COLUMNS) - 1;
+        int fd = -1;
+        for (const HistoryBlockRef& ref : partition.blocks) {
+            if (ref.maxTs < q.fromMs || ref.minTs >= q.toMs) {
+                readCounters.blocksSkipped++;
+                continue;
+            }
+            if (fd < 0 && (fd = ::open(partitionPath(bedId, day, "col").c_str(), O_RDONLY)) < 0) {
+                return;
+            }
+            if (!decode(fd, ref, mask, block)) continue;
+            for (uint32_t r = 0; r < block.rows; r++) {
+                if (!matches(q, block.ts[r], block.column[HISTORY_ACTION][r], block.column[HISTORY_STATUS][r])) {
+                    continue;
+                }
+                HistoryEvent e;
+                e.tsMs = block.ts[r];
+                e.seq = ref.maxSeq - block.rows + 1 + r;    // Keeps the order of equal times
+                e.bed = bedId;
+                e.action = block.column[HISTORY_ACTION][r];
+                e.previous = block.column[HISTORY_PREVIOUS][r];
+                e.status = block.column[HISTORY_STATUS][r];
+                e.staff = block.column[HISTORY_STAFF][r];
+                e.source = block.column[HISTORY_SOURCE][r];
+                e.payload.swap(block.payload[r]);
+                found.push_back(std::move(e));
+            }
+        }
+        if (fd >= 0) ::close(fd);
+    }
+
+    void countBed(const HistoryQuery& q, int64_t bucketMs, HistoryGroup group, const Bed& bed, Tally& tally) {
+        auto keyOf = [&](uint32_t action, uint32_t status) {
+            return group == GROUP_STATUS ? status : group == GROUP_ACTION ? action : tally.bed;
+        };
+        for (const HistoryEvent& e : bed.tail) {
+            if (matches(q, e.tsMs, e.action, e.status)) {
+                tally.add(bucketOf(e.tsMs, bucketMs), keyOf(e.action, e.status));
+            }
+        }
+        if (bed.days.empty() || q.fromMs >= q.toMs) {
+            return;
+        }
+        bool needAction = group == GROUP_ACTION || q.action != HISTORY_ANY;
+        bool needStatus = group == GROUP_STATUS || q.status != HISTORY_ANY;
+        uint8_t mask = 1 << HISTORY_TIME | (needAction ? 1 << HISTORY_ACTION : 0) |
+                       (needStatus ? 1 << HISTORY_STATUS : 0);
+        auto last = bed.days.upper_bound(dayOf(q.toMs - 1));
+        for (auto day = bed.days.lower_bound(dayOf(q.fromMs)); day != last; ++day) {
+            int fd = -1;
+            for (const HistoryBlockRef& ref : day->second.blocks) {
+                if (ref.maxTs < q.fromMs || ref.minTs >= q.toMs) {
+                    readCounters.blocksSkipped++;
+                    continue;
+                }
+                // Counting by bed, a block inside one bucket needs no reading
+                if (group == GROUP_BED && mask == 1 << HISTORY_TIME && ref.minTs >= q.fromMs && ref.maxTs < q.toMs &&
+                    bucketOf(ref.minTs, bucketMs) == bucketOf(ref.maxTs, bucketMs)) {
+                    tally.add(bucketOf(ref.minTs, bucketMs), tally.bed, ref.rows);
+                    continue;
+                }
+                if (fd < 0 && (fd = ::open(partitionPath(tally.bed, day->first, "col").c_str(), O_RDONLY)) < 0) {
+                    break;
+                }
+                if (!decode(fd, ref, mask, block)) continue;
+                const uint32_t* actions = needAction ? block.column[HISTORY_ACTION].data() : nullptr;
+                const uint32_t* statuses = needStatus ? block.column[HISTORY_STATUS].data() : nullptr;
+                for (uint32_t r = 0; r < block.rows; r++) {
+                    uint32_t action = actions ? actions[r] : 0;
+                    uint32_t status = statuses ? statuses[r] : 0;
+                    if (matches(q, block.ts[r], action, status)) {
+                        tally.add(bucketOf(block.ts[r], bucketMs), keyOf(action, status));
+                    }
+                }
+            }
+            if (fd >= 0) ::close(fd);
+        }
+    }
+
+    // Rounds down, before 1970 too
+    static int64_t bucketOf(int64_t tsMs, int64_t bucketMs) {
+        return tsMs / bucketMs - (tsMs % bucketMs < 0 ? 1 : 0);
+    }
+
+    // Reads and inflates the columns in mask; one read covers the header
+    // and every column up to the last one needed
+    bool decode(int fd, const HistoryBlockRef& ref, uint8_t mask, Block& block) {
+        size_t span = sizeof(HistoryBlockHeader);
+        if (ref.bytes < span) {
+            return false;
+        }
+        file.resize(ref.bytes);
+        ssize_t got = pread(fd, &file[0], span, (off_t)ref.offset);
+        HistoryBlockHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        if (got != (ssize_t)span || header.magic != HISTORY_BLOCK_MAGIC || header.rows != ref.rows) {
+            return false;
+        }
+        uint64_t needed = span;
+        for (uint8_t c = 0; c < HISTORY_COLUMNS; c++) {
+            span += header.packed[c];
+            if (mask & (1 << c)) needed = span;
+        }
+        if (span != ref.bytes || pread(fd, &file[sizeof(header)], needed - sizeof(header),
+                                       (off_t)(ref.offset + sizeof(header))) != (ssize_t)(needed - sizeof(header))) {
+            return false;
+        }
+        readCounters.blocksRead++;
+        block.rows = header.rows;
+        size_t offset = sizeof(header);
+        for (uint8_t c = 0; c < HISTORY_COLUMNS; c++) {
+            size_t at = offset;
+            offset += header.packed[c];
+            if ((mask & (1 << c)) == 0) {
+                continue;
+            }
+            raw.resize(header.raw[c]);
+            uLongf rawLength = header.raw[c];
+            if (uncompress((Bytef*)&raw[0], &rawLength, (const Bytef*)file.data() + at, header.packed[c]) != Z_OK ||
+                rawLength != header.raw[c]) {
+                return false;
+            }
+            const uint8_t* p = (const uint8_t*)raw.data();
+            const uint8_t* end = p + raw.size();
+            uint64_t value;
+            if (c == HISTORY_TIME) {
+                block.ts.resize(block.rows);
+                int64_t ts = header.minTs;
+                for (uint32_t r = 0; r < block.rows; r++) {
+                    if (!getVarint(p, end, value)) return false;
+                    ts += (int64_t)value;
+                    block.ts[r] = ts;
+                }
+            } else if (c == HISTORY_PAYLOAD) {
+                block.payload.resize(block.rows);
+                for (uint32_t r = 0; r < block.rows; r++) {
+                    if (!getVarint(p, end, value) || value > (uint64_t)(end - p)) return false;
+                    block.payload[r].assign((const char*)p, value);
+                    p += value;
+                }
+            } else {
+                std::vector<uint32_t>& column = block.column[c];
+                column.resize(block.rows);
+                for (uint32_t r = 0; r < block.rows; r++) {
+                    if (!getVarint(p, end, value)) return false;
+                    column[r] = (uint32_t)value;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Tail to blocks: sorted by time, one block per day
+    bool seal(uint32_t bedId, Bed& bed) {
+        std::vector<HistoryEvent>& rows = bed.tail;
+        std::stable_sort(rows.begin(), rows.end(),
+                         [](const HistoryEvent& a, const HistoryEvent& b) { return a.tsMs < b.tsMs; });
+        for (size_t first = 0; first < rows.size();) {
+            int64_t day = dayOf(rows[first].tsMs);
+            size_t end = first;
+            while (end < rows.size() && dayOf(rows[end].tsMs) == day) end++;
+            if (!writeBlock(bedId, bed, day, rows.data() + first, end - first)) {
+                return false;
+            }
+            first = end;
+        }
+        for (const HistoryEvent& e : rows) {
+            bed.sealedSeq = std::max(bed.sealedSeq, e.seq);
+        }
+        rows.clear();
+        return true;
+    }
+
+    bool writeBlock(uint32_t bedId, Bed& bed, int64_t day, const HistoryEvent* rows, size_t count) {
+        std::string columns[HISTORY_COLUMNS];
+        int64_t previous = rows[0].tsMs;
+        uint64_t maxSeq = 0;
+        for (size_t r = 0; r < count; r++) {
+            const HistoryEvent& e = rows[r];
+            putVarint(columns[HISTORY_TIME], (uint64_t)(e.tsMs - previous));
+            previous = e.tsMs;
+            putVarint(columns[HISTORY_ACTION], e.action);
+            putVarint(columns[HISTORY_PREVIOUS], e.previous);
+            putVarint(columns[HISTORY_STATUS], e.status);
+            putVarint(columns[HISTORY_STAFF], e.staff);
+            putVarint(columns[HISTORY_SOURCE], e.source);
+            putVarint(columns[HISTORY_PAYLOAD], e.payload.size());
+            columns[HISTORY_PAYLOAD] += e.payload;
+            maxSeq = std::max(maxSeq, e.seq);
+        }
+
+        HistoryBlockHeader header = {};
+        header.magic = HISTORY_BLOCK_MAGIC;
+        header.rows = (uint32_t)count;
+        header.minTs = rows[0].tsMs;
+        std::string body;
+        uint64_t rawTotal = 0;
+        for (uint8_t c = 0; c < HISTORY_COLUMNS; c++) {
+            uLongf length = compressBound(columns[c].size());
+            packed.resize(length);
+            if (compress2((Bytef*)&packed[0], &length, (const Bytef*)columns[c].data(), columns[c].size(), 6) != Z_OK) {
+                return fail("cannot deflate a history block");
+            }
+            header.packed[c] = (uint32_t)length;
+            header.raw[c] = (uint32_t)columns[c].size();
+            body.append(packed.data(), length);
+            rawTotal += columns[c].size();
+        }
+
+        std::string colPath = partitionPath(bedId, day, "col");
+        FILE* data = fopen(colPath.c_str(), "ab");
+        if (data == nullptr) {
+            return fail("cannot open " + colPath);
+        }
+        fseek(data, 0, SEEK_END);
+        HistoryBlockRef ref;
+        ref.offset = (uint64_t)ftell(data);
+        ref.bytes = (uint32_t)(sizeof(header) + body.size());
+        ref.rows = (uint32_t)count;
+        ref.minTs = rows[0].tsMs;
+        ref.maxTs = rows[count - 1].tsMs;
+        ref.maxSeq = maxSeq;
+        bool written = fwrite(&header, sizeof(header), 1, data) == 1 &&
+                       fwrite(body.data(), 1, body.size(), data) == body.size();
+        written = fclose(data) == 0 && written;
+
+        // The index entry goes last: a block without one is never read, and
+        // its events are still in the log
+        std::string idxPath = partitionPath(bedId, day, "idx");
+        FILE* index = written ? fopen(idxPath.c_str(), "ab") : nullptr;
+        if (index == nullptr) {
+            return fail("cannot write " + colPath);
+        }
+        written = fwrite(&ref, sizeof(ref), 1, index) == 1;
+        if (fclose(index) != 0 || !written) {
+            return fail("cannot write " + idxPath);
+        }
+        Partition& partition = bed.days[day];
+        partition.blocks.push_back(ref);
+        partition.rawBytes += rawTotal;
+        return true;
+    }
+
+    bool writeLog(const HistoryEvent& e) {
+        std::string record;
+        putVarint(record, e.seq);
+        putVarint(record, (uint64_t)e.tsMs);
+        putVarint(record, e.bed);
+        putVarint(record, e.action);
+        putVarint(record, e.previous);
+        putVarint(record, e.status);
+        putVarint(record, e.staff);
+        putVarint(record, e.source);
+        putVarint(record, e.payload.size());
+        record += e.payload;
+        uint32_t head[2] = {(uint32_t)record.size(), historyChecksum(record.data(), record.size())};
+        if (fwrite(head, sizeof(head), 1, log) != 1 || fwrite(record.data(), 1, record.size(), log) != record.size()) {
+            return fail("cannot write the history log");
+        }
+        logBytes += sizeof(head) + record.size();
+        return true;
+    }
+
+    bool loadStrings() {
+        std::string file = path("strings.dict");
+        FILE* in = fopen(file.c_str(), "rb");
+        size_t valid = 0;
+        if (in != nullptr) {
+            uint16_t length;
+            std::string value;
+            while (fread(&length, sizeof(length), 1, in) == 1) {
+                value.resize(length);
+                if (length != 0 && fread(&value[0], 1, length, in) != length) break;
+                ids.emplace(value, (uint32_t)strings.size());
+                strings.push_back(value);
+                valid += sizeof(length) + length;
+            }
+            fclose(in);
+            if (truncate(file.c_str(), (off_t)valid) != 0) {
+                return fail("cannot repair " + file);
+            }
+        }
+        stringFile = fopen(file.c_str(), "ab");
+        return stringFile != nullptr || fail("cannot open " + file);
+    }
+
+    bool loadWards() {
+        std::string file = path("wards.map");
+        FILE* in = fopen(file.c_str(), "rb");
+        if (in != nullptr) {
+            uint32_t record[2];
+            while (fread(record, sizeof(uint32_t), 2, in) == 2) {
+                beds[record[0]].ward = record[1];
+            }
+            fclose(in);
+        }
+        wardFile = fopen(file.c_str(), "ab");
+        return wardFile != nullptr || fail("cannot open " + file);
+    }
+
+    // b<B>_<day>.idx, keeping only entries whose block is complete
+    bool loadIndexes() {
+        DIR* dir = opendir(root.c_str());
+        if (dir == nullptr) {
+            return fail("cannot list " + root);
+        }
+        while (struct dirent* entry = readdir(dir)) {
+            unsigned bedId;
+            long long day;
+            char extension[8];
+            if (sscanf(entry->d_name, "b%u_%lld.%7s", &bedId, &day, extension) != 3 ||
+                strcmp(extension, "idx") != 0) {
+                continue;
+            }
+            struct stat info;
+            if (stat(partitionPath(bedId, day, "col").c_str(), &info) != 0) {
+                continue;
+            }
+            std::string file = path(entry->d_name);
+            FILE* in = fopen(file.c_str(), "rb");
+            if (in == nullptr) continue;
+            Bed& bed = beds[bedId];
+            HistoryBlockRef ref;
+            size_t valid = 0;
+            while (fread(&ref, sizeof(ref), 1, in) == 1) {
+                if (ref.offset + ref.bytes > (uint64_t)info.st_size || ref.rows == 0) break;
+                Partition& partition = bed.days[day];
+                partition.blocks.push_back(ref);
+                bed.sealedSeq = std::max(bed.sealedSeq, ref.maxSeq);
+                seq = std::max(seq, ref.maxSeq);
+                eventCount += ref.rows;
+                valid += sizeof(ref);
+            }
+            fclose(in);
+            // Later entries must start on a record boundary
+            if (truncate(file.c_str(), (off_t)valid) != 0) {
+                closedir(dir);
+                return fail("cannot repair " + file);
+            }
+        }
+        closedir(dir);
+        // Inflated sizes for stats(), from the block headers
+        for (auto& b : beds) {
+            for (auto& day : b.second.days) {
+                int fd = ::open(partitionPath(b.first, day.first, "col").c_str(), O_RDONLY);
+                if (fd < 0) continue;
+                for (const HistoryBlockRef& ref : day.second.blocks) {
+                    HistoryBlockHeader header;
+                    if (pread(fd, &header, sizeof(header), (off_t)ref.offset) != (ssize_t)sizeof(header)) continue;
+                    for (uint8_t c = 0; c < HISTORY_COLUMNS; c++) day.second.rawBytes += header.raw[c];
+                }
+                ::close(fd);
+            }
+        }
+        return true;
+    }
+
+    // Events logged but not sealed go back into their tails; the log is then
+    // rewritten from the tails, which also drops a torn last record
+    bool replayLog() {
+        std::string file = path("history.log");
+        FILE* in = fopen(file.c_str(), "rb");
+        if (in != nullptr) {
+            uint32_t magic = 0;
+            uint32_t head[2];
+            std::string record;
+            if (fread(&magic, sizeof(magic), 1, in) == 1 && magic == HISTORY_LOG_MAGIC) {
+                while (fread(head, sizeof(head), 1, in) == 1) {
+                    record.resize(head[0]);
+                    if (fread(&record[0], 1, head[0], in) != head[0] ||
+                        historyChecksum(record.data(), record.size()) != head[1]) {
+                        break;
+                    }
+                    HistoryEvent e;
+                    if (!parseLog(record, e)) break;
+                    seq = std::max(seq, e.seq);
+                    Bed& bed = beds[e.bed];
+                    if (e.seq > bed.sealedSeq) {
+                        bed.tail.push_back(std::move(e));
+                        eventCount++;
+                    }
+                }
+            }
+            fclose(in);
+        }
+        log = fopen(file.c_str(), "wb");
+        if (log == nullptr) {
+            return fail("cannot open " + file);
+        }
+        uint32_t magic = HISTORY_LOG_MAGIC;
+        fwrite(&magic, sizeof(magic), 1, log);
+        logBytes = sizeof(magic);
+        for (const auto& entry : beds) {
+            for (const HistoryEvent& e : entry.second.tail) {
+                if (!writeLog(e)) return false;
+            }
+        }
+        return fflush(log) == 0 || fail("cannot write " + file);
+    }
+
+    static bool parseLog(const std::string& record, HistoryEvent& e) {
+        const uint8_t* p = (const uint8_t*)record.data();
+        const uint8_t* end = p + record.size();
+        uint64_t v[9];
+        for (int i = 0; i < 9; i++) {
+            if (!getVarint(p, end, v[i])) return false;
+        }
+        if (v[8] != (uint64_t)(end - p)) {
+            return false;
+        }
+        e.seq = v[0];
+        e.tsMs = (int64_t)v[1];
+        e.bed = (uint32_t)v[2];
+        e.action = (uint32_t)v[3];
+        e.previous = (uint32_t)v[4];
+        e.status = (uint32_t)v[5];
+        e.staff = (uint32_t)v[6];
+        e.source = (uint32_t)v[7];
+        e.payload.assign((const char*)p, v[8]);
+        return true;
+    }
+
+    bool fail(const std::string& message) {
+        lastError = message;
+        return false;
+    }
+
+    std::string root;
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> ids;
+    std::map<uint32_t, Bed> beds;
+    FILE* log = nullptr;
+    FILE* stringFile = nullptr;
+    FILE* wardFile = nullptr;
+    uint64_t logBytes = 0;
+    uint64_t seq = 0;
+    uint64_t eventCount = 0;
+    HistoryStats readCounters = {};
+    std::string packed;                 // Scratch buffers for (de)compression
+    std::string raw;
+    std::string file;                   // Block as read
+    Block block;                        // Columns of the block being read
+    std::string lastError;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef CURALINK_HOUR_FEATURES_H
+#define CURALINK_HOUR_FEATURES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Next-hour forecast features (backend/app.py get_next_hour_prediction and
+// ML_model/model_train.ipynb) for one series of hourly patient counts: a ward,
+// or a bed's occupied hours.
+// push() adds an hour: lags come from a 24-hour ring and each rolling window
+// keeps a running sum (the count entering minus the one leaving), so a new
+// hour costs a few additions instead of rebuilding a DataFrame. For whole
+// counts the sums are exact and the features equal the pandas ones.
+
+#define HOUR_FEATURE_COUNT  22
+#define HOUR_HISTORY        24      // Hours needed before a forecast (lag24)
+
+// Model input order, as trained
+static const char* const HOUR_FEATURE_NAMES[HOUR_FEATURE_COUNT] = {
+    "dayofweek", "hour", "holiday",
+    "lag1", "lag2", "lag3", "lag24", "lag6", "lag12", "lag18",
+    "rolling_3h", "rolling_6h", "rolling_24h", "rolling_12h", "rolling_18h",
+    "hour_sq", "hour_holiday", "lag1_lag24", "peak_hour",
+    "season_Monsoon", "season_Summer", "season_Winter"
+};
+
+class HourSeries {
+public:
+    void push(double count) {
+        for (uint8_t w = 0; w < WINDOWS; w++) {
+            if (seen >= WINDOW_HOURS[w]) {
+                sums[w] -= lag(WINDOW_HOURS[w]);
+            }
+            sums[w] += count;
+        }
+        ring[head] = count;
+        head = (uint8_t)((head + 1) % HOUR_HISTORY);
+        if (seen < HOUR_HISTORY) {
+            seen++;
+        }
+    }
+
+    bool ready() const { return seen >= HOUR_HISTORY; }
+
+    // Count k hours back, 1 = the latest; needs k <= hours pushed
+    double lag(uint8_t k) const { return ring[(head + HOUR_HISTORY - k) % HOUR_HISTORY]; }
+
+    // Features for the hour being forecast (dayofweek 0 = Monday, month 1-12)
+    void features(int dayofweek, int hour, int month, double* out) const {
+        double holiday = dayofweek >= 5 ? 1 : 0;
+        double lag1 = lag(1), lag24 = lag(24);
+        out[0] = dayofweek;
+        out[1] = hour;
+        out[2] = holiday;
+        out[3] = lag1;
+        out[4] = lag(2);
+        out[5] = lag(3);
+        out[6] = lag24;
+        out[7] = lag(6);
+        out[8] = lag(12);
+        out[9] = lag(18);
+        out[10] = sums[0] / 3;
+        out[11] = sums[1] / 6;
+        out[12] = sums[4] / 24;
+        out[13] = sums[2] / 12;
+        out[14] = sums[3] / 18;
+        out[15] = hour * hour;
+        out[16] = hour * holiday;
+        out[17] = lag1 * lag24;
+        out[18] = hour >= 10 && hour <= 16 ? 1 : 0;
+        out[19] = month >= 6 && month <= 9 ? 1 : 0;
+        out[20] = month >= 3 && month <= 5 ? 1 : 0;
+        out[21] = month >= 10 || month <= 2 ? 1 : 0;
+    }
+
+private:
+    static const uint8_t WINDOWS = 5;
+    static constexpr uint8_t WINDOW_HOURS[WINDOWS] = {3, 6, 12, 18, 24};
+
+    double ring[HOUR_HISTORY] = {};
+    double sums[WINDOWS] = {};
+    uint8_t head = 0;
+    uint8_t seen = 0;
+};
+
+#endif
@@ -0,0 +1,341 @@
+// Python extension module curalink_forest: the flat forest (flatForest.h) and
+// the incremental feature builder (hourFeatures.h) for backend/app.py.
+//
+//   forest = curalink_forest.Forest("rf_best_model.forest")
+//   forest.predict(X)          # X: 2-D float64/float32 buffer (numpy array), rows x n_features
+//   series = curalink_forest.Series(last_24_counts)
+//   series.push(count)         # once per hour
+//   forest.forecast([ward, bed1, bed2], dayofweek, hour, month)
+//
+// predict() and forecast() return lists of floats, or fill `out` (a writable
+// float64 buffer) when given. The GIL is released while trees are walked.
+// Build: python setup.py build_ext --inplace
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include <vector>
+#include "flatForest.h"
+#include "hourFeatures.h"
+
+// ------------------ Series ------------------
+
+struct SeriesObject {
+    PyObject_HEAD
+    HourSeries series;
+};
+
+static bool pushAll(SeriesObject* self, PyObject* counts) {
+    PyObject* iterator = PyObject_GetIter(counts);
+    if (iterator == nullptr) {
+        return false;
+    }
+    PyObject* item;
+    while ((item = PyIter_Next(iterator)) != nullptr) {
+        double count = PyFloat_AsDouble(item);
+        Py_DECREF(item);
+        if (count == -1.0 && PyErr_Occurred()) {
+            Py_DECREF(iterator);
+            return false;
+        }
+        self->series.push(count);
+    }
+    Py_DECREF(iterator);
+    return !PyErr_Occurred();
+}
+
+static int Series_init(SeriesObject* self, PyObject* args, PyObject*) {
+    PyObject* counts = nullptr;
+    if (!PyArg_ParseTuple(args, "|O", &counts)) {
+        return -1;
+    }
+    new (&self->series) HourSeries();
+    return counts == nullptr || pushAll(self, counts) ? 0 : -1;
+}
+
+static PyObject* Series_push(SeriesObject* self, PyObject* arg) {
+    double count = PyFloat_AsDouble(arg);
+    if (count == -1.0 && PyErr_Occurred()) {
+        return nullptr;
+    }
+    self->series.push(count);
+    Py_RETURN_NONE;
+}
+
+static PyObject* Series_features(SeriesObject* self, PyObject* args) {
+    int dayofweek, hour, month;
+    if (!PyArg_ParseTuple(args, "iii", &dayofweek, &hour, &month)) {
+        return nullptr;
+    }
+    if (!self->series.ready()) {
+        PyErr_SetString(PyExc_ValueError, "series needs 24 hours");
+        return nullptr;
+    }
+    double row[HOUR_FEATURE_COUNT];
+    self->series.features(dayofweek, hour, month, row);
+    PyObject* list = PyList_New(HOUR_FEATURE_COUNT);
+    for (int i = 0; i < HOUR_FEATURE_COUNT; i++) {
+        PyList_SET_ITEM(list, i, PyFloat_FromDouble(row[i]));
+    }
+    return list;
+}
+
+static PyObject* Series_ready(SeriesObject* self, void*) {
+    return PyBool_FromLong(self->series.ready());
+}
+
+static PyMethodDef SeriesMethods[] = {
+    {"push", (PyCFunction)Series_push, METH_O, "Add the next hour's count"},
+    {"features", (PyCFunction)Series_features, METH_VARARGS,
+     "features(dayofweek, hour, month): model inputs for the hour being forecast"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyGetSetDef SeriesGetSet[] = {
+    {"ready", (getter)Series_ready, nullptr, "True once 24 hours were pushed", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+static PyTypeObject SeriesType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+// ------------------ Forest ------------------
+
+struct ForestObject {
+    PyObject_HEAD
+    FlatForest* forest;
+};
+
+static int Forest_init(ForestObject* self, PyObject* args, PyObject*) {
+    const char* path;
+    if (!PyArg_ParseTuple(args, "s", &path)) {
+        return -1;
+    }
+    delete self->forest;
+    self->forest = new FlatForest();
+    if (!self->forest->load(path)) {
+        PyErr_SetString(PyExc_ValueError, self->forest->error().c_str());
+        return -1;
+    }
+    return 0;
+}
+
+static void Forest_dealloc(ForestObject* self) {
+    delete self->forest;
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+// `out` as a writable float64 buffer of count entries, or a new list afterwards
+struct Output {
+    Py_buffer view = {};
+    bool given = false;
+    std::vector<double> local;
+
+    double* open(PyObject* out, size_t count) {
+        if (out == nullptr || out == Py_None) {
+            local.resize(count);
+            return local.data();
+        }
+        if (PyObject_GetBuffer(out, &view, PyBUF_WRITABLE | PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) != 0) {
+            return nullptr;
+        }
+        given = true;
+        if (strcmp(view.format, "d") != 0 || (size_t)view.len != count * sizeof(double)) {
+            PyErr_SetString(PyExc_ValueError, "out must be a contiguous float64 buffer with one entry per row");
+            return nullptr;
+        }
+        return (double*)view.buf;
+    }
+
+    PyObject* result() {
+        if (given) {
+            Py_RETURN_NONE;
+        }
+        PyObject* list = PyList_New((Py_ssize_t)local.size());
+        for (size_t i = 0; i < local.size(); i++) {
+            PyList_SET_ITEM(list, i, PyFloat_FromDouble(local[i]));
+        }
+        return list;
+    }
+
+    ~Output() {
+        if (given) PyBuffer_Release(&view);
+    }
+};
+
+static bool loaded(ForestObject* self) {
+    if (self->forest == nullptr) {
+        PyErr_SetString(PyExc_ValueError, "forest not loaded");
+        return false;
+    }
+    return true;
+}
+
+static PyObject* Forest_predict(ForestObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"rows", "out", nullptr};
+    PyObject* rows;
+    PyObject* out = nullptr;
+    if (!loaded(self) || !PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", (char**)keywords, &rows, &out)) {
+        return nullptr;
+    }
+    Py_buffer view;
+    if (PyObject_GetBuffer(rows, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) != 0) {
+        return nullptr;
+    }
+    size_t width = self->forest->features();
+    bool isDouble = strcmp(view.format, "d") == 0;
+    bool isFloat = strcmp(view.format, "f") == 0;
+    size_t itemSize = isDouble ? sizeof(double) : sizeof(float);
+    if ((!isDouble && !isFloat) || view.ndim != 2 || (size_t)view.shape[1] != width) {
+        PyBuffer_Release(&view);
+        PyErr_Format(PyExc_ValueError, "rows must be a 2-D float64 or float32 array with %zu columns", width);
+        return nullptr;
+    }
+    size_t count = (size_t)view.len / (itemSize * width);
+
+    Output output;
+    double* target = output.open(out, count);
+    if (target == nullptr) {
+        PyBuffer_Release(&view);
+        return nullptr;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    if (isDouble) {
+        self->forest->predict((const double*)view.buf, count, target);
+    } else {
+        self->forest->predict((const float*)view.buf, count, target);
+    }
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    return output.result();
+}
+
+// One prediction per series, features built natively
+static PyObject* Forest_forecast(ForestObject* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"series", "dayofweek", "hour", "month", "out", nullptr};
+    PyObject* sequence;
+    int dayofweek, hour, month;
+    PyObject* out = nullptr;
+    if (!loaded(self) || !PyArg_ParseTupleAndKeywords(args, kwargs, "Oiii|O", (char**)keywords, &sequence,
+                                                      &dayofweek, &hour, &month, &out)) {
+        return nullptr;
+    }
+    if (self->forest->features() != HOUR_FEATURE_COUNT) {
+        PyErr_SetString(PyExc_ValueError, "forest was not trained on the hourly features");
+        return nullptr;
+    }
+    for (size_t i = 0; i < HOUR_FEATURE_COUNT; i++) {
+        if (self->forest->names()[i] != HOUR_FEATURE_NAMES[i]) {
+            PyErr_Format(PyExc_ValueError, "forest feature %zu is %s, expected %s", i,
+                         self->forest->names()[i].c_str(), HOUR_FEATURE_NAMES[i]);
+            return nullptr;
+        }
+    }
+    PyObject* items = PySequence_Fast(sequence, "series must be a sequence of Series");
+    if (items == nullptr) {
+        return nullptr;
+    }
+    size_t count = (size_t)PySequence_Fast_GET_SIZE(items);
+    std::vector<double> rows(count * HOUR_FEATURE_COUNT);
+    for (size_t i = 0; i < count; i++) {
+        PyObject* item = PySequence_Fast_GET_ITEM(items, i);
+        if (!PyObject_TypeCheck(item, &SeriesType) || !((SeriesObject*)item)->series.ready()) {
+            Py_DECREF(items);
+            PyErr_SetString(PyExc_ValueError, "every series must be a Series with 24 hours");
+            return nullptr;
+        }
+        ((SeriesObject*)item)->series.features(dayofweek, hour, month, &rows[i * HOUR_FEATURE_COUNT]);
+    }
+    Py_DECREF(items);
+
+    Output output;
+    double* target = output.open(out, count);
+    if (target == nullptr) {
+        return nullptr;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    self->forest->predict(rows.data(), count, target);
+    Py_END_ALLOW_THREADS
+    return output.result();
+}
+
+static PyObject* Forest_n_features(ForestObject* self, void*) {
+    return loaded(self) ? PyLong_FromSize_t(self->forest->features()) : nullptr;
+}
+
+static PyObject* Forest_n_trees(ForestObject* self, void*) {
+    return loaded(self) ? PyLong_FromSize_t(self->forest->trees()) : nullptr;
+}
+
+static PyObject* Forest_n_nodes(ForestObject* self, void*) {
+    return loaded(self) ? PyLong_FromSize_t(self->forest->nodeCount()) : nullptr;
+}
+
+static PyObject* Forest_feature_names(ForestObject* self, void*) {
+    if (!loaded(self)) {
+        return nullptr;
+    }
+    const std::vector<std::string>& names = self->forest->names();
+    PyObject* list = PyList_New((Py_ssize_t)names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        PyList_SET_ITEM(list, i, PyUnicode_FromString(names[i].c_str()));
+    }
+    return list;
+}
+
+static PyMethodDef ForestMethods[] = {
+    {"predict", (PyCFunction)(void (*)(void))Forest_predict, METH_VARARGS | METH_KEYWORDS,
+     "predict(rows, out=None): one prediction per row"},
+    {"forecast", (PyCFunction)(void (*)(void))Forest_forecast, METH_VARARGS | METH_KEYWORDS,
+     "forecast(series, dayofweek, hour, month, out=None): next-hour prediction per Series"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyGetSetDef ForestGetSet[] = {
+    {"n_features", (getter)Forest_n_features, nullptr, nullptr, nullptr},
+    {"n_trees", (getter)Forest_n_trees, nullptr, nullptr, nullptr},
+    {"n_nodes", (getter)Forest_n_nodes, nullptr, nullptr, nullptr},
+    {"feature_names", (getter)Forest_feature_names, nullptr, nullptr, nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}
+};
+
+static PyTypeObject ForestType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+// ------------------ Module ------------------
+
+static PyModuleDef ForestModule = {
+    PyModuleDef_HEAD_INIT, "curalink_forest", "Native next-hour forecast inference", -1, nullptr
+};
+
+PyMODINIT_FUNC PyInit_curalink_forest() {
+    SeriesType.tp_name = "curalink_forest.Series";
+    SeriesType.tp_basicsize = sizeof(SeriesObject);
+    SeriesType.tp_flags = Py_TPFLAGS_DEFAULT;
+    SeriesType.tp_doc = "Series(counts=()): hourly counts and their forecast features";
+    SeriesType.tp_new = PyType_GenericNew;
+    SeriesType.tp_init = (initproc)Series_init;
+    SeriesType.tp_methods = SeriesMethods;
+    SeriesType.tp_getset = SeriesGetSet;
+
+    ForestType.tp_name = "curalink_forest.Forest";
+    ForestType.tp_basicsize = sizeof(ForestObject);
+    ForestType.tp_flags = Py_TPFLAGS_DEFAULT;
+    ForestType.tp_doc = "Forest(path): flattened random forest written by export_forest.py";
+    ForestType.tp_new = PyType_GenericNew;
+    ForestType.tp_init = (initproc)Forest_init;
+    ForestType.tp_dealloc = (destructor)Forest_dealloc;
+    ForestType.tp_methods = ForestMethods;
+    ForestType.tp_getset = ForestGetSet;
+
+    if (PyType_Ready(&SeriesType) < 0 || PyType_Ready(&ForestType) < 0) {
+        return nullptr;
+    }
+    PyObject* module = PyModule_Create(&ForestModule);
+    if (module == nullptr) {
+        return nullptr;
+    }
+    Py_INCREF(&SeriesType);
+    Py_INCREF(&ForestType);
+    PyModule_AddObject(module, "Series", (PyObject*)&SeriesType);
+    PyModule_AddObject(module, "Forest", (PyObject*)&ForestType);
+    return module;
+}
@@ -0,0 +1,27 @@
+"""Build the native forecast and history modules next to this file:
+
+    python setup.py build_ext --inplace
+"""
+
+from setuptools import Extension, setup
+
+setup(
+    name='curalink_forest',
+    ext_modules=[
+        Extension(
+            'curalink_forest',
+            sources=['module.cpp'],
+            depends=['flatForest.h', 'hourFeatures.h'],
+            language='c++',
+            extra_compile_args=['-std=c++17', '-O3'],
+        ),
+        Extension(
+            'curalink_history',
+            sources=['historyModule.cpp'],
+            depends=['historyStore.h'],
+            libraries=['z'],
+            language='c++',
+            extra_compile_args=['-std=c++17', '-O3'],
+        ),
+    ],
+)
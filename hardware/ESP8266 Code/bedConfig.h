@@ -0,0 +1,265 @@
+#ifndef CURALINK_BED_CONFIG_H
+#define CURALINK_BED_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "firmwareProfile.h"
+#include "flashRecord.h"
+
+// Runtime-tunable bed settings.
+// The hot path reads the active copy through configStore.get() (one pointer
+// dereference). Updates from Serial or the uplink are staged in the inactive
+// copy, validated as a whole and then swapped in, so a half-applied or invalid
+// update is never visible. With persistence enabled the settings are kept in
+// LittleFS (see flashRecord.h).
+
+#define SETTINGS_MAGIC          0x46434C43UL   // "CLCF"
+#define SETTINGS_SCHEMA         2              // Bump when fields are added (append only)
+#define SETTINGS_FILE           "/settings.bin"
+#define SETTINGS_TMP_FILE       "/settings.tmp"
+
+struct BedSettings {
+    uint16_t fsrThreshold;              // ADC counts above which weight is detected
+    uint16_t tempThresholdCentiC;       // Object temperature for body heat, 0.01 °C
+    uint16_t sampleIntervalMs;          // Sensor sampling period
+    uint16_t unoccupiedConfirmMs;       // Readings must stay empty this long before unoccupied
+    uint16_t longPressMs;               // Button hold time for discharge
+    uint16_t uplinkIntervalMs;          // Periodic uplink cadence
+    uint16_t fsrReportDelta;            // FSR change that forces an uplink
+    uint16_t tempReportDeltaCentiC;     // Temperature change that forces an uplink
+    uint16_t verifyTimeoutMs;           // Cleaning verification card timeout
+    uint16_t dischargePromptTimeoutMs;  // Discharge prompt card timeout
+    uint16_t dischargeVerifyTimeoutMs;  // Discharge confirmation card timeout
+    uint16_t staffIdDisplayMs;          // How long the staff ID stays on screen
+    uint32_t revision;                  // Remote revision last applied, 0 = local/defaults
+    // Schema 2
+    uint16_t autoCalibrate;             // 1 = learned FSR baseline and ambient-compensated body heat
+    uint16_t fsrMinMargin;              // Calibrated FSR threshold is at least this far above baseline
+    uint16_t bodyMarginCentiC;          // Body heat threshold above the empty-bed surface temperature
+};
+
+// Defaults, tunable at runtime. The firmware starts from DEFAULT_SETTINGS and
+// the host tools replay with them.
+// Thresholds
+#define FSR_THRESHOLD   50
+#define TEMP_THRESHOLD  32
+#define LONG_PRESS_TIME 3000  // ms
+#define FSR_REPORT_DELTA        100   // FSR change that forces an uplink
+#define TEMP_REPORT_DELTA_CENTI 50    // 0.5°C change that forces an uplink
+#define AUTO_CALIBRATE          1     // Learn per-bed thresholds (see occupancyCalibration.h)
+#define FSR_MIN_MARGIN          20    // Learned weight threshold is at least this far above baseline
+#define BODY_MARGIN_CENTI       150   // 1.5°C above the empty bed surface counts as body heat
+// Timing
+#define SENSOR_INTERVAL             500    // ms
+#define UNOCCUPIED_CONFIRM_TIME     2000   // ms - 2 seconds to confirm unoccupied
+#define FIREBASE_UPDATE_INTERVAL    2000   // ms
+#define VERIFY_TIMEOUT              5000   // ms - go back to cleaning
+#define DISCHARGE_PROMPT_TIMEOUT    5000   // ms
+#define DISCHARGE_VERIFY_TIMEOUT    10000  // ms
+#define STAFF_ID_DISPLAY_TIME       2000   // ms
+
+static const BedSettings DEFAULT_SETTINGS = {
+    FSR_THRESHOLD,
+    TEMP_THRESHOLD * 100,
+    SENSOR_INTERVAL,
+    UNOCCUPIED_CONFIRM_TIME,
+    LONG_PRESS_TIME,
+    FIREBASE_UPDATE_INTERVAL,
+    FSR_REPORT_DELTA,
+    TEMP_REPORT_DELTA_CENTI,
+    VERIFY_TIMEOUT,
+    DISCHARGE_PROMPT_TIMEOUT,
+    DISCHARGE_VERIFY_TIMEOUT,
+    STAFF_ID_DISPLAY_TIME,
+    0,
+    AUTO_CALIBRATE,
+    FSR_MIN_MARGIN,
+    BODY_MARGIN_CENTI
+};
+
+// Field table used for Serial/uplink updates: name, location and valid range
+struct ConfigField {
+    const char* name;
+    uint8_t offset;
+    uint16_t minValue;
+    uint16_t maxValue;
+};
+
+#define CONFIG_FIELD(field, lo, hi) { #field, (uint8_t)offsetof(BedSettings, field), lo, hi }
+
+static const ConfigField CONFIG_FIELDS[] = {
+    CONFIG_FIELD(fsrThreshold,              1,     1023),
+    CONFIG_FIELD(tempThresholdCentiC,       2000,  4200),
+    CONFIG_FIELD(sampleIntervalMs,          50,    5000),
+    CONFIG_FIELD(unoccupiedConfirmMs,       0,     60000),
+    CONFIG_FIELD(longPressMs,               1000,  10000),
+    // Also the LAN push heartbeat; the dashboard marks a bed offline after 12 s
+    // without a record (src/utils/hardwareBed.js), so keep it well under that
+    CONFIG_FIELD(uplinkIntervalMs,          500,   10000),
+    CONFIG_FIELD(fsrReportDelta,            1,     1023),
+    CONFIG_FIELD(tempReportDeltaCentiC,     1,     1000),
+    CONFIG_FIELD(verifyTimeoutMs,           1000,  60000),
+    CONFIG_FIELD(dischargePromptTimeoutMs,  1000,  60000),
+    CONFIG_FIELD(dischargeVerifyTimeoutMs,  1000,  60000),
+    CONFIG_FIELD(staffIdDisplayMs,          500,   10000),
+    CONFIG_FIELD(autoCalibrate,             0,     1),
+    CONFIG_FIELD(fsrMinMargin,              5,     500),
+    CONFIG_FIELD(bodyMarginCentiC,          50,    800),
+};
+
+#define CONFIG_FIELD_COUNT (sizeof(CONFIG_FIELDS) / sizeof(CONFIG_FIELDS[0]))
+
+// On-flash layout: header, settings, CRC over both
+struct StoredSettings {
+    uint32_t magic;
+    uint16_t schema;
+    uint16_t size;          // sizeof(BedSettings) when written
+    BedSettings settings;
+    uint32_t crc;
+};
+
+class BedConfigStore {
+public:
+    explicit BedConfigStore(const BedSettings& defaults) : defaultSettings(defaults) {
+        slots[0] = defaults;
+        active = &slots[0];
+    }
+
+    // Load persisted settings; falls back to defaults if missing or corrupt.
+    // Settings written by an older schema keep their fields, new fields get defaults.
+    void begin() {
+        StoredSettings stored;
+        memset(&stored, 0, sizeof(stored));
+        size_t n = FlashRecord<FEATURE_PERSISTENCE>::load(SETTINGS_FILE, &stored, sizeof(stored));
+        if (n < offsetof(StoredSettings, settings)) {
+            return;
+        }
+        if (stored.magic != SETTINGS_MAGIC || stored.size == 0 || stored.size > sizeof(BedSettings)) {
+            return;
+        }
+        // The CRC sits right after the settings as they were written
+        uint32_t storedCrc;
+        const uint8_t* base = (const uint8_t*)&stored;
+        size_t crcOffset = offsetof(StoredSettings, settings) + stored.size;
+        if (crcOffset + sizeof(storedCrc) > sizeof(stored)) {
+            return;
+        }
+        memcpy(&storedCrc, base + crcOffset, sizeof(storedCrc));
+        if (flashCrc32(base, crcOffset) != storedCrc) {
+            return;
+        }
+
+        BedSettings loaded = defaultSettings;
+        memcpy(&loaded, &stored.settings, stored.size);
+        if (validate(loaded)) {
+            slots[0] = loaded;
+            active = &slots[0];
+        }
+    }
+
+    // Hot path accessor
+    const BedSettings& get() const { return *active; }
+
+    // Start a transaction on a copy of the active settings
+    void beginUpdate() {
+        staging = inactiveSlot();
+        *staging = *active;
+    }
+
+    // Stage one field; false if the key is unknown or the value out of range
+    bool stage(const char* key, long value) {
+        if (staging == nullptr) return false;
+        const ConfigField* field = findField(key);
+        if (field == nullptr || value < field->minValue || value > field->maxValue) {
+            return false;
+        }
+        uint16_t v = (uint16_t)value;
+        memcpy((uint8_t*)staging + field->offset, &v, sizeof(v));
+        return true;
+    }
+
+    // Validate the staged settings as a whole, swap them in and persist.
+    // Returns false (and keeps the current settings) if validation fails.
+    bool commit(uint32_t revision) {
+        if (staging == nullptr) return false;
+        staging->revision = revision;
+        if (!validate(*staging)) {
+            staging = nullptr;
+            return false;
+        }
+        active = staging;
+        staging = nullptr;
+        persist();
+        return true;
+    }
+
+    void abort() { staging = nullptr; }
+
+    // Back to compiled-in defaults
+    void reset() {
+        BedSettings* slot = inactiveSlot();
+        *slot = defaultSettings;
+        active = slot;
+        persist();
+    }
+
+    bool read(const char* key, uint16_t& value) const {
+        const ConfigField* field = findField(key);
+        if (field == nullptr) return false;
+        memcpy(&value, (const uint8_t*)active + field->offset, sizeof(value));
+        return true;
+    }
+
+    bool lastSaveFailed() const { return saveFailed; }
+
+    static const ConfigField* findField(const char* key) {
+        for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+            if (strcmp(CONFIG_FIELDS[i].name, key) == 0) {
+                return &CONFIG_FIELDS[i];
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    // Cross-field rules on top of the per-field ranges
+    static bool validate(const BedSettings& s) {
+        for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+            uint16_t v;
+            memcpy(&v, (const uint8_t*)&s + CONFIG_FIELDS[i].offset, sizeof(v));
+            if (v < CONFIG_FIELDS[i].minValue || v > CONFIG_FIELDS[i].maxValue) {
+                return false;
+            }
+        }
+        // Confirmation needs at least one sample to fall inside the window
+        if (s.unoccupiedConfirmMs != 0 && s.unoccupiedConfirmMs < s.sampleIntervalMs) {
+            return false;
+        }
+        return true;
+    }
+
+    BedSettings* inactiveSlot() {
+        return active == &slots[0] ? &slots[1] : &slots[0];
+    }
+
+    void persist() {
+        StoredSettings stored;
+        memset(&stored, 0, sizeof(stored));
+        stored.magic = SETTINGS_MAGIC;
+        stored.schema = SETTINGS_SCHEMA;
+        stored.size = sizeof(BedSettings);
+        stored.settings = *active;
+        stored.crc = flashCrc32((const uint8_t*)&stored, offsetof(StoredSettings, crc));
+        saveFailed = !FlashRecord<FEATURE_PERSISTENCE>::save(SETTINGS_FILE, SETTINGS_TMP_FILE,
+                                                             &stored, sizeof(stored));
+    }
+
+    const BedSettings defaultSettings;
+    BedSettings slots[2];
+    BedSettings* active;
+    BedSettings* staging = nullptr;
+    bool saveFailed = false;
+};
+
+#endif
@@ -0,0 +1,582 @@
+#ifndef CURALINK_BED_CONTROLLER_H
+#define CURALINK_BED_CONTROLLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bedState.h"
+#include "sensorMath.h"
+#include "bedConfig.h"
+#include "occupancyCalibration.h"
+#include "sensorHealth.h"
+#include "logMessages.h"
+#include "displayText.h"
+#include "buttonEvents.h"
+#include "bedSnapshot.h"
+
+// Everything that belongs to one bed: the button/card workflow, the
+// median-filtered samples and their calibration, and what was last reported
+// upstream. code.cpp keeps BED_COUNT of these; the RFID reader, LCD, I2C bus
+// and uplink are shared.
+// There is no Arduino dependency: time comes in as arguments and every
+// effect on the outside goes through Io, so the same state machine runs on
+// the host. Io provides:
+//   void show(uint8_t slot, TextId line1, TextId line2, uint32_t holdMs)
+//       workflow feedback on the LCD, held for holdMs (0: until the next redraw)
+//   void redraw(uint8_t slot)                    the status screen changed
+//   void publish(uint8_t slot)                   a state change that goes out now
+//   void trace(uint8_t slot, uint32_t sampleMs)  open a latency trace for an event seen at sampleMs
+//   void log(uint8_t slot, LogId id, args...)
+
+#define BED_STAFF_ID_SIZE   21      // 10-byte UID in hex and the terminator
+#define AMBIENT_READ_EVERY  20      // Sensor samples between MLX ambient reads
+
+// Where bed records go; each keeps its own last-sent values
+enum ReportChannel : uint8_t {
+    REPORT_UPLINK,      // Firebase or the mesh
+    REPORT_LAN,         // LAN push subscribers (lanPush.h)
+    REPORT_CHANNELS
+};
+
+// What a channel last accepted
+struct ReportMark {
+    BedStatus status = UNASSIGNED;
+    int fsrValue = 0;
+    centi_t tempCenti = 0;
+    bool hasBodyTemp = false;
+    bool hasWeight = false;
+    bool isOccupied = false;
+    uint8_t sensorFaults = 0;
+    uint32_t ms = 0;
+};
+
+template<typename Io>
+class BedController {
+public:
+    // Beds live in a fixed array, so they are attached after construction
+    void begin(Io* bedIo, uint8_t bedSlot) {
+        io = bedIo;
+        slot = bedSlot;
+        calibration.begin(slot);
+    }
+
+    uint8_t index() const { return slot; }
+
+    // ------------------ Button ------------------
+
+    // Debounced press/release events in order (buttonEvents.h); gestures are
+    // timed from the event timestamps, not from when the loop got here
+    void buttonEvent(const ButtonEvent& event, const BedSettings& settings) {
+        buttonPoll(event.ms, settings);
+        gesture(gestures.event(event, settings.longPressMs));
+    }
+
+    // Long presses reached while held, and short presses no longer waiting for a double
+    void buttonPoll(uint32_t nowMs, const BedSettings& settings) {
+        ButtonGesture next;
+        while ((next = gestures.poll(nowMs, settings.longPressMs)) != GESTURE_NONE) {
+            gesture(next);
+        }
+    }
+
+    // Button level, polled from every loop pass (simulators, no edge source)
+    void button(bool pressed, uint32_t nowMs, const BedSettings& settings) {
+        if (pressed != gestures.isHeld()) {
+            buttonEvent({nowMs, pressed}, settings);
+        }
+        buttonPoll(nowMs, settings);
+    }
+
+    bool buttonHeld() const { return gestures.isHeld(); }
+
+    void shortPress(uint32_t nowMs) {
+        io->log(slot, LOG_SHORT_PRESS, current);
+
+        switch (current) {
+            case NORMAL:
+                // Start cleaning only if not unassigned
+                if (!unassigned) {
+                    current = CLEANING;
+                    io->trace(slot, lastInputMs);
+                    io->log(slot, LOG_CLEANING_STARTED);
+                    io->publish(slot);
+                    io->show(slot, TEXT_CLEANING_MODE, TEXT_STARTED, 500);
+                }
+                break;
+
+            case CLEANING:
+                // Move to verification state and start the card timeout
+                current = VERIFY_CLEAN;
+                stateTimer = nowMs;
+                io->log(slot, LOG_VERIFY_WAIT);
+                io->publish(slot);
+                io->show(slot, TEXT_TAP_STAFF_CARD, TEXT_TO_VERIFY, 0);
+                break;
+
+            case VERIFY_CLEAN:
+                // Cancel verification and go back to cleaning
+                current = CLEANING;
+                io->log(slot, LOG_VERIFY_CANCELLED);
+                io->show(slot, TEXT_VERIFICATION_TITLE, TEXT_CANCELLED, 500);
+                break;
+
+            default:
+                // Give feedback even when ignoring
+                io->show(slot, TEXT_BUTTON_PRESS, TEXT_NOT_ALLOWED_HERE, 500);
+                break;
+        }
+    }
+
+    void longPress(uint32_t nowMs) {
+        io->log(slot, LOG_LONG_PRESS);
+
+        if (current == NORMAL && !unassigned) {
+            // Start discharge process
+            current = DISCHARGE_PROMPT;
+            stateTimer = nowMs;
+            io->log(slot, LOG_DISCHARGE_START);
+            io->show(slot, TEXT_DISCHARGE_MODE, TEXT_CONFIRM_WITH_CARD, 0);
+            io->publish(slot);
+        } else {
+            io->show(slot, TEXT_LONG_PRESS_NOT, TEXT_ALLOWED_HERE, 1000);
+        }
+    }
+
+    // Only with BUTTON_DOUBLE_PRESS_MS set: backs out of a discharge before the card tap
+    void doublePress() {
+        if (current == DISCHARGE_PROMPT || current == DISCHARGE_VERIFY) {
+            current = NORMAL;
+            io->log(slot, LOG_DISCHARGE_CANCELLED);
+            io->show(slot, TEXT_DISCHARGE, TEXT_CANCELLED, 500);
+            io->publish(slot);
+        } else {
+            io->show(slot, TEXT_DOUBLE_PRESS, TEXT_NOT_ALLOWED_HERE, 500);
+        }
+    }
+
+    // ------------------ Staff cards ------------------
+
+    // A card tap completes this bed's cleaning or discharge
+    bool awaitingCard() const {
+        return current == VERIFY_CLEAN || current == DISCHARGE_PROMPT || current == DISCHARGE_VERIFY;
+    }
+
+    void staffCard(const char* uid, uint32_t nowMs) {
+        strncpy(staff, uid, BED_STAFF_ID_SIZE - 1);
+        staff[BED_STAFF_ID_SIZE - 1] = '\0';
+        lastInputMs = nowMs;
+        io->log(slot, LOG_CARD_IN_STATE, current);
+
+        switch (current) {
+            case VERIFY_CLEAN:
+                // Show staff ID first, then complete cleaning
+                previous = VERIFY_CLEAN;
+                current = SHOW_STAFF_ID;
+                stateTimer = nowMs;
+                io->log(slot, LOG_SHOW_ID_CLEANING);
+                break;
+
+            case DISCHARGE_VERIFY:
+                // Show staff ID first, then discharge
+                previous = DISCHARGE_VERIFY;
+                current = SHOW_STAFF_ID;
+                stateTimer = nowMs;
+                io->log(slot, LOG_SHOW_ID_DISCHARGE);
+                break;
+
+            case DISCHARGE_PROMPT:
+                // Show staff ID first, then move to verification
+                previous = DISCHARGE_PROMPT;
+                current = SHOW_STAFF_ID;
+                stateTimer = nowMs;
+                io->log(slot, LOG_SHOW_ID_VERIFY);
+                break;
+
+            case NORMAL:
+                // If bed is unassigned, staff can reassign it
+                if (unassigned) {
+                    unassigned = false;
+                    occupied = false;
+                    current = SHOW_STAFF_ID;
+                    previous = NORMAL;
+                    stateTimer = nowMs;
+                    io->trace(slot, lastInputMs);
+                    io->log(slot, LOG_REASSIGNED, (const char*)staff);
+                }
+                break;
+
+            default:
+                io->log(slot, LOG_CARD_IGNORED);
+                break;
+        }
+    }
+
+    // Unknown card: a pending cleaning verification falls back to cleaning
+    void cardRejected(uint32_t nowMs) {
+        lastInputMs = nowMs;
+        if (current == VERIFY_CLEAN) {
+            current = CLEANING;
+        }
+    }
+
+    // ------------------ Timeouts ------------------
+
+    void timeouts(uint32_t nowMs, const BedSettings& settings) {
+        switch (current) {
+            case VERIFY_CLEAN:
+                if (nowMs - stateTimer > settings.verifyTimeoutMs) {  // Go back to cleaning
+                    io->show(slot, TEXT_TIMEOUT, TEXT_NONE, 1000);
+                    current = CLEANING;
+                    io->log(slot, LOG_VERIFY_TIMEOUT);
+                    io->redraw(slot);
+                }
+                break;
+
+            case DISCHARGE_PROMPT:
+                if (nowMs - stateTimer > settings.dischargePromptTimeoutMs) {
+                    current = NORMAL;
+                    io->log(slot, LOG_PROMPT_TIMEOUT);
+                }
+                break;
+
+            case DISCHARGE_VERIFY:
+                if (nowMs - stateTimer > settings.dischargeVerifyTimeoutMs) {
+                    current = NORMAL;
+                    io->log(slot, LOG_DISCHARGE_TIMEOUT);
+                }
+                break;
+
+            case SHOW_STAFF_ID:
+                if (nowMs - stateTimer > settings.staffIdDisplayMs) {
+                    if (previous == VERIFY_CLEAN) {
+                        // Complete cleaning
+                        io->show(slot, TEXT_CLEANING, TEXT_COMPLETED, 1000);
+                        current = NORMAL;
+                        io->trace(slot, stateTimer);  // Card tap that started the staff ID display
+                        io->log(slot, LOG_CLEANING_VERIFIED);
+                    } else if (previous == DISCHARGE_VERIFY) {
+                        // Complete discharge - set bed to unassigned
+                        unassigned = true;
+                        occupied = false;  // Force unoccupied state
+                        current = NORMAL;
+                        io->trace(slot, stateTimer);
+                        io->log(slot, LOG_DISCHARGED);
+                        io->publish(slot);
+                    } else if (previous == DISCHARGE_PROMPT) {
+                        // Move to discharge verification
+                        current = DISCHARGE_VERIFY;
+                        stateTimer = nowMs;
+                        io->log(slot, LOG_DISCHARGE_VERIFY);
+                    } else {
+                        current = NORMAL;
+                    }
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    // ------------------ Sensors ------------------
+
+    bool sampleDue(uint32_t nowMs, const BedSettings& settings) const {
+        return nowMs - lastSampleMs > settings.sampleIntervalMs;
+    }
+
+    // Ambient drifts slowly, so it is read only every few samples
+    bool ambientDue() const { return ambientCountdown == 0; }
+
+    // One sample. fsrRaw may be FSR_INVALID and objectCenti CENTI_INVALID
+    // (the last valid value is kept), ambientCenti AMBIENT_INVALID when it was
+    // not read this time.
+    void sample(int fsrRaw, centi_t objectCenti, centi_t ambientReading, uint32_t nowMs,
+                const BedSettings& settings) {
+        // Health sees every read, before the median hides a bad one
+        uint8_t faultsBefore = sensorFaults();
+        uint32_t fsrWindows = fsrMonitor.windows();
+        fsrMonitor.reading(fsrRaw, fsrRaw != FSR_INVALID, {fsrLow(fsrRaw), INT32_MAX, 0, FSR_FULL_SCALE});
+        tempMonitor.reading(objectCenti, objectCenti != CENTI_INVALID, HEALTH_TEMP_LIMITS);
+        if (fsrMonitor.windows() != fsrWindows) {
+            updateFsrFloor(settings);
+        }
+
+        fsrReadings[readingIndex] = fsrRaw != FSR_INVALID ? fsrRaw : fsrValue;
+        tempReadings[readingIndex] = objectCenti != CENTI_INVALID ? objectCenti : tempCenti;
+        readingIndex = (readingIndex + 1) % 3;
+
+        if (ambientCountdown == 0) {
+            if (ambientReading != AMBIENT_INVALID) {
+                ambientCenti = ambientReading;
+            }
+            ambientCountdown = AMBIENT_READ_EVERY;
+        }
+        ambientCountdown--;
+
+        fsrValue = medianOf3(fsrReadings[0], fsrReadings[1], fsrReadings[2]);
+        tempCenti = medianOf3(tempReadings[0], tempReadings[1], tempReadings[2]);
+
+        // An unassigned bed is empty too, so it keeps refining the baseline.
+        // A faulted sensor teaches it nothing (after a mattress change that
+        // reads below the old baseline, "cal reset" starts over).
+        calibration.update(fsrValue, tempCenti, tempMonitor.healthy() ? ambientCenti : AMBIENT_INVALID,
+                           !occupied, settings, fsrMonitor.healthy());
+        calibration.maybePersist(nowMs);
+        if (recording) {
+            io->log(slot, LOG_SAMPLE, nowMs, fsrValue, tempCenti, ambientCenti);
+        }
+
+        if (sensorFaults() != faultsBefore) {
+            io->log(slot, LOG_SENSOR_HEALTH, fsrMonitor.faults(), tempMonitor.faults(), occupancyMode());
+            io->publish(slot);
+        }
+
+        if (!unassigned) {
+            // Weight and body heat against the learned (or configured)
+            // thresholds, or whichever of them is still healthy
+            bool nowOccupied = detected();
+
+            if (nowOccupied && !occupied) {
+                occupied = true;
+                io->trace(slot, nowMs);
+                io->log(slot, LOG_OCCUPIED, fsrValue, tempCenti);
+                unoccupiedSince = 0;
+            } else if (!nowOccupied && occupied) {
+                if (unoccupiedSince == 0) {
+                    unoccupiedSince = nowMs | 1;
+                } else if (nowMs - unoccupiedSince > settings.unoccupiedConfirmMs) {
+                    occupied = false;
+                    // Trace from the first empty reading so the confirm window shows up
+                    io->trace(slot, unoccupiedSince);
+                    io->log(slot, LOG_UNOCCUPIED);
+                    unoccupiedSince = 0;
+                }
+            } else {
+                unoccupiedSince = 0;
+            }
+        }
+        lastSampleMs = nowMs;
+    }
+
+    // "rec on": log every sample for tools/calibration_replay.cpp
+    void record(bool on) { recording = on; }
+
+    // ------------------ Reset survival ------------------
+
+    // What restore() needs to resume this bed after a reset (bedSnapshot.h)
+    BedSnapshot snapshot(uint32_t nowMs) const {
+        BedSnapshot snap = {};
+        snap.state = (uint8_t)current;
+        snap.previous = (uint8_t)previous;
+        snap.flags = (uint8_t)((occupied ? SNAPSHOT_OCCUPIED : 0) | (unassigned ? SNAPSHOT_UNASSIGNED : 0));
+        snap.staffBytes = packStaffId(staff, snap.staff);
+        if (current != NORMAL && current != CLEANING) {
+            uint32_t age = (nowMs - stateTimer) / 100;
+            snap.timerAgeDs = (uint16_t)(age > 0xFFFF ? 0xFFFF : age);
+        }
+        return snap;
+    }
+
+    // At boot, before the first sample. Without timersKnown a timed state
+    // starts its timeout again.
+    bool restore(const BedSnapshot& snap, uint32_t nowMs, bool timersKnown) {
+        if (snap.state > SHOW_STAFF_ID || snap.previous > SHOW_STAFF_ID) {
+            return false;
+        }
+        current = (SystemState)snap.state;
+        previous = (SystemState)snap.previous;
+        occupied = snap.flags & SNAPSHOT_OCCUPIED;
+        unassigned = snap.flags & SNAPSHOT_UNASSIGNED;
+        unpackStaffId(snap.staff, snap.staffBytes, staff);
+        stateTimer = nowMs - (timersKnown ? snap.timerAgeDs * 100UL : 0);
+        return true;
+    }
+
+    // ------------------ Status and reporting ------------------
+
+    BedStatus status() const {
+        if (unassigned) {
+            return UNASSIGNED;
+        }
+        // Debounced occupancy from sample(), so a reading hovering at the
+        // threshold does not flip the reported status between samples
+        switch (current) {
+            case CLEANING:
+            case VERIFY_CLEAN:  // Keep cleaning state during verification
+                return occupied ? OCCUPIED_CLEANING : UNOCCUPIED_CLEANING;
+            default:
+                return occupied ? OCCUPIED : UNOCCUPIED;
+        }
+    }
+
+    // Raw sensor decision sent with the record (the healthy sensors, assigned bed)
+    bool sensorsOccupied() const {
+        return detected() && !unassigned;
+    }
+
+    // ------------------ Sensor health ------------------
+
+    // FSR faults in the low nibble, temperature in the high one (sensorHealth.h)
+    uint8_t sensorFaults() const { return packSensorFaults(fsrMonitor.faults(), tempMonitor.faults()); }
+    OccupancyMode occupancyMode() const { return occupancyModeFor(sensorFaults()); }
+    SensorHealth& fsrHealth() { return fsrMonitor; }
+    const SensorHealth& fsrHealth() const { return fsrMonitor; }
+    SensorHealth& temperatureHealth() { return tempMonitor; }
+    const SensorHealth& temperatureHealth() const { return tempMonitor; }
+
+    // True when the record differs enough from the last one the channel
+    // accepted, or its heartbeat is due
+    bool reportDue(const BedSettings& settings, uint32_t heartbeatMs, uint32_t nowMs,
+                   ReportChannel channel = REPORT_UPLINK) const {
+        const ReportMark& last = marks[channel];
+        bool changed = status() != last.status ||
+                       abs(fsrValue - last.fsrValue) > settings.fsrReportDelta ||
+                       centiDelta(tempCenti, last.tempCenti) > settings.tempReportDeltaCentiC ||
+                       calibration.bodyTempDetected() != last.hasBodyTemp ||
+                       calibration.weightDetected() != last.hasWeight ||
+                       sensorsOccupied() != last.isOccupied ||
+                       sensorFaults() != last.sensorFaults;
+        return changed || nowMs - last.ms >= heartbeatMs;
+    }
+
+    // The current values were accepted by the channel
+    void reported(uint32_t nowMs, ReportChannel channel = REPORT_UPLINK) {
+        ReportMark& last = marks[channel];
+        last.status = status();
+        last.fsrValue = fsrValue;
+        last.tempCenti = tempCenti;
+        last.hasBodyTemp = calibration.bodyTempDetected();
+        last.hasWeight = calibration.weightDetected();
+        last.isOccupied = sensorsOccupied();
+        last.sensorFaults = sensorFaults();
+        last.ms = nowMs;
+    }
+
+    // Status in the last record the channel accepted
+    BedStatus reportedStatus(ReportChannel channel = REPORT_UPLINK) const { return marks[channel].status; }
+
+    SystemState state() const { return current; }
+    bool isOccupied() const { return occupied; }
+    bool isUnassigned() const { return unassigned; }
+    const char* staffId() const { return staff; }
+    int fsr() const { return fsrValue; }
+    centi_t temperatureCenti() const { return tempCenti; }
+    uint32_t lastInput() const { return lastInputMs; }
+    OccupancyCalibration& occupancy() { return calibration; }
+    const OccupancyCalibration& occupancy() const { return calibration; }
+
+private:
+    bool detected() const {
+        switch (occupancyMode()) {
+            case OCCUPANCY_BOTH:
+                return calibration.weightDetected() && calibration.bodyTempDetected();
+            case OCCUPANCY_WEIGHT_ONLY:
+                return calibration.weightDetected();
+            case OCCUPANCY_HEAT_ONLY:
+                return calibration.bodyTempDetected();
+            default:
+                return occupied;  // Nothing left to go on
+        }
+    }
+
+    // Lowest plausible FSR reading. Once the empty-bed baseline is learned well
+    // above the rail, a reading at the rail means the FSR is no longer in the
+    // circuit. A live reading below the floor instead means the baseline is
+    // wrong (learned with an object on the bed, which has now gone): after
+    // HEALTH_BAD_RUN of them on an empty bed it is learned again from there,
+    // rather than faulting a sensor that would then never be trusted to
+    // correct it.
+    int32_t fsrLow(int fsrRaw) {
+        if (fsrFloor == INT32_MIN) {
+            return INT32_MIN;
+        }
+        if (fsrRaw != FSR_INVALID && fsrRaw > 0 && fsrRaw < fsrFloor && !occupied) {
+            if (++belowFloorRun >= HEALTH_BAD_RUN) {
+                io->log(slot, LOG_CAL_RESEED, fsrRaw, calibration.fsrBaseline());
+                calibration.reseedFsr(fsrRaw);
+                fsrFloor = INT32_MIN;   // Taken again at the end of the window
+                belowFloorRun = 0;
+                return INT32_MIN;
+            }
+        } else {
+            belowFloorRun = 0;
+        }
+        return 1;
+    }
+
+    // Taken at the end of a clean health window, so learning from a
+    // disconnected FSR cannot drag it down before the fault is seen; without
+    // a calibration (or after "cal reset") it is off.
+    void updateFsrFloor(const BedSettings& settings) {
+        int32_t floor = INT32_MIN;
+        if (settings.autoCalibrate && calibration.confidence() >= CAL_MIN_CONFIDENCE) {
+            int32_t margin = CAL_NOISE_FACTOR * calibration.fsrNoise();
+            if (margin < settings.fsrMinMargin) margin = settings.fsrMinMargin;
+            if (calibration.fsrBaseline() > margin) floor = calibration.fsrBaseline() - margin;
+        }
+        if (fsrMonitor.healthy() || floor == INT32_MIN) {
+            fsrFloor = floor;
+        }
+    }
+
+    void gesture(ButtonGesture next) {
+        if (next == GESTURE_NONE) {
+            return;
+        }
+        lastInputMs = gestures.gestureMs();
+        switch (next) {
+            case GESTURE_PRESS:
+                io->log(slot, LOG_BUTTON_PRESSED);
+                return;
+            case GESTURE_SHORT:
+                shortPress(lastInputMs);
+                io->log(slot, LOG_SHORT_PRESS_HANDLED);
+                break;
+            case GESTURE_LONG:
+                longPress(lastInputMs);
+                break;
+            default:
+                doublePress();
+                break;
+        }
+        io->redraw(slot);
+    }
+
+    Io* io = nullptr;
+    uint8_t slot = 0;
+
+    // Workflow
+    SystemState current = NORMAL;
+    SystemState previous = NORMAL;  // Where to return after showing the staff ID
+    uint32_t stateTimer = 0;
+    bool occupied = false;
+    bool unassigned = false;
+    char staff[BED_STAFF_ID_SIZE] = "";
+
+    // Button
+    ButtonGestures gestures;
+    uint32_t lastInputMs = 0;       // Latest button/card input, for latency traces
+
+    // Sampling
+    OccupancyCalibration calibration;
+    int fsrReadings[3] = {0, 0, 0};
+    centi_t tempReadings[3] = {0, 0, 0};
+    uint8_t readingIndex = 0;
+    uint8_t ambientCountdown = 0;
+    centi_t ambientCenti = AMBIENT_INVALID;
+    int fsrValue = 0;
+    centi_t tempCenti = 0;
+    uint32_t lastSampleMs = 0;
+    uint32_t unoccupiedSince = 0;
+    bool recording = false;
+    SensorHealth fsrMonitor;
+    SensorHealth tempMonitor;
+    int32_t fsrFloor = INT32_MIN;   // Live readings below it re-seed the baseline, the rail is out of range
+    uint8_t belowFloorRun = 0;
+
+    // Last values accepted upstream and by LAN subscribers, for change detection
+    ReportMark marks[REPORT_CHANNELS];
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef CURALINK_BED_DISPLAY_H
+#define CURALINK_BED_DISPLAY_H
+
+#include <LiquidCrystal_I2C.h>
+#include "i2cBus.h"
+#include "displayText.h"
+
+// 16x2 I2C LCD policy. BedDisplay<false> is an empty stand-in so that call
+// sites stay unconditional and compile to nothing when the display is disabled.
+// BedDisplay<true> draws into a shadow of the screen; only changed characters
+// are sent, from the I2C bus queue at display priority (see i2cBus.h).
+// Fixed text comes from the catalog in flash (displayText.h).
+
+#define LCD_ADDRESS     0x27
+
+template<bool Enabled>
+class BedDisplay {
+public:
+    explicit BedDisplay(I2cBus&) {}
+    void begin() {}
+    void clear() {}
+    void setCursor(uint8_t, uint8_t) {}
+    template<typename T> void print(const T&) {}
+    // Send pending changes now (during start-up, before the loop services the bus)
+    void refresh() {}
+    // Hold a feedback message on screen; without a display there is nothing to wait for
+    void pause(unsigned long) {}
+};
+
+template<>
+class BedDisplay<true> {
+public:
+    explicit BedDisplay(I2cBus& i2c) : bus(i2c), lcd(LCD_ADDRESS, LCD_COLUMNS, LCD_ROWS) {}
+
+    void begin() {
+        lcd.init();
+        lcd.backlight();
+        lcd.clear();
+        memset(shown, ' ', sizeof(shown));
+        memset(screen, ' ', sizeof(screen));
+    }
+
+    void clear() {
+        memset(screen, ' ', sizeof(screen));
+        row = 0;
+        col = 0;
+        changed();
+    }
+
+    void setCursor(uint8_t c, uint8_t r) {
+        col = c;
+        row = r < LCD_ROWS ? r : LCD_ROWS - 1;
+    }
+
+    void print(const char* text) {
+        while (*text) {
+            if (col < LCD_COLUMNS) {
+                screen[row][col] = *text;
+            }
+            col++;
+            text++;
+        }
+        changed();
+    }
+    void print(const String& text) { print(text.c_str()); }
+    // Catalog text, copied straight from flash
+    void print(TextId id) {
+        const char* text = displayText(id);
+        for (char c; (c = (char)pgm_read_byte(text)) != '\0'; text++) {
+            if (col < LCD_COLUMNS) {
+                screen[row][col] = c;
+            }
+            col++;
+        }
+        changed();
+    }
+    void print(int value) {
+        char text[12];
+        snprintf(text, sizeof(text), "%d", value);
+        print(text);
+    }
+
+    void refresh() { flush(this); }
+
+    void pause(unsigned long ms) {
+        refresh();
+        delay(ms);
+    }
+
+private:
+    void changed() {
+        bus.submit(I2C_PRIORITY_DISPLAY, flush, this);
+    }
+
+    // Send each row's changed span (first to last differing column)
+    static void flush(void* context) {
+        BedDisplay<true>* self = static_cast<BedDisplay<true>*>(context);
+        for (uint8_t r = 0; r < LCD_ROWS; r++) {
+            int8_t first = -1;
+            int8_t last = -1;
+            for (uint8_t c = 0; c < LCD_COLUMNS; c++) {
+                if (self->screen[r][c] != self->shown[r][c]) {
+                    if (first < 0) first = c;
+                    last = c;
+                }
+            }
+            if (first < 0) continue;
+            self->lcd.setCursor(first, r);
+            for (int8_t c = first; c <= last; c++) {
+                self->lcd.write((uint8_t)self->screen[r][c]);
+                self->shown[r][c] = self->screen[r][c];
+            }
+        }
+    }
+
+    I2cBus& bus;
+    LiquidCrystal_I2C lcd;
+    char screen[LCD_ROWS][LCD_COLUMNS];     // What the firmware drew
+    char shown[LCD_ROWS][LCD_COLUMNS];      // What the LCD currently displays
+    uint8_t row = 0;
+    uint8_t col = 0;
+};
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef CURALINK_BED_HARDWARE_H
+#define CURALINK_BED_HARDWARE_H
+
+#include <Arduino.h>
+#include "i2cBus.h"
+#include "sensorMath.h"
+#include "buttonEvents.h"
+
+// Per-bed FSR, button and LED for a controller serving Beds beds.
+// BedHardware<1> is the single-bed wiring: button and LED on GPIOs, the FSR
+// on A0 (read through FsrZones/FsrCapture, which own that pin). The button
+// pin interrupts on both edges and the ISR feeds a ButtonEdges debouncer, so
+// presses are timestamped when they happen rather than when loop() looks.
+// With more beds the NodeMCU runs out of pins and has a single ADC, so the
+// per-bed I/O moves onto the shared I2C bus:
+// - FSRs on an ADS1115 (AIN0..AIN3). service() starts one bed's single-shot
+//   conversion and collects it on its next turn, one bed every
+//   BED_ADC_STEP_MS, so the loop never waits for a conversion. Readings are
+//   scaled to A0 counts so thresholds and calibration carry over. A bed
+//   whose last conversion failed reads FSR_INVALID until the next one works.
+// - Buttons on a PCF8574 P0..P3 (to GND), LEDs on P4..P7 (sinking, on when
+//   low), polled every BED_PANEL_POLL_MS. Level changes go through the same
+//   debouncer, so timestamps are good to the poll period.
+// Either way the loop takes debounced events with takeButton(); buttonsUntil()
+// is how far they are complete (see ButtonEdges::sync).
+
+#define BED_COUNT_MAX           4
+#define BED_ADC_ADDRESS         0x48    // ADS1115, ADDR to GND
+#define BED_PANEL_ADDRESS       0x20    // PCF8574, A0-A2 to GND
+#define BED_ADC_STEP_MS         5       // 860 SPS conversions take ~1.2 ms
+#define BED_PANEL_POLL_MS       5
+#define BED_ADC_FULL_SCALE      1270    // A0 counts at the ADS1115's 4.096 V full scale (A0: 1023 = 3.3 V)
+
+template<uint8_t Beds>
+class BedHardware {
+    static_assert(Beds >= 2 && Beds <= BED_COUNT_MAX, "2-4 beds per controller");
+
+public:
+    BedHardware(I2cBus& i2c, uint16_t debounceMs) : bus(i2c), debounce(debounceMs) {}
+
+    // False if the ADC or the expander does not answer
+    bool begin() {
+        for (uint8_t i = 0; i < Beds; i++) {
+            edges[i].begin(debounce, false);
+        }
+        bool ok = writePanel();
+        startConversion();
+        return ok && converting;
+    }
+
+    void service(uint32_t nowMs) {
+        if (nowMs - lastPollMs >= BED_PANEL_POLL_MS) {
+            lastPollMs = nowMs;
+            uint8_t port;
+            if (bus.read(BED_PANEL_ADDRESS, &port, 1)) {
+                uint8_t changed = (uint8_t)((~port & 0x0F) ^ buttons);
+                buttons = ~port & 0x0F;
+                for (uint8_t i = 0; i < Beds; i++) {
+                    if (changed & (1 << i)) {
+                        edges[i].edge(buttons & (1 << i), nowMs);
+                    }
+                }
+            }
+            for (uint8_t i = 0; i < Beds; i++) {
+                edges[i].sync(nowMs);
+            }
+            if (ledsChanged) {
+                writePanel();
+            }
+        }
+        if (nowMs - lastStepMs >= BED_ADC_STEP_MS) {
+            lastStepMs = nowMs;
+            if (converting) {
+                collect();
+            } else {
+                fsrFailed |= (uint8_t)(1 << channel);
+            }
+            channel = (channel + 1) % Beds;
+            startConversion();
+        }
+    }
+
+    int fsr(uint8_t slot) const { return fsrFailed & (1 << slot) ? FSR_INVALID : fsrCounts[slot]; }
+    bool takeButton(uint8_t slot, ButtonEvent& event) { return edges[slot].take(event); }
+    uint32_t buttonsUntil(uint8_t slot) const { return edges[slot].completeUntil(); }
+    const ButtonEdges& buttonEdges(uint8_t slot) const { return edges[slot]; }
+
+    void setLed(uint8_t slot, bool on) {
+        uint8_t mask = (uint8_t)(1 << slot);
+        uint8_t next = on ? (leds | mask) : (leds & ~mask);
+        if (next != leds) {
+            leds = next;
+            ledsChanged = true;
+        }
+    }
+
+private:
+    // Single-shot, AINx against GND, +-4.096 V, 860 SPS, comparator off
+    void startConversion() {
+        const uint8_t config[] = {0x01, (uint8_t)(0xC3 | (channel << 4)), 0xE3};
+        converting = bus.write(BED_ADC_ADDRESS, config, sizeof(config));
+    }
+
+    void collect() {
+        const uint8_t pointer = 0x00;
+        uint8_t data[2];
+        if (!bus.write(BED_ADC_ADDRESS, &pointer, 1) || !bus.read(BED_ADC_ADDRESS, data, 2)) {
+            fsrFailed |= (uint8_t)(1 << channel);
+            return;
+        }
+        fsrFailed &= (uint8_t)~(1 << channel);
+        int32_t raw = (int16_t)((uint16_t)data[0] << 8 | data[1]);
+        int32_t counts = raw * BED_ADC_FULL_SCALE / 32767;
+        fsrCounts[channel] = counts < 0 ? 0 : (counts > 1023 ? 1023 : (int)counts);
+    }
+
+    // Button bits stay high so the quasi-bidirectional pins can read
+    bool writePanel() {
+        uint8_t port = (uint8_t)(0x0F | (~leds & 0x0F) << 4);
+        ledsChanged = !bus.write(BED_PANEL_ADDRESS, &port, 1);
+        return !ledsChanged;
+    }
+
+    I2cBus& bus;
+    ButtonEdges edges[Beds];
+    uint16_t debounce;
+    int fsrCounts[Beds] = {};
+    uint8_t fsrFailed = 0;          // Bit per bed: last conversion failed
+    uint8_t channel = 0;
+    uint8_t buttons = 0;
+    uint8_t leds = 0;
+    bool ledsChanged = false;
+    bool converting = false;
+    uint32_t lastPollMs = 0;
+    uint32_t lastStepMs = 0;
+};
+
+template<>
+class BedHardware<1> {
+public:
+    BedHardware(I2cBus&, uint8_t buttonPin, uint8_t ledPin, uint16_t debounceMs)
+        : button(buttonPin), led(ledPin), debounce(debounceMs) {}
+
+    bool begin() {
+        pinMode(led, OUTPUT);
+        pinMode(button, INPUT_PULLUP);
+        digitalWrite(led, LOW);
+        edges.begin(debounce, digitalRead(button) == LOW);
+        instance = this;
+        attachInterrupt(digitalPinToInterrupt(button), onEdge, CHANGE);
+        return true;
+    }
+
+    // Confirms a press or release once its bounces have died down
+    void service(uint32_t) {
+        noInterrupts();
+        edges.sync(millis());  // Read inside: an edge stamped after nowMs would look old
+        interrupts();
+    }
+
+    int fsr(uint8_t) const { return 0; }  // Not used: FsrZones/FsrCapture read A0
+    bool takeButton(uint8_t, ButtonEvent& event) { return edges.take(event); }
+    uint32_t buttonsUntil(uint8_t) const { return edges.completeUntil(); }
+    const ButtonEdges& buttonEdges(uint8_t) const { return edges; }
+    void setLed(uint8_t, bool on) { digitalWrite(led, on ? HIGH : LOW); }
+
+private:
+    static void IRAM_ATTR onEdge() {
+        instance->edges.edge(digitalRead(instance->button) == LOW, millis());
+    }
+
+    static inline BedHardware* instance = nullptr;  // One button pin per controller
+    ButtonEdges edges;
+    uint8_t button;
+    uint8_t led;
+    uint16_t debounce;
+};
+
+#endif
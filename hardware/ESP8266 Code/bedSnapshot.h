@@ -0,0 +1,187 @@
+#ifndef CURALINK_BED_SNAPSHOT_H
+#define CURALINK_BED_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "flashRecord.h"
+
+// Workflow state that has to survive a reset: each bed's state, the state to
+// return to after the staff ID screen, occupancy, assignment, the staff UID
+// and how long a timed state has been running. Without it a WDT reset or
+// brownout brings a discharged bed back assigned and a bed mid-cleaning back
+// NORMAL, and its first upload overwrites the correct record.
+// - StateKeeper compares the beds' snapshots every loop pass and writes a
+//   change to RTC user memory at once (a few microseconds, no wear). RTC
+//   memory survives WDT, exception and software resets but not power loss.
+// - Changes are mirrored to flash at most every STATE_FLASH_INTERVAL_MS, so
+//   a cold power cut loses at most that much.
+// - restore() at boot takes the RTC copy if its CRC holds, else the flash
+//   one, so the beds resume before the LCD, sensors or WiFi are up. Timers
+//   continue where they stood from RTC memory; from flash the downtime is
+//   unknown and timed states start their timeout again.
+// Storage is a policy pair (Rtc: see rtcRecord.h; Flash: FlashRecord), so
+// tools/state_resume_check.cpp runs the same code with simulated resets.
+
+#define STATE_MAGIC             0x31534C43UL   // "CLS1"
+#define STATE_FILE              "/state.bin"
+#define STATE_TMP_FILE          "/state.tmp"
+#define STATE_FLASH_INTERVAL_MS 15000          // Flash mirror: at most one write per 15 s
+#define STATE_TIMER_REFRESH_MS  1000           // RTC copy of a running timer, refreshed every second
+#define STATE_STAFF_BYTES       10             // Longest card UID
+
+#define SNAPSHOT_OCCUPIED       0x01
+#define SNAPSHOT_UNASSIGNED     0x02
+
+// One bed, 16 bytes
+struct BedSnapshot {
+    uint8_t state;                      // SystemState
+    uint8_t previous;                   // Where SHOW_STAFF_ID returns to
+    uint8_t flags;                      // SNAPSHOT_*
+    uint8_t staffBytes;                 // UID length; the staff ID is its upper-case hex
+    uint8_t staff[STATE_STAFF_BYTES];
+    uint16_t timerAgeDs;                // Tenths of a second into a timed state
+};
+
+enum SnapshotSource : uint8_t {
+    SNAPSHOT_NONE,
+    SNAPSHOT_RTC,
+    SNAPSHOT_FLASH
+};
+
+inline const char* snapshotSourceName(SnapshotSource source) {
+    switch (source) {
+        case SNAPSHOT_RTC: return "rtc";
+        case SNAPSHOT_FLASH: return "flash";
+        default: return "none";
+    }
+}
+
+// Upper-case hex staff ID to UID bytes; returns the byte count (0 if not hex)
+inline uint8_t packStaffId(const char* hex, uint8_t* bytes) {
+    uint8_t n = 0;
+    for (; hex[0] != '\0' && hex[1] != '\0' && n < STATE_STAFF_BYTES; hex += 2) {
+        uint8_t value = 0;
+        for (uint8_t i = 0; i < 2; i++) {
+            char c = hex[i];
+            if (c >= '0' && c <= '9') value = (uint8_t)(value << 4 | (c - '0'));
+            else if (c >= 'A' && c <= 'F') value = (uint8_t)(value << 4 | (c - 'A' + 10));
+            else return 0;
+        }
+        bytes[n++] = value;
+    }
+    return hex[0] == '\0' ? n : 0;
+}
+
+// hex needs 2 * STATE_STAFF_BYTES + 1 chars
+inline void unpackStaffId(const uint8_t* bytes, uint8_t count, char* hex) {
+    static const char DIGITS[] = "0123456789ABCDEF";
+    count = count > STATE_STAFF_BYTES ? STATE_STAFF_BYTES : count;
+    for (uint8_t i = 0; i < count; i++) {
+        hex[2 * i] = DIGITS[bytes[i] >> 4];
+        hex[2 * i + 1] = DIGITS[bytes[i] & 0x0F];
+    }
+    hex[2 * count] = '\0';
+}
+
+template<uint8_t Beds>
+struct StateSnapshot {
+    uint32_t magic;
+    uint32_t seq;                       // One more per change
+    uint8_t beds;
+    uint8_t reserved[3];
+    BedSnapshot bed[Beds];
+    uint32_t crc;
+};
+
+template<uint8_t Beds, typename Rtc, typename Flash>
+class StateKeeper {
+    typedef StateSnapshot<Beds> Snapshot;
+    static_assert(sizeof(BedSnapshot) == 16, "BedSnapshot layout");
+    static_assert(sizeof(Snapshot) % 4 == 0, "RTC memory is written in 4-byte words");
+
+public:
+    // At boot, before the beds are used. RTC memory is written first on
+    // every change, so a valid RTC copy is never older than the flash one and
+    // a warm reset does not wait for the file system.
+    SnapshotSource restore() {
+        if (Rtc::load(&snap, sizeof(snap)) && valid(snap)) {
+            source = SNAPSHOT_RTC;
+            flashDirty = true;  // The flash copy may be behind
+        } else if (Flash::load(STATE_FILE, &snap, sizeof(snap)) == sizeof(snap) && valid(snap)) {
+            source = SNAPSHOT_FLASH;
+        } else {
+            memset(&snap, 0, sizeof(snap));
+            snap.magic = STATE_MAGIC;
+            snap.beds = Beds;
+            source = SNAPSHOT_NONE;
+        }
+        return source;
+    }
+
+    SnapshotSource restoredFrom() const { return source; }
+    bool timersKnown() const { return source == SNAPSHOT_RTC; }
+    const BedSnapshot& bed(uint8_t slot) const { return snap.bed[slot]; }
+
+    // Every loop pass: each bed's current snapshot, then commit()
+    void update(uint8_t slot, const BedSnapshot& bed) {
+        if (memcmp(&bed, &snap.bed[slot], offsetof(BedSnapshot, timerAgeDs)) != 0) {
+            changed = true;
+        } else if (bed.timerAgeDs != snap.bed[slot].timerAgeDs) {
+            aged = true;
+        }
+        snap.bed[slot] = bed;
+    }
+
+    void commit(uint32_t nowMs) {
+        if (changed || (aged && nowMs - rtcMs >= STATE_TIMER_REFRESH_MS)) {
+            if (changed) {
+                snap.seq++;
+                flashDirty = true;
+            }
+            seal();
+            Rtc::save(&snap, sizeof(snap));
+            rtcWrites++;
+            rtcMs = nowMs;
+            changed = false;
+            aged = false;
+        }
+        if (flashDirty && (flashMs == 0 || nowMs - flashMs >= STATE_FLASH_INTERVAL_MS)) {
+            seal();
+            if (Flash::save(STATE_FILE, STATE_TMP_FILE, &snap, sizeof(snap))) {
+                flashDirty = false;
+                flashWrites++;
+            } else {
+                flashFailures++;
+            }
+            flashMs = nowMs | 1;
+        }
+    }
+
+    uint32_t sequence() const { return snap.seq; }
+    uint32_t rtcWriteCount() const { return rtcWrites; }
+    uint32_t flashWriteCount() const { return flashWrites; }
+    uint32_t flashFailureCount() const { return flashFailures; }
+    bool flashPending() const { return flashDirty; }
+
+private:
+    static bool valid(const Snapshot& s) {
+        return s.magic == STATE_MAGIC && s.beds == Beds &&
+               s.crc == flashCrc32((const uint8_t*)&s, offsetof(Snapshot, crc));
+    }
+
+    void seal() { snap.crc = flashCrc32((const uint8_t*)&snap, offsetof(Snapshot, crc)); }
+
+    Snapshot snap = {};
+    SnapshotSource source = SNAPSHOT_NONE;
+    bool changed = false;
+    bool aged = false;
+    bool flashDirty = false;
+    uint32_t rtcMs = 0;
+    uint32_t flashMs = 0;
+    uint32_t rtcWrites = 0;
+    uint32_t flashWrites = 0;
+    uint32_t flashFailures = 0;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef CURALINK_BED_STATE_H
+#define CURALINK_BED_STATE_H
+
+#include "flashText.h"
+
+// Workflow states of the bed controller
+enum SystemState {
+  NORMAL,           // 0: Normal operation showing bed status + sensors
+  CLEANING,         // 1: Cleaning in progress
+  VERIFY_CLEAN,     // 2: Waiting for card to verify cleaning
+  DISCHARGE_PROMPT, // 3: Asking for discharge confirmation
+  DISCHARGE_VERIFY, // 4: Waiting for card to confirm discharge
+  SHOW_STAFF_ID     // 5: Showing staff ID for 2 seconds
+};
+
+// Bed States for Firebase
+enum BedStatus {
+  UNOCCUPIED = 0,
+  OCCUPIED = 1,
+  UNOCCUPIED_CLEANING = 2,
+  OCCUPIED_CLEANING = 3,
+  UNASSIGNED = 4
+};
+
+// Status strings as understood by the dashboard (src/utils/hardwareBed.js);
+// wire values, so never translated. Kept in flash, copied out per use.
+#define BED_STATUS_NAME_SIZE 20
+
+static const char BED_STATUS_UNOCCUPIED_NAME[] PROGMEM = "unoccupied";
+static const char BED_STATUS_OCCUPIED_NAME[] PROGMEM = "occupied";
+static const char BED_STATUS_UNOCCUPIED_CLEANING_NAME[] PROGMEM = "unoccupied+cleaning";
+static const char BED_STATUS_OCCUPIED_CLEANING_NAME[] PROGMEM = "occupied+cleaning";
+static const char BED_STATUS_UNASSIGNED_NAME[] PROGMEM = "unassigned";
+
+struct BedStatusName {
+    char text[BED_STATUS_NAME_SIZE];
+    const char* c_str() const { return text; }
+};
+
+// bedStatusName(status).c_str() stays valid until the end of the statement
+inline BedStatusName bedStatusName(BedStatus status) {
+    const char* name = BED_STATUS_UNOCCUPIED_NAME;
+    switch (status) {
+        case UNOCCUPIED: name = BED_STATUS_UNOCCUPIED_NAME; break;
+        case OCCUPIED: name = BED_STATUS_OCCUPIED_NAME; break;
+        case UNOCCUPIED_CLEANING: name = BED_STATUS_UNOCCUPIED_CLEANING_NAME; break;
+        case OCCUPIED_CLEANING: name = BED_STATUS_OCCUPIED_CLEANING_NAME; break;
+        case UNASSIGNED: name = BED_STATUS_UNASSIGNED_NAME; break;
+    }
+    BedStatusName out;
+    copyFlashText(out.text, sizeof(out.text), name);
+    return out;
+}
+
+#endif
@@ -0,0 +1,657 @@
+#ifndef CURALINK_BED_UPLINK_H
+#define CURALINK_BED_UPLINK_H
+
+#include "firmwareProfile.h"
+#include "bedState.h"
+#include "sensorMath.h"
+#include "timeSync.h"
+#include "latencyTrace.h"
+#include "bedConfig.h"
+#include "eventLog.h"
+#include "respirationFeatures.h"
+#include "hourlyAggregates.h"
+#include "displayText.h"
+#include "sensorHealth.h"
+#include "probeTimers.h"
+
+#if FEATURE_NETWORK
+#include <ESP8266WiFi.h>
+#include <WiFiClientSecure.h>
+#include <time.h>
+#include <sys/time.h>
+#include <coredecls.h>
+#include "rtdbClient.h"
+#endif
+
+// Network uplink policy: WiFi, NTP time samples and the Firebase bed record
+// (rtdbClient.h over one TLS connection). BedUplink<false> is never ready, so
+// callers skip all uplink work and no network code is compiled.
+
+#define UPLINK_TLS_RX_BYTES     16384   // Servers without max fragment length need full TLS records
+#define UPLINK_TLS_SMALL_RX     1024    // When all three Firebase hosts accept max fragment length
+#define UPLINK_TLS_TX_BYTES     RTDB_CHUNK_BYTES
+#define UPLINK_TLS_TIMEOUT_MS   7000
+#define UPLINK_FAILURE_RESET    3       // Failed updates in a row before the session is reset
+#define UPLINK_NTP_WAIT_MS      4500    // Longest connect() waits for the first NTP sample
+
+// One bed record as written to /beds/bed<N>
+struct BedRecord {
+    uint16_t bed;              // This unit, or a bed relayed over the mesh
+    BedStatus status;
+    int fsrValue;
+    centi_t temperatureCenti;  // 0.01 °C, converted to °C only when serialized
+    bool hasBodyTemp;
+    bool hasWeight;
+    bool isOccupied;
+    EventStamp stamp;
+    String staffId;
+    uint32_t configRevision;   // Settings revision in effect
+    uint16_t fsrThreshold;              // Effective (learned or configured) thresholds
+    centi_t tempThresholdCentiC;
+    uint8_t calibrationConfidence;      // Percent, see occupancyCalibration.h
+    bool hasZones;                      // Multiplexed FSR zones fitted (fsrZones.h)
+    bool exitRisk;
+    bool exitChanged;                   // Set on the record sent for a raised/cleared risk
+    int16_t copX;                       // Centre of pressure, permille
+    int16_t copY;
+    uint8_t sensorFaults;               // FSR and temperature faults (sensorHealth.h)
+};
+
+// Progress messages during start-up (shown on the LCD by the caller)
+typedef void (*UplinkProgressFn)(TextId message);
+
+// Where connect() is
+enum UplinkLink : uint8_t {
+    LINK_DOWN,
+    LINK_WIFI,          // Waiting for the access point
+    LINK_TIME,          // Waiting briefly for the first NTP sample
+    LINK_SIGN_IN,       // Waiting for the first Firebase sign-in
+    LINK_UP
+};
+
+template<bool Enabled>
+class BedUplink {
+public:
+    explicit BedUplink(TimeSync&) {}
+    void begin(uint16_t, UplinkProgressFn) {}
+    void connect(uint16_t, UplinkProgressFn, uint32_t = 0) {}
+    bool connecting() const { return false; }
+    bool connectFailed() { return false; }
+    void poll() {}
+    void pollSettings(BedConfigStore&) {}
+    bool ready() { return false; }
+    bool justConnected() { return false; }
+    void queued(const BedRecord&) {}
+    bool sendBatch(const BedRecord*, uint8_t, bool = true) { return false; }
+    bool sendAlert(const BedRecord&) { return false; }
+    bool sendVitals(const RespirationMinute&, const EventStamp&) { return false; }
+    bool sendHour(uint16_t, const HourSummary&) { return false; }
+    bool sendProfile(const ProbeTable&, uint32_t, const EventStamp&) { return false; }
+    void end() {}
+    void openTrace(uint16_t, uint64_t, uint64_t) {}
+};
+
+#if FEATURE_NETWORK
+
+template<>
+class BedUplink<true> {
+public:
+    explicit BedUplink(TimeSync& clock) : timeSync(clock), rtdb(tls) {}
+
+    // Connect at boot: nothing else runs until the first sign-in
+    void begin(uint16_t bed, UplinkProgressFn progress) {
+        connect(bed, progress);
+        while (link != LINK_UP) {
+            if (link == LINK_WIFI) {
+                delay(300);
+                Serial.print(F("."));
+            } else {
+                delay(100);
+            }
+            poll();
+            yield();
+        }
+    }
+
+    // Start connecting and return at once; poll() takes the session through
+    // WiFi, time, sign-in and the bed node a step per call, so the loop keeps
+    // sampling meanwhile (mesh failover). A sign-in attempt still blocks for
+    // its TLS round trips, at most every RTDB_AUTH_RETRY_MS. timeoutMs > 0:
+    // give up after that long, reported once by connectFailed().
+    void connect(uint16_t bed, UplinkProgressFn progress, uint32_t timeoutMs = 0) {
+        bedId = bed;
+        tracer.begin(bed, ESP.random());
+        connectProgress = progress;
+        connectTimeoutMs = timeoutMs;
+        connectStartMs = millis();
+
+        // Disable WiFi sleep mode for better stability
+        WiFi.setSleepMode(WIFI_NONE_SLEEP);
+
+        progress(TEXT_CONNECTING_WIFI);
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+        link = LINK_WIFI;
+    }
+
+    bool connecting() const { return link != LINK_DOWN && link != LINK_UP; }
+
+    // True once when connect() ran out of time (the session was dropped)
+    bool connectFailed() {
+        bool edge = gaveUp;
+        gaveUp = false;
+        return edge;
+    }
+
+    // Apply any NTP sample captured by the SNTP callback, and carry on connecting
+    void poll() {
+        if (ntpSamplePending) {
+            ntpSamplePending = false;
+            uint64_t sampleMono = timeSync.toMonotonic(ntpSampleMillis);
+            timeSync.addSample(sampleMono, ntpSampleUtcMs);
+            LOG(LOG_TIME_SAMPLE, (int32_t)timeSync.drift());
+        }
+        if (connecting()) {
+            advanceLink();
+        }
+    }
+
+    // Apply settings published under /bedConfig/bed<N> when their revision is newer.
+    // All fields are validated together; a bad update is rejected as a whole.
+    // With FEATURE_CONFIG_STREAM the node is read when the stream reports a
+    // change, and polled only while the stream is down.
+    void pollSettings(BedConfigStore& store) {
+        if (!ready()) {
+            return;
+        }
+        bool due = millis() - lastSettingsPoll >= CONFIG_POLL_INTERVAL;
+#if FEATURE_CONFIG_STREAM
+        bool changed = configStream.poll();
+        due = changed || (due && !configStream.live());
+#endif
+        if (!due) {
+            return;
+        }
+        lastSettingsPoll = millis();
+
+        // Only the revision and the known fields are copied out of the reply
+        char values[CONFIG_FIELD_COUNT + 1][12];
+        JsonField fields[CONFIG_FIELD_COUNT + 1];
+        fields[0] = {"revision", values[0], sizeof(values[0]), false};
+        for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+            fields[i + 1] = {CONFIG_FIELDS[i].name, values[i + 1], sizeof(values[i + 1]), false};
+        }
+        JsonScan scan(fields, CONFIG_FIELD_COUNT + 1);
+        char path[24];
+        snprintf(path, sizeof(path), "/bedConfig/bed%u", bedId);
+        if (!rtdb.get(path, scan) || !fields[0].found) {
+            return;  // No config published for this bed
+        }
+
+        long revision;
+        if (!parseInteger(values[0], revision) || revision <= 0 || (uint32_t)revision <= store.get().revision) {
+            return;
+        }
+
+        store.beginUpdate();
+        bool valid = true;
+        for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+            long value;
+            if (fields[i + 1].found &&
+                (!parseInteger(values[i + 1], value) || !store.stage(CONFIG_FIELDS[i].name, value))) {
+                LOG(LOG_SETTINGS_INVALID, (uint32_t)revision, CONFIG_FIELDS[i].name);
+                valid = false;
+            }
+        }
+        if (!valid || !store.commit(revision)) {
+            store.abort();
+            LOG(LOG_SETTINGS_REJECTED, (uint32_t)revision);
+            return;
+        }
+        LOG(LOG_SETTINGS_APPLIED, (uint32_t)revision);
+    }
+
+    bool ready() {
+        return link == LINK_UP && connected && rtdb.ready();
+    }
+
+    // True once when the Firebase session first becomes usable (or comes back)
+    bool justConnected() {
+        if (link == LINK_UP && !connected && rtdb.ready()) {
+            connected = true;
+            LOG(LOG_UPLINK_CONNECTED);
+            return true;
+        }
+        return false;
+    }
+
+    // bed: the bed whose event this is; the trace rides on that bed's records
+    void openTrace(uint16_t bed, uint64_t sampleMs, uint64_t decisionMs) {
+        tracedBed = bed;
+        tracer.open(sampleMs, decisionMs);
+    }
+
+    // Drop the cloud session (mesh gateway standing down)
+    void end() {
+        rtdb.end();
+#if FEATURE_CONFIG_STREAM
+        streamTls.stop();
+#endif
+        WiFi.disconnect();
+        connected = false;
+        link = LINK_DOWN;
+    }
+
+    // The latency trace of a bed's event starts waiting when its record is
+    // queued (uplinkBatch.h), not when the batch goes out
+    void queued(const BedRecord& record) {
+        markEnqueue(record);
+    }
+
+    // Several records in one multi-path update of the root: this
+    // controller's beds from the uplink batch (relayed = false), with the
+    // exit-risk alert of a record that carries one, or beds relayed over the
+    // mesh. One attempt; records that did not go out are still due next time.
+    // After UPLINK_FAILURE_RESET failed updates in a row the session is reset.
+    bool sendBatch(const BedRecord* records, uint8_t count, bool relayed = true) {
+        if (!relayed) {
+            if (WiFi.status() != WL_CONNECTED) {
+                LOG(LOG_WIFI_RECONNECT);
+                WiFi.reconnect();
+                return false;
+            }
+        }
+        bool written = WiFi.status() == WL_CONNECTED &&
+                       rtdb.patch("/", [this, records, count, relayed](JsonOut& json) {
+            json.beginObject();
+            for (uint8_t i = 0; i < count; i++) {
+                char key[20];
+                snprintf(key, sizeof(key), "beds/bed%u", records[i].bed);
+                json.beginObject(key);
+                fillRecord(json, records[i]);
+                if (relayed) {
+                    json.add("relayedBy", (int32_t)bedId);
+                } else {
+                    addTrace(json, records[i]);
+                }
+                json.endObject();
+                if (!relayed && records[i].exitChanged) {
+                    snprintf(key, sizeof(key), "alerts/bed%u", records[i].bed);
+                    json.beginObject(key);
+                    fillAlert(json, records[i]);
+                    json.endObject();
+                }
+            }
+            json.endObject();
+        });
+        if (!written) {
+            if (!relayed) {
+                LOG(LOG_UPLINK_FAILED, rtdb.errorReason());
+                if (++failures >= UPLINK_FAILURE_RESET) {
+                    LOG(LOG_UPLINK_RESET);
+                    rtdb.end();
+                    connected = false;
+                    failures = 0;
+                }
+            }
+            return false;
+        }
+        if (!relayed) {
+            for (uint8_t i = 0; i < count; i++) {
+                markAck(records[i].bed);
+            }
+        }
+        failures = 0;
+        connected = true;
+        return true;
+    }
+
+    // Bed-exit risk raised or cleared on a relayed bed, written to
+    // /alerts/bed<N> ahead of the gateway's batch. One attempt without
+    // waiting for the reply; the record carries exitRisk as well.
+    bool sendAlert(const BedRecord& record) {
+        if (WiFi.status() != WL_CONNECTED) {
+            return false;
+        }
+        char path[24];
+        snprintf(path, sizeof(path), "/alerts/bed%u", record.bed);
+        bool written = rtdb.put(path, [this, &record](JsonOut& json) {
+            json.beginObject();
+            fillAlert(json, record);
+            json.endObject();
+        }, false);
+        if (!written) {
+            LOG(LOG_ALERT_FAILED, rtdb.errorReason());
+            return false;
+        }
+        return true;
+    }
+
+    // Per-minute breathing/motion features (fsrCapture.h) to /vitals/bed<N>.
+    // One attempt: the next minute replaces a lost one.
+    bool sendVitals(const RespirationMinute& minute, const EventStamp& end) {
+        if (WiFi.status() != WL_CONNECTED) {
+            return false;
+        }
+        char path[24];
+        snprintf(path, sizeof(path), "/vitals/bed%u", bedId);
+        bool written = rtdb.put(path, [&minute, &end](JsonOut& json) {
+            json.beginObject();
+            json.add("breathsPerMin", (int32_t)minute.breathsPerMin);
+            json.add("confidence", (int32_t)minute.confidence);
+            json.add("zeroCrossings", (int32_t)minute.zeroCrossings);
+            json.add("motionSeconds", (int32_t)minute.motionSeconds);
+            json.add("motionEnergy", (int64_t)minute.motionEnergy);
+            json.add("meanLoad", (int32_t)minute.meanLoad);
+            json.add("droppedSamples", (int32_t)minute.droppedSamples);
+            json.add("lastUpdate", (int64_t)end.utcMs);
+            json.add("eventMonoMs", (int64_t)end.monoMs);
+            json.add("timeSynced", end.synced);
+            json.endObject();
+        });
+        if (!written) {
+            LOG(LOG_VITALS_FAILED, rtdb.errorReason());
+            return false;
+        }
+        return true;
+    }
+
+    // One finished hour of a bed's aggregates (hourlyAggregates.h) to
+    // /hourly/bed<N>/<hour start, epoch seconds>; kept and retried until accepted
+    bool sendHour(uint16_t bed, const HourSummary& hour) {
+        if (WiFi.status() != WL_CONNECTED) {
+            return false;
+        }
+        char path[40];
+        snprintf(path, sizeof(path), "/hourly/bed%u/%lu", bed, (unsigned long)hour.hour * 3600UL);
+        bool written = rtdb.put(path, [&hour](JsonOut& json) {
+            json.beginObject();
+            json.add("hourStart", (int64_t)hour.hour * 3600);
+            json.add("coveredSeconds", (int32_t)(hour.coveredMs / 1000));
+            json.add("occupiedSeconds", (int32_t)(hour.occupiedMs / 1000));
+            json.add("cleaningSeconds", (int32_t)(hour.cleaningMs / 1000));
+            json.add("admissions", (int32_t)hour.admissions);
+            json.add("cleanings", (int32_t)hour.cleanings);
+            json.add("discharges", (int32_t)hour.discharges);
+            json.endObject();
+        });
+        if (!written) {
+            LOG(LOG_HOURLY_FAILED, rtdb.errorReason());
+            return false;
+        }
+        return true;
+    }
+
+    // Probe histograms (probeTimers.h) to /profile/bed<N>, so units in the
+    // field can be compared with each other and with the host tools.
+    // Times are in microseconds; bucket k counts [2^k, 2^(k+1)) clock ticks.
+    bool sendProfile(const ProbeTable& probes, uint32_t windowMs, const EventStamp& now) {
+        if (WiFi.status() != WL_CONNECTED) {
+            return false;
+        }
+        char path[24];
+        snprintf(path, sizeof(path), "/profile/bed%u", bedId);
+        bool written = rtdb.put(path, [&probes, windowMs, &now](JsonOut& json) {
+            json.beginObject();
+            json.add("profile", PROFILE_NAME);
+            json.add("clock", PROBE_CLOCK);
+            json.add("ticksPerUs", (int32_t)probeTicksPerUs());
+            json.add("windowMs", (int64_t)windowMs);
+            json.add("lastUpdate", (int64_t)now.utcMs);
+            json.add("timeSynced", now.synced);
+            json.beginObject("sites");
+            for (uint8_t i = 0; i < PROBE_COUNT; i++) {
+                ProbeId site = (ProbeId)i;
+                const ProbeHistogram& h = probes.histogram(site);
+                char name[PROBE_NAME_SIZE];
+                json.beginObject(probeName(site, name));
+                json.add("count", (int64_t)h.count);
+                if (h.count > 0) {
+                    addMicros(json, "meanUs", probes.meanTicks(site));
+                    addMicros(json, "p50Us", probes.percentileTicks(site, 500));
+                    addMicros(json, "p90Us", probes.percentileTicks(site, 900));
+                    addMicros(json, "p99Us", probes.percentileTicks(site, 990));
+                    addMicros(json, "maxUs", h.maxTicks);
+                    json.beginObject("buckets");
+                    for (uint8_t k = 0; k < PROBE_BUCKETS; k++) {
+                        if (h.buckets[k] != 0) {
+                            char key[4];
+                            snprintf(key, sizeof(key), "%u", k);
+                            json.add(key, (int64_t)h.buckets[k]);
+                        }
+                    }
+                    json.endObject();
+                }
+                json.endObject();
+            }
+            json.endObject();
+            json.endObject();
+        });
+        if (!written) {
+            LOG(LOG_PROFILE_FAILED, rtdb.errorReason());
+            return false;
+        }
+        return true;
+    }
+
+    // Request counters and latency for the `rtdb` Serial command
+    RtdbClient<BearSSL::WiFiClientSecure>& client() { return rtdb; }
+    bool smallTlsBuffers() const { return smallRx; }
+
+private:
+    // One step of connect(); each waits for its condition without blocking
+    void advanceLink() {
+        uint32_t now = millis();
+        if (connectTimeoutMs != 0 && now - connectStartMs >= connectTimeoutMs) {
+            LOG(LOG_UPLINK_CONNECT_TIMEOUT, (unsigned)link, (unsigned long)(now - connectStartMs));
+            end();
+            gaveUp = true;
+            return;
+        }
+        switch (link) {
+            case LINK_WIFI:
+                if (WiFi.status() != WL_CONNECTED) {
+                    return;
+                }
+                Serial.println(F("\nWiFi Connected"));
+                connectProgress(TEXT_SYNCING_TIME);
+                // Device clock runs in UTC, the dashboard converts to local time for display
+                settimeofday_cb([this]() { onTimeSet(); });
+                configTime(0, 0, "pool.ntp.org", "time.google.com");
+                linkStepMs = now;
+                link = LINK_TIME;
+                return;
+            case LINK_TIME:
+                // Events are stamped with monotonic time, so we can continue unsynced
+                // and the first NTP sample will still date them correctly
+                if (!timeSync.hasSample() && now - linkStepMs < UPLINK_NTP_WAIT_MS) {
+                    return;
+                }
+                connectProgress(TEXT_INIT_FIREBASE);
+                rtdb.begin({DATABASE_URL, API_KEY, USER_EMAIL, USER_PASSWORD, RTDB_AUTH_HOST, RTDB_TOKEN_HOST, RTDB_PORT});
+                setupTls(tls);
+#if FEATURE_CONFIG_STREAM
+                setupTls(streamTls);
+                snprintf(configPath, sizeof(configPath), "/bedConfig/bed%u", bedId);
+                configStream.begin(configPath);
+#endif
+                link = LINK_SIGN_IN;
+                return;
+            case LINK_SIGN_IN:
+                // ready() retries the first sign-in every RTDB_AUTH_RETRY_MS
+                if (!rtdb.ready()) {
+                    return;
+                }
+                createBedNode();
+                link = LINK_UP;
+                return;
+            default:
+                return;
+        }
+    }
+
+    // Initialize the database structure if needed
+    void createBedNode() {
+        EventStamp boot = timeSync.stamp(0);
+        char path[24];
+        snprintf(path, sizeof(path), "/beds/bed%u", bedId);
+        bool created = rtdb.put(path, [&boot](JsonOut& json) {
+            json.beginObject();
+            json.add("initialized", true);
+            json.add("lastBootTime", (int64_t)boot.utcMs);
+            json.add("timeSynced", boot.synced);
+            json.endObject();
+        });
+        if (created) {
+            Serial.println(F("Initial database structure created successfully"));
+        } else {
+            Serial.printf_P(PSTR("Failed to create initial structure: %s\n"), rtdb.errorReason());
+        }
+    }
+
+    // Certificates are not checked, as before (no CA store on the device).
+    // BearSSL needs a receive buffer as large as the largest TLS record;
+    // if every Firebase host agrees to shorter records, 1 KB will do.
+    void setupTls(BearSSL::WiFiClientSecure& client) {
+        client.setInsecure();
+        client.setTimeout(UPLINK_TLS_TIMEOUT_MS);
+        if (&client == &tls) {
+            smallRx = client.probeMaxFragmentLength(rtdb.host(), RTDB_PORT, UPLINK_TLS_SMALL_RX) &&
+                      client.probeMaxFragmentLength(RTDB_AUTH_HOST, RTDB_PORT, UPLINK_TLS_SMALL_RX) &&
+                      client.probeMaxFragmentLength(RTDB_TOKEN_HOST, RTDB_PORT, UPLINK_TLS_SMALL_RX);
+        }
+        client.setBufferSizes(smallRx ? UPLINK_TLS_SMALL_RX : UPLINK_TLS_RX_BYTES, UPLINK_TLS_TX_BYTES);
+    }
+
+    static bool parseInteger(const char* text, long& value) {
+        char* end;
+        value = strtol(text, &end, 10);
+        return end != text && *end == '\0';
+    }
+
+    // Probe ticks as microseconds with two decimals
+    static void addMicros(JsonOut& json, const char* key, uint32_t ticks) {
+        uint32_t centi = probeCentiUs(ticks);
+        char text[16];
+        snprintf(text, sizeof(text), "%lu.%02lu", (unsigned long)(centi / 100), (unsigned long)(centi % 100));
+        json.addRaw(key, text);
+    }
+
+    // Stamped before the body is written: the body function runs twice
+    // (length, then bytes) and must write the same both times
+    void markEnqueue(const BedRecord& record) {
+        if (tracer.active() && record.bed == tracedBed) {
+            tracer.markEnqueue(record.stamp.monoMs);
+        }
+    }
+
+    // Attach the latest event trace to its bed's record; it repeats until the
+    // next event so the ack arrives too
+    void addTrace(JsonOut& json, const BedRecord& record) {
+        if (!tracer.active() || record.bed != tracedBed) {
+            return;
+        }
+        const LatencyTrace& trace = tracer.current();
+        char traceId[32];
+        tracer.formatId(traceId, sizeof(traceId));
+
+        json.beginObject("trace");
+        json.add("id", traceId);
+        json.add("sampleMs", (int64_t)trace.sampleMs);
+        json.add("decisionMs", (int64_t)trace.decisionMs);
+        json.add("enqueueMs", (int64_t)trace.enqueueMs);
+        json.add("ackMs", (int64_t)trace.ackMs);
+        json.beginObject("serverMs");
+        json.add(".sv", "timestamp");  // RTDB fills in its own receive time
+        json.endObject();
+        json.endObject();
+    }
+
+    void markAck(uint16_t bed) {
+        if (bed == tracedBed) {
+            tracer.markAck(timeSync.monotonicMs(millis()));
+        }
+    }
+
+    // The alert's fields, into the caller's object
+    void fillAlert(JsonOut& json, const BedRecord& record) {
+        json.add("type", "bedExitRisk");
+        json.add("active", record.exitRisk);
+        json.add("copX", (int32_t)record.copX);
+        json.add("copY", (int32_t)record.copY);
+        json.add("lastUpdate", (int64_t)record.stamp.utcMs);
+        json.add("eventMonoMs", (int64_t)record.stamp.monoMs);
+        json.add("timeSynced", record.stamp.synced);
+    }
+
+    // The record's fields, into the caller's object
+    void fillRecord(JsonOut& json, const BedRecord& record) {
+        char temperature[12];
+        char tempThreshold[12];
+        formatCenti(temperature, sizeof(temperature), record.temperatureCenti);
+        formatCenti(tempThreshold, sizeof(tempThreshold), record.tempThresholdCentiC);
+        json.add("id", (int32_t)record.bed);
+        json.add("status", bedStatusName(record.status).c_str());
+        json.add("fsrValue", (int32_t)record.fsrValue);
+        json.add("hasBodyTemp", record.hasBodyTemp);
+        json.add("hasWeight", record.hasWeight);
+        json.add("isOccupied", record.isOccupied);
+        json.addRaw("temperature", temperature);
+        json.add("lastUpdate", (int64_t)record.stamp.utcMs);      // UTC epoch ms, 0 if never synced
+        json.add("eventMonoMs", (int64_t)record.stamp.monoMs);    // Device ms since boot
+        json.add("timeSynced", record.stamp.synced);
+        json.add("online", true);
+        json.add("lastStaffId", record.staffId.c_str());  // Add the staff ID that initiated the change
+        json.add("configRevision", (int64_t)record.configRevision);
+        json.add("fsrThreshold", (int32_t)record.fsrThreshold);
+        json.addRaw("tempThreshold", tempThreshold);
+        json.add("calibrationConfidence", (int32_t)record.calibrationConfidence);
+        json.add("sensorFaults", (int32_t)record.sensorFaults);
+        json.add("occupancyMode", (int32_t)occupancyModeFor(record.sensorFaults));
+        if (record.hasZones) {
+            json.add("exitRisk", record.exitRisk);
+            json.add("copX", (int32_t)record.copX);
+            json.add("copY", (int32_t)record.copY);
+        }
+    }
+
+    // SNTP callback - runs when the core sets the system clock
+    void onTimeSet() {
+        struct timeval tv;
+        gettimeofday(&tv, nullptr);
+        ntpSampleMillis = millis();
+        ntpSampleUtcMs = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+        ntpSamplePending = true;
+    }
+
+    TimeSync& timeSync;
+    LatencyTracer tracer;
+
+    BearSSL::WiFiClientSecure tls;
+    RtdbClient<BearSSL::WiFiClientSecure> rtdb;
+    bool smallRx = false;
+#if FEATURE_CONFIG_STREAM
+    BearSSL::WiFiClientSecure streamTls;
+    RtdbStream<BearSSL::WiFiClientSecure, BearSSL::WiFiClientSecure> configStream{streamTls, rtdb};
+    char configPath[24];
+#endif
+    bool connected = false;
+    uint8_t failures = 0;           // Failed batch updates in a row
+    UplinkLink link = LINK_DOWN;
+    UplinkProgressFn connectProgress = nullptr;
+    uint32_t connectStartMs = 0;
+    uint32_t connectTimeoutMs = 0;
+    uint32_t linkStepMs = 0;        // Start of the current connect step
+    bool gaveUp = false;
+    uint16_t bedId = 0;
+    uint16_t tracedBed = 0;
+    unsigned long lastSettingsPoll = 0;
+
+    // NTP samples are captured in the SNTP callback and applied from poll()
+    volatile bool ntpSamplePending = false;
+    volatile uint32_t ntpSampleMillis = 0;
+    int64_t ntpSampleUtcMs = 0;
+};
+
+#endif  // FEATURE_NETWORK
+
+#endif
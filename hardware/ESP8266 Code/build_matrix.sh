@@ -0,0 +1,126 @@
+#!/usr/bin/env bash
+# Build every firmware profile and report flash/RAM size per profile.
+# With --port, each build is also uploaded and the LOOP line printed by the
+# firmware (see LOOP_STATS_INTERVAL) is captured to report loop latency and
+# the free heap low watermark.
+# With --baseline, the same profiles are also built from that git revision
+# and the flash and RAM each profile freed against it are reported; with
+# --port as well, the baseline is uploaded too and its heap low watermark
+# reported ("-" for revisions whose LOOP line has no heap_min).
+#
+# Usage: ./build_matrix.sh [--fqbn esp8266:esp8266:nodemcuv2] [--port /dev/ttyUSB0] [--baseline <git-ref>]
+# Requires arduino-cli with the ESP8266 core and the libraries listed in docs/DEVELOPMENT.md.
+
+set -euo pipefail
+
+FQBN="esp8266:esp8266:nodemcuv2"
+PORT=""
+BASELINE=""
+PROFILES=("PROFILE_NETWORKED" "PROFILE_STANDALONE" "PROFILE_SENSOR_NODE")
+
+while [[ $# -gt 0 ]]; do
+    case "$1" in
+        --fqbn) FQBN="$2"; shift 2 ;;
+        --port) PORT="$2"; shift 2 ;;
+        --baseline) BASELINE="$2"; shift 2 ;;
+        *) echo "Unknown option: $1" >&2; exit 1 ;;
+    esac
+done
+
+SRC_DIR="$(cd "$(dirname "$0")" && pwd)"
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+# arduino-cli needs <dir>/<dir>.ino, so stage the sources as a sketch
+stage() {
+    local from="$1" sketch="$2"
+    mkdir -p "$sketch"
+    cp "$from"/*.h "$sketch"/
+    cp "$from/code.cpp" "$sketch/curalink.ino"
+}
+
+# compile <sketch> <build_dir> <profile> <log>: leaves the size lines in <log>
+compile() {
+    arduino-cli compile --fqbn "$FQBN" \
+        --build-path "$2" \
+        --build-property "compiler.cpp.extra_flags=-DCURALINK_PROFILE=$3" \
+        "$1" > "$4" 2>&1 || { echo "$3: build failed, see output below" >&2; cat "$4" >&2; exit 1; }
+}
+
+ram_of() {
+    sed -n 's/.*Global variables use \([0-9]*\) bytes.*/\1/p' "$1"
+}
+
+flash_of() {
+    sed -n 's/.*Sketch uses \([0-9]*\) bytes.*/\1/p' "$1"
+}
+
+# loop_line <build_dir>: uploads the build and prints its first LOOP line
+loop_line() {
+    arduino-cli upload --fqbn "$FQBN" --port "$PORT" --input-dir "$1" > /dev/null
+    # First LOOP report arrives LOOP_STATS_INTERVAL after boot; allow for start-up
+    timeout 120 arduino-cli monitor --port "$PORT" --config baudrate=115200 2>/dev/null \
+        | grep -m1 "^LOOP " || true
+}
+
+field_of() {
+    sed -n "s/.* $1=\([0-9]*\).*/\1/p" <<< "$2"
+}
+
+SKETCH="$WORK_DIR/curalink"
+stage "$SRC_DIR" "$SKETCH"
+
+BASE_SKETCH=""
+if [[ -n "$BASELINE" ]]; then
+    base_src="$WORK_DIR/baseline-src"
+    mkdir -p "$base_src"
+    # git archive runs from the top level; the tree path keeps just this directory
+    git -C "$(git -C "$SRC_DIR" rev-parse --show-toplevel)" \
+        archive "$BASELINE:$(git -C "$SRC_DIR" rev-parse --show-prefix)" | tar -x -C "$base_src"
+    BASE_SKETCH="$WORK_DIR/baseline/curalink"
+    stage "$base_src" "$BASE_SKETCH"
+fi
+
+printf "%-22s %12s %12s %12s %12s %12s" "profile" "flash_bytes" "ram_bytes" "loop_avg_us" "loop_max_us" "heap_min"
+[[ -n "$BASE_SKETCH" ]] && printf " %12s %12s %12s %12s %12s" "base_flash" "flash_freed" "base_ram" "ram_freed" \
+    "base_heap_min"
+printf "\n"
+
+for profile in "${PROFILES[@]}"; do
+    build_dir="$WORK_DIR/build-$profile"
+    log="$WORK_DIR/$profile.log"
+
+    compile "$SKETCH" "$build_dir" "$profile" "$log"
+
+    flash=$(flash_of "$log")
+    ram=$(ram_of "$log")
+    loop_avg="-"
+    loop_max="-"
+    heap_min="-"
+
+    if [[ -n "$PORT" ]]; then
+        line=$(loop_line "$build_dir")
+        loop_avg=$(field_of avg_us "$line")
+        loop_max=$(field_of max_us "$line")
+        heap_min=$(field_of heap_min "$line")
+    fi
+
+    printf "%-22s %12s %12s %12s %12s %12s" "$profile" "${flash:--}" "${ram:--}" "${loop_avg:--}" "${loop_max:--}" \
+        "${heap_min:--}"
+    if [[ -n "$BASE_SKETCH" ]]; then
+        base_log="$WORK_DIR/baseline-$profile.log"
+        base_build="$WORK_DIR/baseline-build-$profile"
+        compile "$BASE_SKETCH" "$base_build" "$profile" "$base_log"
+        base_flash=$(flash_of "$base_log")
+        base_ram=$(ram_of "$base_log")
+        flash_freed="-"
+        freed="-"
+        base_heap="-"
+        [[ -n "$flash" && -n "$base_flash" ]] && flash_freed=$((base_flash - flash))
+        [[ -n "$ram" && -n "$base_ram" ]] && freed=$((base_ram - ram))
+        [[ -n "$PORT" ]] && base_heap=$(field_of heap_min "$(loop_line "$base_build")")
+        printf " %12s %12s %12s %12s %12s" "${base_flash:--}" "$flash_freed" "${base_ram:--}" "$freed" \
+            "${base_heap:--}"
+    fi
+    printf "\n"
+done
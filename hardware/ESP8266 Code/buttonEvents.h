@@ -0,0 +1,209 @@
+#ifndef CURALINK_BUTTON_EVENTS_H
+#define CURALINK_BUTTON_EVENTS_H
+
+#include <stdint.h>
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR       // Host builds: no flash/IRAM split
+#endif
+
+// Bed buttons as timestamped events, so press timing does not depend on how
+// often loop() gets to look (LCD feedback pauses, blocking uplink retries).
+// - ButtonEdges takes raw edges from the pin-change interrupt (or from a poll
+//   for buttons on the I2C expander). A new level counts once no edge has
+//   come for debounceMs, and its event carries the time of the first edge of
+//   that burst, so a press is timed from first contact however long the
+//   contacts bounce. Bursts that end at the old level (glitches) are dropped.
+//   The loop calls sync() to confirm the last burst when no further edge
+//   arrives. Events wait in a single-producer/single-consumer ring: head is
+//   written only by edge()/sync(), tail only by take().
+// - ButtonGestures turns the events into presses from their timestamps: a
+//   release after longPressMs is a long press even if the loop only sees it
+//   afterwards, and a press still held that long is one as soon as polled.
+//   With a double-press gap set, a short press waits that long for a second
+//   one and the pair is a double press. Call poll(event.ms) before each
+//   event so whatever came due before it is reported first, and after the
+//   events poll(completeUntil()): a burst still settling may yet be a press
+//   or release that happened before now.
+// Host-compilable; tools/button_bounce_check.cpp replays bouncing edge traces.
+
+#ifndef BUTTON_DOUBLE_PRESS_MS
+#define BUTTON_DOUBLE_PRESS_MS  0       // Gap between two short presses of a double press; 0: off
+#endif
+#define BUTTON_QUEUE_SIZE       16      // Events, a power of two
+
+struct ButtonEvent {
+    uint32_t ms;        // First edge of the debounced change
+    bool pressed;
+};
+
+class ButtonEdges {
+    static_assert((BUTTON_QUEUE_SIZE & (BUTTON_QUEUE_SIZE - 1)) == 0, "BUTTON_QUEUE_SIZE must be a power of two");
+
+public:
+    void begin(uint16_t debounce, bool pressed) {
+        debounceMs = debounce;
+        stable = pressed;
+        candidate = pressed;
+        bursting = false;
+    }
+
+    // One raw edge with the level after it. Runs in interrupt context.
+    void IRAM_ATTR edge(bool pressed, uint32_t nowMs) {
+        settle(nowMs);
+        if (pressed == candidate) {
+            return;  // An edge in between was missed; nothing changed
+        }
+        if (!bursting) {
+            bursting = true;
+            burstMs = nowMs;
+        } else {
+            bounces++;
+        }
+        candidate = pressed;
+        lastEdgeMs = nowMs;
+    }
+
+    // Loop side: confirm a settled burst and note up to when the queue is
+    // complete. On the device call with interrupts off, so an edge cannot
+    // land halfway.
+    void sync(uint32_t nowMs) {
+        settle(nowMs);
+        complete = bursting ? burstMs - 1 : nowMs;
+    }
+
+    // Every press and release before this time has been taken or is queued
+    uint32_t completeUntil() const { return complete; }
+
+    // Oldest event not yet handled
+    bool take(ButtonEvent& event) {
+        if (tail == head) {
+            return false;
+        }
+        event = ring[tail % BUTTON_QUEUE_SIZE];
+        tail++;
+        return true;
+    }
+
+    bool pressed() const { return stable; }
+    uint32_t bounceCount() const { return bounces; }
+    uint32_t glitchCount() const { return glitches; }
+    uint32_t dropCount() const { return dropped; }
+
+private:
+    // Confirm a burst that has been quiet for debounceMs
+    void IRAM_ATTR settle(uint32_t nowMs) {
+        if (!bursting || (int32_t)(nowMs - lastEdgeMs) < (int32_t)debounceMs) {
+            return;
+        }
+        bursting = false;
+        if (candidate == stable) {
+            glitches++;
+            return;
+        }
+        stable = candidate;
+        if ((uint8_t)(head - tail) >= BUTTON_QUEUE_SIZE) {
+            dropped++;
+            return;
+        }
+        ring[head % BUTTON_QUEUE_SIZE] = {burstMs, stable};
+        head++;
+    }
+
+    ButtonEvent ring[BUTTON_QUEUE_SIZE];
+    volatile uint8_t head = 0;      // Written by settle() only
+    volatile uint8_t tail = 0;      // Written by take() only
+    volatile uint32_t burstMs = 0;
+    volatile uint32_t lastEdgeMs = 0;
+    uint32_t complete = 0;
+    volatile bool candidate = false;
+    volatile bool stable = false;
+    volatile bool bursting = false;
+    uint16_t debounceMs = 50;
+    volatile uint32_t bounces = 0;
+    volatile uint32_t glitches = 0;
+    volatile uint32_t dropped = 0;
+};
+
+enum ButtonGesture : uint8_t {
+    GESTURE_NONE,
+    GESTURE_PRESS,      // Button went down (every press)
+    GESTURE_SHORT,
+    GESTURE_LONG,
+    GESTURE_DOUBLE
+};
+
+class ButtonGestures {
+public:
+    explicit ButtonGestures(uint16_t doublePressMs = BUTTON_DOUBLE_PRESS_MS) : doubleMs(doublePressMs) {}
+
+    // Events in order; returns the gesture the event completes, if any
+    ButtonGesture event(const ButtonEvent& event, uint16_t longPressMs) {
+        if (event.pressed) {
+            if (held) {
+                return GESTURE_NONE;
+            }
+            held = true;
+            longFired = false;
+            pressMs = event.ms;
+            secondPress = pendingShort && event.ms - pendingMs <= doubleMs;
+            pendingShort = false;
+            at = event.ms;
+            return GESTURE_PRESS;
+        }
+        if (!held) {
+            return GESTURE_NONE;
+        }
+        held = false;
+        if (longFired) {
+            return GESTURE_NONE;
+        }
+        if (event.ms - pressMs >= longPressMs) {
+            at = pressMs + longPressMs;  // Held long enough before the loop looked
+            return GESTURE_LONG;
+        }
+        at = event.ms;
+        if (doubleMs == 0) {
+            return GESTURE_SHORT;
+        }
+        if (secondPress) {
+            secondPress = false;
+            return GESTURE_DOUBLE;
+        }
+        pendingShort = true;
+        pendingMs = event.ms;
+        return GESTURE_NONE;
+    }
+
+    // A long press still held, or a short press whose double-press window has
+    // passed, as of nowMs
+    ButtonGesture poll(uint32_t nowMs, uint16_t longPressMs) {
+        if (held && !longFired && nowMs - pressMs >= longPressMs) {
+            longFired = true;
+            at = pressMs + longPressMs;
+            return GESTURE_LONG;
+        }
+        if (pendingShort && nowMs - pendingMs > doubleMs) {
+            pendingShort = false;
+            at = pendingMs;
+            return GESTURE_SHORT;
+        }
+        return GESTURE_NONE;
+    }
+
+    // When the last returned gesture happened (a long press: when it was reached)
+    uint32_t gestureMs() const { return at; }
+    bool isHeld() const { return held; }
+
+private:
+    uint16_t doubleMs;
+    uint32_t pressMs = 0;
+    uint32_t pendingMs = 0;     // Release of a short press that may start a double press
+    uint32_t at = 0;
+    bool held = false;
+    bool longFired = false;
+    bool pendingShort = false;
+    bool secondPress = false;
+};
+
+#endif
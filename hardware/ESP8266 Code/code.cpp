@@ -1,27 +1,8 @@
-#include <SPI.h>
-#include <MFRC522.h>
-#include <LiquidCrystal_I2C.h>
+// CuraLink bed controller firmware.
+// One codebase for every bed unit; the feature set (network uplink, LCD,
+// RFID workflow, persistence) is chosen at compile time in firmwareProfile.h.
+
 #include <Wire.h>
-#include <Adafruit_MLX90614.h>
-#include <ESP8266WiFi.h>
-#include <Firebase_ESP_Client.h>
-#include <time.h>
-#include "addons/TokenHelper.h"
-#include "addons/RTDBHelper.h"
-
-// Utility function for median calculation - must be before any other code
-template<typename T>
-inline T medianOf3(T a, T b, T c) {
-    if (a > b) {
-        if (b > c) return b;        // a > b > c
-        if (a > c) return c;        // a > c > b
-        return a;                   // c > a > b
-    } else {
-        if (a > c) return a;        // b > a > c
-        if (b > c) return c;        // b > c > a
-        return b;                   // c > b > a
-    }
-}
 
 // ------------------ Configurations ------------------
 #define WIFI_SSID       "Exorev's Phone 2a"
@@ -32,300 +13,367 @@ inline T medianOf3(T a, T b, T c) {
 #define USER_PASSWORD   "ekansh@123"
 
 #define BED_ID          1
+#ifndef BED_COUNT
+#define BED_COUNT       1     // Beds on this controller, numbered from BED_ID (2-4: see bedHardware.h)
+#endif
+#define MESH_CHANNEL    1     // FEATURE_MESH only: WiFi channel shared by all beds and the AP
 
 // Pins
 #define SS_PIN          D8
 #define RST_PIN         D3
 #define FSR_PIN         A0
-#define CLEAN_BTN       D4
+#define CLEAN_BTN       D4    // Single bed; more beds have their buttons and LEDs on the I2C panel
 #define LED_PIN         D0
+// FEATURE_FSR_ZONES only: 74HC4051 select lines, the mux output goes to FSR_PIN
+#define FSR_MUX_S0      D5
+#define FSR_MUX_S1      D6
+#define FSR_MUX_S2      D7
 
-// Thresholds
-#define FSR_THRESHOLD   50
-#define TEMP_THRESHOLD  32
-#define LONG_PRESS_TIME 3000  // ms
-// Timing
-#define DEBOUNCE_DELAY      50     // ms
+// Thresholds and timing defaults, tunable at runtime: bedConfig.h
+// Timing - fixed
+#define DEBOUNCE_DELAY      50     // ms - a button level counts once its edges stop this long
 #define BUTTON_READ_DELAY   5      // ms - Reduced for better RFID response
-#define FIREBASE_UPDATE_INTERVAL 2000  // ms
-
-// System States
-enum SystemState {
-  NORMAL,           // 0: Normal operation showing bed status + sensors
-  CLEANING,         // 1: Cleaning in progress
-  VERIFY_CLEAN,     // 2: Waiting for card to verify cleaning
-  DISCHARGE_PROMPT, // 3: Asking for discharge confirmation
-  DISCHARGE_VERIFY, // 4: Waiting for card to confirm discharge
-  SHOW_STAFF_ID     // 5: Showing staff ID for 2 seconds
-};
+#define NTP_RESYNC_INTERVAL 3600000    // ms - SNTP re-sync period, each sync refines the drift estimate
+#define CONFIG_POLL_INTERVAL 60000     // ms - how often the uplink checks for new settings
 
-// Bed States for Firebase
-enum BedStatus {
-  UNOCCUPIED = 0,
-  OCCUPIED = 1,
-  UNOCCUPIED_CLEANING = 2,
-  OCCUPIED_CLEANING = 3,
-  UNASSIGNED = 4
-};
+#include "firmwareProfile.h"
+#include "bedState.h"
+#include "sensorMath.h"
+#include "i2cBus.h"
+#include "eventLog.h"
+#include "bedConfig.h"
+#include "occupancyCalibration.h"
+#include "timeSync.h"
+#include "bedDisplay.h"
+#include "staffCardReader.h"
+#include "bedUplink.h"
+#include "uplinkBatch.h"
+#include "meshRelay.h"
+#include "lanPush.h"
+#include "fsrZones.h"
+#include "fsrCapture.h"
+#include "bedController.h"
+#include "bedHardware.h"
+#include "hourlyAggregates.h"
+#include "rtcRecord.h"
+#include "bedSnapshot.h"
+#include "probeTimers.h"
+#include "otaUpdate.h"
+
+// One MLX90614 per bed; beyond the first each is set to its own SMBus address (EEPROM 0x0E)
+static const uint8_t MLX_ADDRESSES[BED_COUNT_MAX] = {MLX_I2C_ADDRESS, 0x5B, 0x5C, 0x5D};
+
+#if BED_COUNT < 1 || BED_COUNT > BED_COUNT_MAX
+#error "BED_COUNT must be 1-4"
+#endif
+#if BED_COUNT > 1 && (FEATURE_FSR_ZONES || FEATURE_FSR_CAPTURE)
+#error "FSR zones and high-rate capture need A0; a multi-bed controller reads its FSRs through the ADS1115"
+#endif
+#if BED_COUNT > 1 && FEATURE_MESH
+#error "A mesh node relays a single bed; a multi-bed controller keeps its own uplink"
+#endif
+
+#if FEATURE_LAN_PUSH && !FEATURE_NETWORK
+#error "FEATURE_LAN_PUSH serves subscribers over the WiFi station link; build with FEATURE_NETWORK"
+#endif
+
+#if FEATURE_FSR_ZONES && FEATURE_RFID
+#error "FEATURE_FSR_ZONES drives the multiplexer from the RC522's SPI pins (D5-D7); build without RFID"
+#endif
+#if FEATURE_FSR_ZONES && FEATURE_FSR_CAPTURE
+#error "FEATURE_FSR_CAPTURE samples a single FSR on A0, which FEATURE_FSR_ZONES multiplexes"
+#endif
 
 // Variables
-MFRC522 mfrc522(SS_PIN, RST_PIN);
-LiquidCrystal_I2C lcd(0x27, 16, 2);
-Adafruit_MLX90614 mlx;
-
-FirebaseData fbdo;
-FirebaseAuth auth;
-FirebaseConfig config;
-bool firebaseConnected = false;
-
-// Firebase last known values for change detection
-static BedStatus lastStatus = UNASSIGNED;
-static int lastFsrVal = 0;
-static float lastTemp = 0;
-static bool lastHasBodyTemp = false;
-static bool lastHasWeight = false;
-static bool lastIsOccupied = false;
-static unsigned long lastUpdateTime = 0;
+EventLog eventLog;  // Hot-path logging, drained to Serial from the loop
+#if FEATURE_PROBES
+ProbeTable probes;  // Timing histograms of the PROBE() sites, dumped by `prof`
+#endif
+I2cBus i2cBus;  // Shared by the LCD, the MLX90614s and the multi-bed ADC/panel
+StaffCardReader<FEATURE_RFID> cardReader(SS_PIN, RST_PIN);
+BedDisplay<FEATURE_DISPLAY> lcd(i2cBus);
+FsrZones<FEATURE_FSR_ZONES> fsrZones(FSR_PIN, FSR_MUX_S0, FSR_MUX_S1, FSR_MUX_S2);
+FsrCapture<FEATURE_FSR_CAPTURE> fsrCapture(FSR_PIN);  // Breathing/motion features, one record per minute
+#if BED_COUNT == 1
+BedHardware<1> bedHardware(i2cBus, CLEAN_BTN, LED_PIN, DEBOUNCE_DELAY);
+#else
+BedHardware<BED_COUNT> bedHardware(i2cBus, DEBOUNCE_DELAY);
+#endif
 
-String staff1 = "B310C2F5";  // Staff UID 1 - Full length UID
-String staff2 = "63870DFC";  // Staff UID 2 - Full length UID
+// Runtime settings - read on the hot path through configStore.get()
+BedConfigStore configStore(DEFAULT_SETTINGS);
 
-// System state variables
-SystemState currentState = NORMAL;
-SystemState previousState = NORMAL;  // To track where to return after showing staff ID
-bool bedOccupied = false;
-bool prevOccupied = false;
-bool bedIsUnassigned = false;  // Track unassigned state
+// Timekeeping - every event is stamped with monotonic device time
+TimeSync timeSync;
+BedUplink<FEATURE_NETWORK> uplink(timeSync);
+// This controller's records wait here for a multi-path update, within their class's latency budget
+UplinkBatch<BedRecord, BED_COUNT> uplinkBatch;
+MeshRelay<FEATURE_MESH> mesh(uplink, timeSync);  // Only the elected gateway bed holds a cloud session
+// Delta firmware updates announced under /ota
+OtaUpdate<FEATURE_OTA> ota(uplink, timeSync);
+// Bed records straight to nurse-station displays on the LAN
+LanPush<FEATURE_LAN_PUSH, BED_COUNT> lanPush;
 
-// Button handling
-int buttonState = HIGH;
-int lastButtonState = HIGH;
-unsigned long pressedTime = 0;
-bool isPressing = false;
-bool longPressDetected = false;
+// Exit risk last sent (FSR zones, single bed only)
+static bool lastExitRisk = false;
+// Beds whose workflow published since the last updateFirebase()
+static uint8_t workflowPublished = 0;
+
+String staff1 = "B310C2F5";  // Staff UID 1 - Full length UID
+String staff2 = "63870DFC";  // Staff UID 2 - Full length UID
 
 // Timers
-unsigned long lastSensorCheck = 0;
 unsigned long lastFirebaseUpdate = 0;
-unsigned long stateTimer = 0;
-unsigned long ledTimer = 0;
 unsigned long lastRFIDCheck = 0;  // Add RFID timing
-bool ledOn = false;
-
-// Staff ID display
-String currentStaffId = "";
 
 // Forward declarations of functions
-void initializeWiFiAndFirebase();
-void handleButton();
-void handleShortPress();
-void handleLongPress();
+void handleButtons();
+void saveState();
 void readSensors();
+centi_t readMlxCenti(uint8_t address, uint8_t reg);
 void processRFID();
-void handleStaffCard();
+uint8_t cardBed();
 void handleStateTimeouts();
 void updateDisplay();
-BedStatus getBedStatus();
-void updateFirebase();
+void drawBedOverview();
+void updateFirebase(bool exitChanged = false);
+UplinkClass uplinkClass(uint8_t slot, bool exitDue, bool published, const BedSettings& settings, unsigned long now);
+bool sendRecords(const BedRecord* records, uint8_t count);
+void flushUplink();
+void pushLan();
+void reportExitRisk();
+void reportRespiration(const RespirationMinute& minute);
+void updateHourly();
+void reportHours();
 void updateLED();
+bool workflowsIdle();
+EventStamp eventStamp();
+void openTrace(uint8_t slot, unsigned long sampleMillis);
+void showProgress(TextId message);
+void updateLoopStats(unsigned long loopStartMicros);
+void processSerialCommands();
+void handleSerialCommand(char* line);
+int bedSlot(const char* bedNumber);
+
+// What a bed's workflow does to the shared LCD, uplink, traces and log
+struct BedIo {
+    void show(uint8_t slot, TextId line1, TextId line2, uint32_t holdMs);
+    void redraw(uint8_t) { updateDisplay(); }
+    void publish(uint8_t slot) {
+        workflowPublished |= 1 << slot;
+        updateFirebase();
+    }
+    void trace(uint8_t slot, uint32_t sampleMs) { openTrace(slot, sampleMs); }
+
+    template<typename... Args>
+    void log(uint8_t slot, LogId id, const Args&... args) {
+        // With several beds the log names the bed whenever it changes
+        if constexpr (BED_COUNT > 1) {
+            if (slot != loggedSlot) {
+                loggedSlot = slot;
+                LOG(LOG_BED, BED_ID + slot);
+            }
+        }
+        LOG(id, args...);
+    }
+
+    uint8_t loggedSlot = 0xFF;
+};
+typedef BedController<BedIo> Bed;
+
+// Per-bed workflow, samples and calibration
+BedIo bedIo;
+Bed beds[BED_COUNT];
+uint8_t activeBed = 0;  // Bed whose button or card was used last; its workflow has the LCD
+// Workflow state in RTC memory on every change, mirrored to flash (bedSnapshot.h)
+StateKeeper<BED_COUNT, RtcRecord<FEATURE_PERSISTENCE>, FlashRecord<FEATURE_PERSISTENCE>> stateKeeper;
+
+// Per-bed hourly occupancy/cleaning aggregates for the forecast backend
+HourlyAggregates bedHours[BED_COUNT];
+
+// LED blink state per bed
+unsigned long ledTimer[BED_COUNT] = {};
+bool ledOn[BED_COUNT] = {};
+
+#if FEATURE_NETWORK
+// Override the core's SNTP update period (default is one hour)
+uint32_t sntp_update_delay_MS_rfc_not_less_than_15000() {
+    return NTP_RESYNC_INTERVAL;
+}
+#endif
 
 void setup() {
-    // Disable WiFi sleep mode for better stability
-    WiFi.setSleepMode(WIFI_NONE_SLEEP);
-    
+    // Resume the workflow a reset interrupted before anything else runs
+    SnapshotSource resumed = stateKeeper.restore();
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        beds[i].restore(stateKeeper.bed(i), millis(), stateKeeper.timersKnown());
+    }
+
     delay(2000);  // Give the ESP8266 time to fully start up
     Serial.begin(115200);
-    Serial.println("\nStarting...");
+    Serial.println(F("\nStarting... (profile: " PROFILE_NAME ")"));
+    // A new firmware image that keeps crashing is rolled back here
+    ota.begin(BED_ID);
+    
+    // Load tuned settings before anything samples or times out
+    configStore.begin();
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        beds[i].begin(&bedIo, i);
+        if (resumed != SNAPSHOT_NONE) {
+            bedIo.log(i, LOG_STATE_RESUMED, snapshotSourceName(resumed), (int)beds[i].state(),
+                      (int)beds[i].isUnassigned());
+        }
+    }
     
     // Initialize pins
-    pinMode(LED_PIN, OUTPUT);
-    pinMode(CLEAN_BTN, INPUT_PULLUP);
-    digitalWrite(LED_PIN, LOW);
+    fsrZones.begin();
+    fsrCapture.begin();
     
     // Set CPU frequency to 160MHz for better stability
     system_update_cpu_freq(160);
     
-    // Initialize I2C for LCD and MLX
-    Wire.begin(D2, D1);
-    Wire.setClock(100000);  // Slow down I2C for reliability
+    // Initialize I2C for LCD and MLX - starts at 100 kHz and adapts (see i2cBus.h)
+    i2cBus.begin(D2, D1);
     delay(100);
     
     // Initialize LCD
-    lcd.init();
-    lcd.backlight();
-    lcd.clear();
-    lcd.print("Starting up...");
+    lcd.begin();
+    lcd.print(TEXT_STARTING_UP);
+    lcd.refresh();
     delay(100);
     
-    // Initialize SPI for RFID
-    SPI.begin();
-    delay(100);  // Give SPI time to stabilize
-    
-    // Initialize RFID
-    mfrc522.PCD_Init();
-    delay(100);  // Give RFID time to stabilize
-    
-    // Test RFID communication
-    byte version = mfrc522.PCD_ReadRegister(mfrc522.VersionReg);
-    if (version == 0x00 || version == 0xFF) {
-        Serial.println("WARNING: RFID Reader may not be properly connected");
+    // Buttons and LEDs (and the FSR ADC when there are several beds)
+    if (!bedHardware.begin()) {
+        Serial.println(F("WARNING: Bed ADC/panel not responding"));
         lcd.clear();
-        lcd.print("RFID Error!");
-        delay(2000);
+        lcd.print(TEXT_BED_IO_ERROR);
+        lcd.pause(2000);
     }
     
-    Serial.println("RFID Reader Initialized");
-    Serial.print("RFID Version: 0x");
-    Serial.println(version, HEX);
+    if constexpr (FEATURE_RFID) {
+        // Initialize RFID and test communication
+        byte version = cardReader.begin();
+        if (version == 0x00 || version == 0xFF) {
+            Serial.println(F("WARNING: RFID Reader may not be properly connected"));
+            lcd.clear();
+            lcd.print(TEXT_RFID_ERROR);
+            lcd.pause(2000);
+        }
+        
+        Serial.println(F("RFID Reader Initialized"));
+        Serial.print(F("RFID Version: 0x"));
+        Serial.println(version, HEX);
+    }
     
-    if (!mlx.begin()) {
-        lcd.clear();
-        lcd.print("MLX Error");
-        Serial.println("MLX90614 initialization failed");
-        while (true);
+    // A missing MLX90614 leaves that bed on weight alone (sensorHealth.h);
+    // the fault clears by itself if the sensor starts answering
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        if (readMlxCenti(MLX_ADDRESSES[i], MLX_REG_AMBIENT) == CENTI_INVALID) {
+            beds[i].temperatureHealth().fail(FAULT_ERRORS);
+            lcd.clear();
+            lcd.print(TEXT_MLX_ERROR);
+            if (BED_COUNT > 1) {
+                lcd.print(" ");
+                lcd.print(TEXT_BED_PREFIX);
+                lcd.print(BED_ID + i);
+            }
+            lcd.setCursor(0, 1);
+            lcd.print(TEXT_WEIGHT_ONLY);
+            lcd.pause(2000);
+            Serial.printf_P(PSTR("MLX90614 initialization failed (0x%02X), weight only\n"), MLX_ADDRESSES[i]);
+        }
     }
     
     // Small delay for sensors to stabilize
     delay(100);
     
-    initializeWiFiAndFirebase();
+    if constexpr (FEATURE_MESH) {
+        mesh.begin(BED_ID, showProgress);
+        if (mesh.promoted()) {
+            uplink.connect(BED_ID, showProgress, MESH_CONNECT_TIMEOUT_MS);  // loop() carries it on
+        }
+    } else {
+        uplink.begin(BED_ID, showProgress);
+    }
+    lanPush.begin();
     
     lcd.clear();
-    lcd.print("System Ready");
-    delay(1000); // Reduced delay
+    lcd.print(TEXT_SYSTEM_READY);
+    lcd.pause(1000); // Reduced delay
     
     // Initial sensor reading and display
     readSensors();
     updateDisplay();
     
-    Serial.println("Setup complete - RFID should work now");
-}
-
-void initializeWiFiAndFirebase() {
-    lcd.clear();
-    lcd.print("Connecting WiFi...");
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(300); // Reduced delay
-        Serial.print(".");
-    }
-    Serial.println("\nWiFi Connected");
-    
-    lcd.clear();
-    lcd.print("Syncing time...");
-    configTime(5 * 3600 + 1800, 0, "pool.ntp.org", "time.google.com");
-    
-    time_t now = 0;
-    int retries = 0;
-    while (now < 100000) {
-        delay(300); // Reduced delay
-        now = time(nullptr);
-        retries++;
-        if (retries > 15) break; // Reduced retries
-    }
-    
-    lcd.clear();
-    lcd.print("Init Firebase...");
-    
-    config.api_key = API_KEY;
-    config.database_url = DATABASE_URL;
-    auth.user.email = USER_EMAIL;
-    auth.user.password = USER_PASSWORD;
-    
-    // Increase timeouts for better stability
-    config.timeout.serverResponse = 10000;
-    config.timeout.socketConnection = 7000;
-    config.timeout.sslHandshake = 7000;
-    config.cert.data = nullptr;
-    
-    // Enable auto retry on failure
-    Firebase.RTDB.setMaxRetry(&fbdo, 3);
-    Firebase.RTDB.setMaxErrorQueue(&fbdo, 30);
-    
-    Firebase.begin(&config, &auth);
-    Firebase.reconnectWiFi(true);
-    
-    // Wait for initial connection
-    while (!Firebase.ready()) {
-        delay(100);
-        yield();
-    }
-    
-    // Initialize the database structure if needed
-    FirebaseJson initialJson;
-    initialJson.add("initialized", true);
-    initialJson.add("lastBootTime", time(nullptr));
-    
-    String initPath = "/beds/bed" + String(BED_ID);
-    if (Firebase.RTDB.setJSON(&fbdo, initPath.c_str(), &initialJson)) {
-        Serial.println("Initial database structure created successfully");
-    } else {
-        Serial.println("Failed to create initial structure: " + fbdo.errorReason());
-    }
+    Serial.println(F("Setup complete"));
 }
 
 void loop() {
     static unsigned long lastRFIDCheck = 0;
     static unsigned long lastYield = 0;
+    unsigned long loopStart = micros();
     unsigned long currentMillis = millis();
     
+    // FSR zones are scanned on their own fixed grid; an exit risk goes out first
+    fsrZones.service(loopStart, currentMillis);
+    bedHardware.service(currentMillis);
+    if (fsrZones.takeExitChange()) {
+        reportExitRisk();
+    }
+    fsrCapture.poll();
+    RespirationMinute minute;
+    if (fsrCapture.takeMinute(minute)) {
+        reportRespiration(minute);
+    }
+    
     // Give WiFi stack time to process every 50ms
     if (currentMillis - lastYield >= 50) {
         yield();
         lastYield = currentMillis;
     }
     
+    // Keep the monotonic clock extended and apply any new NTP sample
+    timeSync.monotonicMs(currentMillis);
+    {
+        PROBE(PROBE_UPLINK_POLL);
+        uplink.poll();
+        uplink.pollSettings(configStore);
+    }
+    mesh.poll();
+    if (mesh.promoted()) {
+        // Failover: connects from uplink.poll() while the bed keeps running; the
+        // mesh hands the role on if it cannot reach Firebase in time
+        uplink.connect(BED_ID, showProgress, MESH_CONNECT_TIMEOUT_MS);
+    } else if (mesh.demoted()) {
+        uplink.end();
+        uplinkBatch.clear();  // The mesh heartbeat sends these beds again
+    }
+    processSerialCommands();
+    // Firmware updates download in the background and switch between workflows
+    ota.poll(workflowsIdle(), uplink.ready());
+    
     // Check for RFID card every 100ms to prevent overwhelming the SPI bus
-    if (currentMillis - lastRFIDCheck >= 100) {
-        lastRFIDCheck = currentMillis;
-        
-        if (mfrc522.PICC_IsNewCardPresent()) {
-            delay(10);  // Small delay for stability
-            
-            if (mfrc522.PICC_ReadCardSerial()) {
-                String uid = "";
-                for (byte i = 0; i < mfrc522.uid.size; i++) {
-                    if (mfrc522.uid.uidByte[i] < 0x10) uid += "0";
-                    uid += String(mfrc522.uid.uidByte[i], HEX);
-                }
-                uid.toUpperCase();
-                
-                Serial.println("Card detected! UID: " + uid);
-                
-                if (uid == staff1 || uid == staff2) {
-                    currentStaffId = uid;
-                    Serial.println("Valid staff card: " + uid);
-                    handleStaffCard();
-                } else {
-                    Serial.println("Unknown card: " + uid);
-                    // Show access denied message for any invalid card
-                    lcd.clear();
-                    lcd.print("Access Denied!");
-                    delay(1000);
-                    
-                    // Return to appropriate state
-                    if (currentState == VERIFY_CLEAN) {
-                        currentState = CLEANING;
-                    }
-                    updateDisplay();
-                }
-                
-                mfrc522.PICC_HaltA();
-                mfrc522.PCD_StopCrypto1();
-            }
+    if constexpr (FEATURE_RFID) {
+        if (currentMillis - lastRFIDCheck >= 100) {
+            lastRFIDCheck = currentMillis;
+            processRFID();
         }
     }
     
     // Handle other operations with minimal delays
-    if (Firebase.ready() && !firebaseConnected) {
-        firebaseConnected = true;
-        Serial.println("Firebase connected");
+    if (uplink.justConnected()) {
         updateFirebase();
     }
 
-    handleButton();
+    // The button workflow needs staff cards to complete, so it goes with RFID
+    if constexpr (FEATURE_RFID) {
+        handleButtons();
+    }
     readSensors();
     handleStateTimeouts();
+    updateHourly();
+    saveState();
+    pushLan();
     
     // Update display and LED less frequently
     static unsigned long lastUIUpdate = 0;
@@ -340,360 +388,162 @@ void loop() {
         }
         lastUIUpdate = millis();
     }
+    
+    // Deferred bus work (LCD refresh) after the sensors have had the bus
+    {
+        PROBE(PROBE_I2C_SERVICE);
+        i2cBus.service();
+    }
+    {
+        PROBE(PROBE_LOG_DRAIN);
+        eventLog.drain();
+    }
 
     // Firebase updates
-    if (firebaseConnected && millis() - lastFirebaseUpdate > FIREBASE_UPDATE_INTERVAL) {
+    if ((uplink.ready() || mesh.relaying()) && millis() - lastFirebaseUpdate > configStore.get().uplinkIntervalMs) {
         updateFirebase();
+        reportHours();
         lastFirebaseUpdate = millis();
     }
+    flushUplink();
+    
+    updateLoopStats(loopStart);
     
     // Minimal delay to prevent WDT resets
     delay(1);
     yield();
 }
 
-void handleButton() {
-    static unsigned long lastPressTime = 0;
-    static bool longPressHandled = false;
-    int reading = digitalRead(CLEAN_BTN);
-    unsigned long currentTime = millis();
-    
-    // Button is pressed (LOW)
-    if (reading == LOW) {
-        // Initial press detection
-        if (!isPressing) {
-            lastPressTime = currentTime;
-            pressedTime = currentTime;
-            isPressing = true;
-            longPressDetected = false;
-            longPressHandled = false;
-            Serial.println("Button pressed");
-        }
-        
-        // Check for long press while button is held
-        if (isPressing && !longPressHandled && (currentTime - pressedTime) >= LONG_PRESS_TIME) {
-            longPressDetected = true;
-            longPressHandled = true;
-            handleLongPress();
-            updateDisplay();
-        }
-    }
-    // Button is released (HIGH)
-    else if (reading == HIGH && isPressing) {
-        unsigned long pressDuration = currentTime - pressedTime;
-        isPressing = false;
-        
-        // Only handle short press if it wasn't a long press
-        if (!longPressHandled && pressDuration < LONG_PRESS_TIME) {
-            handleShortPress();
-            Serial.println("Short press handled");
-            updateDisplay();
+void handleButtons() {
+    PROBE(PROBE_BUTTONS);
+    const BedSettings& settings = configStore.get();
+    ButtonEvent event;
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        while (bedHardware.takeButton(i, event)) {
+            if (event.pressed) {
+                activeBed = i;  // Staff are at this bed: its workflow takes the LCD
+            }
+            beds[i].buttonEvent(event, settings);
         }
-        
-        // Reset states
-        longPressDetected = false;
-        longPressHandled = false;
+        beds[i].buttonPoll(bedHardware.buttonsUntil(i), settings);
     }
 }
 
-void handleShortPress() {
-    Serial.println("Short press detected, current state: " + String(currentState));
-    
-    switch (currentState) {
-        case NORMAL:
-            // Start cleaning only if not unassigned
-            if (!bedIsUnassigned) {
-                currentState = CLEANING;
-                Serial.println("=== Cleaning Mode Started ===");
-                // Force immediate Firebase update
-                updateFirebase();
-                // Add feedback
-                lcd.clear();
-                lcd.print("Cleaning Mode");
-                lcd.setCursor(0, 1);
-                lcd.print("Started!");
-                delay(500);  // Brief visual feedback
-            }
-            break;
-            
-        case CLEANING:
-            // Move to verification state and start timer
-            currentState = VERIFY_CLEAN;
-            stateTimer = millis();  // Start the 5-second timeout timer
-            Serial.println("Waiting for staff card verification");
-            // Force immediate Firebase update
-            updateFirebase();
-            // Add feedback
-            lcd.clear();
-            lcd.print("Tap Staff Card");
-            lcd.setCursor(0, 1);
-            lcd.print("to Verify");
-            break;
-            
-        case VERIFY_CLEAN:
-            // Add ability to cancel verification and go back to cleaning
-            currentState = CLEANING;
-            Serial.println("Verification cancelled, back to cleaning");
-            // Add feedback
-            lcd.clear();
-            lcd.print("Verification");
-            lcd.setCursor(0, 1);
-            lcd.print("Cancelled");
-            delay(500);  // Brief visual feedback
-            break;
-            
-        default:
-            // Give feedback even when ignoring
-            lcd.clear();
-            lcd.print("Button press");
-            lcd.setCursor(0, 1);
-            lcd.print("not allowed here");
-            delay(500);  // Brief visual feedback
-            break;
+// Every state change reaches RTC memory in the pass that made it
+void saveState() {
+    PROBE(PROBE_STATE);
+    uint32_t now = millis();
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        stateKeeper.update(i, beds[i].snapshot(now));
     }
+    stateKeeper.commit(now);
 }
 
-void handleLongPress() {
-    Serial.println("Long press detected");
-    
-    if (currentState == NORMAL && !bedIsUnassigned) {
-        // Start discharge process
-        currentState = DISCHARGE_PROMPT;
-        stateTimer = millis();
-        Serial.println("Starting discharge process");
-        
-        // Provide immediate visual feedback
-        lcd.clear();
-        lcd.print("Discharge Mode");
-        lcd.setCursor(0, 1);
-        lcd.print("Tap card to conf.");
-        
-        // Force immediate Firebase update to reflect state change
-        updateFirebase();
-    } else {
-        // Provide feedback when long press is not valid
-        lcd.clear();
-        lcd.print("Long press not");
-        lcd.setCursor(0, 1);
-        lcd.print("allowed here");
-        delay(1000);  // Show message briefly
+void BedIo::show(uint8_t, TextId line1, TextId line2, uint32_t holdMs) {
+    lcd.clear();
+    lcd.print(line1);
+    lcd.setCursor(0, 1);
+    lcd.print(line2);
+    if (holdMs > 0) {
+        lcd.pause(holdMs);  // Brief visual feedback
     }
 }
 
 void readSensors() {
-    static int fsrReadings[3] = {0, 0, 0};
-    static float tempReadings[3] = {0, 0, 0};
-    static uint8_t readingIndex = 0;
-    static unsigned long unoccupiedStartTime = 0;
-    const unsigned long UNOCCUPIED_CONFIRM_TIME = 2000; // 2 seconds to confirm unoccupied
-    
-    if (millis() - lastSensorCheck > 500) {  // Check every 500ms
-        // Single readings
-        fsrReadings[readingIndex] = analogRead(FSR_PIN);
-        tempReadings[readingIndex] = mlx.readObjectTempC();
-        readingIndex = (readingIndex + 1) % 3;
-        
-        // Get current values using median filtering
-        int fsrVal = medianOf3(fsrReadings[0], fsrReadings[1], fsrReadings[2]);
-        float temp = medianOf3(tempReadings[0], tempReadings[1], tempReadings[2]);
-        
-        if (!bedIsUnassigned) {
-            // Check occupancy conditions
-            bool weightDetected = fsrVal > FSR_THRESHOLD;
-            bool tempDetected = temp > TEMP_THRESHOLD;  // Must be above 32°C
-            bool newOccupancyState = weightDetected && tempDetected;  // BOTH must be true
-            
-            if (newOccupancyState && !bedOccupied) {
-                prevOccupied = bedOccupied;
-                bedOccupied = true;
-                Serial.printf("Bed now OCCUPIED - Weight: %d, Temp: %.2f (both above threshold)\n", 
-                            fsrVal, temp);
-                unoccupiedStartTime = 0;
-            } 
-            else if (!newOccupancyState && bedOccupied) {
-                if (unoccupiedStartTime == 0) {
-                    unoccupiedStartTime = millis();
-                } 
-                else if (millis() - unoccupiedStartTime > UNOCCUPIED_CONFIRM_TIME) {
-                    prevOccupied = bedOccupied;
-                    bedOccupied = false;
-                    if (prevOccupied) {
-                        Serial.println("Occupancy changed: UNOCCUPIED");
-                    }
-                    unoccupiedStartTime = 0;
-                }
-            } 
-            else {
-                unoccupiedStartTime = 0;
-            }
-        }
-        
-        lastSensorCheck = millis();
-    }
-}
+    PROBE(PROBE_SENSORS);
+    const BedSettings& settings = configStore.get();
 
-void processRFID() {
-    // Check for new card every loop iteration - no timing restrictions
-    if (mfrc522.PICC_IsNewCardPresent() && mfrc522.PICC_ReadCardSerial()) {
-        String uid = "";
-        for (byte i = 0; i < mfrc522.uid.size; i++) {
-            if (mfrc522.uid.uidByte[i] < 0x10) uid += "0";
-            uid += String(mfrc522.uid.uidByte[i], HEX);
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        Bed& bed = beds[i];
+        unsigned long sampleTime = millis();
+        if (!bed.sampleDue(sampleTime, settings)) {
+            continue;
         }
-        uid.toUpperCase();
-
-        Serial.println("RFID DETECTED: " + uid);
-
-        if (uid == staff1 || uid == staff2) {
-            currentStaffId = uid;
-            Serial.println("VALID STAFF CARD: " + uid);
-            handleStaffCard();
+        int fsr;
+        if constexpr (FEATURE_FSR_CAPTURE) {
+            fsr = fsrCapture.latest();
+        } else if constexpr (BED_COUNT == 1) {
+            fsr = fsrZones.read();
         } else {
-            Serial.println("Unknown card: " + uid);
-            // Show access denied message for any invalid card
-            lcd.clear();
-            lcd.print("Access Denied!");
-            delay(1000);
-            
-            // Return to appropriate state
-            if (currentState == VERIFY_CLEAN) {
-                currentState = CLEANING;
-            }
-            updateDisplay();
+            fsr = bedHardware.fsr(i);
         }
-
-        mfrc522.PICC_HaltA();
-        mfrc522.PCD_StopCrypto1();
-        // No delay here, let loop handle timing
+        centi_t objectCenti = readMlxCenti(MLX_ADDRESSES[i], MLX_REG_OBJECT);
+        centi_t ambientCenti = bed.ambientDue() ? readMlxCenti(MLX_ADDRESSES[i], MLX_REG_AMBIENT) : AMBIENT_INVALID;
+        bed.sample(fsr, objectCenti, ambientCenti, sampleTime, settings);
     }
+    fsrZones.setLearning(!beds[0].isOccupied());
 }
 
-void handleStaffCard() {
-    Serial.println("Valid staff card detected in state: " + String(currentState));
+void processRFID() {
+    PROBE(PROBE_RFID);
+    String uid;
+    if (!cardReader.readCard(uid)) {
+        return;
+    }
+    unsigned long now = millis();
     
-    switch (currentState) {
-        case VERIFY_CLEAN:
-            // Show staff ID first, then complete cleaning
-            previousState = VERIFY_CLEAN;
-            currentState = SHOW_STAFF_ID;
-            stateTimer = millis();
-            Serial.println("Showing staff ID, then completing cleaning");
-            break;
-            
-        case DISCHARGE_VERIFY:
-            // Show staff ID first, then discharge
-            previousState = DISCHARGE_VERIFY;
-            currentState = SHOW_STAFF_ID;
-            stateTimer = millis();
-            Serial.println("Showing staff ID, then discharging");
-            break;
-            
-        case DISCHARGE_PROMPT:
-            // Show staff ID first, then move to verification
-            previousState = DISCHARGE_PROMPT;
-            currentState = SHOW_STAFF_ID;
-            stateTimer = millis();
-            Serial.println("Showing staff ID, then discharge verification");
-            break;
-            
-        case NORMAL:
-            // If bed is unassigned, staff can reassign it
-            if (bedIsUnassigned) {
-                bedIsUnassigned = false;
-                bedOccupied = false;
-                currentState = SHOW_STAFF_ID;
-                previousState = NORMAL;
-                stateTimer = millis();
-                Serial.println("Bed reassigned by staff: " + currentStaffId);
-            }
-            break;
-            
-        default:
-            Serial.println("RFID ignored in current state");
-            break;
+    LOG(LOG_CARD_DETECTED, uid);
+    activeBed = cardBed();
+    Bed& bed = beds[activeBed];
+    
+    if (uid == staff1 || uid == staff2) {
+        LOG(LOG_CARD_VALID, uid);
+        bed.staffCard(uid.c_str(), now);
+    } else {
+        LOG(LOG_CARD_UNKNOWN, uid);
+        // Show access denied message for any invalid card
+        lcd.clear();
+        lcd.print(TEXT_ACCESS_DENIED);
+        lcd.pause(1000);
+        
+        // Return to appropriate state
+        bed.cardRejected(now);
+        updateDisplay();
+    }
+}
+
+// The one reader serves every bed. A card goes to the active bed if it is
+// waiting for one, else to the first bed that is, else to the active bed
+// (which reassigns it when it is unassigned).
+uint8_t cardBed() {
+    if (beds[activeBed].awaitingCard()) {
+        return activeBed;
+    }
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        if (beds[i].awaitingCard()) {
+            return i;
+        }
     }
+    return activeBed;
 }
 
 void handleStateTimeouts() {
     unsigned long currentTime = millis();
-    
-    switch (currentState) {
-        case VERIFY_CLEAN:
-            if (currentTime - stateTimer > 5000) { // 5 second timeout - go back to cleaning
-                lcd.clear();
-                lcd.print("Timeout!");
-                delay(1000);
-                currentState = CLEANING;
-                Serial.println("Cleaning verification timeout - returning to cleaning state");
-                updateDisplay();
-            }
-            break;
-            
-        case DISCHARGE_PROMPT:
-            if (currentTime - stateTimer > 5000) { // 5 second timeout
-                currentState = NORMAL;
-                Serial.println("Discharge prompt timeout");
-            }
-            break;
-            
-        case DISCHARGE_VERIFY:
-            if (currentTime - stateTimer > 10000) { // 10 second timeout
-                currentState = NORMAL;
-                Serial.println("Discharge verification timeout");
-            }
-            break;
-            
-        case SHOW_STAFF_ID:
-            if (currentTime - stateTimer > 2000) { // 2 second display
-                // Handle what happens after showing staff ID
-                if (previousState == VERIFY_CLEAN) {
-                    // Complete cleaning
-                    lcd.clear();
-                    lcd.print("Cleaning");
-                    lcd.setCursor(0, 1);
-                    lcd.print("Completed!");
-                    delay(1000);
-                    currentState = NORMAL;
-                    Serial.println("Cleaning verified, back to normal");
-                    
-                } else if (previousState == DISCHARGE_VERIFY) {
-                    // Complete discharge - set bed to unassigned
-                    bedIsUnassigned = true;
-                    bedOccupied = false;  // Force unoccupied state
-                    currentState = NORMAL;
-                    Serial.println("Discharge confirmed, bed set to UNASSIGNED");
-                    // Force Firebase update immediately
-                    updateFirebase();
-                    
-                } else if (previousState == DISCHARGE_PROMPT) {
-                    // Move to discharge verification
-                    currentState = DISCHARGE_VERIFY;
-                    stateTimer = millis();
-                    Serial.println("Moving to discharge verification");
-                    
-                } else {
-                    // Return to normal
-                    currentState = NORMAL;
-                }
-            }
-            break;
+    const BedSettings& settings = configStore.get();
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        beds[i].timeouts(currentTime, settings);
     }
 }
 
 void updateDisplay() {
+    PROBE(PROBE_DISPLAY);
     static SystemState lastDisplayState = (SystemState)-1;
-    static bool lastOccupiedDisplay = !bedOccupied;
-    static bool lastUnassignedDisplay = !bedIsUnassigned;
+    static bool lastOccupiedDisplay = false;
+    static bool lastUnassignedDisplay = false;
     static BedStatus lastBedStatus = (BedStatus)-1;
+    static uint8_t lastDisplayBed = 0xFF;
     
-    // Get current bed status
-    BedStatus currentBedStatus = getBedStatus();
+    // With several beds the LCD follows the bed last used
+    const Bed& bed = beds[activeBed];
+    SystemState currentState = bed.state();
+    BedStatus currentBedStatus = bed.status();
     
     // Update display only if something has changed
     if (currentState == lastDisplayState && 
-        bedOccupied == lastOccupiedDisplay && 
-        bedIsUnassigned == lastUnassignedDisplay && 
+        bed.isOccupied() == lastOccupiedDisplay && 
+        bed.isUnassigned() == lastUnassignedDisplay && 
         currentBedStatus == lastBedStatus && 
+        activeBed == lastDisplayBed &&
         currentState != NORMAL && 
         currentState != CLEANING) {
         return;
@@ -703,35 +553,31 @@ void updateDisplay() {
     lastBedStatus = currentBedStatus;
     
     lastDisplayState = currentState;
-    lastOccupiedDisplay = bedOccupied;
-    lastUnassignedDisplay = bedIsUnassigned;
+    lastOccupiedDisplay = bed.isOccupied();
+    lastUnassignedDisplay = bed.isUnassigned();
+    lastDisplayBed = activeBed;
     
     lcd.clear();
     
+    if (BED_COUNT > 1 && currentState == NORMAL) {
+        drawBedOverview();
+        return;
+    }
+    
     switch (currentState) {
         case NORMAL:
         {
             // First line: Fixed text
-            lcd.print("Bed Status:");
+            lcd.print(TEXT_BED_STATUS);
             
             // Second line: Current status
             lcd.setCursor(0, 1);
-            if (bedIsUnassigned) {
-                lcd.print("UNASSIGNED: Scan!");
+            if (bed.isUnassigned()) {
+                lcd.print(TEXT_UNASSIGNED_SCAN);
+            } else if (currentBedStatus == OCCUPIED) {
+                lcd.print(TEXT_OCCUPIED);
             } else {
-                // Get real-time status based on current sensor values
-                BedStatus currentStatus = getBedStatus();
-                switch (currentStatus) {
-                    case OCCUPIED:
-                        lcd.print("OCCUPIED");
-                        break;
-                    case UNOCCUPIED:
-                        lcd.print("UNOCCUPIED");
-                        break;
-                    default:
-                        lcd.print("UNOCCUPIED");
-                        break;
-                }
+                lcd.print(TEXT_UNOCCUPIED);
             }
             break;
         }
@@ -739,251 +585,673 @@ void updateDisplay() {
         case CLEANING:
         {
             // First line: Current occupancy status
-            BedStatus currentStatus = getBedStatus();
-            lcd.print("Stat: ");
-            if (currentStatus == OCCUPIED_CLEANING) {
-                lcd.print("Occupied");
-            } else {
-                lcd.print("Unoccupied");
-            }
+            lcd.print(currentBedStatus == OCCUPIED_CLEANING ? TEXT_STAT_OCCUPIED : TEXT_STAT_UNOCCUPIED);
             
             // Second line: Cleaning status
             lcd.setCursor(0, 1);
-            lcd.print("Cleaning...");
+            lcd.print(TEXT_CLEANING_NOW);
             break;
         }
             
         case VERIFY_CLEAN:
         {
-            lcd.print("Tap card for");
+            lcd.print(TEXT_TAP_CARD_FOR);
             lcd.setCursor(0, 1);
-            lcd.print("verification!");
+            lcd.print(TEXT_VERIFICATION);
             break;
         }
             
         case DISCHARGE_PROMPT:
         {
-            lcd.print("Discharge?");
+            lcd.print(TEXT_DISCHARGE_QUESTION);
             lcd.setCursor(0, 1);
-            lcd.print("Tap card!");
+            lcd.print(TEXT_TAP_CARD);
             break;
         }
             
         case DISCHARGE_VERIFY:
         {
-            lcd.print("Discharging...");
+            lcd.print(TEXT_DISCHARGING);
             lcd.setCursor(0, 1);
-            lcd.print("Tap card again!");
+            lcd.print(TEXT_TAP_CARD_AGAIN);
             break;
         }
             
         case SHOW_STAFF_ID:
         {
-            lcd.print("Staff ID:");
+            lcd.print(TEXT_STAFF_ID);
             lcd.setCursor(0, 1);
-            lcd.print(currentStaffId);
+            lcd.print(bed.staffId());
             break;
         }
     }
 }
 
-BedStatus getBedStatus() {
-    if (bedIsUnassigned) {
-        return UNASSIGNED;
-    }
-    
-    // Get current sensor values with error checking
-    int fsrVal = analogRead(FSR_PIN);
-    float temp;
-    
-    // Add error checking for temperature sensor
-    if (mlx.readObjectTempC() > -20 && mlx.readObjectTempC() < 100) {
-        temp = mlx.readObjectTempC();
-    } else {
-        temp = lastTemp;  // Use last valid temperature if reading is invalid
+// All beds at a glance, two 8-column cells per row ("3:occ")
+void drawBedOverview() {
+    if (BED_COUNT <= 2) {
+        lcd.print(TEXT_BED_STATUS);
     }
-    
-    // Check occupancy conditions
-    bool hasWeight = fsrVal > FSR_THRESHOLD;
-    bool hasTemp = temp > TEMP_THRESHOLD;  // Must be above 32°C
-    bool isActuallyOccupied = hasWeight && hasTemp;  // Only true if BOTH conditions are met
-    
-    switch (currentState) {
-        case NORMAL:
-        case SHOW_STAFF_ID:
-        case DISCHARGE_PROMPT:
-        case DISCHARGE_VERIFY:
-            if (!isActuallyOccupied) {
-                return UNOCCUPIED;
-            }
-            return OCCUPIED;  // Only if both conditions are met
-            
-        case CLEANING:
-        case VERIFY_CLEAN:  // Keep cleaning state during verification
-            if (!isActuallyOccupied) {
-                return UNOCCUPIED_CLEANING;
-            }
-            return OCCUPIED_CLEANING;  // Only if both conditions are met
-            
-        default:
-            if (!isActuallyOccupied) {
-                return UNOCCUPIED;
-            }
-            return OCCUPIED;  // Only if both conditions are met
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        const char* status = "free";
+        switch (beds[i].status()) {
+            case OCCUPIED: status = "occ"; break;
+            case UNOCCUPIED_CLEANING: status = "cln"; break;
+            case OCCUPIED_CLEANING: status = "occ+c"; break;
+            case UNASSIGNED: status = "scan"; break;
+            default: break;
+        }
+        char cell[9];
+        snprintf(cell, sizeof(cell), "%u:%s", BED_ID + i, status);
+        lcd.setCursor((i % 2) * 8, BED_COUNT <= 2 ? 1 : i / 2);
+        lcd.print(cell);
     }
 }
 
-void updateFirebase() {
-    if (!firebaseConnected || !Firebase.ready()) {
-        Serial.println("Firebase not ready, skipping update");
+// Record for one bed from its latest filtered values (already range checked)
+void buildRecord(BedRecord& record, const Bed& bed, bool exitChanged) {
+    const OccupancyCalibration& calibration = bed.occupancy();
+    record.bed = BED_ID + bed.index();
+    record.status = bed.status();
+    record.fsrValue = bed.fsr();
+    record.temperatureCenti = bed.temperatureCenti();
+    record.hasBodyTemp = calibration.bodyTempDetected();
+    record.hasWeight = calibration.weightDetected();
+    record.isOccupied = bed.sensorsOccupied();  // Both temperature and weight, assigned bed
+    record.stamp = eventStamp();  // Device time, converted to UTC if we have a sync
+    record.staffId = bed.staffId();
+    record.configRevision = configStore.get().revision;
+    record.fsrThreshold = calibration.fsrThreshold();
+    record.tempThresholdCentiC = calibration.tempThresholdCentiC();
+    record.calibrationConfidence = calibration.confidence();
+    record.sensorFaults = bed.sensorFaults();
+    // FSR zones only exist on a single-bed controller
+    record.hasZones = FEATURE_FSR_ZONES;
+    record.exitRisk = fsrZones.exitRisk();
+    record.exitChanged = exitChanged;
+    record.copX = fsrZones.copX();
+    record.copY = fsrZones.copY();
+}
+
+void updateFirebase(bool exitChanged) {
+    if constexpr (!FEATURE_NETWORK && !FEATURE_MESH) {
+        return;
+    }
+    PROBE(PROBE_UPLINK);
+    uint8_t published = workflowPublished;
+    workflowPublished = 0;
+    bool viaMesh = mesh.relaying();
+    if (!viaMesh && !uplink.ready()) {
+        LOG(LOG_UPLINK_NOT_READY);
         return;
     }
     
-    // Read current values with error checking
-    BedStatus status = getBedStatus();
-    int fsrVal = analogRead(FSR_PIN);
-    float temp;
-    
-    // Add error checking for temperature sensor
-    if (mlx.readObjectTempC() > -20 && mlx.readObjectTempC() < 100) {
-        temp = mlx.readObjectTempC();
-    } else {
-        Serial.println("Invalid temperature reading, using last known value");
-        temp = lastTemp;
-    }
-    
-    bool hasBodyTemp = temp > TEMP_THRESHOLD;  // Only true if above 32°C
-    bool hasWeight = fsrVal > FSR_THRESHOLD;
-    // Bed is only occupied if both temperature and weight conditions are met
-    bool isOccupied = hasBodyTemp && hasWeight && !bedIsUnassigned;
-    
-    // Check if we need to update with more precise thresholds
-    bool valueChanged = (status != lastStatus ||
-                        abs(fsrVal - lastFsrVal) > 100 ||  // FSR threshold
-                        abs(temp - lastTemp) > 0.5 ||      // More sensitive temp threshold
-                        hasBodyTemp != lastHasBodyTemp ||
-                        hasWeight != lastHasWeight ||
-                        isOccupied != lastIsOccupied);
-                        
+    const BedSettings& settings = configStore.get();
     unsigned long now = millis();
-    // Update every 2 seconds if no changes, to ensure data consistency
-    bool timeToUpdate = (now - lastUpdateTime) >= 2000;
-    
-    // Only update if values changed or minimum interval passed
-    if (!valueChanged && !timeToUpdate) return;
-    
-    String statusStr = "";
-    switch (status) {
-        case UNOCCUPIED: statusStr = "unoccupied"; break;
-        case OCCUPIED: statusStr = "occupied"; break;
-        case UNOCCUPIED_CLEANING: statusStr = "unoccupied+cleaning"; break;
-        case OCCUPIED_CLEANING: statusStr = "occupied+cleaning"; break;
-        case UNASSIGNED: statusStr = "unassigned"; break;
-    }
-    
-    // Construct the path
-    String path = "/beds";  // Root path for all beds
-    FirebaseJson json;
-    
-    // Clear and rebuild the JSON object
-    json.clear();
-    
-    // Get current timestamp
-    time_t now_time = time(nullptr);
-    
-    // Create a fresh JSON structure
-    json.add("id", BED_ID);
-    json.add("status", statusStr);
-    json.add("fsrValue", fsrVal);
-    json.add("hasBodyTemp", hasBodyTemp);
-    json.add("hasWeight", hasWeight);
-    json.add("isOccupied", isOccupied);
-    json.add("temperature", temp);
-    json.add("lastUpdate", (int)now_time);
-    json.add("online", true);
-    json.add("lastStaffId", currentStaffId);  // Add the staff ID that initiated the change
-    
-    // Prepare JSON data
-    String jsonStr;
-    json.toString(jsonStr, true);
-    
-    // Try to update Firebase with improved retry mechanism
-    bool success = false;
-    int retries = 0;
-    const int MAX_RETRIES = 3;
-    
-    while (!success && retries < MAX_RETRIES) {
-        // Check WiFi connection before attempting update
-        if (WiFi.status() != WL_CONNECTED) {
-            Serial.println("WiFi disconnected, attempting reconnect...");
-            WiFi.reconnect();
-            delay(1000);
-            retries++;
+    // Update every 2 seconds if no changes, to ensure data consistency.
+    // Relayed beds share the mesh airtime, so their heartbeat is slower.
+    uint32_t heartbeatMs = settings.uplinkIntervalMs;
+    if (viaMesh && heartbeatMs < MESH_HEARTBEAT_MS) {
+        heartbeatMs = MESH_HEARTBEAT_MS;
+    }
+    
+    // Only beds whose values changed or whose heartbeat is due. Relayed
+    // records go to the mesh queue; our own wait in the batch.
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        bool exitDue = i == 0 && (exitChanged || fsrZones.exitRisk() != lastExitRisk);
+        if (!exitDue && !beds[i].reportDue(settings, heartbeatMs, now)) {
             continue;
         }
-        
-        // Attempt Firebase update with specific bed path
-        String specificPath = path + "/bed" + String(BED_ID);  // Creates /beds/bed1
-        if (Firebase.RTDB.setJSON(&fbdo, specificPath.c_str(), &json)) {
-            success = true;
-            
-            // Update last values after successful update
-            lastStatus = status;
-            lastFsrVal = fsrVal;
-            lastTemp = temp;
-            lastHasBodyTemp = hasBodyTemp;
-            lastHasWeight = hasWeight;
-            lastIsOccupied = isOccupied;
-            lastUpdateTime = now;
-            
-            // Update connection status
-            firebaseConnected = true;
-        } else {
-            // Only print error on final retry
-            if (retries == MAX_RETRIES - 1) {
-                Serial.println("Firebase update failed: " + fbdo.errorReason());
+        BedRecord record;
+        buildRecord(record, beds[i], exitChanged && i == 0);
+        if (viaMesh) {
+            if (!mesh.publish(record)) {
+                continue;
             }
-            
-            // Different delay based on error type
-            if (fbdo.errorReason().indexOf("timeout") >= 0) {
-                delay(1000);  // Longer delay for timeout
-            } else {
-                delay(500);   // Shorter delay for other errors
+        } else {
+            uplink.queued(record);
+            UplinkClass cause = uplinkClass(i, exitDue, published & (1 << i), settings, now);
+            uplinkBatch.add(i, record, cause, now, sendRecords);
+        }
+        beds[i].reported(now);
+        if (i == 0) {
+            lastExitRisk = record.exitRisk;
+        }
+    }
+    if (!viaMesh) {
+        uplinkBatch.service(now, sendRecords);  // Urgent records go now
+    }
+}
+
+// How long a bed's record may wait in the batch (uplinkBatch.h)
+UplinkClass uplinkClass(uint8_t slot, bool exitDue, bool published, const BedSettings& settings, unsigned long now) {
+    const Bed& bed = beds[slot];
+    bool discharged = bed.status() == UNASSIGNED && bed.reportedStatus() != UNASSIGNED;
+    if (exitDue || discharged) {
+        return UPLINK_URGENT;
+    }
+    if (published) {
+        return UPLINK_WORKFLOW;
+    }
+    // Due without its heartbeat: something changed
+    return bed.reportDue(settings, UINT32_MAX, now) ? UPLINK_CHANGE : UPLINK_HEARTBEAT;
+}
+
+bool sendRecords(const BedRecord* records, uint8_t count) {
+    return uplink.sendBatch(records, count, false);
+}
+
+// Waiting records go out when a budget is spent, every bed waits or the burst is over
+void flushUplink() {
+    if (uplinkBatch.waiting() == 0 || !uplink.ready()) {
+        return;
+    }
+    PROBE(PROBE_UPLINK);
+    uplinkBatch.service(millis(), sendRecords);
+}
+
+// LAN subscribers get a changed bed in the pass that changed it, and a
+// heartbeat at the uplink cadence so displays do not mark it offline. This
+// does not wait for Firebase, so it keeps going while the internet is down.
+void pushLan() {
+    PROBE(PROBE_LAN_PUSH);
+    unsigned long now = millis();
+    if (lanPush.active()) {
+        const BedSettings& settings = configStore.get();
+        for (uint8_t i = 0; i < BED_COUNT; i++) {
+            if (!beds[i].reportDue(settings, settings.uplinkIntervalMs, now, REPORT_LAN)) {
+                continue;
             }
-            
-            retries++;
-            
-            // Reset Firebase connection on repeated failures
-            if (retries == MAX_RETRIES) {
-                Serial.println("Resetting Firebase connection...");
-                firebaseConnected = false;
+            BedRecord record;
+            buildRecord(record, beds[i], false);
+            if (lanPush.publish(i, record)) {
+                beds[i].reported(now, REPORT_LAN);
             }
         }
-        yield();  // Give system time to process
     }
+    lanPush.service(now);  // Accept, and flush what was just published
 }
 
 void updateLED() {
     unsigned long now = millis();
     
-    if (currentState == CLEANING) {
-        // Blink LED during cleaning
-        if (now - ledTimer > 500) {
-            ledTimer = now;
-            ledOn = !ledOn;
-            digitalWrite(LED_PIN, ledOn ? HIGH : LOW);
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        const Bed& bed = beds[i];
+        bool on = ledOn[i];
+        if (bed.state() == CLEANING) {
+            // Blink LED during cleaning
+            if (now - ledTimer[i] > 500) {
+                ledTimer[i] = now;
+                on = !on;
+            }
+        } else {
+            // Solid LED for unassigned, off for normal states
+            on = bed.isUnassigned();
         }
-    } else if (bedIsUnassigned) {
-        // Solid LED for unassigned
-        if (!ledOn) {
-            ledOn = true;
-            digitalWrite(LED_PIN, HIGH);
+        if (on != ledOn[i]) {
+            ledOn[i] = on;
+            bedHardware.setLed(i, on);
+        }
+    }
+}
+
+// No bed is cleaning, awaiting a card or showing a staff ID, so a restart
+// into new firmware interrupts nothing a nurse is doing
+bool workflowsIdle() {
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        if (beds[i].state() != NORMAL) {
+            return false;
         }
+    }
+    return true;
+}
+
+// Read an MLX90614 temperature register straight into centi-degrees.
+// The bus checks the PEC and retries; CENTI_INVALID on bus or sensor error.
+centi_t readMlxCenti(uint8_t address, uint8_t reg) {
+    uint16_t raw;
+    if (!i2cBus.readWord(address, reg, raw)) {
+        return CENTI_INVALID;
+    }
+    return mlxRawToCenti(raw);
+}
+
+// Bed-exit risk raised or cleared by the FSR zones: sent now, not at the next uplink tick
+void reportExitRisk() {
+    if (fsrZones.exitRisk()) {
+        LOG(LOG_EXIT_RISK_RAISED, fsrZones.copX(), fsrZones.totalLoad());
     } else {
-        // LED off for normal states
-        if (ledOn) {
-            ledOn = false;
-            digitalWrite(LED_PIN, LOW);
+        LOG(LOG_EXIT_RISK_CLEARED);
+    }
+    if (uplink.ready() || mesh.relaying()) {
+        updateFirebase(true);
+        lastFirebaseUpdate = millis();
+    }
+}
+
+// One minute of breathing/motion features; only worth keeping while someone is in bed
+void reportRespiration(const RespirationMinute& minute) {
+    if (!beds[0].isOccupied() || beds[0].isUnassigned()) {
+        return;
+    }
+    LOG(LOG_RESPIRATION, minute.breathsPerMin, minute.confidence, minute.zeroCrossings, minute.motionSeconds,
+        minute.droppedSamples);
+    // Relayed beds keep their minutes local: mesh frames carry the bed record only
+    if (uplink.ready() && !mesh.relaying()) {
+        uplink.sendVitals(minute, eventStamp());
+    }
+}
+
+// Every bed's status into its hour bucket; nothing is counted until the clock is set
+void updateHourly() {
+    EventStamp now = eventStamp();
+    if (now.utcMs <= 0) {
+        return;
+    }
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        bedHours[i].observe((uint64_t)now.utcMs, beds[i].status());
+    }
+}
+
+// Finished hours go up one per bed per uplink tick. Relayed beds keep theirs:
+// mesh frames carry the bed record only
+void reportHours() {
+    if (!uplink.ready() || mesh.relaying()) {
+        return;
+    }
+    PROBE(PROBE_HOURS);
+    HourSummary hour;
+    for (uint8_t i = 0; i < BED_COUNT; i++) {
+        if (bedHours[i].pending(hour) && uplink.sendHour(BED_ID + i, hour)) {
+            bedHours[i].uploaded();
+        }
+    }
+}
+
+EventStamp eventStamp() {
+    return timeSync.stamp(timeSync.monotonicMs(millis()));
+}
+
+// Start a latency trace for a bed's status-changing event observed at sampleMillis
+void openTrace(uint8_t slot, unsigned long sampleMillis) {
+    if constexpr (!FEATURE_NETWORK) {
+        return;
+    }
+    uint64_t decision = timeSync.monotonicMs(millis());
+    uplink.openTrace(BED_ID + slot, timeSync.toMonotonic(sampleMillis), decision);
+}
+
+// Read Serial commands without blocking the loop
+void processSerialCommands() {
+    static char line[64];
+    static uint8_t length = 0;
+    
+    while (Serial.available() > 0) {
+        char c = Serial.read();
+        if (c == '\r') continue;
+        if (c == '\n') {
+            line[length] = '\0';
+            handleSerialCommand(line);
+            length = 0;
+        } else if (length < sizeof(line) - 1) {
+            line[length++] = c;
+        }
+    }
+}
+
+// cfg                    - list settings
+// cfg set <name> <value> - validate and apply one setting (persisted)
+// cfg reset              - restore compiled-in defaults
+// cal                    - show learned baseline, thresholds and confidence per bed
+// cal reset [bed]        - forget the learned calibration (all beds by default)
+// health                 - fault flags, error and range rates, repeat run and window variance per sensor
+// rec on|off [bed]       - stream "S,ms,fsr,objCenti,ambCenti" sample lines (first bed by default)
+// i2c [reset]            - bus counters, clock and occupancy
+// log                    - log ring counters
+// hours                  - this hour's aggregates and upload backlog per bed
+// btn                    - button level and debounce counters per bed
+// state                  - where the workflow resumed from, snapshot writes
+// rtdb                   - RTDB client requests, round trips, bytes, last error and heap (FEATURE_NETWORK)
+// mesh                   - relay role, route and counters (FEATURE_MESH)
+// zones                  - per-zone readings, centre of pressure, scan counters (FEATURE_FSR_ZONES)
+// push                   - LAN subscribers, events and buffer counters (FEATURE_LAN_PUSH)
+// batch [reset]          - uplink batching: requests saved and added latency per record class (FEATURE_NETWORK)
+// resp                   - last minute of breathing/motion features, capture counters (FEATURE_FSR_CAPTURE)
+// prof [reset|send]      - timing histogram per probe site, clear them, upload to /profile (FEATURE_PROBES)
+// ota [check|rollback]   - image, trial and download state, read /ota now, go back to the backup (FEATURE_OTA)
+void handleSerialCommand(char* line) {
+    char* command = strtok(line, " ");
+    if (command == nullptr) {
+        return;
+    }
+#if FEATURE_MESH
+    if (strcmp_P(command, PSTR("mesh")) == 0) {
+        const auto& node = mesh.status();
+        const MeshStats& stats = node.stats();
+        Serial.printf_P(PSTR("mesh: node=%u gateway=%u parent=%u hops=%u queue=%u/%u\n"), node.nodeId(), node.gateway(),
+                      node.parent(), node.hops(), node.queueLength(), MESH_QUEUE_SIZE);
+        Serial.printf_P(PSTR("mesh: sent=%lu acked=%lu retries=%lu retry_drops=%lu queue_drops=%lu superseded=%lu "
+                      "relayed=%lu delivered=%lu batch_drops=%lu parent_changes=%lu elections=%lu\n"),
+                      (unsigned long)stats.framesSent, (unsigned long)stats.acked, (unsigned long)stats.retries,
+                      (unsigned long)stats.retryDrops, (unsigned long)stats.queueDrops,
+                      (unsigned long)stats.superseded, (unsigned long)stats.relayed,
+                      (unsigned long)stats.delivered, (unsigned long)mesh.batchDropCount(),
+                      (unsigned long)stats.parentChanges, (unsigned long)stats.elections);
+        return;
+    }
+#endif
+#if FEATURE_FSR_ZONES
+    if (strcmp_P(command, PSTR("zones")) == 0) {
+        const auto& zones = fsrZones.zones();
+        for (uint8_t i = 0; i < FSR_ZONE_COUNT; i++) {
+            Serial.printf_P(PSTR("zone%u: raw=%u baseline=%d load=%ld share=%u.%u%%\n"), i, zones.raw(i), zones.baseline(i),
+                          (long)zones.zoneLoad(i), zones.sharePermille(i) / 10, zones.sharePermille(i) % 10);
+        }
+        Serial.printf_P(PSTR("zones: load=%ld cop=%d,%d armed=%d exitRisk=%d raised=%lu frames=%lu overruns=%lu "
+                      "max_late_us=%lu\n"),
+                      (long)zones.totalLoad(), zones.copX(), zones.copY(), fsrZones.detector().isArmed(),
+                      fsrZones.exitRisk(), (unsigned long)fsrZones.detector().raised(),
+                      (unsigned long)fsrZones.frames(), (unsigned long)fsrZones.overruns(),
+                      (unsigned long)fsrZones.maxLateUs());
+        return;
+    }
+#endif
+#if FEATURE_FSR_CAPTURE
+    if (strcmp_P(command, PSTR("resp")) == 0) {
+        const RespirationMinute& minute = fsrCapture.lastMinute();
+        Serial.printf_P(PSTR("resp: bpm=%u confidence=%u%% crossings=%u motion_s=%u motion=%lu load=%u\n"),
+                      minute.breathsPerMin, minute.confidence, minute.zeroCrossings, minute.motionSeconds,
+                      (unsigned long)minute.motionEnergy, minute.meanLoad);
+        Serial.printf_P(PSTR("resp: rate=%uHz minutes=%lu dropped=%lu backlog=%u/%u extractor=%uB\n"), FSR_CAPTURE_HZ,
+                      (unsigned long)fsrCapture.minutes(), (unsigned long)fsrCapture.dropped(),
+                      fsrCapture.backlog(), FSR_CAPTURE_RING,
+                      (unsigned)sizeof(RespirationExtractor<FSR_CAPTURE_HZ>));
+        return;
+    }
+#endif
+#if FEATURE_PROBES
+    if (strcmp_P(command, PSTR("prof")) == 0) {
+        static unsigned long since = 0;
+        char* action = strtok(nullptr, " ");
+        if (action != nullptr && strcmp_P(action, PSTR("reset")) == 0) {
+            probes.reset();
+            since = millis();
+            return;
+        }
+        if (action != nullptr && strcmp_P(action, PSTR("send")) == 0) {
+            bool sent = uplink.ready() && uplink.sendProfile(probes, millis() - since, eventStamp());
+            Serial.printf_P(PSTR("prof: sent=%d\n"), sent);
+            return;
+        }
+        Serial.printf_P(PSTR("prof: clock=%s ticks_per_us=%lu window_ms=%lu table=%uB\n"), PROBE_CLOCK,
+                      (unsigned long)probeTicksPerUs(), (unsigned long)(millis() - since), (unsigned)sizeof(probes));
+        for (uint8_t i = 0; i < PROBE_COUNT; i++) {
+            ProbeId site = (ProbeId)i;
+            char summary[PROBE_SUMMARY_SIZE];
+            formatProbeSummary(summary, sizeof(summary), probes, site);
+            Serial.printf_P(PSTR("prof: %s\n"), summary);
+            // Bucket k: durations of [2^k, 2^(k+1)) ticks
+            const ProbeHistogram& h = probes.histogram(site);
+            if (h.count == 0) {
+                continue;
+            }
+            Serial.print(F("hist:"));
+            for (uint8_t k = 0; k < PROBE_BUCKETS; k++) {
+                if (h.buckets[k] != 0) {
+                    Serial.printf_P(PSTR(" %u:%lu"), k, (unsigned long)h.buckets[k]);
+                }
+            }
+            Serial.println();
         }
+        return;
     }
-}
\ No newline at end of file
+#endif
+#if FEATURE_OTA
+    if (strcmp_P(command, PSTR("ota")) == 0) {
+        char* action = strtok(nullptr, " ");
+        if (action != nullptr && strcmp_P(action, PSTR("check")) == 0) {
+            ota.check();
+            return;
+        }
+        if (action != nullptr && strcmp_P(action, PSTR("rollback")) == 0) {
+            ota.rollback();
+            Serial.println(F("ota: no backup image to roll back to"));
+            return;
+        }
+        ota.printStatus();
+        return;
+    }
+#endif
+    if (strcmp_P(command, PSTR("log")) == 0) {
+        const EventLogStats& log = eventLog.stats();
+        Serial.printf_P(PSTR("log: written=%lu dropped=%lu high_water=%u/%u\n"), (unsigned long)log.written,
+                      (unsigned long)log.dropped, log.highWater, LOG_RING_SIZE);
+        return;
+    }
+    if (strcmp_P(command, PSTR("hours")) == 0) {
+        for (uint8_t i = 0; i < BED_COUNT; i++) {
+            const HourSummary& hour = bedHours[i].current();
+            Serial.printf_P(PSTR("hours: bed=%u hour=%lu covered_s=%lu occupied_s=%lu cleaning_s=%lu admissions=%u "
+                          "cleanings=%u discharges=%u backlog=%u/%u dropped=%lu\n"),
+                          BED_ID + i, (unsigned long)hour.hour, (unsigned long)(hour.coveredMs / 1000),
+                          (unsigned long)(hour.occupiedMs / 1000), (unsigned long)(hour.cleaningMs / 1000),
+                          hour.admissions, hour.cleanings, hour.discharges, bedHours[i].backlog(), HOURLY_PENDING,
+                          (unsigned long)bedHours[i].dropped());
+        }
+        return;
+    }
+    if (strcmp_P(command, PSTR("state")) == 0) {
+        Serial.printf_P(PSTR("state: resumed=%s seq=%lu rtc_writes=%lu flash_writes=%lu flash_failures=%lu "
+                      "flash_pending=%d\n"), snapshotSourceName(stateKeeper.restoredFrom()),
+                      (unsigned long)stateKeeper.sequence(), (unsigned long)stateKeeper.rtcWriteCount(),
+                      (unsigned long)stateKeeper.flashWriteCount(), (unsigned long)stateKeeper.flashFailureCount(),
+                      stateKeeper.flashPending());
+        return;
+    }
+#if FEATURE_NETWORK
+    if (strcmp_P(command, PSTR("rtdb")) == 0) {
+        auto& rtdb = uplink.client();
+        const RtdbStats& stats = rtdb.statistics();
+        Serial.printf_P(PSTR("rtdb: host=%s requests=%lu failed=%lu connects=%lu sign_ins=%lu refreshes=%lu "
+                      "tls_rx=%u\n"), rtdb.host(), (unsigned long)stats.requests, (unsigned long)stats.failed,
+                      (unsigned long)stats.connects, (unsigned long)stats.signIns, (unsigned long)stats.refreshes,
+                      uplink.smallTlsBuffers() ? UPLINK_TLS_SMALL_RX : UPLINK_TLS_RX_BYTES);
+        Serial.printf_P(PSTR("rtdb: last_ms=%lu avg_ms=%lu max_ms=%lu bytes_out=%lu bytes_in=%lu last_error=%s\n"),
+                      (unsigned long)stats.lastMs,
+                      (unsigned long)(stats.succeeded ? stats.totalMs / stats.succeeded : 0),
+                      (unsigned long)stats.maxMs, (unsigned long)stats.bytesOut, (unsigned long)stats.bytesIn,
+                      rtdb.errorReason());
+        Serial.printf_P(PSTR("rtdb: heap_free=%lu heap_block=%lu fragmentation=%u%%\n"),
+                      (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMaxFreeBlockSize(),
+                      ESP.getHeapFragmentation());
+        return;
+    }
+    if (strcmp_P(command, PSTR("batch")) == 0) {
+        char* action = strtok(nullptr, " ");
+        if (action != nullptr && strcmp_P(action, PSTR("reset")) == 0) {
+            uplinkBatch.resetStats();
+        }
+        const UplinkBatchStats& stats = uplinkBatch.stats();
+        Serial.printf_P(PSTR("batch: waiting=%u requests=%lu failed=%lu max_beds=%u flushed_by budget=%lu full=%lu "
+                      "idle=%lu status=%lu overwritten=%lu\n"), uplinkBatch.waiting(), (unsigned long)stats.requests,
+                      (unsigned long)stats.failed, stats.maxRecords, (unsigned long)stats.reasons[UPLINK_FLUSH_BUDGET],
+                      (unsigned long)stats.reasons[UPLINK_FLUSH_FULL], (unsigned long)stats.reasons[UPLINK_FLUSH_IDLE],
+                      (unsigned long)stats.reasons[UPLINK_FLUSH_STATUS], (unsigned long)stats.overwritten);
+        for (uint8_t c = 0; c < UPLINK_CLASS_COUNT; c++) {
+            const UplinkClassStats& cls = stats.classes[c];
+            char name[UPLINK_NAME_SIZE];
+            Serial.printf_P(PSTR("batch: %-9s budget_ms=%u records=%lu saved=%lu added_ms avg=%lu max=%lu\n"),
+                          uplinkClassName((UplinkClass)c, name), uplinkBudgetMs((UplinkClass)c),
+                          (unsigned long)cls.records, (unsigned long)cls.saved,
+                          (unsigned long)(cls.sent ? cls.addedMsTotal / cls.sent : 0), (unsigned long)cls.addedMsMax);
+        }
+        return;
+    }
+#endif
+#if FEATURE_LAN_PUSH
+    if (strcmp_P(command, PSTR("push")) == 0) {
+        const auto& hub = lanPush.status();
+        const PushStats& stats = hub.stats();
+        Serial.printf_P(PSTR("push: port=%u subscribers=%u/%u seq=%lu events=%lu coalesced=%lu oversized=%lu "
+                      "max_backlog=%u/%u\n"), LAN_PUSH_PORT, hub.subscriberCount(), LAN_PUSH_MAX_CLIENTS,
+                      (unsigned long)hub.sequence(), (unsigned long)stats.events, (unsigned long)stats.coalesced,
+                      (unsigned long)stats.oversized, stats.maxBacklog, LAN_PUSH_BUFFER);
+        Serial.printf_P(PSTR("push: accepted=%lu rejected=%lu bad_requests=%lu subscribed=%lu closed=%lu stalled=%lu "
+                      "bytes=%lu\n"), (unsigned long)stats.accepted, (unsigned long)stats.rejected,
+                      (unsigned long)stats.badRequests, (unsigned long)stats.subscribed,
+                      (unsigned long)stats.closed, (unsigned long)stats.stalled, (unsigned long)stats.bytes);
+        return;
+    }
+#endif
+    if (strcmp_P(command, PSTR("btn")) == 0) {
+        for (uint8_t i = 0; i < BED_COUNT; i++) {
+            const ButtonEdges& edges = bedHardware.buttonEdges(i);
+            Serial.printf_P(PSTR("btn: bed=%u pressed=%d bounces=%lu glitches=%lu dropped=%lu\n"), BED_ID + i,
+                          edges.pressed(), (unsigned long)edges.bounceCount(), (unsigned long)edges.glitchCount(),
+                          (unsigned long)edges.dropCount());
+        }
+        return;
+    }
+    if (strcmp_P(command, PSTR("i2c")) == 0) {
+        char* action = strtok(nullptr, " ");
+        if (action != nullptr && strcmp_P(action, PSTR("reset")) == 0) {
+            i2cBus.resetStats();
+            return;
+        }
+        const I2cStats& bus = i2cBus.stats();
+        Serial.printf_P(PSTR("i2c: clock=%lu tx=%lu errors=%lu nack=%lu pec=%lu retries=%lu recoveries=%lu "
+                      "speed_changes=%lu drops=%lu busy=%u.%u%%\n"),
+                      (unsigned long)i2cBus.clockHz(), (unsigned long)bus.transactions,
+                      (unsigned long)bus.errors, (unsigned long)bus.nacks, (unsigned long)bus.pecErrors,
+                      (unsigned long)bus.retries, (unsigned long)bus.recoveries,
+                      (unsigned long)bus.speedChanges, (unsigned long)bus.queueDrops,
+                      i2cBus.occupancyPermille() / 10, i2cBus.occupancyPermille() % 10);
+        return;
+    }
+    if (strcmp_P(command, PSTR("cal")) == 0) {
+        char* action = strtok(nullptr, " ");
+        if (action != nullptr && strcmp_P(action, PSTR("reset")) == 0) {
+            int slot = bedSlot(strtok(nullptr, " "));
+            for (uint8_t i = 0; i < BED_COUNT; i++) {
+                if (slot < 0 || slot == i) {
+                    beds[i].occupancy().reset();
+                    Serial.printf_P(PSTR("cal: bed=%u reset\n"), BED_ID + i);
+                }
+            }
+            return;
+        }
+        for (uint8_t i = 0; i < BED_COUNT; i++) {
+            const OccupancyCalibration& calibration = beds[i].occupancy();
+            Serial.printf_P(PSTR("cal: bed=%u baseline=%d noise=%d surfaceDelta=%d confidence=%u%% fsrThr=%u tempThr=%d\n"),
+                          BED_ID + i, calibration.fsrBaseline(), calibration.fsrNoise(),
+                          calibration.surfaceDeltaCentiC(), calibration.confidence(), calibration.fsrThreshold(),
+                          calibration.tempThresholdCentiC());
+        }
+        return;
+    }
+    if (strcmp_P(command, PSTR("health")) == 0) {
+        for (uint8_t i = 0; i < BED_COUNT; i++) {
+            const SensorHealth* sensors[] = {&beds[i].fsrHealth(), &beds[i].temperatureHealth()};
+            Serial.printf_P(PSTR("health: bed=%u mode=%u faults=%02x\n"), BED_ID + i, beds[i].occupancyMode(),
+                            beds[i].sensorFaults());
+            for (uint8_t s = 0; s < 2; s++) {
+                const SensorHealth& h = *sensors[s];
+                Serial.printf_P(PSTR("  %s: faults=%x errors=%u%% range=%u%% repeats=%u varQ4=%ld quietQ4=%ld windows=%lu\n"),
+                                s == 0 ? "fsr" : "temp", h.faults(), h.errorPermille() / 10, h.rangePermille() / 10,
+                                h.repeatRun(), (long)h.lastVarianceQ4(), (long)h.quietVarianceQ4(),
+                                (unsigned long)h.windows());
+            }
+        }
+        return;
+    }
+    if (strcmp_P(command, PSTR("rec")) == 0) {
+        char* action = strtok(nullptr, " ");
+        int slot = bedSlot(strtok(nullptr, " "));
+        for (uint8_t i = 0; i < BED_COUNT; i++) {
+            beds[i].record(action != nullptr && strcmp_P(action, PSTR("on")) == 0 && i == (slot < 0 ? 0 : slot));
+        }
+        return;
+    }
+    if (strcmp_P(command, PSTR("cfg")) != 0) {
+        return;
+    }
+
+    char* action = strtok(nullptr, " ");
+    if (action == nullptr) {
+        for (size_t i = 0; i < CONFIG_FIELD_COUNT; i++) {
+            uint16_t value = 0;
+            configStore.read(CONFIG_FIELDS[i].name, value);
+            Serial.printf_P(PSTR("%s=%u (%u-%u)\n"), CONFIG_FIELDS[i].name, value,
+                          CONFIG_FIELDS[i].minValue, CONFIG_FIELDS[i].maxValue);
+        }
+        Serial.printf_P(PSTR("revision=%lu\n"), (unsigned long)configStore.get().revision);
+    } else if (strcmp_P(action, PSTR("set")) == 0) {
+        char* name = strtok(nullptr, " ");
+        char* value = strtok(nullptr, " ");
+        if (name == nullptr || value == nullptr) {
+            Serial.println(F("usage: cfg set <name> <value>"));
+            return;
+        }
+        char* end;
+        long number = strtol(value, &end, 10);
+        configStore.beginUpdate();
+        if (end == value || *end != '\0' || !configStore.stage(name, number) ||
+            !configStore.commit(configStore.get().revision)) {
+            configStore.abort();
+            Serial.printf_P(PSTR("cfg: rejected %s=%s\n"), name, value);
+            return;
+        }
+        Serial.printf_P(PSTR("cfg: %s=%s%s\n"), name, value,
+                      configStore.lastSaveFailed() ? " (not saved to flash)" : "");
+    } else if (strcmp_P(action, PSTR("reset")) == 0) {
+        configStore.reset();
+        Serial.println(F("cfg: defaults restored"));
+    }
+}
+
+// Bed number typed on the Serial console to its slot; -1 if missing or not ours
+int bedSlot(const char* bedNumber) {
+    if (bedNumber == nullptr) {
+        return -1;
+    }
+    int slot = atoi(bedNumber) - BED_ID;
+    return slot >= 0 && slot < BED_COUNT ? slot : -1;
+}
+
+// Start-up progress from the uplink, shown on the first LCD line
+void showProgress(TextId message) {
+    lcd.clear();
+    lcd.print(message);
+    lcd.refresh();
+}
+
+// Track loop duration and report it periodically so profiles can be compared
+void updateLoopStats(unsigned long loopStartMicros) {
+    if constexpr (LOOP_STATS_INTERVAL == 0) {
+        return;
+    }
+    static unsigned long lastReport = 0;
+    static uint32_t loopCount = 0;
+    static uint32_t maxMicros = 0;
+    static uint64_t totalMicros = 0;
+    static uint32_t minHeap = UINT32_MAX;
+    
+    uint32_t elapsed = micros() - loopStartMicros;
+    loopCount++;
+    totalMicros += elapsed;
+    if (elapsed > maxMicros) maxMicros = elapsed;
+    // Free heap low watermark at the end of a pass, so builds can be compared on heap too
+    uint32_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap < minHeap) minHeap = freeHeap;
+    
+    if (millis() - lastReport >= LOOP_STATS_INTERVAL) {
+        Serial.printf_P(PSTR("LOOP profile=%s loops=%lu avg_us=%lu max_us=%lu heap_min=%lu heap_block=%lu\n"),
+                      PROFILE_NAME, (unsigned long)loopCount, (unsigned long)(totalMicros / loopCount),
+                      (unsigned long)maxMicros, (unsigned long)minHeap, (unsigned long)ESP.getMaxFreeBlockSize());
+        lastReport = millis();
+        loopCount = 0;
+        maxMicros = 0;
+        totalMicros = 0;
+        minHeap = UINT32_MAX;
+    }
+}
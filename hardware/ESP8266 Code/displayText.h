@@ -0,0 +1,98 @@
+#ifndef CURALINK_DISPLAY_TEXT_H
+#define CURALINK_DISPLAY_TEXT_H
+
+#include <stdint.h>
+#include "flashText.h"
+
+// LCD text catalog: one ID per line of text, kept in flash (flashText.h)
+// and read a byte at a time by BedDisplay::print(TextId). Every entry, in
+// every language, is checked against LCD_COLUMNS when the firmware compiles.
+// Only DISPLAY_LANGUAGE is compiled in. The HD44780 character ROM is ASCII:
+// no accents.
+
+#define LCD_COLUMNS     16
+#define LCD_ROWS        2
+
+#define LANGUAGE_EN     0
+#define LANGUAGE_ES     1
+#ifndef DISPLAY_LANGUAGE
+#define DISPLAY_LANGUAGE LANGUAGE_EN
+#endif
+
+//  ID                          English                 Spanish
+#define DISPLAY_TEXT(X) \
+    X(TEXT_NONE,                "",                     "") \
+    X(TEXT_STARTING_UP,         "Starting up...",       "Iniciando...") \
+    X(TEXT_SYSTEM_READY,        "System Ready",         "Sistema listo") \
+    X(TEXT_BED_IO_ERROR,        "Bed I/O Error!",       "Error E/S cama!") \
+    X(TEXT_RFID_ERROR,          "RFID Error!",          "Error RFID!") \
+    X(TEXT_MLX_ERROR,           "MLX Error",            "Error MLX") \
+    X(TEXT_WEIGHT_ONLY,         "Weight only",          "Solo peso") \
+    X(TEXT_BED_PREFIX,          "Bed ",                 "Cama ") \
+    X(TEXT_ACCESS_DENIED,       "Access Denied!",       "Acceso denegado!") \
+    X(TEXT_CONNECTING_WIFI,     "Connecting WiFi",      "Conectando WiFi") \
+    X(TEXT_SYNCING_TIME,        "Syncing time...",      "Sincronizando..") \
+    X(TEXT_INIT_FIREBASE,       "Init Firebase...",     "Conectando nube") \
+    X(TEXT_JOINING_MESH,        "Joining mesh...",      "Uniendo malla..") \
+    X(TEXT_BED_STATUS,          "Bed Status:",          "Estado cama:") \
+    X(TEXT_UNASSIGNED_SCAN,     "UNASSIGNED Scan!",     "SIN ASIGNAR:Leer") \
+    X(TEXT_OCCUPIED,            "OCCUPIED",             "OCUPADA") \
+    X(TEXT_UNOCCUPIED,          "UNOCCUPIED",           "DESOCUPADA") \
+    X(TEXT_STAT_OCCUPIED,       "Stat: Occupied",       "Est: Ocupada") \
+    X(TEXT_STAT_UNOCCUPIED,     "Stat: Unoccupied",     "Est: Desocupada") \
+    X(TEXT_CLEANING_NOW,        "Cleaning...",          "Limpiando...") \
+    X(TEXT_TAP_CARD_FOR,        "Tap card for",         "Pase tarjeta") \
+    X(TEXT_VERIFICATION,        "verification!",        "para verificar!") \
+    X(TEXT_DISCHARGE_QUESTION,  "Discharge?",           "Dar de alta?") \
+    X(TEXT_TAP_CARD,            "Tap card!",            "Pase tarjeta!") \
+    X(TEXT_DISCHARGING,         "Discharging...",       "Dando de alta..") \
+    X(TEXT_TAP_CARD_AGAIN,      "Tap card again!",      "Pase otra vez!") \
+    X(TEXT_STAFF_ID,            "Staff ID:",            "ID personal:") \
+    X(TEXT_CLEANING_MODE,       "Cleaning Mode",        "Modo limpieza") \
+    X(TEXT_STARTED,             "Started!",             "Iniciado!") \
+    X(TEXT_TAP_STAFF_CARD,      "Tap Staff Card",       "Pase tarjeta") \
+    X(TEXT_TO_VERIFY,           "to Verify",            "para verificar") \
+    X(TEXT_VERIFICATION_TITLE,  "Verification",         "Verificacion") \
+    X(TEXT_CANCELLED,           "Cancelled",            "Cancelada") \
+    X(TEXT_BUTTON_PRESS,        "Button press",         "Pulsacion") \
+    X(TEXT_NOT_ALLOWED_HERE,    "not allowed here",     "no permitida") \
+    X(TEXT_DISCHARGE_MODE,      "Discharge Mode",       "Modo alta") \
+    X(TEXT_CONFIRM_WITH_CARD,   "Confirm w/ card",      "Confirme c/tarj.") \
+    X(TEXT_LONG_PRESS_NOT,      "Long press not",       "Pulsacion larga") \
+    X(TEXT_ALLOWED_HERE,        "allowed here",         "no permitida") \
+    X(TEXT_DISCHARGE,           "Discharge",            "Alta") \
+    X(TEXT_DOUBLE_PRESS,        "Double press",         "Doble pulsacion") \
+    X(TEXT_TIMEOUT,             "Timeout!",             "Tiempo agotado!") \
+    X(TEXT_CLEANING,            "Cleaning",             "Limpieza") \
+    X(TEXT_COMPLETED,           "Completed!",           "Completada!")
+
+#define TEXT_ENUM_ENTRY(id, en, es) id,
+enum TextId : uint8_t {
+    DISPLAY_TEXT(TEXT_ENUM_ENTRY)
+    TEXT_ID_COUNT
+};
+#undef TEXT_ENUM_ENTRY
+
+#define TEXT_LENGTH_CHECK(id, en, es) \
+    static_assert(sizeof(en) <= LCD_COLUMNS + 1 && sizeof(es) <= LCD_COLUMNS + 1, #id " is wider than the LCD");
+DISPLAY_TEXT(TEXT_LENGTH_CHECK)
+#undef TEXT_LENGTH_CHECK
+
+#if DISPLAY_LANGUAGE == LANGUAGE_ES
+#define TEXT_STRING_ENTRY(id, en, es) static const char id##_STRING[] PROGMEM = es;
+#else
+#define TEXT_STRING_ENTRY(id, en, es) static const char id##_STRING[] PROGMEM = en;
+#endif
+DISPLAY_TEXT(TEXT_STRING_ENTRY)
+#undef TEXT_STRING_ENTRY
+
+#define TEXT_TABLE_ENTRY(id, en, es) id##_STRING,
+static const char* const DISPLAY_STRINGS[TEXT_ID_COUNT] PROGMEM = { DISPLAY_TEXT(TEXT_TABLE_ENTRY) };
+#undef TEXT_TABLE_ENTRY
+
+// The text's address in flash; read it with pgm_read_byte
+inline const char* displayText(TextId id) {
+    return (const char*)pgm_read_ptr(&DISPLAY_STRINGS[id < TEXT_ID_COUNT ? id : TEXT_NONE]);
+}
+
+#endif
@@ -0,0 +1,247 @@
+#ifndef CURALINK_EVENT_LOG_H
+#define CURALINK_EVENT_LOG_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <type_traits>
+#include "flashText.h"
+#include "logMessages.h"
+
+// Deferred structured logging.
+// LOG(id, args...) packs a message ID, a millis() stamp and the raw arguments
+// into a single-producer/single-consumer ring buffer - no formatting, no
+// String, no waiting on the UART. drain(), called from the loop, moves whole
+// records out only as far as the UART TX FIFO has room, so it never blocks.
+// If the ring is full the message is dropped and counted; the next drain
+// reports how many were lost.
+//
+// Wire format (LOG_BINARY 1):
+//   0xA5 | id | payload length | millis (4, LE) | payload | XOR of all previous bytes
+// Integer arguments are 4 bytes LE, strings a length byte and up to
+// LOG_MAX_STRING bytes. Bytes outside frames are plain text (command replies),
+// which tools/log_decode.py passes through. With LOG_BINARY 0 the drain
+// formats records as text instead, at the cost of keeping the format strings
+// in flash.
+
+#ifndef LOG_BINARY
+#define LOG_BINARY          1
+#endif
+#define LOG_RING_SIZE       1024        // Power of two
+#define LOG_MAX_PAYLOAD     48
+#define LOG_MAX_STRING      24
+#define LOG_FRAME_SYNC      0xA5
+#define LOG_HEADER_SIZE     7           // sync, id, length, millis
+#define LOG_FRAME_OVERHEAD  (LOG_HEADER_SIZE + 1)
+
+static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+#if !LOG_BINARY
+// Formats stay in flash; emit() copies the one it needs
+#define LOG_FORMAT_MAX      96
+#define LOG_FORMAT_STRING(id, format) static const char id##_FORMAT[] PROGMEM = format;
+LOG_MESSAGES(LOG_FORMAT_STRING)
+#undef LOG_FORMAT_STRING
+#define LOG_FORMAT_ENTRY(id, format) id##_FORMAT,
+static const char* const LOG_FORMATS[] PROGMEM = { LOG_MESSAGES(LOG_FORMAT_ENTRY) };
+#undef LOG_FORMAT_ENTRY
+#endif
+
+struct EventLogStats {
+    uint32_t written;
+    uint32_t dropped;
+    uint16_t highWater;     // Most bytes queued at once
+};
+
+class EventLog {
+public:
+    template<typename... Args>
+    void log(LogId id, const Args&... args) {
+        if constexpr (sizeof...(Args) == 0) {
+            push(id, nullptr, 0);
+        } else {
+            uint8_t payload[LOG_MAX_PAYLOAD];
+            size_t length = 0;
+            (pack(payload, length, args), ...);
+            push(id, payload, (uint8_t)length);
+        }
+    }
+
+    // Write queued records while the UART has room; call from the loop
+    void drain() {
+        if (dropReported != counters.dropped) {
+            uint32_t lost = counters.dropped - dropReported;
+            uint8_t payload[4];
+            size_t length = 0;
+            pack(payload, length, lost);
+            if (!emit(LOG_DROPPED, millis(), payload, length)) {
+                return;
+            }
+            dropReported = counters.dropped;
+        }
+
+        uint16_t tail = tailIndex.load(std::memory_order_relaxed);
+        uint16_t head = headIndex.load(std::memory_order_acquire);
+        while (tail != head) {
+            uint8_t header[LOG_HEADER_SIZE - 1];
+            copyOut(tail, header, sizeof(header));
+            LogId id = (LogId)header[0];
+            uint8_t length = header[1];
+            uint32_t stamp = (uint32_t)header[2] | (uint32_t)header[3] << 8 |
+                             (uint32_t)header[4] << 16 | (uint32_t)header[5] << 24;
+            uint8_t payload[LOG_MAX_PAYLOAD];
+            copyOut(tail + sizeof(header), payload, length);
+            if (!emit(id, stamp, payload, length)) {
+                break;  // UART full, retry next loop
+            }
+            tail += sizeof(header) + length;
+            tailIndex.store(tail, std::memory_order_release);
+        }
+    }
+
+    const EventLogStats& stats() const { return counters; }
+
+private:
+    // Integers travel as 4 bytes, whatever their declared width
+    template<typename T>
+    static void pack(uint8_t* payload, size_t& length, const T& value) {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                      "log arguments are integers or strings");
+        if (length + 4 > LOG_MAX_PAYLOAD) return;
+        uint32_t v = (uint32_t)value;
+        payload[length++] = v;
+        payload[length++] = v >> 8;
+        payload[length++] = v >> 16;
+        payload[length++] = v >> 24;
+    }
+
+    static void pack(uint8_t* payload, size_t& length, const char* text) {
+        if (length >= LOG_MAX_PAYLOAD) return;
+        size_t room = LOG_MAX_PAYLOAD - length - 1;
+        size_t n = strnlen(text, LOG_MAX_STRING);
+        if (n > room) n = room;
+        payload[length++] = (uint8_t)n;
+        memcpy(payload + length, text, n);
+        length += n;
+    }
+
+    template<size_t N>
+    static void pack(uint8_t* payload, size_t& length, const char (&text)[N]) {
+        pack(payload, length, (const char*)text);
+    }
+
+    static void pack(uint8_t* payload, size_t& length, const String& text) {
+        pack(payload, length, text.c_str());
+    }
+
+    // Producer side: header (id, length, millis) + payload, or nothing if it does not fit
+    void push(LogId id, const uint8_t* payload, uint8_t length) {
+        uint16_t head = headIndex.load(std::memory_order_relaxed);
+        uint16_t tail = tailIndex.load(std::memory_order_acquire);
+        uint16_t used = head - tail;
+        uint16_t size = LOG_HEADER_SIZE - 1 + length;
+        if (used + size > LOG_RING_SIZE) {
+            counters.dropped++;
+            return;
+        }
+        uint32_t stamp = millis();
+        uint8_t header[LOG_HEADER_SIZE - 1] = {
+            (uint8_t)id, length,
+            (uint8_t)stamp, (uint8_t)(stamp >> 8), (uint8_t)(stamp >> 16), (uint8_t)(stamp >> 24)
+        };
+        copyIn(head, header, sizeof(header));
+        copyIn(head + sizeof(header), payload, length);
+        headIndex.store(head + size, std::memory_order_release);
+        counters.written++;
+        if (used + size > counters.highWater) counters.highWater = used + size;
+    }
+
+    void copyIn(uint16_t at, const uint8_t* data, size_t n) {
+        for (size_t i = 0; i < n; i++) ring[(at + i) & (LOG_RING_SIZE - 1)] = data[i];
+    }
+
+    void copyOut(uint16_t at, uint8_t* data, size_t n) const {
+        for (size_t i = 0; i < n; i++) data[i] = ring[(at + i) & (LOG_RING_SIZE - 1)];
+    }
+
+#if LOG_BINARY
+    static bool emit(LogId id, uint32_t stamp, const uint8_t* payload, size_t length) {
+        if ((size_t)Serial.availableForWrite() < LOG_FRAME_OVERHEAD + length) {
+            return false;
+        }
+        uint8_t frame[LOG_FRAME_OVERHEAD + LOG_MAX_PAYLOAD];
+        frame[0] = LOG_FRAME_SYNC;
+        frame[1] = id;
+        frame[2] = (uint8_t)length;
+        frame[3] = stamp;
+        frame[4] = stamp >> 8;
+        frame[5] = stamp >> 16;
+        frame[6] = stamp >> 24;
+        memcpy(frame + LOG_HEADER_SIZE, payload, length);
+        uint8_t check = 0;
+        for (size_t i = 0; i < LOG_HEADER_SIZE + length; i++) check ^= frame[i];
+        frame[LOG_HEADER_SIZE + length] = check;
+        Serial.write(frame, LOG_FRAME_OVERHEAD + length);
+        return true;
+    }
+#else
+    // Text fallback: "[millis] message", formatted here instead of at the call site
+    static bool emit(LogId id, uint32_t stamp, const uint8_t* payload, size_t length) {
+        char line[128];
+        int n = snprintf(line, sizeof(line), "[%lu] ", (unsigned long)stamp);
+        char text[LOG_FORMAT_MAX] = "?";
+        if (id < LOG_ID_COUNT) {
+            copyFlashText(text, sizeof(text), (const char*)pgm_read_ptr(&LOG_FORMATS[id]));
+        }
+        const char* format = text;
+        size_t at = 0;
+        while (*format && n < (int)sizeof(line) - 2) {
+            if (*format != '%' || format[1] == '\0') {
+                line[n++] = *format++;
+                continue;
+            }
+            format++;
+            while (*format == 'l') format++;
+            char conversion = *format++;
+            if (conversion == '%') {
+                line[n++] = '%';
+            } else if (conversion == 's') {
+                uint8_t len = at < length ? payload[at] : 0;
+                n += snprintf(line + n, sizeof(line) - n, "%.*s", (int)len, (const char*)payload + at + 1);
+                at += 1 + len;
+            } else {
+                uint32_t v = 0;
+                if (at + 4 <= length) {
+                    v = payload[at] | (uint32_t)payload[at + 1] << 8 |
+                        (uint32_t)payload[at + 2] << 16 | (uint32_t)payload[at + 3] << 24;
+                }
+                at += 4;
+                if (conversion == 'd') {
+                    n += snprintf(line + n, sizeof(line) - n, "%ld", (long)(int32_t)v);
+                } else {
+                    n += snprintf(line + n, sizeof(line) - n, conversion == 'x' ? "%lx" : "%lu",
+                                  (unsigned long)v);
+                }
+            }
+            if (n > (int)sizeof(line) - 2) n = sizeof(line) - 2;
+        }
+        line[n++] = '\n';
+        if (Serial.availableForWrite() < n) {
+            return false;
+        }
+        Serial.write((const uint8_t*)line, n);
+        return true;
+    }
+#endif
+
+    uint8_t ring[LOG_RING_SIZE];
+    std::atomic<uint16_t> headIndex{0};     // Written by the producer only
+    std::atomic<uint16_t> tailIndex{0};     // Written by the consumer only
+    EventLogStats counters = {0, 0, 0};
+    uint32_t dropReported = 0;
+};
+
+extern EventLog eventLog;
+
+#define LOG(id, ...) eventLog.log(id, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef CURALINK_FIRMWARE_PROFILE_H
+#define CURALINK_FIRMWARE_PROFILE_H
+
+// Compile-time feature profiles.
+// Select a profile with -DCURALINK_PROFILE=PROFILE_xxx (see build_matrix.sh),
+// or override single features with -DFEATURE_xxx=0/1. Disabled features are
+// replaced by empty policy classes, so they add no code and their objects are
+// dropped by the linker.
+
+#define PROFILE_NETWORKED   1   // WiFi + Firebase uplink, LCD, RFID workflow
+#define PROFILE_STANDALONE  2   // Local bed unit: LCD, RFID workflow, no network
+#define PROFILE_SENSOR_NODE 3   // Occupancy reporting only: uplink, no LCD/RFID
+
+#ifndef CURALINK_PROFILE
+#define CURALINK_PROFILE PROFILE_NETWORKED
+#endif
+
+#if CURALINK_PROFILE == PROFILE_NETWORKED
+  #define PROFILE_NAME              "networked"
+  #define PROFILE_NETWORK           1
+  #define PROFILE_PERSISTENCE       1
+  #define PROFILE_DISPLAY           1
+  #define PROFILE_RFID              1
+#elif CURALINK_PROFILE == PROFILE_STANDALONE
+  #define PROFILE_NAME              "standalone"
+  #define PROFILE_NETWORK           0
+  #define PROFILE_PERSISTENCE       1
+  #define PROFILE_DISPLAY           1
+  #define PROFILE_RFID              1
+#elif CURALINK_PROFILE == PROFILE_SENSOR_NODE
+  #define PROFILE_NAME              "sensor-node"
+  #define PROFILE_NETWORK           1
+  #define PROFILE_PERSISTENCE       1
+  #define PROFILE_DISPLAY           0
+  #define PROFILE_RFID              0
+#else
+  #error "Unknown CURALINK_PROFILE"
+#endif
+
+#ifndef FEATURE_NETWORK
+#define FEATURE_NETWORK       PROFILE_NETWORK       // WiFi, NTP and Firebase uplink
+#endif
+#ifndef FEATURE_PERSISTENCE
+#define FEATURE_PERSISTENCE   PROFILE_PERSISTENCE   // Settings/state kept in flash across reboots
+#endif
+#ifndef FEATURE_DISPLAY
+#define FEATURE_DISPLAY       PROFILE_DISPLAY       // 16x2 I2C LCD
+#endif
+#ifndef FEATURE_RFID
+#define FEATURE_RFID          PROFILE_RFID          // RC522 staff cards and the button workflow
+#endif
+#ifndef FEATURE_LAN_PUSH
+#define FEATURE_LAN_PUSH      FEATURE_NETWORK       // Server-sent events to displays on the LAN (lanPush.h)
+#endif
+// Opt-in: settings pushed over an RTDB event stream instead of polled every
+// CONFIG_POLL_INTERVAL. Costs a second TLS session (rtdbClient.h)
+#ifndef FEATURE_CONFIG_STREAM
+#define FEATURE_CONFIG_STREAM 0                     // Needs FEATURE_NETWORK
+#endif
+// Opt-in for every profile: all beds in a ward must agree on it
+#ifndef FEATURE_MESH
+#define FEATURE_MESH          0                     // ESP-NOW relay through an elected gateway bed
+#endif
+// Opt-in hardware variant: the multiplexer select lines need D5-D7, so no RFID
+#ifndef FEATURE_FSR_ZONES
+#define FEATURE_FSR_ZONES     0                     // Multiplexed FSR zones, centre of pressure, bed-exit risk
+#endif
+#ifndef FEATURE_FSR_CAPTURE
+#define FEATURE_FSR_CAPTURE   0                     // 50-100 Hz FSR capture, per-minute breathing/motion features
+#endif
+
+// Delta firmware updates from /ota with rollback (otaUpdate.h), ~2.3 KB RAM
+#ifndef FEATURE_OTA
+#define FEATURE_OTA           (FEATURE_NETWORK && FEATURE_PERSISTENCE)
+#endif
+
+// Opt-in: per-site timing histograms inside loop() (probeTimers.h), ~1.6 KB RAM
+#ifndef FEATURE_PROBES
+#define FEATURE_PROBES        0                     // `prof` Serial command and /profile upload
+#endif
+
+// Loop latency is reported over Serial at this interval so profiles can be compared
+#ifndef LOOP_STATS_INTERVAL
+#define LOOP_STATS_INTERVAL   60000  // ms, 0 disables
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef CURALINK_FLASH_RECORD_H
+#define CURALINK_FLASH_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "firmwareProfile.h"
+
+#if FEATURE_PERSISTENCE
+#include <LittleFS.h>
+#endif
+
+// Small fixed-size records kept in LittleFS. Writes go to a temp file that is
+// renamed over the old one, which LittleFS applies atomically, so a power cut
+// leaves either the old or the new record. FlashRecord<false> keeps nothing.
+
+inline uint32_t flashCrc32(const uint8_t* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFFUL;
+    while (len--) {
+        crc ^= *data++;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+template<bool Persistent>
+struct FlashRecord {
+    // Returns the number of bytes read (0 if missing)
+    static size_t load(const char*, void*, size_t) { return 0; }
+    static bool save(const char*, const char*, const void*, size_t) { return true; }
+};
+
+#if FEATURE_PERSISTENCE
+template<>
+struct FlashRecord<true> {
+    static size_t load(const char* path, void* data, size_t size) {
+        if (!mount()) return 0;
+        File f = LittleFS.open(path, "r");
+        if (!f) return 0;
+        size_t n = f.read((uint8_t*)data, size);
+        f.close();
+        return n;
+    }
+
+    static bool save(const char* path, const char* tmpPath, const void* data, size_t size) {
+        if (!mount()) return false;
+        File f = LittleFS.open(tmpPath, "w");
+        if (!f) return false;
+        size_t n = f.write((const uint8_t*)data, size);
+        f.close();
+        if (n != size) return false;
+        return LittleFS.rename(tmpPath, path);
+    }
+
+private:
+    static bool mount() {
+        static bool mounted = false;
+        if (!mounted) {
+            mounted = LittleFS.begin();
+        }
+        return mounted;
+    }
+};
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef CURALINK_FLASH_TEXT_H
+#define CURALINK_FLASH_TEXT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Text kept in flash (PROGMEM). On the ESP8266 plain string literals are
+// copied into DRAM at boot; PROGMEM data stays in flash and must be read a
+// byte (or aligned word) at a time. On the host the macros are plain reads.
+
+#ifdef ARDUINO
+#include <pgmspace.h>
+#endif
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef pgm_read_byte
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#endif
+#ifndef pgm_read_word
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#endif
+#ifndef pgm_read_ptr
+#define pgm_read_ptr(p) (*(const void* const*)(p))
+#endif
+#ifndef ARDUINO
+#define snprintf_P snprintf    // Format strings in flash are plain strings on the host
+#endif
+
+// Copies flash text into out (always terminated); returns its length
+inline size_t copyFlashText(char* out, size_t size, const char* text) {
+    size_t n = 0;
+    for (char c; n + 1 < size && (c = (char)pgm_read_byte(text + n)) != '\0'; n++) {
+        out[n] = c;
+    }
+    if (size > 0) {
+        out[n] = '\0';
+    }
+    return n;
+}
+
+#endif
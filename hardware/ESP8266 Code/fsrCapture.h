@@ -0,0 +1,128 @@
+#ifndef CURALINK_FSR_CAPTURE_H
+#define CURALINK_FSR_CAPTURE_H
+
+#include <Arduino.h>
+#include "firmwareProfile.h"
+#include "respirationFeatures.h"
+
+#if FEATURE_FSR_CAPTURE
+#include <Ticker.h>
+#endif
+
+// High-rate FSR capture policy (FEATURE_FSR_CAPTURE). A Ticker samples A0 at
+// FSR_CAPTURE_HZ into a ring; poll() drains the ring through the breathing
+// and motion extractor (respirationFeatures.h), which hands out one compact
+// record per minute. Raw samples never leave the device.
+// - The Ticker callback runs in the SDK timer task whenever the loop yields
+//   (between passes, in delay() and in the network waits of an uplink send),
+//   not in an interrupt, so analogRead is safe there. The ring holds what
+//   arrives while poll() is not reached, 5 s at 50 Hz; beyond that samples
+//   are dropped. Code that runs without yielding holds the Ticker back
+//   instead, and capture() counts the periods it missed from the gap since
+//   its last run. Both are counted in the minute's record.
+// - readSensors() takes the newest captured sample instead of reading A0
+//   itself.
+// FsrCapture<false> captures nothing; the single 500 ms reading stays.
+
+#ifndef FSR_CAPTURE_HZ
+#define FSR_CAPTURE_HZ          50      // 50 or 100 Hz (whole-ms Ticker period)
+#endif
+#define FSR_CAPTURE_RING        256     // Samples, a power of two (5 s at 50 Hz)
+#define FSR_CAPTURE_PERIOD_US   (1000UL * (1000 / FSR_CAPTURE_HZ))
+
+template<bool Enabled>
+class FsrCapture {
+public:
+    explicit FsrCapture(uint8_t) {}
+    void begin() {}
+    void poll() {}
+    bool takeMinute(RespirationMinute&) { return false; }
+    int latest() const { return 0; }  // Not used: FsrZones reads the FSR
+};
+
+#if FEATURE_FSR_CAPTURE
+
+template<>
+class FsrCapture<true> {
+    static_assert(FSR_CAPTURE_HZ == 50 || FSR_CAPTURE_HZ == 100, "FSR_CAPTURE_HZ must be 50 or 100");
+    static_assert((FSR_CAPTURE_RING & (FSR_CAPTURE_RING - 1)) == 0, "FSR_CAPTURE_RING must be a power of two");
+
+public:
+    explicit FsrCapture(uint8_t adcPin) : pin(adcPin) {}
+
+    void begin() {
+        latestSample = analogRead(pin);
+        lastCaptureUs = micros();
+        ticker.attach_ms(1000 / FSR_CAPTURE_HZ, [this]() { capture(); });
+    }
+
+    // Feed captured samples to the extractor; called from every loop pass
+    void poll() {
+        while (tail != head) {
+            if (extractor.add(ring[tail % FSR_CAPTURE_RING])) {
+                pending = extractor.minute();
+                uint32_t dropped = droppedSamples - droppedReported;
+                pending.droppedSamples = dropped > UINT16_MAX ? UINT16_MAX : dropped;
+                droppedReported += dropped;
+                minuteReady = true;
+                minuteCount++;
+            }
+            tail++;
+        }
+    }
+
+    // True once per completed minute
+    bool takeMinute(RespirationMinute& minute) {
+        if (!minuteReady) {
+            return false;
+        }
+        minute = pending;
+        minuteReady = false;
+        return true;
+    }
+
+    int latest() const { return latestSample; }
+    const RespirationMinute& lastMinute() const { return pending; }
+    uint32_t minutes() const { return minuteCount; }
+    uint32_t dropped() const { return droppedSamples; }
+
+    // Ring fill right now, for sizing FSR_CAPTURE_RING
+    uint16_t backlog() const { return (uint16_t)(head - tail); }
+
+private:
+    void capture() {
+        // Periods that passed without a tick (rounded: the timer jitters)
+        uint32_t now = micros();
+        uint32_t periods = (now - lastCaptureUs + FSR_CAPTURE_PERIOD_US / 2) / FSR_CAPTURE_PERIOD_US;
+        lastCaptureUs = now;
+        if (periods > 1) {
+            droppedSamples += periods - 1;
+        }
+        uint16_t sample = analogRead(pin);
+        latestSample = sample;
+        if ((uint16_t)(head - tail) >= FSR_CAPTURE_RING) {
+            droppedSamples++;
+            return;
+        }
+        ring[head % FSR_CAPTURE_RING] = sample;
+        head++;
+    }
+
+    uint8_t pin;
+    Ticker ticker;
+    RespirationExtractor<FSR_CAPTURE_HZ> extractor;
+    RespirationMinute pending = {};
+    uint16_t ring[FSR_CAPTURE_RING];
+    volatile uint16_t head = 0;             // Written by capture() only
+    volatile uint16_t tail = 0;             // Written by poll() only
+    volatile uint16_t latestSample = 0;
+    volatile uint32_t droppedSamples = 0;   // Ring overruns and missed ticks
+    uint32_t lastCaptureUs = 0;             // capture() only, after begin()
+    uint32_t droppedReported = 0;
+    uint32_t minuteCount = 0;
+    bool minuteReady = false;
+};
+
+#endif  // FEATURE_FSR_CAPTURE
+
+#endif
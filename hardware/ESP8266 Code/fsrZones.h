@@ -0,0 +1,127 @@
+#ifndef CURALINK_FSR_ZONES_H
+#define CURALINK_FSR_ZONES_H
+
+#include <Arduino.h>
+#include "firmwareProfile.h"
+#include "pressureZones.h"
+
+// FSR input policy. FsrZones<false> is the original single FSR on A0.
+// FsrZones<true> (FEATURE_FSR_ZONES) scans FSR_ZONE_COUNT FSRs through a
+// 74HC4051 analog multiplexer into A0: one zone per FSR_ZONE_STEP_US on a
+// fixed grid, with the next channel selected right after each read so it
+// settles before the following step. Every full scan updates the centre of
+// pressure and the bed-exit detector (pressureZones.h).
+// - The ESP8266 ADC disturbs WiFi when read much faster than every few ms,
+//   so the step rate is bounded by that rather than by CPU time.
+// - A scan step is taken from the loop; a blocking uplink send delays it.
+//   A step late by a whole period restarts the grid instead of bursting
+//   reads, and is counted as an overrun.
+
+#ifndef FSR_ZONE_COUNT
+#define FSR_ZONE_COUNT          6
+#endif
+#ifndef FSR_ZONE_STEP_US
+#define FSR_ZONE_STEP_US        2500    // One zone per step: 6 zones scan at ~66 Hz
+#endif
+
+template<bool Enabled>
+class FsrZones {
+public:
+    FsrZones(uint8_t adcPin, uint8_t, uint8_t, uint8_t) : pin(adcPin) {}
+    void begin() {}
+    void service(uint32_t, uint32_t) {}
+    void setLearning(bool) {}
+    int read() { return analogRead(pin); }
+    bool takeExitChange() { return false; }
+    bool exitRisk() const { return false; }
+    int32_t totalLoad() const { return 0; }
+    int16_t copX() const { return 0; }
+    int16_t copY() const { return 0; }
+
+private:
+    uint8_t pin;
+};
+
+template<>
+class FsrZones<true> {
+public:
+    FsrZones(uint8_t adcPin, uint8_t s0, uint8_t s1, uint8_t s2) : pin(adcPin), select{s0, s1, s2} {}
+
+    void begin() {
+        for (uint8_t i = 0; i < 3; i++) {
+            pinMode(select[i], OUTPUT);
+        }
+        selectZone(0);
+        nextStepUs = micros() + FSR_ZONE_STEP_US;
+    }
+
+    // Called from every loop pass; reads at most one zone
+    void service(uint32_t nowUs, uint32_t nowMs) {
+        int32_t late = (int32_t)(nowUs - nextStepUs);
+        if (late < 0) {
+            return;
+        }
+        if (late >= FSR_ZONE_STEP_US) {
+            overrunCount++;
+            nextStepUs = nowUs;
+        } else if ((uint32_t)late > maxLate) {
+            maxLate = late;
+        }
+        nextStepUs += FSR_ZONE_STEP_US;
+
+        map.update(zone, analogRead(pin), learning);
+        zone = zone + 1 < FSR_ZONE_COUNT ? zone + 1 : 0;
+        selectZone(zone);
+        if (zone == 0) {
+            frameCount++;
+            if (exit.update(map.totalLoad(), map.copX(), nowMs)) {
+                exitChanged = true;
+            }
+        }
+    }
+
+    // Baselines are learned while the bed is reported empty
+    void setLearning(bool empty) { learning = empty; }
+
+    // Replaces the single A0 reading for occupancy and calibration
+    int read() { return map.meanRaw(); }
+
+    // True once per raised or cleared exit risk
+    bool takeExitChange() {
+        bool changed = exitChanged;
+        exitChanged = false;
+        return changed;
+    }
+
+    bool exitRisk() const { return exit.active(); }
+    int32_t totalLoad() const { return map.totalLoad(); }
+    int16_t copX() const { return map.copX(); }
+    int16_t copY() const { return map.copY(); }
+
+    const ZonePressureMap<FSR_ZONE_COUNT>& zones() const { return map; }
+    const BedExitDetector& detector() const { return exit; }
+    uint32_t frames() const { return frameCount; }
+    uint32_t overruns() const { return overrunCount; }
+    uint32_t maxLateUs() const { return maxLate; }
+
+private:
+    void selectZone(uint8_t z) {
+        for (uint8_t i = 0; i < 3; i++) {
+            digitalWrite(select[i], (z >> i) & 1 ? HIGH : LOW);
+        }
+    }
+
+    uint8_t pin;
+    uint8_t select[3];
+    ZonePressureMap<FSR_ZONE_COUNT> map;
+    BedExitDetector exit;
+    uint8_t zone = 0;
+    bool learning = true;
+    bool exitChanged = false;
+    uint32_t nextStepUs = 0;
+    uint32_t frameCount = 0;
+    uint32_t overrunCount = 0;
+    uint32_t maxLate = 0;
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef CURALINK_HOURLY_AGGREGATES_H
+#define CURALINK_HOURLY_AGGREGATES_H
+
+#include <stdint.h>
+#include "bedState.h"
+
+// Per-bed hourly aggregates for the next-hour forecast (backend/app.py):
+// occupied time, admissions, cleaning time and count, discharges. They are
+// kept incrementally from the reported status, so memory is one open bucket
+// plus a few finished hours waiting for upload; no history is stored or
+// rescanned.
+// - Buckets are UTC hours. Nothing is counted before the clock is first set,
+//   and coveredMs tells how much of an hour was watched (boot, first sync).
+// - Time in a state is split at hour boundaries; events count in the hour
+//   they happen: an admission when the bed leaves UNASSIGNED (a card assigns
+//   it), a discharge when it becomes UNASSIGNED, a cleaning when a cleaning
+//   status ends with the card verification.
+// - A clock step back is held at the last time seen; a gap longer than the
+//   pending queue restarts at the new time instead of inventing the hours in
+//   between.
+// Host-compilable; tools/hourly_aggregates_check.cpp replays status traces
+// against a brute-force recomputation.
+
+#define HOUR_MS                 3600000ULL
+#define HOURLY_PENDING          6       // Finished hours kept until uploaded
+
+struct HourSummary {
+    uint32_t hour;          // UTC hours since the epoch
+    uint32_t coveredMs;     // Part of the hour that was observed
+    uint32_t occupiedMs;
+    uint32_t cleaningMs;
+    uint16_t admissions;
+    uint16_t cleanings;     // Completed (verified) cleanings
+    uint16_t discharges;
+};
+
+class HourlyAggregates {
+public:
+    // Status at utcMs; call on every loop pass (at least on every status change)
+    void observe(uint64_t utcMs, BedStatus status) {
+        if (!started) {
+            open(utcMs);
+            lastMs = utcMs;
+            lastStatus = status;
+            started = true;
+            return;
+        }
+        if (utcMs < lastMs) {
+            utcMs = lastMs;
+        }
+        if (utcMs - lastMs > HOURLY_PENDING * HOUR_MS) {
+            close();
+            open(utcMs);
+            lastMs = utcMs;
+        }
+
+        uint64_t end = hourStart() + HOUR_MS;
+        while (utcMs >= end) {
+            accumulate(end);
+            close();
+            open(end);
+            end += HOUR_MS;
+        }
+        accumulate(utcMs);
+
+        if (status != lastStatus) {
+            if (lastStatus == UNASSIGNED) {
+                bucket.admissions++;
+            } else if (status == UNASSIGNED) {
+                bucket.discharges++;
+            } else if (isCleaning(lastStatus) && !isCleaning(status)) {
+                bucket.cleanings++;
+            }
+            lastStatus = status;
+        }
+    }
+
+    // Oldest finished hour not yet uploaded
+    bool pending(HourSummary& summary) const {
+        if (count == 0) {
+            return false;
+        }
+        summary = finished[first];
+        return true;
+    }
+
+    // The hour from pending() was accepted upstream
+    void uploaded() {
+        if (count > 0) {
+            first = (first + 1) % HOURLY_PENDING;
+            count--;
+        }
+    }
+
+    const HourSummary& current() const { return bucket; }
+    bool active() const { return started; }
+    uint8_t backlog() const { return count; }
+    uint32_t dropped() const { return droppedHours; }
+
+private:
+    static bool isCleaning(BedStatus status) {
+        return status == OCCUPIED_CLEANING || status == UNOCCUPIED_CLEANING;
+    }
+
+    uint64_t hourStart() const { return (uint64_t)bucket.hour * HOUR_MS; }
+
+    void open(uint64_t utcMs) {
+        bucket = HourSummary();
+        bucket.hour = (uint32_t)(utcMs / HOUR_MS);
+        lastMs = utcMs;
+    }
+
+    // Credit the time since lastMs (within the open hour) to the last status
+    void accumulate(uint64_t utcMs) {
+        uint32_t elapsed = (uint32_t)(utcMs - lastMs);
+        bucket.coveredMs += elapsed;
+        if (lastStatus == OCCUPIED || lastStatus == OCCUPIED_CLEANING) {
+            bucket.occupiedMs += elapsed;
+        }
+        if (isCleaning(lastStatus)) {
+            bucket.cleaningMs += elapsed;
+        }
+        lastMs = utcMs;
+    }
+
+    // Queue the open hour; the oldest is dropped when uploads fall behind
+    void close() {
+        if (count == HOURLY_PENDING) {
+            first = (first + 1) % HOURLY_PENDING;
+            count--;
+            droppedHours++;
+        }
+        finished[(first + count) % HOURLY_PENDING] = bucket;
+        count++;
+    }
+
+    HourSummary bucket = {};
+    HourSummary finished[HOURLY_PENDING];
+    uint8_t first = 0;
+    uint8_t count = 0;
+    uint64_t lastMs = 0;
+    BedStatus lastStatus = UNASSIGNED;
+    bool started = false;
+    uint32_t droppedHours = 0;
+};
+
+#endif
@@ -0,0 +1,293 @@
+#ifndef CURALINK_I2C_BUS_H
+#define CURALINK_I2C_BUS_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// Owner of the shared I2C bus (LCD backpack, MLX90614s and, on multi-bed
+// controllers, the FSR ADC and button/LED expander - see bedHardware.h).
+// - Sensor reads are urgent and run immediately, as SMBus read-word with the
+//   PEC byte checked and a few retries.
+// - Slow, non-urgent work (LCD refresh) is queued by priority and run from
+//   service(), after the sensors have been sampled.
+// - Before each transaction, and after a failed one, the bus is checked for a
+//   slave holding SDA low; it is freed by clocking SCL and sending a STOP.
+// - The clock starts at the safe 100 kHz and steps towards I2C_MAX_CLOCK while
+//   transactions stay clean, stepping back down when errors appear.
+
+#define I2C_QUEUE_SIZE          4
+#define I2C_MAX_RETRIES         2
+#define I2C_RECOVERY_PULSES     9       // Enough for a slave to finish any byte
+#define I2C_ADAPT_WINDOW        100     // Transactions per speed decision
+#define I2C_STEP_DOWN_PERMILLE  20      // Error rate above this slows the bus
+#define I2C_CLEAN_WINDOWS       3       // Error-free windows before speeding up
+#ifndef I2C_MAX_CLOCK
+#define I2C_MAX_CLOCK           400000  // The MLX90614 datasheet only guarantees 100 kHz; errors step it back
+#endif
+
+static const uint32_t I2C_CLOCKS[] = {100000, 200000, 400000};
+#define I2C_CLOCK_COUNT (sizeof(I2C_CLOCKS) / sizeof(I2C_CLOCKS[0]))
+
+enum I2cPriority : uint8_t {
+    I2C_PRIORITY_SENSOR = 0,     // Runs first
+    I2C_PRIORITY_DISPLAY = 1
+};
+
+typedef void (*I2cJob)(void* context);
+
+struct I2cStats {
+    uint32_t transactions;
+    uint32_t errors;            // Failed attempts (any cause)
+    uint32_t nacks;             // Address/data not acknowledged or short read
+    uint32_t pecErrors;         // Data received but the checksum did not match
+    uint32_t retries;
+    uint32_t recoveries;        // Stuck-bus recoveries performed
+    uint32_t speedChanges;
+    uint32_t queueDrops;        // Jobs rejected because the queue was full
+    uint32_t busyMicros;        // Time spent in transactions and queued jobs
+};
+
+class I2cBus {
+public:
+    void begin(uint8_t sdaPin, uint8_t sclPin) {
+        sda = sdaPin;
+        scl = sclPin;
+        clockIndex = 0;
+        Wire.begin(sda, scl);
+        Wire.setClock(I2C_CLOCKS[clockIndex]);
+        statsSince = millis();
+    }
+
+    // SMBus read word with PEC (CRC-8 over address, command and data)
+    bool readWord(uint8_t address, uint8_t command, uint16_t& value) {
+        return transact([&]() { return readWordOnce(address, command, value); });
+    }
+
+    // Plain write for devices without PEC (ADC configuration, port expander)
+    bool write(uint8_t address, const uint8_t* data, uint8_t length) {
+        return transact([&]() {
+            Wire.beginTransmission(address);
+            Wire.write(data, length);
+            if (Wire.endTransmission() != 0) {
+                counters.nacks++;
+                return false;
+            }
+            return true;
+        });
+    }
+
+    // Plain read of length bytes from the device's current register
+    bool read(uint8_t address, uint8_t* data, uint8_t length) {
+        return transact([&]() {
+            if (Wire.requestFrom(address, length) != length) {
+                counters.nacks++;
+                return false;
+            }
+            for (uint8_t i = 0; i < length; i++) {
+                data[i] = Wire.read();
+            }
+            return true;
+        });
+    }
+
+    // Queue deferred work; a job already pending with the same context is not queued twice
+    bool submit(I2cPriority priority, I2cJob job, void* context) {
+        for (uint8_t i = 0; i < queued; i++) {
+            if (queue[i].job == job && queue[i].context == context) {
+                return true;
+            }
+        }
+        if (queued >= I2C_QUEUE_SIZE) {
+            counters.queueDrops++;
+            return false;
+        }
+        // Insert behind jobs of the same or higher priority
+        uint8_t pos = queued;
+        while (pos > 0 && queue[pos - 1].priority > priority) {
+            queue[pos] = queue[pos - 1];
+            pos--;
+        }
+        queue[pos] = {priority, job, context};
+        queued++;
+        return true;
+    }
+
+    // Run queued jobs, highest priority first
+    void service() {
+        while (queued > 0) {
+            if (!ensureBusFree()) {
+                return;  // Jobs stay queued, try again next loop
+            }
+            Entry entry = queue[0];
+            for (uint8_t i = 1; i < queued; i++) {
+                queue[i - 1] = queue[i];
+            }
+            queued--;
+            unsigned long start = micros();
+            entry.job(entry.context);
+            counters.busyMicros += micros() - start;
+        }
+    }
+
+    const I2cStats& stats() const { return counters; }
+    uint32_t clockHz() const { return I2C_CLOCKS[clockIndex]; }
+
+    // Share of wall time the bus was busy since the last resetStats(), in 0.1 %
+    uint16_t occupancyPermille() const {
+        uint32_t elapsedMs = millis() - statsSince;
+        if (elapsedMs == 0) return 0;
+        uint64_t permille = (uint64_t)counters.busyMicros / elapsedMs;  // us per ms = 0.1 %
+        return permille > 1000 ? 1000 : (uint16_t)permille;
+    }
+
+    void resetStats() {
+        memset(&counters, 0, sizeof(counters));
+        statsSince = millis();
+    }
+
+private:
+    struct Entry {
+        I2cPriority priority;
+        I2cJob job;
+        void* context;
+    };
+
+    // One transaction with retries, bus recovery and accounting
+    template<typename Transaction>
+    bool transact(Transaction once) {
+        for (uint8_t attempt = 0; attempt <= I2C_MAX_RETRIES; attempt++) {
+            if (attempt > 0) {
+                counters.retries++;
+            }
+            if (!ensureBusFree()) {
+                account(false);
+                continue;
+            }
+            unsigned long start = micros();
+            bool ok = once();
+            counters.busyMicros += micros() - start;
+            account(ok);
+            if (ok) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool readWordOnce(uint8_t address, uint8_t command, uint16_t& value) {
+        Wire.beginTransmission(address);
+        Wire.write(command);
+        if (Wire.endTransmission(false) != 0) {
+            counters.nacks++;
+            return false;
+        }
+        if (Wire.requestFrom(address, (uint8_t)3) != 3) {
+            counters.nacks++;
+            return false;
+        }
+        uint8_t low = Wire.read();
+        uint8_t high = Wire.read();
+        uint8_t pec = Wire.read();
+
+        const uint8_t frame[] = {(uint8_t)(address << 1), command, (uint8_t)((address << 1) | 1), low, high};
+        if (crc8(frame, sizeof(frame)) != pec) {
+            counters.pecErrors++;
+            return false;
+        }
+        value = (uint16_t)high << 8 | low;
+        return true;
+    }
+
+    // SMBus PEC: CRC-8, polynomial x^8 + x^2 + x + 1
+    static uint8_t crc8(const uint8_t* data, size_t length) {
+        uint8_t crc = 0;
+        while (length--) {
+            crc ^= *data++;
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+            }
+        }
+        return crc;
+    }
+
+    // A slave that lost a clock edge keeps SDA low and blocks every master
+    bool ensureBusFree() {
+        if (digitalRead(sda) == HIGH) {
+            return true;
+        }
+        return recover();
+    }
+
+    bool recover() {
+        counters.recoveries++;
+        pinMode(sda, INPUT_PULLUP);
+        pinMode(scl, OUTPUT_OPEN_DRAIN);
+        for (uint8_t i = 0; i < I2C_RECOVERY_PULSES && digitalRead(sda) == LOW; i++) {
+            digitalWrite(scl, LOW);
+            delayMicroseconds(5);
+            digitalWrite(scl, HIGH);
+            delayMicroseconds(5);
+        }
+        // STOP: SDA rises while SCL is high
+        digitalWrite(scl, LOW);
+        delayMicroseconds(5);
+        pinMode(sda, OUTPUT_OPEN_DRAIN);
+        digitalWrite(sda, LOW);
+        delayMicroseconds(5);
+        digitalWrite(scl, HIGH);
+        delayMicroseconds(5);
+        digitalWrite(sda, HIGH);
+        delayMicroseconds(5);
+
+        Wire.begin(sda, scl);
+        Wire.setClock(I2C_CLOCKS[clockIndex]);
+        return digitalRead(sda) == HIGH;
+    }
+
+    // Track errors per window of transactions and adapt the clock
+    void account(bool ok) {
+        counters.transactions++;
+        windowCount++;
+        if (!ok) {
+            counters.errors++;
+            windowErrors++;
+        }
+        if (windowCount < I2C_ADAPT_WINDOW) {
+            return;
+        }
+
+        uint32_t permille = (uint32_t)windowErrors * 1000 / windowCount;
+        uint8_t target = clockIndex;
+        if (permille > I2C_STEP_DOWN_PERMILLE && clockIndex > 0) {
+            target = clockIndex - 1;
+            cleanWindows = 0;
+        } else if (windowErrors == 0 && ++cleanWindows >= I2C_CLEAN_WINDOWS) {
+            cleanWindows = 0;
+            if ((size_t)clockIndex + 1 < I2C_CLOCK_COUNT && I2C_CLOCKS[clockIndex + 1] <= I2C_MAX_CLOCK) {
+                target = clockIndex + 1;
+            }
+        } else if (windowErrors != 0) {
+            cleanWindows = 0;
+        }
+        if (target != clockIndex) {
+            clockIndex = target;
+            Wire.setClock(I2C_CLOCKS[clockIndex]);
+            counters.speedChanges++;
+        }
+        windowCount = 0;
+        windowErrors = 0;
+    }
+
+    uint8_t sda = 0;
+    uint8_t scl = 0;
+    uint8_t clockIndex = 0;
+    uint16_t windowCount = 0;
+    uint16_t windowErrors = 0;
+    uint8_t cleanWindows = 0;
+    Entry queue[I2C_QUEUE_SIZE];
+    uint8_t queued = 0;
+    I2cStats counters = {};
+    unsigned long statsSince = 0;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef CURALINK_LAN_PUSH_H
+#define CURALINK_LAN_PUSH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "firmwareProfile.h"
+#include "bedState.h"
+#include "sensorMath.h"
+#include "bedUplink.h"
+#include "pushHub.h"
+
+#if FEATURE_LAN_PUSH
+#include <ESP8266WiFi.h>
+#endif
+
+// LAN push policy: bed records as server-sent events on
+// http://<controller>:LAN_PUSH_PORT/events (see pushHub.h). Records go out
+// whenever the station link is up, whether or not Firebase is reachable.
+// LanPush<false> never publishes.
+
+#define LAN_PUSH_PORT           8080
+#define LAN_PUSH_MAX_CLIENTS    4       // Each costs a buffer and an lwIP connection
+#define LAN_PUSH_BUFFER         768     // Bytes per subscriber
+
+// A bed record as the JSON object the dashboard reads from /beds/bed<N>
+// (the fields BedUplink::fillRecord writes); returns the length, or -1 if
+// it does not fit
+inline int formatBedEvent(char* out, size_t size, const BedRecord& record) {
+    char temperature[12];
+    char threshold[12];
+    formatCenti(temperature, sizeof(temperature), record.temperatureCenti);
+    formatCenti(threshold, sizeof(threshold), record.tempThresholdCentiC);
+    int length = snprintf(out, size,
+                          "{\"id\":%u,\"status\":\"%s\",\"fsrValue\":%d,\"hasBodyTemp\":%s,\"hasWeight\":%s,"
+                          "\"isOccupied\":%s,\"temperature\":%s,\"lastUpdate\":%lld,\"eventMonoMs\":%lld,"
+                          "\"timeSynced\":%s,\"online\":true,\"lastStaffId\":\"%s\",\"configRevision\":%lu,"
+                          "\"fsrThreshold\":%u,\"tempThreshold\":%s,\"calibrationConfidence\":%u,"
+                          "\"sensorFaults\":%u,\"occupancyMode\":%u",
+                          (unsigned)record.bed, bedStatusName(record.status).c_str(), record.fsrValue,
+                          record.hasBodyTemp ? "true" : "false", record.hasWeight ? "true" : "false",
+                          record.isOccupied ? "true" : "false", temperature, (long long)record.stamp.utcMs,
+                          (long long)record.stamp.monoMs, record.stamp.synced ? "true" : "false",
+                          record.staffId.c_str(), (unsigned long)record.configRevision,
+                          (unsigned)record.fsrThreshold, threshold, (unsigned)record.calibrationConfidence,
+                          (unsigned)record.sensorFaults, (unsigned)occupancyModeFor(record.sensorFaults));
+    if (length > 0 && (size_t)length < size) {
+        int tail = record.hasZones ? snprintf(out + length, size - length, ",\"exitRisk\":%s,\"copX\":%d,\"copY\":%d}",
+                                              record.exitRisk ? "true" : "false", record.copX, record.copY)
+                                   : snprintf(out + length, size - length, "}");
+        length = tail > 0 ? length + tail : -1;
+    }
+    return length > 0 && (size_t)length < size ? length : -1;
+}
+
+template<bool Enabled, uint8_t Beds>
+class LanPush {
+public:
+    void begin() {}
+    void service(uint32_t) {}
+    bool active() { return false; }
+    bool publish(uint8_t, const BedRecord&) { return false; }
+};
+
+#if FEATURE_LAN_PUSH
+
+template<uint8_t Beds>
+class LanPush<true, Beds> {
+public:
+    typedef PushHub<WiFiClient, LAN_PUSH_MAX_CLIENTS, LAN_PUSH_BUFFER, Beds> Hub;
+
+    void begin() {
+        server.begin();
+        server.setNoDelay(true);
+    }
+
+    // Every loop pass: accept, read requests, flush
+    void service(uint32_t nowMs) {
+        WiFiClient client = server.accept();
+        if (client) {
+            client.setNoDelay(true);
+            hub.add(client, nowMs);
+        }
+        hub.service(nowMs);
+    }
+
+    // Subscribers can only reach us over the station link
+    bool active() { return WiFi.status() == WL_CONNECTED; }
+
+    // The bed's latest record; kept for displays that subscribe later
+    bool publish(uint8_t slot, const BedRecord& record) {
+        char json[PUSH_EVENT_BYTES - 48];  // Room for the id/event/data framing
+        if (formatBedEvent(json, sizeof(json), record) < 0) {
+            return false;
+        }
+        hub.publish(slot, json);
+        return true;
+    }
+
+    const Hub& status() const { return hub; }
+
+private:
+    WiFiServer server{LAN_PUSH_PORT};
+    Hub hub;
+};
+
+#endif
+
+#endif
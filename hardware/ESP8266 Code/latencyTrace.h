@@ -0,0 +1,77 @@
+#ifndef CURALINK_LATENCY_TRACE_H
+#define CURALINK_LATENCY_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// End-to-end latency tracing for bed events.
+// Each event (occupancy change, workflow transition) gets a trace ID and the
+// device records its own stage times in monotonic ms:
+//   sample   - sensor reading / input edge that caused the event
+//   decision - state machine committed the new state
+//   enqueue  - first uplink record carrying the event was built
+//   ack      - that record was acknowledged by the database
+// The trace rides along in every uplink record until the next event replaces
+// it, so the ack time reaches the cloud with the following record. Later hops
+// (RTDB server time, dashboard receive/render) append their own stages.
+
+struct LatencyTrace {
+    uint32_t seq;          // Per-boot sequence number, 0 = no trace yet
+    uint64_t sampleMs;
+    uint64_t decisionMs;
+    uint64_t enqueueMs;    // 0 until the first record is built
+    uint64_t ackMs;        // 0 until the first record is acknowledged
+};
+
+class LatencyTracer {
+public:
+    // bootTag distinguishes sequence numbers across reboots
+    void begin(uint16_t bed, uint32_t bootTag) {
+        bedId = bed;
+        boot = bootTag;
+    }
+
+    // Open a trace for a new event. An event that was never sent is superseded.
+    void open(uint64_t sampleMs, uint64_t decisionMs) {
+        if (trace.seq != 0 && trace.enqueueMs == 0) {
+            superseded++;
+        }
+        trace.seq = ++nextSeq;
+        trace.sampleMs = sampleMs;
+        trace.decisionMs = decisionMs;
+        trace.enqueueMs = 0;
+        trace.ackMs = 0;
+    }
+
+    void markEnqueue(uint64_t nowMs) {
+        if (trace.seq != 0 && trace.enqueueMs == 0) {
+            trace.enqueueMs = nowMs;
+        }
+    }
+
+    void markAck(uint64_t nowMs) {
+        if (trace.enqueueMs != 0 && trace.ackMs == 0) {
+            trace.ackMs = nowMs;
+        }
+    }
+
+    bool active() const { return trace.seq != 0; }
+    const LatencyTrace& current() const { return trace; }
+    uint32_t supersededCount() const { return superseded; }
+
+    // Trace IDs are unique across beds and reboots: "b<bed>-<boot>-<seq>"
+    // (no characters that are illegal in RTDB keys)
+    void formatId(char* buf, size_t len) const {
+        snprintf(buf, len, "b%u-%08lx-%lu", (unsigned)bedId, (unsigned long)boot,
+                 (unsigned long)trace.seq);
+    }
+
+private:
+    LatencyTrace trace = {0, 0, 0, 0, 0};
+    uint32_t nextSeq = 0;
+    uint32_t superseded = 0;
+    uint32_t boot = 0;
+    uint16_t bedId = 0;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef CURALINK_LOG_MESSAGES_H
+#define CURALINK_LOG_MESSAGES_H
+
+// Log message catalog: one ID per format string (see eventLog.h).
+// Only the ID and the packed arguments go over the UART; tools/log_decode.py
+// reads this file to turn them back into text. Append new messages at the end
+// so captures from older firmware still decode. Supported conversions:
+// %d %u %ld %lu %x %lx (4 bytes each) and %s (length + up to LOG_MAX_STRING bytes).
+
+#define LOG_MESSAGES(X) \
+    X(LOG_DROPPED,              "[log] %lu messages dropped") \
+    X(LOG_BUTTON_PRESSED,       "Button pressed") \
+    X(LOG_SHORT_PRESS_HANDLED,  "Short press handled") \
+    X(LOG_SHORT_PRESS,          "Short press detected, current state: %d") \
+    X(LOG_CLEANING_STARTED,     "=== Cleaning Mode Started ===") \
+    X(LOG_VERIFY_WAIT,          "Waiting for staff card verification") \
+    X(LOG_VERIFY_CANCELLED,     "Verification cancelled, back to cleaning") \
+    X(LOG_LONG_PRESS,           "Long press detected") \
+    X(LOG_DISCHARGE_START,      "Starting discharge process") \
+    X(LOG_SAMPLE,               "S,%lu,%d,%d,%d") \
+    X(LOG_OCCUPIED,             "Bed now OCCUPIED - Weight: %d, Temp: %d cC (both above threshold)") \
+    X(LOG_UNOCCUPIED,           "Occupancy changed: UNOCCUPIED") \
+    X(LOG_CARD_DETECTED,        "Card detected! UID: %s") \
+    X(LOG_CARD_VALID,           "Valid staff card: %s") \
+    X(LOG_CARD_UNKNOWN,         "Unknown card: %s") \
+    X(LOG_CARD_IN_STATE,        "Valid staff card detected in state: %d") \
+    X(LOG_SHOW_ID_CLEANING,     "Showing staff ID, then completing cleaning") \
+    X(LOG_SHOW_ID_DISCHARGE,    "Showing staff ID, then discharging") \
+    X(LOG_SHOW_ID_VERIFY,       "Showing staff ID, then discharge verification") \
+    X(LOG_REASSIGNED,           "Bed reassigned by staff: %s") \
+    X(LOG_CARD_IGNORED,         "RFID ignored in current state") \
+    X(LOG_VERIFY_TIMEOUT,       "Cleaning verification timeout - returning to cleaning state") \
+    X(LOG_PROMPT_TIMEOUT,       "Discharge prompt timeout") \
+    X(LOG_DISCHARGE_TIMEOUT,    "Discharge verification timeout") \
+    X(LOG_CLEANING_VERIFIED,    "Cleaning verified, back to normal") \
+    X(LOG_DISCHARGED,           "Discharge confirmed, bed set to UNASSIGNED") \
+    X(LOG_DISCHARGE_VERIFY,     "Moving to discharge verification") \
+    X(LOG_UPLINK_NOT_READY,     "Firebase not ready, skipping update") \
+    X(LOG_TIME_SAMPLE,          "Time sample applied, drift %ld ppb") \
+    X(LOG_SETTINGS_INVALID,     "Settings revision %lu: invalid %s") \
+    X(LOG_SETTINGS_REJECTED,    "Settings revision %lu rejected") \
+    X(LOG_SETTINGS_APPLIED,     "Settings revision %lu applied") \
+    X(LOG_UPLINK_CONNECTED,     "Firebase connected") \
+    X(LOG_WIFI_RECONNECT,       "WiFi disconnected, attempting reconnect...") \
+    X(LOG_UPLINK_FAILED,        "Firebase update failed: %s") \
+    X(LOG_UPLINK_RESET,         "Resetting Firebase connection...") \
+    X(LOG_MESH_GATEWAY,         "Mesh: elected gateway") \
+    X(LOG_MESH_FOLLOWING,       "Mesh: following gateway %u") \
+    X(LOG_MESH_NO_ROUTE,        "Mesh: no gateway in range") \
+    X(LOG_MESH_BATCH_FAILED,    "Mesh: uplink of %u relayed records failed") \
+    X(LOG_MESH_RX_DROPPED,      "Mesh: %lu received frames dropped") \
+    X(LOG_EXIT_RISK_RAISED,     "Bed-exit risk: load at edge, COP x=%d load=%ld") \
+    X(LOG_EXIT_RISK_CLEARED,    "Bed-exit risk cleared") \
+    X(LOG_ALERT_FAILED,         "Alert upload failed: %s") \
+    X(LOG_RESPIRATION,          "Minute: %u breaths/min (%u%%), %u crossings, %u s moving, %u dropped") \
+    X(LOG_VITALS_FAILED,        "Vitals upload failed: %s") \
+    X(LOG_BED,                  "Bed %u:") \
+    X(LOG_HOURLY_FAILED,        "Hourly summary upload failed: %s") \
+    X(LOG_DISCHARGE_CANCELLED,  "Discharge cancelled by double press") \
+    X(LOG_STATE_RESUMED,        "Workflow resumed from %s: state %d, unassigned %d") \
+    X(LOG_SENSOR_HEALTH,        "Sensor faults: FSR %x, temperature %x, occupancy mode %u") \
+    X(LOG_PROFILE_FAILED,       "Profile upload failed: %s") \
+    X(LOG_OTA_SCHEDULED,        "Update %s scheduled, starts %lu s into the rollout") \
+    X(LOG_OTA_STAGED,           "Update %s staged from %lu patch bytes") \
+    X(LOG_OTA_FAILED,           "Update failed: %s (HTTP %d)") \
+    X(LOG_OTA_INSTALLING,       "Installing update %s, restarting") \
+    X(LOG_OTA_CONFIRMED,        "Update %s passed its health check") \
+    X(LOG_OTA_ROLLBACK,         "Rolling back to the previous image") \
+    X(LOG_CAL_RESEED,           "FSR reads %d on an empty bed, below its baseline %d: baseline learned again") \
+    X(LOG_UPLINK_CONNECT_TIMEOUT, "Uplink connect gave up in step %u after %lu ms") \
+    X(LOG_MESH_RESIGNED,        "Mesh: no cloud connection, gave up the gateway role") \
+    X(LOG_OTA_NO_DIGEST,        "Update %s not installed: /ota has no valid targetSha256")
+
+#define LOG_ENUM_ENTRY(id, format) id,
+enum LogId : uint8_t {
+    LOG_MESSAGES(LOG_ENUM_ENTRY)
+    LOG_ID_COUNT
+};
+#undef LOG_ENUM_ENTRY
+
+#endif
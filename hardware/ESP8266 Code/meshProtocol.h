@@ -0,0 +1,609 @@
+#ifndef CURALINK_MESH_PROTOCOL_H
+#define CURALINK_MESH_PROTOCOL_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Bed-to-bed relay protocol. It does not depend on the radio, so the same code
+// runs over ESP-NOW (meshRelay.h) and in the host simulator (tools/mesh_sim.cpp).
+// - Every node broadcasts a beacon naming the gateway it follows, that gateway's
+//   beacon sequence number and its own hop count. The gateway bumps the
+//   sequence on every beacon; a gateway whose sequence stops advancing for
+//   MESH_GATEWAY_TIMEOUT_MS is considered gone.
+// - A node follows the best-ranked gateway it hears of (higher score, then
+//   lower id) within MESH_MAX_HOPS. Its parent is the neighbour with the lowest
+//   path cost: expected transmissions (ETX), estimated from how many of each
+//   neighbour's beacons arrive. Fewest hops alone would pick the long, lossy
+//   links at the edge of radio range.
+// - A gateway-capable node (score > 0) with no gateway for its election wait
+//   elects itself. Better-ranked candidates wait less. A gateway that hears
+//   of a better one stands down.
+// - State frames go hop by hop towards the gateway. Each hop is acknowledged
+//   (the ESP-NOW MAC ack on hardware) and retried; after MESH_PARENT_FAILURES
+//   undelivered frames the parent is dropped and avoided for a while.
+// - The TX queue is bounded. A newer state for the same bed replaces the queued
+//   one, since only the latest state matters; when full, the oldest is evicted.
+//
+// The Radio type provides:
+//   void send(uint16_t dst, const uint8_t* frame, uint8_t length)   // dst MESH_BROADCAST for beacons
+//   void deliver(const MeshState& state, uint32_t nowMs)             // Gateway only; ageMs is current
+//   uint32_t random(uint32_t limit)                                  // 0 .. limit-1
+// and calls receive() and sendDone() back.
+
+#define MESH_NO_NODE            0xFFFF
+#define MESH_BROADCAST          0xFFFF
+#define MESH_BEACON_INTERVAL_MS 2000
+#define MESH_GATEWAY_TIMEOUT_MS (3 * MESH_BEACON_INTERVAL_MS + MESH_BEACON_INTERVAL_MS / 2)
+#define MESH_ELECTION_WAIT_MS   (2 * MESH_BEACON_INTERVAL_MS)
+#define MESH_MAX_HOPS           6
+#define MESH_QUEUE_SIZE         8
+#define MESH_MAX_RETRIES        5
+#define MESH_ACK_TIMEOUT_MS     50       // Fallback if the radio never reports the send
+#define MESH_RETRY_BACKOFF_MS   20       // Random 0..this between attempts
+#define MESH_PARENT_FAILURES    2        // Undelivered frames before the parent is dropped
+#define MESH_DUPLICATE_SLOTS    8
+#define MESH_NEIGHBOUR_SLOTS    8
+#define MESH_COST_UNIT          4        // Path cost is in quarter transmissions
+#define MESH_NEW_LINK_COST      16       // Assumed for a link until its beacons are counted (50 %)
+#define MESH_COST_HYSTERESIS    6        // Half a transmission better before switching parent
+
+enum MeshFrameType : uint8_t {
+    MESH_FRAME_BEACON = 1,
+    MESH_FRAME_STATE = 2
+};
+
+enum MeshStateFlags : uint8_t {
+    MESH_FLAG_BODY_TEMP = 0x01,
+    MESH_FLAG_WEIGHT = 0x02,
+    MESH_FLAG_OCCUPIED = 0x04,
+    MESH_FLAG_ZONES = 0x08,         // Sender has FSR zones: exit risk and COP are valid
+    MESH_FLAG_EXIT_RISK = 0x10,
+    MESH_FLAG_ALERT = 0x20          // Exit risk just changed: jumps the queues, gateway writes the alert
+};
+
+// Frames are sent as-is: packed, little-endian on both the ESP8266 and x86
+struct __attribute__((packed)) MeshBeacon {
+    uint8_t type;               // MESH_FRAME_BEACON
+    uint16_t src;
+    uint16_t gateway;           // MESH_NO_NODE while the sender has no route
+    uint16_t gatewaySeq;
+    uint8_t gatewayScore;
+    uint8_t hops;               // Sender's distance to the gateway, 0 for the gateway
+    uint8_t cost;               // Sender's path cost in MESH_COST_UNITs
+    uint8_t beaconSeq;          // Sender's own counter, gaps show lost beacons
+};
+
+// Compact bed state, about a third of the JSON record
+struct __attribute__((packed)) MeshState {
+    uint16_t bed;
+    uint16_t seq;               // Per bed, newer replaces older along the path
+    uint32_t ageMs;             // Time since the sample, grows while queued
+    uint8_t status;             // BedStatus
+    uint8_t flags;              // MeshStateFlags
+    int16_t fsrValue;
+    int16_t temperatureCenti;
+    uint16_t fsrThreshold;
+    int16_t tempThresholdCentiC;
+    uint8_t calibrationConfidence;
+    uint8_t staffIdLength;
+    uint8_t staffId[7];         // Raw card UID bytes
+    uint32_t configRevision;
+    int16_t copX;               // Centre of pressure, permille
+    int16_t copY;
+    uint8_t sensorFaults;       // sensorHealth.h
+};
+
+struct __attribute__((packed)) MeshStateFrame {
+    uint8_t type;               // MESH_FRAME_STATE
+    uint16_t src;               // This hop
+    uint16_t dst;
+    MeshState state;
+};
+
+struct MeshStats {
+    uint32_t beaconsSent;
+    uint32_t framesSent;        // State frame transmissions, retries included
+    uint32_t retries;
+    uint32_t acked;
+    uint32_t retryDrops;        // Gave up after MESH_MAX_RETRIES
+    uint32_t queueDrops;        // Evicted from a full queue
+    uint32_t superseded;        // Replaced by a newer state for the same bed
+    uint32_t duplicates;        // Retransmissions already received
+    uint32_t relayed;           // Frames accepted from children
+    uint32_t delivered;         // States handed to the uplink (gateway)
+    uint32_t parentChanges;
+    uint32_t gatewayChanges;
+    uint32_t elections;         // Times this node became gateway
+};
+
+template<typename Radio>
+class MeshNode {
+public:
+    explicit MeshNode(Radio& link) : radio(link) {
+        for (uint8_t i = 0; i < MESH_DUPLICATE_SLOTS; i++) {
+            recent[i].src = MESH_NO_NODE;
+        }
+        for (uint8_t i = 0; i < MESH_NEIGHBOUR_SLOTS; i++) {
+            neighbours[i].id = MESH_NO_NODE;
+        }
+    }
+
+    // score 0: never a gateway (no cloud connection on this unit)
+    void begin(uint16_t nodeId, uint8_t candidateScore, uint32_t now) {
+        id = nodeId;
+        score = candidateScore;
+        clearRoute(now);
+        nextBeacon = now + radio.random(MESH_BEACON_INTERVAL_MS);
+    }
+
+    void tick(uint32_t now) {
+        if (gatewayId == id) {
+            // Nothing to expire
+        } else if (gatewayId != MESH_NO_NODE && now - lastAdvance > MESH_GATEWAY_TIMEOUT_MS) {
+            clearRoute(now);
+        } else if (gatewayId == MESH_NO_NODE && score > 0 && now - noRouteSince >= electionWait()) {
+            becomeGateway(now);
+        }
+
+        if ((int32_t)(now - nextBeacon) >= 0) {
+            sendBeacon(now);
+            // +-10 % jitter keeps neighbours from beaconing in lockstep
+            nextBeacon = now + MESH_BEACON_INTERVAL_MS * 9 / 10 + radio.random(MESH_BEACON_INTERVAL_MS / 5);
+        }
+
+        if (awaitingAck && now - sentAt > MESH_ACK_TIMEOUT_MS) {
+            sendDone(false, now);
+        }
+        if (!awaitingAck && queued > 0 && parentId != MESH_NO_NODE && (int32_t)(now - nextAttempt) >= 0) {
+            transmitHead(now);
+        }
+    }
+
+    // A frame from the radio, any type
+    void receive(const uint8_t* data, uint8_t length, uint32_t now) {
+        if (length == sizeof(MeshBeacon) && data[0] == MESH_FRAME_BEACON) {
+            MeshBeacon beacon;
+            memcpy(&beacon, data, sizeof(beacon));
+            onBeacon(beacon, now);
+        } else if (length == sizeof(MeshStateFrame) && data[0] == MESH_FRAME_STATE) {
+            MeshStateFrame frame;
+            memcpy(&frame, data, sizeof(frame));
+            if (frame.dst == id) {
+                onState(frame, now);
+            }
+        }
+    }
+
+    // Outcome of the last state frame (per-hop ack)
+    void sendDone(bool acked, uint32_t now) {
+        if (!awaitingAck) {
+            return;
+        }
+        awaitingAck = false;
+        if (acked) {
+            counters.acked++;
+            parentFailures = 0;
+            popHead();
+            return;
+        }
+        if (++attempts <= MESH_MAX_RETRIES) {
+            counters.retries++;
+            nextAttempt = now + 1 + radio.random(MESH_RETRY_BACKOFF_MS);
+            return;
+        }
+        counters.retryDrops++;
+        popHead();
+        if (++parentFailures >= MESH_PARENT_FAILURES) {
+            avoidId = parentId;
+            avoidSince = now;
+            dropParent();
+        }
+    }
+
+    // This bed's own state; the gateway delivers it directly
+    bool publish(const MeshState& state, uint32_t now) {
+        if (gatewayId == id) {
+            counters.delivered++;
+            radio.deliver(state, now);
+            return true;
+        }
+        enqueue(state, now);
+        return true;
+    }
+
+    // Give the gateway role up and stay out of elections (this unit could
+    // not reach the cloud); the others elect a new gateway as if it had gone
+    void resign(uint32_t now) {
+        score = 0;
+        if (gatewayId == id) {
+            clearRoute(now);
+        }
+    }
+
+    // Stand for election again
+    void candidate(uint8_t candidateScore) { score = candidateScore; }
+
+    bool isGateway() const { return gatewayId == id; }
+    bool hasRoute() const { return gatewayId == id || parentId != MESH_NO_NODE; }
+    uint16_t nodeId() const { return id; }
+    uint16_t gateway() const { return gatewayId; }
+    uint16_t parent() const { return parentId; }
+    uint8_t hops() const { return gatewayId == id ? 0 : hopCount; }
+    uint8_t queueLength() const { return queued; }
+    const MeshStats& stats() const { return counters; }
+
+private:
+    struct Entry {
+        MeshState state;
+        uint32_t enqueuedAt;
+    };
+
+    struct Neighbour {
+        uint16_t id;                // MESH_NO_NODE: free slot
+        uint16_t gateway;           // As advertised
+        uint16_t gatewaySeq;
+        uint8_t gatewayScore;
+        uint8_t hops;
+        uint8_t cost;
+        uint8_t beaconSeq;
+        uint8_t quality;            // Share of its beacons received, 255 = all
+        uint32_t lastHeard;
+    };
+
+    // Higher score wins, then the lower id
+    static bool outranks(uint8_t scoreA, uint16_t idA, uint8_t scoreB, uint16_t idB) {
+        return scoreA != scoreB ? scoreA > scoreB : idA < idB;
+    }
+
+    // Best candidates elect first, so usually only one does
+    uint32_t electionWait() const {
+        return MESH_ELECTION_WAIT_MS + (uint32_t)(255 - score) * MESH_BEACON_INTERVAL_MS / 256 +
+               (id % 16) * MESH_BEACON_INTERVAL_MS / 32;
+    }
+
+    void clearRoute(uint32_t now) {
+        if (gatewayId != MESH_NO_NODE) {
+            counters.gatewayChanges++;
+            // Neighbours that have not timed out yet still advertise it
+            lostGateway = gatewayId;
+            lostGatewaySeq = gatewaySeq;
+        }
+        gatewayId = MESH_NO_NODE;
+        noRouteSince = now;
+        dropParent();
+    }
+
+    void becomeGateway(uint32_t now) {
+        gatewayId = id;
+        gatewayScore = score;
+        dropParent();
+        counters.elections++;
+        counters.gatewayChanges++;
+        // Queued states are ours to deliver now
+        while (queued > 0) {
+            MeshState state = queue[0].state;
+            state.ageMs += now - queue[0].enqueuedAt;
+            counters.delivered++;
+            radio.deliver(state, now);
+            popHead();
+        }
+    }
+
+    void dropParent() {
+        if (parentId != MESH_NO_NODE) {
+            // Only a sequence newer than this proves a new path is live
+            lossSeq = gatewaySeq;
+        }
+        parentId = MESH_NO_NODE;
+        awaitingAck = false;
+    }
+
+    void setParent(const Neighbour& n) {
+        if (n.id != parentId) {
+            counters.parentChanges++;
+            awaitingAck = false;  // A pending frame is resent to the new parent
+            attempts = 0;
+        }
+        parentId = n.id;
+        hopCount = n.hops + 1;
+        pathCost = totalCost(n);
+    }
+
+    // Expected transmissions over the link: frame and ack must both arrive, and
+    // the beacon reception rate is taken for both directions
+    static uint8_t linkCost(const Neighbour& n) {
+        uint32_t q = n.quality > 0 ? n.quality : 1;
+        uint32_t cost = MESH_COST_UNIT * 255 * 255 / (q * q);
+        return cost > 255 ? 255 : (uint8_t)cost;
+    }
+
+    static uint8_t totalCost(const Neighbour& n) {
+        uint16_t cost = (uint16_t)n.cost + linkCost(n);
+        return cost > 255 ? 255 : (uint8_t)cost;
+    }
+
+    Neighbour* findNeighbour(uint16_t nodeId) {
+        for (uint8_t i = 0; i < MESH_NEIGHBOUR_SLOTS; i++) {
+            if (neighbours[i].id == nodeId) {
+                return &neighbours[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Slot for a newly heard neighbour: a free or stale one, else the worst
+    // entry (no route counts as worst) if the newcomer advertises a better path
+    Neighbour* allocateNeighbour(const MeshBeacon& beacon, uint32_t now) {
+        Neighbour* worst = nullptr;
+        for (uint8_t i = 0; i < MESH_NEIGHBOUR_SLOTS; i++) {
+            Neighbour& n = neighbours[i];
+            if (n.id == MESH_NO_NODE || now - n.lastHeard > MESH_GATEWAY_TIMEOUT_MS) {
+                return &n;
+            }
+            if (n.id != parentId && (worst == nullptr || rankCost(n) > rankCost(*worst))) {
+                worst = &n;
+            }
+        }
+        uint16_t offered = beacon.gateway == MESH_NO_NODE ? 0xFFFF : beacon.cost + MESH_NEW_LINK_COST;
+        if (worst != nullptr && offered < rankCost(*worst)) {
+            return worst;
+        }
+        return nullptr;
+    }
+
+    uint16_t rankCost(const Neighbour& n) const {
+        return n.gateway == MESH_NO_NODE || n.gateway != gatewayId ? 0xFFFF : totalCost(n);
+    }
+
+    bool usable(const Neighbour& n, uint32_t now) const {
+        return n.id != MESH_NO_NODE && n.gateway == gatewayId && n.hops < MESH_MAX_HOPS &&
+               now - n.lastHeard <= MESH_GATEWAY_TIMEOUT_MS &&
+               !(n.id == avoidId && now - avoidSince < MESH_GATEWAY_TIMEOUT_MS);
+    }
+
+    // Pick the cheapest path to our gateway. Candidates must be closer to the
+    // gateway than we are, so a child is never chosen (no loops); without a
+    // parent we advertise no route, and take only a newer sequence number.
+    void chooseParent(uint32_t now) {
+        if (gatewayId == id || gatewayId == MESH_NO_NODE) {
+            return;
+        }
+        Neighbour* current = parentId != MESH_NO_NODE ? findNeighbour(parentId) : nullptr;
+        if (parentId != MESH_NO_NODE && (current == nullptr || !usable(*current, now))) {
+            dropParent();
+            current = nullptr;
+        }
+        uint8_t best = current != nullptr ? totalCost(*current) : 255;
+        Neighbour* choice = current;
+        for (uint8_t i = 0; i < MESH_NEIGHBOUR_SLOTS; i++) {
+            Neighbour& n = neighbours[i];
+            if (&n == current || !usable(n, now)) {
+                continue;
+            }
+            if (current == nullptr ? (int16_t)(n.gatewaySeq - lossSeq) <= 0 : n.cost >= pathCost) {
+                continue;
+            }
+            uint8_t cost = totalCost(n);
+            if (choice == nullptr || cost + (current != nullptr ? MESH_COST_HYSTERESIS : 0) < best) {
+                choice = &n;
+                best = cost;
+            }
+        }
+        if (choice != nullptr) {
+            setParent(*choice);
+        }
+    }
+
+    void onBeacon(const MeshBeacon& beacon, uint32_t now) {
+        if (beacon.src == id) {
+            return;
+        }
+        Neighbour* n = findNeighbour(beacon.src);
+        if (n == nullptr) {
+            n = allocateNeighbour(beacon, now);
+            if (n != nullptr) {
+                *n = {beacon.src, MESH_NO_NODE, 0, 0, 0, 0, (uint8_t)(beacon.beaconSeq - 1), 128, now};  // 50 %
+            }
+        }
+        if (n != nullptr) {
+            // EWMA of reception, each missed beacon counts as a zero
+            uint8_t gap = beacon.beaconSeq - n->beaconSeq;
+            for (uint8_t k = 1; k < gap && k < 8; k++) {
+                n->quality -= n->quality / 8;
+            }
+            n->quality += (255 - n->quality) / 8;
+            n->beaconSeq = beacon.beaconSeq;
+            n->gateway = beacon.gateway;
+            n->gatewaySeq = beacon.gatewaySeq;
+            n->gatewayScore = beacon.gatewayScore;
+            n->hops = beacon.hops;
+            n->cost = beacon.cost;
+            n->lastHeard = now;
+        }
+
+        // Our parent moved to another gateway or lost its route
+        if (beacon.src == parentId && beacon.gateway != gatewayId) {
+            dropParent();
+        }
+        if (beacon.gateway == MESH_NO_NODE || beacon.gateway == id || beacon.hops >= MESH_MAX_HOPS) {
+            return;
+        }
+
+        if (gatewayId != beacon.gateway) {
+            bool better = gatewayId == MESH_NO_NODE ||
+                          outranks(beacon.gatewayScore, beacon.gateway, gatewayScore, gatewayId);
+            bool stale = beacon.gateway == lostGateway && (int16_t)(beacon.gatewaySeq - lostGatewaySeq) <= 0;
+            if (!better || stale || n == nullptr) {
+                return;
+            }
+            // Follow the better gateway; a gateway that hears of one stands down here too
+            counters.gatewayChanges++;
+            gatewayId = beacon.gateway;
+            gatewayScore = beacon.gatewayScore;
+            gatewaySeq = beacon.gatewaySeq;
+            lastAdvance = now;
+            setParent(*n);
+            return;
+        }
+
+        if ((int16_t)(beacon.gatewaySeq - gatewaySeq) > 0) {
+            gatewaySeq = beacon.gatewaySeq;
+            lastAdvance = now;
+        }
+        if (beacon.src == parentId && n != nullptr) {
+            hopCount = n->hops + 1;
+            pathCost = totalCost(*n);
+        } else if (parentId == MESH_NO_NODE) {
+            chooseParent(now);
+        }
+    }
+
+    void onState(const MeshStateFrame& frame, uint32_t now) {
+        // A lost ack makes the sender retransmit; the MAC layer acked it already
+        for (uint8_t i = 0; i < MESH_DUPLICATE_SLOTS; i++) {
+            if (recent[i].src == frame.src && recent[i].bed == frame.state.bed &&
+                recent[i].seq == frame.state.seq) {
+                counters.duplicates++;
+                return;
+            }
+        }
+        recent[recentNext] = {frame.src, frame.state.bed, frame.state.seq};
+        recentNext = (recentNext + 1) % MESH_DUPLICATE_SLOTS;
+
+        counters.relayed++;
+        if (gatewayId == id) {
+            counters.delivered++;
+            radio.deliver(frame.state, now);
+            return;
+        }
+        enqueue(frame.state, now);
+    }
+
+    void enqueue(const MeshState& state, uint32_t now) {
+        // The head may be in flight, so it is never replaced
+        for (uint8_t i = awaitingAck ? 1 : 0; i < queued; i++) {
+            if (queue[i].state.bed != state.bed) {
+                continue;
+            }
+            counters.superseded++;
+            if ((int16_t)(state.seq - queue[i].state.seq) > 0) {
+                // A newer state must not swallow an alert that has not gone out
+                uint8_t alert = queue[i].state.flags & MESH_FLAG_ALERT;
+                queue[i] = {state, now};
+                queue[i].state.flags |= alert;
+                if (queue[i].state.flags & MESH_FLAG_ALERT) {
+                    moveForward(i);
+                }
+            }
+            return;
+        }
+        if (queued == MESH_QUEUE_SIZE) {
+            counters.queueDrops++;
+            uint8_t oldest = awaitingAck ? 1 : 0;
+            for (uint8_t i = oldest; i + 1 < queued; i++) {
+                queue[i] = queue[i + 1];
+            }
+            queued--;
+        }
+        queue[queued++] = {state, now};
+        if (state.flags & MESH_FLAG_ALERT) {
+            moveForward(queued - 1);
+        }
+    }
+
+    // Alerts go out next, behind the frame in flight and earlier alerts
+    void moveForward(uint8_t index) {
+        uint8_t first = awaitingAck ? 1 : 0;
+        while (index > first && !(queue[index - 1].state.flags & MESH_FLAG_ALERT)) {
+            Entry entry = queue[index - 1];
+            queue[index - 1] = queue[index];
+            queue[index] = entry;
+            index--;
+        }
+    }
+
+    void popHead() {
+        for (uint8_t i = 1; i < queued; i++) {
+            queue[i - 1] = queue[i];
+        }
+        if (queued > 0) {
+            queued--;
+        }
+        attempts = 0;
+    }
+
+    void transmitHead(uint32_t now) {
+        MeshStateFrame frame;
+        frame.type = MESH_FRAME_STATE;
+        frame.src = id;
+        frame.dst = parentId;
+        frame.state = queue[0].state;
+        frame.state.ageMs += now - queue[0].enqueuedAt;
+        awaitingAck = true;
+        sentAt = now;
+        counters.framesSent++;
+        radio.send(parentId, (const uint8_t*)&frame, sizeof(frame));
+    }
+
+    void sendBeacon(uint32_t now) {
+        if (gatewayId == id) {
+            gatewaySeq++;
+        } else {
+            chooseParent(now);
+        }
+        MeshBeacon beacon;
+        beacon.type = MESH_FRAME_BEACON;
+        beacon.src = id;
+        // Without a parent we cannot relay, so do not attract children
+        bool routed = gatewayId == id || parentId != MESH_NO_NODE;
+        beacon.gateway = routed ? gatewayId : MESH_NO_NODE;
+        beacon.gatewaySeq = gatewaySeq;
+        beacon.gatewayScore = gatewayId == id ? score : gatewayScore;
+        beacon.hops = hops();
+        beacon.cost = gatewayId == id ? 0 : routed ? pathCost : 255;
+        beacon.beaconSeq = ++beaconSeq;
+        counters.beaconsSent++;
+        radio.send(MESH_BROADCAST, (const uint8_t*)&beacon, sizeof(beacon));
+    }
+
+    struct Recent {
+        uint16_t src;
+        uint16_t bed;
+        uint16_t seq;
+    };
+
+    Radio& radio;
+    uint16_t id = MESH_NO_NODE;
+    uint8_t score = 0;
+
+    uint16_t gatewayId = MESH_NO_NODE;
+    uint8_t gatewayScore = 0;
+    uint16_t gatewaySeq = 0;
+    uint16_t parentId = MESH_NO_NODE;
+    uint8_t hopCount = 0;
+    uint8_t pathCost = 0;
+    uint16_t lossSeq = 0;
+    uint16_t lostGateway = MESH_NO_NODE;
+    uint16_t lostGatewaySeq = 0;
+    uint8_t beaconSeq = 0;
+    uint32_t lastAdvance = 0;
+    uint32_t noRouteSince = 0;
+    uint32_t nextBeacon = 0;
+    uint16_t avoidId = MESH_NO_NODE;
+    uint32_t avoidSince = 0;
+
+    Entry queue[MESH_QUEUE_SIZE];
+    uint8_t queued = 0;
+    bool awaitingAck = false;
+    uint8_t attempts = 0;
+    uint8_t parentFailures = 0;
+    uint32_t sentAt = 0;
+    uint32_t nextAttempt = 0;
+
+    Neighbour neighbours[MESH_NEIGHBOUR_SLOTS];
+    Recent recent[MESH_DUPLICATE_SLOTS] = {};
+    uint8_t recentNext = 0;
+    MeshStats counters = {};
+};
+
+#endif
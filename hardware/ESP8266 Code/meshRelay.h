@@ -0,0 +1,396 @@
+#ifndef CURALINK_MESH_RELAY_H
+#define CURALINK_MESH_RELAY_H
+
+#include "firmwareProfile.h"
+#include "meshProtocol.h"
+#include "bedUplink.h"
+#include "eventLog.h"
+
+#if FEATURE_MESH
+#include <ESP8266WiFi.h>
+#include <espnow.h>
+#endif
+
+// ESP-NOW relay policy (FEATURE_MESH): beds hand their record to an elected
+// gateway bed instead of each holding its own WiFi + Firebase session. The
+// protocol (election, routing, per-hop acks, bounded queue) is in
+// meshProtocol.h; this class is the ESP-NOW radio under it and, on the
+// gateway, batches relayed records into one Firebase update.
+// - All beds and the access point must share MESH_CHANNEL: ESP-NOW only
+//   reaches radios on the same channel, and the gateway's WiFi follows the AP.
+// - Only units with FEATURE_NETWORK can be elected (score MESH_GATEWAY_SCORE;
+//   give beds near the access point a higher score).
+// MeshRelay<false> never relays, so every unit uses its own uplink.
+
+#ifndef MESH_CHANNEL
+#define MESH_CHANNEL            1
+#endif
+#ifndef MESH_GATEWAY_SCORE
+#define MESH_GATEWAY_SCORE      128     // 1-255, higher is preferred as gateway
+#endif
+#define MESH_HEARTBEAT_MS       10000   // Minimum heartbeat period for relayed beds
+#define MESH_BATCH_SIZE         16      // Relayed records per Firebase update
+#define MESH_BATCH_INTERVAL_MS  1000    // Longest a relayed record waits for the batch
+#define MESH_RX_SLOTS           8       // Frames buffered between the radio callback and poll()
+#define MESH_PEER_SLOTS         16      // Node id -> MAC, learned from beacons
+#define MESH_CONNECT_TIMEOUT_MS 60000   // A new gateway must reach Firebase in this time...
+#define MESH_RESIGN_HOLD_MS     (5 * 60000UL)   // ...or stays out of elections this long
+
+template<bool Enabled>
+class MeshRelay {
+public:
+    template<typename Uplink>
+    MeshRelay(Uplink&, TimeSync&) {}
+    void begin(uint16_t, UplinkProgressFn) {}
+    void poll() {}
+    bool relaying() const { return false; }
+    bool promoted() { return false; }
+    bool demoted() { return false; }
+    bool publish(const BedRecord&) { return false; }
+};
+
+#if FEATURE_MESH
+
+template<>
+class MeshRelay<true> {
+public:
+    typedef BedUplink<FEATURE_NETWORK> Uplink;
+
+    MeshRelay(Uplink& link, TimeSync& clock) : uplink(link), timeSync(clock), node(*this) {
+        for (uint8_t i = 0; i < MESH_PEER_SLOTS; i++) {
+            peers[i].id = MESH_NO_NODE;
+        }
+    }
+
+    // Start the radio and wait long enough for a running mesh to be heard
+    // (or for this unit to win the election)
+    void begin(uint16_t bed, UplinkProgressFn progress) {
+        instance = this;
+        bedId = bed;
+        WiFi.mode(WIFI_STA);
+        WiFi.disconnect();
+        wifi_set_channel(MESH_CHANNEL);
+        esp_now_init();
+        esp_now_set_self_role(ESP_NOW_ROLE_COMBO);
+        esp_now_register_recv_cb(onReceive);
+        esp_now_register_send_cb(onSent);
+        esp_now_add_peer((uint8_t*)BROADCAST_MAC, ESP_NOW_ROLE_COMBO, MESH_CHANNEL, nullptr, 0);
+
+        node.begin(bed, FEATURE_NETWORK ? MESH_GATEWAY_SCORE : 0, millis());
+        progress(TEXT_JOINING_MESH);
+        unsigned long start = millis();
+        while (!node.hasRoute() && millis() - start < MESH_ELECTION_WAIT_MS + 2 * MESH_BEACON_INTERVAL_MS) {
+            poll();
+            delay(10);
+        }
+    }
+
+    void poll() {
+        uint32_t now = millis();
+        while (rxTail != rxHead) {
+            RxFrame& frame = rx[rxTail % MESH_RX_SLOTS];
+            if (frame.length == sizeof(MeshBeacon) && frame.data[0] == MESH_FRAME_BEACON) {
+                MeshBeacon beacon;
+                memcpy(&beacon, frame.data, sizeof(beacon));
+                rememberPeer(beacon.src, frame.mac);
+            }
+            node.receive(frame.data, frame.length, now);
+            rxTail++;
+        }
+        if (sendPending && sendReported) {
+            sendPending = false;
+            sendReported = false;
+            node.sendDone(sendAcked, now);
+        }
+        if (rxDropped != rxDropReported) {
+            LOG(LOG_MESH_RX_DROPPED, rxDropped - rxDropReported);
+            rxDropReported = rxDropped;
+        }
+
+        // A gateway that cannot reach the AP or Firebase hands the role on
+        if (uplink.connectFailed() && node.isGateway()) {
+            LOG(LOG_MESH_RESIGNED);
+            node.resign(now);
+            resigned = true;
+            resignedMs = now;
+        } else if (resigned && now - resignedMs >= MESH_RESIGN_HOLD_MS) {
+            node.candidate(FEATURE_NETWORK ? MESH_GATEWAY_SCORE : 0);
+            resigned = false;
+        }
+
+        node.tick(now);
+        trackRole();
+
+        // A former gateway's WiFi left the mesh channel when it disconnected
+        if (!node.isGateway() && wifi_get_channel() != MESH_CHANNEL) {
+            wifi_set_channel(MESH_CHANNEL);
+        }
+        if (batched > 0 && (batched == MESH_BATCH_SIZE || now - batchStart >= MESH_BATCH_INTERVAL_MS)) {
+            flushBatch();
+        }
+    }
+
+    // Not the gateway: records go through the mesh
+    bool relaying() const { return !node.isGateway(); }
+
+    // True once when this unit became / stopped being the gateway
+    bool promoted() {
+        bool edge = becameGateway;
+        becameGateway = false;
+        return edge;
+    }
+
+    bool demoted() {
+        bool edge = stoodDown;
+        stoodDown = false;
+        return edge;
+    }
+
+    bool publish(const BedRecord& record) {
+        MeshState state = {};
+        state.bed = bedId;
+        state.seq = ++stateSeq;
+        // Age since the sample; the gateway turns it back into a timestamp
+        state.ageMs = (uint32_t)(timeSync.monotonicMs(millis()) - record.stamp.monoMs);
+        state.status = record.status;
+        state.flags = (record.hasBodyTemp ? MESH_FLAG_BODY_TEMP : 0) |
+                      (record.hasWeight ? MESH_FLAG_WEIGHT : 0) |
+                      (record.isOccupied ? MESH_FLAG_OCCUPIED : 0) |
+                      (record.hasZones ? MESH_FLAG_ZONES : 0) |
+                      (record.exitRisk ? MESH_FLAG_EXIT_RISK : 0) |
+                      (record.exitChanged ? MESH_FLAG_ALERT : 0);
+        state.copX = record.copX;
+        state.copY = record.copY;
+        state.fsrValue = record.fsrValue;
+        state.temperatureCenti = record.temperatureCenti;
+        state.fsrThreshold = record.fsrThreshold;
+        state.tempThresholdCentiC = record.tempThresholdCentiC;
+        state.calibrationConfidence = record.calibrationConfidence;
+        state.sensorFaults = record.sensorFaults;
+        state.configRevision = record.configRevision;
+        // Staff UIDs are hex strings; two characters per byte
+        for (unsigned i = 0; i + 1 < record.staffId.length() && state.staffIdLength < sizeof(state.staffId); i += 2) {
+            state.staffId[state.staffIdLength++] = strtoul(record.staffId.substring(i, i + 2).c_str(), nullptr, 16);
+        }
+        return node.publish(state, millis());
+    }
+
+    const MeshNode<MeshRelay<true>>& status() const { return node; }
+
+    // Radio interface for MeshNode
+    void send(uint16_t dst, const uint8_t* frame, uint8_t length) {
+        if (dst == MESH_BROADCAST) {
+            esp_now_send((uint8_t*)BROADCAST_MAC, (uint8_t*)frame, length);
+            return;
+        }
+        const uint8_t* mac = peerMac(dst);
+        if (mac == nullptr || !selectPeer(mac)) {
+            sendAcked = false;
+            sendReported = true;
+            sendPending = true;
+            return;
+        }
+        sendPending = true;
+        sendReported = false;
+        if (esp_now_send((uint8_t*)mac, (uint8_t*)frame, length) != 0) {
+            sendAcked = false;
+            sendReported = true;
+        }
+    }
+
+    void deliver(const MeshState& state, uint32_t) {
+        if (batched == MESH_BATCH_SIZE) {
+            flushBatch();
+            if (batched == MESH_BATCH_SIZE) {
+                // Uplink down: keep the newest
+                for (uint8_t i = 1; i < batched; i++) {
+                    batch[i - 1] = batch[i];
+                }
+                batched--;
+                batchDrops++;
+            }
+        }
+        if (batched == 0) {
+            batchStart = millis();
+        }
+        BedRecord& record = batch[batched++];
+        record.bed = state.bed;
+        record.status = (BedStatus)state.status;
+        record.fsrValue = state.fsrValue;
+        record.temperatureCenti = state.temperatureCenti;
+        record.hasBodyTemp = state.flags & MESH_FLAG_BODY_TEMP;
+        record.hasWeight = state.flags & MESH_FLAG_WEIGHT;
+        record.isOccupied = state.flags & MESH_FLAG_OCCUPIED;
+        record.hasZones = state.flags & MESH_FLAG_ZONES;
+        record.exitRisk = state.flags & MESH_FLAG_EXIT_RISK;
+        record.exitChanged = state.flags & MESH_FLAG_ALERT;
+        record.copX = state.copX;
+        record.copY = state.copY;
+        record.stamp = timeSync.stamp(timeSync.monotonicMs(millis()) - state.ageMs);
+        record.staffId = "";
+        for (uint8_t i = 0; i < state.staffIdLength && i < sizeof(state.staffId); i++) {
+            char hex[3];
+            snprintf(hex, sizeof(hex), "%02X", state.staffId[i]);
+            record.staffId += hex;
+        }
+        record.configRevision = state.configRevision;
+        record.fsrThreshold = state.fsrThreshold;
+        record.tempThresholdCentiC = state.tempThresholdCentiC;
+        record.calibrationConfidence = state.calibrationConfidence;
+        record.sensorFaults = state.sensorFaults;
+
+        // Exit risk raised or cleared on a relayed bed: alert and write at once
+        if (record.exitChanged && uplink.ready()) {
+            uplink.sendAlert(record);
+            flushBatch();
+        }
+    }
+
+    uint32_t random(uint32_t limit) {
+        return limit > 0 ? ESP.random() % limit : 0;
+    }
+
+    uint32_t batchDropCount() const { return batchDrops; }
+
+private:
+    struct RxFrame {
+        uint8_t mac[6];
+        uint8_t length;
+        uint8_t data[sizeof(MeshStateFrame)];
+    };
+
+    struct Peer {
+        uint16_t id;
+        uint8_t mac[6];
+    };
+
+    static constexpr uint8_t BROADCAST_MAC[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+    // Radio callbacks run in the WiFi task: copy and return, poll() does the work
+    static void onReceive(uint8_t* mac, uint8_t* data, uint8_t length) {
+        MeshRelay& self = *instance;
+        if (length > sizeof(MeshStateFrame)) {
+            return;
+        }
+        if ((uint8_t)(self.rxHead - self.rxTail) >= MESH_RX_SLOTS) {
+            self.rxDropped++;
+            return;
+        }
+        RxFrame& frame = self.rx[self.rxHead % MESH_RX_SLOTS];
+        memcpy(frame.mac, mac, sizeof(frame.mac));
+        memcpy(frame.data, data, length);
+        frame.length = length;
+        self.rxHead++;
+    }
+
+    // The MAC-layer ack of a unicast frame is our per-hop ack
+    static void onSent(uint8_t* mac, uint8_t status) {
+        MeshRelay& self = *instance;
+        if (memcmp(mac, BROADCAST_MAC, sizeof(BROADCAST_MAC)) == 0 || !self.sendPending) {
+            return;
+        }
+        self.sendAcked = status == 0;
+        self.sendReported = true;
+    }
+
+    void rememberPeer(uint16_t id, const uint8_t* mac) {
+        for (uint8_t i = 0; i < MESH_PEER_SLOTS; i++) {
+            if (peers[i].id == id) {
+                memcpy(peers[i].mac, mac, sizeof(peers[i].mac));
+                return;
+            }
+        }
+        // Round robin; the parent is re-learned from its next beacon if overwritten
+        peers[peerNext].id = id;
+        memcpy(peers[peerNext].mac, mac, sizeof(peers[peerNext].mac));
+        peerNext = (peerNext + 1) % MESH_PEER_SLOTS;
+    }
+
+    const uint8_t* peerMac(uint16_t id) const {
+        for (uint8_t i = 0; i < MESH_PEER_SLOTS; i++) {
+            if (peers[i].id == id) {
+                return peers[i].mac;
+            }
+        }
+        return nullptr;
+    }
+
+    // ESP-NOW unicast needs the receiver registered; only the parent ever is
+    bool selectPeer(const uint8_t* mac) {
+        if (hasPeer && memcmp(mac, currentPeer, sizeof(currentPeer)) == 0) {
+            return true;
+        }
+        if (hasPeer) {
+            esp_now_del_peer(currentPeer);
+        }
+        memcpy(currentPeer, mac, sizeof(currentPeer));
+        hasPeer = esp_now_add_peer(currentPeer, ESP_NOW_ROLE_COMBO, MESH_CHANNEL, nullptr, 0) == 0;
+        return hasPeer;
+    }
+
+    void trackRole() {
+        uint16_t gateway = node.gateway();
+        if (gateway == lastGateway) {
+            return;
+        }
+        if (gateway == bedId) {
+            becameGateway = true;
+            LOG(LOG_MESH_GATEWAY);
+        } else if (lastGateway == bedId) {
+            stoodDown = true;
+        }
+        if (gateway == MESH_NO_NODE) {
+            LOG(LOG_MESH_NO_ROUTE);
+        } else if (gateway != bedId) {
+            LOG(LOG_MESH_FOLLOWING, gateway);
+        }
+        lastGateway = gateway;
+    }
+
+    void flushBatch() {
+        if (!uplink.ready()) {
+            return;
+        }
+        if (!uplink.sendBatch(batch, batched)) {
+            LOG(LOG_MESH_BATCH_FAILED, batched);
+            batchDrops += batched;
+        }
+        batched = 0;
+    }
+
+    static inline MeshRelay* instance = nullptr;
+
+    Uplink& uplink;
+    TimeSync& timeSync;
+    MeshNode<MeshRelay<true>> node;
+    uint16_t bedId = 0;
+    uint16_t stateSeq = 0;
+    uint16_t lastGateway = MESH_NO_NODE;
+    bool becameGateway = false;
+    bool stoodDown = false;
+    bool resigned = false;          // Out of elections until MESH_RESIGN_HOLD_MS has passed
+    uint32_t resignedMs = 0;
+
+    RxFrame rx[MESH_RX_SLOTS];
+    volatile uint8_t rxHead = 0;            // Written by onReceive only
+    volatile uint8_t rxTail = 0;            // Written by poll() only
+    volatile uint32_t rxDropped = 0;
+    uint32_t rxDropReported = 0;
+
+    volatile bool sendPending = false;
+    volatile bool sendReported = false;
+    volatile bool sendAcked = false;
+    Peer peers[MESH_PEER_SLOTS];
+    uint8_t peerNext = 0;
+    uint8_t currentPeer[6] = {};
+    bool hasPeer = false;
+
+    BedRecord batch[MESH_BATCH_SIZE];
+    uint8_t batched = 0;
+    unsigned long batchStart = 0;
+    uint32_t batchDrops = 0;
+};
+
+#endif  // FEATURE_MESH
+
+#endif
@@ -0,0 +1,225 @@
+#ifndef CURALINK_OCCUPANCY_CALIBRATION_H
+#define CURALINK_OCCUPANCY_CALIBRATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "sensorMath.h"
+#include "bedConfig.h"
+#include "flashRecord.h"
+
+// Online calibration of the occupancy sensors.
+// While the bed is empty the engine learns the FSR baseline and noise floor,
+// and the bed surface temperature relative to the MLX90614 ambient channel.
+// Once thresholds are learned, nothing is learned from a reading above them:
+// a bag on an empty bed weighs the FSR, a heating pad warms the surface, and
+// neither should become the new empty bed. The hysteresis band does not
+// count, so a preload that crept up during a stay is still followed.
+// Thresholds are then derived per bed instead of the fixed 50 counts / 32 °C:
+//   weight:    baseline + max(fsrMinMargin, CAL_NOISE_FACTOR * noise)
+//   body heat: ambient + surface delta + bodyMarginCentiC
+// Both decisions use hysteresis so readings hovering at a threshold do not
+// flap. Until enough empty-bed samples are seen (confidence) the configured
+// thresholds are used. Learned state is persisted so it survives reboots.
+
+#define CAL_MAGIC               0x4C41434CUL   // "CLAL"
+#define CAL_FILE                "/calibration.bin"     // First bed; further beds add their slot number
+#define CAL_TMP_FILE            "/calibration.tmp"
+#define CAL_FULL_SAMPLES        240            // Empty-bed samples for full confidence (2 min at 500 ms)
+#define CAL_MIN_CONFIDENCE      50             // Percent; below this the configured thresholds apply
+#define CAL_EWMA_WINDOW         64             // Learned values follow ~1/64 of each new sample
+#define CAL_NOISE_FACTOR        6
+#define CAL_OUTLIER_FACTOR      4              // The baseline moves at most 4 * noise + margin per window
+#define CAL_SETTLE_SAMPLES      20             // Empty samples before the FSR is learned (getting off)
+#define CAL_SURFACE_SETTLE_SAMPLES 600         // Empty samples before the surface is learned (residual heat)
+#define CAL_SAVE_INTERVAL_MS    (30UL * 60000UL)
+#define FSR_HYSTERESIS_MIN      10             // ADC counts
+#define TEMP_HYSTERESIS_CENTI   50             // 0.5 °C
+#define TEMP_MIN_BODY_CENTI     2600           // Compensated body threshold limits
+#define TEMP_MAX_BODY_CENTI     3500
+#define AMBIENT_INVALID         CENTI_INVALID
+
+// Persisted learning state; values are kept in 1/16 units (Q4) for precision
+struct CalibrationState {
+    uint32_t magic;
+    int32_t fsrBaselineQ4;      // Empty-bed FSR reading
+    int32_t fsrNoiseQ4;         // Mean absolute deviation around the baseline
+    int32_t surfaceDeltaQ4;     // Empty-bed object - ambient temperature, centi-degrees
+    uint32_t fsrSamples;
+    uint32_t surfaceSamples;
+    uint32_t crc;
+};
+
+class OccupancyCalibration {
+public:
+    // slot: bed on a multi-bed controller; each keeps its own learned state
+    void begin(uint8_t slot = 0) {
+        if (slot == 0) {
+            strcpy(path, CAL_FILE);
+        } else {
+            snprintf(path, sizeof(path), "/calibration%u.bin", slot);
+        }
+        CalibrationState loaded;
+        size_t n = FlashRecord<FEATURE_PERSISTENCE>::load(path, &loaded, sizeof(loaded));
+        if (n == sizeof(loaded) && loaded.magic == CAL_MAGIC &&
+            loaded.crc == flashCrc32((const uint8_t*)&loaded, offsetof(CalibrationState, crc))) {
+            state = loaded;
+            settledQ4 = state.fsrBaselineQ4;
+            savedSamples = state.fsrSamples;
+        }
+    }
+
+    // Forget everything learned (e.g. after a mattress change)
+    void reset() {
+        memset(&state, 0, sizeof(state));
+        settledQ4 = 0;
+        windowSamples = 0;
+        savedSamples = 0;
+        lastSaveMs = 0;
+        dirty = true;
+    }
+
+    // Feed one filtered sample. ambientCentiC may be AMBIENT_INVALID.
+    // bedEmpty is the debounced occupancy state (true when nobody is on the bed).
+    // fsrTrusted false (a faulted FSR, sensorHealth.h) keeps the baseline as it is.
+    void update(int fsr, centi_t objectCentiC, centi_t ambientCentiC, bool bedEmpty,
+                const BedSettings& settings, bool fsrTrusted = true) {
+        bool calibrated = settings.autoCalibrate && confidence() >= CAL_MIN_CONFIDENCE;
+
+        // Derive thresholds from what has been learned so far
+        if (calibrated) {
+            int32_t noise = state.fsrNoiseQ4 >> 4;
+            int32_t margin = CAL_NOISE_FACTOR * noise;
+            if (margin < settings.fsrMinMargin) margin = settings.fsrMinMargin;
+            int32_t thr = (state.fsrBaselineQ4 >> 4) + margin;
+            fsrThr = (uint16_t)(thr > 1023 ? 1023 : thr);
+        } else {
+            fsrThr = settings.fsrThreshold;
+        }
+
+        bool surfaceCalibrated = calibrated && ambientCentiC != AMBIENT_INVALID &&
+                                 state.surfaceSamples >= CAL_FULL_SAMPLES / 2;
+        if (surfaceCalibrated) {
+            int32_t thr = ambientCentiC + (state.surfaceDeltaQ4 >> 4) + settings.bodyMarginCentiC;
+            if (thr < TEMP_MIN_BODY_CENTI) thr = TEMP_MIN_BODY_CENTI;
+            if (thr > TEMP_MAX_BODY_CENTI) thr = TEMP_MAX_BODY_CENTI;
+            tempThr = (centi_t)thr;
+        } else {
+            tempThr = (centi_t)settings.tempThresholdCentiC;
+        }
+
+        // Decisions with hysteresis: once detected, the reading must fall clearly below
+        int32_t fsrHyst = (state.fsrNoiseQ4 >> 4) * 2;
+        if (!calibrated || fsrHyst < FSR_HYSTERESIS_MIN) fsrHyst = FSR_HYSTERESIS_MIN;
+        weight = weight ? fsr > (int32_t)fsrThr - fsrHyst : fsr > fsrThr;
+        bodyTemp = bodyTemp ? objectCentiC > tempThr - TEMP_HYSTERESIS_CENTI : objectCentiC > tempThr;
+
+        // Learn only once the bed has been empty for a while: the mattress needs
+        // to recover after someone gets off, and the surface keeps body heat for minutes
+        if (!bedEmpty) {
+            emptyRun = 0;
+            return;
+        }
+        if (emptyRun < UINT16_MAX) emptyRun++;
+
+        bool loaded = calibrated && fsr > fsrThr;
+        bool warm = surfaceCalibrated && objectCentiC > tempThr;
+        if (emptyRun >= CAL_SETTLE_SAMPLES && fsrTrusted && !loaded) {
+            int32_t sampleQ4 = (int32_t)fsr << 4;
+            if (state.fsrSamples == 0) {
+                state.fsrBaselineQ4 = sampleQ4;
+                settledQ4 = sampleQ4;
+            } else if (state.fsrSamples >= CAL_EWMA_WINDOW) {
+                // Clip against the baseline settled at the start of the window,
+                // not the moving one, so something resting just under the
+                // threshold drags the baseline by one step per window at most
+                int32_t limit = CAL_OUTLIER_FACTOR * state.fsrNoiseQ4 + ((int32_t)settings.fsrMinMargin << 4);
+                if (sampleQ4 > settledQ4 + limit) sampleQ4 = settledQ4 + limit;
+                if (sampleQ4 < settledQ4 - limit) sampleQ4 = settledQ4 - limit;
+            }
+            ewma(state.fsrBaselineQ4, sampleQ4, state.fsrSamples);
+            int32_t deviation = sampleQ4 - state.fsrBaselineQ4;
+            if (deviation < 0) deviation = -deviation;
+            ewma(state.fsrNoiseQ4, deviation, state.fsrSamples);
+            state.fsrSamples++;
+            if (++windowSamples >= CAL_EWMA_WINDOW) {
+                windowSamples = 0;
+                settledQ4 = state.fsrBaselineQ4;
+            }
+            dirty = true;
+        }
+
+        if (emptyRun >= CAL_SURFACE_SETTLE_SAMPLES && ambientCentiC != AMBIENT_INVALID && !warm) {
+            int32_t deltaQ4 = ((int32_t)objectCentiC - ambientCentiC) << 4;
+            if (state.surfaceSamples == 0) {
+                state.surfaceDeltaQ4 = deltaQ4;
+            }
+            ewma(state.surfaceDeltaQ4, deltaQ4, state.surfaceSamples);
+            state.surfaceSamples++;
+        }
+    }
+
+    // The empty bed reads clearly below the learned baseline on a healthy FSR:
+    // the baseline was learned with something on the bed. Start it again from
+    // this reading; noise and confidence are kept.
+    void reseedFsr(int fsr) {
+        state.fsrBaselineQ4 = (int32_t)fsr << 4;
+        settledQ4 = state.fsrBaselineQ4;
+        windowSamples = 0;
+        dirty = true;
+    }
+
+    bool weightDetected() const { return weight; }
+    bool bodyTempDetected() const { return bodyTemp; }
+    uint16_t fsrThreshold() const { return fsrThr; }
+    centi_t tempThresholdCentiC() const { return tempThr; }
+    int fsrBaseline() const { return state.fsrBaselineQ4 >> 4; }
+    int fsrNoise() const { return state.fsrNoiseQ4 >> 4; }
+    int surfaceDeltaCentiC() const { return state.surfaceDeltaQ4 >> 4; }
+
+    // Percent of the empty-bed samples needed for a trustworthy baseline
+    uint8_t confidence() const {
+        if (state.fsrSamples >= CAL_FULL_SAMPLES) return 100;
+        return (uint8_t)(state.fsrSamples * 100 / CAL_FULL_SAMPLES);
+    }
+
+    // Save learned state at most every CAL_SAVE_INTERVAL_MS, and as soon as it
+    // first becomes usable, to keep flash wear low
+    void maybePersist(uint32_t nowMs) {
+        if (!dirty) return;
+        bool firstUsable = savedSamples < CAL_FULL_SAMPLES && state.fsrSamples >= CAL_FULL_SAMPLES;
+        if (!firstUsable && lastSaveMs != 0 && nowMs - lastSaveMs < CAL_SAVE_INTERVAL_MS) return;
+        if (!firstUsable && lastSaveMs == 0 && nowMs < CAL_SAVE_INTERVAL_MS) return;
+
+        state.magic = CAL_MAGIC;
+        state.crc = flashCrc32((const uint8_t*)&state, offsetof(CalibrationState, crc));
+        if (FlashRecord<FEATURE_PERSISTENCE>::save(path, CAL_TMP_FILE, &state, sizeof(state))) {
+            savedSamples = state.fsrSamples;
+            dirty = false;
+        }
+        lastSaveMs = nowMs == 0 ? 1 : nowMs;
+    }
+
+private:
+    // Running mean for the first samples, then an exponential average
+    static void ewma(int32_t& acc, int32_t sample, uint32_t count) {
+        int32_t window = count < CAL_EWMA_WINDOW ? (int32_t)count + 1 : CAL_EWMA_WINDOW;
+        acc += (sample - acc) / window;
+    }
+
+    CalibrationState state = {0, 0, 0, 0, 0, 0, 0};
+    char path[20] = CAL_FILE;
+    uint16_t fsrThr = 0;
+    centi_t tempThr = 0;
+    bool weight = false;
+    bool bodyTemp = false;
+    bool dirty = false;
+    uint16_t emptyRun = 0;
+    int32_t settledQ4 = 0;          // Baseline at the start of the learning window
+    uint8_t windowSamples = 0;
+    uint32_t savedSamples = 0;
+    uint32_t lastSaveMs = 0;
+};
+
+#endif
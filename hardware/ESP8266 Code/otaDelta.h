@@ -0,0 +1,439 @@
+#ifndef CURALINK_OTA_DELTA_H
+#define CURALINK_OTA_DELTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef ARDUINO
+#include <bearssl/bearssl_hash.h>
+#endif
+
+// Delta patches for firmware updates (otaUpdate.h; made by tools/ota_delta.cpp).
+// A patch rebuilds the new image from the one running, bsdiff style: most of
+// a rebuilt image is the old code, shifted, with addresses changed by a few
+// bytes. So the patch holds byte differences against the old image (mostly
+// zeros) and the bytes that are new, and LZSS compresses the lot. Applying it
+// takes the LZSS window and two small buffers whatever the image size, and
+// writes the new image straight to flash as it is decoded.
+//
+// Patch file:
+//   header, OTA_PATCH_HEADER_SIZE bytes, little endian:
+//     magic "CLDP", version, flags, 2 reserved,
+//     source size, source CRC-32, target size, target CRC-32
+//   then an LZSS stream: a flag byte per 8 items, LSB first; 1 = a literal
+//   byte, 0 = a match of 2 bytes, (length - 3) << 10 | (distance - 1).
+//   Decoded, the stream is a sequence of ops, counts in unsigned LEB128:
+//     OTA_OP_DIFF n     n bytes follow; target = source + byte, source advances
+//     OTA_OP_INSERT n   n bytes follow, copied into the target
+//     OTA_OP_SEEK d     the source position moves by d (zig-zag encoded)
+// A patch with a source size of 0 carries the whole image and applies to
+// any running image.
+
+#define OTA_PATCH_MAGIC         0x50444C43UL    // "CLDP"
+#define OTA_PATCH_VERSION       1
+#define OTA_PATCH_HEADER_SIZE   24
+#define OTA_WINDOW_BITS         10
+#define OTA_WINDOW              (1 << OTA_WINDOW_BITS)
+#define OTA_MIN_MATCH           3
+#define OTA_MAX_MATCH           (OTA_MIN_MATCH + 63)
+#define OTA_SECTOR_SIZE         4096
+#define OTA_PAGE_BYTES          256     // Target bytes buffered per flash write
+#define OTA_SOURCE_CACHE        64      // Source bytes read from flash at a time
+
+enum OtaOp : uint8_t {
+    OTA_OP_DIFF = 0,
+    OTA_OP_INSERT = 1,
+    OTA_OP_SEEK = 2
+};
+
+//  ID                          Reason
+#define OTA_ERRORS(X) \
+    X(OTA_OK,                   "ok") \
+    X(OTA_BAD_HEADER,           "not a patch") \
+    X(OTA_WRONG_SOURCE,         "patch is for another image") \
+    X(OTA_NO_SPACE,             "image does not fit") \
+    X(OTA_CORRUPT,              "corrupt patch") \
+    X(OTA_FLASH_FAILED,         "flash write failed") \
+    X(OTA_BAD_IMAGE,            "image check failed") \
+    X(OTA_DOWNLOAD_FAILED,      "download failed") \
+    X(OTA_HTTP_STATUS,          "HTTP") \
+    X(OTA_BACKUP_FAILED,        "no valid backup") \
+    X(OTA_BAD_DIGEST,           "image SHA-256 mismatch")
+
+#define OTA_ERROR_ID(id, reason) id,
+enum OtaError : uint8_t { OTA_ERRORS(OTA_ERROR_ID) OTA_ERROR_COUNT };
+#undef OTA_ERROR_ID
+
+// CRC-32 (same polynomial as flashCrc32), continued across calls:
+// crc = otaCrc32(crc, part, n) starting from 0
+inline uint32_t otaCrc32(uint32_t crc, const uint8_t* data, size_t len) {
+    static const uint32_t NIBBLE[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    while (len--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ NIBBLE[crc & 15];
+        crc = (crc >> 4) ^ NIBBLE[crc & 15];
+    }
+    return ~crc;
+}
+
+// SHA-256 of the new image, checked against /ota: a CRC only catches flash
+// errors, anyone serving patches can make an image with a given CRC. The
+// device uses BearSSL from the core; the host tools get the same calls here.
+#define OTA_DIGEST_BYTES        32
+
+#ifndef ARDUINO
+struct br_sha256_context {
+    uint32_t val[8];
+    uint8_t buf[64];
+    uint64_t count;
+};
+
+inline void otaSha256Block(uint32_t (&val)[8], const uint8_t* block) {
+    static const uint32_t K[64] = {
+        0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+        0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+        0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+        0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+        0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+        0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+        0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+        0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+    };
+    auto ror = [](uint32_t x, int n) { return (x >> n) | (x << (32 - n)); };
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+               (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t v[8];
+    memcpy(v, val, sizeof(v));
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = v[7] + (ror(v[4], 6) ^ ror(v[4], 11) ^ ror(v[4], 25)) + ((v[4] & v[5]) ^ (~v[4] & v[6])) +
+                      K[i] + w[i];
+        uint32_t t2 = (ror(v[0], 2) ^ ror(v[0], 13) ^ ror(v[0], 22)) + ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+        memmove(v + 1, v, 7 * sizeof(uint32_t));
+        v[4] += t1;
+        v[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; i++) {
+        val[i] += v[i];
+    }
+}
+
+inline void br_sha256_init(br_sha256_context* ctx) {
+    static const uint32_t IV[8] = {
+        0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+    };
+    memcpy(ctx->val, IV, sizeof(IV));
+    ctx->count = 0;
+}
+
+inline void br_sha256_update(br_sha256_context* ctx, const void* data, size_t len) {
+    const uint8_t* p = (const uint8_t*)data;
+    while (len > 0) {
+        size_t used = ctx->count & 63;
+        size_t n = 64 - used < len ? 64 - used : len;
+        memcpy(ctx->buf + used, p, n);
+        ctx->count += n;
+        p += n;
+        len -= n;
+        if (used + n == 64) {
+            otaSha256Block(ctx->val, ctx->buf);
+        }
+    }
+}
+
+// Like BearSSL, the context is left as it was
+inline void br_sha256_out(const br_sha256_context* ctx, void* out) {
+    br_sha256_context last = *ctx;
+    uint64_t bits = ctx->count << 3;
+    uint8_t pad[72] = {0x80};
+    size_t n = ((55 - (ctx->count & 63)) & 63) + 1;
+    for (int i = 0; i < 8; i++) {
+        pad[n + i] = (uint8_t)(bits >> (56 - 8 * i));
+    }
+    br_sha256_update(&last, pad, n + 8);
+    for (int i = 0; i < 8; i++) {
+        for (int b = 0; b < 4; b++) {
+            ((uint8_t*)out)[4 * i + b] = (uint8_t)(last.val[i] >> (24 - 8 * b));
+        }
+    }
+}
+#endif
+
+// 64 hex digits (as published in /ota) into a digest; false if malformed
+inline bool otaParseDigest(const char* hex, uint8_t (&digest)[OTA_DIGEST_BYTES]) {
+    for (size_t i = 0; i < 2 * OTA_DIGEST_BYTES; i++) {
+        char c = hex[i];
+        int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10
+              : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+        if (v < 0) {
+            return false;
+        }
+        digest[i / 2] = (uint8_t)(i % 2 ? digest[i / 2] | v : v << 4);
+    }
+    return hex[2 * OTA_DIGEST_BYTES] == '\0';
+}
+
+struct OtaPatchHeader {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t sourceSize;        // 0: the patch carries the whole image
+    uint32_t sourceCrc;
+    uint32_t targetSize;
+    uint32_t targetCrc;
+};
+
+// Applies a patch fed in pieces of any size. Flash is a policy with static
+// read/erase/write on 4-byte aligned words (see OtaFlash in otaUpdate.h);
+// the source is the image at address 0, the target goes to targetAddress,
+// which must start a sector.
+template<typename Flash>
+class OtaPatch {
+public:
+    void begin(uint32_t runningSize, uint32_t runningCrc, uint32_t targetAddress, uint32_t targetLimit) {
+        sourceLimit = runningSize;
+        sourceCrc = runningCrc;
+        base = targetAddress;
+        limit = targetLimit;
+        headerBytes = 0;
+        error = OTA_OK;
+        complete = false;
+        flagBits = 0;
+        matchState = LZ_FLAGS;
+        windowPos = 0;
+        opState = OP_CODE;
+        sourcePos = 0;
+        cached = false;
+        produced = 0;
+        pageFill = 0;
+        targetCrc = 0;
+        memset(window, 0, sizeof(window));
+    }
+
+    // OTA_OK while the patch is good so far; the first error sticks
+    OtaError feed(const uint8_t* data, size_t length) {
+        for (size_t i = 0; i < length && error == OTA_OK; i++) {
+            if (headerBytes < OTA_PATCH_HEADER_SIZE) {
+                headerRaw[headerBytes++] = data[i];
+                if (headerBytes == OTA_PATCH_HEADER_SIZE) {
+                    error = checkHeader();
+                }
+            } else if (complete) {
+                error = OTA_CORRUPT;    // Bytes after the end of the image
+            } else {
+                decode(data[i]);
+            }
+        }
+        return error;
+    }
+
+    // The whole image is in flash and its CRC matched
+    bool done() const { return complete && error == OTA_OK; }
+    OtaError result() const { return error; }
+    const OtaPatchHeader& header() const { return info; }
+    uint32_t written() const { return produced; }
+
+private:
+    enum LzState : uint8_t { LZ_FLAGS, LZ_ITEM, LZ_MATCH_HIGH };
+    enum OpState : uint8_t { OP_CODE, OP_COUNT, OP_DIFF_DATA, OP_INSERT_DATA };
+
+    static uint32_t le32(const uint8_t* p) {
+        return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+    }
+
+    OtaError checkHeader() {
+        info.magic = le32(headerRaw);
+        info.version = headerRaw[4];
+        info.flags = headerRaw[5];
+        info.reserved = (uint16_t)(headerRaw[6] | headerRaw[7] << 8);
+        info.sourceSize = le32(headerRaw + 8);
+        info.sourceCrc = le32(headerRaw + 12);
+        info.targetSize = le32(headerRaw + 16);
+        info.targetCrc = le32(headerRaw + 20);
+        if (info.magic != OTA_PATCH_MAGIC || info.version != OTA_PATCH_VERSION || info.targetSize == 0) {
+            return OTA_BAD_HEADER;
+        }
+        if (info.sourceSize != 0 && (info.sourceSize != sourceLimit || info.sourceCrc != sourceCrc)) {
+            return OTA_WRONG_SOURCE;
+        }
+        if (info.targetSize > limit) {
+            return OTA_NO_SPACE;
+        }
+        sourceLimit = info.sourceSize;
+        return OTA_OK;
+    }
+
+    // LZSS: each decoded byte goes into the window and on to the ops
+    void decode(uint8_t b) {
+        switch (matchState) {
+        case LZ_FLAGS:
+            flags = b;
+            flagBits = 8;
+            matchState = LZ_ITEM;
+            break;
+        case LZ_ITEM:
+            if (flags & 1) {
+                emit(b);
+                nextItem();
+            } else {
+                matchLow = b;
+                matchState = LZ_MATCH_HIGH;
+            }
+            break;
+        case LZ_MATCH_HIGH: {
+            uint16_t token = (uint16_t)(matchLow | b << 8);
+            uint16_t distance = (token & (OTA_WINDOW - 1)) + 1;
+            uint8_t length = (uint8_t)((token >> OTA_WINDOW_BITS) + OTA_MIN_MATCH);
+            for (uint8_t n = 0; n < length && error == OTA_OK; n++) {
+                emit(window[(windowPos - distance) & (OTA_WINDOW - 1)]);
+            }
+            nextItem();
+            break;
+        }
+        }
+    }
+
+    void nextItem() {
+        flags >>= 1;
+        matchState = --flagBits == 0 ? LZ_FLAGS : LZ_ITEM;
+    }
+
+    void emit(uint8_t b) {
+        window[windowPos++ & (OTA_WINDOW - 1)] = b;
+        switch (opState) {
+        case OP_CODE:
+            if (b > OTA_OP_SEEK) {
+                error = OTA_CORRUPT;
+                return;
+            }
+            op = (OtaOp)b;
+            count = 0;
+            countShift = 0;
+            opState = OP_COUNT;
+            break;
+        case OP_COUNT:
+            if (countShift > 28) {
+                error = OTA_CORRUPT;
+                return;
+            }
+            count |= (uint32_t)(b & 0x7F) << countShift;
+            countShift += 7;
+            if (b & 0x80) {
+                break;
+            }
+            startOp();
+            break;
+        case OP_DIFF_DATA:
+            if (sourcePos >= sourceLimit) {
+                error = OTA_CORRUPT;
+                return;
+            }
+            output((uint8_t)(sourceByte(sourcePos++) + b));
+            if (--count == 0) opState = OP_CODE;
+            break;
+        case OP_INSERT_DATA:
+            output(b);
+            if (--count == 0) opState = OP_CODE;
+            break;
+        }
+    }
+
+    void startOp() {
+        if (op == OTA_OP_SEEK) {
+            int32_t delta = (int32_t)(count >> 1) ^ -(int32_t)(count & 1);
+            int64_t next = (int64_t)sourcePos + delta;
+            if (next < 0 || next > (int64_t)sourceLimit) {
+                error = OTA_CORRUPT;
+                return;
+            }
+            sourcePos = (uint32_t)next;
+            opState = OP_CODE;
+        } else if (count > info.targetSize - produced) {
+            error = OTA_CORRUPT;
+        } else {
+            opState = count == 0 ? OP_CODE : (op == OTA_OP_DIFF ? OP_DIFF_DATA : OP_INSERT_DATA);
+        }
+    }
+
+    uint8_t sourceByte(uint32_t pos) {
+        if (!cached || pos - cacheStart >= OTA_SOURCE_CACHE) {
+            cacheStart = pos & ~(uint32_t)(OTA_SOURCE_CACHE - 1);
+            cached = Flash::read(cacheStart, sourceCache, OTA_SOURCE_CACHE);
+            if (!cached) {
+                error = OTA_FLASH_FAILED;
+                return 0;
+            }
+        }
+        return ((const uint8_t*)sourceCache)[pos - cacheStart];
+    }
+
+    void output(uint8_t b) {
+        ((uint8_t*)page)[pageFill++] = b;
+        produced++;
+        if (pageFill == OTA_PAGE_BYTES || produced == info.targetSize) {
+            flushPage();
+        }
+        if (produced == info.targetSize && error == OTA_OK) {
+            complete = true;
+            if (targetCrc != info.targetCrc) {
+                error = OTA_BAD_IMAGE;
+            }
+        }
+    }
+
+    // Whole words only: the last page is padded with erased bytes
+    void flushPage() {
+        targetCrc = otaCrc32(targetCrc, (const uint8_t*)page, pageFill);
+        uint32_t address = base + produced - pageFill;
+        size_t bytes = (pageFill + 3) & ~(size_t)3;
+        memset((uint8_t*)page + pageFill, 0xFF, bytes - pageFill);
+        if (address % OTA_SECTOR_SIZE == 0 && !Flash::erase(address / OTA_SECTOR_SIZE)) {
+            error = OTA_FLASH_FAILED;
+        } else if (!Flash::write(address, page, bytes)) {
+            error = OTA_FLASH_FAILED;
+        }
+        pageFill = 0;
+    }
+
+    uint8_t window[OTA_WINDOW];
+    uint32_t page[OTA_PAGE_BYTES / 4];
+    uint32_t sourceCache[OTA_SOURCE_CACHE / 4];
+    uint8_t headerRaw[OTA_PATCH_HEADER_SIZE];
+    OtaPatchHeader info = {};
+    uint32_t sourceLimit = 0;
+    uint32_t sourceCrc = 0;
+    uint32_t base = 0;
+    uint32_t limit = 0;
+    uint32_t cacheStart = 0;
+    uint32_t sourcePos = 0;
+    uint32_t produced = 0;
+    uint32_t targetCrc = 0;
+    uint32_t count = 0;
+    uint16_t windowPos = 0;
+    uint16_t pageFill = 0;
+    uint8_t headerBytes = 0;
+    uint8_t flags = 0;
+    uint8_t flagBits = 0;
+    uint8_t matchLow = 0;
+    uint8_t countShift = 0;
+    LzState matchState = LZ_FLAGS;
+    OpState opState = OP_CODE;
+    OtaOp op = OTA_OP_DIFF;
+    OtaError error = OTA_OK;
+    bool cached = false;
+    bool complete = false;
+};
+
+#endif
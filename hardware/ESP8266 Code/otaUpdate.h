@@ -0,0 +1,896 @@
+#ifndef CURALINK_OTA_UPDATE_H
+#define CURALINK_OTA_UPDATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "firmwareProfile.h"
+#include "flashText.h"
+#include "flashRecord.h"
+#include "otaDelta.h"
+#include "rtdbClient.h"
+
+#if FEATURE_OTA
+#include <ESP8266WiFi.h>
+#include <flash_hal.h>
+#include <eboot_command.h>
+#include "bedUplink.h"
+#include "timeSync.h"
+#include "eventLog.h"
+#endif
+
+// Fleet firmware updates (FEATURE_OTA).
+// /ota in the RTDB names the image every bed should run. A bed fetches a delta
+// patch from its running image to that one (otaDelta.h) from a plain HTTP file
+// server on the LAN and applies it into free flash as it arrives, a socket
+// read per loop pass, so it keeps sampling and reporting while it downloads.
+// The sketch area is used as
+//   0: running image | free | backup of the running image | new image | file system
+// Once the new image reads back with the CRC and SHA-256 from /ota and the
+// running one is backed up, the unit restarts at a moment when no bed is in a workflow and
+// the boot loader (eboot) copies the new image over the old one.
+// The new image is on trial: it must hold a cloud session of its own for
+// OTA_HEALTH_MS, within OTA_TRIAL_TIMEOUT_MS of booting and within
+// OTA_TRIAL_BOOTS boots. A gateway that cannot connect resigns and relays
+// through another bed, which does not count: that is how a broken WiFi build
+// would look. Otherwise the backup is copied back the same
+// way and that image is never installed again on this unit.
+// Beds start at staggered times (otaRolloutDelayS) so the ward WiFi never
+// carries every download at once. Mesh followers have no cloud session and
+// are updated over USB.
+//
+// /ota: { "version": "1.4.0", "targetCrc": "9a1b2c3d", "targetSize": 301234,
+//         "targetSha256": "<64 hex digits>",
+//         "patchBase": "http://10.0.0.5:8000/ota", "rolloutStart": <epoch s>,
+//         "waves": 4, "waveMinutes": 30, "paused": false }
+// Patches are <patchBase>/<running CRC>-<target CRC>.cldp, CRCs in 8 lower-case
+// hex digits (tools/ota_delta.cpp names them); a bed whose image has no patch
+// fetches <patchBase>/full-<target CRC>.cldp. Each bed reports to /ota/status/bed<N>.
+
+#define OTA_STATE_FILE          "/ota.bin"
+#define OTA_STATE_TMP_FILE      "/ota.tmp"
+#define OTA_STATE_MAGIC         0x41544F43UL    // "COTA"
+#define OTA_VERSION_BYTES       16
+#define OTA_BASE_BYTES          80      // patchBase
+#define OTA_URL_BYTES           112     // patchBase plus the file name (stack)
+#define OTA_HOST_BYTES          64
+#define OTA_COPY_BYTES          256     // Flash read or copied at a time when hashing or backing up
+#define OTA_STEP_BYTES          OTA_SECTOR_SIZE     // Flash hashed or copied per loop pass
+#define OTA_READ_BYTES          256     // Patch bytes taken from the socket per loop pass (stack)
+#define OTA_IMAGE_MAGIC         0xE9    // First byte of an ESP8266 image
+#define OTA_TRIAL_BOOTS         3
+#define OTA_HEALTH_MS           300000UL    // A new image keeps a cloud session this long...
+#define OTA_TRIAL_TIMEOUT_MS    900000UL    // ...within this long of booting
+#define OTA_CHECK_INTERVAL_MS   600000UL    // /ota poll
+#define OTA_RETRY_MS            1800000UL   // After a failed download or a bad image
+#define OTA_FETCH_TIMEOUT_MS    15000       // No bytes from the file server for this long
+
+//  ID                          Name
+#define OTA_PHASES(X) \
+    X(OTA_IDLE,                 "idle") \
+    X(OTA_HASHING,              "hashing") \
+    X(OTA_WAITING,              "waiting") \
+    X(OTA_DOWNLOADING,          "downloading") \
+    X(OTA_VERIFYING,            "verifying") \
+    X(OTA_BACKING_UP,           "backing_up") \
+    X(OTA_READY,                "ready") \
+    X(OTA_FAILED,               "failed")
+
+//  ID                          Name
+#define OTA_SLOTS(X) \
+    X(OTA_SLOT_CONFIRMED,       "confirmed")    /* Passed its trial, or never updated */ \
+    X(OTA_SLOT_TRIAL,           "trial")        /* A new image that has not passed yet */ \
+    X(OTA_SLOT_ROLLED_BACK,     "rolled_back")  /* Back on the backup after a failed trial */
+
+#define OTA_ENUM_ENTRY(id, name) id,
+enum OtaPhase : uint8_t { OTA_PHASES(OTA_ENUM_ENTRY) OTA_PHASE_COUNT };
+enum OtaSlotState : uint8_t { OTA_SLOTS(OTA_ENUM_ENTRY) OTA_SLOT_COUNT };
+#undef OTA_ENUM_ENTRY
+
+#define OTA_NAME_STRING(id, name) static const char id##_NAME[] PROGMEM = name;
+OTA_PHASES(OTA_NAME_STRING)
+OTA_SLOTS(OTA_NAME_STRING)
+OTA_ERRORS(OTA_NAME_STRING)
+#undef OTA_NAME_STRING
+#define OTA_NAME_ENTRY(id, name) id##_NAME,
+static const char* const OTA_PHASE_NAMES[] PROGMEM = { OTA_PHASES(OTA_NAME_ENTRY) };
+static const char* const OTA_SLOT_NAMES[] PROGMEM = { OTA_SLOTS(OTA_NAME_ENTRY) };
+static const char* const OTA_ERROR_NAMES[] PROGMEM = { OTA_ERRORS(OTA_NAME_ENTRY) };
+#undef OTA_NAME_ENTRY
+
+#define OTA_NAME_SIZE           32
+
+// Copy a name out of flash; return out
+inline const char* otaPhaseName(OtaPhase phase, char (&out)[OTA_NAME_SIZE]) {
+    copyFlashText(out, sizeof(out), (const char*)pgm_read_ptr(&OTA_PHASE_NAMES[phase]));
+    return out;
+}
+
+inline const char* otaSlotName(uint8_t slot, char (&out)[OTA_NAME_SIZE]) {
+    copyFlashText(out, sizeof(out), (const char*)pgm_read_ptr(&OTA_SLOT_NAMES[slot < OTA_SLOT_COUNT ? slot : 0]));
+    return out;
+}
+
+inline const char* otaErrorName(OtaError error, char (&out)[OTA_NAME_SIZE]) {
+    copyFlashText(out, sizeof(out), (const char*)pgm_read_ptr(&OTA_ERROR_NAMES[error]));
+    return out;
+}
+
+// Seconds after rolloutStart at which a unit may start: its wave (from a hash
+// of unitKey, the chip ID on the device) times waveMinutes, plus a spread
+// inside the wave so a wave does not start on the same second
+inline uint32_t otaRolloutDelayS(uint32_t unitKey, uint16_t waves, uint16_t waveMinutes) {
+    if (waves == 0 || waveMinutes == 0) {
+        return 0;
+    }
+    uint32_t h = unitKey;   // murmur3 finalizer: chip IDs are close together
+    h ^= h >> 16;
+    h *= 0x85EBCA6BUL;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35UL;
+    h ^= h >> 16;
+    uint32_t waveSeconds = (uint32_t)waveMinutes * 60;
+    return (h % waves) * waveSeconds + (h / waves) % waveSeconds;
+}
+
+// What is installed where; kept in flash (Store) across the switch
+struct OtaRecord {
+    uint32_t magic;
+    uint8_t state;              // OtaSlotState
+    uint8_t trialBoots;
+    uint16_t reserved;
+    uint32_t imageCrc;          // Image the record expects to be running
+    uint32_t imageSize;
+    uint32_t backupAddress;     // The image before it, for rollback; size 0 if none
+    uint32_t backupSize;
+    uint32_t backupCrc;
+    uint32_t rejectedCrc;       // Rolled back from here: not installed again
+    char version[OTA_VERSION_BYTES];
+    char backupVersion[OTA_VERSION_BYTES];
+    uint32_t crc;
+};
+
+// The flash side of an update: hashing the running image, applying a patch
+// into free space, checking and backing up, switching and rolling back.
+// Policies with static functions, so the host tools run it on a file:
+//   Flash: read/erase/write as in otaDelta.h, imageSize() of the running
+//          image and spaceEnd(), where the sketch area ends
+//   Store: load/save of the OtaRecord
+//   Boot:  install(address, size) has the boot loader copy that image to 0
+//          on the next start; restart()
+template<typename Flash, typename Store, typename Boot>
+class OtaInstaller {
+public:
+    // At boot, before anything that could hang: counts trial boots and rolls
+    // back a new image that keeps restarting
+    void begin(uint32_t nowMs) {
+        bootMs = nowMs;
+        if (!Store::load(&record, sizeof(record)) || record.magic != OTA_STATE_MAGIC ||
+            record.crc != flashCrc32((const uint8_t*)&record, offsetof(OtaRecord, crc))) {
+            memset(&record, 0, sizeof(record));
+            record.magic = OTA_STATE_MAGIC;
+        }
+        if (record.state == OTA_SLOT_TRIAL) {
+            record.trialBoots++;
+            save();
+            if (record.trialBoots > OTA_TRIAL_BOOTS) {
+                failTrial();
+            }
+        }
+        runningSize = Flash::imageSize();
+        position = 0;
+        imageCrc = 0;
+        phase = OTA_HASHING;
+    }
+
+    // Background work, at most OTA_STEP_BYTES of flash per call
+    void step() {
+        switch (phase) {
+        case OTA_HASHING:
+            if (!hashStep(0, runningSize)) {
+                return;
+            }
+            runningCrc = imageCrc;
+            hashed = true;
+            phase = OTA_IDLE;
+            // A switch that did not happen, or an image loaded over USB
+            if (record.imageCrc != runningCrc) {
+                record.state = OTA_SLOT_CONFIRMED;
+                record.trialBoots = 0;
+                record.imageCrc = runningCrc;
+                record.imageSize = runningSize;
+                record.version[0] = '\0';
+                save();
+            }
+            break;
+        case OTA_VERIFYING:
+            if (!hashStep(stagingAddress, targetSize, &imageDigest)) {
+                return;
+            }
+            // The CRC catches a bad flash write; only the SHA-256 says it is the published image
+            if (imageCrc != targetCrc || !imageMagic(stagingAddress)) {
+                fail(OTA_BAD_IMAGE);
+                return;
+            }
+            if (!digestMatches()) {
+                fail(OTA_BAD_DIGEST);
+                return;
+            }
+            position = 0;
+            phase = OTA_BACKING_UP;
+            break;
+        case OTA_BACKING_UP:
+            copyStep();
+            break;
+        default:
+            break;
+        }
+    }
+
+    // Whether an image is worth fetching: not running, not rolled back from,
+    // no download under way, and the running image past its trial
+    bool wants(uint32_t crc) const {
+        return hashed && crc != runningCrc && crc != record.rejectedCrc && record.state != OTA_SLOT_TRIAL &&
+               (phase == OTA_IDLE || phase == OTA_WAITING || phase == OTA_FAILED);
+    }
+
+    void schedule() { phase = OTA_WAITING; }
+    void cancel() { phase = OTA_IDLE; }
+
+    // Lays out flash for an image of size bytes and starts the patch
+    OtaError beginPatch(uint32_t size, uint32_t crc, const uint8_t (&digest)[OTA_DIGEST_BYTES], const char* version) {
+        uint32_t end = Flash::spaceEnd() & ~(uint32_t)(OTA_SECTOR_SIZE - 1);
+        uint32_t running = sectors(runningSize);
+        uint32_t staged = sectors(size);
+        if (size == 0 || staged > end || end - staged < running) {
+            return fail(OTA_NO_SPACE);
+        }
+        stagingAddress = end - staged;
+        backupAddress = stagingAddress - running;
+        // The backup must clear the running image now and the new one after the switch
+        if (backupAddress < running || backupAddress < staged) {
+            return fail(OTA_NO_SPACE);
+        }
+        targetSize = size;
+        targetCrc = crc;
+        memcpy(targetDigest, digest, sizeof(targetDigest));
+        strncpy(targetVersion, version, sizeof(targetVersion) - 1);
+        targetVersion[sizeof(targetVersion) - 1] = '\0';
+        patch.begin(runningSize, runningCrc, stagingAddress, size);
+        error = OTA_OK;
+        phase = OTA_DOWNLOADING;
+        return OTA_OK;
+    }
+
+    OtaError feed(const uint8_t* data, size_t length) {
+        if (phase != OTA_DOWNLOADING) {
+            return error;
+        }
+        OtaError result = patch.feed(data, length);
+        return result == OTA_OK ? OTA_OK : fail(result);
+    }
+
+    // The download ended; the image is read back before anything else
+    OtaError endPatch() {
+        if (phase != OTA_DOWNLOADING) {
+            return error;
+        }
+        if (patch.result() != OTA_OK) {
+            return fail(patch.result());
+        }
+        if (!patch.done()) {
+            return fail(OTA_CORRUPT);
+        }
+        if (patch.header().targetSize != targetSize || patch.header().targetCrc != targetCrc) {
+            return fail(OTA_BAD_IMAGE);
+        }
+        position = 0;
+        imageCrc = 0;
+        br_sha256_init(&imageDigest);
+        phase = OTA_VERIFYING;
+        return OTA_OK;
+    }
+
+    OtaError fail(OtaError reason) {
+        error = reason;
+        phase = OTA_FAILED;
+        return reason;
+    }
+
+    // OTA_READY: record the trial and restart into the new image
+    bool install() {
+        if (phase != OTA_READY) {
+            return false;
+        }
+        memcpy(record.backupVersion, record.version, sizeof(record.backupVersion));
+        memcpy(record.version, targetVersion, sizeof(record.version));
+        record.state = OTA_SLOT_TRIAL;
+        record.trialBoots = 0;
+        record.backupAddress = backupAddress;
+        record.backupSize = runningSize;
+        record.backupCrc = runningCrc;
+        record.imageCrc = targetCrc;
+        record.imageSize = targetSize;
+        if (!save()) {
+            fail(OTA_FLASH_FAILED);
+            return false;
+        }
+        Boot::install(stagingAddress, targetSize);
+        Boot::restart();
+        return true;
+    }
+
+    // Every loop pass: a trial image that holds a cloud session for
+    // OTA_HEALTH_MS is kept, one that does not in time is rolled back.
+    // True on the pass the running image is confirmed.
+    bool health(bool healthy, uint32_t nowMs) {
+        if (record.state != OTA_SLOT_TRIAL || !hashed) {
+            return false;
+        }
+        if (!healthy) {
+            healthySince = 0;
+        } else if (healthySince == 0) {
+            healthySince = nowMs | 1;
+        } else if (nowMs - healthySince >= OTA_HEALTH_MS) {
+            record.state = OTA_SLOT_CONFIRMED;
+            record.trialBoots = 0;
+            save();
+            return true;
+        }
+        if (nowMs - bootMs >= OTA_TRIAL_TIMEOUT_MS) {
+            failTrial();
+        }
+        return false;
+    }
+
+    // Copy the backup back and restart; also the `ota rollback` command.
+    // Returns only if there is no backup that reads back intact.
+    OtaError rollback() {
+        uint32_t address = record.backupAddress;
+        uint32_t size = record.backupSize;
+        uint32_t crc = 0;
+        uint32_t offset = 0;
+        if (size == 0 || record.backupCrc == record.imageCrc ||
+            !hashBytes(address, size, offset, crc, size) || crc != record.backupCrc || !imageMagic(address)) {
+            return error = OTA_BACKUP_FAILED;
+        }
+        record.rejectedCrc = record.imageCrc;
+        record.state = OTA_SLOT_ROLLED_BACK;
+        record.trialBoots = 0;
+        record.imageCrc = record.backupCrc;
+        record.imageSize = size;
+        memcpy(record.version, record.backupVersion, sizeof(record.version));
+        record.backupVersion[0] = '\0';
+        record.backupSize = 0;      // The next download lays out flash again
+        record.backupCrc = 0;
+        save();
+        Boot::install(address, size);
+        Boot::restart();
+        return OTA_OK;
+    }
+
+    OtaPhase currentPhase() const { return phase; }
+    OtaError lastError() const { return error; }
+    bool imageKnown() const { return hashed; }
+    uint32_t crc() const { return runningCrc; }
+    uint32_t size() const { return runningSize; }
+    uint32_t target() const { return targetCrc; }
+    uint32_t written() const { return patch.written(); }
+    const OtaRecord& state() const { return record; }
+
+private:
+    static uint32_t sectors(uint32_t bytes) {
+        return (bytes + OTA_SECTOR_SIZE - 1) & ~(uint32_t)(OTA_SECTOR_SIZE - 1);
+    }
+
+    static bool imageMagic(uint32_t address) {
+        uint32_t word;
+        return Flash::read(address, &word, sizeof(word)) && (word & 0xFF) == OTA_IMAGE_MAGIC;
+    }
+
+    bool save() {
+        record.crc = flashCrc32((const uint8_t*)&record, offsetof(OtaRecord, crc));
+        return Store::save(&record, sizeof(record));
+    }
+
+    // A trial image with no intact backup to go back to is kept
+    void failTrial() {
+        if (rollback() != OTA_OK) {
+            record.state = OTA_SLOT_CONFIRMED;
+            record.trialBoots = 0;
+            save();
+        }
+    }
+
+    // Continues the CRC of [address, address + size) in imageCrc, and the
+    // SHA-256 in digest if given; true when done
+    bool hashStep(uint32_t address, uint32_t size, br_sha256_context* digest = nullptr) {
+        if (!hashBytes(address, size, position, imageCrc, OTA_STEP_BYTES, digest)) {
+            fail(OTA_FLASH_FAILED);
+            return false;
+        }
+        return position >= size;
+    }
+
+    // Up to budget more bytes of [address, address + size) into crc; false on a read error
+    bool hashBytes(uint32_t address, uint32_t size, uint32_t& offset, uint32_t& crc, uint32_t budget,
+                   br_sha256_context* digest = nullptr) {
+        while (offset < size && budget > 0) {
+            uint32_t n = size - offset < OTA_COPY_BYTES ? size - offset : OTA_COPY_BYTES;
+            if (!Flash::read(address + offset, buffer, (n + 3) & ~(uint32_t)3)) {
+                return false;
+            }
+            crc = otaCrc32(crc, (const uint8_t*)buffer, n);
+            if (digest != nullptr) {
+                br_sha256_update(digest, buffer, n);
+            }
+            offset += n;
+            budget = budget > n ? budget - n : 0;
+        }
+        return true;
+    }
+
+    bool digestMatches() const {
+        uint8_t digest[OTA_DIGEST_BYTES];
+        br_sha256_out(&imageDigest, digest);
+        return memcmp(digest, targetDigest, sizeof(digest)) == 0;
+    }
+
+    // One sector of the running image into the backup, each piece read back
+    void copyStep() {
+        if (!Flash::erase((backupAddress + position) / OTA_SECTOR_SIZE)) {
+            fail(OTA_FLASH_FAILED);
+            return;
+        }
+        for (uint32_t n = 0; n < OTA_SECTOR_SIZE; n += OTA_COPY_BYTES, position += OTA_COPY_BYTES) {
+            uint32_t check[OTA_COPY_BYTES / 4];
+            if (!Flash::read(position, buffer, OTA_COPY_BYTES) ||
+                !Flash::write(backupAddress + position, buffer, OTA_COPY_BYTES) ||
+                !Flash::read(backupAddress + position, check, OTA_COPY_BYTES) ||
+                memcmp(buffer, check, OTA_COPY_BYTES) != 0) {
+                fail(OTA_FLASH_FAILED);
+                return;
+            }
+        }
+        if (position >= sectors(runningSize)) {
+            phase = OTA_READY;
+        }
+    }
+
+    OtaPatch<Flash> patch;
+    OtaRecord record = {};
+    uint32_t buffer[OTA_COPY_BYTES / 4];
+    char targetVersion[OTA_VERSION_BYTES] = {};
+    uint32_t runningSize = 0;
+    uint32_t runningCrc = 0;
+    uint32_t imageCrc = 0;          // CRC so far of whatever is being hashed
+    br_sha256_context imageDigest = {};     // SHA-256 so far of the new image (verifying)
+    uint8_t targetDigest[OTA_DIGEST_BYTES] = {};
+    uint32_t position = 0;
+    uint32_t stagingAddress = 0;
+    uint32_t backupAddress = 0;
+    uint32_t targetSize = 0;
+    uint32_t targetCrc = 0;
+    uint32_t bootMs = 0;
+    uint32_t healthySince = 0;
+    OtaPhase phase = OTA_IDLE;
+    OtaError error = OTA_OK;
+    bool hashed = false;
+};
+
+enum OtaFetchState : uint8_t {
+    OTA_FETCH_IDLE,
+    OTA_FETCH_BUSY,
+    OTA_FETCH_DONE,             // Response complete: check status()
+    OTA_FETCH_FAILED            // No connection, dropped or timed out
+};
+
+// GET of one file over plain HTTP, body bytes to a sink as they arrive.
+// Client is WiFiClient on the device; tools/ota_delta.cpp uses POSIX sockets.
+// It needs the calls listed in rtdbClient.h.
+template<typename Client>
+class OtaFetch {
+public:
+    typedef void (*SinkFn)(void* context, const uint8_t* data, size_t length);
+
+    explicit OtaFetch(Client& transport) : client(transport) {}
+
+    // url: http://host[:port]/path
+    bool begin(const char* url, SinkFn sink, void* context, uint32_t nowMs) {
+        end();
+        bodySink = sink;
+        sinkContext = context;
+        received = 0;
+        state = OTA_FETCH_FAILED;
+        if (strncmp(url, "http://", 7) != 0) {
+            return false;
+        }
+        const char* host = url + 7;
+        size_t hostLength = strcspn(host, ":/");
+        const char* path = host + hostLength;
+        uint16_t port = 80;
+        if (*path == ':') {
+            char* end;
+            port = (uint16_t)strtoul(path + 1, &end, 10);
+            path = end;
+        }
+        if (hostLength == 0 || hostLength >= sizeof(hostName) || *path != '/' || port == 0) {
+            return false;
+        }
+        memcpy(hostName, host, hostLength);
+        hostName[hostLength] = '\0';
+        if (!client.connect(hostName, port)) {
+            return false;
+        }
+        const char* parts[] = {"GET ", path, " HTTP/1.1\r\nHost: ", hostName, "\r\nConnection: close\r\n\r\n"};
+        for (const char* part : parts) {
+            size_t n = strlen(part);
+            if (client.write((const uint8_t*)part, n) != n) {
+                client.stop();
+                return false;
+            }
+        }
+        response.begin(onBody, this);
+        lastMs = nowMs;
+        state = OTA_FETCH_BUSY;
+        return true;
+    }
+
+    // One socket read per call
+    OtaFetchState poll(uint32_t nowMs) {
+        if (state != OTA_FETCH_BUSY) {
+            return state;
+        }
+        uint8_t data[OTA_READ_BYTES];
+        int available = client.available();
+        if (available > 0) {
+            int n = client.read(data, (size_t)available < sizeof(data) ? (size_t)available : sizeof(data));
+            if (n > 0) {
+                response.feed((const char*)data, (size_t)n);
+                lastMs = nowMs;
+            }
+        } else if (!client.connected()) {
+            response.closed();
+        } else if (nowMs - lastMs >= OTA_FETCH_TIMEOUT_MS) {
+            state = OTA_FETCH_FAILED;
+        }
+        if (response.done()) {
+            state = OTA_FETCH_DONE;
+        } else if (response.failed()) {
+            state = OTA_FETCH_FAILED;
+        }
+        if (state != OTA_FETCH_BUSY) {
+            client.stop();
+        }
+        return state;
+    }
+
+    void end() {
+        client.stop();
+        state = OTA_FETCH_IDLE;
+    }
+
+    int status() const { return response.status(); }
+    uint32_t bytes() const { return received; }     // Body bytes of a 200 response
+
+private:
+    // Only a 200 body is patch data; anything else is an error page
+    static void onBody(void* context, const char* data, size_t length) {
+        OtaFetch* self = static_cast<OtaFetch*>(context);
+        if (self->response.status() == 200) {
+            self->received += length;
+            self->bodySink(self->sinkContext, (const uint8_t*)data, length);
+        }
+    }
+
+    Client& client;
+    HttpResponse response;
+    SinkFn bodySink = nullptr;
+    void* sinkContext = nullptr;
+    char hostName[OTA_HOST_BYTES];
+    uint32_t lastMs = 0;
+    uint32_t received = 0;
+    OtaFetchState state = OTA_FETCH_IDLE;
+};
+
+template<bool Enabled>
+class OtaUpdate {
+public:
+    template<typename Uplink, typename Clock>
+    OtaUpdate(Uplink&, Clock&) {}
+    void begin(uint16_t) {}
+    void poll(bool, bool) {}
+    void check() {}
+    bool rollback() { return false; }
+    void printStatus() {}
+};
+
+#if FEATURE_OTA
+
+#if !FEATURE_NETWORK || !FEATURE_PERSISTENCE
+#error "FEATURE_OTA needs FEATURE_NETWORK (for /ota) and FEATURE_PERSISTENCE (for the trial record)"
+#endif
+
+// Flash offsets from 0, the start of the image (eboot, then the sketch)
+struct OtaFlash {
+    static bool read(uint32_t address, uint32_t* data, size_t size) { return ESP.flashRead(address, data, size); }
+    static bool erase(uint32_t sector) { return ESP.flashEraseSector(sector); }
+    static bool write(uint32_t address, const uint32_t* data, size_t size) {
+        return ESP.flashWrite(address, data, size);
+    }
+    static uint32_t imageSize() { return ESP.getSketchSize(); }
+    static uint32_t spaceEnd() { return FS_PHYS_ADDR; }
+};
+
+struct OtaStore {
+    static bool load(void* data, size_t size) {
+        return FlashRecord<true>::load(OTA_STATE_FILE, data, size) == size;
+    }
+    static bool save(const void* data, size_t size) {
+        return FlashRecord<true>::save(OTA_STATE_FILE, OTA_STATE_TMP_FILE, data, size);
+    }
+};
+
+// The core's Updater switches images the same way
+struct OtaBoot {
+    static void install(uint32_t address, uint32_t size) {
+        eboot_command command;
+        memset(&command, 0, sizeof(command));
+        command.action = ACTION_COPY_RAW;
+        command.args[0] = address;
+        command.args[1] = 0;
+        command.args[2] = size;
+        eboot_command_write(&command);
+    }
+    static void restart() {
+        Serial.flush();
+        ESP.restart();
+    }
+};
+
+template<>
+class OtaUpdate<true> {
+public:
+    OtaUpdate(BedUplink<true>& link, TimeSync& clock) : uplink(link), timeSync(clock), fetch(http) {}
+
+    // Early in setup(): a new image that keeps restarting is rolled back here
+    void begin(uint16_t bed) {
+        bedId = bed;
+        installer.begin(millis());
+    }
+
+    // Every loop pass. safe: no bed is in a workflow, so a restart loses
+    // nothing. healthy: this unit holds its own cloud session.
+    void poll(bool safe, bool healthy) {
+        uint32_t now = millis();
+        OtaPhase before = installer.currentPhase();
+        installer.step();
+        if (installer.health(healthy, now)) {
+            LOG(LOG_OTA_CONFIRMED, installer.state().version);
+            reportDue = true;
+        }
+        switch (installer.currentPhase()) {
+        case OTA_IDLE:
+        case OTA_WAITING:
+        case OTA_FAILED:
+            if (installer.imageKnown() && uplink.ready() &&
+                (checkRequested || now - checkedMs >= (installer.currentPhase() == OTA_FAILED
+                                                       ? OTA_RETRY_MS : OTA_CHECK_INTERVAL_MS))) {
+                checkRequested = false;
+                checkedMs = now;
+                readManifest();
+            }
+            if (installer.currentPhase() == OTA_WAITING && rolloutDue()) {
+                startDownload(now, false);
+            }
+            break;
+        case OTA_DOWNLOADING:
+            pollDownload(now);
+            break;
+        case OTA_READY:
+            if (safe) {
+                LOG(LOG_OTA_INSTALLING, targetVersion);
+                report();
+                eventLog.drain();
+                installer.install();
+            }
+            break;
+        default:
+            break;
+        }
+        OtaPhase after = installer.currentPhase();
+        if (after != before && (after == OTA_FAILED || after == OTA_READY)) {
+            if (after == OTA_FAILED) {
+                char reason[OTA_NAME_SIZE];
+                LOG(LOG_OTA_FAILED, otaErrorName(installer.lastError(), reason), httpStatus);
+            } else {
+                LOG(LOG_OTA_STAGED, targetVersion, (unsigned long)fetch.bytes());
+            }
+            reportDue = true;
+        }
+        // After a switch or a rollback, the state goes up once the cloud is there
+        if ((reportDue || !reported) && installer.imageKnown() && uplink.ready()) {
+            report();
+        }
+    }
+
+    // `ota check`: read /ota on the next pass
+    void check() { checkRequested = true; }
+
+    // `ota rollback`: returns only if there is nothing to roll back to
+    bool rollback() {
+        LOG(LOG_OTA_ROLLBACK);
+        eventLog.drain();
+        return installer.rollback() == OTA_OK;
+    }
+
+    void printStatus() {
+        const OtaRecord& record = installer.state();
+        char phase[OTA_NAME_SIZE];
+        char slot[OTA_NAME_SIZE];
+        char error[OTA_NAME_SIZE];
+        Serial.printf_P(PSTR("ota: version=%s image=%08lx size=%lu state=%s boots=%u backup=%s/%08lx@%lx "
+                      "rejected=%08lx\n"), record.version, (unsigned long)installer.crc(),
+                      (unsigned long)installer.size(), otaSlotName(record.state, slot), record.trialBoots,
+                      record.backupVersion, (unsigned long)record.backupCrc, (unsigned long)record.backupAddress,
+                      (unsigned long)record.rejectedCrc);
+        Serial.printf_P(PSTR("ota: phase=%s target=%s/%08lx received=%lu written=%lu error=%s http=%d "
+                      "start_in_s=%ld ram=%uB\n"), otaPhaseName(installer.currentPhase(), phase), targetVersion,
+                      (unsigned long)scheduledCrc, (unsigned long)fetch.bytes(),
+                      (unsigned long)installer.written(), otaErrorName(installer.lastError(), error), httpStatus,
+                      (long)(startUtcS - utcSeconds()), (unsigned)sizeof(*this));
+    }
+
+private:
+    int64_t utcSeconds() {
+        EventStamp now = timeSync.stamp(timeSync.monotonicMs(millis()));
+        return now.utcMs > 0 ? now.utcMs / 1000 : 0;
+    }
+
+    bool rolloutDue() {
+        int64_t now = utcSeconds();
+        return now > 0 && now >= startUtcS;
+    }
+
+    void readManifest() {
+        char version[OTA_VERSION_BYTES];
+        char base[OTA_BASE_BYTES];
+        char crc[12], size[12], start[16], waves[8], minutes[8], paused[8];
+        char sha[2 * OTA_DIGEST_BYTES + 4];
+        JsonField fields[] = {
+            {"version", version, sizeof(version), false},
+            {"targetCrc", crc, sizeof(crc), false},
+            {"targetSize", size, sizeof(size), false},
+            {"targetSha256", sha, sizeof(sha), false},
+            {"patchBase", base, sizeof(base), false},
+            {"rolloutStart", start, sizeof(start), false},
+            {"waves", waves, sizeof(waves), false},
+            {"waveMinutes", minutes, sizeof(minutes), false},
+            {"paused", paused, sizeof(paused), false}
+        };
+        JsonScan scan(fields, sizeof(fields) / sizeof(fields[0]));
+        uint8_t digest[OTA_DIGEST_BYTES];
+        if (!uplink.client().get("/ota", scan) || !fields[1].found || !fields[2].found || !fields[4].found) {
+            return;     // Nothing published, or not reachable now
+        }
+        if (!fields[3].found || !otaParseDigest(sha, digest)) {
+            LOG(LOG_OTA_NO_DIGEST, version);    // Nothing is installed without it
+            return;
+        }
+        uint32_t targetCrc = strtoul(crc, nullptr, 16);
+        if (strcmp(paused, "true") == 0 || !installer.wants(targetCrc)) {
+            if (installer.currentPhase() == OTA_WAITING) {
+                installer.cancel();
+            }
+            return;
+        }
+        uint32_t delay = otaRolloutDelayS(ESP.getChipId(), (uint16_t)atoi(waves), (uint16_t)atoi(minutes));
+        if (installer.currentPhase() != OTA_WAITING || targetCrc != scheduledCrc) {
+            LOG(LOG_OTA_SCHEDULED, version, (unsigned long)delay);
+            reportDue = true;
+        }
+        memcpy(targetVersion, version, sizeof(targetVersion));
+        memcpy(patchBase, base, sizeof(patchBase));
+        scheduledCrc = targetCrc;
+        memcpy(scheduledDigest, digest, sizeof(scheduledDigest));
+        scheduledSize = strtoul(size, nullptr, 10);
+        startUtcS = strtoll(start, nullptr, 10) + delay;
+        installer.schedule();
+    }
+
+    void startDownload(uint32_t now, bool full) {
+        char url[OTA_URL_BYTES];
+        int n = full ? snprintf(url, sizeof(url), "%s/full-%08lx.cldp", patchBase, (unsigned long)scheduledCrc)
+                     : snprintf(url, sizeof(url), "%s/%08lx-%08lx.cldp", patchBase,
+                                (unsigned long)installer.crc(), (unsigned long)scheduledCrc);
+        httpStatus = 0;
+        fullImage = full;
+        if (installer.beginPatch(scheduledSize, scheduledCrc, scheduledDigest, targetVersion) != OTA_OK) {
+            return;
+        }
+        if (n <= 0 || n >= (int)sizeof(url) || !fetch.begin(url, onPatch, this, now)) {
+            installer.fail(OTA_DOWNLOAD_FAILED);
+        }
+    }
+
+    void pollDownload(uint32_t now) {
+        OtaFetchState state = fetch.poll(now);
+        if (installer.currentPhase() != OTA_DOWNLOADING) {
+            fetch.end();                // The patch went bad part way
+            return;
+        }
+        if (state == OTA_FETCH_FAILED) {
+            installer.fail(OTA_DOWNLOAD_FAILED);
+        } else if (state == OTA_FETCH_DONE) {
+            httpStatus = fetch.status();
+            if (httpStatus == 404 && !fullImage) {
+                startDownload(now, true);   // No patch from this image: the whole one
+            } else if (httpStatus != 200) {
+                installer.fail(OTA_HTTP_STATUS);
+            } else {
+                installer.endPatch();
+            }
+        }
+    }
+
+    static void onPatch(void* context, const uint8_t* data, size_t length) {
+        static_cast<OtaUpdate*>(context)->installer.feed(data, length);
+    }
+
+    void report() {
+        char path[24];
+        snprintf(path, sizeof(path), "/ota/status/bed%u", bedId);
+        const OtaRecord& record = installer.state();
+        OtaPhase phase = installer.currentPhase();
+        OtaError error = installer.lastError();
+        int status = httpStatus;
+        EventStamp now = timeSync.stamp(timeSync.monotonicMs(millis()));
+        char image[12];
+        char target[12];
+        snprintf(image, sizeof(image), "%08lx", (unsigned long)installer.crc());
+        snprintf(target, sizeof(target), "%08lx", (unsigned long)scheduledCrc);
+        reported = uplink.client().put(path, [&](JsonOut& json) {
+            char name[OTA_NAME_SIZE];
+            json.beginObject();
+            json.add("version", record.version);
+            json.add("image", image);
+            json.add("state", otaSlotName(record.state, name));
+            json.add("phase", otaPhaseName(phase, name));
+            if (scheduledCrc != 0) {
+                json.add("target", target);
+            }
+            if (error != OTA_OK) {
+                json.add("error", otaErrorName(error, name));
+                json.add("httpStatus", (int32_t)status);
+            }
+            json.add("lastUpdate", (int64_t)now.utcMs);
+            json.endObject();
+        });
+        reportDue = !reported;
+    }
+
+    BedUplink<true>& uplink;
+    TimeSync& timeSync;
+    WiFiClient http;
+    OtaFetch<WiFiClient> fetch;
+    OtaInstaller<OtaFlash, OtaStore, OtaBoot> installer;
+    char patchBase[OTA_BASE_BYTES] = {};
+    char targetVersion[OTA_VERSION_BYTES] = {};
+    int64_t startUtcS = 0;
+    uint32_t scheduledCrc = 0;
+    uint8_t scheduledDigest[OTA_DIGEST_BYTES] = {};
+    uint32_t scheduledSize = 0;
+    uint32_t checkedMs = 0;
+    int httpStatus = 0;
+    uint16_t bedId = 0;
+    bool checkRequested = true;     // Read /ota once the cloud is up after boot
+    bool fullImage = false;
+    bool reported = false;
+    bool reportDue = false;
+};
+
+#endif
+
+#endif
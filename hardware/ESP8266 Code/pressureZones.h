@@ -0,0 +1,194 @@
+#ifndef CURALINK_PRESSURE_ZONES_H
+#define CURALINK_PRESSURE_ZONES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Load distribution over an array of FSR zones and the bed-exit risk
+// decision. Pure integer code with no Arduino dependency, so the same logic
+// runs on the host (tools/fsr_zone_bench.cpp).
+// Zones sit in two columns along the bed, zone 0 at the head on the left:
+//   0 1
+//   2 3     x: -1000 (left column) .. +1000 (right column)
+//   4 5     y: -1000 (head row) .. +1000 (foot row)
+// With an odd count the last zone is centred. The centre of pressure (COP)
+// is the load-weighted mean zone position, in the same permille units, so
+// |x| near 1000 means nearly all load is on one side of the bed.
+// Each zone reading updates the load total and moment sums in O(1); the COP
+// costs one division per axis when it is read.
+
+#define ZONE_MAX                    8
+#define ZONE_BASELINE_WINDOW        64     // Empty-bed baseline follows ~1/64 of each reading
+#define ZONE_EXIT_MIN_LOAD          150    // Summed counts above baseline that mean someone is on the bed
+#define ZONE_EXIT_EDGE_PERMILLE     650    // |COP x| at which the load is at a bed edge
+#define ZONE_EXIT_CLEAR_PERMILLE    450    // |COP x| that counts as back in the middle
+#define ZONE_EXIT_CONFIRM_MS        300    // Edge load held this long raises the risk
+#define ZONE_EXIT_CLEAR_MS          2000   // Middle load held this long clears it
+#define ZONE_EXIT_ARM_MS            5000   // Load in the middle this long before edges count
+
+struct ZonePosition {
+    int16_t x;
+    int16_t y;
+};
+
+inline ZonePosition zonePosition(uint8_t zone, uint8_t count) {
+    uint8_t rows = (count + 1) / 2;
+    uint8_t row = zone / 2;
+    ZonePosition p;
+    p.y = rows > 1 ? (int16_t)(-1000 + 2000 * row / (rows - 1)) : 0;
+    if (zone + 1 == count && count % 2 == 1) {
+        p.x = 0;
+    } else {
+        p.x = zone % 2 == 0 ? -1000 : 1000;
+    }
+    return p;
+}
+
+template<uint8_t Zones>
+class ZonePressureMap {
+    static_assert(Zones >= 2 && Zones <= ZONE_MAX, "2-8 FSR zones are supported");
+
+public:
+    ZonePressureMap() {
+        for (uint8_t i = 0; i < Zones; i++) {
+            position[i] = zonePosition(i, Zones);
+        }
+    }
+
+    // New reading for one zone. While learn is set (bed empty) the reading
+    // also refines that zone's baseline.
+    void update(uint8_t zone, uint16_t raw, bool learn) {
+        if (learn) {
+            if (!seeded[zone]) {
+                baselineQ4[zone] = (int32_t)raw << 4;
+                seeded[zone] = true;
+            } else {
+                baselineQ4[zone] += (((int32_t)raw << 4) - baselineQ4[zone]) / ZONE_BASELINE_WINDOW;
+            }
+        }
+        int32_t zoneLoad = (int32_t)raw - (baselineQ4[zone] >> 4);
+        if (zoneLoad < 0) {
+            zoneLoad = 0;
+        }
+        int32_t delta = zoneLoad - load[zone];
+        load[zone] = zoneLoad;
+        rawSum += (int32_t)raw - rawValue[zone];
+        rawValue[zone] = raw;
+        total += delta;
+        momentX += delta * position[zone].x;
+        momentY += delta * position[zone].y;
+    }
+
+    int32_t totalLoad() const { return total; }
+
+    // Mean raw reading, on the scale of a single FSR on A0
+    int meanRaw() const { return (int)(rawSum / Zones); }
+
+    int16_t copX() const { return total > 0 ? (int16_t)(momentX / total) : 0; }
+    int16_t copY() const { return total > 0 ? (int16_t)(momentY / total) : 0; }
+
+    uint16_t raw(uint8_t zone) const { return rawValue[zone]; }
+    int32_t zoneLoad(uint8_t zone) const { return load[zone]; }
+    int baseline(uint8_t zone) const { return (int)(baselineQ4[zone] >> 4); }
+
+    // Share of the total load on one zone, in permille
+    uint16_t sharePermille(uint8_t zone) const {
+        return total > 0 ? (uint16_t)(load[zone] * 1000 / total) : 0;
+    }
+
+private:
+    ZonePosition position[Zones];
+    uint16_t rawValue[Zones] = {};
+    int32_t load[Zones] = {};
+    int32_t baselineQ4[Zones] = {};
+    bool seeded[Zones] = {};
+    int32_t rawSum = 0;
+    int32_t total = 0;
+    int32_t momentX = 0;
+    int32_t momentY = 0;
+};
+
+// Raises the exit risk when load that has been lying in the middle of the
+// bed moves to a side and stays there (sitting up on the edge). Someone
+// sitting on an empty bed's edge does not arm it. Evaluated once per scan.
+class BedExitDetector {
+public:
+    // Returns true when the risk was raised or cleared by this frame
+    bool update(int32_t totalLoad, int16_t copX, uint32_t nowMs) {
+        bool loaded = totalLoad >= ZONE_EXIT_MIN_LOAD;
+        int16_t side = copX < 0 ? -copX : copX;
+        bool atEdge = loaded && side >= ZONE_EXIT_EDGE_PERMILLE;
+        bool inMiddle = loaded && side <= ZONE_EXIT_CLEAR_PERMILLE;
+
+        if (!loaded) {
+            middleSince = 0;
+            edgeSince = 0;
+            if (emptySince == 0) {
+                emptySince = nowMs | 1;
+            }
+            // Bed empty: the exit has happened, occupancy reporting takes over
+            if (heldFor(emptySince, nowMs, ZONE_EXIT_ARM_MS)) {
+                armed = false;
+                if (risk) {
+                    risk = false;
+                    return true;
+                }
+            }
+            return false;
+        }
+        emptySince = 0;
+
+        if (inMiddle) {
+            edgeSince = 0;
+            if (middleSince == 0) {
+                middleSince = nowMs | 1;
+            }
+            if (heldFor(middleSince, nowMs, ZONE_EXIT_ARM_MS)) {
+                armed = true;
+            }
+            if (risk && heldFor(middleSince, nowMs, ZONE_EXIT_CLEAR_MS)) {
+                risk = false;
+                return true;
+            }
+            return false;
+        }
+        middleSince = 0;
+
+        if (!atEdge) {
+            edgeSince = 0;
+            return false;
+        }
+        if (!armed || risk) {
+            return false;
+        }
+        if (edgeSince == 0) {
+            edgeSince = nowMs | 1;
+        }
+        if (heldFor(edgeSince, nowMs, ZONE_EXIT_CONFIRM_MS)) {
+            risk = true;
+            raisedCount++;
+            return true;
+        }
+        return false;
+    }
+
+    bool active() const { return risk; }
+    bool isArmed() const { return armed; }
+    uint32_t raised() const { return raisedCount; }
+
+private:
+    // Start times are stored with bit 0 set so that 0 means "not running";
+    // that can put them 1 ms ahead of now, hence the signed difference
+    static bool heldFor(uint32_t since, uint32_t nowMs, uint32_t ms) {
+        return (int32_t)(nowMs - since) >= (int32_t)ms;
+    }
+
+    uint32_t middleSince = 0;
+    uint32_t edgeSince = 0;
+    uint32_t emptySince = 0;
+    uint32_t raisedCount = 0;
+    bool armed = false;
+    bool risk = false;
+};
+
+#endif
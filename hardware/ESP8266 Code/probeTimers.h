@@ -0,0 +1,191 @@
+#ifndef CURALINK_PROBE_TIMERS_H
+#define CURALINK_PROBE_TIMERS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "firmwareProfile.h"
+#include "flashText.h"
+
+// Profiling probes (FEATURE_PROBES): where the time goes inside loop().
+// PROBE(site) at the top of a block times the rest of the block and adds the
+// duration to that site's histogram. Sites are fixed at compile time in
+// PROBE_SITES, so each has its slot in a static table and its name in flash.
+//
+// The clock is the CPU cycle counter on the ESP8266 (one tick per cycle, a
+// single register read) and std::chrono nanoseconds on the host, so the same
+// sites can be timed in the host tools (tools/probe_check.cpp) and compared
+// in microseconds. Bucket k of a histogram counts durations of
+// [2^k, 2^(k+1)) ticks: recording is a count-leading-zeros and a few adds,
+// no division. A 32-bit tick count wraps after 53 s at 80 MHz, far longer
+// than anything timed here.
+//
+// With FEATURE_PROBES 0, PROBE() expands to nothing and no table is built.
+
+#define PROBE_BUCKETS       32      // One per bit of the tick count
+
+// Probe sites: ID, name in the `prof` dump and the uplink record
+#define PROBE_SITES(X) \
+    X(PROBE_SENSORS,        "sensors") /* readSensors(): MLX90614/ADC reads and filtering */ \
+    X(PROBE_RFID,           "rfid") /* processRFID(): RC522 SPI poll and card handling */ \
+    X(PROBE_BUTTONS,        "buttons") \
+    X(PROBE_DISPLAY,        "display") /* updateDisplay(): composes the LCD lines */ \
+    X(PROBE_I2C_SERVICE,    "i2c_service") /* Deferred bus work: the LCD writes themselves */ \
+    X(PROBE_UPLINK,         "uplink") /* updateFirebase(): records to the RTDB or the mesh */ \
+    X(PROBE_UPLINK_POLL,    "uplink_poll") /* Uplink upkeep and settings poll */ \
+    X(PROBE_HOURS,          "hours") /* reportHours(): finished hours to the RTDB */ \
+    X(PROBE_LAN_PUSH,       "lan_push") \
+    X(PROBE_STATE,          "state") /* saveState(): RTC/flash snapshots */ \
+    X(PROBE_LOG_DRAIN,      "log_drain")
+
+#define PROBE_ID(id, name) id,
+enum ProbeId : uint8_t { PROBE_SITES(PROBE_ID) PROBE_COUNT };
+#undef PROBE_ID
+
+#define PROBE_NAME_STRING(id, name) static const char id##_NAME[] PROGMEM = name;
+PROBE_SITES(PROBE_NAME_STRING)
+#undef PROBE_NAME_STRING
+#define PROBE_NAME_ENTRY(id, name) id##_NAME,
+static const char* const PROBE_NAMES[] PROGMEM = { PROBE_SITES(PROBE_NAME_ENTRY) };
+#undef PROBE_NAME_ENTRY
+
+#define PROBE_NAME_SIZE     16
+
+// Copies the site's name out of flash; returns out
+inline const char* probeName(ProbeId site, char (&out)[PROBE_NAME_SIZE]) {
+    copyFlashText(out, sizeof(out), (const char*)pgm_read_ptr(&PROBE_NAMES[site]));
+    return out;
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#define PROBE_CLOCK         "cycles"
+inline uint32_t probeTicks() { return ESP.getCycleCount(); }
+inline uint32_t probeTicksPerUs() { return ESP.getCpuFreqMHz(); }
+#else
+#include <chrono>
+#define PROBE_CLOCK         "ns"
+inline uint32_t probeTicks() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+inline uint32_t probeTicksPerUs() { return 1000; }
+#endif
+
+struct ProbeHistogram {
+    uint32_t count;
+    uint32_t minTicks;
+    uint32_t maxTicks;
+    uint64_t totalTicks;
+    uint32_t buckets[PROBE_BUCKETS];
+};
+
+class ProbeTable {
+public:
+    ProbeTable() { reset(); }
+
+    void record(ProbeId site, uint32_t ticks) {
+        ProbeHistogram& h = sites[site];
+        h.buckets[31 - __builtin_clz(ticks | 1)]++;
+        h.count++;
+        h.totalTicks += ticks;
+        if (ticks < h.minTicks) h.minTicks = ticks;
+        if (ticks > h.maxTicks) h.maxTicks = ticks;
+    }
+
+    void reset() {
+        memset(sites, 0, sizeof(sites));
+        for (ProbeHistogram& h : sites) {
+            h.minTicks = UINT32_MAX;
+        }
+    }
+
+    const ProbeHistogram& histogram(ProbeId site) const { return sites[site]; }
+
+    // Duration at or below which `permille` of the samples fall, in ticks:
+    // found by bucket, then interpolated within the part of the bucket
+    // between the smallest and largest durations seen
+    uint32_t percentileTicks(ProbeId site, uint16_t permille) const {
+        const ProbeHistogram& h = sites[site];
+        if (h.count == 0) {
+            return 0;
+        }
+        uint64_t rank = ((uint64_t)h.count * permille + 999) / 1000;
+        if (rank == 0) rank = 1;
+        uint64_t below = 0;
+        for (uint8_t k = 0; k < PROBE_BUCKETS; k++) {
+            uint32_t n = h.buckets[k];
+            if (below + n < rank) {
+                below += n;
+                continue;
+            }
+            uint64_t low = k == 0 ? 0 : (1ULL << k);
+            uint64_t high = 2ULL << k;
+            if (low < h.minTicks) low = h.minTicks;
+            if (high > (uint64_t)h.maxTicks + 1) high = (uint64_t)h.maxTicks + 1;
+            return (uint32_t)(low + (high - low) * (rank - below) / n - (rank - below == n ? 1 : 0));
+        }
+        return h.maxTicks;
+    }
+
+    uint32_t meanTicks(ProbeId site) const {
+        const ProbeHistogram& h = sites[site];
+        return h.count ? (uint32_t)(h.totalTicks / h.count) : 0;
+    }
+
+private:
+    ProbeHistogram sites[PROBE_COUNT];
+};
+
+// Ticks to hundredths of a microsecond, for the dump and the uplink record
+inline uint32_t probeCentiUs(uint32_t ticks) {
+    return (uint32_t)((uint64_t)ticks * 100 / probeTicksPerUs());
+}
+
+// One site as printed by `prof` and the host tools, times in microseconds:
+//   "<name> n=<count> mean_us=.. p50_us=.. p90_us=.. p99_us=.. max_us=.."
+#define PROBE_SUMMARY_SIZE  128
+static const char PROBE_SUMMARY_FORMAT[] PROGMEM =
+    "%-11s n=%lu mean_us=%lu.%02lu p50_us=%lu.%02lu p90_us=%lu.%02lu p99_us=%lu.%02lu max_us=%lu.%02lu";
+
+inline int formatProbeSummary(char* out, size_t size, const ProbeTable& table, ProbeId site) {
+    char name[PROBE_NAME_SIZE];
+    const ProbeHistogram& h = table.histogram(site);
+    uint32_t us[5] = {
+        probeCentiUs(table.meanTicks(site)),
+        probeCentiUs(table.percentileTicks(site, 500)),
+        probeCentiUs(table.percentileTicks(site, 900)),
+        probeCentiUs(table.percentileTicks(site, 990)),
+        probeCentiUs(h.count ? h.maxTicks : 0)
+    };
+    return snprintf_P(out, size, PROBE_SUMMARY_FORMAT, probeName(site, name), (unsigned long)h.count,
+                      (unsigned long)(us[0] / 100), (unsigned long)(us[0] % 100),
+                      (unsigned long)(us[1] / 100), (unsigned long)(us[1] % 100),
+                      (unsigned long)(us[2] / 100), (unsigned long)(us[2] % 100),
+                      (unsigned long)(us[3] / 100), (unsigned long)(us[3] % 100),
+                      (unsigned long)(us[4] / 100), (unsigned long)(us[4] % 100));
+}
+
+class ProbeScope {
+public:
+    ProbeScope(ProbeTable& table, ProbeId site) : table(table), site(site), start(probeTicks()) {}
+    ~ProbeScope() { table.record(site, probeTicks() - start); }
+
+    ProbeScope(const ProbeScope&) = delete;
+    ProbeScope& operator=(const ProbeScope&) = delete;
+
+private:
+    ProbeTable& table;
+    ProbeId site;
+    uint32_t start;
+};
+
+#define PROBE_CONCAT_(a, b) a##b
+#define PROBE_CONCAT(a, b) PROBE_CONCAT_(a, b)
+#if FEATURE_PROBES
+#define PROBE(site) ProbeScope PROBE_CONCAT(probeScope, __LINE__)(probes, site)
+#else
+#define PROBE(site) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,339 @@
+#ifndef CURALINK_PUSH_HUB_H
+#define CURALINK_PUSH_HUB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+// Server-sent events (text/event-stream) to a few subscribers on the LAN, so
+// a nurse-station display sees a bed change without the Firebase round trip
+// and keeps seeing them while the internet is down. Browsers subscribe with
+// EventSource and reconnect on their own, so there is no WebSocket handshake
+// or framing to carry.
+// - Each topic (bed slot) has a latest event; publish() formats it once and
+//   appends it to every subscriber's buffer. A new subscriber starts with the
+//   latest event of every topic, so it needs no history.
+// - Buffers are fixed (BufferBytes per subscriber) and hold whole events. When
+//   an event does not fit, the subscriber is marked as owing that topic and
+//   gets its latest event once the buffer drains: a slow display skips
+//   intermediate states but never sees a stale one last, and never costs
+//   memory. A subscriber that takes nothing for PUSH_STALL_MS is dropped.
+// - At most MaxClients connections; the next one is answered 503 and closed,
+//   and EventSource retries later.
+// - service() reads requests, flushes no more than the socket takes without
+//   blocking (availableForWrite) and sends a comment line on idle streams.
+// Client is WiFiClient on the device; tools/lan_push_bench.cpp runs the same
+// hub over POSIX sockets. It needs connected(), available(),
+// read(uint8_t*, size_t), write(const uint8_t*, size_t), availableForWrite()
+// and stop().
+
+#define PUSH_PATH               "/events"
+#define PUSH_EVENT_BYTES        512     // Longest event with its id/event/data framing
+#define PUSH_LINE_BYTES         32      // Request line kept for matching; the rest is skipped
+#define PUSH_REQUEST_BYTES      2048    // Longest request head accepted
+#define PUSH_REQUEST_TIMEOUT_MS 3000    // The request head must arrive within this
+#define PUSH_PING_MS            15000   // Comment line on an idle stream
+#define PUSH_STALL_MS           30000   // Subscriber that takes no bytes for this long is dropped
+#define PUSH_RETRY_MS           2000    // Reconnect delay for EventSource
+
+enum PushSlotState : uint8_t {
+    PUSH_FREE,
+    PUSH_REQUEST,       // Reading the request head
+    PUSH_STREAM,        // Subscribed
+    PUSH_CLOSING        // Sending an error response, then closed
+};
+
+struct PushStats {
+    uint32_t accepted;          // Connections given a slot
+    uint32_t rejected;          // Turned away at the connection cap
+    uint32_t badRequests;       // Oversized, timed out or not found
+    uint32_t subscribed;        // Streams started
+    uint32_t events;            // Events published
+    uint32_t oversized;         // Events longer than PUSH_EVENT_BYTES, not sent
+    uint32_t coalesced;         // Events a full buffer skipped; the latest followed
+    uint32_t stalled;           // Subscribers dropped for not reading
+    uint32_t closed;            // Subscribers that went away
+    uint32_t bytes;             // Written to sockets
+    uint16_t maxBacklog;        // Fullest buffer seen
+};
+
+template<typename Client, uint8_t MaxClients, uint16_t BufferBytes, uint8_t Topics>
+class PushHub {
+    static_assert(BufferBytes >= PUSH_EVENT_BYTES + 256, "A buffer must hold the response head and an event");
+    static_assert(Topics >= 1 && Topics <= 32, "Owed topics are a 32-bit mask");
+
+public:
+    // A new connection. Returns false, after answering 503 and closing it,
+    // when every slot is taken.
+    bool add(const Client& client, uint32_t nowMs) {
+        for (uint8_t i = 0; i < MaxClients; i++) {
+            Slot& slot = slots[i];
+            if (slot.state != PUSH_FREE) {
+                continue;
+            }
+            slot.client = client;
+            slot.state = PUSH_REQUEST;
+            slot.head = 0;
+            slot.count = 0;
+            slot.owed = 0;
+            slot.sinceMs = nowMs;
+            slot.activeMs = nowMs;
+            slot.lineLength = 0;
+            slot.lineDone = false;
+            slot.blankLine = true;
+            slot.requestBytes = 0;
+            counters.accepted++;
+            return true;
+        }
+        static const char BUSY[] = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 5\r\n"
+                                   "Content-Length: 0\r\nConnection: close\r\n\r\n";
+        Client busy = client;
+        busy.write((const uint8_t*)BUSY, sizeof(BUSY) - 1);
+        busy.stop();
+        counters.rejected++;
+        return false;
+    }
+
+    // New state of a topic as a JSON object
+    void publish(uint8_t topic, const char* json) {
+        if (topic >= Topics) {
+            return;
+        }
+        int length = snprintf(latest[topic], PUSH_EVENT_BYTES, "id: %lu\nevent: bed\ndata: %s\n\n",
+                              (unsigned long)(seq + 1), json);
+        if (length <= 0 || length >= PUSH_EVENT_BYTES) {
+            latestLength[topic] = 0;
+            counters.oversized++;
+            return;
+        }
+        seq++;
+        latestLength[topic] = (uint16_t)length;
+        counters.events++;
+        uint32_t bit = 1UL << topic;
+        for (uint8_t i = 0; i < MaxClients; i++) {
+            Slot& slot = slots[i];
+            if (slot.state != PUSH_STREAM) {
+                continue;
+            }
+            // A subscriber already owed this topic gets the latest event anyway
+            if ((slot.owed & bit) == 0 && !append(slot, latest[topic], latestLength[topic])) {
+                slot.owed |= bit;
+                counters.coalesced++;
+            }
+        }
+    }
+
+    // Every loop pass
+    void service(uint32_t nowMs) {
+        for (uint8_t i = 0; i < MaxClients; i++) {
+            Slot& slot = slots[i];
+            if (slot.state == PUSH_FREE) {
+                continue;
+            }
+            if (!slot.client.connected()) {
+                if (slot.state == PUSH_STREAM) {
+                    counters.closed++;
+                }
+                release(slot);
+                continue;
+            }
+            if (slot.state == PUSH_REQUEST) {
+                readRequest(slot, nowMs);
+                if (slot.state != PUSH_STREAM && slot.state != PUSH_CLOSING) {
+                    continue;
+                }
+            } else {
+                skipInput(slot);
+            }
+            if (slot.state == PUSH_STREAM) {
+                catchUp(slot);
+                if (slot.count == 0 && nowMs - slot.activeMs >= PUSH_PING_MS) {
+                    static const char PING[] = ": ping\n\n";
+                    append(slot, PING, sizeof(PING) - 1);
+                }
+            }
+            flush(slot, nowMs);
+            if (slot.count > 0 && nowMs - slot.activeMs >= PUSH_STALL_MS) {
+                counters.stalled++;
+                release(slot);
+            } else if (slot.state == PUSH_CLOSING && slot.count == 0) {
+                release(slot);
+            }
+        }
+    }
+
+    uint8_t subscriberCount() const {
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < MaxClients; i++) {
+            n += slots[i].state == PUSH_STREAM;
+        }
+        return n;
+    }
+
+    uint16_t backlog(uint8_t i) const { return slots[i].count; }
+    PushSlotState slotState(uint8_t i) const { return slots[i].state; }
+    uint32_t sequence() const { return seq; }
+    const PushStats& stats() const { return counters; }
+
+private:
+    struct Slot {
+        Client client;
+        PushSlotState state = PUSH_FREE;
+        uint16_t head = 0;              // Oldest unsent byte
+        uint16_t count = 0;             // Unsent bytes
+        uint32_t owed = 0;              // Topics whose latest event did not fit
+        uint32_t sinceMs = 0;           // Connected at
+        uint32_t activeMs = 0;          // Last byte taken by the socket
+        uint16_t requestBytes = 0;
+        uint8_t lineLength = 0;
+        bool lineDone = false;
+        bool blankLine = true;          // Nothing but '\r' since the last '\n'
+        char line[PUSH_LINE_BYTES];
+        uint8_t buffer[BufferBytes];
+    };
+
+    // All or nothing, so the stream only ever holds whole events
+    bool append(Slot& slot, const char* data, uint16_t length) {
+        if (length > BufferBytes - slot.count) {
+            return false;
+        }
+        uint16_t tail = (uint16_t)((slot.head + slot.count) % BufferBytes);
+        uint16_t first = length < BufferBytes - tail ? length : (uint16_t)(BufferBytes - tail);
+        memcpy(slot.buffer + tail, data, first);
+        memcpy(slot.buffer, data + first, length - first);
+        slot.count += length;
+        if (slot.count > counters.maxBacklog) {
+            counters.maxBacklog = slot.count;
+        }
+        return true;
+    }
+
+    // Latest events the buffer could not take when they were published
+    void catchUp(Slot& slot) {
+        for (uint8_t topic = 0; slot.owed != 0 && topic < Topics; topic++) {
+            uint32_t bit = 1UL << topic;
+            if ((slot.owed & bit) == 0) {
+                continue;
+            }
+            if (latestLength[topic] != 0 && !append(slot, latest[topic], latestLength[topic])) {
+                return;
+            }
+            slot.owed &= ~bit;
+        }
+    }
+
+    void flush(Slot& slot, uint32_t nowMs) {
+        while (slot.count > 0) {
+            size_t room = slot.client.availableForWrite();
+            uint16_t contiguous = slot.count < BufferBytes - slot.head ? slot.count
+                                                                       : (uint16_t)(BufferBytes - slot.head);
+            size_t length = contiguous < room ? contiguous : room;
+            if (length == 0) {
+                return;
+            }
+            size_t written = slot.client.write(slot.buffer + slot.head, length);
+            if (written == 0) {
+                return;
+            }
+            slot.head = (uint16_t)((slot.head + written) % BufferBytes);
+            slot.count -= (uint16_t)written;
+            slot.activeMs = nowMs;
+            counters.bytes += written;
+        }
+        slot.head = 0;
+    }
+
+    void readRequest(Slot& slot, uint32_t nowMs) {
+        uint8_t chunk[64];
+        int available;
+        while ((available = slot.client.available()) > 0) {
+            int n = slot.client.read(chunk, available < (int)sizeof(chunk) ? (size_t)available : sizeof(chunk));
+            if (n <= 0) {
+                break;
+            }
+            for (int k = 0; k < n; k++) {
+                char c = (char)chunk[k];
+                if (++slot.requestBytes > PUSH_REQUEST_BYTES) {
+                    reject(slot);
+                    return;
+                }
+                if (c == '\n') {
+                    if (slot.blankLine && slot.lineDone) {
+                        answer(slot);
+                        return;
+                    }
+                    slot.lineDone = true;
+                    slot.blankLine = true;
+                } else if (c != '\r') {
+                    slot.blankLine = false;
+                    if (!slot.lineDone && slot.lineLength < PUSH_LINE_BYTES - 1) {
+                        slot.line[slot.lineLength++] = c;
+                    }
+                }
+            }
+        }
+        if (nowMs - slot.sinceMs >= PUSH_REQUEST_TIMEOUT_MS) {
+            reject(slot);
+        }
+    }
+
+    // The request head is complete: GET /events (any query) subscribes
+    void answer(Slot& slot) {
+        slot.line[slot.lineLength] = '\0';
+        static const char PREFIX[] = "GET " PUSH_PATH;
+        size_t prefix = sizeof(PREFIX) - 1;
+        bool events = strncmp(slot.line, PREFIX, prefix) == 0 &&
+                      (slot.line[prefix] == ' ' || slot.line[prefix] == '?');
+        if (!events) {
+            static const char NOT_FOUND[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n"
+                                            "Connection: close\r\n\r\n";
+            append(slot, NOT_FOUND, sizeof(NOT_FOUND) - 1);
+            slot.state = PUSH_CLOSING;
+            counters.badRequests++;
+            return;
+        }
+        static const char HEAD[] = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                                   "Cache-Control: no-cache\r\nConnection: keep-alive\r\n"
+                                   "Access-Control-Allow-Origin: *\r\n\r\n";
+        append(slot, HEAD, sizeof(HEAD) - 1);
+        char retry[24];
+        int length = snprintf(retry, sizeof(retry), "retry: %u\n\n", (unsigned)PUSH_RETRY_MS);
+        append(slot, retry, (uint16_t)length);
+        for (uint8_t topic = 0; topic < Topics; topic++) {
+            if (latestLength[topic] != 0) {
+                slot.owed |= 1UL << topic;
+            }
+        }
+        slot.state = PUSH_STREAM;
+        counters.subscribed++;
+    }
+
+    void reject(Slot& slot) {
+        counters.badRequests++;
+        release(slot);
+    }
+
+    // Subscribers have nothing more to say; keep their input from piling up
+    void skipInput(Slot& slot) {
+        uint8_t chunk[32];
+        while (slot.client.available() > 0 && slot.client.read(chunk, sizeof(chunk)) > 0) {
+        }
+    }
+
+    void release(Slot& slot) {
+        slot.client.stop();
+        slot.state = PUSH_FREE;
+        slot.client = Client();
+        slot.count = 0;
+        slot.owed = 0;
+    }
+
+    Slot slots[MaxClients];
+    char latest[Topics][PUSH_EVENT_BYTES];
+    uint16_t latestLength[Topics] = {};
+    uint32_t seq = 0;
+    PushStats counters = {};
+};
+
+#endif
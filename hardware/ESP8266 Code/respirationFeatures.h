@@ -0,0 +1,186 @@
+#ifndef CURALINK_RESPIRATION_FEATURES_H
+#define CURALINK_RESPIRATION_FEATURES_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming breathing and motion features from the FSR load signal.
+// Integer-only per sample (no FPU on the ESP8266) and no sample history:
+// every input sample is folded into running sums, and one compact record
+// per minute comes out. The same code runs on the host
+// (tools/respiration_bench.cpp).
+// - Motion: squared sample-to-sample change at the full capture rate,
+//   summed per second and per minute.
+// - Breathing: the samples are averaged down to RESP_DECIMATED_HZ, the slow
+//   load drift is removed, and a bank of Goertzel filters measures the power
+//   at every whole breaths/min from RESP_MIN_BPM to RESP_MAX_BPM over the
+//   minute. A minute of 5 Hz samples makes each filter exactly one DFT bin
+//   (1/60 Hz apart), so the peak bin is the breathing rate.
+// - Zero crossings of the detrended signal (with hysteresis) give an
+//   independent cycle count: about two per breath.
+
+#define RESP_DECIMATED_HZ       5
+#define RESP_WINDOW_SECONDS     60
+#define RESP_MIN_BPM            6
+#define RESP_MAX_BPM            40
+#define RESP_BINS               (RESP_MAX_BPM - RESP_MIN_BPM + 1)
+#define RESP_COEFF_SHIFT        14     // Goertzel coefficients in Q14
+#define RESP_DRIFT_SHIFT        5      // Drift follows 1/32 of each decimated sample (~6 s)
+#define RESP_SIGNAL_LIMIT       8191   // Detrended samples are clipped here (motion), keeps filters in 32 bits
+#define RESP_ZC_HYSTERESIS      8      // Detrended units (1/16 of a decimated sum)
+#define RESP_MOTION_THRESHOLD   25     // Mean squared step (counts^2) that makes a second "moving"
+#define RESP_MAX_MOTION_SECONDS 15     // More than this and the rate is not reported
+#define RESP_MIN_CONFIDENCE     35     // Percent of band power around the peak
+
+struct RespirationMinute {
+    uint16_t meanLoad;          // Mean FSR reading over the minute
+    uint8_t breathsPerMin;      // 0 when motion or a flat spectrum makes it unreliable
+    uint8_t confidence;         // Percent of the breathing band power in the peak (+-1 bin)
+    uint16_t zeroCrossings;
+    uint8_t motionSeconds;      // Seconds with more change than RESP_MOTION_THRESHOLD
+    uint32_t motionEnergy;      // Sum of squared sample-to-sample changes, saturating
+    uint16_t droppedSamples;    // Ring overruns and missed ticks during the minute (filled in by the caller)
+};
+
+template<uint16_t SampleHz>
+class RespirationExtractor {
+    static_assert(SampleHz % RESP_DECIMATED_HZ == 0, "capture rate must be a multiple of 5 Hz");
+    static_assert(SampleHz <= 200, "decimated sums must fit 16 bits");
+    static constexpr uint16_t DECIMATION = SampleHz / RESP_DECIMATED_HZ;
+    static constexpr uint16_t WINDOW = RESP_DECIMATED_HZ * RESP_WINDOW_SECONDS;
+
+public:
+    RespirationExtractor() {
+        // Bin k of a WINDOW-point DFT at RESP_DECIMATED_HZ is k/60 Hz = k breaths/min
+        for (uint8_t i = 0; i < RESP_BINS; i++) {
+            double w = 2.0 * M_PI * (RESP_MIN_BPM + i) / WINDOW;
+            coeff[i] = (int16_t)lround(2.0 * cos(w) * (1 << RESP_COEFF_SHIFT));
+        }
+        resetWindow();
+    }
+
+    // One capture sample; returns true when it completed a minute
+    bool add(uint16_t sample) {
+        if (hasPrevious) {
+            int32_t step = (int32_t)sample - previous;
+            secondEnergy += (uint32_t)(step * step);
+        }
+        previous = sample;
+        hasPrevious = true;
+        loadSum += sample;
+        if (++secondSamples == SampleHz) {
+            if (secondEnergy > (uint32_t)RESP_MOTION_THRESHOLD * SampleHz) {
+                motionSeconds++;
+            }
+            motionEnergy = motionEnergy + secondEnergy < motionEnergy ? UINT32_MAX : motionEnergy + secondEnergy;
+            secondEnergy = 0;
+            secondSamples = 0;
+        }
+
+        decimatedSum += sample;
+        if (++decimatedCount < DECIMATION) {
+            return false;
+        }
+        addDecimated(decimatedSum);
+        decimatedSum = 0;
+        decimatedCount = 0;
+        if (++windowSamples < WINDOW) {
+            return false;
+        }
+        finishWindow();
+        return true;
+    }
+
+    // The minute completed by the last add() that returned true
+    const RespirationMinute& minute() const { return result; }
+
+private:
+    void addDecimated(int32_t sum) {
+        // Drift in Q8 of the decimated sum; the first sample seeds it
+        int32_t scaled = sum << 8;
+        if (!driftSeeded) {
+            driftQ8 = scaled;
+            driftSeeded = true;
+        }
+        driftQ8 += (scaled - driftQ8) >> RESP_DRIFT_SHIFT;
+        int32_t x = (scaled - driftQ8) >> 4;  // Q4
+        if (x > RESP_SIGNAL_LIMIT) x = RESP_SIGNAL_LIMIT;
+        if (x < -RESP_SIGNAL_LIMIT) x = -RESP_SIGNAL_LIMIT;
+
+        if (x > RESP_ZC_HYSTERESIS) {
+            if (sign < 0) zeroCrossings++;
+            sign = 1;
+        } else if (x < -RESP_ZC_HYSTERESIS) {
+            if (sign > 0) zeroCrossings++;
+            sign = -1;
+        }
+
+        for (uint8_t i = 0; i < RESP_BINS; i++) {
+            int32_t s = x + (int32_t)(((int64_t)coeff[i] * s1[i]) >> RESP_COEFF_SHIFT) - s2[i];
+            s2[i] = s1[i];
+            s1[i] = s;
+        }
+    }
+
+    void finishWindow() {
+        int64_t power[RESP_BINS];
+        int64_t band = 0;
+        uint8_t peak = 0;
+        for (uint8_t i = 0; i < RESP_BINS; i++) {
+            int64_t a = s1[i];
+            int64_t b = s2[i];
+            power[i] = a * a + b * b - ((coeff[i] * a * b) >> RESP_COEFF_SHIFT);
+            if (power[i] < 0) power[i] = 0;
+            band += power[i];
+            if (power[i] > power[peak]) peak = i;
+        }
+        int64_t around = power[peak];
+        if (peak > 0) around += power[peak - 1];
+        if (peak + 1 < RESP_BINS) around += power[peak + 1];
+        uint8_t confidence = band > 0 ? (uint8_t)(around * 100 / band) : 0;
+
+        result.meanLoad = (uint16_t)(loadSum / ((uint32_t)WINDOW * DECIMATION));
+        result.confidence = confidence;
+        result.breathsPerMin = (confidence >= RESP_MIN_CONFIDENCE && motionSeconds <= RESP_MAX_MOTION_SECONDS)
+                                   ? (uint8_t)(RESP_MIN_BPM + peak) : 0;
+        result.zeroCrossings = zeroCrossings;
+        result.motionSeconds = motionSeconds;
+        result.motionEnergy = motionEnergy;
+        result.droppedSamples = 0;
+        resetWindow();
+    }
+
+    void resetWindow() {
+        for (uint8_t i = 0; i < RESP_BINS; i++) {
+            s1[i] = 0;
+            s2[i] = 0;
+        }
+        windowSamples = 0;
+        zeroCrossings = 0;
+        motionSeconds = 0;
+        motionEnergy = 0;
+        loadSum = 0;
+    }
+
+    int16_t coeff[RESP_BINS];
+    int32_t s1[RESP_BINS];
+    int32_t s2[RESP_BINS];
+    RespirationMinute result = {};
+    int32_t driftQ8 = 0;
+    uint32_t decimatedSum = 0;
+    uint32_t loadSum = 0;
+    uint32_t secondEnergy = 0;
+    uint32_t motionEnergy = 0;
+    uint16_t decimatedCount = 0;
+    uint16_t windowSamples = 0;
+    uint16_t secondSamples = 0;
+    uint16_t zeroCrossings = 0;
+    uint16_t previous = 0;
+    uint8_t motionSeconds = 0;
+    int8_t sign = 0;
+    bool hasPrevious = false;
+    bool driftSeeded = false;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef CURALINK_RTC_RECORD_H
+#define CURALINK_RTC_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "firmwareProfile.h"
+
+#if FEATURE_PERSISTENCE
+#include <Arduino.h>
+#endif
+
+// A small record in the ESP8266's RTC user memory (512 bytes, written in
+// 4-byte words). It survives WDT, exception and software resets and deep
+// sleep, and takes microseconds to write with no flash wear; power loss
+// clears it, so readers check a CRC. RtcRecord<false> keeps nothing.
+
+#define RTC_RECORD_BLOCK    32      // First word used; words 0-31 belong to the core's OTA update
+
+template<bool Persistent>
+struct RtcRecord {
+    static bool load(void*, size_t) { return false; }
+    static bool save(const void*, size_t) { return true; }
+};
+
+#if FEATURE_PERSISTENCE
+template<>
+struct RtcRecord<true> {
+    static bool load(void* data, size_t size) {
+        return ESP.rtcUserMemoryRead(RTC_RECORD_BLOCK, (uint32_t*)data, size);
+    }
+
+    static bool save(const void* data, size_t size) {
+        return ESP.rtcUserMemoryWrite(RTC_RECORD_BLOCK, (uint32_t*)data, size);
+    }
+};
+#endif
+
+#endif
@@ -0,0 +1,1162 @@
+#ifndef CURALINK_RTDB_CLIENT_H
+#define CURALINK_RTDB_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "flashText.h"
+
+// Firebase Realtime Database over its REST API, for the little the firmware
+// needs: email/password sign-in and ID token refresh, PUT/PATCH/GET of small
+// nodes and an optional event stream on one node. Replaces Firebase_ESP_Client,
+// whose token manager, FirebaseJson trees, error queue and String copies were
+// the largest user of flash and heap on the controller and the main source of
+// heap fragmentation.
+// - No heap. The tokens, a RTDB_CHUNK_BYTES output chunk and one header line
+//   are fixed members. A request body is written by the caller's body function
+//   twice, once to count Content-Length and once to the socket, so no body is
+//   ever held in memory; the function must write the same bytes both times.
+// - Responses are parsed as they arrive (HttpResponse): status, the headers
+//   that matter, plain, chunked or close-delimited bodies. Body bytes go to a
+//   JsonScan that copies only the top-level fields asked for.
+// - One keep-alive connection. Sign-in and refresh go to Google's token hosts
+//   on the same Client, so the database connection is reopened after them
+//   (about once an hour).
+// - The ID token is refreshed RTDB_REFRESH_MARGIN_MS before it expires, and
+//   on a 401, after which the request is sent once more.
+// Client is BearSSL::WiFiClientSecure on the device; tools/rtdb_client_check.cpp
+// runs the same client against a local HTTP stand-in over POSIX sockets. It
+// needs connect(host, port), connected(), available(), read(uint8_t*, size_t),
+// write(const uint8_t*, size_t) and stop().
+
+#define RTDB_PORT                   443
+#define RTDB_AUTH_HOST              "identitytoolkit.googleapis.com"
+#define RTDB_TOKEN_HOST             "securetoken.googleapis.com"
+#define RTDB_HOST_BYTES             80      // Database or stream server host name
+#define RTDB_ID_TOKEN_BYTES         1280    // Firebase ID tokens (JWT) run 900-1200 characters
+#define RTDB_REFRESH_TOKEN_BYTES    384
+#define RTDB_CHUNK_BYTES            512     // Output is flushed to the socket in chunks of this
+#define RTDB_READ_BYTES             128     // Read from the socket at a time (stack)
+#define RTDB_LINE_BYTES             96      // Response status/header line kept for matching
+#define RTDB_KEY_BYTES              32      // Longest JSON key matched by JsonScan
+#define RTDB_ERROR_BYTES            48
+#define RTDB_RESPONSE_TIMEOUT_MS    10000
+#define RTDB_REFRESH_MARGIN_MS      300000UL    // Refresh the ID token 5 min before it expires
+#define RTDB_AUTH_RETRY_MS          10000   // After a failed sign-in or refresh
+#define RTDB_STREAM_IDLE_MS         75000   // The server sends keep-alive every 30 s
+#define RTDB_STREAM_RETRY_MS        5000
+
+#ifdef ARDUINO
+#include <Arduino.h>
+inline uint32_t rtdbMillis() { return millis(); }
+inline void rtdbYield() { yield(); }
+#else
+#include <chrono>
+#include <thread>
+inline uint32_t rtdbMillis() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+inline void rtdbYield() { std::this_thread::yield(); }
+#endif
+
+//  ID                          Reason
+#define RTDB_ERRORS(X) \
+    X(RTDB_OK,                  "ok") \
+    X(RTDB_NOT_SIGNED_IN,       "not signed in") \
+    X(RTDB_CONNECT_FAILED,      "connection failed") \
+    X(RTDB_WRITE_FAILED,        "send failed") \
+    X(RTDB_TIMEOUT,             "response timeout") \
+    X(RTDB_CLOSED,              "connection closed") \
+    X(RTDB_BAD_RESPONSE,        "malformed response") \
+    X(RTDB_BODY_CHANGED,        "body length changed") \
+    X(RTDB_HTTP_STATUS,         "HTTP")
+
+#define RTDB_ERROR_ENUM_ENTRY(id, text) id,
+enum RtdbError : uint8_t {
+    RTDB_ERRORS(RTDB_ERROR_ENUM_ENTRY)
+    RTDB_ERROR_COUNT
+};
+#undef RTDB_ERROR_ENUM_ENTRY
+
+#define RTDB_ERROR_STRING_ENTRY(id, text) static const char id##_STRING[] PROGMEM = text;
+RTDB_ERRORS(RTDB_ERROR_STRING_ENTRY)
+#undef RTDB_ERROR_STRING_ENTRY
+
+#define RTDB_ERROR_TABLE_ENTRY(id, text) id##_STRING,
+static const char* const RTDB_ERROR_STRINGS[RTDB_ERROR_COUNT] PROGMEM = { RTDB_ERRORS(RTDB_ERROR_TABLE_ENTRY) };
+#undef RTDB_ERROR_TABLE_ENTRY
+
+struct RtdbStats {
+    uint32_t requests;          // Sent, retries included
+    uint32_t failed;
+    uint32_t connects;          // Connections (TLS sessions) opened
+    uint32_t signIns;
+    uint32_t refreshes;
+    uint32_t bytesOut;
+    uint32_t bytesIn;
+    uint32_t lastMs;            // Request to end of response, successful requests
+    uint32_t maxMs;
+    uint32_t succeeded;
+    uint64_t totalMs;
+};
+
+// Where and as whom. Host names must outlive the client.
+struct RtdbConfig {
+    const char* databaseUrl;    // https://<db>.firebasedatabase.app or just the host
+    const char* apiKey;
+    const char* email;
+    const char* password;
+    const char* authHost;       // RTDB_AUTH_HOST, or a local stand-in
+    const char* tokenHost;      // RTDB_TOKEN_HOST
+    uint16_t port;              // RTDB_PORT
+};
+
+// Writes through a fixed chunk to flush(); with no flush function it only
+// counts, which gives Content-Length.
+class RtdbOut {
+public:
+    typedef bool (*FlushFn)(void* context, const char* data, size_t length);
+
+    RtdbOut(char* chunk, size_t size, FlushFn flush, void* context)
+        : buffer(chunk), capacity(size), flushFn(flush), flushContext(context) {}
+
+    void write(const char* data, size_t length) {
+        total += length;
+        if (flushFn == nullptr) {
+            return;
+        }
+        while (length > 0 && ok) {
+            size_t n = capacity - used;
+            if (n > length) n = length;
+            memcpy(buffer + used, data, n);
+            used += n;
+            data += n;
+            length -= n;
+            if (used == capacity) {
+                flush();
+            }
+        }
+    }
+
+    void print(const char* text) { write(text, strlen(text)); }
+
+    void print(int64_t value) {
+        char digits[21];
+        char* end = digits + sizeof(digits);
+        char* p = end;
+        uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+        do {
+            *--p = (char)('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude > 0);
+        if (value < 0) {
+            write("-", 1);
+        }
+        write(p, end - p);
+    }
+
+    // Sends what is left in the chunk; false if any write failed
+    bool finish() {
+        if (flushFn != nullptr && used > 0 && ok) {
+            flush();
+        }
+        return ok;
+    }
+
+    size_t length() const { return total; }
+
+private:
+    void flush() {
+        ok = flushFn(flushContext, buffer, used);
+        used = 0;
+    }
+
+    char* buffer;
+    size_t capacity;
+    FlushFn flushFn;
+    void* flushContext;
+    size_t used = 0;
+    size_t total = 0;
+    bool ok = true;
+};
+
+// JSON object writer over RtdbOut. Keys are written as given; string values
+// are escaped.
+class JsonOut {
+public:
+    explicit JsonOut(RtdbOut& output) : out(output) {}
+
+    void beginObject(const char* key = nullptr) {
+        if (key != nullptr) {
+            name(key);
+        }
+        out.write("{", 1);
+        if (depth < 15) depth++;
+        members &= ~(1u << depth);
+    }
+
+    void endObject() {
+        out.write("}", 1);
+        if (depth > 0) depth--;
+    }
+
+    void add(const char* key, const char* text) {
+        name(key);
+        out.write("\"", 1);
+        for (const char* p = text; *p != '\0'; p++) {
+            char c = *p;
+            if (c == '"' || c == '\\') {
+                char escaped[2] = {'\\', c};
+                out.write(escaped, 2);
+            } else if ((uint8_t)c < 0x20) {
+                out.write(" ", 1);  // Control characters never belong in our values
+            } else {
+                out.write(&c, 1);
+            }
+        }
+        out.write("\"", 1);
+    }
+
+    void add(const char* key, bool value) {
+        name(key);
+        out.print(value ? "true" : "false");
+    }
+
+    void add(const char* key, int32_t value) {
+        name(key);
+        out.print((int64_t)value);
+    }
+
+    void add(const char* key, int64_t value) {
+        name(key);
+        out.print(value);
+    }
+
+    // A value already in JSON form, e.g. a formatted decimal
+    void addRaw(const char* key, const char* json) {
+        name(key);
+        out.print(json);
+    }
+
+private:
+    void name(const char* key) {
+        if (members & (1u << depth)) {
+            out.write(",", 1);
+        }
+        members |= 1u << depth;
+        out.write("\"", 1);
+        out.print(key);
+        out.write("\":", 2);
+    }
+
+    RtdbOut& out;
+    uint8_t depth = 0;
+    uint16_t members = 0;       // Bit per depth: the object already has a member
+};
+
+// One top-level field JsonScan copies out. value is always terminated; found
+// is set once the whole value arrived. Objects and arrays are skipped and
+// leave value empty.
+struct JsonField {
+    const char* name;
+    char* value;
+    uint16_t size;
+    bool found;
+};
+
+// Incremental scanner for the top level of a JSON object: bytes may arrive
+// in any split, and only the named fields are kept.
+class JsonScan {
+public:
+    JsonScan(JsonField* fieldList, uint8_t count) : fields(fieldList), fieldCount(count) {
+        for (uint8_t i = 0; i < count; i++) {
+            fields[i].found = false;
+            if (fields[i].size > 0) fields[i].value[0] = '\0';
+        }
+    }
+
+    void feed(const char* data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            step(data[i]);
+        }
+    }
+
+    static void sink(void* context, const char* data, size_t length) {
+        static_cast<JsonScan*>(context)->feed(data, length);
+    }
+
+    // The top-level object closed
+    bool complete() const { return state == SCAN_DONE; }
+
+private:
+    enum ScanState : uint8_t {
+        SCAN_START,         // Before the opening brace
+        SCAN_KEY,           // Expecting a key or the closing brace
+        SCAN_KEY_TEXT,
+        SCAN_COLON,
+        SCAN_VALUE,         // Expecting a value
+        SCAN_STRING,
+        SCAN_SCALAR,
+        SCAN_NESTED,        // Skipping an object or array
+        SCAN_NEXT,          // After a value: comma or closing brace
+        SCAN_DONE,
+        SCAN_INVALID
+    };
+
+    void step(char c) {
+        bool space = c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        switch (state) {
+        case SCAN_START:
+            if (c == '{') state = SCAN_KEY;
+            else if (!space) state = SCAN_INVALID;  // null, or not an object
+            break;
+        case SCAN_KEY:
+            if (c == '"') {
+                state = SCAN_KEY_TEXT;
+                keyLength = 0;
+                escape = false;
+            } else if (c == '}') {
+                state = SCAN_DONE;
+            } else if (!space && c != ',') {
+                state = SCAN_INVALID;
+            }
+            break;
+        case SCAN_KEY_TEXT:
+            if (escape) {
+                escape = false;
+                appendKey(c);
+            } else if (c == '\\') {
+                escape = true;
+            } else if (c == '"') {
+                key[keyLength < RTDB_KEY_BYTES ? keyLength : RTDB_KEY_BYTES - 1] = '\0';
+                current = keyLength < RTDB_KEY_BYTES ? find(key) : nullptr;
+                state = SCAN_COLON;
+            } else {
+                appendKey(c);
+            }
+            break;
+        case SCAN_COLON:
+            if (c == ':') state = SCAN_VALUE;
+            else if (!space) state = SCAN_INVALID;
+            break;
+        case SCAN_VALUE:
+            valueLength = 0;
+            if (c == '"') {
+                state = SCAN_STRING;
+                escape = false;
+                unicode = 0;
+            } else if (c == '{' || c == '[') {
+                state = SCAN_NESTED;
+                nested = 1;
+                inString = false;
+                escape = false;
+            } else if (!space) {
+                state = SCAN_SCALAR;
+                append(c);
+            }
+            break;
+        case SCAN_STRING:
+            if (unicode > 0) {
+                if (--unicode == 0) append('?');  // \uXXXX: not in any value we read
+            } else if (escape) {
+                escape = false;
+                if (c == 'u') unicode = 4;
+                else append(c == 'n' ? '\n' : c == 't' ? '\t' : c == 'r' ? '\r' : c);
+            } else if (c == '\\') {
+                escape = true;
+            } else if (c == '"') {
+                finishValue();
+                state = SCAN_NEXT;
+            } else {
+                append(c);
+            }
+            break;
+        case SCAN_SCALAR:
+            if (c == ',' || c == '}' || space) {
+                finishValue();
+                state = c == ',' ? SCAN_KEY : c == '}' ? SCAN_DONE : SCAN_NEXT;
+            } else {
+                append(c);
+            }
+            break;
+        case SCAN_NESTED:
+            if (inString) {
+                if (escape) escape = false;
+                else if (c == '\\') escape = true;
+                else if (c == '"') inString = false;
+            } else if (c == '"') {
+                inString = true;
+            } else if (c == '{' || c == '[') {
+                nested++;
+            } else if ((c == '}' || c == ']') && --nested == 0) {
+                finishValue();
+                state = SCAN_NEXT;
+            }
+            break;
+        case SCAN_NEXT:
+            if (c == ',') state = SCAN_KEY;
+            else if (c == '}') state = SCAN_DONE;
+            else if (!space) state = SCAN_INVALID;
+            break;
+        case SCAN_DONE:
+        case SCAN_INVALID:
+            break;
+        }
+    }
+
+    void appendKey(char c) {
+        if (keyLength < RTDB_KEY_BYTES) key[keyLength] = c;
+        if (keyLength < UINT8_MAX) keyLength++;
+    }
+
+    void append(char c) {
+        if (current != nullptr && valueLength + 1 < current->size) {
+            current->value[valueLength++] = c;
+        }
+    }
+
+    void finishValue() {
+        if (current != nullptr) {
+            if (current->size > 0) current->value[valueLength] = '\0';
+            current->found = true;
+            current = nullptr;
+        }
+    }
+
+    JsonField* find(const char* name) {
+        for (uint8_t i = 0; i < fieldCount; i++) {
+            if (strcmp(fields[i].name, name) == 0) return &fields[i];
+        }
+        return nullptr;
+    }
+
+    JsonField* fields;
+    uint8_t fieldCount;
+    JsonField* current = nullptr;
+    ScanState state = SCAN_START;
+    char key[RTDB_KEY_BYTES];
+    uint8_t keyLength = 0;
+    uint16_t valueLength = 0;
+    uint8_t nested = 0;
+    uint8_t unicode = 0;
+    bool escape = false;
+    bool inString = false;
+};
+
+// HTTP/1.1 response, parsed as bytes arrive. Body bytes go to the sink given
+// to begin(); a 1xx interim response is skipped.
+class HttpResponse {
+public:
+    typedef void (*BodyFn)(void* context, const char* data, size_t length);
+
+    void begin(BodyFn body, void* context) {
+        bodyFn = body;
+        bodyContext = context;
+        state = HTTP_STATUS;
+        code = 0;
+        lineLength = 0;
+        contentLength = -1;
+        chunked = false;
+        closeAfter = false;
+        location[0] = '\0';
+    }
+
+    // Consumes up to length bytes; stops at the end of the response
+    size_t feed(const char* data, size_t length) {
+        size_t i = 0;
+        while (i < length && state != HTTP_DONE && state != HTTP_ERROR) {
+            if (state == HTTP_BODY || state == HTTP_CHUNK_DATA || state == HTTP_UNTIL_CLOSE) {
+                size_t n = length - i;
+                if (state != HTTP_UNTIL_CLOSE && n > (size_t)remaining) n = (size_t)remaining;
+                if (bodyFn != nullptr) bodyFn(bodyContext, data + i, n);
+                i += n;
+                if (state != HTTP_UNTIL_CLOSE) {
+                    remaining -= n;
+                    if (remaining == 0) state = state == HTTP_BODY ? HTTP_DONE : HTTP_CHUNK_END;
+                }
+                continue;
+            }
+            char c = data[i++];
+            if (c == '\r') {
+                continue;
+            }
+            if (c != '\n') {
+                if (lineLength + 1 < RTDB_LINE_BYTES) line[lineLength++] = c;
+                else overlong = true;
+                continue;
+            }
+            line[lineLength] = '\0';
+            endLine();
+            lineLength = 0;
+            overlong = false;
+        }
+        return i;
+    }
+
+    // The connection closed: ends a body without length, fails anything else
+    void closed() {
+        if (state == HTTP_UNTIL_CLOSE) state = HTTP_DONE;
+        else if (state != HTTP_DONE) state = HTTP_ERROR;
+    }
+
+    bool done() const { return state == HTTP_DONE; }
+    bool failed() const { return state == HTTP_ERROR; }
+    bool inBody() const { return state >= HTTP_BODY && state <= HTTP_UNTIL_CLOSE; }
+    int status() const { return code; }
+    bool connectionClose() const { return closeAfter; }
+    const char* redirectHost() const { return location; }   // Host of a 3xx Location, or empty
+
+private:
+    enum HttpState : uint8_t {
+        HTTP_STATUS,
+        HTTP_HEADER,
+        HTTP_BODY,
+        HTTP_CHUNK_SIZE,
+        HTTP_CHUNK_DATA,
+        HTTP_CHUNK_END,
+        HTTP_UNTIL_CLOSE,
+        HTTP_TRAILER,
+        HTTP_DONE,
+        HTTP_ERROR
+    };
+
+    void endLine() {
+        switch (state) {
+        case HTTP_STATUS:
+            if (strncmp(line, "HTTP/1.", 7) != 0 || lineLength < 12) {
+                state = HTTP_ERROR;
+                return;
+            }
+            code = atoi(line + 9);
+            state = HTTP_HEADER;
+            break;
+        case HTTP_HEADER:
+            if (lineLength == 0) {
+                endHeaders();
+            } else if (header("content-length:")) {
+                contentLength = strtol(value, nullptr, 10);
+            } else if (header("transfer-encoding:")) {
+                chunked = strstr(value, "chunked") != nullptr;
+            } else if (header("connection:")) {
+                closeAfter = strncasecmpAscii(value, "close", 5) == 0;
+            } else if (header("location:")) {
+                // https://host/path: keep the host
+                const char* host = strstr(value, "://");
+                host = host != nullptr ? host + 3 : value;
+                size_t n = strcspn(host, "/:");
+                if (n >= RTDB_HOST_BYTES || (overlong && host + n == line + lineLength)) n = 0;
+                memcpy(location, host, n);
+                location[n] = '\0';
+            }
+            break;
+        case HTTP_CHUNK_SIZE: {
+            char* end;
+            remaining = strtol(line, &end, 16);
+            if (end == line || remaining < 0) {
+                state = HTTP_ERROR;
+            } else {
+                state = remaining == 0 ? HTTP_TRAILER : HTTP_CHUNK_DATA;
+            }
+            break;
+        }
+        case HTTP_CHUNK_END:
+            state = lineLength == 0 ? HTTP_CHUNK_SIZE : HTTP_ERROR;
+            break;
+        case HTTP_TRAILER:
+            if (lineLength == 0) state = HTTP_DONE;
+            break;
+        default:
+            break;
+        }
+    }
+
+    void endHeaders() {
+        if (code >= 100 && code < 200) {
+            begin(bodyFn, bodyContext);     // Interim response, the real one follows
+        } else if (code == 204 || code == 304) {
+            state = HTTP_DONE;
+        } else if (chunked) {
+            state = HTTP_CHUNK_SIZE;
+        } else if (contentLength >= 0) {
+            remaining = contentLength;
+            state = remaining == 0 ? HTTP_DONE : HTTP_BODY;
+        } else {
+            state = HTTP_UNTIL_CLOSE;
+        }
+    }
+
+    // Case-insensitive header name match; value points past it and leading spaces
+    bool header(const char* name) {
+        size_t n = strlen(name);
+        if (lineLength < n || strncasecmpAscii(line, name, n) != 0) {
+            return false;
+        }
+        value = line + n;
+        while (*value == ' ' || *value == '\t') value++;
+        return true;
+    }
+
+    static int strncasecmpAscii(const char* a, const char* b, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            char x = a[i] >= 'A' && a[i] <= 'Z' ? a[i] + 32 : a[i];
+            char y = b[i] >= 'A' && b[i] <= 'Z' ? b[i] + 32 : b[i];
+            if (x != y || x == '\0') return x - y;
+        }
+        return 0;
+    }
+
+    BodyFn bodyFn = nullptr;
+    void* bodyContext = nullptr;
+    HttpState state = HTTP_STATUS;
+    int code = 0;
+    char line[RTDB_LINE_BYTES];
+    uint8_t lineLength = 0;
+    bool overlong = false;
+    const char* value = nullptr;
+    long contentLength = -1;
+    long remaining = 0;
+    bool chunked = false;
+    bool closeAfter = false;
+    char location[RTDB_HOST_BYTES];
+};
+
+template<typename Client>
+class RtdbClient {
+public:
+    explicit RtdbClient(Client& transport) : client(transport) {}
+
+    void begin(const RtdbConfig& settings) {
+        config = settings;
+        const char* host = strstr(settings.databaseUrl, "://");
+        host = host != nullptr ? host + 3 : settings.databaseUrl;
+        size_t n = strcspn(host, "/");
+        if (n >= RTDB_HOST_BYTES) n = RTDB_HOST_BYTES - 1;
+        memcpy(databaseHost, host, n);
+        databaseHost[n] = '\0';
+        signedIn = false;
+        authFailedMs = 0;
+        authFailed = false;
+    }
+
+    const char* host() const { return databaseHost; }
+
+    // Signed in with a token that is not about to expire. Signs in or
+    // refreshes when due, at most every RTDB_AUTH_RETRY_MS after a failure;
+    // this blocks for the exchange.
+    bool ready() {
+        uint32_t now = rtdbMillis();
+        bool due = !signedIn || (int32_t)(now - refreshAtMs) >= 0;
+        if (!due) {
+            return true;
+        }
+        if (authFailed && now - authFailedMs < RTDB_AUTH_RETRY_MS) {
+            return signedIn && (int32_t)(now - expiresAtMs) < 0;
+        }
+        bool ok = (signedIn && refresh()) || signIn();
+        authFailed = !ok;
+        authFailedMs = now;
+        return ok;
+    }
+
+    // Email/password sign-in for a new ID and refresh token
+    bool signIn() {
+        stats.signIns++;
+        char expires[12];
+        JsonField fields[] = {
+            {"idToken", idToken, sizeof(idToken), false},
+            {"refreshToken", refreshToken, sizeof(refreshToken), false},
+            {"expiresIn", expires, sizeof(expires), false}
+        };
+        JsonScan scan(fields, 3);
+        const char* target[] = {"/v1/accounts:signInWithPassword?key=", config.apiKey, nullptr, nullptr};
+        signedIn = false;
+        bool ok = request("POST", config.authHost, target, "application/json", [this](RtdbOut& out) {
+            JsonOut json(out);
+            json.beginObject();
+            json.add("email", config.email);
+            json.add("password", config.password);
+            json.add("returnSecureToken", true);
+            json.endObject();
+        }, &scan, true);
+        return ok && acceptToken(fields, expires);
+    }
+
+    // New ID token from the refresh token
+    bool refresh() {
+        stats.refreshes++;
+        // The body is read from the refresh token while the response
+        // overwrites it (and the scan clears it), so it is copied first
+        char previous[RTDB_REFRESH_TOKEN_BYTES];
+        memcpy(previous, refreshToken, sizeof(previous));
+        char expires[12];
+        JsonField fields[] = {
+            {"id_token", idToken, sizeof(idToken), false},
+            {"refresh_token", refreshToken, sizeof(refreshToken), false},
+            {"expires_in", expires, sizeof(expires), false}
+        };
+        JsonScan scan(fields, 3);
+        const char* target[] = {"/v1/token?key=", config.apiKey, nullptr, nullptr};
+        signedIn = false;
+        bool ok = request("POST", config.tokenHost, target, "application/x-www-form-urlencoded",
+                          [&previous](RtdbOut& out) {
+            out.print("grant_type=refresh_token&refresh_token=");
+            out.print(previous);
+        }, &scan, true);
+        return ok && acceptToken(fields, expires);
+    }
+
+    // Replace the node at path (e.g. "/beds/bed1") with the body's object.
+    // Writes ask for no content back (print=silent), so the reply is a bare
+    // 204 instead of an echo of the body. waitForReply false: the reply is
+    // read before the next request, so the caller does not wait a round trip.
+    template<typename Body>
+    bool put(const char* path, Body body, bool waitForReply = true) {
+        return database("PUT", path, jsonBody(body), nullptr, waitForReply);
+    }
+
+    // Update the children named in the body's object, leaving the others
+    template<typename Body>
+    bool patch(const char* path, Body body) {
+        return database("PATCH", path, jsonBody(body), nullptr, true);
+    }
+
+    // Read the node at path into scan. False on failure; a missing node
+    // succeeds with nothing found.
+    bool get(const char* path, JsonScan& scan) {
+        return database("GET", path, nullptr, &scan, true);
+    }
+
+    // Close the connection (WiFi going down, gateway standing down)
+    void end() {
+        client.stop();
+        connectedHost = nullptr;
+        replyPending = false;
+    }
+
+    RtdbError error() const { return lastError; }
+    int httpStatus() const { return lastStatus; }
+
+    // Last failure as text, e.g. "HTTP 401 Permission denied"; valid until the next request
+    const char* errorReason() {
+        size_t n = copyFlashText(reason, sizeof(reason),
+                                 (const char*)pgm_read_ptr(&RTDB_ERROR_STRINGS[lastError]));
+        if (lastError == RTDB_HTTP_STATUS) {
+            snprintf(reason + n, sizeof(reason) - n, serverError[0] != '\0' ? " %d %s" : " %d", lastStatus,
+                     serverError);
+        }
+        return reason;
+    }
+
+    const RtdbStats& statistics() const { return stats; }
+    // Stream sessions share the token
+    const char* token() const { return idToken; }
+    const RtdbConfig& settings() const { return config; }
+
+private:
+    // Database request with auth; retried once on a stale connection or an
+    // expired token
+    template<typename Body>
+    bool database(const char* method, const char* path, Body body, JsonScan* scan, bool wait) {
+        if (!ready()) {
+            fail(RTDB_NOT_SIGNED_IN);
+            return false;
+        }
+        for (uint8_t attempt = 0; attempt < 2; attempt++) {
+            const char* target[] = {path, ".json?auth=", idToken, scan == nullptr ? "&print=silent" : nullptr};
+            bool ok = request(method, databaseHost, target, "application/json", body, scan, wait);
+            if (ok || lastError != RTDB_HTTP_STATUS || lastStatus != 401 || attempt > 0) {
+                return ok;
+            }
+            // Token revoked or expired early: renew it and send again
+            if (!refresh() && !signIn()) {
+                authFailed = true;
+                authFailedMs = rtdbMillis();
+                return false;
+            }
+        }
+        return false;
+    }
+
+    // One request on the keep-alive connection; target is up to four pieces
+    // of the request target. A reused connection that fails before the
+    // response starts is reopened and the request sent once more.
+    template<typename Body>
+    bool request(const char* method, const char* host, const char* const* target, const char* contentType,
+                 Body body, JsonScan* scan, bool wait) {
+        if (replyPending) {
+            replyPending = false;
+            uint32_t started = rtdbMillis();
+            response.begin(nullptr, nullptr);
+            if (!readResponse(started) || response.connectionClose()) {
+                end();
+            }
+        }
+        for (uint8_t attempt = 0; attempt < 2; attempt++) {
+            bool reused = connectedHost == host && client.connected();
+            uint32_t started = rtdbMillis();
+            stats.requests++;
+            if (!reused) {
+                client.stop();
+                connectedHost = nullptr;
+                if (!client.connect(host, config.port)) {
+                    return fail(RTDB_CONNECT_FAILED);
+                }
+                connectedHost = host;
+                stats.connects++;
+            }
+            if (!send(method, host, target, contentType, body)) {
+                end();
+                if (reused && lastError == RTDB_WRITE_FAILED) continue;
+                return false;
+            }
+            if (!wait) {
+                replyPending = true;
+                record(started);
+                return true;
+            }
+            userScan = scan;
+            errorScanning = false;
+            serverError[0] = '\0';
+            response.begin(onBody, this);
+            bool complete = readResponse(started);
+            if (!complete || response.connectionClose()) {
+                end();
+            }
+            if (!complete) {
+                if (reused && lastError == RTDB_CLOSED && !response.inBody() && response.status() == 0) continue;
+                return false;
+            }
+            lastStatus = response.status();
+            if (lastStatus < 200 || lastStatus >= 300) {
+                return fail(RTDB_HTTP_STATUS);
+            }
+            lastError = RTDB_OK;
+            record(started);
+            return true;
+        }
+        return false;
+    }
+
+    template<typename Body>
+    bool send(const char* method, const char* host, const char* const* target, const char* contentType,
+              Body body) {
+        RtdbOut counter(nullptr, 0, nullptr, nullptr);
+        writeBody(counter, body);
+        size_t length = counter.length();
+
+        RtdbOut out(chunk, sizeof(chunk), flushToClient, this);
+        out.print(method);
+        out.write(" ", 1);
+        for (uint8_t i = 0; i < 4; i++) {
+            if (target[i] != nullptr) out.print(target[i]);
+        }
+        out.print(" HTTP/1.1\r\nHost: ");
+        out.print(host);
+        if (length > 0) {
+            out.print("\r\nContent-Type: ");
+            out.print(contentType);
+        }
+        if (length > 0 || strcmp(method, "GET") != 0) {
+            out.print("\r\nContent-Length: ");
+            out.print((int64_t)length);
+        }
+        out.print("\r\n\r\n");
+        size_t head = out.length();
+        writeBody(out, body);
+        if (!out.finish()) {
+            return fail(RTDB_WRITE_FAILED);
+        }
+        if (out.length() - head != length) {
+            return fail(RTDB_BODY_CHANGED);     // The server would wait for bytes that never come
+        }
+        return true;
+    }
+
+    // body(JsonOut&) as a writer of the raw body
+    template<typename Body>
+    static auto jsonBody(Body& body) {
+        return [&body](RtdbOut& out) {
+            JsonOut json(out);
+            body(json);
+        };
+    }
+
+    template<typename Body>
+    static void writeBody(RtdbOut& out, Body body) { body(out); }
+    static void writeBody(RtdbOut&, decltype(nullptr)) {}
+
+    bool readResponse(uint32_t started) {
+        char buffer[RTDB_READ_BYTES];
+        while (!response.done()) {
+            int available = client.available();
+            if (available > 0) {
+                int n = client.read((uint8_t*)buffer, available < (int)sizeof(buffer) ? available : sizeof(buffer));
+                if (n > 0) {
+                    stats.bytesIn += n;
+                    response.feed(buffer, n);
+                    if (response.failed()) return fail(RTDB_BAD_RESPONSE);
+                    continue;
+                }
+            }
+            if (!client.connected()) {
+                response.closed();
+                if (response.failed()) return fail(RTDB_CLOSED);
+                break;
+            }
+            if (rtdbMillis() - started > RTDB_RESPONSE_TIMEOUT_MS) {
+                return fail(RTDB_TIMEOUT);
+            }
+            rtdbYield();
+        }
+        return true;
+    }
+
+    bool acceptToken(const JsonField* fields, const char* expires) {
+        if (!fields[0].found || !fields[1].found || !fields[2].found || idToken[0] == '\0') {
+            return fail(RTDB_BAD_RESPONSE);
+        }
+        uint32_t lifetimeMs = (uint32_t)strtoul(expires, nullptr, 10) * 1000UL;
+        uint32_t margin = RTDB_REFRESH_MARGIN_MS < lifetimeMs / 2 ? RTDB_REFRESH_MARGIN_MS : lifetimeMs / 2;
+        uint32_t now = rtdbMillis();
+        expiresAtMs = now + lifetimeMs;
+        refreshAtMs = now + lifetimeMs - margin;
+        signedIn = true;
+        return true;
+    }
+
+    bool fail(RtdbError error) {
+        lastError = error;
+        stats.failed++;
+        return false;
+    }
+
+    void record(uint32_t started) {
+        uint32_t elapsed = rtdbMillis() - started;
+        stats.lastMs = elapsed;
+        if (elapsed > stats.maxMs) stats.maxMs = elapsed;
+        stats.totalMs += elapsed;
+        stats.succeeded++;
+    }
+
+    static bool flushToClient(void* context, const char* data, size_t length) {
+        RtdbClient* self = static_cast<RtdbClient*>(context);
+        self->stats.bytesOut += length;
+        return self->client.write((const uint8_t*)data, length) == length;
+    }
+
+    // 2xx bodies go to the caller's scan; others are searched for "error"
+    static void onBody(void* context, const char* data, size_t length) {
+        RtdbClient* self = static_cast<RtdbClient*>(context);
+        int status = self->response.status();
+        if (status >= 200 && status < 300) {
+            if (self->userScan != nullptr) self->userScan->feed(data, length);
+            return;
+        }
+        if (!self->errorScanning) {
+            self->errorScanning = true;
+            self->errorField = {"error", self->serverError, sizeof(self->serverError), false};
+            self->errorScan = JsonScan(&self->errorField, 1);
+        }
+        self->errorScan.feed(data, length);
+    }
+
+    Client& client;
+    RtdbConfig config = {};
+    char databaseHost[RTDB_HOST_BYTES] = {};
+    const char* connectedHost = nullptr;
+    char idToken[RTDB_ID_TOKEN_BYTES] = {};
+    char refreshToken[RTDB_REFRESH_TOKEN_BYTES] = {};
+    bool signedIn = false;
+    bool authFailed = false;
+    uint32_t authFailedMs = 0;
+    uint32_t refreshAtMs = 0;
+    uint32_t expiresAtMs = 0;
+    bool replyPending = false;
+
+    char chunk[RTDB_CHUNK_BYTES];
+    HttpResponse response;
+    JsonScan* userScan = nullptr;
+    JsonField errorField = {"error", nullptr, 0, false};
+    JsonScan errorScan{&errorField, 0};
+    bool errorScanning = false;
+    char serverError[RTDB_ERROR_BYTES] = {};
+
+    RtdbError lastError = RTDB_OK;
+    int lastStatus = 0;
+    char reason[RTDB_ERROR_BYTES + 24];
+    RtdbStats stats = {};
+};
+
+// Server-sent events on one node (GET with Accept: text/event-stream) on a
+// connection of its own, so the session's requests are not held up behind
+// it. It only tells that the node changed; the caller then reads the node
+// with get(), so there is one parser for its fields. Firebase may send the
+// stream to another server with a 307, which is followed. A stream that is
+// cancelled, loses its token or hears nothing for RTDB_STREAM_IDLE_MS is
+// reopened, at most every RTDB_STREAM_RETRY_MS; opening blocks for the
+// connection.
+template<typename Client, typename SessionClient>
+class RtdbStream {
+public:
+    RtdbStream(Client& transport, RtdbClient<SessionClient>& owner) : client(transport), session(owner) {}
+
+    // path (e.g. "/bedConfig/bed1") must outlive the stream
+    void begin(const char* nodePath) {
+        path = nodePath;
+        close();
+        retryAtMs = rtdbMillis();
+    }
+
+    // True when the node changed since the last call, and once after every
+    // (re)connect, since the first event carries the whole node
+    bool poll() {
+        uint32_t now = rtdbMillis();
+        if (!open) {
+            if (path == nullptr || (int32_t)(now - retryAtMs) < 0) {
+                return false;
+            }
+            retryAtMs = now + RTDB_STREAM_RETRY_MS;
+            if (!connect()) {
+                redirect[0] = '\0';     // Start again from the database host
+                return false;
+            }
+            now = rtdbMillis();         // After the handshake, or the idle check below sees lastByteMs ahead
+        }
+
+        char buffer[RTDB_READ_BYTES];
+        int available;
+        while ((available = client.available()) > 0) {
+            int n = client.read((uint8_t*)buffer, available < (int)sizeof(buffer) ? available : sizeof(buffer));
+            if (n <= 0) break;
+            lastByteMs = now;
+            response.feed(buffer, n);
+        }
+        if (!client.connected() && !response.done()) {
+            response.closed();
+        }
+
+        if (response.done() || response.failed() || reopen) {
+            int status = response.status();
+            close();
+            if (status >= 300 && status < 400 && response.redirectHost()[0] != '\0') {
+                memcpy(redirect, response.redirectHost(), sizeof(redirect));
+                retryAtMs = now;        // Follow at once
+            }
+        } else if (response.status() != 0 && response.status() != 200 && response.inBody()) {
+            close();                    // 401 and the like: the session renews its token first
+        } else if (now - lastByteMs > RTDB_STREAM_IDLE_MS) {
+            close();
+        }
+
+        bool result = changed;
+        changed = false;
+        return result;
+    }
+
+    void end() {
+        close();
+        path = nullptr;
+    }
+
+    bool live() const { return open && response.status() == 200; }
+    uint32_t events() const { return eventCount; }
+    uint32_t connects() const { return connectCount; }
+
+private:
+    bool connect() {
+        if (!session.ready()) {
+            return false;
+        }
+        const char* host = redirect[0] != '\0' ? redirect : session.host();
+        if (!client.connect(host, session.settings().port)) {
+            return false;
+        }
+        connectCount++;
+        char chunk[RTDB_READ_BYTES];
+        RtdbOut out(chunk, sizeof(chunk), flushToClient, this);
+        out.print("GET ");
+        out.print(path);
+        out.print(".json?auth=");
+        out.print(session.token());
+        out.print(" HTTP/1.1\r\nHost: ");
+        out.print(host);
+        out.print("\r\nAccept: text/event-stream\r\n\r\n");
+        if (!out.finish()) {
+            client.stop();
+            return false;
+        }
+        open = true;
+        reopen = false;
+        lineLength = 0;
+        eventName[0] = '\0';
+        lastByteMs = rtdbMillis();
+        response.begin(onBody, this);
+        return true;
+    }
+
+    void close() {
+        client.stop();
+        open = false;
+    }
+
+    static bool flushToClient(void* context, const char* data, size_t length) {
+        return static_cast<RtdbStream*>(context)->client.write((const uint8_t*)data, length) == length;
+    }
+
+    // text/event-stream: "event: put" / "data: {...}" lines, a blank line ends an event
+    static void onBody(void* context, const char* data, size_t length) {
+        RtdbStream* self = static_cast<RtdbStream*>(context);
+        if (self->response.status() != 200) {
+            return;
+        }
+        for (size_t i = 0; i < length; i++) {
+            char c = data[i];
+            if (c == '\r') continue;
+            if (c != '\n') {
+                if (self->lineLength + 1u < sizeof(self->line)) self->line[self->lineLength++] = c;
+                continue;
+            }
+            self->line[self->lineLength] = '\0';
+            self->endLine();
+            self->lineLength = 0;
+        }
+    }
+
+    void endLine() {
+        if (lineLength == 0) {
+            if (strcmp(eventName, "put") == 0 || strcmp(eventName, "patch") == 0) {
+                changed = true;
+                eventCount++;
+            } else if (strcmp(eventName, "cancel") == 0 || strcmp(eventName, "auth_revoked") == 0) {
+                reopen = true;
+            }
+            eventName[0] = '\0';
+        } else if (strncmp(line, "event:", 6) == 0) {
+            const char* name = line + 6;
+            while (*name == ' ') name++;
+            strncpy(eventName, name, sizeof(eventName) - 1);
+            eventName[sizeof(eventName) - 1] = '\0';
+        }
+    }
+
+    Client& client;
+    RtdbClient<SessionClient>& session;
+    const char* path = nullptr;
+    char redirect[RTDB_HOST_BYTES] = {};
+    HttpResponse response;
+    char line[24];
+    uint8_t lineLength = 0;
+    char eventName[16] = {};
+    bool open = false;
+    bool reopen = false;
+    bool changed = false;
+    uint32_t retryAtMs = 0;
+    uint32_t lastByteMs = 0;
+    uint32_t eventCount = 0;
+    uint32_t connectCount = 0;
+};
+
+#endif
@@ -0,0 +1,237 @@
+#ifndef CURALINK_SENSOR_HEALTH_H
+#define CURALINK_SENSOR_HEALTH_H
+
+#include <stdint.h>
+
+// Per-sensor health from constant-memory streaming statistics.
+// Every reading updates a repeat counter and the sums of the current window;
+// every HEALTH_WINDOW readings the window is closed and the sensor's faults
+// re-evaluated:
+//   stuck:   the same reading HEALTH_STUCK_READINGS times in a row (frozen
+//            register, an ADC that stopped converting). Not at the rails,
+//            where a healthy sensor can sit (an empty FSR reads 0)
+//   flat:    the window's variance collapsed below HEALTH_FLAT_FLOOR_Q4 on a
+//            sensor whose quiet noise has been HEALTH_FLAT_RATIO times that
+//            (a disconnected input that used to show ADC noise). Windows
+//            touching a rail are left out, as for stuck
+//   range:   more than HEALTH_RATE_LIMIT permille of readings outside what a
+//            bed can produce (smoothed over windows), or HEALTH_BAD_RUN in a row
+//   errors:  more than HEALTH_RATE_LIMIT permille of reads failed (I2C, PEC,
+//            MLX error flag), or HEALTH_BAD_RUN in a row
+// Faults are raised at once and cleared after HEALTH_CLEAR_WINDOWS clean
+// windows in a row. BedController picks the occupancy inputs from them.
+
+#define HEALTH_WINDOW           32          // Readings per window (16 s at 500 ms)
+#define HEALTH_STUCK_READINGS   240         // 2 min at 500 ms
+#define HEALTH_FLAT_FLOOR_Q4    2           // Window variance, 1/16 units
+#define HEALTH_FLAT_RATIO       16
+#define HEALTH_FLAT_WINDOWS     4           // Collapsed windows in a row
+#define HEALTH_QUIET_WINDOWS    8           // Windows before the quiet noise is trusted
+#define HEALTH_RATE_LIMIT       200         // Permille
+#define HEALTH_BAD_RUN          8           // Failed or out-of-range reads in a row (4 s)
+#define HEALTH_RATE_SHIFT       2           // Rates follow 1/4 of each window
+#define HEALTH_CLEAR_WINDOWS    4
+#define HEALTH_TEMP_MIN_CENTI   500         // Plausible object temperature at a bed, 5..50 °C
+#define HEALTH_TEMP_MAX_CENTI   5000
+
+enum SensorFault : uint8_t {
+    FAULT_STUCK = 0x01,
+    FAULT_FLAT = 0x02,
+    FAULT_RANGE = 0x04,
+    FAULT_ERRORS = 0x08
+};
+
+// Which readings decide occupancy; sent with the record
+enum OccupancyMode : uint8_t {
+    OCCUPANCY_BOTH,             // Weight and body heat
+    OCCUPANCY_WEIGHT_ONLY,      // Temperature sensor faulted
+    OCCUPANCY_HEAT_ONLY,        // FSR faulted
+    OCCUPANCY_HELD              // Both faulted: the last decision is kept
+};
+
+// Uplink byte: FSR faults in the low nibble, temperature in the high one
+inline uint8_t packSensorFaults(uint8_t fsrFaults, uint8_t tempFaults) {
+    return (uint8_t)((fsrFaults & 0x0F) | (tempFaults & 0x0F) << 4);
+}
+
+inline OccupancyMode occupancyModeFor(uint8_t sensorFaults) {
+    bool fsrOk = (sensorFaults & 0x0F) == 0;
+    bool tempOk = (sensorFaults & 0xF0) == 0;
+    if (fsrOk && tempOk) return OCCUPANCY_BOTH;
+    if (fsrOk) return OCCUPANCY_WEIGHT_ONLY;
+    if (tempOk) return OCCUPANCY_HEAT_ONLY;
+    return OCCUPANCY_HELD;
+}
+
+// What is plausible for one sensor. Readings at or beyond the rails do not
+// count as stuck.
+struct SensorLimits {
+    int32_t low;
+    int32_t high;
+    int32_t railLow;
+    int32_t railHigh;
+};
+
+// MLX90614 object temperature, centi-degrees; it has no rails
+static const SensorLimits HEALTH_TEMP_LIMITS = {HEALTH_TEMP_MIN_CENTI, HEALTH_TEMP_MAX_CENTI, INT32_MIN, INT32_MAX};
+
+class SensorHealth {
+public:
+    // One read; ok is false when it failed (value is then ignored).
+    // True when faults() changed.
+    bool reading(int32_t value, bool ok, const SensorLimits& limits) {
+        uint8_t before = faultBits;
+        windowReads++;
+        if (!ok) {
+            windowErrors++;
+            raiseOnRun(errorRun, FAULT_ERRORS);
+            rangeRun = 0;
+        } else {
+            errorRun = 0;
+            if (value < limits.low || value > limits.high) {
+                windowOutOfRange++;
+                raiseOnRun(rangeRun, FAULT_RANGE);
+            } else {
+                rangeRun = 0;
+            }
+            if (primed && value == lastValue) {
+                if (repeats < UINT16_MAX) repeats++;
+            } else {
+                repeats = 1;
+                lastValue = value;
+            }
+            primed = true;
+            bool offRail = value > limits.railLow && value < limits.railHigh;
+            if (offRail) {
+                windowOffRail++;
+            }
+            if (repeats >= HEALTH_STUCK_READINGS && offRail) {
+                windowFaults |= FAULT_STUCK;
+                faultBits |= FAULT_STUCK;
+            }
+            // Moments around the window's first reading keep the sums small
+            if (windowValid == 0) {
+                origin = value;
+            }
+            int32_t d = value - origin;
+            sum += d;
+            sumSq += (int64_t)d * d;
+            windowValid++;
+        }
+        if (windowReads >= HEALTH_WINDOW) {
+            closeWindow();
+        }
+        return faultBits != before;
+    }
+
+    // A failure seen outside the stream (the sensor did not answer at boot)
+    void fail(uint8_t fault) {
+        faultBits |= fault;
+        windowFaults |= fault;
+        cleanWindows = 0;
+        if (fault & FAULT_ERRORS) errorRate = 1000;
+    }
+
+    bool healthy() const { return faultBits == 0; }
+    uint8_t faults() const { return faultBits; }
+    uint16_t errorPermille() const { return (uint16_t)errorRate; }
+    uint16_t rangePermille() const { return (uint16_t)rangeRate; }
+    uint16_t repeatRun() const { return repeats; }
+    int32_t lastVarianceQ4() const { return varianceQ4; }
+    int32_t quietVarianceQ4() const { return quietQ4; }
+    uint32_t windows() const { return windowCount; }
+
+private:
+    void raiseOnRun(uint8_t& run, uint8_t fault) {
+        if (run < UINT8_MAX) run++;
+        if (run >= HEALTH_BAD_RUN) {
+            windowFaults |= fault;
+            faultBits |= fault;
+        }
+    }
+
+    void closeWindow() {
+        uint8_t seen = windowFaults;
+
+        rate(errorRate, windowErrors);
+        rate(rangeRate, windowOutOfRange);
+        if (errorRate > HEALTH_RATE_LIMIT) seen |= FAULT_ERRORS;
+        if (rangeRate > HEALTH_RATE_LIMIT) seen |= FAULT_RANGE;
+
+        if (windowValid >= HEALTH_WINDOW / 2) {
+            int64_t n = windowValid;
+            varianceQ4 = (int32_t)(((n * sumSq - (int64_t)sum * sum) << 4) / (n * n));
+            if (varianceQ4 < HEALTH_FLAT_FLOOR_Q4) {
+                // Collapsed, or a sensor that never showed noise
+                bool noisy = windowOffRail == windowValid && quietWindows >= HEALTH_QUIET_WINDOWS &&
+                             quietQ4 >= HEALTH_FLAT_FLOOR_Q4 * HEALTH_FLAT_RATIO;
+                flatRun = noisy && flatRun < UINT8_MAX ? flatRun + 1 : 0;
+            } else {
+                flatRun = 0;
+                // Quiet noise: falls quickly, rises slowly, ignores activity
+                if (quietWindows == 0) {
+                    quietQ4 = varianceQ4;
+                } else if (varianceQ4 < quietQ4) {
+                    quietQ4 -= (quietQ4 - varianceQ4) >> 1;
+                } else if (varianceQ4 <= quietQ4 * 4) {
+                    quietQ4 += (varianceQ4 - quietQ4) >> 4;
+                }
+                if (quietWindows < UINT16_MAX) quietWindows++;
+            }
+            if (flatRun >= HEALTH_FLAT_WINDOWS) seen |= FAULT_FLAT;
+        }
+
+        if (seen == 0) {
+            if (cleanWindows < UINT8_MAX) cleanWindows++;
+            if (cleanWindows >= HEALTH_CLEAR_WINDOWS) faultBits = 0;
+        } else {
+            cleanWindows = 0;
+            faultBits |= seen;
+        }
+
+        windowCount++;
+        windowFaults = 0;
+        windowReads = 0;
+        windowErrors = 0;
+        windowOutOfRange = 0;
+        windowValid = 0;
+        windowOffRail = 0;
+        sum = 0;
+        sumSq = 0;
+    }
+
+    // Permille, exponentially smoothed across windows
+    void rate(int32_t& value, uint8_t count) {
+        int32_t window = (int32_t)count * 1000 / windowReads;
+        value += (window - value) >> HEALTH_RATE_SHIFT;
+    }
+
+    // Current window
+    uint8_t windowReads = 0;
+    uint8_t windowErrors = 0;
+    uint8_t windowOutOfRange = 0;
+    uint8_t windowValid = 0;
+    uint8_t windowOffRail = 0;
+    uint8_t windowFaults = 0;
+    int32_t origin = 0;
+    int32_t sum = 0;
+    int64_t sumSq = 0;
+
+    // Across windows
+    int32_t lastValue = 0;
+    bool primed = false;
+    uint16_t repeats = 0;
+    uint8_t errorRun = 0;
+    uint8_t rangeRun = 0;
+    int32_t errorRate = 0;
+    int32_t rangeRate = 0;
+    int32_t varianceQ4 = 0;
+    int32_t quietQ4 = 0;
+    uint16_t quietWindows = 0;
+    uint8_t flatRun = 0;
+    uint8_t cleanWindows = 0;
+    uint8_t faultBits = 0;
+    uint32_t windowCount = 0;
+};
+
+#endif
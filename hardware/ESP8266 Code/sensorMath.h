@@ -0,0 +1,72 @@
+#ifndef CURALINK_SENSOR_MATH_H
+#define CURALINK_SENSOR_MATH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Integer sensor math for the sampling path.
+// The ESP8266 has no FPU, so every float add/compare is a soft-float library
+// call. Temperatures are kept as centi-degrees Celsius (int16_t, 0.01 °C)
+// from the MLX90614 register to the occupancy decision; floats only appear
+// where a value is presented (uplink JSON).
+
+typedef int16_t centi_t;                // 0.01 °C
+
+#define CENTI_INVALID       INT16_MIN
+#define CENTI_MIN_VALID     (-2000)     // Plausible sensor range, -20..100 °C
+#define CENTI_MAX_VALID     10000
+
+#define FSR_INVALID         (-1)        // Failed ADC conversion
+#define FSR_FULL_SCALE      1023
+
+// MLX90614 RAM registers hold temperature in 0.02 K, bit 15 flags an error
+#define MLX_I2C_ADDRESS     0x5A
+#define MLX_REG_AMBIENT     0x06
+#define MLX_REG_OBJECT      0x07
+
+// Utility function for median calculation
+template<typename T>
+inline T medianOf3(T a, T b, T c) {
+    if (a > b) {
+        if (b > c) return b;        // a > b > c
+        if (a > c) return c;        // a > c > b
+        return a;                   // c > a > b
+    } else {
+        if (a > c) return a;        // b > a > c
+        if (b > c) return c;        // b > c > a
+        return b;                   // c > b > a
+    }
+}
+
+// Raw register value to centi-degrees: raw * 2 - 27315 (0.02 K -> 0.01 °C)
+inline centi_t mlxRawToCenti(uint16_t raw) {
+    if (raw & 0x8000) {
+        return CENTI_INVALID;
+    }
+    int32_t centi = (int32_t)raw * 2 - 27315;
+    if (centi < CENTI_MIN_VALID || centi > CENTI_MAX_VALID) {
+        return CENTI_INVALID;
+    }
+    return (centi_t)centi;
+}
+
+inline uint16_t centiDelta(centi_t a, centi_t b) {
+    int32_t d = (int32_t)a - b;
+    return (uint16_t)(d < 0 ? -d : d);
+}
+
+// Presentation edge only
+inline float centiToFloat(centi_t centi) {
+    return centi / 100.0f;
+}
+
+// "33.45" / "-1.05" without going through printf's float support
+inline void formatCenti(char* buffer, size_t size, centi_t centi) {
+    int32_t value = centi;
+    const char* sign = value < 0 ? "-" : "";
+    if (value < 0) value = -value;
+    snprintf(buffer, size, "%s%ld.%02ld", sign, (long)(value / 100), (long)(value % 100));
+}
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef CURALINK_STAFF_CARD_READER_H
+#define CURALINK_STAFF_CARD_READER_H
+
+#include <SPI.h>
+#include <MFRC522.h>
+
+// RC522 staff card reader policy. StaffCardReader<false> never sees a card,
+// so the card-verified workflow steps are compiled out with it.
+
+template<bool Enabled>
+class StaffCardReader {
+public:
+    StaffCardReader(uint8_t, uint8_t) {}
+    byte begin() { return 0; }
+    bool readCard(String&) { return false; }
+};
+
+template<>
+class StaffCardReader<true> {
+public:
+    StaffCardReader(uint8_t ssPin, uint8_t rstPin) : mfrc522(ssPin, rstPin) {}
+
+    // Returns the reader firmware version, 0x00/0xFF means it is not responding
+    byte begin() {
+        SPI.begin();
+        delay(100);  // Give SPI time to stabilize
+        mfrc522.PCD_Init();
+        delay(100);  // Give RFID time to stabilize
+        return mfrc522.PCD_ReadRegister(mfrc522.VersionReg);
+    }
+
+    // Poll for a new card; on success uid holds the upper-case hex UID
+    bool readCard(String& uid) {
+        if (!mfrc522.PICC_IsNewCardPresent()) {
+            return false;
+        }
+        delay(10);  // Small delay for stability
+        if (!mfrc522.PICC_ReadCardSerial()) {
+            return false;
+        }
+
+        uid = "";
+        for (byte i = 0; i < mfrc522.uid.size; i++) {
+            if (mfrc522.uid.uidByte[i] < 0x10) uid += "0";
+            uid += String(mfrc522.uid.uidByte[i], HEX);
+        }
+        uid.toUpperCase();
+
+        mfrc522.PICC_HaltA();
+        mfrc522.PCD_StopCrypto1();
+        return true;
+    }
+
+private:
+    MFRC522 mfrc522;
+};
+
+#endif
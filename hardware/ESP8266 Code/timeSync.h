@@ -0,0 +1,99 @@
+#ifndef CURALINK_TIME_SYNC_H
+#define CURALINK_TIME_SYNC_H
+
+#include <stdint.h>
+
+// Timekeeping for bed events.
+// Every event is stamped with the monotonic device clock (millis() extended to
+// 64 bits) and converted to UTC through an offset learned from NTP/server
+// samples. Between samples the offset is corrected for crystal drift, so
+// stamps stay accurate to well under a second for hours without a new sample.
+
+#define TIME_MIN_DRIFT_SPAN_MS   60000UL            // Min spacing between samples to estimate drift
+#define TIME_MAX_DRIFT_PPB       500000L            // Clamp drift to +/-500 ppm (crystal spec)
+#define TIME_HOLDOVER_MS         (6UL * 3600000UL)  // Stamps count as synced this long after a sample
+
+// Event timestamp: monotonic device time plus the UTC estimate at that instant
+struct EventStamp {
+    uint64_t monoMs;   // Milliseconds since boot, never wraps
+    int64_t utcMs;     // Estimated UTC epoch milliseconds, 0 if never synced
+    bool synced;       // True if utcMs is backed by a recent sample
+};
+
+class TimeSync {
+public:
+    // Extend a 32-bit millis() reading to 64 bits. Must be called at least
+    // once per 49 days (the loop does it on every iteration).
+    uint64_t monotonicMs(uint32_t nowMs) {
+        if (nowMs < lastRawMs) {
+            wraps++;
+        }
+        lastRawMs = nowMs;
+        return ((uint64_t)wraps << 32) | nowMs;
+    }
+
+    // Convert an earlier millis() reading (less than 49 days old) to monotonic time
+    // without advancing the clock
+    uint64_t toMonotonic(uint32_t rawMs) const {
+        uint64_t current = ((uint64_t)wraps << 32) | lastRawMs;
+        return current - (uint32_t)(lastRawMs - rawMs);
+    }
+
+    // Record a reference sample: UTC time utcMs observed at monotonic time monoMs
+    void addSample(uint64_t monoMs, int64_t utcMs) {
+        int64_t offset = utcMs - (int64_t)monoMs;
+
+        // Samples closer together than the minimum span only refresh the offset
+        if (sampleCount > 0 && monoMs - sampleMonoMs >= TIME_MIN_DRIFT_SPAN_MS) {
+            // Drift is the offset change per elapsed device time, in parts per billion
+            int64_t span = (int64_t)(monoMs - sampleMonoMs);
+            int64_t measured = (offset - sampleOffsetMs) * 1000000000LL / span;
+            if (measured > TIME_MAX_DRIFT_PPB) measured = TIME_MAX_DRIFT_PPB;
+            if (measured < -TIME_MAX_DRIFT_PPB) measured = -TIME_MAX_DRIFT_PPB;
+
+            // Smooth out network jitter in individual samples
+            driftPpb = driftValid ? (int32_t)((3 * (int64_t)driftPpb + measured) / 4)
+                                  : (int32_t)measured;
+            driftValid = true;
+        }
+
+        sampleMonoMs = monoMs;
+        sampleOffsetMs = offset;
+        if (sampleCount < UINT16_MAX) sampleCount++;
+    }
+
+    // Convert a monotonic time to an event stamp. Works for any time since boot,
+    // so events recorded before the first sync can be re-stamped once synced.
+    EventStamp stamp(uint64_t monoMs) const {
+        EventStamp s;
+        s.monoMs = monoMs;
+        if (sampleCount == 0) {
+            s.utcMs = 0;
+            s.synced = false;
+            return s;
+        }
+
+        int64_t elapsed = (int64_t)(monoMs - sampleMonoMs);
+        int64_t correction = elapsed * driftPpb / 1000000000LL;
+        s.utcMs = (int64_t)monoMs + sampleOffsetMs + correction;
+
+        uint64_t age = monoMs > sampleMonoMs ? monoMs - sampleMonoMs : sampleMonoMs - monoMs;
+        s.synced = age <= TIME_HOLDOVER_MS;
+        return s;
+    }
+
+    bool hasSample() const { return sampleCount > 0; }
+    int32_t drift() const { return driftPpb; }
+
+private:
+    uint32_t lastRawMs = 0;
+    uint32_t wraps = 0;
+
+    uint64_t sampleMonoMs = 0;    // Monotonic time of the latest sample
+    int64_t sampleOffsetMs = 0;   // UTC - monotonic at the latest sample
+    int32_t driftPpb = 0;         // Smoothed clock drift, parts per billion
+    bool driftValid = false;
+    uint16_t sampleCount = 0;
+};
+
+#endif
@@ -0,0 +1,276 @@
+#ifndef CURALINK_UPLINK_BATCH_H
+#define CURALINK_UPLINK_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "flashText.h"
+#include "bedState.h"
+
+// Bed records of this controller on their way to Firebase, batched into one
+// multi-path update (BedUplink::sendBatch). Workflow steps, sensor changes
+// and the heartbeat tick used to write at once each, so a burst of
+// transitions became several TLS writes a few hundred ms apart. Records now
+// wait here, one per bed:
+// - A newer record of a bed replaces its waiting one while the status is the
+//   same (only the latest is read), keeping the classes and queue times of
+//   both. A different status sends the waiting record first, so the
+//   dashboard still sees every status a bed passes through.
+// - Each record has a latency budget from its class (UPLINK_CLASSES). The
+//   batch goes out when one is spent (URGENT has none: discharge and exit
+//   risk go at once), when every bed of a multi-bed controller is waiting
+//   (size; a single bed only merges over time), or when nothing was added for
+//   UPLINK_BATCH_IDLE_MS (the burst is over). Heartbeats alone only go out on
+//   their budget: one waits for the next tick's and they go out as one. A
+//   batch that is due is sent before the next record is added, so the tick
+//   that spends the budget starts the next pair rather than joining this one:
+//   with the default 2 s tick a quiet controller writes every 4 s, well inside
+//   the dashboard's 10 s freshness window (src/utils/hardwareBed.js).
+// Most of the saving is that heartbeat pairing, the same a 4 s uplink tick
+// would give. Workflow bursts are not merged: cleaning, verify, staff ID and
+// back to normal still cost a write each, because the dashboard builds bed
+// history from successive /beds snapshots.
+// - A failed update keeps the records, newer ones still merge in, and it is
+//   tried again after UPLINK_BATCH_RETRY_MS.
+// - Per class: records, requests saved against one request per record, and
+//   the latency the wait added.
+// There is no Arduino dependency; tools/uplink_batch_sim.cpp replays ward
+// workflows through it. Record needs `BedStatus status` and `bool
+// exitChanged`; Send is bool(const Record* records, uint8_t count).
+
+#ifndef UPLINK_BATCH_IDLE_MS
+#define UPLINK_BATCH_IDLE_MS    300     // Quiet time that ends a burst
+#endif
+#define UPLINK_BATCH_RETRY_MS   1000    // After a failed update
+
+//  ID                          Name            Budget (ms)
+#define UPLINK_CLASSES(X) \
+    X(UPLINK_URGENT,            "urgent",       0)      /* Discharge, exit risk raised or cleared */ \
+    X(UPLINK_WORKFLOW,          "workflow",     1000)   /* A workflow step published (BedIo::publish) */ \
+    X(UPLINK_CHANGE,            "change",       1500)   /* Sensor values or occupancy moved */ \
+    X(UPLINK_HEARTBEAT,         "heartbeat",    4000)   /* Nothing changed, the record is due */
+
+#define UPLINK_ENUM_ENTRY(id, name, budget) id,
+enum UplinkClass : uint8_t { UPLINK_CLASSES(UPLINK_ENUM_ENTRY) UPLINK_CLASS_COUNT };
+#undef UPLINK_ENUM_ENTRY
+
+#define UPLINK_NAME_STRING(id, name, budget) static const char id##_NAME[] PROGMEM = name;
+UPLINK_CLASSES(UPLINK_NAME_STRING)
+#undef UPLINK_NAME_STRING
+#define UPLINK_NAME_ENTRY(id, name, budget) id##_NAME,
+static const char* const UPLINK_CLASS_NAMES[] PROGMEM = { UPLINK_CLASSES(UPLINK_NAME_ENTRY) };
+#undef UPLINK_NAME_ENTRY
+#define UPLINK_BUDGET_ENTRY(id, name, budget) budget,
+static const uint16_t UPLINK_BUDGETS_MS[] PROGMEM = { UPLINK_CLASSES(UPLINK_BUDGET_ENTRY) };
+#undef UPLINK_BUDGET_ENTRY
+
+#define UPLINK_NAME_SIZE        12
+
+inline const char* uplinkClassName(UplinkClass uplinkClass, char (&out)[UPLINK_NAME_SIZE]) {
+    copyFlashText(out, sizeof(out), (const char*)pgm_read_ptr(&UPLINK_CLASS_NAMES[uplinkClass]));
+    return out;
+}
+
+inline uint16_t uplinkBudgetMs(UplinkClass uplinkClass) {
+    return pgm_read_word(&UPLINK_BUDGETS_MS[uplinkClass]);
+}
+
+// Why a batch went out
+enum UplinkFlush : uint8_t {
+    UPLINK_FLUSH_BUDGET,    // A record's budget was spent
+    UPLINK_FLUSH_FULL,      // Every bed had a record waiting
+    UPLINK_FLUSH_IDLE,      // Nothing added for UPLINK_BATCH_IDLE_MS
+    UPLINK_FLUSH_STATUS,    // A bed's status changed under a waiting record
+    UPLINK_FLUSH_COUNT
+};
+
+struct UplinkClassStats {
+    uint32_t records;       // Records queued
+    uint32_t saved;         // Requests saved: merged into a waiting record, or carried by another bed's request
+    uint32_t sent;          // Waits ended by an update (a bed's merged records of one class count once)
+    uint32_t addedMsTotal;  // First record of the class queued to its update starting, over sent
+    uint32_t addedMsMax;
+};
+
+struct UplinkBatchStats {
+    UplinkClassStats classes[UPLINK_CLASS_COUNT];
+    uint32_t requests;      // Updates tried
+    uint32_t failed;
+    uint32_t reasons[UPLINK_FLUSH_COUNT];
+    uint32_t overwritten;   // Statuses replaced unsent because the update before them failed
+    uint8_t maxRecords;     // Most beds in one update
+};
+
+template<typename Record, uint8_t Beds>
+class UplinkBatch {
+    static_assert(Beds >= 1 && Beds <= 16, "Waiting beds are found by a linear scan");
+
+public:
+    // Queue a bed's record. What is due goes out first, so a heartbeat whose
+    // budget ran out on this tick does not take the new one along; so does a
+    // waiting record of that bed with another status.
+    template<typename Send>
+    void add(uint8_t slot, const Record& record, UplinkClass uplinkClass, uint32_t nowMs, Send& send) {
+        service(nowMs, send);
+        batchStats.classes[uplinkClass].records++;
+        lastAddMs = nowMs;
+        int8_t i = find(slot);
+        if (i >= 0 && records[i].status != record.status) {
+            if (retryWaiting(nowMs) || !flush(nowMs, UPLINK_FLUSH_STATUS, send)) {
+                batchStats.overwritten++;
+            }
+            i = find(slot);
+        }
+        if (i < 0) {
+            i = count++;
+            records[i] = record;
+            waits[i].slot = slot;
+            waits[i].first = uplinkClass;
+            waits[i].classes = 0;
+        } else {
+            batchStats.classes[uplinkClass].saved++;
+            bool alert = records[i].exitChanged;
+            records[i] = record;
+            records[i].exitChanged |= alert;
+        }
+        Wait& wait = waits[i];
+        if (!(wait.classes & (1 << uplinkClass))) {
+            wait.classes |= 1 << uplinkClass;
+            wait.queuedMs[uplinkClass] = nowMs;
+        }
+    }
+
+    // Send the waiting records when a trigger says so; true when nothing is left waiting
+    template<typename Send>
+    bool service(uint32_t nowMs, Send& send) {
+        if (count == 0) {
+            return true;
+        }
+        if (retryWaiting(nowMs)) {
+            return false;
+        }
+        UplinkFlush reason;
+        if (budgetSpent(nowMs)) {
+            reason = UPLINK_FLUSH_BUDGET;
+        } else if (heartbeatsOnly()) {
+            return false;
+        } else if (Beds > 1 && count == Beds) {
+            reason = UPLINK_FLUSH_FULL;
+        } else if (nowMs - lastAddMs >= UPLINK_BATCH_IDLE_MS) {
+            reason = UPLINK_FLUSH_IDLE;
+        } else {
+            return false;
+        }
+        return flush(nowMs, reason, send);
+    }
+
+    // Drop what is waiting (the unit hands its records to the mesh)
+    void clear() {
+        count = 0;
+        retrying = false;
+    }
+
+    uint8_t waiting() const { return count; }
+    const UplinkBatchStats& stats() const { return batchStats; }
+    void resetStats() { batchStats = UplinkBatchStats(); }
+
+    // Time until the oldest waiting record's budget is spent (0 when it is)
+    uint32_t dueInMs(uint32_t nowMs) const {
+        uint32_t least = UINT32_MAX;
+        for (uint8_t i = 0; i < count; i++) {
+            for (uint8_t c = 0; c < UPLINK_CLASS_COUNT; c++) {
+                if (!(waits[i].classes & (1 << c))) {
+                    continue;
+                }
+                uint32_t waited = nowMs - waits[i].queuedMs[c];
+                uint32_t budget = uplinkBudgetMs((UplinkClass)c);
+                uint32_t left = waited >= budget ? 0 : budget - waited;
+                if (left < least) {
+                    least = left;
+                }
+            }
+        }
+        return least;
+    }
+
+private:
+    // Queue times of the record waiting at the same index
+    struct Wait {
+        uint8_t slot;
+        UplinkClass first;                      // Class of the record that opened the slot
+        uint8_t classes;                        // Bit per class merged into the record
+        uint32_t queuedMs[UPLINK_CLASS_COUNT];  // First record of each class
+    };
+
+    // A failed update is not tried again before UPLINK_BATCH_RETRY_MS
+    bool retryWaiting(uint32_t nowMs) const {
+        return retrying && nowMs - failedMs < UPLINK_BATCH_RETRY_MS;
+    }
+
+    int8_t find(uint8_t slot) const {
+        for (uint8_t i = 0; i < count; i++) {
+            if (waits[i].slot == slot) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    bool budgetSpent(uint32_t nowMs) const {
+        return dueInMs(nowMs) == 0;
+    }
+
+    bool heartbeatsOnly() const {
+        for (uint8_t i = 0; i < count; i++) {
+            if (waits[i].classes & ~(1 << UPLINK_HEARTBEAT)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<typename Send>
+    bool flush(uint32_t nowMs, UplinkFlush reason, Send& send) {
+        batchStats.requests++;
+        if (!send(records, count)) {
+            batchStats.failed++;
+            retrying = true;
+            failedMs = nowMs;
+            return false;
+        }
+        retrying = false;
+        batchStats.reasons[reason]++;
+        if (count > batchStats.maxRecords) {
+            batchStats.maxRecords = count;
+        }
+        for (uint8_t i = 0; i < count && i < Beds; i++) {
+            // The request pays for the first bed; the others rode along
+            if (i > 0) {
+                batchStats.classes[waits[i].first].saved++;
+            }
+            for (uint8_t c = 0; c < UPLINK_CLASS_COUNT; c++) {
+                if (!(waits[i].classes & (1 << c))) {
+                    continue;
+                }
+                UplinkClassStats& classStats = batchStats.classes[c];
+                uint32_t added = nowMs - waits[i].queuedMs[c];
+                classStats.sent++;
+                classStats.addedMsTotal += added;
+                if (added > classStats.addedMsMax) {
+                    classStats.addedMsMax = added;
+                }
+            }
+        }
+        count = 0;
+        return true;
+    }
+
+    Record records[Beds];
+    Wait waits[Beds];
+    uint8_t count = 0;
+    uint32_t lastAddMs = 0;
+    bool retrying = false;
+    uint32_t failedMs = 0;
+    UplinkBatchStats batchStats = {};
+};
+
+#endif
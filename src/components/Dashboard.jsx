@@ -1,5 +1,5 @@
 import React, { useState, useEffect } from 'react';
-import { ref, onValue, set } from 'firebase/database';
+import { ref, onValue, set, query, orderByKey, limitToLast } from 'firebase/database';
 import { database, isDemoMode } from '../firebase/config';
 import { seedDummyData, addHistoryEntry } from '../firebase/seedData';
 import BedCard from './BedCard';
@@ -8,6 +8,7 @@ import PredictionBox from './PredictionBox';
 import { getEffectiveBedStatus, checkAndUnassignExpiredPatients } from '../firebase/bedManager';
 import { BED_STATUSES, WARD_TYPES, WARD_COLORS } from '../utils/bedUtils';
 import { subscribeToHardwareBed, HARDWARE_BED_ID } from '../utils/hardwareBed';
+import { HISTORY_WINDOW } from '../services/HistoryService';
 
 // Filter options ordered by priority: All → Available → Occupied → Unoccupied → Cleaning
 const filterOptions = [
@@ -276,8 +277,9 @@ const Dashboard = ({ onNavigate, sharedHistory, setSharedHistory }) => {
           setLoading(false);
         });
 
-        // Listen for history data
-        const historyRef = ref(database, 'bedHistory');
+        // Listen to the latest history entries only; older ones come from the
+        // backend history store (HistoryService, Full History page)
+        const historyRef = query(ref(database, 'bedHistory'), orderByKey(), limitToLast(HISTORY_WINDOW));
         const unsubscribeHistory = onValue(historyRef, (snapshot) => {
           if (!mounted) return;
           console.log('History data update received');
@@ -1,11 +1,55 @@
-import React, { useEffect } from 'react';
+import React, { useEffect, useState } from 'react';
 import HistoryTable from './HistoryTable';
+import { HistoryService } from '../services/HistoryService';
+
+// Entries fetched from the backend history store
+const FULL_HISTORY_LIMIT = 5000;
+
+// Events per action in a list of entries
+const countActions = entries =>
+  entries.reduce((counts, item) => {
+    counts[item.action] = (counts[item.action] || 0) + 1;
+    return counts;
+  }, {});
+
+const FullHistory = ({ onBack, historyData: liveHistory }) => {
+  // The dashboard only listens to the latest entries; fetch the rest from the
+  // backend and fall back to that live window when it is not running or empty
+  const [storedHistory, setStoredHistory] = useState([]);
+  const historyData = storedHistory.length > 0 ? storedHistory : liveHistory;
+  // The table is capped at FULL_HISTORY_LIMIT entries; the totals come from
+  // the store's per-action counts over the whole history
+  const [storedCounts, setStoredCounts] = useState(null);
+  const actionCounts = storedCounts || countActions(historyData);
+  const totalChanges = Object.values(actionCounts).reduce((sum, count) => sum + count, 0);
 
-const FullHistory = ({ onBack, historyData }) => {
   // Scroll to top when component mounts
   useEffect(() => {
     window.scrollTo(0, 0);
   }, []);
+
+  useEffect(() => {
+    let mounted = true;
+    HistoryService.getHistory({ limit: FULL_HISTORY_LIMIT })
+      .then(entries => {
+        if (mounted) setStoredHistory(entries);
+      })
+      .catch(() => {
+        console.log('History store unavailable - showing live entries');
+      });
+    HistoryService.getCounts('day', 'action')
+      .then(({ counts }) => {
+        const totals = {};
+        counts.forEach(({ key, count }) => {
+          totals[key] = (totals[key] || 0) + count;
+        });
+        if (mounted && counts.length > 0) setStoredCounts(totals);
+      })
+      .catch(() => {});
+    return () => {
+      mounted = false;
+    };
+  }, []);
   return (
     <div className="min-h-screen" style={{ backgroundColor: '#e9eae0' }}>
       <div className="max-w-7xl mx-auto px-4 sm:px-6 lg:px-8 py-8">
@@ -23,7 +67,7 @@ const FullHistory = ({ onBack, historyData }) => {
               <span>Back to Dashboard</span>
             </button>
             <div className="text-sm text-gray-600">
-              Total Changes: {historyData.length}
+              Total Changes: {totalChanges}
             </div>
           </div>
           <h1 className="text-3xl font-bold text-center" style={{ color: '#01796F' }}>Complete Change History</h1>
@@ -61,24 +105,24 @@ const FullHistory = ({ onBack, historyData }) => {
         <div className="mt-8 grid grid-cols-1 md:grid-cols-4 gap-6">
           <div className="bg-white rounded-lg shadow p-6">
             <h3 className="text-sm font-medium text-gray-500">Total Changes</h3>
-            <p className="text-2xl font-bold text-gray-900">{historyData.length}</p>
+            <p className="text-2xl font-bold text-gray-900">{totalChanges}</p>
           </div>
           <div className="bg-white rounded-lg shadow p-6">
             <h3 className="text-sm font-medium text-gray-500">Status Changes</h3>
             <p className="text-2xl font-bold text-blue-600">
-              {historyData.filter(item => item.action === 'status_change').length}
+              {actionCounts.status_change || 0}
             </p>
           </div>
           <div className="bg-white rounded-lg shadow p-6">
             <h3 className="text-sm font-medium text-gray-500">Patient Assignments</h3>
             <p className="text-2xl font-bold text-green-600">
-              {historyData.filter(item => item.action === 'patient_assigned').length}
+              {actionCounts.patient_assigned || 0}
             </p>
           </div>
           <div className="bg-white rounded-lg shadow p-6">
             <h3 className="text-sm font-medium text-gray-500">Supervisor Overrides</h3>
             <p className="text-2xl font-bold text-purple-600">
-              {historyData.filter(item => item.action === 'supervisor_override').length}
+              {actionCounts.supervisor_override || 0}
             </p>
           </div>
         </div>
@@ -0,0 +1,45 @@
+// History service: bed history from the backend's native store
+const API_URL = '/api';
+
+// Entries the dashboard keeps live from the RTDB
+export const HISTORY_WINDOW = 500;
+
+export const HistoryService = {
+    // filters: bed (string or array), ward, from, to (ms), action, status, limit, order ('asc')
+    async getHistory(filters = {}) {
+        const params = new URLSearchParams();
+        Object.entries(filters).forEach(([key, value]) => {
+            if (value === undefined || value === null) return;
+            (Array.isArray(value) ? value : [value]).forEach(item => params.append(key, item));
+        });
+        try {
+            const response = await fetch(`${API_URL}/history?${params}`);
+            if (!response.ok) {
+                throw new Error('Network response was not ok');
+            }
+            const data = await response.json();
+            return data.entries;
+        } catch (error) {
+            console.error('Error fetching history:', error);
+            throw error;
+        }
+    },
+
+    // Events per bucket ('hour', 'day' or ms) and group ('status', 'action', 'bed')
+    async getCounts(bucket = 'hour', group = 'status', filters = {}) {
+        const params = new URLSearchParams({ bucket, group });
+        Object.entries(filters).forEach(([key, value]) => {
+            if (value !== undefined && value !== null) params.append(key, value);
+        });
+        try {
+            const response = await fetch(`${API_URL}/history/counts?${params}`);
+            if (!response.ok) {
+                throw new Error('Network response was not ok');
+            }
+            return await response.json();
+        } catch (error) {
+            console.error('Error fetching history counts:', error);
+            throw error;
+        }
+    }
+};
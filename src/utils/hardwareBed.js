@@ -1,4 +1,4 @@
-import { ref, onValue, off } from 'firebase/database';
+import { ref, onValue, off, update } from 'firebase/database';
 import { database } from '../firebase/config';
 
 export const HARDWARE_BED_ID = 1;
@@ -15,14 +15,51 @@ let lastLogTime = 0;
 const LOG_DEBOUNCE_TIME = 3000; // 3 second debounce to prevent rapid duplicate logs
 let lastLoggedTransition = null; // Track the exact transition to prevent duplicates
 
+// Latency trace capture - enable with localStorage.setItem('latencyTraceCapture', 'true')
+const isTraceCaptureEnabled = () => {
+  try {
+    return localStorage.getItem('latencyTraceCapture') === 'true';
+  } catch {
+    return false;
+  }
+};
+let lastCapturedTraceId = null;
+let lastCapturedAckId = null;
+
+// Records pushed straight from the controller on the LAN (lanPush.h), ahead of
+// Firebase and while the internet is down - enable with
+// localStorage.setItem('lanPushUrl', 'http://<controller-ip>:8080/events')
+const getLanPushUrl = () => {
+  try {
+    return localStorage.getItem('lanPushUrl');
+  } catch {
+    return null;
+  }
+};
+const STALE_WINDOW_MS = 60000; // A record further behind than this is from before a controller reboot
+
 export const subscribeToHardwareBed = (onUpdate) => {
   if (!database) return () => {};
 
   const bedRef = ref(database, `beds/bed${HARDWARE_BED_ID}`);
   let connectionTimeout;
+  let newestMonoMs = null;
+
+  // The same record can arrive over the LAN and from Firebase; keep the first
+  const isStaleRecord = (data) => {
+    if (typeof data.eventMonoMs !== 'number') return false;
+    if (newestMonoMs !== null && data.eventMonoMs <= newestMonoMs &&
+        newestMonoMs - data.eventMonoMs < STALE_WINDOW_MS) {
+      return true;
+    }
+    newestMonoMs = data.eventMonoMs;
+    return false;
+  };
   
   const handleBedUpdate = async (snapshot) => {
+    const receivedAt = Date.now();
     const data = snapshot.val();
+    if (data && isStaleRecord(data)) return;
     
     console.log('🔧 Hardware bed Firebase data received:', data);
     
@@ -49,8 +86,11 @@ export const subscribeToHardwareBed = (onUpdate) => {
       return;
     }
 
+    // Device event time (UTC ms) is only trustworthy once the controller has synced its clock
+    const deviceTime = getDeviceEventTime(data);
+
     // Calculate data age for debugging
-    const dataAge = Date.now() - (data.lastUpdate || 0);
+    const dataAge = Date.now() - (deviceTime || 0);
     const isDataFresh = dataAge < 10000; // 10 seconds
     
     // If we're receiving Firebase data right now and online=true, hardware is connected
@@ -61,6 +101,7 @@ export const subscribeToHardwareBed = (onUpdate) => {
       hasData: !!data,
       dataAge: Math.round(dataAge / 1000) + ' seconds',
       isDataFresh,
+      timeSynced: data.timeSynced === true,
       rawOnline: data.online,
       isHardwareOnline
     });
@@ -99,7 +140,9 @@ export const subscribeToHardwareBed = (onUpdate) => {
           newStatus: bedStatus,
           staffId: data.lastStaffId || null,
           source: isHardwareOnline ? 'hardware' : 'hardware_stale',
-          details: logDetails
+          details: logDetails,
+          deviceTime,
+          deviceMonoMs: data.eventMonoMs ?? null
         });
         
         // Update tracking variables
@@ -129,8 +172,12 @@ export const subscribeToHardwareBed = (onUpdate) => {
       hasBodyTemp: data.hasBodyTemp || false,
       hasWeight: data.hasWeight || false,
       isOccupied: data.isOccupied || false,
+      // Nonzero when a sensor is faulted; occupancyMode says which readings decided isOccupied
+      sensorFaults: data.sensorFaults || 0,
+      occupancyMode: data.occupancyMode || 0,
       online: isHardwareOnline,
-      lastUpdate: Date.now() // Always use current time since we just received this data
+      // Prefer the device event time, fall back to receive time if the controller is unsynced
+      lastUpdate: deviceTime || Date.now()
     };
 
     console.log('✅ Updating bed with sensor data:', { bedStatus, online: isHardwareOnline });
@@ -139,6 +186,10 @@ export const subscribeToHardwareBed = (onUpdate) => {
       status: bedStatus,
       sensorData
     });
+
+    if (data.trace && isTraceCaptureEnabled()) {
+      captureLatencyTrace(data, receivedAt);
+    }
     
     // Set a timeout to mark as offline if no updates received (fast response)
     connectionTimeout = setTimeout(async () => {
@@ -188,9 +239,80 @@ export const subscribeToHardwareBed = (onUpdate) => {
   };
 
   onValue(bedRef, handleBedUpdate);
+
+  let lanEvents = null;
+  const lanPushUrl = getLanPushUrl();
+  if (lanPushUrl && typeof EventSource === 'function') {
+    // EventSource reconnects by itself; the controller sends every bed's latest record on connect
+    lanEvents = new EventSource(lanPushUrl);
+    lanEvents.addEventListener('bed', (event) => {
+      try {
+        const data = JSON.parse(event.data);
+        if (data.id === HARDWARE_BED_ID) {
+          handleBedUpdate({ val: () => data });
+        }
+      } catch (error) {
+        console.error('Error reading LAN push event:', error);
+      }
+    });
+  }
   
   // Return unsubscribe function
-  return () => off(bedRef);
+  return () => {
+    off(bedRef);
+    if (lanEvents) lanEvents.close();
+  };
+};
+
+// Append the dashboard hops (receive, render) to a device trace and store it under latencyTraces/
+// The device ack only arrives with the following record, so it is merged in separately
+const captureLatencyTrace = (data, receivedAt) => {
+  const trace = data.trace;
+  if (!trace.id) return;
+
+  const updates = {};
+  if (trace.id !== lastCapturedTraceId) {
+    lastCapturedTraceId = trace.id;
+    updates[`latencyTraces/${trace.id}/bedId`] = `bed${HARDWARE_BED_ID}`;
+    updates[`latencyTraces/${trace.id}/status`] = data.status || null;
+    updates[`latencyTraces/${trace.id}/sampleMs`] = trace.sampleMs;
+    updates[`latencyTraces/${trace.id}/decisionMs`] = trace.decisionMs;
+    updates[`latencyTraces/${trace.id}/enqueueMs`] = trace.enqueueMs;
+    // Device ms + offset = UTC ms; only meaningful when the device clock is synced
+    updates[`latencyTraces/${trace.id}/deviceOffsetMs`] =
+      data.timeSynced ? data.lastUpdate - data.eventMonoMs : null;
+    updates[`latencyTraces/${trace.id}/serverMs`] = trace.serverMs || null;
+    updates[`latencyTraces/${trace.id}/receivedAt`] = receivedAt;
+  }
+  if (trace.ackMs > 0 && trace.id !== lastCapturedAckId) {
+    lastCapturedAckId = trace.id;
+    updates[`latencyTraces/${trace.id}/ackMs`] = trace.ackMs;
+  }
+  if (Object.keys(updates).length === 0) return;
+
+  const traceId = trace.id;
+  const isFirstArrival = updates[`latencyTraces/${traceId}/receivedAt`] !== undefined;
+  const write = () => update(ref(database), updates).catch((error) => {
+    console.error('Error capturing latency trace:', error);
+  });
+
+  if (isFirstArrival && typeof requestAnimationFrame === 'function') {
+    // Next frame is the earliest point the new status can be on screen
+    requestAnimationFrame(() => {
+      updates[`latencyTraces/${traceId}/renderedAt`] = Date.now();
+      write();
+    });
+  } else {
+    write();
+  }
+};
+
+// Returns the device-stamped event time in UTC ms, or null if the controller clock was unsynced
+const getDeviceEventTime = (data) => {
+  if (data.timeSynced === true && data.lastUpdate > 0) {
+    return data.lastUpdate;
+  }
+  return null;
 };
 
 const getBedStatusFromHardware = (data) => {
@@ -0,0 +1,260 @@
+// Replay bouncing button edge traces through the interrupt-side debouncer
+// and the gesture decoder (buttonEvents.h) and check every gesture.
+//
+// Generates sequences of short, long and paired presses whose contacts
+// chatter for a few ms on every press and release, with glitches (short
+// spikes) between presses and while held. Edges reach ButtonEdges at their
+// exact times, as from the pin-change ISR; the loop that settles, takes and
+// decodes the events runs every few ms but now and then stalls for up to
+// --stall ms (LCD feedback, uplink retries). Each gesture must match the
+// script in kind and to the millisecond: presses at the first contact, short
+// presses at the first edge of the release, long presses at press + long.
+// Runs once with double presses off and once with --double ms, and counts
+// what the old polled decoding (raw level per loop pass) would have made of
+// the same traces.
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -I"hardware/ESP8266 Code" tools/button_bounce_check.cpp -o button_bounce_check
+// Usage:
+//   ./button_bounce_check [--presses 20000] [--debounce 50] [--long 3000] [--double 400] [--stall 1200] [--seed 1]
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "buttonEvents.h"
+
+struct Edge {
+    uint32_t ms;
+    bool pressed;
+};
+
+struct Gesture {
+    ButtonGesture kind;
+    uint32_t ms;
+};
+
+struct Trace {
+    std::vector<Edge> edges;
+    std::vector<Gesture> expected;
+    uint32_t endMs;
+    uint32_t shorts = 0, longs = 0, pairs = 0, glitches = 0;
+};
+
+struct Options {
+    int presses = 20000;
+    uint16_t debounce = 50;
+    uint16_t longMs = 3000;
+    uint16_t doubleMs = 400;
+    uint32_t stall = 1200;
+    unsigned seed = 1;
+};
+
+static const char* kindName(ButtonGesture kind) {
+    switch (kind) {
+        case GESTURE_PRESS: return "press";
+        case GESTURE_SHORT: return "short";
+        case GESTURE_LONG: return "long";
+        case GESTURE_DOUBLE: return "double";
+        default: return "none";
+    }
+}
+
+// Contacts chatter up to ~18 ms before resting at level; returns the last edge
+static uint32_t chatter(std::vector<Edge>& edges, std::mt19937& rng, uint32_t t, bool level) {
+    edges.push_back({t, level});
+    for (unsigned k = rng() % 4; k > 0; k--) {
+        t += 1 + rng() % 3;
+        edges.push_back({t, !level});
+        t += 1 + rng() % 3;
+        edges.push_back({t, level});
+    }
+    return t;
+}
+
+// A spike away from level and back, shorter than the debounce time
+static void spike(Trace& trace, std::mt19937& rng, uint32_t t, bool level) {
+    trace.edges.push_back({t, !level});
+    trace.edges.push_back({t + 1 + (uint32_t)(rng() % 20), level});
+    trace.glitches++;
+}
+
+static uint32_t uniform(std::mt19937& rng, uint32_t lo, uint32_t hi) { return lo + rng() % (hi - lo + 1); }
+
+// One press: chatter in, hold (maybe with a spike), chatter out; returns the release
+static uint32_t press(Trace& trace, std::mt19937& rng, const Options& o, uint32_t at, uint32_t hold) {
+    uint32_t settled = chatter(trace.edges, rng, at, true);
+    uint32_t release = at + hold;
+    if (hold > 300 && rng() % 4 == 0) {
+        spike(trace, rng, uniform(rng, settled + o.debounce + 10, release - o.debounce - 30), true);
+    }
+    chatter(trace.edges, rng, release, false);
+    return release;
+}
+
+static Trace makeTrace(std::mt19937& rng, const Options& o, bool doubles) {
+    Trace trace;
+    uint32_t t = 1000;
+    for (int n = 0; n < o.presses; n++) {
+        uint32_t gap;
+        switch (rng() % 6) {
+            case 0: {  // Long press
+                uint32_t release = press(trace, rng, o, t, uniform(rng, o.longMs + 20, o.longMs * 2));
+                trace.expected.push_back({GESTURE_PRESS, t});
+                trace.expected.push_back({GESTURE_LONG, t + o.longMs});
+                trace.longs++;
+                t = release;
+                gap = uniform(rng, 100, 3000);
+                break;
+            }
+            case 1: {  // Two quick short presses
+                uint32_t first = t;
+                uint32_t release = press(trace, rng, o, t, uniform(rng, 100, 300));
+                uint32_t second = release + uniform(rng, 80, o.doubleMs - 50);
+                uint32_t last = press(trace, rng, o, second, uniform(rng, 100, 300));
+                trace.expected.push_back({GESTURE_PRESS, first});
+                if (!doubles) trace.expected.push_back({GESTURE_SHORT, release});
+                trace.expected.push_back({GESTURE_PRESS, second});
+                trace.expected.push_back({doubles ? GESTURE_DOUBLE : GESTURE_SHORT, last});
+                trace.pairs++;
+                t = last;
+                gap = uniform(rng, o.doubleMs + 100, 3000);
+                break;
+            }
+            default: {  // Short press
+                uint32_t release = press(trace, rng, o, t, uniform(rng, 100, 900));
+                trace.expected.push_back({GESTURE_PRESS, t});
+                trace.expected.push_back({GESTURE_SHORT, release});
+                trace.shorts++;
+                t = release;
+                gap = uniform(rng, o.doubleMs + 100, 3000);
+                break;
+            }
+        }
+        // A knock on the cable between presses
+        if (gap > 300 && rng() % 5 == 0) {
+            spike(trace, rng, uniform(rng, t + 20 + o.debounce, t + gap - o.debounce - 30), false);
+        }
+        t += gap;
+    }
+    trace.endMs = t + o.longMs + o.doubleMs + 1000;
+    return trace;
+}
+
+struct Result {
+    uint64_t gestures = 0, wrong = 0, bounces = 0, glitches = 0, dropped = 0;
+    uint64_t polledShorts = 0, polledLongs = 0, passes = 0;
+    uint32_t longestPass = 0;
+};
+
+// The firmware loop against one trace: ISR edges at their times, loop passes
+// with stalls, and alongside it the polled decoding the events replaced
+static Result run(const Trace& trace, const Options& o, bool doubles, std::mt19937& rng) {
+    Result result;
+    ButtonEdges edges;
+    edges.begin(o.debounce, false);
+    ButtonGestures gestures(doubles ? o.doubleMs : 0);
+    std::vector<Gesture> seen;
+    auto record = [&](ButtonGesture kind) {
+        if (kind != GESTURE_NONE) seen.push_back({kind, gestures.gestureMs()});
+    };
+
+    bool raw = false, polledHeld = false, polledLong = false;
+    uint32_t polledPressMs = 0;
+    size_t next = 0;
+    for (uint32_t now = 0; now < trace.endMs;) {
+        uint32_t pass = rng() % 100 == 0 ? uniform(rng, 200, o.stall) : uniform(rng, 1, 10);
+        result.longestPass = pass > result.longestPass ? pass : result.longestPass;
+        now += pass;
+        result.passes++;
+        for (; next < trace.edges.size() && trace.edges[next].ms <= now; next++) {
+            edges.edge(trace.edges[next].pressed, trace.edges[next].ms);
+            raw = trace.edges[next].pressed;
+        }
+        edges.sync(now);
+        ButtonEvent event;
+        while (edges.take(event)) {
+            for (ButtonGesture due; (due = gestures.poll(event.ms, o.longMs)) != GESTURE_NONE;) {
+                record(due);
+            }
+            record(gestures.event(event, o.longMs));
+        }
+        for (ButtonGesture due; (due = gestures.poll(edges.completeUntil(), o.longMs)) != GESTURE_NONE;) {
+            record(due);
+        }
+
+        // Before: the raw level once per pass, timed by the pass
+        if (raw && !polledHeld) {
+            polledHeld = true;
+            polledLong = false;
+            polledPressMs = now;
+        } else if (raw && !polledLong && now - polledPressMs >= o.longMs) {
+            polledLong = true;
+            result.polledLongs++;
+        } else if (!raw && polledHeld) {
+            polledHeld = false;
+            if (!polledLong) result.polledShorts++;
+        }
+    }
+
+    result.gestures = seen.size();
+    size_t count = seen.size() > trace.expected.size() ? seen.size() : trace.expected.size();
+    for (size_t i = 0; i < count; i++) {
+        bool have = i < seen.size(), want = i < trace.expected.size();
+        if (have && want && seen[i].kind == trace.expected[i].kind && seen[i].ms == trace.expected[i].ms) {
+            continue;
+        }
+        if (result.wrong++ < 5) {
+            printf("  gesture %zu: got %s@%u, expected %s@%u\n", i, have ? kindName(seen[i].kind) : "-",
+                   have ? seen[i].ms : 0, want ? kindName(trace.expected[i].kind) : "-",
+                   want ? trace.expected[i].ms : 0);
+        }
+    }
+    result.bounces = edges.bounceCount();
+    result.glitches = edges.glitchCount();
+    result.dropped = edges.dropCount();
+    return result;
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "--presses") o.presses = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--debounce") o.debounce = (uint16_t)atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--long") o.longMs = (uint16_t)atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--double") o.doubleMs = (uint16_t)atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--stall") o.stall = (uint32_t)atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--seed") o.seed = (unsigned)atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--presses n] [--debounce ms] [--long ms] [--double ms] [--stall ms] "
+                            "[--seed n]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (o.doubleMs < 200 || o.stall < 200 || o.longMs < 1000) {
+        fprintf(stderr, "--double and --stall need at least 200 ms, --long 1000 ms\n");
+        return 1;
+    }
+
+    uint64_t failures = 0;
+    printf("%-8s %8s %8s %8s %8s %8s %8s %8s %8s %10s\n", "doubles", "gestures", "wrong", "bounces", "glitches",
+           "dropped", "longest", "polled_s", "polled_l", "expected");
+    for (bool doubles : {false, true}) {
+        std::mt19937 rng(o.seed);
+        Trace trace = makeTrace(rng, o, doubles);
+        Result r = run(trace, o, doubles, rng);
+        failures += r.wrong;
+        char expected[32];
+        snprintf(expected, sizeof(expected), "%u/%u", trace.shorts + (doubles ? trace.pairs : 2 * trace.pairs),
+                 trace.longs);
+        printf("%-8s %8llu %8llu %8llu %8llu %8llu %6lums %8llu %8llu %10s\n", doubles ? "on" : "off",
+               (unsigned long long)r.gestures, (unsigned long long)r.wrong, (unsigned long long)r.bounces,
+               (unsigned long long)r.glitches, (unsigned long long)r.dropped, (unsigned long)r.longestPass,
+               (unsigned long long)r.polledShorts, (unsigned long long)r.polledLongs, expected);
+    }
+    printf("polled_s/polled_l: short/long presses the raw level polled once per loop pass gives for the same "
+           "traces\nexpected: short (or double)/long presses scripted\n");
+    return failures == 0 ? 0 : 1;
+}
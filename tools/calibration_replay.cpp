@@ -0,0 +1,299 @@
+// Replay captured sensor samples through the occupancy logic and compare the
+// fixed thresholds with the auto-calibrated ones.
+//
+// Capture samples from a bed with the Serial command "rec on" and decode the
+// log with tools/log_decode.py; every sample becomes
+// "[<millis>] S,<ms>,<fsr>,<objCenti>,<ambCenti>" and other lines are ignored.
+// Optionally append ",<0|1>" by hand (ground truth occupancy) to get accuracy.
+//
+// Without a capture, --synthetic generates labelled traces of a bed whose
+// patients come and go (stays of 30-120 min, empty for 10-40 min), one per
+// case the fixed thresholds get wrong:
+//   drift:     mattress preload creeping from 30 to 130 counts, ambient
+//              swinging 21-27 °C
+//   flapping:  a light patient whose load and skin temperature hover at the
+//              fixed 50 counts / 32 °C
+//   bag:       10 minutes after the first patient leaving after hour 1, a
+//              400-count bag at room temperature is put on the bed; it is
+//              taken away two hours later as the next patient lies down
+//   warm:      a mattress topper preloading 60 counts, and from hour 2 a
+//              heated underlay keeping the empty surface at 32.5 °C
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -DFEATURE_PERSISTENCE=0 -I"hardware/ESP8266 Code"
+//       tools/calibration_replay.cpp -o calibration_replay
+// Usage:
+//   ./calibration_replay capture.log [--confirm-ms 2000]
+//   ./calibration_replay --synthetic [--seed 1] [--hours 12] [--confirm-ms 2000]
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "bedConfig.h"
+#include "occupancyCalibration.h"
+
+struct Sample {
+    uint32_t ms;
+    int fsr;
+    centi_t objectCenti;
+    centi_t ambientCenti;
+    int truth;          // -1 if not labelled
+};
+
+struct ReplayResult {
+    unsigned transitions = 0;
+    unsigned shortStays = 0;        // Occupied periods under a minute, usually flapping
+    unsigned labelled = 0;
+    unsigned correct = 0;
+    double meanOnsetMs = 0;         // Labelled occupied -> detected occupied
+    unsigned onsets = 0;
+};
+
+// Same debounce as readSensors(): occupied at once, unoccupied after the confirm window
+class Debouncer {
+public:
+    explicit Debouncer(uint32_t confirm) : confirmMs(confirm) {}
+
+    bool update(bool detected, uint32_t ms) {
+        if (detected && !occupied) {
+            occupied = true;
+            emptySince = 0;
+        } else if (!detected && occupied) {
+            if (emptySince == 0) {
+                emptySince = ms;
+            } else if (ms - emptySince > confirmMs) {
+                occupied = false;
+                emptySince = 0;
+            }
+        } else {
+            emptySince = 0;
+        }
+        return occupied;
+    }
+
+    bool occupied = false;
+
+private:
+    uint32_t confirmMs;
+    uint32_t emptySince = 0;
+};
+
+template<typename Detector>
+ReplayResult replay(const std::vector<Sample>& samples, uint32_t confirmMs, Detector detect) {
+    ReplayResult result;
+    Debouncer debouncer(confirmMs);
+    uint32_t occupiedAt = 0;
+    uint32_t truthOnset = 0;
+    bool pendingOnset = false;
+    int lastTruth = -1;
+    double onsetTotal = 0;
+
+    for (const Sample& s : samples) {
+        bool before = debouncer.occupied;
+        bool detected = detect(s, !before);
+        bool now = debouncer.update(detected, s.ms);
+
+        if (now != before) {
+            result.transitions++;
+            if (now) {
+                occupiedAt = s.ms;
+            } else if (s.ms - occupiedAt < 60000) {
+                result.shortStays++;
+            }
+        }
+
+        if (s.truth >= 0) {
+            result.labelled++;
+            if ((int)now == s.truth) result.correct++;
+            if (s.truth == 1 && lastTruth == 0) {
+                truthOnset = s.ms;
+                pendingOnset = true;
+            }
+            if (pendingOnset && now) {
+                onsetTotal += s.ms - truthOnset;
+                result.onsets++;
+                pendingOnset = false;
+            }
+            lastTruth = s.truth;
+        }
+    }
+    result.meanOnsetMs = result.onsets ? onsetTotal / result.onsets : 0;
+    return result;
+}
+
+static bool parseSample(const char* line, Sample& s) {
+    // Skip the "[millis] " prefix added by the log decoder
+    if (line[0] == '[') {
+        const char* end = strchr(line, ']');
+        if (end == nullptr) return false;
+        line = end + 1;
+        while (*line == ' ') line++;
+    }
+    if (line[0] != 'S' || line[1] != ',') return false;
+    unsigned long ms;
+    int fsr, obj, amb, truth = -1;
+    int n = sscanf(line + 2, "%lu,%d,%d,%d,%d", &ms, &fsr, &obj, &amb, &truth);
+    if (n < 4) return false;
+    s.ms = (uint32_t)ms;
+    s.fsr = fsr;
+    s.objectCenti = (centi_t)obj;
+    s.ambientCenti = (centi_t)amb;
+    s.truth = n == 5 ? truth : -1;
+    return true;
+}
+
+enum Trace { TRACE_DRIFT, TRACE_FLAPPING, TRACE_BAG, TRACE_WARM, TRACE_COUNT };
+static const char* TRACE_NAMES[] = {"drift", "flapping", "bag", "warm"};
+
+// One labelled sample every 500 ms, as "rec on" would capture it
+static std::vector<Sample> synthesize(Trace trace, unsigned seed, double hours) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> n(0, 1);
+    std::vector<Sample> samples;
+    const uint32_t endMs = (uint32_t)(hours * 3600000.0);
+    uint32_t bagFromMs = UINT32_MAX, bagToMs = 0;
+    bool patient = false;
+    uint32_t nextMoveMs = 15 * 60000UL;     // Empty first: calibration learns
+    uint32_t leftMs = 0;
+    double skin = 3420, leftSkin = 0, wander = 0;
+    for (uint32_t ms = 500; ms <= endMs; ms += 500) {
+        if (ms >= nextMoveMs) {
+            patient = !patient;
+            if (!patient) {
+                leftMs = ms;
+                leftSkin = skin;
+            }
+            nextMoveMs = ms + (patient ? 30 + rng() % 91 : 10 + rng() % 31) * 60000UL;
+            if (trace == TRACE_BAG && !patient && bagToMs == 0 && ms >= 3600000UL) {
+                bagFromMs = ms + 10 * 60000UL;
+                bagToMs = bagFromMs + 120 * 60000UL;
+                nextMoveMs = bagToMs;   // Taken away as the next patient comes
+            }
+        }
+        double t = ms / 3600000.0;
+        double ambient = 2300, preload = 30, load = 620 + 15 * n(rng), surface;
+        skin = 3420 + 3 * n(rng);
+        switch (trace) {
+            case TRACE_DRIFT:
+                preload = 30 + 100 * t / hours;
+                ambient = 2400 + 300 * sin(2 * M_PI * t / 24);
+                break;
+            case TRACE_FLAPPING:
+                // Light, restless patient under a thin blanket
+                wander += 0.02 * n(rng);
+                wander *= 0.999;
+                load = 48 + 25 * fabs(sin(2 * M_PI * ms / 420000.0)) + 8 * n(rng);
+                skin = 3200 + 40 * wander + 30 * sin(2 * M_PI * ms / 300000.0) + 10 * n(rng);
+                break;
+            case TRACE_BAG:
+                if (ms >= bagFromMs && ms < bagToMs) preload = 400;
+                break;
+            case TRACE_WARM:
+                preload = 60;
+                break;
+            default:
+                break;
+        }
+        surface = ambient + (trace == TRACE_WARM && t >= 2 ? 950 : 150);
+        // The surface keeps the patient's heat for a few minutes
+        if (!patient && leftMs != 0) {
+            surface += (leftSkin - surface) * exp(-(double)(ms - leftMs) / 240000.0);
+        }
+        Sample s;
+        s.ms = ms;
+        s.fsr = (int)(preload + (patient ? load : 0) + 2 * n(rng) + 0.5);
+        if (s.fsr < 0) s.fsr = 0;
+        if (s.fsr > 1023) s.fsr = 1023;
+        s.objectCenti = (centi_t)((patient ? skin : surface + 3 * n(rng)) + 0.5);
+        s.ambientCenti = (centi_t)(ambient + 3 * n(rng) + 0.5);
+        s.truth = patient ? 1 : 0;
+        samples.push_back(s);
+    }
+    return samples;
+}
+
+static void printResult(const char* name, const ReplayResult& r) {
+    printf("%-12s transitions=%-5u short_stays=%-5u", name, r.transitions, r.shortStays);
+    if (r.labelled) {
+        printf(" accuracy=%.2f%% onset_ms=%.0f", 100.0 * r.correct / r.labelled, r.meanOnsetMs);
+    }
+    printf("\n");
+}
+
+// Fixed thresholds against the calibration on one trace
+static void compare(const std::vector<Sample>& samples, uint32_t confirmMs, const BedSettings& settings) {
+    // Fixed: the original comparison against 50 counts / 32 °C, no hysteresis
+    ReplayResult fixed = replay(samples, confirmMs, [&](const Sample& s, bool) {
+        return s.fsr > settings.fsrThreshold && s.objectCenti > settings.tempThresholdCentiC;
+    });
+
+    OccupancyCalibration calibration;
+    int peakBaseline = 0;
+    ReplayResult calibrated = replay(samples, confirmMs, [&](const Sample& s, bool empty) {
+        calibration.update(s.fsr, s.objectCenti, s.ambientCenti, empty, settings);
+        if (calibration.fsrBaseline() > peakBaseline) peakBaseline = calibration.fsrBaseline();
+        return calibration.weightDetected() && calibration.bodyTempDetected();
+    });
+
+    printf("samples=%zu span_s=%.0f confirm_ms=%u\n", samples.size(),
+           (samples.back().ms - samples.front().ms) / 1000.0, confirmMs);
+    printResult("fixed", fixed);
+    printResult("calibrated", calibrated);
+    printf("learned: baseline=%d (peak %d) noise=%d surfaceDelta=%d confidence=%u%% fsrThr=%u tempThr=%d\n",
+           calibration.fsrBaseline(), peakBaseline, calibration.fsrNoise(), calibration.surfaceDeltaCentiC(),
+           calibration.confidence(), calibration.fsrThreshold(), calibration.tempThresholdCentiC());
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s capture.log|--synthetic [--seed N] [--hours H] [--confirm-ms N]\n", argv[0]);
+        return 1;
+    }
+    uint32_t confirmMs = DEFAULT_SETTINGS.unoccupiedConfirmMs;
+    unsigned seed = 1;
+    double hours = 12;
+    for (int i = 2; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--confirm-ms") == 0) confirmMs = (uint32_t)atol(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0) seed = (unsigned)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--hours") == 0) hours = atof(argv[++i]);
+    }
+
+    if (strcmp(argv[1], "--synthetic") == 0) {
+        if (hours < 6) {
+            fprintf(stderr, "--hours must be at least 6 (the bag comes after hour 1 and stays two)\n");
+            return 1;
+        }
+        for (int trace = 0; trace < TRACE_COUNT; trace++) {
+            std::vector<Sample> samples = synthesize((Trace)trace, seed, hours);
+            unsigned stays = 0;
+            for (size_t i = 1; i < samples.size(); i++) {
+                if (samples[i].truth != samples[i - 1].truth) stays++;
+            }
+            printf("%s%s: %u true transitions, ", trace ? "\n" : "", TRACE_NAMES[trace], stays);
+            compare(samples, confirmMs, DEFAULT_SETTINGS);
+        }
+        return 0;
+    }
+
+    FILE* f = fopen(argv[1], "r");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    std::vector<Sample> samples;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        Sample s;
+        if (parseSample(line, s)) samples.push_back(s);
+    }
+    fclose(f);
+    if (samples.empty()) {
+        fprintf(stderr, "no S, sample lines in %s\n", argv[1]);
+        return 1;
+    }
+    compare(samples, confirmMs, DEFAULT_SETTINGS);
+    return 0;
+}
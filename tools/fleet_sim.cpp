@@ -0,0 +1,795 @@
+// Bed fleet simulator and ingestion load generator.
+//
+// Runs thousands of virtual bed controllers on worker threads. Each one is the
+// firmware's BedController (bedController.h): the same button/card workflow,
+// median filtering, calibration and report-on-change/heartbeat logic as
+// code.cpp, driven by a scripted ward. Patients are admitted (staff card on an
+// unassigned bed), the empty bed is cleaned and verified, patients come and go
+// during their stay, beds are cleaned while occupied, and discharges take the
+// long press and two card taps. Sampling and the uplink heartbeat run in real
+// time; the ward's timeline (stays, gaps, cleaning) is compressed so a short
+// run sees a realistic mix of events.
+//
+// Records go to a pluggable sink:
+//   http     one PUT of /beds/bed<N>.json per record over a keep-alive
+//            connection per worker, like a controller's Firebase session
+//   file     one JSON line per record, appended to --file
+//   gateway  records are queued to a gateway thread that writes up to
+//            --batch of them as one multi-path PATCH of /beds.json, like the
+//            mesh gateway or a multi-bed controller (sendBatch)
+// The HTTP target is an in-process stand-in on 127.0.0.1 unless --target
+// points at a real endpoint (an IPv4 address and port).
+//
+// Reported per sink:
+//   rec/s      records acknowledged per second at the ward's offered load
+//   events/s   status-changing events (occupancy, workflow) per second
+//   ack p50/p95/p99  from the event's decision to the ack of the first record
+//              carrying it: occupancy changes wait for the next uplink tick
+//              as on the device, workflow changes go out at once
+//   ceiling    records/s and MB/s when the workers send as fast as the sink
+//              allows, i.e. the most beds this sink path can carry
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -pthread -DFEATURE_PERSISTENCE=0 -I"hardware/ESP8266 Code" tools/fleet_sim.cpp -o fleet_sim
+// Usage:
+//   ./fleet_sim [--beds 1000] [--threads 8] [--duration 30] [--compress 600]
+//               [--sinks http,file,gateway] [--batch 32] [--batch-ms 50]
+//               [--file /tmp/fleet_sim.jsonl] [--fsync 0] [--target 127.0.0.1:8080]
+//               [--ceiling 3] [--seed 1]
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bedConfig.h"
+#include "bedController.h"
+
+static const char* STAFF_CARDS[] = {"B310C2F5", "63870DFC"};
+static const int TICK_MS = 10;
+
+struct Options {
+    int beds = 1000;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    double durationS = 30;
+    double compress = 600;          // Ward timeline speed-up
+    std::vector<std::string> sinks = {"http", "file", "gateway"};
+    int batch = 32;
+    int batchMs = 50;
+    std::string file = "/tmp/fleet_sim.jsonl";
+    bool fsync = false;
+    std::string target;             // Empty: in-process stand-in
+    double ceilingS = 3;
+    unsigned seed = 1;
+};
+
+static int64_t wallNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ------------------ Metrics ------------------
+
+struct Metrics {
+    std::atomic<uint64_t> records{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> events{0};
+    std::mutex lock;
+    std::vector<uint32_t> latencyUs;    // Event decision to ack
+
+    void ack(const std::vector<int64_t>& eventNs, uint64_t count, uint64_t size, int64_t nowNs) {
+        records += count;
+        bytes += size;
+        if (eventNs.empty()) return;
+        std::lock_guard<std::mutex> guard(lock);
+        for (int64_t t : eventNs) {
+            latencyUs.push_back((uint32_t)std::min<int64_t>((nowNs - t) / 1000, UINT32_MAX));
+        }
+    }
+};
+
+struct Record {
+    uint16_t bed;
+    std::string json;
+    int64_t eventNs;    // Decision time of the event this record carries first, 0 if none
+};
+
+// ------------------ HTTP ------------------
+
+static bool parseTarget(const std::string& target, sockaddr_in& addr) {
+    size_t colon = target.rfind(':');
+    if (colon == std::string::npos) return false;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)atoi(target.c_str() + colon + 1));
+    return inet_pton(AF_INET, target.substr(0, colon).c_str(), &addr.sin_addr) == 1;
+}
+
+static bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = ::send(fd, data, length, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+// Reads one HTTP message (headers + Content-Length body) from a buffered socket
+class HttpReader {
+public:
+    explicit HttpReader(int socket) : fd(socket) {}
+
+    bool next(std::string& head, std::string& body) {
+        size_t end;
+        while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (!fill()) return false;
+        }
+        head = buffer.substr(0, end);
+        buffer.erase(0, end + 4);
+        size_t length = 0;
+        const char* field = strcasestr(head.c_str(), "content-length:");
+        if (field) length = (size_t)atol(field + 15);
+        while (buffer.size() < length) {
+            if (!fill()) return false;
+        }
+        body = buffer.substr(0, length);
+        buffer.erase(0, length);
+        return true;
+    }
+
+private:
+    bool fill() {
+        char chunk[16384];
+        ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer.append(chunk, (size_t)n);
+        return true;
+    }
+
+    int fd;
+    std::string buffer;
+};
+
+// Stand-in for the RTDB REST endpoint: accepts keep-alive PUT/PATCH requests
+// and answers each with 200 and a small body, one thread per connection
+class StandInServer {
+public:
+    bool start() {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 1024) != 0) return false;
+        socklen_t len = sizeof(addr);
+        getsockname(listener, (sockaddr*)&addr, &len);
+        port = ntohs(addr.sin_port);
+        acceptor = std::thread([this]() { acceptLoop(); });
+        return true;
+    }
+
+    void stop() {
+        shutdown(listener, SHUT_RDWR);
+        close(listener);
+        acceptor.join();
+        std::lock_guard<std::mutex> guard(lock);
+        for (int fd : clients) shutdown(fd, SHUT_RDWR);
+        for (std::thread& t : workers) t.join();
+    }
+
+    std::string address() const { return "127.0.0.1:" + std::to_string(port); }
+
+private:
+    void acceptLoop() {
+        for (;;) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0) return;
+            int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            std::lock_guard<std::mutex> guard(lock);
+            clients.push_back(fd);
+            workers.emplace_back([fd]() { serve(fd); });
+        }
+    }
+
+    static void serve(int fd) {
+        HttpReader reader(fd);
+        std::string head, body;
+        static const char reply[] = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: 2\r\n\r\n{}";
+        while (reader.next(head, body)) {
+            if (!writeAll(fd, reply, sizeof(reply) - 1)) break;
+        }
+        close(fd);
+    }
+
+    int listener = -1;
+    uint16_t port = 0;
+    std::thread acceptor;
+    std::mutex lock;
+    std::vector<int> clients;
+    std::vector<std::thread> workers;
+};
+
+class HttpClient {
+public:
+    ~HttpClient() { disconnect(); }
+
+    // One request/response; reconnects once if the connection dropped
+    bool request(const sockaddr_in& addr, const char* method, const std::string& path, const std::string& body) {
+        for (int attempt = 0; attempt < 2; attempt++) {
+            if (fd < 0 && !connectTo(addr)) return false;
+            char head[256];
+            int n = snprintf(head, sizeof(head),
+                             "%s %s HTTP/1.1\r\nHost: fleet-sim\r\nContent-Type: application/json\r\n"
+                             "Content-Length: %zu\r\n\r\n", method, path.c_str(), body.size());
+            std::string replyHead, replyBody;
+            if (writeAll(fd, head, (size_t)n) && writeAll(fd, body.data(), body.size()) &&
+                reader->next(replyHead, replyBody)) {
+                return replyHead.compare(0, 12, "HTTP/1.1 200") == 0;
+            }
+            disconnect();
+        }
+        return false;
+    }
+
+private:
+    bool connectTo(const sockaddr_in& addr) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+            disconnect();
+            return false;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        reader.reset(new HttpReader(fd));
+        return true;
+    }
+
+    void disconnect() {
+        if (fd >= 0) close(fd);
+        fd = -1;
+        reader.reset();
+    }
+
+    int fd = -1;
+    std::unique_ptr<HttpReader> reader;
+};
+
+// ------------------ Sinks ------------------
+
+class Sink {
+public:
+    virtual ~Sink() {}
+    // Called from worker threads; acks are reported to metrics
+    virtual void send(int worker, Record&& record) = 0;
+    virtual void finish() {}
+};
+
+class HttpSink : public Sink {
+public:
+    HttpSink(const sockaddr_in& target, int workers, Metrics& m) : addr(target), clients(workers), metrics(m) {}
+
+    void send(int worker, Record&& record) override {
+        std::string path = "/beds/bed" + std::to_string(record.bed) + ".json";
+        if (!clients[worker].request(addr, "PUT", path, record.json)) {
+            metrics.failures++;
+            return;
+        }
+        std::vector<int64_t> events;
+        if (record.eventNs) events.push_back(record.eventNs);
+        metrics.ack(events, 1, record.json.size(), wallNs());
+    }
+
+private:
+    sockaddr_in addr;
+    std::vector<HttpClient> clients;
+    Metrics& metrics;
+};
+
+class FileSink : public Sink {
+public:
+    FileSink(const std::string& path, bool sync, Metrics& m) : durable(sync), metrics(m) {
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    }
+    ~FileSink() override { if (fd >= 0) close(fd); }
+
+    bool ok() const { return fd >= 0; }
+
+    void send(int, Record&& record) override {
+        record.json.push_back('\n');
+        // O_APPEND keeps concurrent lines whole; fdatasync makes each one durable
+        bool written = writeLine(record.json);
+        if (written && durable) written = fdatasync(fd) == 0;
+        if (!written) {
+            metrics.failures++;
+            return;
+        }
+        std::vector<int64_t> events;
+        if (record.eventNs) events.push_back(record.eventNs);
+        metrics.ack(events, 1, record.json.size(), wallNs());
+    }
+
+private:
+    bool writeLine(const std::string& line) {
+        return write(fd, line.data(), line.size()) == (ssize_t)line.size();
+    }
+
+    int fd = -1;
+    bool durable;
+    Metrics& metrics;
+};
+
+// Workers enqueue; one gateway thread writes batches, like the mesh gateway's sendBatch
+class GatewaySink : public Sink {
+public:
+    GatewaySink(const sockaddr_in& target, int batchSize, int batchMs, Metrics& m)
+        : addr(target), batch(batchSize), lingerMs(batchMs), metrics(m) {
+        thread = std::thread([this]() { run(); });
+    }
+
+    void send(int, Record&& record) override {
+        std::unique_lock<std::mutex> guard(lock);
+        // Bounded like the firmware queues; producers wait rather than grow it
+        space.wait(guard, [this]() { return queue.size() < QUEUE_LIMIT || stopping; });
+        queue.push_back(std::move(record));
+        if ((int)queue.size() >= batch) ready.notify_one();
+    }
+
+    void finish() override {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        ready.notify_one();
+        space.notify_all();
+        thread.join();
+    }
+
+private:
+    static const size_t QUEUE_LIMIT = 8192;
+
+    void run() {
+        HttpClient client;
+        std::vector<Record> taken;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                ready.wait_for(guard, std::chrono::milliseconds(lingerMs),
+                               [this]() { return (int)queue.size() >= batch || stopping; });
+                if (queue.empty()) {
+                    if (stopping) return;
+                    continue;
+                }
+                size_t n = std::min(queue.size(), (size_t)batch);
+                taken.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.begin() + n));
+                queue.erase(queue.begin(), queue.begin() + n);
+            }
+            space.notify_all();
+
+            // Newest record per bed wins within a batch, as in a multi-path update
+            std::string body = "{";
+            for (size_t i = 0; i < taken.size(); i++) {
+                if (i) body += ',';
+                body += "\"bed" + std::to_string(taken[i].bed) + "\":" + taken[i].json;
+            }
+            body += '}';
+            if (!client.request(addr, "PATCH", "/beds.json", body)) {
+                metrics.failures += taken.size();
+                continue;
+            }
+            std::vector<int64_t> events;
+            for (const Record& r : taken) {
+                if (r.eventNs) events.push_back(r.eventNs);
+            }
+            metrics.ack(events, taken.size(), body.size(), wallNs());
+        }
+    }
+
+    sockaddr_in addr;
+    int batch;
+    int lingerMs;
+    Metrics& metrics;
+    std::mutex lock;
+    std::condition_variable ready;
+    std::condition_variable space;
+    std::deque<Record> queue;
+    bool stopping = false;
+    std::thread thread;
+};
+
+// ------------------ Virtual beds ------------------
+
+struct SimBed;
+
+// BedController's Io: no LCD, publishes and traces are noted for the worker
+struct SimIo {
+    SimBed* bed = nullptr;
+    void show(uint8_t, TextId, TextId, uint32_t) {}
+    void redraw(uint8_t) {}
+    void publish(uint8_t);
+    void trace(uint8_t, uint32_t);
+    template<typename... Args>
+    void log(uint8_t, LogId id, const Args&...) { counted(id); }
+    void counted(LogId id);
+};
+
+// Scripted ward actions
+enum ActionType { PATIENT_IN, PATIENT_OUT, PRESS, CARD };
+
+struct Action {
+    uint32_t atMs;
+    ActionType type;
+    uint32_t durationMs;    // PRESS only
+};
+
+struct EventMix {
+    uint64_t admissions = 0;
+    uint64_t cleanings = 0;
+    uint64_t discharges = 0;
+    uint64_t occupancy = 0;
+    uint64_t timeouts = 0;
+};
+
+struct SimBed {
+    uint16_t id = 0;
+    SimIo io;
+    BedController<SimIo> controller;
+    std::deque<Action> script;
+    std::mt19937 rng;
+    bool patient = false;
+    uint32_t buttonUpMs = 0;
+    bool forced = false;
+    int64_t pendingEventNs = 0;
+    uint32_t nextUplinkMs = 0;
+    EventMix mix;
+    uint64_t events = 0;
+};
+
+void SimIo::publish(uint8_t) { bed->forced = true; }
+
+void SimIo::trace(uint8_t, uint32_t) {
+    bed->pendingEventNs = wallNs();
+    bed->events++;
+}
+
+void SimIo::counted(LogId id) {
+    switch (id) {
+        case LOG_REASSIGNED: bed->mix.admissions++; break;
+        case LOG_CLEANING_VERIFIED: bed->mix.cleanings++; break;
+        case LOG_DISCHARGED: bed->mix.discharges++; break;
+        case LOG_OCCUPIED: case LOG_UNOCCUPIED: bed->mix.occupancy++; break;
+        case LOG_VERIFY_TIMEOUT: bed->mix.timeouts++; break;
+        default: break;
+    }
+}
+
+class Ward {
+public:
+    Ward(const Options& o) : opt(o) {}
+
+    // Ward durations in minutes, compressed
+    uint32_t minutes(SimBed& bed, double mean) {
+        std::exponential_distribution<double> d(1.0 / mean);
+        return (uint32_t)(d(bed.rng) * 60000.0 / opt.compress) + 1000;
+    }
+
+    uint32_t between(SimBed& bed, uint32_t lo, uint32_t hi) {
+        return lo + bed.rng() % (hi - lo + 1);
+    }
+
+    // Cleaning: press, clean, press, card (5% of verifications time out and are repeated)
+    uint32_t cleaning(SimBed& bed, uint32_t t) {
+        bed.script.push_back({t, PRESS, between(bed, 100, 400)});
+        t += minutes(bed, 15);
+        for (;;) {
+            bed.script.push_back({t, PRESS, between(bed, 100, 400)});
+            if (bed.rng() % 20 != 0) {
+                t += between(bed, 1000, 4000);
+                bed.script.push_back({t, CARD, 0});
+                return t + DEFAULT_SETTINGS.staffIdDisplayMs + 1500;
+            }
+            t += DEFAULT_SETTINGS.verifyTimeoutMs + 2000;  // Timed out, back to cleaning
+        }
+    }
+
+    // A stay from the patient arriving: trips away from the bed, maybe a
+    // cleaning, then the patient leaves and the bed is discharged
+    uint32_t stay(SimBed& bed, uint32_t t, double meanHours) {
+        bed.script.push_back({t, PATIENT_IN, 0});
+        uint32_t end = t + minutes(bed, meanHours * 60);
+        bool cleaned = false;
+        for (;;) {
+            t += minutes(bed, 90);
+            if (t >= end) break;
+            if (!cleaned && bed.rng() % 3 == 0) {
+                t = cleaning(bed, t);
+                cleaned = true;
+                continue;
+            }
+            bed.script.push_back({t, PATIENT_OUT, 0});
+            t += minutes(bed, 8);
+            bed.script.push_back({t, PATIENT_IN, 0});
+        }
+        bed.script.push_back({end, PATIENT_OUT, 0});
+        t = end + minutes(bed, 10);
+        // Discharge: long press, card at the prompt, card again to confirm
+        bed.script.push_back({t, PRESS, DEFAULT_SETTINGS.longPressMs + between(bed, 200, 800)});
+        t += DEFAULT_SETTINGS.longPressMs + between(bed, 1500, 3500);
+        bed.script.push_back({t, CARD, 0});
+        t += DEFAULT_SETTINGS.staffIdDisplayMs + between(bed, 1500, 5000);
+        bed.script.push_back({t, CARD, 0});
+        return t + DEFAULT_SETTINGS.staffIdDisplayMs + 500;
+    }
+
+    // Next admission after a gap: card reassigns the bed, it is cleaned, the patient arrives
+    void nextEpisode(SimBed& bed, uint32_t t) {
+        t += minutes(bed, 30);
+        bed.script.push_back({t, CARD, 0});
+        t = cleaning(bed, t + DEFAULT_SETTINGS.staffIdDisplayMs + 1000);
+        stay(bed, t + minutes(bed, 20), 36);
+    }
+
+    // Beds boot assigned and empty: most get a patient mid-stay, the rest a cleaning first
+    void start(SimBed& bed, uint16_t id) {
+        bed.id = id;
+        bed.rng.seed(opt.seed * 7919 + id);
+        bed.io.bed = &bed;
+        bed.controller.begin(&bed.io, 0);
+        uint32_t t = between(bed, 1000, 20000);
+        if (bed.rng() % 4 == 0) {
+            t = cleaning(bed, t);
+        }
+        stay(bed, t, 6);
+        bed.nextUplinkMs = between(bed, 0, DEFAULT_SETTINGS.uplinkIntervalMs);
+    }
+
+    // One loop pass of the bed's firmware at nowMs
+    void step(SimBed& bed, uint32_t nowMs, int worker, Sink& sink) {
+        while (!bed.script.empty() && bed.script.front().atMs <= nowMs) {
+            Action a = bed.script.front();
+            bed.script.pop_front();
+            switch (a.type) {
+                case PATIENT_IN: bed.patient = true; break;
+                case PATIENT_OUT: bed.patient = false; break;
+                case PRESS: bed.buttonUpMs = nowMs + a.durationMs; break;
+                case CARD: bed.controller.staffCard(STAFF_CARDS[bed.rng() % 2], nowMs); break;
+            }
+            if (bed.script.empty()) {
+                nextEpisode(bed, nowMs);
+            }
+        }
+        bed.controller.button(nowMs < bed.buttonUpMs, nowMs, DEFAULT_SETTINGS);
+
+        if (bed.controller.sampleDue(nowMs, DEFAULT_SETTINGS)) {
+            std::normal_distribution<double> noise(0, 4);
+            int fsr = (int)((bed.patient ? 620 : 90) + noise(bed.rng));
+            centi_t object = (centi_t)((bed.patient ? 3420 : 2450) + noise(bed.rng) * 3);
+            centi_t ambient = bed.controller.ambientDue() ? (centi_t)(2300 + noise(bed.rng)) : AMBIENT_INVALID;
+            bed.controller.sample(std::max(0, fsr), object, ambient, nowMs, DEFAULT_SETTINGS);
+        }
+        bed.controller.timeouts(nowMs, DEFAULT_SETTINGS);
+
+        // updateFirebase: forced by the workflow or on the uplink tick, sent if due
+        bool tick = (int32_t)(nowMs - bed.nextUplinkMs) >= 0;
+        if (tick) bed.nextUplinkMs = nowMs + DEFAULT_SETTINGS.uplinkIntervalMs;
+        if ((bed.forced || tick) &&
+            bed.controller.reportDue(DEFAULT_SETTINGS, DEFAULT_SETTINGS.uplinkIntervalMs, nowMs)) {
+            Record record = build(bed, nowMs);
+            bed.pendingEventNs = 0;
+            bed.controller.reported(nowMs);
+            sink.send(worker, std::move(record));
+        }
+        bed.forced = false;
+    }
+
+    // Same fields as BedUplink::fillRecord
+    static Record build(const SimBed& bed, uint32_t nowMs) {
+        const BedController<SimIo>& c = bed.controller;
+        const OccupancyCalibration& cal = c.occupancy();
+        char temperature[12], threshold[12];
+        formatCenti(temperature, sizeof(temperature), c.temperatureCenti());
+        formatCenti(threshold, sizeof(threshold), cal.tempThresholdCentiC());
+        char json[512];
+        snprintf(json, sizeof(json),
+                 "{\"id\":%u,\"status\":\"%s\",\"fsrValue\":%d,\"hasBodyTemp\":%s,\"hasWeight\":%s,"
+                 "\"isOccupied\":%s,\"temperature\":%s,\"lastUpdate\":%lld,\"eventMonoMs\":%u,"
+                 "\"timeSynced\":true,\"online\":true,\"lastStaffId\":\"%s\",\"configRevision\":0,"
+                 "\"fsrThreshold\":%u,\"tempThreshold\":%s,\"calibrationConfidence\":%u}",
+                 bed.id, bedStatusName(c.status()).c_str(), c.fsr(), cal.bodyTempDetected() ? "true" : "false",
+                 cal.weightDetected() ? "true" : "false", c.sensorsOccupied() ? "true" : "false", temperature,
+                 (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::system_clock::now().time_since_epoch()).count(),
+                 nowMs, c.staffId(), cal.fsrThreshold(), threshold, cal.confidence());
+        return Record{bed.id, json, bed.pendingEventNs};
+    }
+
+private:
+    const Options& opt;
+};
+
+// ------------------ Runs ------------------
+
+static uint32_t percentile(std::vector<uint32_t>& values, double p) {
+    if (values.empty()) return 0;
+    size_t k = (size_t)(p * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+static std::unique_ptr<Sink> makeSink(const std::string& name, const Options& opt, const sockaddr_in& target,
+                                      Metrics& metrics) {
+    if (name == "http") return std::unique_ptr<Sink>(new HttpSink(target, opt.threads, metrics));
+    if (name == "gateway") return std::unique_ptr<Sink>(new GatewaySink(target, opt.batch, opt.batchMs, metrics));
+    if (name == "file") {
+        FileSink* sink = new FileSink(opt.file, opt.fsync, metrics);
+        if (!sink->ok()) {
+            fprintf(stderr, "cannot open %s\n", opt.file.c_str());
+            exit(1);
+        }
+        return std::unique_ptr<Sink>(sink);
+    }
+    fprintf(stderr, "unknown sink %s\n", name.c_str());
+    exit(1);
+}
+
+// The ward at its own pace for --duration seconds
+static void runWard(const Options& opt, Sink& sink, Metrics& metrics, EventMix& mix) {
+    std::vector<SimBed> beds(opt.beds);
+    Ward ward(opt);
+    for (int i = 0; i < opt.beds; i++) {
+        ward.start(beds[i], (uint16_t)(i + 1));
+    }
+    int64_t start = wallNs();
+    int64_t end = start + (int64_t)(opt.durationS * 1e9);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < opt.threads; w++) {
+        workers.emplace_back([&, w]() {
+            int64_t next = start;
+            while (next < end) {
+                uint32_t nowMs = (uint32_t)((wallNs() - start) / 1000000);
+                for (int i = w; i < opt.beds; i += opt.threads) {
+                    ward.step(beds[i], nowMs, w, sink);
+                }
+                next += TICK_MS * 1000000LL;
+                int64_t wait = next - wallNs();
+                if (wait > 0) std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+            }
+        });
+    }
+    for (std::thread& t : workers) t.join();
+    sink.finish();
+    for (const SimBed& bed : beds) {
+        metrics.events += bed.events;
+        mix.admissions += bed.mix.admissions;
+        mix.cleanings += bed.mix.cleanings;
+        mix.discharges += bed.mix.discharges;
+        mix.occupancy += bed.mix.occupancy;
+        mix.timeouts += bed.mix.timeouts;
+    }
+}
+
+// Every worker sends a typical record as fast as the sink acks it
+static void runCeiling(const Options& opt, Sink& sink) {
+    SimBed bed;
+    Ward(opt).start(bed, 1);
+    Record sample = Ward::build(bed, 0);
+    int64_t end = wallNs() + (int64_t)(opt.ceilingS * 1e9);
+    std::vector<std::thread> workers;
+    for (int w = 0; w < opt.threads; w++) {
+        workers.emplace_back([&, w]() {
+            uint16_t id = (uint16_t)(w + 1);
+            while (wallNs() < end) {
+                Record r = sample;
+                r.bed = id;
+                id = (uint16_t)(id % opt.beds + 1);
+                sink.send(w, std::move(r));
+            }
+        });
+    }
+    for (std::thread& t : workers) t.join();
+    sink.finish();
+}
+
+static void usage() {
+    fprintf(stderr, "usage: fleet_sim [--beds n] [--threads n] [--duration s] [--compress x] "
+                    "[--sinks http,file,gateway] [--batch n] [--batch-ms ms] [--file path] [--fsync 0|1] "
+                    "[--target ip:port] [--ceiling s] [--seed n]\n");
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) usage();
+        const char* value = argv[++i];
+        if (arg == "--sinks") {
+            opt.sinks.clear();
+            for (const char* p = value; *p;) {
+                const char* comma = strchr(p, ',');
+                opt.sinks.push_back(comma ? std::string(p, comma - p) : std::string(p));
+                if (!comma) break;
+                p = comma + 1;
+            }
+        } else if (arg == "--beds") opt.beds = atoi(value);
+        else if (arg == "--threads") opt.threads = atoi(value);
+        else if (arg == "--duration") opt.durationS = atof(value);
+        else if (arg == "--compress") opt.compress = atof(value);
+        else if (arg == "--batch") opt.batch = atoi(value);
+        else if (arg == "--batch-ms") opt.batchMs = atoi(value);
+        else if (arg == "--file") opt.file = value;
+        else if (arg == "--fsync") opt.fsync = atoi(value) != 0;
+        else if (arg == "--target") opt.target = value;
+        else if (arg == "--ceiling") opt.ceilingS = atof(value);
+        else if (arg == "--seed") opt.seed = (unsigned)atoi(value);
+        else usage();
+    }
+    if (opt.beds < 1 || opt.beds > 65535 || opt.threads < 1 || opt.batch < 1) usage();
+
+    StandInServer server;
+    std::string target = opt.target;
+    if (target.empty()) {
+        if (!server.start()) {
+            fprintf(stderr, "cannot start the HTTP stand-in\n");
+            return 1;
+        }
+        target = server.address();
+    }
+    sockaddr_in addr;
+    if (!parseTarget(target, addr)) usage();
+
+    printf("%d beds on %d threads, %.0f s per sink, ward timeline %.0fx, HTTP target %s%s\n\n", opt.beds,
+           opt.threads, opt.durationS, opt.compress, target.c_str(), opt.target.empty() ? " (stand-in)" : "");
+    printf("%-8s %9s %9s %8s %8s %8s %7s %12s %10s\n", "sink", "rec/s", "events/s", "p50ms", "p95ms", "p99ms",
+           "fail", "ceil_rec/s", "ceil_MB/s");
+
+    EventMix mix;
+    for (const std::string& name : opt.sinks) {
+        Metrics metrics;
+        EventMix sinkMix;
+        {
+            std::unique_ptr<Sink> sink = makeSink(name, opt, addr, metrics);
+            runWard(opt, *sink, metrics, sinkMix);
+        }
+        Metrics ceiling;
+        int64_t ceilingStart = wallNs();
+        {
+            std::unique_ptr<Sink> sink = makeSink(name, opt, addr, ceiling);
+            runCeiling(opt, *sink);
+        }
+        double ceilingS = (wallNs() - ceilingStart) / 1e9;
+        mix = sinkMix;
+
+        printf("%-8s %9.0f %9.1f %8.1f %8.1f %8.1f %7llu %12.0f %10.2f\n", name.c_str(),
+               metrics.records / opt.durationS, metrics.events / opt.durationS,
+               percentile(metrics.latencyUs, 0.50) / 1000.0, percentile(metrics.latencyUs, 0.95) / 1000.0,
+               percentile(metrics.latencyUs, 0.99) / 1000.0,
+               (unsigned long long)(metrics.failures + ceiling.failures), ceiling.records / ceilingS,
+               ceiling.bytes / ceilingS / 1e6);
+    }
+    printf("\nevents per run: %llu admissions, %llu cleanings (%llu verify timeouts), %llu discharges, "
+           "%llu occupancy changes\n", (unsigned long long)mix.admissions, (unsigned long long)mix.cleanings,
+           (unsigned long long)mix.timeouts, (unsigned long long)mix.discharges,
+           (unsigned long long)mix.occupancy);
+
+    if (opt.target.empty()) server.stop();
+    return 0;
+}
@@ -0,0 +1,359 @@
+// Benchmark of the multiplexed FSR zone path (FEATURE_FSR_ZONES).
+//
+// For 4-8 zones it measures:
+// - the CPU cost of one scan step (zone update) and of the per-scan centre
+//   of pressure + bed-exit evaluation, using pressureZones.h from the firmware;
+// - the scan rate actually reached when steps are taken from a loop whose
+//   passes take --loop-us with an occasional --stall-us blocking pass
+//   (LCD refresh, uplink send), as FsrZones<true>::service() schedules them;
+// - bed-exit detection latency (load crossing the edge -> risk raised) and
+//   false alarms for a restless patient and for someone sitting on an empty bed.
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -I"hardware/ESP8266 Code" tools/fsr_zone_bench.cpp -o fsr_zone_bench
+// Usage:
+//   ./fsr_zone_bench [--step-us 2500] [--loop-us 1200] [--stall-us 30000]
+//                    [--stall-every 500] [--trials 200] [--seed 1]
+//
+// Cycles are read with rdtsc on x86, otherwise derived from std::chrono
+// nanoseconds. The ESP8266 has a single-cycle 32x32 multiply but no divider,
+// so the per-scan divisions weigh more there than on the host; the analogRead
+// itself (tens of us) is the dominant cost of a step on the device.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "pressureZones.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t cycles() { return __rdtsc(); }
+#define CYCLE_UNIT "cycles"
+#else
+static inline uint64_t cycles() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#define CYCLE_UNIT "ns"
+#endif
+
+struct Options {
+    uint32_t stepUs = 2500;
+    uint32_t loopUs = 1200;
+    uint32_t stallUs = 30000;
+    uint32_t stallEvery = 500;
+    int trials = 200;
+    unsigned seed = 1;
+};
+
+// A body on the mattress: load spread over the zones around (x, y)
+struct Body {
+    double load = 0;    // ADC counts summed over all zones
+    double x = 0;       // permille, as in pressureZones.h
+    double y = 0;
+};
+
+class Mattress {
+public:
+    Mattress(uint8_t zones, std::mt19937& random) : count(zones), rng(random) {
+        std::uniform_int_distribution<int> base(20, 60);
+        for (uint8_t i = 0; i < count; i++) {
+            baseline[i] = base(rng);
+        }
+    }
+
+    uint16_t read(uint8_t zone, const Body& body) {
+        ZonePosition p = zonePosition(zone, count);
+        // Bilinear share: one column per side, rows spaced along the bed
+        double wx = p.x == 0 ? 0.5 : (p.x < 0 ? (1000 - body.x) / 2000 : (1000 + body.x) / 2000);
+        uint8_t rows = (count + 1) / 2;
+        double rowSpacing = rows > 1 ? 2000.0 / (rows - 1) : 2000.0;
+        double wy = std::max(0.0, 1 - std::fabs(body.y - p.y) / rowSpacing);
+        double rowTotal = 0;
+        for (uint8_t i = 0; i < count; i += 2) {
+            ZonePosition q = zonePosition(i, count);
+            rowTotal += std::max(0.0, 1 - std::fabs(body.y - q.y) / rowSpacing);
+        }
+        double share = std::max(0.0, wx) * (rowTotal > 0 ? wy / rowTotal : 0);
+        std::normal_distribution<double> noise(0, 4);
+        double value = baseline[zone] + body.load * share + noise(rng);
+        return (uint16_t)std::min(1023.0, std::max(0.0, value));
+    }
+
+private:
+    uint8_t count;
+    std::mt19937& rng;
+    int baseline[ZONE_MAX];
+};
+
+// Loop passes as FsrZones<true>::service() sees them: mostly short, now and
+// then a blocking one
+class LoopModel {
+public:
+    LoopModel(const Options& o, std::mt19937& random) : opt(o), rng(random) {}
+
+    uint32_t nextPass() {
+        std::uniform_int_distribution<uint32_t> jitter(0, opt.loopUs / 2);
+        if (opt.stallEvery > 0 && ++passes % opt.stallEvery == 0) {
+            return opt.stallUs;
+        }
+        return opt.loopUs + jitter(rng);
+    }
+
+private:
+    const Options& opt;
+    std::mt19937& rng;
+    uint32_t passes = 0;
+};
+
+// FsrZones<true> without the hardware: fixed step grid, one zone per step
+template<uint8_t Zones>
+class ZoneScanner {
+public:
+    explicit ZoneScanner(uint32_t step) : stepUs(step), nextStepUs(step) {}
+
+    // Returns true when this call completed a scan
+    template<typename ReadFn>
+    bool service(uint32_t nowUs, bool learn, ReadFn read) {
+        int32_t late = (int32_t)(nowUs - nextStepUs);
+        if (late < 0) {
+            return false;
+        }
+        if (late >= (int32_t)stepUs) {
+            overruns++;
+            nextStepUs = nowUs;
+        } else if ((uint32_t)late > maxLateUs) {
+            maxLateUs = late;
+        }
+        nextStepUs += stepUs;
+        map.update(zone, read(zone), learn);
+        zone = zone + 1 < Zones ? zone + 1 : 0;
+        steps++;
+        return zone == 0;
+    }
+
+    ZonePressureMap<Zones> map;
+    BedExitDetector exit;
+    uint32_t stepUs;
+    uint32_t nextStepUs;
+    uint8_t zone = 0;
+    uint32_t steps = 0;
+    uint32_t overruns = 0;
+    uint32_t maxLateUs = 0;
+};
+
+template<uint8_t Zones>
+static void measureCost(double& stepCycles, double& scanCycles) {
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> value(0, 1023);
+    std::vector<uint16_t> raw(1 << 16);
+    for (auto& r : raw) {
+        r = value(rng);
+    }
+    ZonePressureMap<Zones> map;
+    BedExitDetector exit;
+    uint64_t bestStep = UINT64_MAX;
+    uint64_t bestScan = UINT64_MAX;
+    volatile int32_t sink = 0;
+    for (int run = 0; run < 5; run++) {
+        uint64_t start = cycles();
+        for (size_t i = 0; i < raw.size(); i++) {
+            map.update(i % Zones, raw[i], (i & 1024) != 0);
+        }
+        bestStep = std::min(bestStep, cycles() - start);
+
+        start = cycles();
+        for (size_t i = 0; i < raw.size(); i++) {
+            // Vary the inputs so the compiler cannot hoist the divisions
+            map.update(i % Zones, raw[i], false);
+            sink += exit.update(map.totalLoad(), map.copX(), (uint32_t)i * 16) + map.copY();
+        }
+        bestScan = std::min(bestScan, cycles() - start);
+    }
+    stepCycles = (double)bestStep / raw.size();
+    scanCycles = (double)bestScan / raw.size() - stepCycles;
+}
+
+struct Scenario {
+    uint32_t frames = 0;
+    uint32_t raised = 0;
+    uint32_t firstRaiseMs = 0;  // 0: never raised
+};
+
+// Time-stepped run: body(tMs) drives the readings, scans are taken from the loop model
+template<uint8_t Zones, typename BodyFn>
+static Scenario runScenario(const Options& opt, std::mt19937& rng, uint32_t durationMs, BodyFn body,
+                            ZoneScanner<Zones>& scanner) {
+    Mattress mattress(Zones, rng);
+    LoopModel loop(opt, rng);
+    Scenario result;
+    uint64_t nowUs = 0;
+    // Learn the empty bed first, as readSensors() does while unoccupied
+    Body empty;
+    for (uint32_t t = 0; t < 10000000; t += opt.stepUs) {
+        scanner.service(t, true, [&](uint8_t z) { return mattress.read(z, empty); });
+    }
+    scanner.nextStepUs = 0;
+    while (nowUs < (uint64_t)durationMs * 1000) {
+        uint32_t ms = (uint32_t)(nowUs / 1000);
+        Body b = body(ms);
+        bool learn = b.load < ZONE_EXIT_MIN_LOAD / 2;
+        if (scanner.service((uint32_t)nowUs, learn, [&](uint8_t z) { return mattress.read(z, b); })) {
+            result.frames++;
+            if (scanner.exit.update(scanner.map.totalLoad(), scanner.map.copX(), ms + 1) &&
+                scanner.exit.active()) {
+                result.raised++;
+                if (result.firstRaiseMs == 0) {
+                    result.firstRaiseMs = ms;
+                }
+            }
+        }
+        nowUs += loop.nextPass();
+    }
+    return result;
+}
+
+struct Percentiles {
+    double p50;
+    double p95;
+    double max;
+};
+
+static Percentiles percentiles(std::vector<double> v) {
+    if (v.empty()) {
+        return {-1, -1, -1};
+    }
+    std::sort(v.begin(), v.end());
+    return {v[v.size() / 2], v[std::min(v.size() - 1, v.size() * 95 / 100)], v.back()};
+}
+
+template<uint8_t Zones>
+static void benchZones(const Options& opt) {
+    double stepCycles, scanCycles;
+    measureCost<Zones>(stepCycles, scanCycles);
+
+    std::mt19937 rng(opt.seed * 131 + Zones);
+    std::normal_distribution<double> unit(0, 1);
+    std::vector<double> latencies;
+    uint32_t missed = 0;
+    uint32_t restlessAlarms = 0;
+    uint32_t sittingAlarms = 0;
+    uint64_t frames = 0;
+    uint64_t scanTimeMs = 0;
+    uint32_t overruns = 0;
+    uint32_t maxLate = 0;
+
+    for (int trial = 0; trial < opt.trials; trial++) {
+        // Lies in the middle for 20 s, rolls to one side over 1.5 s, sits on the edge, leaves
+        double side = trial % 2 == 0 ? 1 : -1;
+        double load = 500 + 300 * std::fabs(unit(rng));
+        double rollMs = 1500;
+        uint32_t rollAt = 20000;
+        // The body crosses ZONE_EXIT_EDGE_PERMILLE part way through the roll
+        double edgeFraction = (ZONE_EXIT_EDGE_PERMILLE - 100.0) / (900.0 - 100.0);
+        uint32_t edgeAt = rollAt + (uint32_t)(rollMs * edgeFraction);
+        ZoneScanner<Zones> exitScan(opt.stepUs);
+        Scenario exitRun = runScenario<Zones>(opt, rng, 30000, [&](uint32_t ms) {
+            Body b;
+            b.load = ms < 28000 ? load : 0;
+            b.y = 100;
+            double t = ms < rollAt ? 0 : std::min(1.0, (ms - rollAt) / rollMs);
+            b.x = side * (100 + 800 * t);
+            return b;
+        }, exitScan);
+        // Sensor noise can move the measured COP over the edge a little before the body
+        if (exitRun.firstRaiseMs < rollAt) {
+            missed++;
+        } else {
+            latencies.push_back((double)exitRun.firstRaiseMs - edgeAt);
+        }
+        frames += exitRun.frames;
+        scanTimeMs += 30000;
+        overruns += exitScan.overruns;
+        maxLate = std::max(maxLate, exitScan.maxLateUs);
+
+        // Restless sleeper: turns every few seconds, staying within half the width
+        std::uniform_real_distribution<double> turn(-450, 450);
+        double target = 0;
+        uint32_t nextTurn = 0;
+        ZoneScanner<Zones> restlessScan(opt.stepUs);
+        Scenario restless = runScenario<Zones>(opt, rng, 120000, [&](uint32_t ms) {
+            if (ms >= nextTurn) {
+                target = turn(rng);
+                nextTurn = ms + 2000 + (uint32_t)(ms * 7919u % 6000);
+            }
+            Body b;
+            b.load = load;
+            b.x = target;
+            b.y = 0;
+            return b;
+        }, restlessScan);
+        restlessAlarms += restless.raised;
+        frames += restless.frames;
+        scanTimeMs += 120000;
+        overruns += restlessScan.overruns;
+        maxLate = std::max(maxLate, restlessScan.maxLateUs);
+
+        // Empty bed, someone sits on the edge for a minute
+        ZoneScanner<Zones> sittingScan(opt.stepUs);
+        Scenario sitting = runScenario<Zones>(opt, rng, 90000, [&](uint32_t ms) {
+            Body b;
+            b.load = ms >= 10000 && ms < 70000 ? load * 0.7 : 0;
+            b.x = side * 850;
+            b.y = 300;
+            return b;
+        }, sittingScan);
+        sittingAlarms += sitting.raised;
+        frames += sitting.frames;
+        scanTimeMs += 90000;
+        overruns += sittingScan.overruns;
+        maxLate = std::max(maxLate, sittingScan.maxLateUs);
+    }
+
+    Percentiles p = percentiles(latencies);
+    double nominalHz = 1e6 / ((double)opt.stepUs * Zones);
+    double achievedHz = frames * 1000.0 / scanTimeMs;
+    printf("%5u %9.1f %9.1f %8.1f %8.1f %9.1f %8u %7.0f %7.0f %7.0f %6u %9u %8u\n", Zones, stepCycles, scanCycles,
+           nominalHz, achievedHz, overruns * 60000.0 / scanTimeMs, maxLate, p.p50, p.p95, p.max, missed,
+           restlessAlarms, sittingAlarms);
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr) {
+            fprintf(stderr, "missing value for %s\n", arg);
+            return 1;
+        }
+        if (strcmp(arg, "--step-us") == 0) opt.stepUs = atoi(value);
+        else if (strcmp(arg, "--loop-us") == 0) opt.loopUs = atoi(value);
+        else if (strcmp(arg, "--stall-us") == 0) opt.stallUs = atoi(value);
+        else if (strcmp(arg, "--stall-every") == 0) opt.stallEvery = atoi(value);
+        else if (strcmp(arg, "--trials") == 0) opt.trials = atoi(value);
+        else if (strcmp(arg, "--seed") == 0) opt.seed = atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 1;
+        }
+        i++;
+    }
+
+    printf("step %u us, loop %u us, %u us stall every %u passes, %d trials\n", opt.stepUs, opt.loopUs,
+           opt.stallUs, opt.stallEvery, opt.trials);
+    printf("zones %9s %9s %8s %8s %9s %8s %7s %7s %7s %6s %9s %8s\n", "step", "scan", "nom_Hz", "scan_Hz",
+           "overrun/m", "late_us", "p50_ms", "p95_ms", "max_ms", "missed", "restless", "sitting");
+    printf("      %9s %9s\n", CYCLE_UNIT, CYCLE_UNIT);
+    benchZones<4>(opt);
+    benchZones<5>(opt);
+    benchZones<6>(opt);
+    benchZones<7>(opt);
+    benchZones<8>(opt);
+    return 0;
+}
@@ -0,0 +1,236 @@
+// Check the on-device hourly aggregates (hourlyAggregates.h) against a
+// brute-force recomputation.
+//
+// Generates week-long bed status traces (admissions, cleanings, patients
+// leaving and returning, discharges, idle gaps) observed at irregular loop
+// intervals, with the occasional stalled loop and clock outage. Each trace is
+// fed to HourlyAggregates as the firmware does, draining finished hours as an
+// uplink would. Independently, every hour is recomputed from the whole trace
+// by intersecting each status interval with the hour. Any difference in
+// covered, occupied or cleaning time, or in admissions, cleanings or
+// discharges, is printed and fails the run.
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -I"hardware/ESP8266 Code" tools/hourly_aggregates_check.cpp -o hourly_aggregates_check
+// Usage:
+//   ./hourly_aggregates_check [--traces 20] [--days 7] [--seed 1]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "hourlyAggregates.h"
+
+struct Observation {
+    uint64_t utcMs;
+    BedStatus status;
+};
+
+// Scripted ward: status changes at random times, observed by loop passes
+static std::vector<Observation> makeTrace(std::mt19937_64& rng, double days) {
+    auto minutes = [&](double mean) {
+        std::exponential_distribution<double> d(1.0 / mean);
+        return (uint64_t)(d(rng) * 60000.0) + 1;
+    };
+    // Status script: (time, status) changes
+    std::vector<Observation> script;
+    uint64_t start = 1760000000000ULL + rng() % HOUR_MS;  // Mid-hour boot
+    uint64_t end = start + (uint64_t)(days * 24 * HOUR_MS);
+    uint64_t t = start;
+    bool assigned = rng() % 2;
+    script.push_back({t, assigned ? UNOCCUPIED : UNASSIGNED});
+    while (t < end) {
+        if (!assigned) {
+            t += minutes(90);
+            script.push_back({t, UNOCCUPIED});                  // Card assigns the bed
+            assigned = true;
+            t += minutes(5);
+            script.push_back({t, UNOCCUPIED_CLEANING});
+            t += minutes(20);
+            script.push_back({t, UNOCCUPIED});                  // Verified
+        }
+        t += minutes(30);
+        uint64_t leave = t + minutes(36 * 60);
+        script.push_back({t, OCCUPIED});
+        while (t < leave) {
+            t += minutes(120);
+            switch (rng() % 3) {
+                case 0:
+                    script.push_back({t, UNOCCUPIED});          // Away from bed
+                    t += minutes(10);
+                    script.push_back({t, OCCUPIED});
+                    break;
+                case 1:
+                    script.push_back({t, OCCUPIED_CLEANING});   // Cleaned around the patient
+                    t += minutes(15);
+                    if (rng() % 4 == 0) {
+                        script.push_back({t, UNOCCUPIED_CLEANING});
+                        t += minutes(5);
+                        script.push_back({t, OCCUPIED_CLEANING});
+                        t += minutes(5);
+                    }
+                    script.push_back({t, OCCUPIED});
+                    break;
+                default:
+                    break;
+            }
+        }
+        t += minutes(5);
+        script.push_back({t, UNOCCUPIED});
+        t += minutes(20);
+        script.push_back({t, UNASSIGNED});                      // Discharged
+        assigned = false;
+    }
+
+    // Loop passes: mostly a few ms apart, sometimes a stalled loop or a clock outage
+    std::vector<Observation> trace;
+    size_t next = 0;
+    BedStatus status = script[0].status;
+    for (uint64_t now = start; now < end;) {
+        while (next < script.size() && script[next].utcMs <= now) {
+            status = script[next++].status;
+        }
+        trace.push_back({now, status});
+        uint32_t r = rng() % 100000;
+        if (r == 0) {
+            now += HOURLY_PENDING * HOUR_MS + minutes(60);      // Longer than the pending queue
+        } else if (r < 10) {
+            now += minutes(90);
+        } else if (r < 1000) {
+            now += 1000 + rng() % 20000;
+        } else {
+            now += 1 + rng() % 400;
+        }
+        // Land exactly on some hour boundaries too
+        if (rng() % 5000 == 0) {
+            now = (now / HOUR_MS + 1) * HOUR_MS;
+        }
+    }
+    return trace;
+}
+
+static bool occupiedStatus(BedStatus s) { return s == OCCUPIED || s == OCCUPIED_CLEANING; }
+static bool cleaningStatus(BedStatus s) { return s == OCCUPIED_CLEANING || s == UNOCCUPIED_CLEANING; }
+
+// Every hour from the whole trace: intervals intersected with hours
+static std::map<uint32_t, HourSummary> bruteForce(const std::vector<Observation>& trace) {
+    std::map<uint32_t, HourSummary> hours;
+    auto hourOf = [&](uint64_t t) -> HourSummary& {
+        HourSummary& h = hours[(uint32_t)(t / HOUR_MS)];
+        h.hour = (uint32_t)(t / HOUR_MS);
+        return h;
+    };
+    hourOf(trace[0].utcMs);
+    for (size_t i = 0; i + 1 < trace.size(); i++) {
+        uint64_t from = trace[i].utcMs, to = trace[i + 1].utcMs;
+        BedStatus s = trace[i].status, next = trace[i + 1].status;
+        // Gaps longer than the pending queue are not credited to anything
+        if (to - from <= HOURLY_PENDING * HOUR_MS) {
+            for (uint64_t h = from / HOUR_MS; h * HOUR_MS < to; h++) {
+                uint64_t lo = std::max<uint64_t>(from, h * HOUR_MS);
+                uint64_t hi = std::min<uint64_t>(to, (h + 1) * HOUR_MS);
+                if (hi <= lo) continue;
+                HourSummary& bucket = hourOf(lo);
+                bucket.coveredMs += (uint32_t)(hi - lo);
+                if (occupiedStatus(s)) bucket.occupiedMs += (uint32_t)(hi - lo);
+                if (cleaningStatus(s)) bucket.cleaningMs += (uint32_t)(hi - lo);
+            }
+        }
+        HourSummary& at = hourOf(to);
+        if (next == s) continue;
+        if (s == UNASSIGNED) at.admissions++;
+        else if (next == UNASSIGNED) at.discharges++;
+        else if (cleaningStatus(s) && !cleaningStatus(next)) at.cleanings++;
+    }
+    return hours;
+}
+
+static bool same(const HourSummary& a, const HourSummary& b) {
+    return a.coveredMs == b.coveredMs && a.occupiedMs == b.occupiedMs && a.cleaningMs == b.cleaningMs &&
+           a.admissions == b.admissions && a.cleanings == b.cleanings && a.discharges == b.discharges;
+}
+
+static void print(const char* label, const HourSummary& h) {
+    printf("  %-11s hour=%u covered=%u occupied=%u cleaning=%u adm=%u cln=%u dis=%u\n", label, h.hour,
+           h.coveredMs, h.occupiedMs, h.cleaningMs, h.admissions, h.cleanings, h.discharges);
+}
+
+int main(int argc, char** argv) {
+    int traces = 20;
+    double days = 7;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            fprintf(stderr, "usage: %s [--traces n] [--days d] [--seed n]\n", argv[0]);
+            return 1;
+        }
+        if (arg == "--traces") traces = atoi(argv[++i]);
+        else if (arg == "--days") days = atof(argv[++i]);
+        else if (arg == "--seed") seed = (unsigned)atoi(argv[++i]);
+    }
+
+    std::mt19937_64 rng(seed);
+    uint64_t observations = 0, hoursCompared = 0, mismatches = 0;
+    uint64_t admissions = 0, cleanings = 0, discharges = 0, occupiedMs = 0, coveredMs = 0;
+    double observeNs = 0;
+    for (int n = 0; n < traces; n++) {
+        std::vector<Observation> trace = makeTrace(rng, days);
+        std::map<uint32_t, HourSummary> device;
+        HourlyAggregates aggregates;
+        HourSummary summary;
+        auto t0 = std::chrono::steady_clock::now();
+        for (const Observation& o : trace) {
+            aggregates.observe(o.utcMs, o.status);
+            // Upload keeps up, so nothing is dropped from the pending queue
+            while (aggregates.pending(summary)) {
+                device[summary.hour] = summary;
+                aggregates.uploaded();
+            }
+        }
+        observeNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+        device[aggregates.current().hour] = aggregates.current();
+        observations += trace.size();
+
+        std::map<uint32_t, HourSummary> expected = bruteForce(trace);
+        std::map<uint32_t, bool> hours;
+        for (const auto& h : device) hours[h.first] = true;
+        for (const auto& h : expected) hours[h.first] = true;
+        for (const auto& h : hours) {
+            HourSummary zero = {};
+            zero.hour = h.first;
+            const HourSummary& got = device.count(h.first) ? device[h.first] : zero;
+            const HourSummary& want = expected.count(h.first) ? expected[h.first] : zero;
+            hoursCompared++;
+            admissions += want.admissions;
+            cleanings += want.cleanings;
+            discharges += want.discharges;
+            occupiedMs += want.occupiedMs;
+            coveredMs += want.coveredMs;
+            if (!same(got, want)) {
+                if (mismatches++ < 10) {
+                    printf("trace %d: mismatch\n", n);
+                    print("device", got);
+                    print("brute force", want);
+                }
+            }
+        }
+        if (aggregates.dropped() != 0) {
+            printf("trace %d: %u hours dropped\n", n, aggregates.dropped());
+            mismatches++;
+        }
+    }
+
+    printf("traces=%d observations=%llu hours=%llu mismatches=%llu\n", traces, (unsigned long long)observations,
+           (unsigned long long)hoursCompared, (unsigned long long)mismatches);
+    printf("admissions=%llu cleanings=%llu discharges=%llu occupancy=%.1f%%\n", (unsigned long long)admissions,
+           (unsigned long long)cleanings, (unsigned long long)discharges,
+           coveredMs ? 100.0 * occupiedMs / coveredMs : 0.0);
+    printf("observe: %.1f ns per loop pass, state %zu bytes per bed\n", observeNs / observations,
+           sizeof(HourlyAggregates));
+    return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,362 @@
+// Fan-out benchmark for the LAN push hub (pushHub.h) over real sockets.
+//
+// Runs the firmware's PushHub on loopback with POSIX sockets standing in for
+// WiFiClient (send buffers cut down towards lwIP's, availableForWrite from
+// the unsent byte count) and subscribes --clients EventSource-style readers.
+// The hub publishes --events bed events of device size round-robin over
+// four beds at --rate per second, servicing every --pass us like the loop.
+// Each event carries its publish time, so every reader measures
+// publish-to-receive latency; the spread is first to last reader per event.
+// --slow of the readers take 256 bytes every 50 ms: they must skip events
+// (coalesced into the latest per bed) without holding the others back, and
+// every reader must end on each bed's latest event.
+// A second, shorter run connects the same number of readers, all fast, to a
+// hub with the device's connection cap: all but the cap must get 503.
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -pthread -I"hardware/ESP8266 Code" tools/lan_push_bench.cpp -o lan_push_bench
+// Usage:
+//   ./lan_push_bench [--clients 50] [--slow 5] [--events 2000] [--rate 200] [--pass 1000]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/sockios.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "pushHub.h"
+
+#define BENCH_TOPICS        4       // Beds on one controller
+#define BENCH_BUFFER        768     // LAN_PUSH_BUFFER
+#define BENCH_DEVICE_CAP    4       // LAN_PUSH_MAX_CLIENTS
+#define BENCH_GATEWAY_CAP   64      // A gateway serving a whole ward
+#define BENCH_SNDBUF        2920    // lwIP TCP_SND_BUF: two segments
+#define BENCH_EVENT_JSON    300     // About the size of a bed record
+
+static uint64_t nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t nowMs() { return (uint32_t)(nowNs() / 1000000); }
+
+// WiFiClient as far as PushHub uses it
+struct PosixClient {
+    int fd = -1;
+    int sendBuffer = 0;
+
+    bool connected() {
+        if (fd < 0) return false;
+        char c;
+        ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    }
+    int available() {
+        int n = 0;
+        return fd >= 0 && ioctl(fd, FIONREAD, &n) == 0 ? n : 0;
+    }
+    int read(uint8_t* data, size_t length) {
+        ssize_t n = recv(fd, data, length, MSG_DONTWAIT);
+        return n > 0 ? (int)n : 0;
+    }
+    size_t write(const uint8_t* data, size_t length) {
+        ssize_t n = send(fd, data, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+        return n > 0 ? (size_t)n : 0;
+    }
+    // Unsent bytes against the (halved, as Linux doubles it) send buffer
+    size_t availableForWrite() {
+        int queued = 0;
+        if (fd < 0 || ioctl(fd, SIOCOUTQ, &queued) != 0) return 0;
+        int room = sendBuffer / 2 - queued;
+        return room > 0 ? (size_t)room : 0;
+    }
+    void stop() {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+};
+
+struct Options {
+    int clients = 50;
+    int slow = 5;
+    int events = 2000;
+    int rate = 200;
+    int passUs = 1000;
+};
+
+struct Reader {
+    bool slow = false;
+    int status = 0;                         // HTTP status of the response
+    uint64_t received = 0;
+    uint32_t lastSeq[BENCH_TOPICS] = {};    // Latest event seen per bed
+    std::vector<uint32_t> seqs;
+    std::vector<uint64_t> receivedNs;
+};
+
+static int listenLoopback(uint16_t& port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0) {
+        perror("listen");
+        exit(1);
+    }
+    socklen_t length = sizeof(addr);
+    getsockname(fd, (sockaddr*)&addr, &length);
+    port = ntohs(addr.sin_port);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+// One subscriber: request /events, then parse the stream until told to stop
+static void readStream(uint16_t port, Reader& reader, const std::atomic<bool>& done) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (reader.slow) {
+        int small = 4096;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    }
+    timeval timeout = {0, 50000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return;
+    }
+    static const char REQUEST[] = "GET " PUSH_PATH " HTTP/1.1\r\nHost: bed\r\nAccept: text/event-stream\r\n\r\n";
+    send(fd, REQUEST, sizeof(REQUEST) - 1, MSG_NOSIGNAL);
+
+    std::string pending;
+    bool head = true;
+    uint32_t seq = 0;
+    char chunk[4096];
+    while (!done.load()) {
+        ssize_t n = recv(fd, chunk, reader.slow ? 256 : sizeof(chunk), 0);
+        uint64_t at = nowNs();
+        if (n == 0) break;
+        if (n < 0) continue;
+        pending.append(chunk, (size_t)n);
+        size_t start = 0, end;
+        while ((end = pending.find('\n', start)) != std::string::npos) {
+            std::string line = pending.substr(start, end - start);
+            start = end + 1;
+            if (head) {
+                if (reader.status == 0) reader.status = atoi(line.c_str() + 9);  // "HTTP/1.1 200"
+                head = line != "\r";
+            } else if (line.compare(0, 4, "id: ") == 0) {
+                seq = (uint32_t)strtoul(line.c_str() + 4, nullptr, 10);
+            } else if (line.compare(0, 6, "data: ") == 0) {
+                const char* topic = strstr(line.c_str(), "\"bed\":");
+                if (topic != nullptr) {
+                    reader.lastSeq[atoi(topic + 6) % BENCH_TOPICS] = seq;
+                    reader.seqs.push_back(seq);
+                    reader.receivedNs.push_back(at);
+                    reader.received++;
+                }
+            }
+        }
+        pending.erase(0, start);
+        if (reader.slow) std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    close(fd);
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0;
+    size_t k = (size_t)(p * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+struct Result {
+    int subscribed = 0, rejected = 0, finalWrong = 0;
+    uint64_t fastMissed = 0, slowReceived = 0;
+    double p50 = 0, p99 = 0, max = 0, spread99 = 0, slowP50 = 0;
+    double seconds = 0;
+    PushStats stats = {};
+};
+
+template<uint8_t Cap>
+static Result run(const Options& o, int events) {
+    typedef PushHub<PosixClient, Cap, BENCH_BUFFER, BENCH_TOPICS> Hub;
+    static Hub hub;
+    hub = Hub();
+
+    uint16_t port = 0;
+    int listener = listenLoopback(port);
+    std::vector<Reader> readers(o.clients);
+    for (int i = 0; i < o.slow && i < o.clients; i++) readers[i].slow = true;
+
+    std::atomic<bool> done(false);
+    std::atomic<int> subscribers(0);
+    std::atomic<bool> publishing(false);
+    std::vector<uint64_t> publishedNs(events + 1, 0);
+    uint32_t latest[BENCH_TOPICS] = {};
+    double seconds = 0;
+
+    // The controller: accept, publish on schedule, service every pass
+    std::thread server([&]() {
+        int published = 0;
+        uint64_t startNs = 0, periodNs = 1000000000ULL / (uint64_t)o.rate;
+        uint64_t drainUntil = 0;
+        char json[BENCH_EVENT_JSON + 64];
+        while (!done.load()) {
+            int fd;
+            while ((fd = accept(listener, nullptr, nullptr)) >= 0) {
+                int size = BENCH_SNDBUF, one = 1;
+                setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                PosixClient client;
+                client.fd = fd;
+                socklen_t length = sizeof(client.sendBuffer);
+                getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &client.sendBuffer, &length);
+                hub.add(client, nowMs());
+            }
+            if (publishing.load() && published < events) {
+                uint64_t now = nowNs();
+                if (startNs == 0) startNs = now;
+                while (published < events && now >= startNs + (uint64_t)published * periodNs) {
+                    uint8_t bed = (uint8_t)(published % BENCH_TOPICS);
+                    int length = snprintf(json, sizeof(json), "{\"bed\":%u,\"status\":\"occupied\",\"fsrValue\":%d,"
+                                          "\"pad\":\"", bed, published % 1024);
+                    memset(json + length, 'x', BENCH_EVENT_JSON - length - 2);
+                    strcpy(json + BENCH_EVENT_JSON - 2, "\"}");
+                    publishedNs[hub.sequence() + 1] = nowNs();
+                    hub.publish(bed, json);
+                    latest[bed] = hub.sequence();
+                    published++;
+                }
+                if (published == events) {
+                    seconds = (nowNs() - startNs) / 1e9;
+                    drainUntil = nowNs() + 3000000000ULL;  // Slow readers catch up
+                }
+            }
+            hub.service(nowMs());
+            subscribers.store(hub.subscriberCount());
+            if (drainUntil != 0 && nowNs() >= drainUntil) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(o.passUs));
+        }
+        done.store(true);
+    });
+
+    std::vector<std::thread> threads;
+    for (Reader& reader : readers) {
+        threads.emplace_back(readStream, port, std::ref(reader), std::cref(done));
+    }
+    int expected = o.clients < Cap ? o.clients : Cap;
+    for (int wait = 0; subscribers.load() < expected && wait < 500; wait++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    publishing.store(true);
+    for (std::thread& t : threads) t.join();
+    server.join();
+    hub.service(nowMs());  // Sees the readers gone and closes their sockets
+    close(listener);
+
+    Result r;
+    r.seconds = seconds;
+    r.stats = hub.stats();
+    std::vector<double> latencies, slowLatencies;
+    std::vector<uint64_t> first(events + 1, UINT64_MAX), last(events + 1, 0);
+    for (const Reader& reader : readers) {
+        if (reader.status == 200) r.subscribed++;
+        else if (reader.status == 503) r.rejected++;
+        if (reader.status != 200) continue;
+        for (uint8_t bed = 0; bed < BENCH_TOPICS; bed++) {
+            r.finalWrong += reader.lastSeq[bed] != latest[bed];
+        }
+        if (reader.slow) {
+            r.slowReceived += reader.received;
+        } else {
+            r.fastMissed += (uint64_t)events - reader.received;
+        }
+        for (size_t k = 0; k < reader.seqs.size(); k++) {
+            uint32_t seq = reader.seqs[k];
+            if (seq == 0 || seq > (uint32_t)events || publishedNs[seq] == 0) continue;
+            double ms = (reader.receivedNs[k] - publishedNs[seq]) / 1e6;
+            if (reader.slow) {
+                slowLatencies.push_back(ms);
+                continue;
+            }
+            latencies.push_back(ms);
+            first[seq] = std::min(first[seq], reader.receivedNs[k]);
+            last[seq] = std::max(last[seq], reader.receivedNs[k]);
+        }
+    }
+    std::vector<double> spreads;
+    for (int seq = 1; seq <= events; seq++) {
+        if (last[seq] != 0) spreads.push_back((last[seq] - first[seq]) / 1e6);
+    }
+    r.p50 = percentile(latencies, 0.50);
+    r.p99 = percentile(latencies, 0.99);
+    r.max = latencies.empty() ? 0 : *std::max_element(latencies.begin(), latencies.end());
+    r.spread99 = percentile(spreads, 0.99);
+    r.slowP50 = percentile(slowLatencies, 0.50);
+    return r;
+}
+
+static void print(const char* name, const Options& o, uint8_t cap, const Result& r) {
+    printf("%-8s %4d %4u %6d %6d %8lu %7.2f %7.2f %7.2f %8.2f %9lu %8lu %9.1f %7lu %6d\n", name, o.clients, cap,
+           r.subscribed, r.rejected, (unsigned long)r.stats.events, r.p50, r.p99, r.max, r.spread99,
+           (unsigned long)r.fastMissed, (unsigned long)r.slowReceived, r.slowP50,
+           (unsigned long)r.stats.coalesced, r.finalWrong);
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "--clients") o.clients = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--slow") o.slow = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--events") o.events = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--rate") o.rate = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--pass") o.passUs = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--clients n] [--slow n] [--events n] [--rate per_s] [--pass us]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (o.clients < 1 || o.clients > BENCH_GATEWAY_CAP || o.slow > o.clients || o.events < 1 || o.rate < 1) {
+        fprintf(stderr, "--clients 1-%d, --slow at most --clients, --events and --rate at least 1\n",
+                BENCH_GATEWAY_CAP);
+        return 1;
+    }
+
+    printf("%-8s %4s %4s %6s %6s %8s %7s %7s %7s %8s %9s %8s %9s %7s %6s\n", "hub", "clnt", "cap", "subscr",
+           "503", "events", "p50_ms", "p99_ms", "max_ms", "sprd_p99", "fast_miss", "slow_rx", "slow_p50",
+           "coalesc", "stale");
+    Result gateway = run<BENCH_GATEWAY_CAP>(o, o.events);
+    print("gateway", o, BENCH_GATEWAY_CAP, gateway);
+    Options capped = o;
+    capped.slow = 0;  // Whoever gets a slot reads at full speed
+    Result device = run<BENCH_DEVICE_CAP>(capped, o.events / 10 > 0 ? o.events / 10 : 1);
+    print("device", capped, BENCH_DEVICE_CAP, device);
+    printf("gateway: %.0f events/s to %d subscribers, %.1f MB/s written\n", gateway.stats.events / gateway.seconds,
+           gateway.subscribed, gateway.stats.bytes / gateway.seconds / 1e6);
+    printf("p50/p99/max: publish to receive on the %d fast subscribers; sprd_p99: first to last subscriber per "
+           "event\nfast_miss: events fast subscribers did not get; stale: subscriber/bed pairs not ending on the "
+           "latest event\n", o.clients - o.slow);
+
+    bool ok = gateway.subscribed == o.clients && gateway.finalWrong == 0 && device.finalWrong == 0 &&
+              device.subscribed == std::min(o.clients, BENCH_DEVICE_CAP) &&
+              device.subscribed + device.rejected == o.clients;
+    return ok ? 0 : 1;
+}
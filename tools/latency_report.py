@@ -0,0 +1,103 @@
+"""Per-stage latency report for captured bed event traces.
+
+Reads trace records captured by the dashboard under `latencyTraces/`
+(enable with localStorage.setItem('latencyTraceCapture', 'true')).
+Accepts either a Firebase JSON export of that node ({id: record}) or a
+JSON-lines file with one record per line.
+
+Usage:
+    python tools/latency_report.py latencyTraces.json [--by-status]
+"""
+import argparse
+import json
+import sys
+
+# (name, start field, end field, needs device->UTC offset on start, on end)
+# Device stages are monotonic ms; server/browser stages are UTC ms.
+STAGES = [
+    ('confirm (sample->decision)', 'sampleMs', 'decisionMs', False, False),
+    ('queue (decision->enqueue)', 'decisionMs', 'enqueueMs', False, False),
+    ('uplink (enqueue->ack)', 'enqueueMs', 'ackMs', False, False),
+    ('to server (enqueue->serverMs)', 'enqueueMs', 'serverMs', True, False),
+    ('delivery (serverMs->receivedAt)', 'serverMs', 'receivedAt', False, False),
+    ('render (receivedAt->renderedAt)', 'receivedAt', 'renderedAt', False, False),
+    ('total (sample->renderedAt)', 'sampleMs', 'renderedAt', True, False),
+]
+
+
+def load_records(path):
+    with open(path) as f:
+        text = f.read().strip()
+    if not text:
+        return []
+    if text.startswith('{') and '\n{' not in text:
+        data = json.loads(text)
+        # Firebase export keyed by trace id, or a single record
+        if 'sampleMs' in data:
+            return [data]
+        return [dict(record, id=trace_id) for trace_id, record in data.items()]
+    return [json.loads(line) for line in text.splitlines() if line.strip()]
+
+
+def stage_latency(record, start, end, start_is_device, end_is_device):
+    a = record.get(start)
+    b = record.get(end)
+    if not a or not b:
+        return None
+    offset = record.get('deviceOffsetMs')
+    if start_is_device or end_is_device:
+        if offset is None:
+            return None  # Device clock was unsynced, cannot compare with UTC stages
+        if start_is_device:
+            a += offset
+        if end_is_device:
+            b += offset
+    return b - a
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return None
+    k = (len(sorted_values) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(sorted_values) - 1)
+    return sorted_values[lo] + (sorted_values[hi] - sorted_values[lo]) * (k - lo)
+
+
+def print_report(records, title):
+    print(f'\n{title} ({len(records)} traces)')
+    print(f'{"stage":34} {"n":>5} {"min":>8} {"p50":>8} {"p90":>8} {"p99":>8} {"max":>8}')
+    for name, start, end, start_dev, end_dev in STAGES:
+        values = sorted(
+            v for v in (stage_latency(r, start, end, start_dev, end_dev) for r in records)
+            if v is not None
+        )
+        if not values:
+            print(f'{name:34} {0:>5} {"-":>8} {"-":>8} {"-":>8} {"-":>8} {"-":>8}')
+            continue
+        row = [values[0], percentile(values, 50), percentile(values, 90),
+               percentile(values, 99), values[-1]]
+        print(f'{name:34} {len(values):>5} ' + ' '.join(f'{v:>8.0f}' for v in row))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Per-stage latency report (ms) for bed event traces')
+    parser.add_argument('path', help='latencyTraces JSON export or JSON-lines capture')
+    parser.add_argument('--by-status', action='store_true', help='also break down by resulting status')
+    args = parser.parse_args()
+
+    records = load_records(args.path)
+    if not records:
+        print('No trace records found')
+        return 1
+
+    print_report(records, 'All events')
+    if args.by_status:
+        statuses = sorted({r.get('status') or 'unknown' for r in records})
+        for status in statuses:
+            print_report([r for r in records if (r.get('status') or 'unknown') == status], status)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
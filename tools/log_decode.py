@@ -0,0 +1,147 @@
+"""Decode the firmware's binary log stream back into text.
+
+The firmware sends log records as binary frames (see eventLog.h) mixed with
+plain-text command replies. Message formats are read from logMessages.h, so
+the decoder always matches the source tree it is run from.
+
+Usage:
+    python tools/log_decode.py capture.bin            # a saved capture
+    python tools/log_decode.py /dev/ttyUSB0 --baud 115200   # live (needs pyserial)
+    cat capture.bin | python tools/log_decode.py -
+"""
+import argparse
+import os
+import re
+import struct
+import sys
+
+FRAME_SYNC = 0xA5
+HEADER_SIZE = 7  # sync, id, length, millis
+DEFAULT_CATALOG = os.path.join(os.path.dirname(__file__), '..', 'hardware', 'ESP8266 Code',
+                               'logMessages.h')
+
+ENTRY = re.compile(r'X\(\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)')
+CONVERSION = re.compile(r'%(l*)([dusx%])')
+
+
+def load_catalog(path):
+    """Message formats in ID order, as the X-macro list assigns them."""
+    with open(path) as f:
+        text = f.read()
+    return [(name, bytes(fmt, 'utf-8').decode('unicode_escape')) for name, fmt in ENTRY.findall(text)]
+
+
+def render(fmt, payload):
+    at = 0
+    out = []
+    pos = 0
+    for match in CONVERSION.finditer(fmt):
+        out.append(fmt[pos:match.start()])
+        pos = match.end()
+        conversion = match.group(2)
+        if conversion == '%':
+            out.append('%')
+        elif conversion == 's':
+            if at >= len(payload):
+                out.append('?')
+                continue
+            length = payload[at]
+            out.append(payload[at + 1:at + 1 + length].decode('utf-8', 'replace'))
+            at += 1 + length
+        else:
+            if at + 4 > len(payload):
+                out.append('?')
+                continue
+            value, = struct.unpack_from('<i' if conversion == 'd' else '<I', payload, at)
+            out.append(format(value, 'x') if conversion == 'x' else str(value))
+            at += 4
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+
+class Decoder:
+    def __init__(self, catalog, show_ids=False):
+        self.catalog = catalog
+        self.show_ids = show_ids
+        self.buffer = bytearray()
+        self.bad_frames = 0
+
+    def feed(self, data):
+        """Returns decoded lines; plain text outside frames is passed through."""
+        self.buffer.extend(data)
+        lines = []
+        while self.buffer:
+            sync = self.buffer.find(FRAME_SYNC)
+            if sync != 0:
+                text = self.buffer if sync < 0 else self.buffer[:sync]
+                lines.append(text.decode('utf-8', 'replace'))
+                del self.buffer[:len(text)]
+                continue
+            if len(self.buffer) < HEADER_SIZE:
+                break
+            msg_id, length = self.buffer[1], self.buffer[2]
+            end = HEADER_SIZE + length + 1
+            if len(self.buffer) < end:
+                break
+            check = 0
+            for b in self.buffer[:end - 1]:
+                check ^= b
+            if check != self.buffer[end - 1]:
+                # Not a frame (or a corrupted one): skip the sync byte and resync
+                self.bad_frames += 1
+                del self.buffer[:1]
+                continue
+            stamp, = struct.unpack_from('<I', self.buffer, 3)
+            payload = bytes(self.buffer[HEADER_SIZE:end - 1])
+            del self.buffer[:end]
+            if msg_id < len(self.catalog):
+                name, fmt = self.catalog[msg_id]
+                text = render(fmt, payload)
+                if self.show_ids:
+                    text = '%s %s' % (name, text)
+            else:
+                text = '<unknown message %d: %s>' % (msg_id, payload.hex())
+            lines.append('[%d] %s\n' % (stamp, text))
+        return lines
+
+
+def open_source(path, baud):
+    if path == '-':
+        return sys.stdin.buffer
+    if path.startswith('/dev/') or path.upper().startswith('COM'):
+        try:
+            import serial
+        except ImportError:
+            sys.exit('Reading a serial port needs pyserial (pip install pyserial)')
+        return serial.Serial(path, baud, timeout=0.2)
+    return open(path, 'rb')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('source', help="capture file, serial port, or '-' for stdin")
+    parser.add_argument('--catalog', default=DEFAULT_CATALOG, help='path to logMessages.h')
+    parser.add_argument('--baud', type=int, default=115200)
+    parser.add_argument('--ids', action='store_true', help='prefix messages with their ID name')
+    args = parser.parse_args()
+
+    decoder = Decoder(load_catalog(args.catalog), args.ids)
+    source = open_source(args.source, args.baud)
+    try:
+        while True:
+            chunk = source.read(256)
+            if not chunk:
+                if args.source.startswith('/dev/') or args.source.upper().startswith('COM'):
+                    continue
+                break
+            for line in decoder.feed(chunk):
+                sys.stdout.write(line)
+            sys.stdout.flush()
+    except KeyboardInterrupt:
+        pass
+    if decoder.bad_frames:
+        sys.stderr.write('%d corrupted frames skipped\n' % decoder.bad_frames)
+
+
+if __name__ == '__main__':
+    main()
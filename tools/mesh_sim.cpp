@@ -0,0 +1,408 @@
+// Host simulation of the bed-to-bed ESP-NOW relay (meshProtocol.h).
+//
+// Beds sit on a jittered grid; every pair within radio range shares a lossy
+// link. Each node runs the firmware's MeshNode unchanged over a simulated
+// 1 Mbit/s ESP-NOW channel with carrier sense, hidden-node collisions and MAC
+// acks. Beds publish a heartbeat plus random status changes. Halfway through,
+// the busiest gateway is switched off to measure failover.
+//
+// Reported per node count:
+//   delivered  share of published states that reached a gateway (superseded
+//              states, replaced in a queue by a newer one, count as not delivered)
+//   p50/p95/p99 sample-to-gateway latency
+//   air avg/max share of time the channel is busy as heard by a node (mean, worst)
+//   failover   time from the gateway loss until all of its nodes follow a live one
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -I"hardware/ESP8266 Code" tools/mesh_sim.cpp -o mesh_sim
+// Usage:
+//   ./mesh_sim [--nodes 50,100,200,500] [--loss 0.05] [--range 15] [--spacing 4]
+//              [--capable 0.1] [--heartbeat 10] [--event-interval 120]
+//              [--duration 600] [--seed 1]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "meshProtocol.h"
+
+// 802.11b long preamble at 1 Mbit/s; vendor action frame adds 43 bytes of MAC overhead
+static const uint32_t PREAMBLE_US = 192;
+static const uint32_t MAC_OVERHEAD_BYTES = 43;
+static const uint32_t ACK_US = PREAMBLE_US + 14 * 8;
+static const uint32_t SIFS_US = 10;
+static const uint32_t SLOT_US = 20;         // Starts closer than this collide despite carrier sense
+
+struct Options {
+    std::vector<int> nodes = {50, 100, 200, 500};
+    double loss = 0.05;
+    double range = 15.0;
+    double spacing = 4.0;
+    double capable = 0.1;
+    double heartbeatS = 10.0;
+    double eventIntervalS = 120.0;
+    double durationS = 600.0;
+    unsigned seed = 1;
+};
+
+struct Simulation;
+
+struct SimRadio {
+    Simulation* sim = nullptr;
+    uint16_t self = 0;
+    void send(uint16_t dst, const uint8_t* frame, uint8_t length);
+    void deliver(const MeshState& state, uint32_t nowMs);
+    uint32_t random(uint32_t limit);
+};
+
+struct Transmission {
+    uint16_t from;
+    uint16_t dst;
+    uint64_t startUs;
+    uint64_t endUs;
+    std::vector<uint8_t> frame;
+};
+
+struct Node {
+    SimRadio radio;
+    MeshNode<SimRadio> mesh{radio};
+    double x = 0, y = 0;
+    bool alive = true;
+    bool booted = false;
+    uint32_t bootMs = 0;
+    std::vector<Transmission> pending;     // Waiting for the channel
+    uint16_t seq = 0;
+    uint64_t nextHeartbeatMs = 0;
+    uint64_t nextEventMs = 0;
+    uint64_t airHeardUs = 0;
+    uint32_t delivered = 0;                // As gateway
+};
+
+struct Simulation {
+    const Options& opt;
+    std::mt19937 rng;
+    std::vector<Node> nodes;
+    std::vector<std::vector<uint16_t>> neighbours;
+    std::vector<std::vector<float>> linkLoss;      // Dense, indexed [a][b]; 0 means out of range
+    std::vector<Transmission> onAir;
+    std::unordered_map<uint32_t, uint64_t> published;   // bed << 16 | seq -> sample time
+    std::vector<uint32_t> latencies;
+    uint64_t nowMs = 0;
+    uint64_t measureFromMs = 0;
+    uint64_t publishCount = 0;
+
+    Simulation(const Options& o, int count) : opt(o), rng(o.seed * 7919u + count), nodes(count) {
+        int side = (int)std::ceil(std::sqrt((double)count));
+        std::uniform_real_distribution<double> jitter(-0.3, 0.3);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        for (int i = 0; i < count; i++) {
+            Node& n = nodes[i];
+            n.radio.sim = this;
+            n.radio.self = i;
+            n.x = (i % side + jitter(rng)) * opt.spacing;
+            n.y = (i / side + jitter(rng)) * opt.spacing;
+            n.bootMs = rng() % 5000;
+        }
+        neighbours.assign(count, {});
+        linkLoss.assign(count, std::vector<float>(count, 0.0f));
+        for (int a = 0; a < count; a++) {
+            for (int b = 0; b < count; b++) {
+                double d = std::hypot(nodes[a].x - nodes[b].x, nodes[a].y - nodes[b].y);
+                if (a == b || d > opt.range) continue;
+                // Loss grows towards the edge of the range
+                double r = d / opt.range;
+                linkLoss[a][b] = (float)std::min(0.95, opt.loss + 0.3 * r * r * r * r);
+                neighbours[a].push_back(b);
+            }
+        }
+    }
+
+    uint8_t gatewayScore() {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        return unit(rng) < opt.capable ? (uint8_t)(1 + rng() % 255) : 0;
+    }
+
+    static uint32_t airtimeUs(size_t length) {
+        return PREAMBLE_US + (uint32_t)(length + MAC_OVERHEAD_BYTES) * 8;
+    }
+
+    bool lost(uint16_t a, uint16_t b) {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        return unit(rng) < linkLoss[a][b];
+    }
+
+    void publish(uint16_t i) {
+        Node& n = nodes[i];
+        MeshState state = {};
+        state.bed = i;
+        state.seq = ++n.seq;
+        state.status = rng() % 7;
+        if (nowMs >= measureFromMs) {
+            published[(uint32_t)i << 16 | state.seq] = nowMs;
+            publishCount++;
+        }
+        n.mesh.publish(state, (uint32_t)nowMs);
+    }
+
+    void onDeliver(uint16_t gateway, const MeshState& state) {
+        nodes[gateway].delivered++;
+        auto it = published.find((uint32_t)state.bed << 16 | state.seq);
+        if (it == published.end()) return;
+        latencies.push_back((uint32_t)(nowMs - it->second));
+        published.erase(it);
+    }
+
+    // Start queued transmissions where the channel is free (as sensed by the sender)
+    void startTransmissions() {
+        uint64_t tickUs = nowMs * 1000;
+        for (uint16_t i = 0; i < nodes.size(); i++) {
+            Node& n = nodes[i];
+            if (n.pending.empty()) continue;
+            Transmission& tx = n.pending.front();
+            uint64_t start = tickUs + rng() % 900;
+            uint64_t end = start + airtimeUs(tx.frame.size());
+            if (tx.dst != MESH_BROADCAST) end += SIFS_US + ACK_US;
+            bool busy = false;
+            for (const Transmission& other : onAir) {
+                bool heard = other.from == i || linkLoss[i][other.from] > 0;
+                bool overlap = other.startUs < end && start < other.endUs;
+                if (heard && overlap && (start > other.startUs ? start - other.startUs : other.startUs - start) >= SLOT_US) {
+                    busy = true;
+                    break;
+                }
+            }
+            if (busy) continue;  // Defer to the next tick
+            tx.startUs = start;
+            tx.endUs = end;
+            onAir.push_back(std::move(tx));
+            n.pending.erase(n.pending.begin());
+        }
+    }
+
+    // Resolve transmissions that ended during this tick
+    void finishTransmissions() {
+        uint64_t boundaryUs = (nowMs + 1) * 1000;
+        std::vector<Transmission> done;
+        for (size_t k = 0; k < onAir.size();) {
+            if (onAir[k].endUs <= boundaryUs) {
+                done.push_back(std::move(onAir[k]));
+                onAir.erase(onAir.begin() + k);
+            } else {
+                k++;
+            }
+        }
+        // Collisions are judged against everything on air in the same window
+        std::vector<const Transmission*> window;
+        for (const Transmission& t : done) window.push_back(&t);
+        for (const Transmission& t : onAir) window.push_back(&t);
+
+        for (const Transmission& tx : done) {
+            uint32_t air = (uint32_t)(tx.endUs - tx.startUs);
+            nodes[tx.from].airHeardUs += air;
+            for (uint16_t r : neighbours[tx.from]) nodes[r].airHeardUs += air;
+
+            auto receivedBy = [&](uint16_t r) {
+                if (!nodes[r].alive || !nodes[r].booted) return false;
+                for (const Transmission* other : window) {
+                    if (other == &tx) continue;
+                    bool overlap = other->startUs < tx.endUs && tx.startUs < other->endUs;
+                    if (overlap && (other->from == r || linkLoss[r][other->from] > 0)) return false;
+                }
+                return !lost(tx.from, r);
+            };
+
+            if (tx.dst == MESH_BROADCAST) {
+                for (uint16_t r : neighbours[tx.from]) {
+                    if (receivedBy(r)) nodes[r].mesh.receive(tx.frame.data(), tx.frame.size(), (uint32_t)nowMs);
+                }
+                continue;
+            }
+            bool acked = false;
+            if (linkLoss[tx.from][tx.dst] > 0 && receivedBy(tx.dst)) {
+                nodes[tx.dst].mesh.receive(tx.frame.data(), tx.frame.size(), (uint32_t)nowMs);
+                acked = !lost(tx.dst, tx.from);
+            }
+            if (nodes[tx.from].alive) nodes[tx.from].mesh.sendDone(acked, (uint32_t)nowMs);
+        }
+    }
+
+    // Nodes that followed the failed gateway and have not found a live one yet
+    bool stranded(const std::vector<uint16_t>& orphans, uint16_t dead) const {
+        for (uint16_t i : orphans) {
+            const Node& n = nodes[i];
+            if (!n.mesh.hasRoute() || n.mesh.gateway() == dead) return true;
+        }
+        return false;
+    }
+
+    void run(uint64_t& failoverMs) {
+        std::exponential_distribution<double> eventGap(1.0 / (opt.eventIntervalS * 1000.0));
+        uint64_t warmupMs = 30000;
+        uint64_t endMs = warmupMs + (uint64_t)(opt.durationS * 1000);
+        uint64_t drainMs = endMs + 10000;
+        uint64_t failAtMs = warmupMs + (endMs - warmupMs) / 2;
+        measureFromMs = warmupMs;
+        failoverMs = 0;
+        bool failed = false;
+        bool recovered = false;
+        uint16_t dead = MESH_NO_NODE;
+        std::vector<uint16_t> orphans;
+
+        for (Node& n : nodes) {
+            n.nextHeartbeatMs = n.bootMs + rng() % (uint64_t)(opt.heartbeatS * 1000);
+            n.nextEventMs = n.bootMs + (uint64_t)eventGap(rng);
+        }
+
+        for (nowMs = 0; nowMs < drainMs; nowMs++) {
+            if (!failed && nowMs == failAtMs) {
+                auto busiest = std::max_element(nodes.begin(), nodes.end(), [](const Node& a, const Node& b) {
+                    return (a.alive && a.mesh.isGateway() ? a.delivered : 0) <
+                           (b.alive && b.mesh.isGateway() ? b.delivered : 0);
+                });
+                if (busiest->mesh.isGateway()) {
+                    busiest->alive = false;
+                    busiest->pending.clear();
+                    failed = true;
+                    dead = busiest->mesh.nodeId();
+                    for (uint16_t i = 0; i < nodes.size(); i++) {
+                        if (nodes[i].alive && nodes[i].mesh.gateway() == dead) orphans.push_back(i);
+                    }
+                }
+            }
+            for (uint16_t i = 0; i < nodes.size(); i++) {
+                Node& n = nodes[i];
+                if (!n.alive) continue;
+                if (!n.booted) {
+                    if (nowMs < n.bootMs) continue;
+                    n.booted = true;
+                    n.mesh.begin(i, gatewayScore(), (uint32_t)nowMs);
+                }
+                if (nowMs < endMs) {
+                    bool changed = nowMs >= n.nextEventMs;
+                    if (changed) n.nextEventMs = nowMs + 1 + (uint64_t)eventGap(rng);
+                    if (changed || nowMs >= n.nextHeartbeatMs) {
+                        n.nextHeartbeatMs = nowMs + (uint64_t)(opt.heartbeatS * 1000);
+                        publish(i);
+                    }
+                }
+                n.mesh.tick((uint32_t)nowMs);
+            }
+            startTransmissions();
+            finishTransmissions();
+            if (failed && !recovered && nowMs % 100 == 0 && !stranded(orphans, dead)) {
+                recovered = true;
+                failoverMs = nowMs - failAtMs;
+            }
+        }
+        if (failed && !recovered) failoverMs = UINT64_MAX;
+    }
+};
+
+void SimRadio::send(uint16_t dst, const uint8_t* frame, uint8_t length) {
+    Node& n = sim->nodes[self];
+    if (!n.alive) return;
+    // ESP-NOW buffers a handful of frames; beyond that esp_now_send fails
+    if (n.pending.size() >= 4) {
+        if (dst != MESH_BROADCAST) n.mesh.sendDone(false, (uint32_t)sim->nowMs);
+        return;
+    }
+    n.pending.push_back({self, dst, 0, 0, std::vector<uint8_t>(frame, frame + length)});
+}
+
+void SimRadio::deliver(const MeshState& state, uint32_t) {
+    sim->onDeliver(self, state);
+}
+
+uint32_t SimRadio::random(uint32_t limit) {
+    return limit ? sim->rng() % limit : 0;
+}
+
+static uint32_t percentile(std::vector<uint32_t>& values, double p) {
+    if (values.empty()) return 0;
+    size_t k = (size_t)(p * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+static void usage() {
+    fprintf(stderr, "usage: mesh_sim [--nodes 50,100,200,500] [--loss p] [--range m] [--spacing m] "
+                    "[--capable fraction] [--heartbeat s] [--event-interval s] [--duration s] [--seed n]\n");
+    exit(1);
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) usage();
+        const char* value = argv[++i];
+        if (arg == "--nodes") {
+            opt.nodes.clear();
+            for (const char* p = value; *p;) {
+                opt.nodes.push_back(atoi(p));
+                p = strchr(p, ',');
+                if (!p) break;
+                p++;
+            }
+        } else if (arg == "--loss") opt.loss = atof(value);
+        else if (arg == "--range") opt.range = atof(value);
+        else if (arg == "--spacing") opt.spacing = atof(value);
+        else if (arg == "--capable") opt.capable = atof(value);
+        else if (arg == "--heartbeat") opt.heartbeatS = atof(value);
+        else if (arg == "--event-interval") opt.eventIntervalS = atof(value);
+        else if (arg == "--duration") opt.durationS = atof(value);
+        else if (arg == "--seed") opt.seed = (unsigned)atoi(value);
+        else usage();
+    }
+
+    printf("loss=%.2f range=%.0fm spacing=%.0fm capable=%.0f%% heartbeat=%.0fs events every %.0fs, %.0fs\n\n",
+           opt.loss, opt.range, opt.spacing, opt.capable * 100, opt.heartbeatS, opt.eventIntervalS,
+           opt.durationS);
+    printf("%6s %4s %5s %10s %8s %8s %8s %7s %7s %6s %8s %7s %10s\n", "nodes", "gws", "hops", "published",
+           "deliv%", "p50ms", "p95ms", "p99ms", "air%", "max%", "retries", "drops", "failover");
+
+    for (int count : opt.nodes) {
+        if (count < 2 || count >= MESH_NO_NODE) usage();
+        Simulation sim(opt, count);
+        uint64_t failoverMs = 0;
+        sim.run(failoverMs);
+
+        int gateways = 0;
+        double hops = 0;
+        int routed = 0;
+        MeshStats total = {};
+        uint64_t maxHeard = 0;
+        uint64_t sumHeard = 0;
+        for (const Node& n : sim.nodes) {
+            const MeshStats& s = n.mesh.stats();
+            total.retries += s.retries;
+            total.retryDrops += s.retryDrops;
+            total.queueDrops += s.queueDrops;
+            sumHeard += n.airHeardUs;
+            maxHeard = std::max(maxHeard, n.airHeardUs);
+            if (!n.alive) continue;
+            if (n.mesh.isGateway()) gateways++;
+            if (n.mesh.hasRoute()) {
+                hops += n.mesh.hops();
+                routed++;
+            }
+        }
+        double simUs = (double)sim.nowMs * 1000.0;
+        double deliveredPct = sim.publishCount ? 100.0 * sim.latencies.size() / sim.publishCount : 0;
+        char failover[32];
+        if (failoverMs == UINT64_MAX) snprintf(failover, sizeof(failover), "never");
+        else snprintf(failover, sizeof(failover), "%llums", (unsigned long long)failoverMs);
+
+        printf("%6d %4d %5.1f %10llu %7.1f%% %8u %8u %7u %6.1f%% %5.1f%% %8u %7u %10s\n", count, gateways,
+               routed ? hops / routed : 0.0, (unsigned long long)sim.publishCount, deliveredPct,
+               percentile(sim.latencies, 0.50), percentile(sim.latencies, 0.95),
+               percentile(sim.latencies, 0.99), 100.0 * sumHeard / count / simUs, 100.0 * maxHeard / simUs,
+               total.retries, total.retryDrops + total.queueDrops, failover);
+    }
+    return 0;
+}
@@ -0,0 +1,1184 @@
+// Delta patches for the firmware's OTA updates (otaDelta.h, otaUpdate.h):
+// makes them, and checks the update path end to end on the host.
+//
+// make: a patch that rebuilds new.bin from old.bin. Both images are taken to
+//   the size the device hashes (ESP.getSketchSize(): the segments of the app
+//   image at 0x1000, rounded as the core does). Matching is bsdiff style:
+//   8-byte hash hits in the old image extended forward while at least half
+//   the bytes agree, so code that moved with its addresses changed becomes a
+//   run of small byte differences; what matches nothing is inserted. The op
+//   stream is then LZSS compressed with the window the device decodes with.
+//   Publish the patch as <patchBase>/<old CRC>-<new CRC>.cldp; the /ota
+//   fields to set are printed.
+// full: a whole-image patch for units whose image has no delta, published as
+//   <patchBase>/full-<new CRC>.cldp.
+// check: the device's installer and HTTP fetch on a memory flash, against a
+//   loopback file server, on synthetic images (code with literal pools and
+//   relative calls; a version with functions inserted, one with constants
+//   changed, and unrelated builds):
+//   - patch size against the whole image, compressed and raw
+//   - update, switch, confirm after the health period
+//   - never healthy: rolled back after the trial timeout; crash loop: rolled
+//     back after OTA_TRIAL_BOOTS boots; a rolled-back image is not fetched again
+//   - mesh gateway on trial whose WiFi is broken: resigns, relays through the
+//     other bed and is still rolled back; one that connects is confirmed
+//   - corrupt patch, patch for another image, an image with the published
+//     CRC but not its SHA-256, missing patch (whole image instead), dribbled,
+//     chunked and dropped downloads, power lost mid-download and between the
+//     trial record and the switch
+//   - start times of --beds beds with sequential chip IDs: waves and peak
+//     concurrent downloads against starting all at once
+//   - fixed RAM of the installer and the fetch; otaCrc32 against flashCrc32,
+//     the host SHA-256 against the FIPS 180-2 examples
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -pthread -DFEATURE_PERSISTENCE=0 -I"hardware/ESP8266 Code" tools/ota_delta.cpp -o ota_delta
+// Usage:
+//   ./ota_delta make old.bin new.bin out.cldp
+//   ./ota_delta full new.bin out.cldp
+//   ./ota_delta check [--beds 200] [--seed 1]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "otaUpdate.h"
+#include "meshProtocol.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+static const uint32_t APP_OFFSET = 0x1000;          // App image header, after eboot
+static const uint32_t APP_LOAD = 0x40201010;        // Where the sketch is mapped
+static const uint32_t SKETCH_SPACE = 0x200000;      // 4M2M layout: FS_PHYS_ADDR
+
+static uint32_t le32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void put32(Bytes& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+// As ESP.getSketchSize(): header at 0x1000, its segments, then (pos + 16) & ~15.
+// 0 if the bytes are not an image.
+static uint32_t sketchSize(const uint8_t* image, size_t size) {
+    if (size < APP_OFFSET + 8 || image[APP_OFFSET] != OTA_IMAGE_MAGIC) {
+        return 0;
+    }
+    uint32_t pos = APP_OFFSET + 8;
+    uint8_t segments = image[APP_OFFSET + 1];
+    for (uint8_t i = 0; i < segments; i++) {
+        if (pos + 8 > size) return 0;
+        pos += 8 + le32(image + pos + 4);
+    }
+    return (pos + 16) & ~15u;
+}
+
+// The bytes the device hashes: the image to its sketch size, past the end of
+// the file as erased flash
+static Bytes sketchBytes(const Bytes& file) {
+    uint32_t size = sketchSize(file.data(), file.size());
+    Bytes image = file;
+    image.resize(size != 0 ? size : file.size(), 0xFF);
+    return image;
+}
+
+static uint32_t crcOf(const Bytes& data) { return otaCrc32(0, data.data(), data.size()); }
+
+struct Digest {
+    uint8_t bytes[OTA_DIGEST_BYTES];
+    char hex[2 * OTA_DIGEST_BYTES + 1];
+};
+
+static Digest digestOf(const Bytes& data) {
+    Digest digest;
+    br_sha256_context context;
+    br_sha256_init(&context);
+    br_sha256_update(&context, data.data(), data.size());
+    br_sha256_out(&context, digest.bytes);
+    for (size_t i = 0; i < OTA_DIGEST_BYTES; i++) snprintf(digest.hex + 2 * i, 3, "%02x", digest.bytes[i]);
+    return digest;
+}
+
+// ---- Patch writer ----
+
+struct OpStream {
+    Bytes out;
+
+    void count(uint32_t n) {
+        do {
+            out.push_back((uint8_t)((n & 0x7F) | (n > 0x7F ? 0x80 : 0)));
+            n >>= 7;
+        } while (n != 0);
+    }
+
+    void insert(const uint8_t* data, size_t n) {
+        if (n == 0) return;
+        out.push_back(OTA_OP_INSERT);
+        count((uint32_t)n);
+        out.insert(out.end(), data, data + n);
+    }
+
+    void seek(int64_t delta) {
+        if (delta == 0) return;
+        out.push_back(OTA_OP_SEEK);
+        count((uint32_t)((delta << 1) ^ (delta >> 63)));
+    }
+
+    void diff(const uint8_t* source, const uint8_t* target, size_t n) {
+        out.push_back(OTA_OP_DIFF);
+        count((uint32_t)n);
+        for (size_t i = 0; i < n; i++) out.push_back((uint8_t)(target[i] - source[i]));
+    }
+};
+
+struct Extension {
+    size_t length;
+    size_t matches;
+};
+
+// Forward from (source, target) while the run stays better than half equal;
+// stops 64 bytes after the last improvement
+static Extension extend(const Bytes& source, size_t s, const Bytes& target, size_t t) {
+    Extension best = {0, 0};
+    size_t same = 0;
+    for (size_t i = 0; s + i < source.size() && t + i < target.size(); i++) {
+        if (source[s + i] == target[t + i]) same++;
+        if ((int64_t)(2 * same) - (int64_t)(i + 1) > (int64_t)(2 * best.matches) - (int64_t)best.length) {
+            best = {i + 1, same};
+        }
+        if (i + 1 - best.length > 64) break;
+    }
+    return best;
+}
+
+static uint32_t hash8(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return (uint32_t)((v * 0x9E3779B97F4A7C15ULL) >> 44);   // 20 bits
+}
+
+static Bytes diffOps(const Bytes& source, const Bytes& target) {
+    const size_t chainLimit = 16;
+    std::vector<int32_t> head(1 << 20, -1);
+    std::vector<int32_t> prev(source.size(), -1);
+    for (size_t i = 0; i + 8 <= source.size(); i++) {
+        uint32_t h = hash8(&source[i]);
+        prev[i] = head[h];
+        head[h] = (int32_t)i;
+    }
+    OpStream ops;
+    size_t t = 0;
+    size_t literal = 0;
+    int64_t sourcePos = 0;
+    int64_t diagonal = 0;       // source - target offset of the last run
+    while (t + 8 <= target.size()) {
+        Extension best = {0, 0};
+        int64_t bestSource = -1;
+        int64_t along = (int64_t)t + diagonal;
+        if (along >= 0 && along < (int64_t)source.size()) {
+            best = extend(source, (size_t)along, target, t);
+            bestSource = best.matches >= 8 ? along : -1;
+        }
+        size_t tried = 0;
+        for (int32_t c = head[hash8(&target[t])]; c >= 0 && tried < chainLimit; c = prev[c], tried++) {
+            if (c == along || memcmp(&source[c], &target[t], 8) != 0) continue;
+            Extension e = extend(source, (size_t)c, target, t);
+            if (e.matches >= 24 && e.matches > best.matches + 8) {
+                best = e;
+                bestSource = c;
+            }
+        }
+        if (bestSource < 0) {
+            t++;
+            continue;
+        }
+        ops.insert(&target[literal], t - literal);
+        ops.seek(bestSource - sourcePos);
+        ops.diff(&source[bestSource], &target[t], best.length);
+        diagonal = bestSource - (int64_t)t;
+        t += best.length;
+        sourcePos = bestSource + (int64_t)best.length;
+        literal = t;
+    }
+    ops.insert(&target[literal], target.size() - literal);
+    return ops.out;
+}
+
+static Bytes insertOps(const Bytes& target) {
+    OpStream ops;
+    ops.insert(target.data(), target.size());
+    return ops.out;
+}
+
+// LZSS as otaDelta.h decodes it; hash chains, longest match in the window
+static Bytes lzss(const Bytes& in) {
+    std::vector<int32_t> head(1 << 14, -1);
+    std::vector<int32_t> prev(in.size(), -1);
+    auto hash3 = [&in](size_t i) { return ((in[i] << 6) ^ (in[i + 1] << 3) ^ in[i + 2] ^ (in[i + 2] << 11)) & 0x3FFF; };
+    auto add = [&](size_t i) {
+        if (i + 3 > in.size()) return;
+        uint32_t h = hash3(i);
+        prev[i] = head[h];
+        head[h] = (int32_t)i;
+    };
+    Bytes out;
+    size_t flagAt = 0;
+    int items = 8;
+    size_t i = 0;
+    while (i < in.size()) {
+        if (items == 8) {
+            flagAt = out.size();
+            out.push_back(0);
+            items = 0;
+        }
+        size_t bestLength = 0, bestDistance = 0;
+        if (i + OTA_MIN_MATCH <= in.size()) {
+            size_t limit = std::min<size_t>(OTA_MAX_MATCH, in.size() - i);
+            int chain = 0;
+            for (int32_t c = head[hash3(i)]; c >= 0 && i - c <= OTA_WINDOW && chain < 256; c = prev[c], chain++) {
+                size_t n = 0;
+                while (n < limit && in[c + n] == in[i + n]) n++;
+                if (n > bestLength) {
+                    bestLength = n;
+                    bestDistance = i - c;
+                    if (n == limit) break;
+                }
+            }
+        }
+        if (bestLength >= OTA_MIN_MATCH) {
+            uint16_t token = (uint16_t)((bestLength - OTA_MIN_MATCH) << OTA_WINDOW_BITS | (bestDistance - 1));
+            out.push_back((uint8_t)token);
+            out.push_back((uint8_t)(token >> 8));
+            for (size_t k = 0; k < bestLength; k++) add(i + k);
+            i += bestLength;
+        } else {
+            out[flagAt] |= (uint8_t)(1 << items);
+            out.push_back(in[i]);
+            add(i);
+            i++;
+        }
+        items++;
+    }
+    return out;
+}
+
+static Bytes patchFile(const Bytes* source, const Bytes& target) {
+    Bytes out;
+    put32(out, OTA_PATCH_MAGIC);
+    out.push_back(OTA_PATCH_VERSION);
+    out.push_back(0);
+    out.push_back(0);
+    out.push_back(0);
+    put32(out, source ? (uint32_t)source->size() : 0);
+    put32(out, source ? crcOf(*source) : 0);
+    put32(out, (uint32_t)target.size());
+    put32(out, crcOf(target));
+    Bytes body = lzss(source ? diffOps(*source, target) : insertOps(target));
+    out.insert(out.end(), body.begin(), body.end());
+    return out;
+}
+
+static Bytes makePatch(const Bytes& source, const Bytes& target) { return patchFile(&source, target); }
+static Bytes makeFull(const Bytes& target) { return patchFile(nullptr, target); }
+
+// ---- Memory flash and the policies the installer runs on ----
+
+struct MemoryFlash {
+    static Bytes bytes;
+    static uint32_t misaligned;
+    static uint32_t unerasedWrites;
+    static uint32_t erases;
+    static bool failWrites;
+
+    static bool read(uint32_t address, uint32_t* data, size_t size) {
+        if (address % 4 || size % 4) misaligned++;
+        if (address + size > bytes.size()) return false;
+        memcpy(data, &bytes[address], size);
+        return true;
+    }
+    static bool erase(uint32_t sector) {
+        uint32_t address = sector * OTA_SECTOR_SIZE;
+        if (address + OTA_SECTOR_SIZE > bytes.size()) return false;
+        memset(&bytes[address], 0xFF, OTA_SECTOR_SIZE);
+        erases++;
+        return true;
+    }
+    // NOR flash: writing only clears bits
+    static bool write(uint32_t address, const uint32_t* data, size_t size) {
+        if (address % 4 || size % 4) misaligned++;
+        if (failWrites || address + size > bytes.size()) return false;
+        const uint8_t* p = (const uint8_t*)data;
+        for (size_t i = 0; i < size; i++) {
+            if ((bytes[address + i] & p[i]) != p[i]) unerasedWrites++;
+            bytes[address + i] &= p[i];
+        }
+        return true;
+    }
+    static uint32_t imageSize() { return sketchSize(bytes.data(), bytes.size()); }
+    static uint32_t spaceEnd() { return SKETCH_SPACE; }
+};
+Bytes MemoryFlash::bytes;
+uint32_t MemoryFlash::misaligned = 0;
+uint32_t MemoryFlash::unerasedWrites = 0;
+uint32_t MemoryFlash::erases = 0;
+bool MemoryFlash::failWrites = false;
+
+struct MemoryStore {
+    static Bytes saved;
+    static bool load(void* data, size_t size) {
+        if (saved.size() != size) return false;
+        memcpy(data, saved.data(), size);
+        return true;
+    }
+    static bool save(const void* data, size_t size) {
+        saved.assign((const uint8_t*)data, (const uint8_t*)data + size);
+        return true;
+    }
+};
+Bytes MemoryStore::saved;
+
+// eboot: the copy is made at the next start
+struct MemoryBoot {
+    static uint32_t from, size;
+    static bool pending, restarted;
+    static void install(uint32_t address, uint32_t bytes) {
+        from = address;
+        size = bytes;
+        pending = true;
+    }
+    static void restart() { restarted = true; }
+};
+uint32_t MemoryBoot::from = 0, MemoryBoot::size = 0;
+bool MemoryBoot::pending = false, MemoryBoot::restarted = false;
+
+typedef OtaInstaller<MemoryFlash, MemoryStore, MemoryBoot> Installer;
+
+// ---- Loopback file server ----
+
+static uint32_t nowMs() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct FileServer {
+    std::atomic<bool> dribble{false};       // Bodies in pieces of 1-300 bytes
+    std::atomic<bool> chunked{false};
+    std::atomic<size_t> dropAfter{0};       // Close after this many body bytes (0: never)
+    std::atomic<uint32_t> requests{0}, notFound{0};
+    std::atomic<uint64_t> bodyBytes{0};
+
+    std::mutex lock;
+    std::map<std::string, Bytes> files;
+    int listener = -1;
+    uint16_t port = 0;
+    std::atomic<bool> running{true};
+    std::thread acceptor;
+
+    void start() {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listener, (sockaddr*)&address, sizeof(address));
+        socklen_t length = sizeof(address);
+        getsockname(listener, (sockaddr*)&address, &length);
+        port = ntohs(address.sin_port);
+        listen(listener, 16);
+        acceptor = std::thread([this] {
+            while (running) {
+                int fd = accept(listener, nullptr, nullptr);
+                if (fd < 0) continue;
+                if (!running) {
+                    close(fd);
+                    break;
+                }
+                serve(fd);      // One download at a time, like one unit
+                close(fd);
+            }
+        });
+    }
+
+    void stop() {
+        running = false;
+        shutdown(listener, SHUT_RDWR);
+        close(listener);
+        acceptor.join();
+    }
+
+    void publish(const std::string& path, const Bytes& data) {
+        std::lock_guard<std::mutex> guard(lock);
+        files[path] = data;
+    }
+
+    bool sendAll(int fd, const uint8_t* data, size_t size, std::mt19937& rng) {
+        size_t i = 0;
+        while (i < size) {
+            size_t n = dribble ? std::min<size_t>(size - i, 1 + rng() % 300) : size - i;
+            ssize_t sent = send(fd, data + i, n, MSG_NOSIGNAL);
+            if (sent <= 0) return false;
+            i += sent;
+        }
+        return true;
+    }
+
+    bool sendText(int fd, const std::string& text, std::mt19937& rng) {
+        return sendAll(fd, (const uint8_t*)text.data(), text.size(), rng);
+    }
+
+    void serve(int fd) {
+        std::mt19937 rng(fd * 7919u + requests);
+        std::string head;
+        while (head.find("\r\n\r\n") == std::string::npos) {
+            char buffer[1024];
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) return;
+            head.append(buffer, n);
+        }
+        requests++;
+        size_t sp1 = head.find(' '), sp2 = head.find(' ', sp1 + 1);
+        std::string path = head.substr(sp1 + 1, sp2 - sp1 - 1);
+        Bytes body;
+        bool found;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto it = files.find(path);
+            found = it != files.end();
+            if (found) body = it->second;
+        }
+        if (!found) {
+            notFound++;
+            sendText(fd, "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\nConnection: close\r\n\r\nNot found", rng);
+            return;
+        }
+        size_t limit = dropAfter != 0 ? std::min(dropAfter.load(), body.size()) : body.size();
+        if (chunked) {
+            if (!sendText(fd, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n", rng)) return;
+            size_t i = 0;
+            while (i < limit) {
+                size_t n = std::min<size_t>(limit - i, 1 + rng() % 2000);
+                char size[16];
+                snprintf(size, sizeof(size), "%zx\r\n", n);
+                if (!sendText(fd, size, rng) || !sendAll(fd, &body[i], n, rng) || !sendText(fd, "\r\n", rng)) return;
+                i += n;
+                bodyBytes += n;
+            }
+            if (limit == body.size()) sendText(fd, "0\r\n\r\n", rng);
+            return;
+        }
+        std::string header = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: " +
+                             std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+        if (sendText(fd, header, rng) && sendAll(fd, body.data(), limit, rng)) bodyBytes += limit;
+    }
+};
+
+static FileServer server;
+
+// WiFiClient as far as OtaFetch uses it; every host is the file server
+struct PosixClient {
+    int fd = -1;
+
+    bool connect(const char*, uint16_t) {
+        stop();
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(server.port);
+        if (::connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+            stop();
+            return false;
+        }
+        return true;
+    }
+
+    bool connected() {
+        if (fd < 0) return false;
+        char c;
+        ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    }
+
+    int available() {
+        int n = 0;
+        if (fd < 0 || ioctl(fd, FIONREAD, &n) != 0) return 0;
+        return n;
+    }
+
+    int read(uint8_t* buffer, size_t size) {
+        return fd < 0 ? -1 : (int)recv(fd, buffer, size, MSG_DONTWAIT);
+    }
+
+    size_t write(const uint8_t* data, size_t length) {
+        size_t done = 0;
+        while (fd >= 0 && done < length) {
+            ssize_t n = send(fd, data + done, length - done, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            done += n;
+        }
+        return done;
+    }
+
+    void stop() {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+};
+
+// ---- Synthetic firmware ----
+
+// Code as the linker lays it out: functions of instruction-like bytes with
+// relative calls, literal pools of absolute addresses into the image, then
+// string data. A build is a list of function IDs; the same ID gives the same
+// body, so builds share code at shifted addresses.
+struct Build {
+    std::vector<uint32_t> functions;
+    std::vector<uint32_t> changed;      // Functions with a constant edited
+    uint32_t stringSeed;
+};
+
+static Bytes functionBody(uint32_t id, bool edited) {
+    std::mt19937 rng(id * 2654435761u);
+    size_t size = 60 + rng() % 600;
+    Bytes body;
+    // 3-byte instructions: a few opcodes, registers and small immediates
+    static const uint8_t OPCODES[] = {0x22, 0x32, 0x42, 0x52, 0x62, 0xA2, 0xC0, 0x0C, 0x1C, 0xF0};
+    while (body.size() < size) {
+        uint8_t op = OPCODES[rng() % 4 == 0 ? rng() % sizeof(OPCODES) : rng() % 3];
+        body.push_back((uint8_t)(op | (rng() % 4) << 4));
+        body.push_back((uint8_t)((rng() % 6) << 4 | (rng() % 6)));
+        body.push_back(rng() % 4 == 0 ? (uint8_t)rng() : (uint8_t)(rng() % 8));
+    }
+    body.resize(size);
+    if (edited) {
+        body[size / 2] ^= 0x5A;
+        body[size / 2 + 1] += 3;
+    }
+    return body;
+}
+
+static Bytes buildImage(const Build& build) {
+    std::mt19937 rng(17);
+    Bytes image(APP_OFFSET);
+    for (auto& b : image) b = (uint8_t)rng();
+    image[0] = OTA_IMAGE_MAGIC;     // eboot, the same in every build
+    // Layout pass: where each function and its pool go
+    std::vector<Bytes> bodies;
+    std::vector<uint32_t> offsets;
+    std::map<uint32_t, uint32_t> addressOf;
+    uint32_t offset = 0;
+    for (uint32_t id : build.functions) {
+        bool edited = std::find(build.changed.begin(), build.changed.end(), id) != build.changed.end();
+        bodies.push_back(functionBody(id, edited));
+        offsets.push_back(offset);
+        addressOf[id] = APP_LOAD + offset;
+        offset += (uint32_t)bodies.back().size() + 16;   // 4 pool entries
+    }
+    uint32_t stringsAt = APP_LOAD + offset;
+    Bytes code;
+    for (size_t f = 0; f < build.functions.size(); f++) {
+        std::mt19937 links(build.functions[f] * 40503u);
+        Bytes body = bodies[f];
+        // Relative calls to other functions (CALL0: 18-bit word offset)
+        for (size_t at = 8; at + 3 < body.size(); at += 40 + links() % 80) {
+            uint32_t callee = build.functions[(f + 1 + links() % 40) % build.functions.size()];
+            int32_t words = (int32_t)(addressOf[callee] - (APP_LOAD + offsets[f] + (uint32_t)at)) / 4;
+            uint32_t insn = 0x05 | ((uint32_t)words & 0x3FFFF) << 6;
+            body[at] = (uint8_t)insn;
+            body[at + 1] = (uint8_t)(insn >> 8);
+            body[at + 2] = (uint8_t)(insn >> 16);
+        }
+        code.insert(code.end(), body.begin(), body.end());
+        for (int k = 0; k < 4; k++) {
+            uint32_t target = k == 3 ? stringsAt + (links() % 4096)
+                                     : addressOf[build.functions[(f + 7 * k + 3) % build.functions.size()]];
+            put32(code, target);
+        }
+    }
+    std::mt19937 text(build.stringSeed);
+    for (int i = 0; i < 6000; i++) {
+        code.push_back(i % 24 == 23 ? 0 : (uint8_t)('a' + text() % 26));
+    }
+    // App image: header, one segment
+    image.push_back(OTA_IMAGE_MAGIC);
+    image.push_back(1);
+    image.push_back(2);
+    image.push_back(0x40);
+    put32(image, 0x40100000);
+    put32(image, APP_LOAD);
+    put32(image, (uint32_t)code.size());
+    image.insert(image.end(), code.begin(), code.end());
+    image.resize(sketchSize(image.data(), image.size() + 16), 0xFF);
+    image.back() = (uint8_t)crcOf(code);    // The checksum byte
+    return image;
+}
+
+// ---- Checks ----
+
+static int failures = 0;
+
+static void check(const char* name, bool ok, const char* detail = "") {
+    printf("  %-46s %-5s %s\n", name, ok ? "ok" : "FAIL", detail);
+    if (!ok) failures++;
+}
+
+// One bed's unit: flash, trial record, installer; reboot() runs eboot's copy
+struct Unit {
+    std::unique_ptr<Installer> installer;
+    uint32_t clockMs = 0;
+
+    void flash(const Bytes& image) {
+        MemoryFlash::bytes.assign(SKETCH_SPACE + 0x10000, 0xFF);
+        std::copy(image.begin(), image.end(), MemoryFlash::bytes.begin());
+        MemoryStore::saved.clear();
+        MemoryBoot::pending = false;
+        boot();
+    }
+
+    void boot() {
+        MemoryBoot::restarted = false;
+        if (MemoryBoot::pending) {
+            for (uint32_t a = 0; a < MemoryBoot::size; a += OTA_SECTOR_SIZE) {
+                MemoryFlash::erase(a / OTA_SECTOR_SIZE);
+            }
+            std::copy_n(MemoryFlash::bytes.begin() + MemoryBoot::from, MemoryBoot::size, MemoryFlash::bytes.begin());
+            MemoryBoot::pending = false;
+        }
+        clockMs = 0;
+        installer.reset(new Installer());
+        installer->begin(clockMs);
+        if (MemoryBoot::restarted) {
+            boot();                 // Rolled back before start-up finished
+            return;
+        }
+        run();
+    }
+
+    // Background steps until nothing is left to hash or copy
+    void run() {
+        for (int i = 0; i < 10000; i++) {
+            OtaPhase phase = installer->currentPhase();
+            if (phase != OTA_HASHING && phase != OTA_VERIFYING && phase != OTA_BACKING_UP) break;
+            installer->step();
+        }
+    }
+
+    uint32_t running() const { return otaCrc32(0, MemoryFlash::bytes.data(), MemoryFlash::imageSize()); }
+
+    // A trial: healthy or not for up to ms, in loop passes of 50 ms
+    void live(bool healthy, uint32_t ms) {
+        for (uint32_t end = clockMs + ms; clockMs < end && !MemoryBoot::restarted; clockMs += 50) {
+            installer->health(healthy, clockMs);
+        }
+        if (MemoryBoot::restarted) boot();
+    }
+
+    // What OtaUpdate does from a manifest: the patch from this image, the
+    // whole image on a 404, applied as it arrives. forged: /ota names another
+    // image with the same CRC and size.
+    OtaError download(const Bytes& target, const char* path = nullptr, bool forged = false) {
+        uint32_t targetCrc = crcOf(target);
+        Digest digest = digestOf(target);
+        if (forged) digest.bytes[0] ^= 1;
+        if (!installer->wants(targetCrc)) return OTA_OK;
+        for (int attempt = 0; attempt < 2; attempt++) {
+            char url[OTA_URL_BYTES];
+            if (path != nullptr) snprintf(url, sizeof(url), "http://files.test:%u%s", server.port, path);
+            else if (attempt == 0) snprintf(url, sizeof(url), "http://files.test:%u/ota/%08x-%08x.cldp", server.port,
+                                            installer->crc(), targetCrc);
+            else snprintf(url, sizeof(url), "http://files.test:%u/ota/full-%08x.cldp", server.port, targetCrc);
+            if (installer->beginPatch((uint32_t)target.size(), targetCrc, digest.bytes, "v") != OTA_OK) {
+                return installer->lastError();
+            }
+            PosixClient socket;
+            OtaFetch<PosixClient> fetch(socket);
+            if (!fetch.begin(url, [](void* context, const uint8_t* data, size_t length) {
+                    static_cast<Installer*>(context)->feed(data, length);
+                }, installer.get(), nowMs())) {
+                return installer->fail(OTA_DOWNLOAD_FAILED);
+            }
+            OtaFetchState state;
+            while ((state = fetch.poll(nowMs())) == OTA_FETCH_BUSY && installer->currentPhase() == OTA_DOWNLOADING) {
+                std::this_thread::yield();
+            }
+            fetch.end();
+            if (installer->currentPhase() != OTA_DOWNLOADING) return installer->lastError();
+            if (state == OTA_FETCH_FAILED) return installer->fail(OTA_DOWNLOAD_FAILED);
+            if (fetch.status() == 404 && path == nullptr && attempt == 0) continue;
+            if (fetch.status() != 200) return installer->fail(OTA_HTTP_STATUS);
+            installer->endPatch();
+            run();
+            return installer->currentPhase() == OTA_READY ? OTA_OK : installer->lastError();
+        }
+        return installer->lastError();
+    }
+
+    bool install() {
+        if (!installer->install() || !MemoryBoot::restarted) return false;
+        boot();
+        return true;
+    }
+};
+
+// ---- A unit on trial as the mesh gateway ----
+
+// As meshRelay.h: a gateway that has not reached Firebase in this time resigns
+// and stays out of elections this long
+#define TRIAL_CONNECT_TIMEOUT_MS 60000
+#define TRIAL_RESIGN_HOLD_MS     (5 * 60000UL)
+
+struct PairRadio;
+typedef MeshNode<PairRadio> PairNode;
+
+// Two beds in range of each other; every frame arrives and every unicast is acked
+struct PairRadio {
+    PairNode* peer = nullptr;
+    uint32_t now = 0;
+    bool unicast = false;
+
+    void send(uint16_t dst, const uint8_t* frame, uint8_t length) {
+        if (dst != MESH_BROADCAST) unicast = true;
+        peer->receive(frame, length, now);
+    }
+    void deliver(const MeshState&, uint32_t) {}
+    uint32_t random(uint32_t limit) { return limit == 0 ? 0 : (uint32_t)rand() % limit; }
+};
+
+// The unit on trial outranks the other bed as gateway. wifiWorks: its cloud
+// session comes up 5 s after it takes the role; otherwise it resigns after
+// TRIAL_CONNECT_TIMEOUT_MS. health() gets its own session, as code.cpp gives
+// it; longestRelayedMs is the longest run of "gateway or relaying with a
+// route", the signal that let a broken build pass.
+static void meshTrial(Unit& unit, bool wifiWorks, uint32_t& longestRelayedMs) {
+    PairRadio trialRadio, otherRadio;
+    PairNode trial(trialRadio), other(otherRadio);
+    trialRadio.peer = &other;
+    otherRadio.peer = &trial;
+    trial.begin(1, 200, unit.clockMs);
+    other.begin(2, 100, unit.clockMs);
+    MeshState state = {};
+    uint32_t roleSince = 0, resignedMs = 0, relayedSince = 0;
+    bool gateway = false, resigned = false, relayed = false;
+    longestRelayedMs = 0;
+    for (uint32_t end = unit.clockMs + OTA_TRIAL_TIMEOUT_MS + 1000; unit.clockMs < end && !MemoryBoot::restarted;
+         unit.clockMs += 50) {
+        uint32_t now = unit.clockMs;
+        trialRadio.now = otherRadio.now = now;
+        trial.tick(now);
+        other.tick(now);
+        if (now % 1000 == 0) other.publish(state, now);
+        if (trialRadio.unicast) trial.sendDone(true, now);
+        if (otherRadio.unicast) other.sendDone(true, now);
+        trialRadio.unicast = otherRadio.unicast = false;
+
+        if (trial.isGateway() != gateway) {
+            gateway = trial.isGateway();
+            roleSince = now;
+        }
+        bool ready = gateway && wifiWorks && now - roleSince >= 5000;
+        if (gateway && !wifiWorks && now - roleSince >= TRIAL_CONNECT_TIMEOUT_MS) {
+            trial.resign(now);
+            resigned = true;
+            resignedMs = now;
+        } else if (resigned && now - resignedMs >= TRIAL_RESIGN_HOLD_MS) {
+            trial.candidate(200);
+            resigned = false;
+        }
+
+        bool relaying = gateway || trial.hasRoute();
+        if (relaying && !relayed) relayedSince = now;
+        relayed = relaying;
+        if (relayed) longestRelayedMs = std::max(longestRelayedMs, now - relayedSince);
+        unit.installer->health(ready, now);
+    }
+    if (MemoryBoot::restarted) unit.boot();
+}
+
+static const char* errorText(OtaError error) {
+    static char text[OTA_NAME_SIZE];
+    return otaErrorName(error, text);
+}
+
+static void publishPatch(const Bytes& from, const Bytes& to, const Bytes& patch) {
+    char path[64];
+    snprintf(path, sizeof(path), "/ota/%08x-%08x.cldp", crcOf(from), crcOf(to));
+    server.publish(path, patch);
+}
+
+static void publishFull(const Bytes& to, const Bytes& patch) {
+    char path[64];
+    snprintf(path, sizeof(path), "/ota/full-%08x.cldp", crcOf(to));
+    server.publish(path, patch);
+}
+
+static void checkCrc(unsigned seed) {
+    std::mt19937 rng(seed);
+    bool same = true;
+    for (int n = 0; n < 64; n++) {
+        Bytes data(rng() % 3000);
+        for (auto& b : data) b = (uint8_t)rng();
+        size_t split = data.empty() ? 0 : rng() % data.size();
+        uint32_t crc = otaCrc32(otaCrc32(0, data.data(), split), data.data() + split, data.size() - split);
+        same &= crc == flashCrc32(data.data(), data.size());
+    }
+    check("otaCrc32 in pieces equals flashCrc32", same);
+
+    const char* two = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    Bytes million(1000000, 'a');
+    check("host SHA-256 matches the FIPS 180-2 examples",
+          !strcmp(digestOf(Bytes{'a', 'b', 'c'}).hex, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") &&
+          !strcmp(digestOf(Bytes(two, two + strlen(two))).hex,
+                  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1") &&
+          !strcmp(digestOf(million).hex, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"));
+}
+
+static void rollout(uint32_t beds, uint32_t patchBytes, uint32_t fullBytes) {
+    const uint16_t waves = 4, waveMinutes = 30;
+    const uint32_t rate = 50000;        // Bytes/s one bed downloads at on its own
+    const uint32_t capacity = 500000;   // Bytes/s the ward's access points carry for all beds
+    std::vector<uint32_t> perWave(waves, 0);
+    std::vector<uint32_t> starts;
+    uint32_t latest = 0;
+    for (uint32_t b = 0; b < beds; b++) {
+        uint32_t delay = otaRolloutDelayS(0x00A1B200 + b, waves, waveMinutes);
+        starts.push_back(delay);
+        perWave[delay / (waveMinutes * 60)]++;
+        latest = std::max(latest, delay);
+    }
+    auto peak = [&starts](uint32_t seconds) {
+        uint32_t most = 0;
+        for (uint32_t s : starts) {
+            uint32_t n = 0;
+            for (uint32_t t : starts) n += t <= s && s < t + seconds;
+            most = std::max(most, n);
+        }
+        return most;
+    };
+    // All at once, the beds share the capacity
+    auto together = [&](uint32_t bytes) {
+        return std::max((double)bytes / rate, (double)bytes * beds / capacity);
+    };
+    uint32_t patchS = (patchBytes + rate - 1) / rate;
+    printf("rollout: %u beds, %u waves of %u min, %u B/s per bed, %u B/s for the ward\n", beds, waves, waveMinutes,
+           rate, capacity);
+    printf("  beds per wave:");
+    bool balanced = true;
+    for (uint32_t n : perWave) {
+        printf(" %u", n);
+        balanced &= n * waves * 2 >= beds && n * waves <= beds * 2;
+    }
+    printf("\n");
+    uint32_t staggered = peak(patchS);
+    printf("  %-22s %10s %12s %10s %14s\n", "", "download_s", "concurrent", "ward_load", "ward_total_MB");
+    printf("  %-22s %10.0f %12u %9.0f%% %14.1f\n", "whole image, at once", together(fullBytes), beds,
+           100.0 * std::min(beds * rate, capacity * 100) / capacity, beds * (double)fullBytes / 1e6);
+    printf("  %-22s %10.0f %12u %9.0f%% %14.1f\n", "delta, at once", together(patchBytes), beds,
+           100.0 * beds * rate / capacity, beds * (double)patchBytes / 1e6);
+    printf("  %-22s %10u %12u %9.0f%% %14.1f\n", "delta, staggered", patchS, staggered,
+           100.0 * staggered * rate / capacity, beds * (double)patchBytes / 1e6);
+    check("every bed starts within the rollout", latest < (uint32_t)waves * waveMinutes * 60);
+    check("waves balanced (within 2x of beds/waves)", balanced);
+    char detail[48];
+    snprintf(detail, sizeof(detail), "peak %u of %u", staggered, beds);
+    check("staggered downloads fit in the ward capacity", staggered * rate <= capacity, detail);
+}
+
+static int runChecks(uint32_t beds, unsigned seed) {
+    server.start();
+    char detail[160];
+
+    // Builds: v1 running; v2 adds functions mid-image and edits constants;
+    // v0 is an old build with no patch published; other is unrelated
+    Build b1, b2, b0, bOther;
+    for (uint32_t id = 1; id <= 1000; id++) b1.functions.push_back(id);
+    b1.stringSeed = 1;
+    b2 = b1;
+    b2.functions.insert(b2.functions.begin() + 300, {5001, 5002, 5003, 5004, 5005});
+    b2.functions.erase(b2.functions.begin() + 700);
+    b2.changed = {12, 250, 501, 777, 990};
+    b2.stringSeed = 2;
+    b0 = b1;
+    b0.functions.resize(900);
+    bOther = b1;
+    for (auto& id : bOther.functions) id += 20000;
+    Bytes v1 = buildImage(b1), v2 = buildImage(b2), v0 = buildImage(b0), other = buildImage(bOther);
+
+    printf("patch sizes\n");
+    auto started = std::chrono::steady_clock::now();
+    Bytes patch12 = makePatch(v1, v2);
+    double makeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    Bytes patch21 = makePatch(v2, v1);
+    Bytes full2 = makeFull(v2);
+    Bytes full1 = makeFull(v1);
+    printf("  image v1 %zu B, v2 %zu B; v2 whole compressed %zu B (%.0f%%)\n", v1.size(), v2.size(), full2.size(),
+           100.0 * full2.size() / v2.size());
+    printf("  v1->v2 patch %zu B (%.1f%% of the image, %.1f%% of it compressed), made in %.0f ms\n", patch12.size(),
+           100.0 * patch12.size() / v2.size(), 100.0 * patch12.size() / full2.size(), makeMs);
+    check("delta patch under 15% of the image", patch12.size() * 100 < v2.size() * 15);
+    publishPatch(v1, v2, patch12);
+    publishPatch(v2, v1, patch21);
+    publishFull(v2, full2);
+    publishFull(v1, full1);
+
+    printf("update path\n");
+    checkCrc(seed);
+    Unit unit;
+    unit.flash(v1);
+    check("running image hashed in the background", unit.installer->imageKnown() && unit.installer->crc() == crcOf(v1));
+    OtaError error = unit.download(v2);
+    snprintf(detail, sizeof(detail), "%s, %u patch bytes, %u sector erases", errorText(error),
+             (unsigned)patch12.size(), MemoryFlash::erases);
+    check("v1->v2 patch applied, verified, backed up", error == OTA_OK, detail);
+    check("flash: aligned, nothing written unerased", MemoryFlash::misaligned == 0 && MemoryFlash::unerasedWrites == 0);
+    check("running image untouched before the switch", unit.running() == crcOf(v1));
+    check("switch: v2 running on trial", unit.install() && unit.running() == crcOf(v2) &&
+          unit.installer->state().state == OTA_SLOT_TRIAL);
+    unit.live(true, OTA_HEALTH_MS - 1000);
+    check("still on trial before the health period", unit.installer->state().state == OTA_SLOT_TRIAL);
+    unit.live(true, 2000);
+    check("confirmed after the health period", unit.installer->state().state == OTA_SLOT_CONFIRMED &&
+          unit.running() == crcOf(v2));
+    check("v2 not wanted again", !unit.installer->wants(crcOf(v2)));
+
+    // Never healthy: back to v1 at the trial timeout, and v2 is not fetched again
+    unit.flash(v1);
+    unit.download(v2);
+    unit.install();
+    unit.live(false, OTA_TRIAL_TIMEOUT_MS + 1000);
+    check("never healthy: rolled back at the timeout", unit.running() == crcOf(v1) &&
+          unit.installer->state().state == OTA_SLOT_ROLLED_BACK);
+    check("rolled-back image not fetched again", !unit.installer->wants(crcOf(v2)) &&
+          unit.installer->state().rejectedCrc == crcOf(v2));
+    check("a later image still wanted", unit.installer->wants(crcOf(other)));
+
+    // Healthy at times, never long enough
+    unit.flash(v1);
+    unit.download(v2);
+    unit.install();
+    for (int i = 0; i < 8 && unit.running() == crcOf(v2); i++) {
+        unit.live(true, OTA_HEALTH_MS / 2);
+        unit.live(false, 1000);
+    }
+    check("flapping health: rolled back", unit.running() == crcOf(v1));
+
+    // Crash loop: restarts before the health check can pass
+    unit.flash(v1);
+    unit.download(v2);
+    unit.install();
+    int boots = 0;
+    while (unit.running() == crcOf(v2) && boots < 10) {
+        unit.live(true, 20000);
+        unit.boot();
+        boots++;
+    }
+    snprintf(detail, sizeof(detail), "%d restarts", boots);
+    check("crash loop: rolled back by boot count", unit.running() == crcOf(v1) && boots == OTA_TRIAL_BOOTS, detail);
+
+    // On the mesh: a gateway whose WiFi the new build broke resigns and relays
+    // through the other bed, which is no proof the build works
+    uint32_t relayedMs = 0;
+    unit.flash(v1);
+    unit.download(v2);
+    unit.install();
+    meshTrial(unit, false, relayedMs);
+    snprintf(detail, sizeof(detail), "gateway or relaying for %u s straight", (unsigned)(relayedMs / 1000));
+    check("mesh: gateway without WiFi rolled back", unit.running() == crcOf(v1) &&
+          unit.installer->state().state == OTA_SLOT_ROLLED_BACK && relayedMs >= OTA_HEALTH_MS, detail);
+    unit.flash(v1);
+    unit.download(v2);
+    unit.install();
+    meshTrial(unit, true, relayedMs);
+    check("mesh: gateway with a session confirmed", unit.running() == crcOf(v2) &&
+          unit.installer->state().state == OTA_SLOT_CONFIRMED);
+
+    // Manual rollback after confirming, and none without a backup
+    unit.flash(v1);
+    unit.download(v2);
+    unit.install();
+    unit.live(true, OTA_HEALTH_MS + 1000);
+    unit.installer->rollback();
+    if (MemoryBoot::restarted) unit.boot();
+    check("`ota rollback` after confirming", unit.running() == crcOf(v1));
+    check("no second rollback without a backup", unit.installer->rollback() == OTA_BACKUP_FAILED &&
+          !MemoryBoot::restarted);
+
+    // Bad patches: nothing installed, the running image untouched
+    unit.flash(v1);
+    Bytes corrupt = patch12;
+    // A whole run, not one bit: one bit can land in a match inside repeated code and decode the same
+    for (size_t i = corrupt.size() / 2; i < corrupt.size() / 2 + 16; i++) corrupt[i] ^= 0xA5;
+    server.publish("/ota/corrupt.cldp", corrupt);
+    error = unit.download(v2, "/ota/corrupt.cldp");
+    check("corrupt patch rejected", error == OTA_CORRUPT || error == OTA_BAD_IMAGE, errorText(error));
+    Bytes truncated(patch12.begin(), patch12.begin() + patch12.size() * 2 / 3);
+    server.publish("/ota/truncated.cldp", truncated);
+    error = unit.download(v2, "/ota/truncated.cldp");
+    check("truncated patch rejected", error == OTA_CORRUPT, errorText(error));
+    error = unit.download(v2, "/ota/not-a-patch");
+    check("404 for a named patch", error == OTA_HTTP_STATUS, errorText(error));
+    unit.flash(other);
+    char path[64];
+    snprintf(path, sizeof(path), "/ota/%08x-%08x.cldp", crcOf(v1), crcOf(v2));
+    error = unit.download(v2, path);
+    check("patch for another image rejected", error == OTA_WRONG_SOURCE, errorText(error));
+    check("running image untouched after rejections", unit.running() == crcOf(other) && !MemoryBoot::pending);
+
+    // A file server can serve any image with the published CRC; not its SHA-256
+    unit.flash(v1);
+    error = unit.download(v2, nullptr, true);
+    check("image without the published SHA-256 rejected", error == OTA_BAD_DIGEST && !MemoryBoot::pending,
+          errorText(error));
+    Digest known = digestOf(v2);
+    uint8_t parsed[OTA_DIGEST_BYTES];
+    check("targetSha256 parsed; short or non-hex refused", otaParseDigest(known.hex, parsed) &&
+          memcmp(parsed, known.bytes, sizeof(parsed)) == 0 && !otaParseDigest("0123", parsed) &&
+          !otaParseDigest(std::string(64, 'g').c_str(), parsed));
+
+    // No patch from this image: the whole one
+    unit.flash(v0);
+    uint32_t notFound = server.notFound;
+    error = unit.download(v2);
+    check("no patch published: whole image used", error == OTA_OK && server.notFound == notFound + 1 &&
+          unit.install() && unit.running() == crcOf(v2), errorText(error));
+
+    // Transports
+    unit.flash(v1);
+    server.dribble = true;
+    error = unit.download(v2);
+    server.dribble = false;
+    check("patch dribbled in small pieces", error == OTA_OK, errorText(error));
+    unit.flash(v1);
+    server.chunked = true;
+    error = unit.download(v2);
+    server.chunked = false;
+    check("patch sent chunked", error == OTA_OK, errorText(error));
+    unit.flash(v1);
+    server.dropAfter = patch12.size() / 2;
+    error = unit.download(v2);
+    server.dropAfter = 0;
+    check("connection dropped mid-download", error == OTA_DOWNLOAD_FAILED, errorText(error));
+    check("retry after the drop succeeds", unit.download(v2) == OTA_OK);
+
+    // Power lost mid-download, and between the trial record and the switch
+    unit.flash(v1);
+    server.dropAfter = patch12.size() / 3;
+    unit.download(v2);
+    server.dropAfter = 0;
+    unit.boot();
+    check("power lost mid-download: v1 runs, retry works", unit.running() == crcOf(v1) &&
+          unit.download(v2) == OTA_OK && unit.install() && unit.running() == crcOf(v2));
+    unit.flash(v1);
+    unit.download(v2);
+    unit.installer->install();
+    MemoryBoot::pending = false;    // eboot never ran the copy
+    unit.boot();
+    check("switch lost: v1 runs, record back to confirmed", unit.running() == crcOf(v1) &&
+          unit.installer->state().state == OTA_SLOT_CONFIRMED && unit.installer->wants(crcOf(v2)));
+
+    // Flash failing while the patch is written
+    unit.flash(v1);
+    MemoryFlash::failWrites = true;
+    error = unit.download(v2);
+    MemoryFlash::failWrites = false;
+    check("flash write failure reported", error == OTA_FLASH_FAILED, errorText(error));
+
+    // Images that do not fit beside a backup
+    unit.flash(v1);
+    error = unit.installer->beginPatch(SKETCH_SPACE / 2, 0x12345678, digestOf(v1).bytes, "huge");
+    check("image too large for the free flash refused", error == OTA_NO_SPACE, errorText(error));
+
+    printf("memory\n");
+    snprintf(detail, sizeof(detail), "installer %u B (LZSS window %u, page %u, copy %u), fetch %u B",
+             (unsigned)sizeof(Installer), OTA_WINDOW, OTA_PAGE_BYTES, OTA_COPY_BYTES,
+             (unsigned)sizeof(OtaFetch<PosixClient>));
+    check("fixed RAM under 2.5 KB for any image size",
+          sizeof(Installer) + sizeof(OtaFetch<PosixClient>) < 2560, detail);
+
+    rollout(beds, (uint32_t)patch12.size(), (uint32_t)full2.size());
+    server.stop();
+    printf("\n%s\n", failures == 0 ? "all checks passed" : "CHECKS FAILED");
+    return failures == 0 ? 0 : 1;
+}
+
+static bool readFile(const char* name, Bytes& out) {
+    FILE* f = fopen(name, "rb");
+    if (f == nullptr) return false;
+    uint8_t buffer[65536];
+    size_t n;
+    out.clear();
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) out.insert(out.end(), buffer, buffer + n);
+    fclose(f);
+    return true;
+}
+
+static bool writeFile(const char* name, const Bytes& data) {
+    FILE* f = fopen(name, "wb");
+    if (f == nullptr) return false;
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+}
+
+static int usage(const char* program) {
+    fprintf(stderr, "usage: %s make old.bin new.bin out.cldp\n"
+                    "       %s full new.bin out.cldp\n"
+                    "       %s check [--beds N] [--seed N]\n", program, program, program);
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && strcmp(argv[1], "check") == 0) {
+        uint32_t beds = 200;
+        unsigned seed = 1;
+        for (int i = 2; i < argc; i++) {
+            if (!strcmp(argv[i], "--beds") && i + 1 < argc) beds = (uint32_t)atol(argv[++i]);
+            else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = (unsigned)atoi(argv[++i]);
+            else return usage(argv[0]);
+        }
+        if (beds == 0) return usage(argv[0]);
+        return runChecks(beds, seed);
+    }
+    bool full = argc == 4 && strcmp(argv[1], "full") == 0;
+    if (!full && !(argc == 5 && strcmp(argv[1], "make") == 0)) {
+        return usage(argv[0]);
+    }
+    Bytes source, target;
+    if ((!full && !readFile(argv[2], source)) || !readFile(argv[full ? 2 : 3], target)) {
+        fprintf(stderr, "cannot read the images\n");
+        return 1;
+    }
+    if (!full && sketchSize(source.data(), source.size()) == 0) {
+        fprintf(stderr, "%s: no app image at 0x1000, hashing the whole file\n", argv[2]);
+    }
+    source = sketchBytes(source);
+    target = sketchBytes(target);
+    Bytes patch = full ? makeFull(target) : makePatch(source, target);
+    const char* out = argv[full ? 3 : 4];
+    if (!writeFile(out, patch)) {
+        fprintf(stderr, "cannot write %s\n", out);
+        return 1;
+    }
+    printf("%s: %zu B for a %zu B image (%.1f%%)\n", out, patch.size(), target.size(),
+           100.0 * patch.size() / target.size());
+    if (full) printf("publish as <patchBase>/full-%08x.cldp\n", crcOf(target));
+    else printf("publish as <patchBase>/%08x-%08x.cldp\n", crcOf(source), crcOf(target));
+    printf("/ota: \"targetCrc\": \"%08x\", \"targetSize\": %zu, \"targetSha256\": \"%s\"\n", crcOf(target),
+           target.size(), digestOf(target).hex);
+    return 0;
+}
@@ -0,0 +1,203 @@
+// Check of the firmware's profiling probes (probeTimers.h, FEATURE_PROBES).
+//
+// - accuracy: durations drawn from known distributions (a narrow one, a wide
+//   log-normal one, and the two-mode shape of readSensors(): skipped passes
+//   and passes with I2C reads) go into a probe histogram; its p50/p90/p99
+//   estimates are compared with the exact percentiles of the same samples.
+//   Log2 buckets bound the error by the bucket width; interpolation keeps it
+//   well inside that.
+// - overhead: cost of one PROBE() scope against the same loop without it.
+// - host profile: the firmware's BedController sampling (the logic half of
+//   readSensors(), without the bus) timed under the `sensors` site, printed
+//   in the format of the device's `prof` command so the two can be compared
+//   line by line. On the device the same site also includes the I2C reads.
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -DFEATURE_PERSISTENCE=0 -DFEATURE_PROBES=1 -I"hardware/ESP8266 Code" tools/probe_check.cpp -o probe_check
+// Usage:
+//   ./probe_check [--samples 200000] [--seed 1]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "probeTimers.h"
+#include "bedConfig.h"
+#include "bedController.h"
+
+#if !FEATURE_PROBES
+#error "Build with -DFEATURE_PROBES=1"
+#endif
+
+ProbeTable probes;
+
+
+struct SimIo {
+    void show(uint8_t, TextId, TextId, uint32_t) {}
+    void redraw(uint8_t) {}
+    void publish(uint8_t) {}
+    void trace(uint8_t, uint32_t) {}
+    template<typename... Args>
+    void log(uint8_t, LogId, const Args&...) {}
+};
+
+enum Shape {
+    NARROW,         // 40 us +- 2 %: a fixed-length bus transaction
+    LOG_NORMAL,     // Median 300 us, a long tail: network and flash work
+    TWO_MODE,       // 95 % skipped passes (3 us), 5 % sampling passes (~900 us)
+    SHAPES
+};
+
+static const char* SHAPE_NAMES[] = { "narrow", "log-normal", "two-mode" };
+
+// Durations in host ticks (ns)
+static uint32_t draw(Shape shape, std::mt19937& rng) {
+    std::normal_distribution<double> n(0, 1);
+    switch (shape) {
+        case NARROW: return (uint32_t)(40000 * (1 + 0.02 * n(rng)));
+        case LOG_NORMAL: return (uint32_t)(300000 * std::exp(0.8 * n(rng)));
+        default: break;
+    }
+    if (rng() % 100 < 95) {
+        return (uint32_t)(3000 + 200 * std::fabs(n(rng)));
+    }
+    return (uint32_t)(900000 * (1 + 0.05 * n(rng)));
+}
+
+static uint32_t exactPercentile(std::vector<uint32_t>& sorted, uint16_t permille) {
+    size_t rank = (sorted.size() * permille + 999) / 1000;
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+static bool checkAccuracy(uint32_t samples, unsigned seed) {
+    static const uint16_t PERMILLE[] = { 500, 900, 990 };
+    bool ok = true;
+    printf("accuracy (%u samples)\n", samples);
+    printf("  %-11s %8s %10s %10s %8s\n", "shape", "pct", "exact_us", "probe_us", "error");
+    for (int s = 0; s < SHAPES; s++) {
+        std::mt19937 rng(seed + s);
+        ProbeTable table;
+        std::vector<uint32_t> values;
+        values.reserve(samples);
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < samples; i++) {
+            uint32_t ticks = draw((Shape)s, rng);
+            table.record(PROBE_SENSORS, ticks);
+            values.push_back(ticks);
+            total += ticks;
+        }
+        std::sort(values.begin(), values.end());
+        for (uint16_t permille : PERMILLE) {
+            double exact = exactPercentile(values, permille);
+            double estimate = table.percentileTicks(PROBE_SENSORS, permille);
+            double error = (estimate - exact) / exact;
+            // Never outside the bucket holding the exact value
+            bool within = estimate >= exact / 2 && estimate <= exact * 2;
+            ok &= within;
+            printf("  %-11s %7.1f%% %10.1f %10.1f %+7.1f%%%s\n", SHAPE_NAMES[s], permille / 10.0, exact / 1000,
+                   estimate / 1000, 100 * error, within ? "" : "  FAIL");
+        }
+        const ProbeHistogram& h = table.histogram(PROBE_SENSORS);
+        bool exact = h.count == samples && h.maxTicks == values.back() && h.minTicks == values.front() &&
+                     table.meanTicks(PROBE_SENSORS) == (uint32_t)(total / samples);
+        ok &= exact;
+        if (!exact) {
+            printf("  %-11s count/min/max/mean differ  FAIL\n", SHAPE_NAMES[s]);
+        }
+    }
+    return ok;
+}
+
+static volatile uint32_t sink;
+
+static void checkOverhead() {
+    const uint32_t rounds = 2000000;
+    ProbeTable table;
+    uint32_t best[2] = { UINT32_MAX, UINT32_MAX };
+    for (int repeat = 0; repeat < 5; repeat++) {
+        uint32_t start = probeTicks();
+        for (uint32_t i = 0; i < rounds; i++) {
+            sink = sink + i;
+        }
+        best[0] = std::min(best[0], probeTicks() - start);
+        start = probeTicks();
+        for (uint32_t i = 0; i < rounds; i++) {
+            ProbeScope scope(table, PROBE_SENSORS);
+            sink = sink + i;
+        }
+        best[1] = std::min(best[1], probeTicks() - start);
+    }
+    double perProbe = best[1] > best[0] ? (double)(best[1] - best[0]) / rounds : 0;
+    printf("overhead\n");
+    printf("  one PROBE() scope: %.1f ns on this host (two clock reads, a clz and four adds)\n", perProbe);
+    printf("  table: %u bytes for %u sites, %u buckets each; nothing with FEATURE_PROBES 0\n",
+           (unsigned)sizeof(ProbeTable), (unsigned)PROBE_COUNT, (unsigned)PROBE_BUCKETS);
+}
+
+// The firmware's per-sample work for one bed, timed as on the device
+static void hostProfile(uint32_t samples, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> n(0, 1);
+    SimIo io;
+    BedController<SimIo> bed;
+    bed.begin(&io, 0);
+    probes.reset();
+    bool patient = false;
+    uint32_t now = 0;
+    for (uint32_t i = 0; i < samples; i++) {
+        now += DEFAULT_SETTINGS.sampleIntervalMs;
+        if (i % 3600 == 1200) {
+            patient = !patient;
+        }
+        int fsr = (int)((patient ? 620 + 15 * n(rng) : 30 + 2 * n(rng)) + 0.5);
+        centi_t object = (centi_t)((patient ? 3420 : 2450) + 3 * n(rng));
+        centi_t ambient = bed.ambientDue() ? (centi_t)(2300 + 3 * n(rng)) : AMBIENT_INVALID;
+        PROBE(PROBE_SENSORS);
+        if (bed.sampleDue(now, DEFAULT_SETTINGS)) {
+            bed.sample(fsr, object, ambient, now, DEFAULT_SETTINGS);
+        }
+    }
+
+    printf("host profile (compare with `prof` on a unit)\n");
+    printf("  prof: clock=%s ticks_per_us=%lu table=%uB\n", PROBE_CLOCK, (unsigned long)probeTicksPerUs(),
+           (unsigned)sizeof(probes));
+    char summary[PROBE_SUMMARY_SIZE];
+    formatProbeSummary(summary, sizeof(summary), probes, PROBE_SENSORS);
+    printf("  prof: %s\n", summary);
+    const ProbeHistogram& h = probes.histogram(PROBE_SENSORS);
+    printf("  hist:");
+    for (uint8_t k = 0; k < PROBE_BUCKETS; k++) {
+        if (h.buckets[k] != 0) {
+            printf(" %u:%lu", k, (unsigned long)h.buckets[k]);
+        }
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    uint32_t samples = 200000;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--samples") && i + 1 < argc) {
+            samples = (uint32_t)atol(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = (unsigned)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--samples N] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (samples == 0) {
+        fprintf(stderr, "--samples must be positive\n");
+        return 2;
+    }
+
+    bool ok = checkAccuracy(samples, seed);
+    checkOverhead();
+    hostProfile(samples, seed);
+    printf("\n%s\n", ok ? "all checks passed" : "CHECKS FAILED");
+    return ok ? 0 : 1;
+}
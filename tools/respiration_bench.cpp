@@ -0,0 +1,183 @@
+// Benchmark of the FSR breathing/motion feature extractor (FEATURE_FSR_CAPTURE).
+//
+// Runs respirationFeatures.h from the firmware on synthetic FSR load signals:
+// a body load with slow drift, breathing at a known rate and depth, ADC noise
+// and quantisation, and optional bursts of movement. Reports for 50 and
+// 100 Hz capture:
+// - cycles per sample (amortised, including the per-minute spectrum) and the
+//   extractor's RAM footprint;
+// - how often the reported rate is within 1 breath/min of the truth, how
+//   often a rate is withheld, and the zero-crossing count against 2x the rate;
+// - wrong rates reported during minutes with movement.
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -I"hardware/ESP8266 Code" tools/respiration_bench.cpp -o respiration_bench
+// Usage:
+//   ./respiration_bench [--minutes 400] [--depth 3] [--noise 1] [--seed 1]
+//
+// --depth is the breathing amplitude in ADC counts (peak), --noise the ADC
+// noise in counts (sigma). Cycles are read with rdtsc on x86, otherwise
+// derived from std::chrono nanoseconds.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "respirationFeatures.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t cycles() { return __rdtsc(); }
+#define CYCLE_UNIT "cycles"
+#else
+static inline uint64_t cycles() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#define CYCLE_UNIT "ns"
+#endif
+
+struct Options {
+    int minutes = 400;
+    double depth = 3;
+    double noise = 1;
+    unsigned seed = 1;
+};
+
+struct Minute {
+    std::vector<uint16_t> samples;
+    int bpm;
+    bool moving;
+};
+
+// Carried from minute to minute so the signal has no seams
+struct Body {
+    double phase = 0;
+    double load = 450;
+};
+
+// One minute of load: body weight, drift, breathing (with a little rate wander
+// and a second harmonic), optional movement, noise, rounding to ADC counts.
+// Movement also shifts the load that the body puts on the FSR.
+static Minute makeMinute(uint16_t hz, const Options& opt, std::mt19937& rng, Body& body) {
+    std::uniform_int_distribution<int> rate(8, 30);
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::normal_distribution<double> noise(0, opt.noise);
+    Minute m;
+    m.bpm = rate(rng);
+    m.moving = unit(rng) < 0.25;
+    double startLoad = body.load;
+    double movedLoad = 350 + 200 * unit(rng);
+    double drift = (unit(rng) - 0.5) * 20;   // Counts over the minute
+    double depth = opt.depth * (0.7 + 0.6 * unit(rng));
+    double moveStart = 10 + 40 * unit(rng);
+    double moveLength = 3 + 12 * unit(rng);
+    for (uint32_t n = 0; n < (uint32_t)hz * 60; n++) {
+        double t = (double)n / hz;
+        double f = m.bpm / 60.0 * (1 + 0.02 * std::sin(2 * M_PI * t / 23));
+        body.phase += 2 * M_PI * f / hz;
+        if (m.moving && t >= moveStart) {
+            body.load = movedLoad;
+        }
+        body.load += drift / 60 / hz;
+        double value = body.load + depth * (std::sin(body.phase) + 0.3 * std::sin(2 * body.phase));
+        if (m.moving && t >= moveStart && t < moveStart + moveLength) {
+            // Shifting over from the old load, with large irregular swings
+            double progress = (t - moveStart) / moveLength;
+            value += (startLoad - movedLoad) * (1 - progress);
+            value += 60 * std::sin(2 * M_PI * 1.3 * t) + 40 * noise(rng);
+        }
+        value += noise(rng);
+        m.samples.push_back((uint16_t)std::lround(std::min(1023.0, std::max(0.0, value))));
+    }
+    return m;
+}
+
+template<uint16_t Hz>
+static void bench(const Options& opt) {
+    std::mt19937 rng(opt.seed * 977 + Hz);
+    std::vector<Minute> minutes;
+    Body body;
+    for (int i = 0; i < opt.minutes; i++) {
+        minutes.push_back(makeMinute(Hz, opt, rng, body));
+    }
+
+    // Timing: best of a few passes over all the minutes
+    uint64_t best = UINT64_MAX;
+    uint64_t samples = 0;
+    for (int run = 0; run < 3; run++) {
+        RespirationExtractor<Hz> extractor;
+        samples = 0;
+        uint64_t start = cycles();
+        for (const Minute& m : minutes) {
+            for (uint16_t s : m.samples) {
+                extractor.add(s);
+            }
+            samples += m.samples.size();
+        }
+        best = std::min(best, cycles() - start);
+    }
+
+    RespirationExtractor<Hz> extractor;
+    int still = 0, stillCorrect = 0, stillWithheld = 0;
+    int moving = 0, movingWrong = 0, movingWithheld = 0;
+    double crossingError = 0;
+    for (size_t i = 0; i < minutes.size(); i++) {
+        const Minute& m = minutes[i];
+        bool done = false;
+        for (uint16_t s : m.samples) {
+            done = extractor.add(s);
+        }
+        if (!done || i == 0) {
+            continue;  // The first minute includes the drift filter settling
+        }
+        const RespirationMinute& r = extractor.minute();
+        int error = std::abs((int)r.breathsPerMin - m.bpm);
+        if (m.moving) {
+            moving++;
+            if (r.breathsPerMin == 0) movingWithheld++;
+            else if (error > 1) movingWrong++;
+        } else {
+            still++;
+            if (r.breathsPerMin == 0) stillWithheld++;
+            else if (error <= 1) stillCorrect++;
+            crossingError += std::fabs(r.zeroCrossings - 2.0 * m.bpm) / (2.0 * m.bpm);
+        }
+    }
+
+    printf("%4u %10.1f %8zu %9.1f%% %9.1f%% %9.1f%% %9.1f%% %9.1f%%\n", Hz, (double)best / samples,
+           sizeof(RespirationExtractor<Hz>), 100.0 * stillCorrect / std::max(1, still),
+           100.0 * stillWithheld / std::max(1, still), 100.0 * crossingError / std::max(1, still),
+           100.0 * movingWithheld / std::max(1, moving), 100.0 * movingWrong / std::max(1, moving));
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (value == nullptr) {
+            fprintf(stderr, "missing value for %s\n", arg);
+            return 1;
+        }
+        if (strcmp(arg, "--minutes") == 0) opt.minutes = atoi(value);
+        else if (strcmp(arg, "--depth") == 0) opt.depth = atof(value);
+        else if (strcmp(arg, "--noise") == 0) opt.noise = atof(value);
+        else if (strcmp(arg, "--seed") == 0) opt.seed = atoi(value);
+        else {
+            fprintf(stderr, "unknown option %s\n", arg);
+            return 1;
+        }
+        i++;
+    }
+
+    printf("%d minutes, breathing depth %.1f counts, noise %.1f counts\n", opt.minutes, opt.depth, opt.noise);
+    printf("  Hz %10s %8s %10s %10s %10s %10s %10s\n", CYCLE_UNIT "/smp", "bytes", "rate+-1", "withheld",
+           "zc_err", "mv_withh", "mv_wrong");
+    bench<50>(opt);
+    bench<100>(opt);
+    return 0;
+}
@@ -0,0 +1,932 @@
+// Run the firmware's RTDB client (rtdbClient.h) against a local stand-in for
+// Firebase and check it, then measure it.
+//
+// The stand-in speaks plain HTTP/1.1 on loopback and routes on the Host
+// header like the real services: sign-in (auth.test), token refresh
+// (token.test), the database (db.test) and a stream server the database
+// redirects event streams to (stream.test). It checks every ID token, keeps
+// what is written and can split responses into small pieces, send them
+// chunked, close kept-alive connections, revoke tokens and expire them early.
+// The client runs over POSIX sockets standing in for WiFiClientSecure.
+// Checks:
+// - sign-in, PUT of a bed record, PATCH of several beds, GET of bed settings
+//   and of a missing node: what the stand-in stored must parse as JSON and
+//   hold the values written; the settings must be read back field by field
+// - responses dribbled a few bytes at a time and chunked
+// - tokens refreshed before they expire, and renewed after a revocation, with
+//   the request that hit the 401 sent once more
+// - kept-alive connections closed by the server, Connection: close, and a
+//   write without waiting for the reply followed by another request
+// - a settings stream: redirected, every change seen, reopened after the
+//   server drops it
+// Then it times --requests bed record PUTs over the kept-alive connection,
+// counting heap allocations on the client's thread (must be none), and
+// prints the client's fixed memory. Flash and the device's heap against
+// Firebase_ESP_Client come from build_matrix.sh --baseline (docs/HARDWARE.md).
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -pthread -I"hardware/ESP8266 Code" tools/rtdb_client_check.cpp -o rtdb_client_check
+// Usage:
+//   ./rtdb_client_check [--requests 2000] [--rtt-ms 0]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "rtdbClient.h"
+
+// Heap allocations made on the client's thread while counting is on
+static thread_local bool countAllocations = false;
+static std::atomic<uint64_t> allocations{0};
+
+// Every replaceable form, so each new is paired with a delete that frees the
+// same way. The deletes free out of line: inlined, GCC's
+// -Wmismatched-new-delete sees a pointer from operator new reach free().
+__attribute__((noinline)) static void release(void* p) noexcept { free(p); }
+
+void* operator new(size_t size) {
+    if (countAllocations) allocations++;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    if (countAllocations) allocations++;
+    return malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void* operator new(size_t size, std::align_val_t align) {
+    if (countAllocations) allocations++;
+    size_t alignment = (size_t)align < sizeof(void*) ? sizeof(void*) : (size_t)align;
+    void* p = nullptr;
+    if (posix_memalign(&p, alignment, size ? size : 1) != 0) throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size, std::align_val_t align) { return operator new(size, align); }
+void operator delete(void* p) noexcept { release(p); }
+void operator delete[](void* p) noexcept { release(p); }
+void operator delete(void* p, size_t) noexcept { release(p); }
+void operator delete[](void* p, size_t) noexcept { release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { release(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { release(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { release(p); }
+
+static uint64_t nowUs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void sleepMs(int ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+// ---- Minimal JSON reader, to check what the client wrote ----
+
+struct Json {
+    enum Type { NUL, BOOL, NUMBER, STRING, OBJECT, ARRAY } type = NUL;
+    std::string text;                                   // Scalar as written (strings unescaped)
+    std::vector<std::pair<std::string, Json>> members;  // Object members or array items
+
+    const Json* get(const std::string& key) const {
+        for (const auto& m : members) {
+            if (m.first == key) return &m.second;
+        }
+        return nullptr;
+    }
+};
+
+struct JsonReader {
+    const std::string& s;
+    size_t i = 0;
+    bool ok = true;
+
+    explicit JsonReader(const std::string& text) : s(text) {}
+
+    void space() {
+        while (i < s.size() && strchr(" \t\r\n", s[i]) != nullptr) i++;
+    }
+
+    std::string string() {
+        std::string out;
+        i++;
+        while (i < s.size() && s[i] != '"') {
+            if (s[i] == '\\' && i + 1 < s.size()) {
+                i++;
+                out += s[i] == 'n' ? '\n' : s[i];
+            } else if ((unsigned char)s[i] < 0x20) {
+                ok = false;
+            } else {
+                out += s[i];
+            }
+            i++;
+        }
+        if (i >= s.size()) ok = false;
+        i++;
+        return out;
+    }
+
+    Json value() {
+        Json v;
+        space();
+        if (i >= s.size()) {
+            ok = false;
+            return v;
+        }
+        char c = s[i];
+        if (c == '{' || c == '[') {
+            v.type = c == '{' ? Json::OBJECT : Json::ARRAY;
+            i++;
+            space();
+            if (i < s.size() && s[i] == (c == '{' ? '}' : ']')) {
+                i++;
+                return v;
+            }
+            while (ok) {
+                std::string key;
+                if (c == '{') {
+                    space();
+                    if (i >= s.size() || s[i] != '"') {
+                        ok = false;
+                        break;
+                    }
+                    key = string();
+                    space();
+                    if (i >= s.size() || s[i] != ':') {
+                        ok = false;
+                        break;
+                    }
+                    i++;
+                }
+                v.members.emplace_back(key, value());
+                space();
+                if (i < s.size() && s[i] == ',') {
+                    i++;
+                } else if (i < s.size() && s[i] == (c == '{' ? '}' : ']')) {
+                    i++;
+                    break;
+                } else {
+                    ok = false;
+                }
+            }
+        } else if (c == '"') {
+            v.type = Json::STRING;
+            v.text = string();
+        } else {
+            size_t start = i;
+            while (i < s.size() && strchr(",}] \t\r\n", s[i]) == nullptr) i++;
+            v.text = s.substr(start, i - start);
+            if (v.text == "null") v.type = Json::NUL;
+            else if (v.text == "true" || v.text == "false") v.type = Json::BOOL;
+            else {
+                v.type = Json::NUMBER;
+                char* end;
+                strtod(v.text.c_str(), &end);
+                if (v.text.empty() || *end != '\0') ok = false;
+            }
+        }
+        return v;
+    }
+};
+
+static bool parseJson(const std::string& text, Json& out) {
+    JsonReader reader(text);
+    out = reader.value();
+    reader.space();
+    return reader.ok && reader.i == text.size();
+}
+
+// ---- Local stand-in for Firebase ----
+
+#define API_KEY         "test-api-key"
+#define EMAIL           "bed@ward.test"
+#define PASSWORD        "secret"
+#define CONFIG_PATH     "/bedConfig/bed1"
+
+struct StandIn {
+    // Behaviour, changed by the checks between runs
+    std::atomic<int> tokenLifetimeS{3600};
+    std::atomic<bool> dribble{false};       // Responses in pieces of 1-40 bytes
+    std::atomic<bool> chunked{false};       // GET bodies with chunked transfer encoding
+    std::atomic<int> dropEvery{0};          // Close a kept-alive connection instead of answering every n-th request
+    std::atomic<int> closeEvery{0};         // Connection: close on every n-th response
+    std::atomic<int> rttUs{0};              // Added before each database response
+    std::atomic<int> keepAliveMs{1000};     // Stream keep-alive period
+    std::atomic<bool> killStreams{false};
+
+    // What happened
+    std::atomic<uint32_t> signIns{0}, refreshes{0}, unauthorized{0}, dropped{0};
+    std::atomic<uint32_t> streamOpens{0}, streamRedirects{0}, badRequests{0}, invalidJson{0};
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::map<std::string, std::string> nodes;
+    std::map<std::string, uint64_t> idTokens;   // Token -> expiry, us
+    std::set<std::string> refreshTokens;
+    uint64_t version = 0;
+    uint32_t issued = 0;
+
+    int listener = -1;
+    uint16_t port = 0;
+    std::atomic<bool> running{true};
+    std::thread acceptor;
+    std::vector<std::thread> connections;
+    std::mutex connectionsLock;
+
+    void start() {
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(listener, (sockaddr*)&address, sizeof(address));
+        socklen_t length = sizeof(address);
+        getsockname(listener, (sockaddr*)&address, &length);
+        port = ntohs(address.sin_port);
+        listen(listener, 64);
+        acceptor = std::thread([this] {
+            while (running) {
+                int fd = accept(listener, nullptr, nullptr);
+                if (fd < 0) continue;
+                if (!running) {
+                    close(fd);
+                    break;
+                }
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                std::lock_guard<std::mutex> guard(connectionsLock);
+                connections.emplace_back([this, fd] { serve(fd); });
+            }
+        });
+    }
+
+    void stop() {
+        running = false;
+        changed.notify_all();
+        shutdown(listener, SHUT_RDWR);
+        close(listener);
+        acceptor.join();
+        std::lock_guard<std::mutex> guard(connectionsLock);
+        for (auto& t : connections) t.join();
+    }
+
+    void setNode(const std::string& path, const std::string& json) {
+        std::lock_guard<std::mutex> guard(lock);
+        nodes[path] = json;
+        version++;
+        changed.notify_all();
+    }
+
+    std::string node(const std::string& path) {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = nodes.find(path);
+        return it == nodes.end() ? std::string() : it->second;
+    }
+
+    void revokeTokens() {
+        std::lock_guard<std::mutex> guard(lock);
+        idTokens.clear();
+    }
+
+    struct Request {
+        std::string method, path, query, host, accept, body;
+    };
+
+    // Reads one request; false when the connection closed
+    static bool readRequest(int fd, std::string& pending, Request& request) {
+        size_t end;
+        while ((end = pending.find("\r\n\r\n")) == std::string::npos) {
+            char buffer[4096];
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) return false;
+            pending.append(buffer, n);
+        }
+        std::string head = pending.substr(0, end);
+        pending.erase(0, end + 4);
+        size_t sp1 = head.find(' '), sp2 = head.find(' ', sp1 + 1);
+        request.method = head.substr(0, sp1);
+        std::string target = head.substr(sp1 + 1, sp2 - sp1 - 1);
+        size_t q = target.find('?');
+        request.path = target.substr(0, q);
+        request.query = q == std::string::npos ? "" : target.substr(q + 1);
+        size_t contentLength = 0;
+        request.host.clear();
+        request.accept.clear();
+        size_t line = head.find("\r\n");
+        while (line != std::string::npos) {
+            size_t next = head.find("\r\n", line + 2);
+            std::string header = head.substr(line + 2, next == std::string::npos ? std::string::npos : next - line - 2);
+            size_t colon = header.find(':');
+            if (colon != std::string::npos) {
+                std::string name = header.substr(0, colon), value = header.substr(colon + 1);
+                while (!value.empty() && value[0] == ' ') value.erase(0, 1);
+                for (auto& c : name) c = (char)tolower(c);
+                if (name == "host") request.host = value;
+                if (name == "accept") request.accept = value;
+                if (name == "content-length") contentLength = strtoul(value.c_str(), nullptr, 10);
+            }
+            line = next;
+        }
+        while (pending.size() < contentLength) {
+            char buffer[4096];
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n <= 0) return false;
+            pending.append(buffer, n);
+        }
+        request.body = pending.substr(0, contentLength);
+        pending.erase(0, contentLength);
+        return true;
+    }
+
+    static std::string param(const std::string& query, const std::string& name) {
+        size_t start = 0;
+        while (start <= query.size()) {
+            size_t end = query.find('&', start);
+            std::string pair = query.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            if (pair.compare(0, name.size() + 1, name + "=") == 0) return pair.substr(name.size() + 1);
+            if (end == std::string::npos) break;
+            start = end + 1;
+        }
+        return "";
+    }
+
+    bool sendAll(int fd, const std::string& data, std::mt19937& rng) {
+        size_t i = 0;
+        while (i < data.size()) {
+            size_t n = data.size() - i;
+            if (dribble) {
+                n = std::min<size_t>(n, 1 + rng() % 40);
+            }
+            ssize_t sent = send(fd, data.data() + i, n, MSG_NOSIGNAL);
+            if (sent <= 0) return false;
+            i += sent;
+            if (dribble) std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        return true;
+    }
+
+    bool respond(int fd, int status, const std::string& body, bool closeAfter, std::mt19937& rng,
+                 bool chunk = false, const std::string& extra = "") {
+        const char* reason = status == 200 ? "OK" : status == 204 ? "No Content" : status == 307
+                             ? "Temporary Redirect" : status == 401 ? "Unauthorized" : "Bad Request";
+        std::string out = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n" + extra;
+        out += "Content-Type: application/json; charset=utf-8\r\n";
+        if (closeAfter) out += "Connection: close\r\n";
+        if (status == 204) {
+            out += "\r\n";
+        } else if (chunk) {
+            out += "Transfer-Encoding: chunked\r\n\r\n";
+            size_t i = 0;
+            while (i < body.size()) {
+                size_t n = std::min<size_t>(body.size() - i, 1 + rng() % 24);
+                char size[16];
+                snprintf(size, sizeof(size), "%zx\r\n", n);
+                out += size + body.substr(i, n) + "\r\n";
+                i += n;
+            }
+            out += "0\r\n\r\n";
+        } else {
+            out += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+        }
+        return sendAll(fd, out, rng);
+    }
+
+    std::string newToken(const char* prefix, size_t length) {
+        std::string token = prefix + std::to_string(++issued) + ".";
+        while (token.size() < length) token += (char)('a' + (token.size() * 7 + issued) % 26);
+        return token;
+    }
+
+    void serve(int fd) {
+        std::mt19937 rng(fd * 7919u);
+        std::string pending;
+        uint32_t served = 0;
+        Request request;
+        while (running && readRequest(fd, pending, request)) {
+            served++;
+            if (request.host == "auth.test" || request.host == "token.test") {
+                if (!auth(fd, request, rng)) break;
+                continue;
+            }
+            if (request.host != "db.test" && request.host != "stream.test") {
+                badRequests++;
+                respond(fd, 400, "{\"error\":\"unknown host\"}", true, rng);
+                break;
+            }
+            int every = dropEvery;
+            if (every > 0 && served > 1 && served % every == 0) {
+                dropped++;                  // Kept-alive connection timed out on the server
+                break;
+            }
+            if (!database(fd, request, served, rng)) break;
+        }
+        close(fd);
+    }
+
+    bool auth(int fd, const Request& request, std::mt19937& rng) {
+        if (param(request.query, "key") != API_KEY) {
+            badRequests++;
+            return respond(fd, 400, "{\"error\":{\"code\":400,\"message\":\"API key not valid\"}}", false, rng);
+        }
+        std::string lifetime = std::to_string(tokenLifetimeS.load());
+        std::lock_guard<std::mutex> guard(lock);
+        uint64_t expiry = nowUs() + (uint64_t)tokenLifetimeS * 1000000;
+        if (request.path == "/v1/accounts:signInWithPassword" && request.host == "auth.test") {
+            Json body;
+            const Json *email, *password;
+            if (!parseJson(request.body, body) || (email = body.get("email")) == nullptr ||
+                (password = body.get("password")) == nullptr || email->text != EMAIL || password->text != PASSWORD) {
+                badRequests++;
+                return respond(fd, 400, "{\"error\":{\"code\":400,\"message\":\"INVALID_PASSWORD\","
+                                        "\"errors\":[{\"message\":\"INVALID_PASSWORD\"}]}}", false, rng);
+            }
+            signIns++;
+            std::string id = newToken("id", 1000), refresh = newToken("rt", 260);
+            idTokens[id] = expiry;
+            refreshTokens.insert(refresh);
+            return respond(fd, 200, "{\n  \"kind\": \"identitytoolkit#VerifyPasswordResponse\",\n  \"localId\": "
+                                    "\"u1\",\n  \"email\": \"" EMAIL "\",\n  \"displayName\": \"\",\n  \"idToken\": \"" +
+                                    id + "\",\n  \"registered\": true,\n  \"refreshToken\": \"" + refresh +
+                                    "\",\n  \"expiresIn\": \"" + lifetime + "\"\n}\n", false, rng);
+        }
+        if (request.path == "/v1/token" && request.host == "token.test") {
+            std::string refresh = param(request.body, "refresh_token");
+            if (param(request.body, "grant_type") != "refresh_token" || refreshTokens.count(refresh) == 0) {
+                badRequests++;
+                return respond(fd, 400, "{\"error\":{\"code\":400,\"message\":\"INVALID_REFRESH_TOKEN\"}}", false, rng);
+            }
+            refreshes++;
+            std::string id = newToken("id", 1000);
+            idTokens[id] = expiry;
+            return respond(fd, 200, "{\"access_token\":\"" + id + "\",\"expires_in\":\"" + lifetime +
+                                    "\",\"token_type\":\"Bearer\",\"refresh_token\":\"" + refresh +
+                                    "\",\"id_token\":\"" + id + "\",\"user_id\":\"u1\",\"project_id\":\"1\"}", false, rng);
+        }
+        badRequests++;
+        return respond(fd, 400, "{\"error\":\"not found\"}", false, rng);
+    }
+
+    bool database(int fd, const Request& request, uint32_t served, std::mt19937& rng) {
+        int every = closeEvery;
+        bool closeAfter = every > 0 && served % every == 0;
+        if (request.path.size() < 5 || request.path.compare(request.path.size() - 5, 5, ".json") != 0) {
+            badRequests++;
+            return respond(fd, 400, "{\"error\":\"path must end in .json\"}", true, rng) && false;
+        }
+        std::string path = request.path.substr(0, request.path.size() - 5);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            auto token = idTokens.find(param(request.query, "auth"));
+            if (token == idTokens.end() || token->second < nowUs()) {
+                unauthorized++;
+                return respond(fd, 401, "{\n  \"error\" : \"Auth token is expired\"\n}\n", closeAfter, rng);
+            }
+        }
+        if (path == "/forbidden") {
+            return respond(fd, 401, "{\n  \"error\" : \"Permission denied\"\n}\n", closeAfter, rng);
+        }
+        if (rttUs > 0) std::this_thread::sleep_for(std::chrono::microseconds(rttUs.load()));
+
+        if (request.method == "GET" && request.accept == "text/event-stream") {
+            return stream(fd, request, path, rng);
+        }
+        if (request.method == "GET") {
+            std::string body = node(path);
+            return respond(fd, 200, body.empty() ? "null" : body, closeAfter, rng, chunked);
+        }
+        Json body;
+        if (!parseJson(request.body, body) || body.type != Json::OBJECT) {
+            invalidJson++;
+            return respond(fd, 400, "{\n  \"error\" : \"Invalid data; couldn't parse JSON object.\"\n}\n", true, rng) &&
+                   false;
+        }
+        if (request.method == "PUT") {
+            setNode(path, request.body);
+        } else if (request.method == "PATCH") {
+            // Children are kept as written, one node each
+            JsonReader reader(request.body);
+            reader.space();
+            reader.i++;
+            while (reader.ok && reader.i < request.body.size()) {
+                reader.space();
+                if (request.body[reader.i] == '}') break;
+                std::string key = reader.string();
+                reader.space();
+                reader.i++;
+                reader.space();
+                size_t start = reader.i;
+                reader.value();
+                setNode(path + "/" + key, request.body.substr(start, reader.i - start));
+                reader.space();
+                if (reader.i < request.body.size() && request.body[reader.i] == ',') reader.i++;
+            }
+        } else {
+            badRequests++;
+            return respond(fd, 400, "{\"error\":\"method\"}", true, rng) && false;
+        }
+        if (param(request.query, "print") == "silent") {
+            return respond(fd, 204, "", closeAfter, rng) && !closeAfter;
+        }
+        return respond(fd, 200, request.body, closeAfter, rng) && !closeAfter;
+    }
+
+    // Event stream: the database host redirects to the stream host
+    bool stream(int fd, const Request& request, const std::string& path, std::mt19937& rng) {
+        if (request.host == "db.test") {
+            streamRedirects++;
+            respond(fd, 307, "{\"error\":\"redirect\"}", true, rng,
+                    false, "Location: https://stream.test" + request.path + "?" + request.query + "\r\n");
+            return false;
+        }
+        streamOpens++;
+        std::string head = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n\r\n";
+        if (!sendAll(fd, head, rng)) return false;
+        std::string token = param(request.query, "auth");
+        uint64_t seen = ~0ull;
+        while (running && !killStreams) {
+            std::string event;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                if (seen == version) {
+                    changed.wait_for(guard, std::chrono::milliseconds(keepAliveMs.load()));
+                }
+                auto it = idTokens.find(token);
+                if (it == idTokens.end() || it->second < nowUs()) {
+                    event = "event: auth_revoked\ndata: \"credential is no longer valid\"\n\n";
+                } else if (seen != version) {
+                    seen = version;
+                    auto node = nodes.find(path);
+                    event = "event: put\ndata: {\"path\":\"/\",\"data\":" +
+                            (node == nodes.end() ? std::string("null") : node->second) + "}\n\n";
+                } else {
+                    event = "event: keep-alive\ndata: null\n\n";
+                }
+            }
+            if (!sendAll(fd, event, rng)) return false;
+            if (event.compare(0, 18, "event: auth_revoke") == 0) break;
+        }
+        return false;
+    }
+};
+
+static StandIn standIn;
+
+// WiFiClientSecure as far as RtdbClient uses it; every host is the stand-in
+struct PosixClient {
+    int fd = -1;
+
+    bool connect(const char*, uint16_t) {
+        stop();
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(standIn.port);
+        if (::connect(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+            stop();
+            return false;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        sleepMs(2);     // The TLS handshake: the clock moves on while connecting
+        return true;
+    }
+
+    bool connected() {
+        if (fd < 0) return false;
+        char c;
+        ssize_t n = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+        return n > 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    }
+
+    int available() {
+        int n = 0;
+        if (fd < 0 || ioctl(fd, FIONREAD, &n) != 0) return 0;
+        return n;
+    }
+
+    int read(uint8_t* buffer, size_t size) {
+        return fd < 0 ? -1 : (int)recv(fd, buffer, size, MSG_DONTWAIT);
+    }
+
+    size_t write(const uint8_t* data, size_t length) {
+        size_t done = 0;
+        while (fd >= 0 && done < length) {
+            ssize_t n = send(fd, data + done, length - done, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            done += n;
+        }
+        return done;
+    }
+
+    void stop() {
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+};
+
+static const RtdbConfig CONFIG = {"https://db.test", API_KEY, EMAIL, PASSWORD, "auth.test", "token.test", 80};
+
+// A bed record as bedUplink.h writes it, trace included
+struct Record {
+    int bed;
+    const char* status;
+    int fsr;
+    int64_t utcMs;
+    int64_t monoMs;
+};
+
+static void writeRecord(JsonOut& json, const Record& r) {
+    json.add("id", (int32_t)r.bed);
+    json.add("status", r.status);
+    json.add("fsrValue", (int32_t)r.fsr);
+    json.add("hasBodyTemp", true);
+    json.add("hasWeight", true);
+    json.add("isOccupied", true);
+    json.addRaw("temperature", "36.45");
+    json.add("lastUpdate", r.utcMs);
+    json.add("eventMonoMs", r.monoMs);
+    json.add("timeSynced", true);
+    json.add("online", true);
+    json.add("lastStaffId", "A1B2C3D4");
+    json.add("configRevision", (int32_t)3);
+    json.add("fsrThreshold", (int32_t)86);
+    json.addRaw("tempThreshold", "32.10");
+    json.add("calibrationConfidence", (int32_t)100);
+    json.add("sensorFaults", (int32_t)0);
+    json.add("occupancyMode", (int32_t)0);
+    json.beginObject("trace");
+    json.add("id", "bed1-00c0ffee-17");
+    json.add("sampleMs", r.monoMs - 40);
+    json.add("decisionMs", r.monoMs - 12);
+    json.add("enqueueMs", r.monoMs);
+    json.add("ackMs", (int64_t)0);
+    json.beginObject("serverMs");
+    json.add(".sv", "timestamp");
+    json.endObject();
+    json.endObject();
+}
+
+static bool recordStored(const std::string& path, const Record& r) {
+    Json node;
+    if (!parseJson(standIn.node(path), node) || node.type != Json::OBJECT) return false;
+    const Json* status = node.get("status");
+    const Json* fsr = node.get("fsrValue");
+    const Json* utc = node.get("lastUpdate");
+    const Json* temperature = node.get("temperature");
+    const Json* trace = node.get("trace");
+    const Json* server = trace ? trace->get("serverMs") : nullptr;
+    return status && status->text == r.status && fsr && atoi(fsr->text.c_str()) == r.fsr && utc &&
+           strtoll(utc->text.c_str(), nullptr, 10) == r.utcMs && temperature && temperature->text == "36.45" &&
+           server && server->get(".sv") && server->get(".sv")->text == "timestamp";
+}
+
+static int failures = 0;
+
+static void check(const char* name, bool ok, const char* detail = "") {
+    printf("%-44s %-5s %s\n", name, ok ? "ok" : "FAIL", detail);
+    if (!ok) failures++;
+}
+
+static bool putRecord(RtdbClient<PosixClient>& rtdb, const Record& r) {
+    char path[24];
+    snprintf(path, sizeof(path), "/beds/bed%d", r.bed);
+    return rtdb.put(path, [&r](JsonOut& json) {
+        json.beginObject();
+        writeRecord(json, r);
+        json.endObject();
+    });
+}
+
+// bedConfig fields as BedUplink::pollSettings reads them
+static bool readSettings(RtdbClient<PosixClient>& rtdb, long& revision, long& threshold, long& interval,
+                         bool& found) {
+    char values[3][12];
+    JsonField fields[] = {
+        {"revision", values[0], sizeof(values[0]), false},
+        {"fsrThreshold", values[1], sizeof(values[1]), false},
+        {"uplinkIntervalMs", values[2], sizeof(values[2]), false}
+    };
+    JsonScan scan(fields, 3);
+    if (!rtdb.get(CONFIG_PATH, scan)) return false;
+    found = fields[0].found;
+    revision = found ? atol(values[0]) : 0;
+    threshold = fields[1].found ? atol(values[1]) : -1;
+    interval = fields[2].found ? atol(values[2]) : -1;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    uint32_t requests = 2000;
+    int rttMs = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--requests") == 0) requests = (uint32_t)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--rtt-ms") == 0) rttMs = atoi(argv[i + 1]);
+    }
+    standIn.start();
+
+    PosixClient transport;
+    RtdbClient<PosixClient> rtdb(transport);
+    rtdb.begin(CONFIG);
+    char detail[160];
+
+    // Sign-in and the three request kinds
+    check("sign-in", rtdb.ready() && standIn.signIns == 1);
+    Record record = {1, "occupied", 612, 1760000000123LL, 86400123};
+    check("PUT bed record", putRecord(rtdb, record) && recordStored("/beds/bed1", record));
+    Record batch[4];
+    bool patched = rtdb.patch("/beds", [&batch](JsonOut& json) {
+        json.beginObject();
+        for (int i = 0; i < 4; i++) {
+            batch[i] = {2 + i, i % 2 ? "unoccupied" : "occupied", 100 * i, 1760000000500LL + i, 86400500 + i};
+            char key[12];
+            snprintf(key, sizeof(key), "bed%d", batch[i].bed);
+            json.beginObject(key);
+            writeRecord(json, batch[i]);
+            json.add("relayedBy", (int32_t)1);
+            json.endObject();
+        }
+        json.endObject();
+    });
+    bool allStored = patched;
+    for (int i = 0; i < 4; i++) {
+        allStored &= recordStored("/beds/bed" + std::to_string(batch[i].bed), batch[i]);
+    }
+    check("PATCH four beds", allStored && standIn.node("/beds/bed1").size() > 0);
+
+    long revision, threshold, interval;
+    bool found;
+    bool read = readSettings(rtdb, revision, threshold, interval, found);
+    check("GET missing settings node", read && !found);
+    standIn.setNode(CONFIG_PATH, "{\"fsrThreshold\":80,\"note\":{\"by\":\"ward \\\"B\\\"\",\"at\":[1,2]},"
+                                 "\"revision\":7,\"uplinkIntervalMs\":5000}");
+    read = readSettings(rtdb, revision, threshold, interval, found);
+    check("GET settings fields", read && found && revision == 7 && threshold == 80 && interval == 5000);
+    check("error reason", !rtdb.put("/forbidden", [](JsonOut& json) {
+        json.beginObject();
+        json.add("x", (int32_t)1);
+        json.endObject();
+    }) && strcmp(rtdb.errorReason(), "HTTP 401 Permission denied") == 0, rtdb.errorReason());
+    check("no bad requests or invalid JSON", standIn.badRequests == 0 && standIn.invalidJson == 0);
+
+    // Responses in small pieces, chunked
+    standIn.dribble = true;
+    standIn.chunked = true;
+    bool pieces = true;
+    for (int i = 0; i < 100 && pieces; i++) {
+        record.fsr = 500 + i;
+        pieces = putRecord(rtdb, record) && recordStored("/beds/bed1", record) &&
+                 readSettings(rtdb, revision, threshold, interval, found) && revision == 7 && threshold == 80;
+    }
+    standIn.dribble = false;
+    standIn.chunked = false;
+    check("dribbled and chunked responses", pieces);
+
+    // Proactive refresh: a 6 s token is renewed at 3 s
+    standIn.tokenLifetimeS = 6;
+    rtdb.begin(CONFIG);
+    uint32_t refreshesBefore = standIn.refreshes, unauthorizedBefore = standIn.unauthorized;
+    bool allOk = true;
+    uint64_t until = nowUs() + 10000000;
+    uint32_t sent = 0;
+    while (nowUs() < until) {
+        record.fsr = 300 + sent++ % 300;
+        allOk &= putRecord(rtdb, record);
+        sleepMs(50);
+    }
+    snprintf(detail, sizeof(detail), "%u refreshes, %u rejected, over %u requests",
+             standIn.refreshes - refreshesBefore, standIn.unauthorized - unauthorizedBefore, sent);
+    check("token refreshed before expiry", allOk && standIn.refreshes - refreshesBefore >= 2 &&
+          standIn.unauthorized == unauthorizedBefore, detail);
+    standIn.tokenLifetimeS = 3600;
+    rtdb.begin(CONFIG);
+
+    // Revoked token: one 401, renewed, sent again
+    check("signed in again", rtdb.ready());
+    standIn.revokeTokens();
+    unauthorizedBefore = standIn.unauthorized;
+    record.fsr = 42;
+    check("revoked token renewed and resent", putRecord(rtdb, record) && recordStored("/beds/bed1", record) &&
+          standIn.unauthorized == unauthorizedBefore + 1);
+
+    // Server closing kept-alive connections
+    standIn.dropEvery = 5;
+    standIn.closeEvery = 7;
+    allOk = true;
+    for (int i = 0; i < 300; i++) {
+        record.fsr = i;
+        allOk &= putRecord(rtdb, record);
+    }
+    snprintf(detail, sizeof(detail), "%u dropped by the server", standIn.dropped.load());
+    check("closed connections reopened", allOk && recordStored("/beds/bed1", record) && standIn.dropped > 0,
+          detail);
+    standIn.dropEvery = 0;
+    standIn.closeEvery = 0;
+
+    // Write without waiting, then a request that has to read past its reply
+    bool alert = rtdb.put("/alerts/bed1", [](JsonOut& json) {
+        json.beginObject();
+        json.add("type", "bedExitRisk");
+        json.add("active", true);
+        json.endObject();
+    }, false);
+    read = readSettings(rtdb, revision, threshold, interval, found);
+    check("write without waiting for the reply", alert && read && revision == 7 &&
+          standIn.node("/alerts/bed1").find("bedExitRisk") != std::string::npos);
+
+    // Settings stream
+    PosixClient streamTransport;
+    RtdbStream<PosixClient, PosixClient> stream(streamTransport, rtdb);
+    stream.begin(CONFIG_PATH);
+    standIn.keepAliveMs = 200;
+    auto waitChange = [&stream](uint32_t ms) {
+        uint64_t end = nowUs() + (uint64_t)ms * 1000;
+        while (nowUs() < end) {
+            if (stream.poll()) return true;
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        return false;
+    };
+    bool opened = waitChange(2000);
+    check("stream opened through the redirect", opened && stream.live() && standIn.streamRedirects == 1 &&
+          standIn.streamOpens == 1);
+    check("keep-alives are not changes", !waitChange(700));
+    uint64_t worstUs = 0;
+    bool seenAll = true;
+    for (int i = 0; i < 5; i++) {
+        uint64_t start = nowUs();
+        standIn.setNode(CONFIG_PATH, "{\"revision\":" + std::to_string(8 + i) + ",\"fsrThreshold\":90}");
+        seenAll &= waitChange(1000);
+        worstUs = std::max(worstUs, nowUs() - start);
+    }
+    snprintf(detail, sizeof(detail), "worst %.1f ms from write to poll()", worstUs / 1000.0);
+    check("every settings change seen", seenAll, detail);
+    standIn.killStreams = true;
+    sleepMs(300);
+    standIn.killStreams = false;
+    bool reopened = waitChange(RTDB_STREAM_RETRY_MS + 3000);
+    check("dropped stream reopened", reopened && stream.live() && stream.connects() >= 3);
+    stream.end();
+
+    // Steady state: bed record PUTs on the kept-alive connection
+    standIn.rttUs = rttMs * 1000;
+    std::vector<uint32_t> latencies;
+    latencies.reserve(requests);
+    RtdbStats before = rtdb.statistics();
+    allOk = true;
+    countAllocations = true;
+    allocations = 0;
+    for (uint32_t i = 0; i < requests; i++) {
+        record.fsr = (int)(i % 1024);
+        record.monoMs += 500;
+        uint64_t start = nowUs();
+        allOk &= putRecord(rtdb, record);
+        latencies.push_back((uint32_t)(nowUs() - start));
+    }
+    countAllocations = false;
+    const RtdbStats& after = rtdb.statistics();
+    check("steady-state requests", allOk && recordStored("/beds/bed1", record));
+    snprintf(detail, sizeof(detail), "%llu over %u requests", (unsigned long long)allocations.load(), requests);
+    check("no heap allocations", allocations == 0, detail);
+
+    std::sort(latencies.begin(), latencies.end());
+    uint64_t total = 0;
+    for (uint32_t v : latencies) total += v;
+    size_t n = latencies.size();
+    printf("\nbed record PUT over loopback%s: %u requests\n", rttMs ? " with added delay" : "", requests);
+    printf("  latency_us  avg %llu  p50 %u  p99 %u  max %u\n", (unsigned long long)(n ? total / n : 0),
+           n ? latencies[n / 2] : 0, n ? latencies[n * 99 / 100] : 0, n ? latencies[n - 1] : 0);
+    printf("  bytes/request  out %u  in %u;  connections opened %u\n",
+           requests ? (after.bytesOut - before.bytesOut) / requests : 0,
+           requests ? (after.bytesIn - before.bytesIn) / requests : 0, after.connects - before.connects);
+    printf("  fixed memory  RtdbClient %zu bytes (tokens %u, output chunk %u, response parser %zu), "
+           "RtdbStream %zu bytes\n", sizeof(RtdbClient<PosixClient>) - sizeof(PosixClient*),
+           RTDB_ID_TOKEN_BYTES + RTDB_REFRESH_TOKEN_BYTES, RTDB_CHUNK_BYTES, sizeof(HttpResponse),
+           sizeof(RtdbStream<PosixClient, PosixClient>));
+    printf("  stack  request %u byte read buffer; a refresh copies the refresh token (%u)\n", RTDB_READ_BYTES,
+           RTDB_REFRESH_TOKEN_BYTES);
+
+    rtdb.end();
+    standIn.stop();
+    printf("\n%s\n", failures == 0 ? "all checks passed" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+// Inject sensor faults into a simulated bed and check the health monitor
+// (sensorHealth.h) finds them and keeps occupancy right.
+//
+// A bed is sampled every 500 ms for twelve hours while patients come and go,
+// running the firmware's BedController. Each scenario breaks a sensor three
+// hours in: the MLX90614 missing at boot, frozen on one reading, dropping a
+// third of its reads, unplugged and back; the FSR unplugged, frozen on one
+// reading, its ADC failing; both at once. Per scenario it reports:
+// - detect: time from the fault to the monitor flagging it, and the mode the
+//   bed ends up in
+// - wrong: share of the time after the fault that the bed reported the wrong
+//   occupancy, with the monitor and with both sensors required as before
+//   (sample transitions within the confirm window are not counted)
+// - false: faults raised on a healthy run (must be none)
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -DFEATURE_PERSISTENCE=0 -I"hardware/ESP8266 Code" tools/sensor_fault_check.cpp -o sensor_fault_check
+// Usage:
+//   ./sensor_fault_check [--seeds 5] [--hours 12]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "bedConfig.h"
+#include "bedController.h"
+
+static const uint32_t HOUR_MS = 3600000UL;
+static const uint32_t FAULT_AT_MS = 3 * HOUR_MS;
+static const uint32_t GRACE_MS = 10000;     // After a patient moves, before a wrong report counts
+
+struct SimIo {
+    uint32_t faultChanges = 0;
+    void show(uint8_t, TextId, TextId, uint32_t) {}
+    void redraw(uint8_t) {}
+    void publish(uint8_t) {}
+    void trace(uint8_t, uint32_t) {}
+    template<typename... Args>
+    void log(uint8_t, LogId id, const Args&...) {
+        if (id == LOG_SENSOR_HEALTH) faultChanges++;
+    }
+};
+
+enum Scenario {
+    HEALTHY,
+    MLX_MISSING,            // No answer from boot
+    MLX_FROZEN,             // Same reading forever
+    MLX_FLAKY,              // A third of the reads fail
+    MLX_UNPLUGGED,          // Gone for an hour, then back
+    FSR_UNPLUGGED,          // Input pulled to 0, no noise
+    FSR_FROZEN,             // External ADC repeating its last conversion
+    FSR_ADC_FAILING,        // Every conversion fails
+    BOTH_GONE,
+    SCENARIOS
+};
+
+static const char* SCENARIO_NAMES[] = {
+    "healthy", "mlx missing at boot", "mlx frozen", "mlx 33% read errors", "mlx unplugged 1 h",
+    "fsr unplugged", "fsr frozen", "fsr adc failing", "fsr and mlx gone"
+};
+
+struct Result {
+    uint32_t detectMs = UINT32_MAX;
+    uint8_t finalFaults = 0;
+    OccupancyMode finalMode = OCCUPANCY_BOTH;
+    uint64_t countedMs = 0, wrongMs = 0, wrongBeforeMs = 0;
+    uint32_t faultChanges = 0;
+    bool recovered = false;
+};
+
+static Result run(Scenario scenario, unsigned seed, uint32_t hours) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> n(0, 1);
+    SimIo io;
+    BedController<SimIo> bed;
+    bed.begin(&io, 0);
+    bool mlxAtBoot = scenario != MLX_MISSING;
+    if (!mlxAtBoot) {
+        bed.temperatureHealth().fail(FAULT_ERRORS);  // setup() found no MLX90614
+    }
+
+    Result result;
+    bool patient = false;
+    uint32_t nextMoveMs = 10 * 60000UL;     // Empty for the first ten minutes: calibration learns
+    uint32_t movedMs = 0;
+    centi_t frozen = 0;
+    int frozenFsr = -1;
+    uint32_t endMs = hours * HOUR_MS;
+    for (uint32_t now = DEFAULT_SETTINGS.sampleIntervalMs; now <= endMs; now += DEFAULT_SETTINGS.sampleIntervalMs) {
+        if (now >= nextMoveMs) {
+            patient = !patient;
+            movedMs = now;
+            nextMoveMs = now + (patient ? 30 + rng() % 90 : 5 + rng() % 25) * 60000UL;
+        }
+        bool faulted = scenario == MLX_MISSING || now >= FAULT_AT_MS;
+
+        // FSR: mattress preload plus ADC noise, a patient adds load and movement
+        int fsr = (int)((patient ? 620 + 15 * n(rng) : 30 + 2 * n(rng)) + 0.5);
+        if (faulted && (scenario == FSR_UNPLUGGED || scenario == BOTH_GONE)) fsr = 0;
+        if (faulted && scenario == FSR_ADC_FAILING) fsr = FSR_INVALID;
+        if (faulted && scenario == FSR_FROZEN) {
+            if (frozenFsr < 0) frozenFsr = fsr;
+            fsr = frozenFsr;
+        }
+
+        // MLX90614: skin or mattress surface, about 0.03 °C of noise
+        centi_t object = (centi_t)((patient ? 3420 : 2450) + 3 * n(rng));
+        centi_t ambient = bed.ambientDue() ? (centi_t)(2300 + 3 * n(rng)) : AMBIENT_INVALID;
+        bool mlxGone = scenario == MLX_MISSING || scenario == BOTH_GONE ||
+                       (scenario == MLX_UNPLUGGED && now < FAULT_AT_MS + HOUR_MS);
+        if (faulted && mlxGone) {
+            object = CENTI_INVALID;
+            ambient = bed.ambientDue() ? CENTI_INVALID : AMBIENT_INVALID;
+        }
+        if (faulted && scenario == MLX_FROZEN) {
+            if (frozen == 0) frozen = object;
+            object = frozen;
+        }
+        if (faulted && scenario == MLX_FLAKY && rng() % 3 == 0) object = CENTI_INVALID;
+
+        bed.sample(fsr, object, ambient, now, DEFAULT_SETTINGS);
+
+        if (faulted && bed.sensorFaults() != 0 && result.detectMs == UINT32_MAX) {
+            result.detectMs = now - (scenario == MLX_MISSING ? 0 : FAULT_AT_MS);
+        }
+        if (scenario == MLX_UNPLUGGED && now > FAULT_AT_MS + HOUR_MS && bed.sensorFaults() == 0) {
+            result.recovered = true;
+        }
+        if ((faulted || scenario == HEALTHY) && now - movedMs > DEFAULT_SETTINGS.unoccupiedConfirmMs + GRACE_MS) {
+            const OccupancyCalibration& cal = bed.occupancy();
+            result.countedMs += DEFAULT_SETTINGS.sampleIntervalMs;
+            if (bed.isOccupied() != patient) result.wrongMs += DEFAULT_SETTINGS.sampleIntervalMs;
+            if ((cal.weightDetected() && cal.bodyTempDetected()) != patient) {
+                result.wrongBeforeMs += DEFAULT_SETTINGS.sampleIntervalMs;
+            }
+        }
+    }
+    result.finalFaults = bed.sensorFaults();
+    result.finalMode = bed.occupancyMode();
+    result.faultChanges = io.faultChanges;
+    return result;
+}
+
+int main(int argc, char** argv) {
+    unsigned seeds = 5;
+    uint32_t hours = 12;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--seeds") == 0) seeds = (unsigned)atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--hours") == 0) hours = (uint32_t)atoi(argv[i + 1]);
+    }
+    if (hours < 6) hours = 6;
+
+    static const char* MODE_NAMES[] = {"both", "weight", "heat", "held"};
+    printf("%-22s %10s %9s %7s %9s %9s %7s\n", "scenario", "detect_s", "faults", "mode", "wrong%", "before%",
+           "false");
+    bool ok = true;
+    for (int s = 0; s < SCENARIOS; s++) {
+        uint64_t counted = 0, wrong = 0, wrongBefore = 0;
+        uint32_t worstDetect = 0, falseAlarms = 0;
+        uint8_t faults = 0;
+        OccupancyMode mode = OCCUPANCY_BOTH;
+        bool detectedAll = true, recoveredAll = true;
+        for (unsigned seed = 1; seed <= seeds; seed++) {
+            Result r = run((Scenario)s, seed, hours);
+            counted += r.countedMs;
+            wrong += r.wrongMs;
+            wrongBefore += r.wrongBeforeMs;
+            if (s == HEALTHY) {
+                falseAlarms += r.faultChanges;
+            } else if (r.detectMs == UINT32_MAX) {
+                detectedAll = false;
+            } else if (r.detectMs > worstDetect) {
+                worstDetect = r.detectMs;
+            }
+            faults |= r.finalFaults;
+            mode = r.finalMode;
+            recoveredAll &= r.recovered;
+        }
+        double wrongPct = counted ? 100.0 * wrong / counted : 0;
+        double beforePct = counted ? 100.0 * wrongBefore / counted : 0;
+        char detect[16] = "-";
+        if (s != HEALTHY) {
+            if (detectedAll) snprintf(detect, sizeof(detect), "%.0f", worstDetect / 1000.0);
+            else snprintf(detect, sizeof(detect), "missed");
+        }
+        printf("%-22s %10s %9.2x %7s %9.2f %9.2f %7u\n", SCENARIO_NAMES[s], detect, faults,
+               s == MLX_UNPLUGGED ? (recoveredAll ? "back" : "stuck") : MODE_NAMES[mode], wrongPct, beforePct,
+               falseAlarms);
+        bool scenarioOk = s == HEALTHY ? falseAlarms == 0 : detectedAll;
+        if (s == MLX_UNPLUGGED) scenarioOk &= recoveredAll;
+        if (s != BOTH_GONE) scenarioOk &= wrongPct < 1.0;  // With nothing left the bed holds its last state
+        if (!scenarioOk) {
+            printf("  ^ FAILED\n");
+            ok = false;
+        }
+    }
+    printf("\ndetect_s: worst time from fault to flag over %u seeds; faults: final sensorFaults byte\n"
+           "(fsr low nibble, temperature high; 1 stuck, 2 flat, 4 range, 8 errors); mode: final occupancy\n"
+           "inputs; wrong%%/before%%: time with the wrong occupancy after the fault, with the monitor and with\n"
+           "both sensors required as before; false: fault changes on healthy runs\n",
+           seeds);
+    return ok ? 0 : 1;
+}
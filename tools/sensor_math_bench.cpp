@@ -0,0 +1,110 @@
+// Micro-benchmark of the temperature sampling path: float vs centi-degree integers.
+//
+// Both paths do what readSensors()/updateFirebase() do per sample: convert an
+// MLX90614 register value, median-of-3 filter, test the body-heat threshold
+// and the report delta. The integer path uses sensorMath.h from the firmware.
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -I"hardware/ESP8266 Code" tools/sensor_math_bench.cpp -o sensor_math_bench
+// Usage:
+//   ./sensor_math_bench [samples]
+//
+// A host CPU has an FPU, so the gap here understates the ESP8266, where every
+// float operation in the float path is a soft-float call (__addsf3, __mulsf3,
+// __ltsf2, ...). Cycles are read with rdtsc on x86, otherwise derived from
+// std::chrono nanoseconds.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "sensorMath.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t cycles() { return __rdtsc(); }
+#define CYCLE_UNIT "cycles"
+#else
+static inline uint64_t cycles() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#define CYCLE_UNIT "ns"
+#endif
+
+struct PathResult {
+    uint32_t bodyHeat;      // Samples above the threshold
+    uint32_t reports;       // Samples that would force an uplink
+};
+
+// The float path as the firmware had it: library conversion, float median and compares
+static PathResult floatPath(const std::vector<uint16_t>& raw) {
+    PathResult r = {0, 0};
+    float readings[3] = {0, 0, 0};
+    float lastReported = 0;
+    for (size_t i = 0; i < raw.size(); i++) {
+        readings[i % 3] = raw[i] * 0.02f - 273.15f;
+        float temp = medianOf3(readings[0], readings[1], readings[2]);
+        if (temp > 32.0f) r.bodyHeat++;
+        if (std::fabs(temp - lastReported) > 0.5f) {
+            r.reports++;
+            lastReported = temp;
+        }
+    }
+    return r;
+}
+
+static PathResult centiPath(const std::vector<uint16_t>& raw) {
+    PathResult r = {0, 0};
+    centi_t readings[3] = {0, 0, 0};
+    centi_t lastReported = 0;
+    for (size_t i = 0; i < raw.size(); i++) {
+        readings[i % 3] = mlxRawToCenti(raw[i]);
+        centi_t temp = medianOf3(readings[0], readings[1], readings[2]);
+        if (temp > 3200) r.bodyHeat++;
+        if (centiDelta(temp, lastReported) > 50) {
+            r.reports++;
+            lastReported = temp;
+        }
+    }
+    return r;
+}
+
+template<typename Path>
+static double measure(Path path, const std::vector<uint16_t>& raw, PathResult& result) {
+    uint64_t best = UINT64_MAX;
+    for (int run = 0; run < 5; run++) {
+        uint64_t start = cycles();
+        result = path(raw);
+        uint64_t elapsed = cycles() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return (double)best / raw.size();
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+
+    // Object temperatures wandering between an empty bed and a body, 0.02 K steps
+    std::vector<uint16_t> raw(count);
+    srand(42);
+    int32_t centi = 3000;
+    for (size_t i = 0; i < count; i++) {
+        centi += rand() % 41 - 20;
+        if (centi < 2400) centi = 2400;
+        if (centi > 3700) centi = 3700;
+        raw[i] = (uint16_t)((centi + 27315) / 2);
+    }
+
+    PathResult f, c;
+    double floatCost = measure(floatPath, raw, f);
+    double centiCost = measure(centiPath, raw, c);
+
+    printf("samples=%zu\n", count);
+    printf("%-8s %8.2f %s/sample  body_heat=%u reports=%u\n", "float", floatCost, CYCLE_UNIT, f.bodyHeat, f.reports);
+    printf("%-8s %8.2f %s/sample  body_heat=%u reports=%u\n", "centi", centiCost, CYCLE_UNIT, c.bodyHeat, c.reports);
+    printf("speedup  %.2fx\n", floatCost / centiCost);
+    // Results can differ by a few samples where float rounding lands on a threshold
+    return 0;
+}
@@ -0,0 +1,403 @@
+// Reset a simulated bed at every workflow transition and check that it
+// resumes where it was (bedSnapshot.h).
+//
+// A scripted bed goes through admissions, cleanings (some verifications time
+// out), trips away from the bed, discharges and reassignments, running the
+// firmware's BedController and StateKeeper every 10 ms loop pass against
+// simulated RTC memory and flash. The script is replayed once without resets
+// to record every transition, then once per reset point: right after each
+// transition, and every few seconds in between to check running timers.
+// - warm reset (WDT, exception, brownout that keeps RTC memory): the bed must
+//   come back in the same state, assignment, occupancy and staff ID, with its
+//   timer at most STATE_TIMER_REFRESH_MS behind. The script then continues
+//   and must end with the same cleanings, discharges and reassignments as the
+//   run without resets
+// - power cut (RTC memory lost): the bed must come back as it was at some
+//   earlier transition, and only transitions from the last
+//   STATE_FLASH_INTERVAL_MS may be lost
+// Also counts how many resets would have brought the bed back wrong without
+// the snapshot (booting NORMAL, assigned and empty). Resets while the button
+// is held or a card is tapped during the reboot are skipped: those inputs are
+// lost on real hardware too.
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -DFEATURE_PERSISTENCE=0 -I"hardware/ESP8266 Code" tools/state_resume_check.cpp -o state_resume_check
+// Usage:
+//   ./state_resume_check [--episodes 10] [--every 7000] [--seed 1]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "bedConfig.h"
+#include "bedController.h"
+
+static const char* STAFF_CARDS[] = {"B310C2F5", "63870DFC", "04A1B2C3D4E5F6"};
+static const uint32_t TICK_MS = 10;
+static const uint32_t WARM_BOOT_MS = 300;
+static const uint32_t COLD_BOOT_MS = 2500;
+
+// Storage that outlives a controller: RTC memory (lost on a power cut) and flash
+struct SimRtc {
+    static std::vector<uint8_t> memory;
+    static bool load(void* data, size_t size) {
+        if (memory.size() != size) return false;
+        memcpy(data, memory.data(), size);
+        return true;
+    }
+    static bool save(const void* data, size_t size) {
+        memory.assign((const uint8_t*)data, (const uint8_t*)data + size);
+        return true;
+    }
+};
+std::vector<uint8_t> SimRtc::memory;
+
+struct SimFlash {
+    static std::vector<uint8_t> file;
+    static uint64_t writes;
+    static size_t load(const char*, void* data, size_t size) {
+        size_t n = std::min(size, file.size());
+        memcpy(data, file.data(), n);
+        return n;
+    }
+    static bool save(const char*, const char*, const void* data, size_t size) {
+        file.assign((const uint8_t*)data, (const uint8_t*)data + size);
+        writes++;
+        return true;
+    }
+};
+std::vector<uint8_t> SimFlash::file;
+uint64_t SimFlash::writes = 0;
+
+struct Outcome {
+    uint32_t cleanings = 0, discharges = 0, reassigned = 0;
+    bool operator==(const Outcome& o) const {
+        return cleanings == o.cleanings && discharges == o.discharges && reassigned == o.reassigned;
+    }
+};
+
+struct SimIo {
+    Outcome* outcome = nullptr;
+    void show(uint8_t, TextId, TextId, uint32_t) {}
+    void redraw(uint8_t) {}
+    void publish(uint8_t) {}
+    void trace(uint8_t, uint32_t) {}
+    template<typename... Args>
+    void log(uint8_t, LogId id, const Args&...) {
+        if (id == LOG_CLEANING_VERIFIED) outcome->cleanings++;
+        if (id == LOG_DISCHARGED) outcome->discharges++;
+        if (id == LOG_REASSIGNED) outcome->reassigned++;
+    }
+};
+
+enum ActionType { PATIENT_IN, PATIENT_OUT, PRESS, CARD };
+
+struct Action {
+    uint32_t atMs;
+    ActionType type;
+    uint32_t durationMs;    // PRESS: hold time; CARD: card index
+};
+
+class Script {
+public:
+    Script(unsigned seed, int episodes) : rng(seed) {
+        uint32_t t = 1000;
+        for (int e = 0; e < episodes; e++) {
+            add(t, PATIENT_IN);
+            t += between(20000, 60000);
+            if (rng() % 2) t = cleaning(t);
+            add(t, PATIENT_OUT);
+            t += between(5000, 15000);
+            add(t, PATIENT_IN);  // Back from a trip
+            t += between(10000, 30000);
+            add(t, PATIENT_OUT);
+            t += between(5000, 20000);
+            // Discharge: long press, card at the prompt, card to confirm
+            add(t, PRESS, DEFAULT_SETTINGS.longPressMs + between(200, 800));
+            t += DEFAULT_SETTINGS.longPressMs + between(1500, 3500);
+            add(t, CARD, card());
+            t += DEFAULT_SETTINGS.staffIdDisplayMs + between(1500, 4000);
+            add(t, CARD, card());
+            t += DEFAULT_SETTINGS.staffIdDisplayMs + between(10000, 30000);
+            // Reassigned by a card, cleaned for the next patient
+            add(t, CARD, card());
+            t = cleaning(t + DEFAULT_SETTINGS.staffIdDisplayMs + between(1000, 5000));
+        }
+        endMs = t + 20000;
+    }
+
+    std::vector<Action> actions;
+    uint32_t endMs = 0;
+
+private:
+    uint32_t between(uint32_t lo, uint32_t hi) { return lo + rng() % (hi - lo + 1); }
+    uint32_t card() { return rng() % 3; }
+    void add(uint32_t t, ActionType type, uint32_t value = 0) { actions.push_back({t, type, value}); }
+
+    // Press, clean, press, card; a fifth of the verifications time out first
+    uint32_t cleaning(uint32_t t) {
+        add(t, PRESS, between(100, 400));
+        t += between(10000, 30000);
+        for (;;) {
+            add(t, PRESS, between(100, 400));
+            if (rng() % 5 != 0) {
+                t += between(1000, 3500);
+                add(t, CARD, card());
+                return t + DEFAULT_SETTINGS.staffIdDisplayMs + between(1500, 4000);
+            }
+            t += DEFAULT_SETTINGS.verifyTimeoutMs + between(2000, 5000);
+        }
+    }
+
+    std::mt19937 rng;
+};
+
+// One boot of the controller: BedController and StateKeeper live in RAM
+struct Unit {
+    SimIo io;
+    BedController<SimIo> bed;
+    StateKeeper<1, SimRtc, SimFlash> keeper;
+
+    Unit(Outcome* outcome) { io.outcome = outcome; }
+
+    void boot(uint32_t nowMs) {
+        keeper.restore();
+        bed.restore(keeper.bed(0), nowMs, keeper.timersKnown());
+        bed.begin(&io, 0);
+    }
+};
+
+// The world around the bed: patient, button, cards
+struct World {
+    size_t next = 0;
+    bool patient = false;
+    uint32_t buttonUpMs = 0;
+    std::mt19937 noise{7};
+
+    void act(const Script& script, Unit* unit, uint32_t nowMs) {
+        for (; next < script.actions.size() && script.actions[next].atMs <= nowMs; next++) {
+            const Action& a = script.actions[next];
+            switch (a.type) {
+                case PATIENT_IN: patient = true; break;
+                case PATIENT_OUT: patient = false; break;
+                case PRESS: buttonUpMs = nowMs + a.durationMs; break;
+                case CARD:
+                    // processRFID: only beds that wait for a card, or an unassigned one
+                    if (unit->bed.awaitingCard() || (unit->bed.isUnassigned() && unit->bed.state() == NORMAL)) {
+                        unit->bed.staffCard(STAFF_CARDS[a.durationMs], nowMs);
+                    }
+                    break;
+            }
+        }
+    }
+
+    // One loop pass, as code.cpp orders it
+    void pass(const Script& script, Unit* unit, uint32_t nowMs) {
+        act(script, unit, nowMs);
+        unit->bed.button(nowMs < buttonUpMs, nowMs, DEFAULT_SETTINGS);
+        if (unit->bed.sampleDue(nowMs, DEFAULT_SETTINGS)) {
+            std::normal_distribution<double> n(0, 4);
+            int fsr = (int)((patient ? 620 : 90) + n(noise));
+            centi_t object = (centi_t)((patient ? 3420 : 2450) + n(noise) * 3);
+            centi_t ambient = unit->bed.ambientDue() ? (centi_t)(2300 + n(noise)) : AMBIENT_INVALID;
+            unit->bed.sample(std::max(0, fsr), object, ambient, nowMs, DEFAULT_SETTINGS);
+        }
+        unit->bed.timeouts(nowMs, DEFAULT_SETTINGS);
+        unit->keeper.update(0, unit->bed.snapshot(nowMs));
+        unit->keeper.commit(nowMs);
+    }
+
+    bool inputDuring(const Script& script, uint32_t fromMs, uint32_t toMs) const {
+        if (buttonUpMs > fromMs) return true;
+        for (size_t i = next; i < script.actions.size() && script.actions[i].atMs < toMs; i++) {
+            if (script.actions[i].type == PRESS || script.actions[i].type == CARD) return true;
+        }
+        return false;
+    }
+};
+
+static bool sameState(const BedSnapshot& a, const BedSnapshot& b) {
+    return memcmp(&a, &b, offsetof(BedSnapshot, timerAgeDs)) == 0;
+}
+
+struct Transition {
+    uint32_t atMs;
+    BedSnapshot state;
+};
+
+struct Reference {
+    std::vector<Transition> transitions;    // [0]: the state at boot
+    Outcome outcome;
+    BedSnapshot final;
+    uint64_t rtcWrites = 0, flashWrites = 0;
+};
+
+static void resetStorage() {
+    SimRtc::memory.clear();
+    SimFlash::file.clear();
+    SimFlash::writes = 0;
+}
+
+static Reference reference(const Script& script) {
+    resetStorage();
+    Reference ref;
+    Unit unit(&ref.outcome);
+    unit.boot(0);
+    World world;
+    ref.transitions.push_back({0, unit.bed.snapshot(0)});
+    for (uint32_t now = TICK_MS; now <= script.endMs; now += TICK_MS) {
+        world.pass(script, &unit, now);
+        BedSnapshot snap = unit.bed.snapshot(now);
+        if (!sameState(snap, ref.transitions.back().state)) {
+            ref.transitions.push_back({now, snap});
+        }
+    }
+    ref.final = unit.bed.snapshot(script.endMs);
+    ref.rtcWrites = unit.keeper.rtcWriteCount();
+    ref.flashWrites = SimFlash::writes;
+    return ref;
+}
+
+struct Tally {
+    uint64_t resets = 0, skipped = 0, exact = 0, failures = 0, wrongWithout = 0, outcomeMismatches = 0;
+    uint32_t maxTimerLagMs = 0, maxLostAgeMs = 0, lostTransitions = 0;
+};
+
+// Replay up to resetMs, reset, check the restored state, and continue after a warm reset
+static void resetAt(const Script& script, const Reference& ref, uint32_t resetMs, bool powerCut, Tally& tally) {
+    resetStorage();
+    Outcome outcome;
+    World world;
+    BedSnapshot before;
+    {
+        Unit unit(&outcome);
+        unit.boot(0);
+        for (uint32_t now = TICK_MS; now <= resetMs; now += TICK_MS) {
+            world.pass(script, &unit, now);
+        }
+        before = unit.bed.snapshot(resetMs);
+    }
+    uint32_t bootMs = resetMs + (powerCut ? COLD_BOOT_MS : WARM_BOOT_MS);
+    if (world.inputDuring(script, resetMs, bootMs + TICK_MS)) {
+        tally.skipped++;
+        return;
+    }
+    tally.resets++;
+    if (before.state != NORMAL || before.flags != 0 || before.staffBytes != 0) {
+        tally.wrongWithout++;  // A plain reboot comes back NORMAL, assigned and empty
+    }
+    if (powerCut) {
+        std::mt19937 garbage(resetMs);
+        for (uint8_t& b : SimRtc::memory) b = (uint8_t)garbage();
+    }
+
+    Unit unit(&outcome);
+    unit.boot(bootMs);
+    BedSnapshot restored = unit.bed.snapshot(bootMs);
+    if (!powerCut) {
+        if (!sameState(restored, before)) {
+            tally.failures++;
+            printf("  warm reset at %u ms: state %u/%u flags %u came back as %u/%u flags %u\n", resetMs,
+                   before.state, before.previous, before.flags, restored.state, restored.previous, restored.flags);
+            return;
+        }
+        tally.exact++;
+        uint32_t lagMs = (before.timerAgeDs - restored.timerAgeDs) * 100u;
+        tally.maxTimerLagMs = std::max(tally.maxTimerLagMs, lagMs);
+        if (restored.timerAgeDs > before.timerAgeDs || lagMs > STATE_TIMER_REFRESH_MS + 100) {
+            tally.failures++;
+            printf("  warm reset at %u ms: timer %u ds restored as %u ds\n", resetMs, before.timerAgeDs,
+                   restored.timerAgeDs);
+        }
+        for (uint32_t now = bootMs + TICK_MS; now <= script.endMs; now += TICK_MS) {
+            world.pass(script, &unit, now);
+        }
+        if (!(outcome == ref.outcome) || !sameState(unit.bed.snapshot(script.endMs), ref.final)) {
+            tally.outcomeMismatches++;
+            printf("  warm reset at %u ms: %u cleanings, %u discharges, %u reassignments; without reset %u, %u, %u\n",
+                   resetMs, outcome.cleanings, outcome.discharges, outcome.reassigned, ref.outcome.cleanings,
+                   ref.outcome.discharges, ref.outcome.reassigned);
+        }
+        return;
+    }
+
+    // Power cut: some earlier transition, with only the last few seconds lost
+    int match = -1;
+    for (int i = (int)ref.transitions.size() - 1; i >= 0; i--) {
+        if (ref.transitions[i].atMs <= resetMs && sameState(ref.transitions[i].state, restored)) {
+            match = i;
+            break;
+        }
+    }
+    if (match < 0) {
+        tally.failures++;
+        printf("  power cut at %u ms: restored state %u flags %u never happened\n", resetMs, restored.state,
+               restored.flags);
+        return;
+    }
+    if (sameState(restored, before)) tally.exact++;
+    for (size_t i = match + 1; i < ref.transitions.size() && ref.transitions[i].atMs <= resetMs; i++) {
+        uint32_t age = resetMs - ref.transitions[i].atMs;
+        tally.lostTransitions++;
+        tally.maxLostAgeMs = std::max(tally.maxLostAgeMs, age);
+        if (age >= STATE_FLASH_INTERVAL_MS + TICK_MS) {
+            tally.failures++;
+            printf("  power cut at %u ms: lost a transition %u ms old\n", resetMs, age);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int episodes = 10;
+    uint32_t every = 7000;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 < argc && arg == "--episodes") episodes = atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--every") every = (uint32_t)atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--seed") seed = (unsigned)atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--episodes n] [--every ms] [--seed n]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Script script(seed, episodes);
+    Reference ref = reference(script);
+    double hours = script.endMs / 3600000.0;
+    printf("script: %.1f min, %zu transitions, %u cleanings, %u discharges, %u reassignments\n",
+           script.endMs / 60000.0, ref.transitions.size() - 1, ref.outcome.cleanings, ref.outcome.discharges,
+           ref.outcome.reassigned);
+    printf("writes: rtc %.0f/h, flash %.0f/h; snapshot %zu bytes\n\n", ref.rtcWrites / hours,
+           ref.flashWrites / hours, sizeof(StateSnapshot<1>));
+
+    // Right after every transition, and every few seconds for running timers
+    std::vector<uint32_t> points;
+    for (size_t i = 1; i < ref.transitions.size(); i++) points.push_back(ref.transitions[i].atMs);
+    for (uint32_t t = every; t < script.endMs; t += every) points.push_back(t - t % TICK_MS);
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+
+    uint64_t failures = 0;
+    printf("%-10s %7s %7s %7s %9s %12s %8s %9s %11s\n", "reset", "resets", "skipped", "exact", "failures",
+           "wrong_before", "outcome", "timer_lag", "lost(max)");
+    for (bool powerCut : {false, true}) {
+        Tally tally;
+        for (uint32_t t : points) resetAt(script, ref, t, powerCut, tally);
+        failures += tally.failures + tally.outcomeMismatches;
+        char lost[32];
+        snprintf(lost, sizeof(lost), "%u(%.1fs)", tally.lostTransitions, tally.maxLostAgeMs / 1000.0);
+        printf("%-10s %7llu %7llu %7llu %9llu %12llu %8llu %7ums %11s\n", powerCut ? "power cut" : "warm",
+               (unsigned long long)tally.resets, (unsigned long long)tally.skipped,
+               (unsigned long long)tally.exact, (unsigned long long)tally.failures,
+               (unsigned long long)tally.wrongWithout, (unsigned long long)tally.outcomeMismatches,
+               tally.maxTimerLagMs, powerCut ? lost : "-");
+    }
+    printf("exact: came back in the state it was reset in; wrong_before: resets a plain reboot gets wrong;\n"
+           "outcome: warm resets whose continued run differs; timer_lag: restored timer behind the real one;\n"
+           "lost: transitions a power cut undid, and the oldest of them\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,554 @@
+// Uplink batching (uplinkBatch.h) on replayed ward workflows.
+//
+// Controllers run the firmware's BedController through a scripted ward on a
+// virtual clock, 10 ms per loop pass: admissions, cleanings (press, press,
+// card), trips away from the bed and discharges (long press, two cards).
+// updateFirebase() is mirrored from code.cpp: forced by a workflow step or on
+// the uplink tick, records of due beds classified as there and queued in the
+// batch, which is serviced every pass. The same records are counted as the
+// firmware sent them before batching: one request per updateFirebase() call
+// that had a due bed.
+//
+// Reported per scenario and record class: records, requests saved, and the
+// latency the batch added (a record queued to the update that carried it or
+// a newer record of its bed), from the simulation and from the batch's own
+// counters (the `batch` Serial command). The saving is split into heartbeat
+// pairing and other merges; status changes never merge. Checked:
+//   - fewer requests than one per updateFirebase() call (delivered updates
+//     when the link goes down)
+//   - every status a bed passed through reached the sink, in order
+//   - urgent records (discharge) added no latency; no class waited past
+//     its budget
+//   - the batch's counters agree with the simulation
+//   - link outages: updates retried every UPLINK_BATCH_RETRY_MS, each bed's
+//     latest status delivered once the link is back
+// Compare other idle times with -DUPLINK_BATCH_IDLE_MS=<ms>.
+//
+// Build (host, from the repo root):
+//   g++ -std=c++17 -O2 -DFEATURE_PERSISTENCE=0 -I"hardware/ESP8266 Code" tools/uplink_batch_sim.cpp -o uplink_batch_sim
+// Usage:
+//   ./uplink_batch_sim [--controllers 20] [--hours 8] [--seed 1]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <vector>
+#include "bedConfig.h"
+#include "bedController.h"
+#include "uplinkBatch.h"
+
+static const char* STAFF_CARDS[] = {"B310C2F5", "63870DFC"};
+static const uint32_t TICK_MS = 10;
+
+static int failures = 0;
+
+static void check(const char* name, bool ok, const char* detail = "") {
+    printf("  %-50s %-5s %s\n", name, ok ? "ok" : "FAIL", detail);
+    if (!ok) failures++;
+}
+
+// What the batch carries: the fields it reads, and enough to trace a record
+struct SimRecord {
+    uint16_t bed;
+    BedStatus status;
+    bool exitChanged;
+    uint32_t seq;           // Per bed, in queue order
+};
+
+struct SimIo {
+    uint8_t* published = nullptr;
+    void show(uint8_t, TextId, TextId, uint32_t) {}
+    void redraw(uint8_t) {}
+    void publish(uint8_t slot) { *published |= 1 << slot; }
+    void trace(uint8_t, uint32_t) {}
+    template<typename... Args>
+    void log(uint8_t, LogId, const Args&...) {}
+};
+
+typedef BedController<SimIo> Bed;
+
+// Scripted ward actions
+enum ActionType { PATIENT_IN, PATIENT_OUT, PRESS, CARD };
+
+struct Action {
+    uint32_t atMs;
+    ActionType type;
+    uint32_t durationMs;    // PRESS only
+};
+
+struct Queued {
+    uint32_t seq;
+    uint32_t ms;
+    UplinkClass uplinkClass;
+};
+
+struct ClassResult {
+    uint64_t records = 0;
+    std::vector<uint32_t> addedMs;
+};
+
+struct Result {
+    ClassResult classes[UPLINK_CLASS_COUNT];
+    UplinkBatchStats stats = {};
+    uint64_t oldRequests = 0;       // One per updateFirebase() call with a due bed
+    uint64_t requests = 0;          // Updates the batch tried
+    uint64_t statusesQueued = 0;    // Status changes between consecutive records of a bed
+    uint64_t statusesLost = 0;      // ...that never reached the sink
+    uint64_t orderErrors = 0;
+    uint64_t budgetOverruns = 0;
+    uint64_t retryTooSoon = 0;      // Updates tried within UPLINK_BATCH_RETRY_MS of a failed one
+    uint64_t staleAtEnd = 0;        // Beds whose latest status never arrived
+    uint64_t outageRequests = 0;
+    double outageSeconds = 0;
+};
+
+// Ward script for one bed: the timings of fleet_sim.cpp, uncompressed
+struct Ward {
+    std::mt19937 rng;
+    bool quick;     // Workflow bursts back to back instead of hours apart
+
+    uint32_t between(uint32_t lo, uint32_t hi) { return lo + rng() % (hi - lo + 1); }
+
+    uint32_t minutes(double mean) {
+        if (quick) {
+            mean = std::min(mean, 1.0);
+        }
+        std::exponential_distribution<double> d(1.0 / mean);
+        return (uint32_t)(d(rng) * 60000.0) + 1000;
+    }
+
+    uint32_t cleaning(std::deque<Action>& script, uint32_t t) {
+        script.push_back({t, PRESS, between(100, 400)});
+        t += minutes(15);
+        for (;;) {
+            script.push_back({t, PRESS, between(100, 400)});
+            if (rng() % 20 != 0) {
+                t += between(1000, 4000);
+                script.push_back({t, CARD, 0});
+                return t + DEFAULT_SETTINGS.staffIdDisplayMs + 1500;
+            }
+            t += DEFAULT_SETTINGS.verifyTimeoutMs + 2000;
+        }
+    }
+
+    uint32_t stay(std::deque<Action>& script, uint32_t t, double meanHours) {
+        script.push_back({t, PATIENT_IN, 0});
+        uint32_t end = t + minutes(meanHours * 60);
+        bool cleaned = false;
+        for (;;) {
+            t += minutes(90);
+            if (t >= end) break;
+            if (!cleaned && rng() % 3 == 0) {
+                t = cleaning(script, t);
+                cleaned = true;
+                continue;
+            }
+            script.push_back({t, PATIENT_OUT, 0});
+            t += minutes(8);
+            script.push_back({t, PATIENT_IN, 0});
+        }
+        script.push_back({end, PATIENT_OUT, 0});
+        t = end + minutes(10);
+        script.push_back({t, PRESS, DEFAULT_SETTINGS.longPressMs + between(200, 800)});
+        t += DEFAULT_SETTINGS.longPressMs + between(1500, 3500);
+        script.push_back({t, CARD, 0});
+        t += DEFAULT_SETTINGS.staffIdDisplayMs + between(1500, 5000);
+        script.push_back({t, CARD, 0});
+        return t + DEFAULT_SETTINGS.staffIdDisplayMs + 500;
+    }
+
+    void nextEpisode(std::deque<Action>& script, uint32_t t) {
+        t += minutes(30);
+        script.push_back({t, CARD, 0});
+        t = cleaning(script, t + DEFAULT_SETTINGS.staffIdDisplayMs + 1000);
+        stay(script, t + minutes(20), 36);
+    }
+};
+
+struct SimBed {
+    Bed controller;
+    std::deque<Action> script;
+    bool patient = false;
+    uint32_t buttonUpMs = 0;
+    uint32_t nextSeq = 1;
+    std::vector<Queued> waiting;            // Queued, not yet carried by an update
+    std::vector<BedStatus> queuedStatuses;  // Every status change, in queue order
+    std::vector<BedStatus> sinkStatuses;    // Status changes as the sink saw them
+    BedStatus lastQueued = UNASSIGNED;
+    BedStatus lastSink = UNASSIGNED;
+};
+
+// One controller of Beds beds, its batch and its link
+template<uint8_t Beds>
+class Controller {
+public:
+    Controller(unsigned seed, bool quick, const std::vector<std::pair<uint32_t, uint32_t>>& outages)
+        : down(outages) {
+        ward.rng.seed(seed);
+        ward.quick = quick;
+        for (uint8_t i = 0; i < Beds; i++) {
+            io.published = &published;
+            beds[i].controller.begin(&io, i);
+            uint32_t t = ward.between(1000, 20000);
+            if (ward.rng() % 4 == 0) {
+                t = ward.cleaning(beds[i].script, t);
+            }
+            ward.stay(beds[i].script, t, 6);
+        }
+        nextTickMs = ward.between(0, DEFAULT_SETTINGS.uplinkIntervalMs);
+    }
+
+    // One loop pass of code.cpp at nowMs
+    void step(uint32_t nowMs) {
+        this->nowMs = nowMs;
+        for (uint8_t i = 0; i < Beds; i++) {
+            SimBed& bed = beds[i];
+            while (!bed.script.empty() && bed.script.front().atMs <= nowMs) {
+                Action a = bed.script.front();
+                bed.script.pop_front();
+                switch (a.type) {
+                    case PATIENT_IN: bed.patient = true; break;
+                    case PATIENT_OUT: bed.patient = false; break;
+                    case PRESS: bed.buttonUpMs = nowMs + a.durationMs; break;
+                    case CARD: bed.controller.staffCard(STAFF_CARDS[ward.rng() % 2], nowMs); publishIfAny(); break;
+                }
+                if (bed.script.empty()) {
+                    ward.nextEpisode(bed.script, nowMs);
+                }
+            }
+            bed.controller.button(nowMs < bed.buttonUpMs, nowMs, DEFAULT_SETTINGS);
+            publishIfAny();
+        }
+        for (uint8_t i = 0; i < Beds; i++) {
+            SimBed& bed = beds[i];
+            if (bed.controller.sampleDue(nowMs, DEFAULT_SETTINGS)) {
+                std::normal_distribution<double> noise(0, 4);
+                int fsr = (int)((bed.patient ? 620 : 90) + noise(ward.rng));
+                centi_t object = (centi_t)((bed.patient ? 3420 : 2450) + noise(ward.rng) * 3);
+                centi_t ambient = bed.controller.ambientDue() ? (centi_t)(2300 + noise(ward.rng)) : AMBIENT_INVALID;
+                bed.controller.sample(std::max(0, fsr), object, ambient, nowMs, DEFAULT_SETTINGS);
+            }
+            bed.controller.timeouts(nowMs, DEFAULT_SETTINGS);
+            publishIfAny();
+        }
+        if ((int32_t)(nowMs - nextTickMs) >= 0) {
+            nextTickMs = nowMs + DEFAULT_SETTINGS.uplinkIntervalMs;
+            updateFirebase();
+        }
+        // flushUplink()
+        if (batch.waiting() > 0) {
+            batch.service(nowMs, sender);
+        }
+    }
+
+    // The link comes back for good: drain what is left
+    void finish(uint32_t nowMs) {
+        down.clear();
+        for (uint32_t t = nowMs; batch.waiting() > 0 && t < nowMs + 10000; t += TICK_MS) {
+            this->nowMs = t;
+            batch.service(t, sender);
+        }
+    }
+
+    void collect(Result& result) const {
+        for (uint8_t c = 0; c < UPLINK_CLASS_COUNT; c++) {
+            const UplinkClassStats& from = batch.stats().classes[c];
+            UplinkClassStats& to = result.stats.classes[c];
+            to.records += from.records;
+            to.saved += from.saved;
+            to.sent += from.sent;
+            to.addedMsTotal += from.addedMsTotal;
+            to.addedMsMax = std::max(to.addedMsMax, from.addedMsMax);
+            result.classes[c].records += classes[c].records;
+            result.classes[c].addedMs.insert(result.classes[c].addedMs.end(), classes[c].addedMs.begin(),
+                                             classes[c].addedMs.end());
+        }
+        for (uint8_t r = 0; r < UPLINK_FLUSH_COUNT; r++) {
+            result.stats.reasons[r] += batch.stats().reasons[r];
+        }
+        result.stats.requests += batch.stats().requests;
+        result.stats.failed += batch.stats().failed;
+        result.stats.overwritten += batch.stats().overwritten;
+        result.stats.maxRecords = std::max(result.stats.maxRecords, batch.stats().maxRecords);
+        result.oldRequests += oldRequests;
+        result.requests += requests;
+        result.budgetOverruns += budgetOverruns;
+        result.retryTooSoon += retryTooSoon;
+        result.outageRequests += outageRequests;
+        for (uint8_t i = 0; i < Beds; i++) {
+            const SimBed& bed = beds[i];
+            result.statusesQueued += bed.queuedStatuses.size();
+            // The sink's changes must be the queued ones in order, possibly fewer
+            size_t k = 0;
+            for (BedStatus s : bed.sinkStatuses) {
+                while (k < bed.queuedStatuses.size() && bed.queuedStatuses[k] != s) {
+                    k++;
+                }
+                if (k == bed.queuedStatuses.size()) {
+                    result.orderErrors++;
+                    break;
+                }
+                k++;
+            }
+            result.statusesLost += bed.queuedStatuses.size() - std::min(bed.queuedStatuses.size(),
+                                                                       bed.sinkStatuses.size());
+            if (bed.lastSink != bed.lastQueued) {
+                result.staleAtEnd++;
+            }
+        }
+    }
+
+private:
+    struct Sender {
+        Controller* owner;
+        bool operator()(const SimRecord* records, uint8_t count) { return owner->deliver(records, count); }
+    };
+
+    void publishIfAny() {
+        if (published != 0) {
+            updateFirebase();
+        }
+    }
+
+    // code.cpp updateFirebase() and uplinkClass()
+    void updateFirebase() {
+        uint8_t workflow = published;
+        published = 0;
+        bool any = false;
+        for (uint8_t i = 0; i < Beds; i++) {
+            SimBed& bed = beds[i];
+            Bed& c = bed.controller;
+            if (!c.reportDue(DEFAULT_SETTINGS, DEFAULT_SETTINGS.uplinkIntervalMs, nowMs)) {
+                continue;
+            }
+            any = true;
+            UplinkClass cause;
+            if (c.status() == UNASSIGNED && c.reportedStatus() != UNASSIGNED) {
+                cause = UPLINK_URGENT;
+            } else if (workflow & (1 << i)) {
+                cause = UPLINK_WORKFLOW;
+            } else {
+                cause = c.reportDue(DEFAULT_SETTINGS, UINT32_MAX, nowMs) ? UPLINK_CHANGE : UPLINK_HEARTBEAT;
+            }
+            SimRecord record = {(uint16_t)i, c.status(), false, bed.nextSeq++};
+            bed.waiting.push_back({record.seq, nowMs, cause});
+            classes[cause].records++;
+            if (record.status != bed.lastQueued) {
+                bed.queuedStatuses.push_back(record.status);
+                bed.lastQueued = record.status;
+            }
+            batch.add(i, record, cause, nowMs, sender);
+            c.reported(nowMs);
+        }
+        if (any) {
+            oldRequests++;
+        }
+        batch.service(nowMs, sender);
+    }
+
+    bool linkDown() const {
+        for (const auto& window : down) {
+            if (nowMs >= window.first && nowMs < window.second) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool deliver(const SimRecord* records, uint8_t count) {
+        requests++;
+        if (failedMs != 0 && nowMs - failedMs < UPLINK_BATCH_RETRY_MS) {
+            retryTooSoon++;
+        }
+        if (linkDown()) {
+            outageRequests++;
+            failedMs = nowMs;
+            return false;
+        }
+        failedMs = 0;
+        for (uint8_t n = 0; n < count; n++) {
+            SimBed& bed = beds[records[n].bed];
+            // The record carries itself and every older one of its bed
+            auto it = bed.waiting.begin();
+            for (; it != bed.waiting.end() && it->seq <= records[n].seq; ++it) {
+                uint32_t added = nowMs - it->ms;
+                classes[it->uplinkClass].addedMs.push_back(added);
+                if (down.empty() && added > uplinkBudgetMs(it->uplinkClass) + TICK_MS) {
+                    budgetOverruns++;
+                }
+            }
+            bed.waiting.erase(bed.waiting.begin(), it);
+            if (records[n].status != bed.lastSink) {
+                bed.sinkStatuses.push_back(records[n].status);
+                bed.lastSink = records[n].status;
+            }
+        }
+        return true;
+    }
+
+    Ward ward;
+    SimIo io;
+    SimBed beds[Beds];
+    uint8_t published = 0;
+    UplinkBatch<SimRecord, Beds> batch;
+    Sender sender{this};
+    uint32_t nowMs = 0;
+    uint32_t nextTickMs = 0;
+    uint32_t failedMs = 0;
+    std::vector<std::pair<uint32_t, uint32_t>> down;
+    ClassResult classes[UPLINK_CLASS_COUNT];
+    uint64_t oldRequests = 0;
+    uint64_t requests = 0;
+    uint64_t budgetOverruns = 0;
+    uint64_t retryTooSoon = 0;
+    uint64_t outageRequests = 0;
+};
+
+static uint32_t percentile(std::vector<uint32_t>& values, double p) {
+    if (values.empty()) return 0;
+    size_t k = (size_t)(p * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + k, values.end());
+    return values[k];
+}
+
+template<uint8_t Beds>
+static Result runScenario(int controllers, double hours, unsigned seed, bool quick, bool outages) {
+    Result result;
+    uint32_t endMs = (uint32_t)(hours * 3600000.0);
+    for (int n = 0; n < controllers; n++) {
+        // Outages: a minute down at a different point of every hour
+        std::vector<std::pair<uint32_t, uint32_t>> down;
+        if (outages) {
+            std::mt19937 rng(seed * 131 + n);
+            for (uint32_t h = 0; h + 3600000 <= endMs; h += 3600000) {
+                uint32_t start = h + rng() % 3540000;
+                down.push_back({start, start + 60000});
+                result.outageSeconds += 60;
+            }
+        }
+        Controller<Beds> controller(seed * 7919 + n, quick, down);
+        for (uint32_t t = 0; t < endMs; t += TICK_MS) {
+            controller.step(t);
+        }
+        controller.finish(endMs);
+        controller.collect(result);
+    }
+    return result;
+}
+
+static void report(const char* title, Result& r, bool healthy) {
+    printf("%s\n", title);
+    printf("  %-10s %9s %8s %8s %9s %9s %9s %9s %9s\n", "class", "budget_ms", "records", "saved", "added_p50",
+           "added_p99", "added_max", "fw_avg", "fw_max");
+    uint64_t records = 0;
+    uint64_t saved = 0;
+    for (uint8_t c = 0; c < UPLINK_CLASS_COUNT; c++) {
+        ClassResult& cr = r.classes[c];
+        const UplinkClassStats& fw = r.stats.classes[c];
+        char name[UPLINK_NAME_SIZE];
+        uint32_t max = cr.addedMs.empty() ? 0 : *std::max_element(cr.addedMs.begin(), cr.addedMs.end());
+        printf("  %-10s %9u %8llu %8llu %9u %9u %9u %9llu %9u\n", uplinkClassName((UplinkClass)c, name),
+               uplinkBudgetMs((UplinkClass)c), (unsigned long long)cr.records, (unsigned long long)fw.saved,
+               percentile(cr.addedMs, 0.5), percentile(cr.addedMs, 0.99), max,
+               (unsigned long long)(fw.sent ? fw.addedMsTotal / fw.sent : 0), fw.addedMsMax);
+        records += cr.records;
+        saved += fw.saved;
+    }
+    uint64_t succeeded = r.stats.requests - r.stats.failed;
+    printf("  requests: %llu before batching, %llu batched (%+.1f%%), %llu failed; up to %u beds per update\n",
+           (unsigned long long)r.oldRequests, (unsigned long long)r.stats.requests,
+           r.oldRequests ? 100.0 * ((double)r.stats.requests - (double)r.oldRequests) / r.oldRequests : 0.0,
+           (unsigned long long)r.stats.failed, r.stats.maxRecords);
+    printf("  flushed by: budget %llu, full %llu, idle %llu, status change %llu\n",
+           (unsigned long long)r.stats.reasons[UPLINK_FLUSH_BUDGET],
+           (unsigned long long)r.stats.reasons[UPLINK_FLUSH_FULL],
+           (unsigned long long)r.stats.reasons[UPLINK_FLUSH_IDLE],
+           (unsigned long long)r.stats.reasons[UPLINK_FLUSH_STATUS]);
+    // Pairing heartbeats is what a longer uplink tick would save too; a
+    // status change never merges, so a burst still costs a write per status
+    printf("  saved: %llu by pairing heartbeats, %llu by merging other records; %llu status changes, "
+           "none merged\n",
+           (unsigned long long)r.stats.classes[UPLINK_HEARTBEAT].saved,
+           (unsigned long long)(saved - r.stats.classes[UPLINK_HEARTBEAT].saved),
+           (unsigned long long)r.statusesQueued);
+
+    // Failed attempts while the link is down are retries the firmware made
+    // before batching too; compare the updates that got through
+    char detail[96];
+    uint64_t compared = healthy ? r.stats.requests : succeeded;
+    snprintf(detail, sizeof(detail), "%llu vs %llu", (unsigned long long)compared,
+             (unsigned long long)r.oldRequests);
+    check(healthy ? "fewer requests than one per updateFirebase() call"
+                  : "fewer delivered updates than one per updateFirebase() call",
+          compared < r.oldRequests, detail);
+    snprintf(detail, sizeof(detail), "%llu records, %llu saved, %llu updates", (unsigned long long)records,
+             (unsigned long long)saved, (unsigned long long)succeeded);
+    check("batch counters: records = saved + updates", records == saved + succeeded, detail);
+    check("statuses reach the sink in queue order", r.orderErrors == 0);
+    snprintf(detail, sizeof(detail), "%llu beds", (unsigned long long)r.staleAtEnd);
+    check("every bed's latest status delivered", r.staleAtEnd == 0, detail);
+    std::vector<uint32_t>& urgent = r.classes[UPLINK_URGENT].addedMs;
+    if (!urgent.empty()) {
+        uint32_t max = *std::max_element(urgent.begin(), urgent.end());
+        snprintf(detail, sizeof(detail), "%llu discharges, max %u ms", (unsigned long long)urgent.size(), max);
+        check(healthy ? "urgent records go out in the same pass" : "urgent records (outages aside) on time",
+              !healthy || max == 0, detail);
+    }
+    if (healthy) {
+        snprintf(detail, sizeof(detail), "%llu of %llu statuses", (unsigned long long)r.statusesLost,
+                 (unsigned long long)r.statusesQueued);
+        check("every status a bed passed through delivered", r.statusesLost == 0, detail);
+        snprintf(detail, sizeof(detail), "%llu records", (unsigned long long)r.budgetOverruns);
+        check("no record waited past its class budget", r.budgetOverruns == 0, detail);
+    } else {
+        snprintf(detail, sizeof(detail), "%llu attempts in %.0f s down (%.2f/s), %llu statuses overwritten",
+                 (unsigned long long)r.outageRequests, r.outageSeconds,
+                 r.outageSeconds > 0 ? r.outageRequests / r.outageSeconds : 0.0,
+                 (unsigned long long)r.stats.overwritten);
+        check("outages: retried no faster than UPLINK_BATCH_RETRY_MS", r.retryTooSoon == 0, detail);
+    }
+}
+
+int main(int argc, char** argv) {
+    int controllers = 20;
+    double hours = 8;
+    unsigned seed = 1;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--controllers") && i + 1 < argc) {
+            controllers = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--hours") && i + 1 < argc) {
+            hours = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+            seed = (unsigned)atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "usage: %s [--controllers N] [--hours H] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (controllers <= 0 || hours <= 0) {
+        fprintf(stderr, "--controllers and --hours must be positive\n");
+        return 2;
+    }
+    printf("%d controllers, %.1f h each, idle flush after %u ms, retry after %u ms\n\n", controllers, hours,
+           UPLINK_BATCH_IDLE_MS, UPLINK_BATCH_RETRY_MS);
+
+    char title[96];
+    Result single = runScenario<1>(controllers, hours, seed, false, false);
+    snprintf(title, sizeof(title), "ward, one bed per controller");
+    report(title, single, true);
+    Result multi = runScenario<3>(controllers, hours, seed, false, false);
+    snprintf(title, sizeof(title), "ward, three beds per controller");
+    report(title, multi, true);
+    Result bursts = runScenario<1>(controllers, hours, seed, true, false);
+    snprintf(title, sizeof(title), "workflow bursts (stays and cleanings of about a minute)");
+    report(title, bursts, true);
+    Result outage = runScenario<3>(controllers, hours, seed, false, true);
+    snprintf(title, sizeof(title), "three beds per controller, link down a minute every hour");
+    report(title, outage, false);
+
+    printf("\n%s\n", failures == 0 ? "all checks passed" : "CHECKS FAILED");
+    return failures == 0 ? 0 : 1;
+}